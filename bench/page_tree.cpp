@@ -0,0 +1,538 @@
+#include "page_tree.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace apollo {
+namespace bench {
+
+namespace {
+
+using layout::Display;
+using layout::EdgeInsets;
+using layout::LayoutBox;
+using layout::LayoutNode;
+using layout::LayoutTree;
+using layout::Position;
+
+using Declarations = std::vector<std::pair<std::string, std::string>>;
+
+// Rules by the tag or ".class" they apply to, in source order
+using StyleSheet = std::unordered_map<std::string, std::vector<Declarations>>;
+
+// CSS px per em; the pages' root font size
+constexpr double kEm = 16;
+
+const char* const kVoidElements[] = {"area", "base", "br", "col", "embed", "hr", "img", "input",
+                                     "link", "meta", "source", "track", "wbr"};
+// Elements whose content is not markup
+const char* const kRawTextElements[] = {"script", "style", "textarea", "title"};
+// Elements that produce no boxes
+const char* const kSkippedElements[] = {"head", "script", "style", "title", "template"};
+
+struct TagDisplay {
+    const char* tag;
+    Display display;
+};
+
+const TagDisplay kTagDisplays[] = {
+    {"html", Display::Block},       {"body", Display::Block},      {"div", Display::Block},
+    {"p", Display::Block},          {"section", Display::Block},   {"article", Display::Block},
+    {"header", Display::Block},     {"footer", Display::Block},    {"nav", Display::Block},
+    {"main", Display::Block},       {"aside", Display::Block},     {"h1", Display::Block},
+    {"h2", Display::Block},         {"h3", Display::Block},        {"h4", Display::Block},
+    {"h5", Display::Block},         {"h6", Display::Block},        {"ul", Display::Block},
+    {"ol", Display::Block},         {"li", Display::ListItem},     {"pre", Display::Block},
+    {"blockquote", Display::Block}, {"form", Display::Block},      {"figure", Display::Block},
+    {"hr", Display::Block},         {"dl", Display::Block},        {"dt", Display::Block},
+    {"dd", Display::Block},         {"table", Display::Table},     {"tr", Display::TableRow},
+    {"tbody", Display::TableRowGroup}, {"thead", Display::TableRowGroup}, {"td", Display::TableCell},
+    {"th", Display::TableCell},     {"img", Display::InlineBlock}, {"button", Display::InlineBlock},
+    {"input", Display::InlineBlock}, {"select", Display::InlineBlock}, {"textarea", Display::InlineBlock},
+};
+
+struct DisplayName {
+    const char* name;
+    Display display;
+};
+
+const DisplayName kDisplayNames[] = {
+    {"none", Display::None},
+    {"block", Display::Block},
+    {"inline", Display::Inline},
+    {"inline-block", Display::InlineBlock},
+    {"flex", Display::Flex},
+    {"inline-flex", Display::InlineFlex},
+    {"grid", Display::Grid},
+    {"inline-grid", Display::InlineGrid},
+    {"table", Display::Table},
+    {"table-row", Display::TableRow},
+    {"table-cell", Display::TableCell},
+    {"list-item", Display::ListItem},
+    {"contents", Display::Contents},
+};
+
+struct PositionName {
+    const char* name;
+    Position position;
+};
+
+const PositionName kPositionNames[] = {
+    {"static", Position::Static},
+    {"relative", Position::Relative},
+    {"absolute", Position::Absolute},
+    {"fixed", Position::Fixed},
+    {"sticky", Position::Sticky},
+};
+
+template <size_t N>
+bool contains(const char* const (&names)[N], const std::string& name) {
+    return std::find_if(std::begin(names), std::end(names), [&](const char* entry) { return name == entry; }) !=
+           std::end(names);
+}
+
+std::string lower(std::string text) {
+    for (char& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return text;
+}
+
+std::string trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return std::string();
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::string part;
+    std::istringstream in(text);
+    while (std::getline(in, part, separator)) parts.push_back(part);
+    return parts;
+}
+
+// Whitespace-separated words
+std::vector<std::string> words(const std::string& text) {
+    std::vector<std::string> result;
+    std::istringstream in(text);
+    std::string word;
+    while (in >> word) result.push_back(word);
+    return result;
+}
+
+// px of a length; percentages and keywords other than the border widths
+// count as 0
+double parseLength(const std::string& value) {
+    if (value == "thin") return 1;
+    if (value == "medium") return 3;
+    if (value == "thick") return 5;
+    char* end = nullptr;
+    double number = std::strtod(value.c_str(), &end);
+    if (end == value.c_str()) return 0;
+    std::string unit = lower(end);
+    if (unit == "em" || unit == "rem") return number * kEm;
+    if (unit == "px" || unit.empty()) return number;
+    if (unit == "pt") return number * 4 / 3;
+    return 0;
+}
+
+bool isLength(const std::string& value) {
+    return !value.empty() && (std::isdigit(static_cast<unsigned char>(value[0])) || value[0] == '.' ||
+                              value == "thin" || value == "medium" || value == "thick");
+}
+
+// Expands the one to four values of a box shorthand
+EdgeInsets parseEdges(const std::string& value) {
+    std::vector<double> lengths;
+    for (const std::string& word : words(value)) lengths.push_back(parseLength(word));
+    switch (lengths.size()) {
+        case 0: return EdgeInsets();
+        case 1: return EdgeInsets(lengths[0]);
+        case 2: return EdgeInsets(lengths[0], lengths[1]);
+        case 3: return EdgeInsets(lengths[0], lengths[1], lengths[2], lengths[1]);
+        default: return EdgeInsets(lengths[0], lengths[1], lengths[2], lengths[3]);
+    }
+}
+
+Declarations parseDeclarations(const std::string& text) {
+    Declarations declarations;
+    for (const std::string& item : split(text, ';')) {
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = lower(trim(item.substr(0, colon)));
+        std::string value = lower(trim(item.substr(colon + 1)));
+        size_t important = value.find("!important");
+        if (important != std::string::npos) value = trim(value.substr(0, important));
+        if (!name.empty()) declarations.emplace_back(std::move(name), std::move(value));
+    }
+    return declarations;
+}
+
+// Keys a selector's last simple selector matches, tag or ".class"
+std::vector<std::string> selectorKeys(const std::string& selector) {
+    std::string last;
+    for (const std::string& word : words(selector)) {
+        if (word != ">" && word != "+" && word != "~") last = word;
+    }
+    size_t combinator = last.find_last_of(">+~");
+    if (combinator != std::string::npos) last = last.substr(combinator + 1);
+    size_t pseudo = last.find_first_of(":[");
+    if (pseudo != std::string::npos) last = last.substr(0, pseudo);
+
+    std::vector<std::string> keys;
+    size_t dot = last.find('.');
+    if (dot == std::string::npos) {
+        if (!last.empty() && std::isalpha(static_cast<unsigned char>(last[0]))) keys.push_back(lower(last));
+        return keys;
+    }
+    for (const std::string& name : split(last.substr(dot + 1), '.')) {
+        if (!name.empty()) keys.push_back("." + name);
+    }
+    return keys;
+}
+
+void parseStyleSheet(const std::string& css, StyleSheet& sheet) {
+    // Comments first, so braces in them do not count
+    std::string text;
+    for (size_t i = 0; i < css.size();) {
+        if (css.compare(i, 2, "/*") == 0) {
+            size_t end = css.find("*/", i + 2);
+            i = end == std::string::npos ? css.size() : end + 2;
+        } else {
+            text += css[i++];
+        }
+    }
+
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t open = text.find('{', i);
+        if (open == std::string::npos) break;
+        std::string prelude = trim(text.substr(i, open - i));
+        // The block ends at its matching brace
+        size_t close = open + 1;
+        for (int depth = 1; close < text.size() && depth > 0; ++close) {
+            if (text[close] == '{') ++depth;
+            if (text[close] == '}') --depth;
+        }
+        std::string body = text.substr(open + 1, close - open - 2);
+        i = close;
+
+        if (!prelude.empty() && prelude[0] == '@') {
+            // Media queries are taken to match; other at-rules hold no
+            // style rules
+            if (prelude.compare(0, 6, "@media") == 0) parseStyleSheet(body, sheet);
+            continue;
+        }
+        Declarations declarations = parseDeclarations(body);
+        for (const std::string& selector : split(prelude, ',')) {
+            for (const std::string& key : selectorKeys(selector)) {
+                sheet[key].push_back(declarations);
+            }
+        }
+    }
+}
+
+void applyDeclarations(const Declarations& declarations, LayoutBox& box) {
+    for (const auto& [name, value] : declarations) {
+        if (name == "display") {
+            for (const auto& entry : kDisplayNames) {
+                if (value == entry.name) box.setDisplay(entry.display);
+            }
+        } else if (name == "position") {
+            for (const auto& entry : kPositionNames) {
+                if (value == entry.name) box.setPosition(entry.position);
+            }
+        } else if (name == "z-index") {
+            if (value != "auto") box.setZIndex(std::atoi(value.c_str()));
+        } else if (name == "opacity") {
+            box.setOpacity(std::atof(value.c_str()));
+        } else if (name == "margin") {
+            box.setMargin(parseEdges(value));
+        } else if (name == "padding") {
+            box.setPadding(parseEdges(value));
+        } else if (name == "border-width") {
+            box.setBorder(parseEdges(value));
+        } else if (name == "border") {
+            if (value == "none" || value == "0") {
+                box.setBorder(EdgeInsets());
+                continue;
+            }
+            // One width for all sides, 'medium' without one
+            double width = 3;
+            for (const std::string& word : words(value)) {
+                if (isLength(word)) width = parseLength(word);
+            }
+            box.setBorder(EdgeInsets(width));
+        }
+    }
+}
+
+std::string decodeText(const std::string& text) {
+    static const std::pair<const char*, const char*> kEntities[] = {
+        {"&amp;", "&"}, {"&lt;", "<"}, {"&gt;", ">"}, {"&quot;", "\""}, {"&#39;", "'"}, {"&nbsp;", " "},
+    };
+    std::string result;
+    bool space = false;
+    for (size_t i = 0; i < text.size();) {
+        if (std::isspace(static_cast<unsigned char>(text[i]))) {
+            space = true;
+            ++i;
+            continue;
+        }
+        if (space && !result.empty()) result += ' ';
+        space = false;
+        if (text[i] == '&') {
+            bool decoded = false;
+            for (const auto& [entity, replacement] : kEntities) {
+                if (text.compare(i, std::char_traits<char>::length(entity), entity) == 0) {
+                    result += replacement;
+                    i += std::char_traits<char>::length(entity);
+                    decoded = true;
+                    break;
+                }
+            }
+            if (decoded) continue;
+        }
+        result += text[i++];
+    }
+    return result;
+}
+
+struct Tag {
+    std::string name;
+    std::unordered_map<std::string, std::string> attributes;
+    bool closing = false;
+    bool selfClosing = false;
+};
+
+// Parses the tag starting at html[start], which is '<'; returns the index
+// after it
+size_t parseTag(const std::string& html, size_t start, Tag& tag) {
+    size_t i = start + 1;
+    if (i < html.size() && html[i] == '/') {
+        tag.closing = true;
+        ++i;
+    }
+    size_t nameStart = i;
+    while (i < html.size() && !std::isspace(static_cast<unsigned char>(html[i])) && html[i] != '>' && html[i] != '/')
+        ++i;
+    tag.name = lower(html.substr(nameStart, i - nameStart));
+
+    while (i < html.size() && html[i] != '>') {
+        if (html[i] == '/') {
+            tag.selfClosing = true;
+            ++i;
+            continue;
+        }
+        if (std::isspace(static_cast<unsigned char>(html[i]))) {
+            ++i;
+            continue;
+        }
+        size_t keyStart = i;
+        while (i < html.size() && html[i] != '=' && html[i] != '>' && !std::isspace(static_cast<unsigned char>(html[i])))
+            ++i;
+        std::string key = lower(html.substr(keyStart, i - keyStart));
+        std::string value;
+        if (i < html.size() && html[i] == '=') {
+            ++i;
+            if (i < html.size() && (html[i] == '"' || html[i] == '\'')) {
+                char quote = html[i++];
+                size_t end = html.find(quote, i);
+                if (end == std::string::npos) end = html.size();
+                value = html.substr(i, end - i);
+                i = end + 1;
+            } else {
+                size_t valueStart = i;
+                while (i < html.size() && html[i] != '>' && !std::isspace(static_cast<unsigned char>(html[i]))) ++i;
+                value = html.substr(valueStart, i - valueStart);
+            }
+        }
+        if (!key.empty()) tag.attributes[key] = value;
+    }
+    return std::min(html.size(), i + 1);
+}
+
+// Index just past the raw text of element name starting at start, and
+// where the text ends
+size_t skipRawText(const std::string& html, size_t start, const std::string& name, size_t& textEnd) {
+    for (size_t i = html.find("</", start); i != std::string::npos; i = html.find("</", i + 2)) {
+        if (lower(html.substr(i + 2, name.size())) != name) continue;
+        textEnd = i;
+        size_t close = html.find('>', i);
+        return close == std::string::npos ? html.size() : close + 1;
+    }
+    textEnd = html.size();
+    return html.size();
+}
+
+class PageBuilder {
+public:
+    explicit PageBuilder(const StyleSheet& sheet)
+        : sheet_(sheet)
+        , tree_(std::make_unique<LayoutTree>())
+        , open_()
+        , skipDepth_(0) {
+    }
+
+    void openElement(const Tag& tag) {
+        bool isVoid = contains(kVoidElements, tag.name) || tag.selfClosing;
+        if (skipDepth_ > 0 || contains(kSkippedElements, tag.name)) {
+            if (!isVoid) {
+                ++skipDepth_;
+                skipped_.push_back(tag.name);
+            }
+            return;
+        }
+
+        auto box = std::make_shared<LayoutBox>();
+        box->setDisplay(Display::Inline);
+        for (const auto& entry : kTagDisplays) {
+            if (tag.name == entry.tag) box->setDisplay(entry.display);
+        }
+        applyRules(tag.name, *box);
+        auto classes = tag.attributes.find("class");
+        if (classes != tag.attributes.end()) {
+            for (const std::string& name : words(classes->second)) applyRules("." + name, *box);
+        }
+        auto style = tag.attributes.find("style");
+        if (style != tag.attributes.end()) applyDeclarations(parseDeclarations(style->second), *box);
+
+        LayoutNode* node = addNode(box);
+        if (tag.name == "img" || tag.name == "input") {
+            // Replaced content of the size its attributes give
+            box->setIsReplaced(true);
+            double width = tag.attributes.count("width") ? parseLength(tag.attributes.at("width")) : 0;
+            double height = tag.attributes.count("height") ? parseLength(tag.attributes.at("height")) : 0;
+            node->setIntrinsicSize(layout::Size(width ? width : 150, height ? height : 24));
+        }
+        if (!isVoid) open_.push_back({tag.name, node});
+    }
+
+    void closeElement(const std::string& name) {
+        if (skipDepth_ > 0) {
+            if (!skipped_.empty() && skipped_.back() == name) {
+                skipped_.pop_back();
+                --skipDepth_;
+            }
+            return;
+        }
+        // Closes everything opened since name, as unclosed <p> and <li> are
+        auto open = std::find_if(open_.rbegin(), open_.rend(), [&](const auto& entry) { return entry.first == name; });
+        if (open == open_.rend()) return;
+        open_.erase(std::next(open).base(), open_.end());
+    }
+
+    void addText(const std::string& raw) {
+        if (skipDepth_ > 0) return;
+        std::string text = decodeText(raw);
+        if (text.empty() || text == " ") return;
+        auto box = std::make_shared<LayoutBox>();
+        box->setDisplay(Display::Inline);
+        addNode(box)->setTextContent(text);
+    }
+
+    std::unique_ptr<LayoutTree> finish() {
+        if (!tree_->root()) {
+            auto box = std::make_shared<LayoutBox>();
+            box->setDisplay(Display::Block);
+            addNode(box);
+        }
+        return std::move(tree_);
+    }
+
+private:
+    const StyleSheet& sheet_;
+    std::unique_ptr<LayoutTree> tree_;
+    // Open elements, outermost first
+    std::vector<std::pair<std::string, LayoutNode*>> open_;
+    std::vector<std::string> skipped_;
+    size_t skipDepth_;
+
+    void applyRules(const std::string& key, LayoutBox& box) const {
+        auto rules = sheet_.find(key);
+        if (rules == sheet_.end()) return;
+        for (const Declarations& declarations : rules->second) applyDeclarations(declarations, box);
+    }
+
+    LayoutNode* addNode(std::shared_ptr<LayoutBox> box) {
+        LayoutNode* node = tree_->createNode(std::move(box));
+        if (!tree_->root()) {
+            node->box()->setIsRoot(true);
+            tree_->setRoot(node);
+        } else {
+            (open_.empty() ? tree_->root() : open_.back().second)->addChild(node);
+        }
+        return node;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<LayoutTree> buildPageTree(const std::string& html) {
+    // Style sheets apply to the whole page, wherever they appear in it
+    StyleSheet sheet;
+    for (size_t i = html.find('<'); i != std::string::npos; i = html.find('<', i)) {
+        Tag tag;
+        size_t next = parseTag(html, i, tag);
+        if (!tag.closing && tag.name == "style") {
+            size_t textEnd;
+            i = skipRawText(html, next, "style", textEnd);
+            parseStyleSheet(html.substr(next, textEnd - next), sheet);
+        } else {
+            i = next;
+        }
+    }
+
+    PageBuilder builder(sheet);
+    size_t i = 0;
+    while (i < html.size()) {
+        size_t open = html.find('<', i);
+        if (open == std::string::npos) open = html.size();
+        if (open > i) builder.addText(html.substr(i, open - i));
+        if (open == html.size()) break;
+
+        if (html.compare(open, 4, "<!--") == 0) {
+            size_t end = html.find("-->", open + 4);
+            i = end == std::string::npos ? html.size() : end + 3;
+            continue;
+        }
+        if (html.compare(open, 2, "<!") == 0 || html.compare(open, 2, "<?") == 0) {
+            size_t end = html.find('>', open);
+            i = end == std::string::npos ? html.size() : end + 1;
+            continue;
+        }
+
+        Tag tag;
+        i = parseTag(html, open, tag);
+        if (tag.closing) {
+            builder.closeElement(tag.name);
+            continue;
+        }
+        builder.openElement(tag);
+        if (contains(kRawTextElements, tag.name)) {
+            size_t textEnd;
+            i = skipRawText(html, i, tag.name, textEnd);
+            builder.closeElement(tag.name);
+        }
+    }
+    return builder.finish();
+}
+
+std::unique_ptr<LayoutTree> loadPageTree(const std::string& path, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open file";
+        return nullptr;
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return buildPageTree(contents.str());
+}
+
+} // namespace bench
+} // namespace apollo
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "layout/layout_node.h"
+#include <memory>
+#include <string>
+
+namespace apollo {
+namespace bench {
+
+// Layout trees of HTML pages, for benchmarking without the Rust front end
+//
+// Elements become boxes and text becomes inline runs; head, script and
+// style content is dropped. Boxes get the display their tag has by default,
+// overridden by the page's <style> rules and style attributes, of which
+// display, position, z-index, opacity, margin, padding and border widths
+// are read. A rule applies when the last simple selector of one of its
+// selectors names a tag or a class of the element; other selectors,
+// cascade order beyond source order and inheritance are ignored, which is
+// close enough for timing layout and paint.
+
+std::unique_ptr<layout::LayoutTree> buildPageTree(const std::string& html);
+// nullptr with error set when path cannot be read
+std::unique_ptr<layout::LayoutTree> loadPageTree(const std::string& path, std::string& error);
+
+} // namespace bench
+} // namespace apollo
@@ -0,0 +1,454 @@
+// render_bench: times whole frames of real pages through layout, display
+// list painting and software raster, at several viewport sizes.
+//
+//   render_bench [--filter=<substring>] [--min-time=<seconds>] [--min-frames=<n>]
+//                [--threads=<n>] [--page=<file.html|file.lytc>]... [--viewport=<w>x<h>]...
+//                [--out=<file.json>] [--baseline=<file.json>] [--tolerance=<fraction>]
+//                [--save-captures=<dir>]
+//
+// A frame lays the page's tree out from scratch, snapshots it, paints the
+// snapshot into a display list and rasterizes every tile of the viewport.
+// Without --page the pages of test_data and demo.html are run. Results go
+// to stdout as a table and, with --out, to a JSON file in the layout of
+// Google Benchmark's --benchmark_out. With --baseline the run fails when a
+// benchmark's median frame is more than tolerance slower than in that
+// file, so CI catches regressions; it runs headless either way.
+//
+// Pages may also be layout captures (see layout_capture.h), which load
+// without parsing or styling; --save-captures writes one per page given,
+// named after it, to replay elsewhere.
+
+#include "page_tree.h"
+#include "layout/layout_capture.h"
+#include "layout/layout_engine.h"
+#include "layout/layout_node.h"
+#include "layout/layout_snapshot.h"
+#include "renderer/canvas.h"
+#include "renderer/display_list.h"
+#include "renderer/software.h"
+#include "apollo/json_string.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define RENDER_BENCH_RUSAGE 1
+#else
+#define RENDER_BENCH_RUSAGE 0
+#endif
+
+#ifndef RENDER_BENCH_SOURCE_DIR
+#define RENDER_BENCH_SOURCE_DIR "."
+#endif
+
+// Every allocation of the process is counted, so allocations per frame
+// include those of the libraries under test
+namespace {
+std::atomic<uint64_t> allocationCount{0};
+}
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    if (void* p = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Fewer frames than this make the p99 meaningless
+constexpr size_t kDefaultMinFrames = 100;
+// Frames run before timing, to warm the caches
+constexpr size_t kWarmupFrames = 3;
+
+struct Viewport {
+    int width;
+    int height;
+};
+
+struct Options {
+    std::string filter;
+    double minTime = 1.0;
+    size_t minFrames = kDefaultMinFrames;
+    size_t threads = 0;
+    std::vector<std::string> pages;
+    std::vector<Viewport> viewports;
+    std::string out;
+    std::string baseline;
+    double tolerance = 0.10;
+    std::string saveCaptures;
+};
+
+struct Result {
+    std::string name;
+    size_t nodes;
+    size_t items;
+    size_t frames;
+    double fps;
+    double p50Ms;
+    double p99Ms;
+    double layoutMs;
+    double paintMs;
+    double rasterMs;
+    double allocationsPerFrame;
+    long peakRssKb;
+};
+
+long peakRssKb() {
+#if RENDER_BENCH_RUSAGE
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+double elapsedMs(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Painting
+
+// Backgrounds by depth, so nested boxes show and cover the viewport
+const renderer::Color kBackgrounds[] = {
+    renderer::Color(250, 250, 250, 255), renderer::Color(232, 240, 254, 255), renderer::Color(254, 243, 232, 255),
+    renderer::Color(232, 254, 240, 255), renderer::Color(250, 232, 254, 255), renderer::Color(240, 240, 232, 255),
+};
+
+renderer::Rect toRenderer(const layout::Rect& rect) {
+    return renderer::Rect(rect.x, rect.y, rect.width, rect.height);
+}
+
+// Paints boxes in paint order: background, border, then text, culled to
+// the viewport as a compositor's tiles would be
+std::shared_ptr<const renderer::DisplayList> paintSnapshot(const layout::LayoutSnapshot& snapshot,
+                                                           const Viewport& viewport) {
+    renderer::Canvas canvas;
+    canvas.beginRecording();
+    canvas.drawColor(renderer::Color(255, 255, 255, 255));
+    layout::Rect visible(0, 0, viewport.width, viewport.height);
+
+    renderer::Paint fill;
+    renderer::Paint border;
+    border.setStyle(renderer::PaintStyle::Stroke);
+    border.setColor(renderer::Color(120, 120, 140, 255));
+    renderer::Paint text;
+    text.setColor(renderer::Color(20, 20, 20, 255));
+    text.setTextSize(16);
+
+    std::vector<size_t> depth(snapshot.size(), 0);
+    for (const auto& entry : snapshot.paintOrder()) {
+        const layout::LayoutSnapshot::Node& node = snapshot.node(entry.node);
+        if (node.parent != layout::LayoutSnapshot::kNone) depth[entry.node] = depth[node.parent] + 1;
+        if (!node.hasBox || node.style.display == layout::Display::None ||
+            node.style.visibility != layout::Visibility::Visible) {
+            continue;
+        }
+        if (!node.absoluteRect.intersects(visible)) continue;
+
+        renderer::Rect rect = toRenderer(node.absoluteRect);
+        double opacity = node.style.opacity;
+        if (node.text != layout::LayoutSnapshot::kNone) {
+            text.setOpacity(opacity);
+            canvas.drawText(snapshot.texts()[node.text].content, rect.x(), rect.y() + node.baseline, text);
+            continue;
+        }
+        if (node.style.display == layout::Display::Inline) continue;
+
+        fill.setColor(kBackgrounds[depth[entry.node] % (sizeof(kBackgrounds) / sizeof(kBackgrounds[0]))]);
+        fill.setOpacity(opacity);
+        canvas.drawRect(rect, fill);
+        const layout::EdgeInsets& edges = node.style.border;
+        double width = std::max(std::max(edges.top, edges.bottom), std::max(edges.left, edges.right));
+        if (width > 0) {
+            border.setStrokeWidth(width);
+            border.setOpacity(opacity);
+            canvas.drawRect(renderer::Rect(rect.x() + width / 2, rect.y() + width / 2, rect.width() - width,
+                                           rect.height() - width),
+                            border);
+        }
+    }
+    return canvas.finishRecording();
+}
+
+// Measurement
+
+Result runPage(const std::string& name, const layout::LayoutTree& page, const Viewport& viewport,
+               const Options& options) {
+    layout::LayoutEngine engine;
+    engine.setTree(page.clone());
+    engine.setViewport(layout::Rect(0, 0, viewport.width, viewport.height));
+    renderer::SoftwareRasterizer rasterizer(viewport.width, viewport.height, options.threads);
+
+    std::vector<double> frames;
+    double layoutTotal = 0, paintTotal = 0, rasterTotal = 0;
+    uint64_t allocations = 0;
+    size_t items = 0;
+    for (size_t i = 0; frames.size() < options.minFrames || layoutTotal + paintTotal + rasterTotal <
+                                                                options.minTime * 1e3; ++i) {
+        uint64_t before = allocationCount.load(std::memory_order_relaxed);
+        Clock::time_point start = Clock::now();
+        engine.invalidateLayout();
+        engine.layout();
+        std::shared_ptr<const layout::LayoutSnapshot> snapshot = engine.tree()->snapshot();
+        Clock::time_point laidOut = Clock::now();
+        std::shared_ptr<const renderer::DisplayList> list = paintSnapshot(*snapshot, viewport);
+        Clock::time_point painted = Clock::now();
+        rasterizer.invalidateAll();
+        rasterizer.rasterize(*list);
+        Clock::time_point rastered = Clock::now();
+        uint64_t after = allocationCount.load(std::memory_order_relaxed);
+
+        items = list->size();
+        if (i < kWarmupFrames) continue;
+        frames.push_back(elapsedMs(start, rastered));
+        layoutTotal += elapsedMs(start, laidOut);
+        paintTotal += elapsedMs(laidOut, painted);
+        rasterTotal += elapsedMs(painted, rastered);
+        allocations += after - before;
+    }
+
+    double total = layoutTotal + paintTotal + rasterTotal;
+    size_t count = frames.size();
+    std::sort(frames.begin(), frames.end());
+    Result result;
+    result.name = name + "/" + std::to_string(viewport.width) + "x" + std::to_string(viewport.height);
+    result.nodes = page.nodeCount();
+    result.items = items;
+    result.frames = count;
+    result.fps = count / (total / 1e3);
+    result.p50Ms = frames[count / 2];
+    result.p99Ms = frames[std::min(count - 1, count * 99 / 100)];
+    result.layoutMs = layoutTotal / count;
+    result.paintMs = paintTotal / count;
+    result.rasterMs = rasterTotal / count;
+    result.allocationsPerFrame = static_cast<double>(allocations) / count;
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+// Output
+
+std::string resultsJson(const std::vector<Result>& results, const Options& options) {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    std::ostringstream out;
+    out << "{\n  \"context\": {\"date\": \"" << date << "\", \"library\": \"renderer\""
+        << ", \"num_cpus\": " << std::thread::hardware_concurrency() << ", \"threads\": " << options.threads
+        << "},\n"
+        << "  \"benchmarks\": [";
+    // One benchmark per line, which --baseline relies on
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        apollo::appendJsonString(out, result.name);
+        double meanNs = 1e9 / result.fps;
+        out << ", \"run_type\": \"iteration\", \"iterations\": " << result.frames << ", \"real_time\": " << meanNs
+            << ", \"cpu_time\": " << meanNs << ", \"time_unit\": \"ns\", \"nodes\": " << result.nodes
+            << ", \"items\": " << result.items << ", \"fps\": " << result.fps << ", \"p50_ms\": " << result.p50Ms
+            << ", \"p99_ms\": " << result.p99Ms << ", \"layout_ms\": " << result.layoutMs
+            << ", \"paint_ms\": " << result.paintMs << ", \"raster_ms\": " << result.rasterMs
+            << ", \"allocations_per_frame\": " << result.allocationsPerFrame
+            << ", \"peak_rss_kb\": " << result.peakRssKb << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+void printTable(const std::vector<Result>& results) {
+    std::printf("%-32s %7s %7s %9s %9s %9s %9s %9s %9s %11s %11s\n", "benchmark", "nodes", "frames", "fps",
+                "p50 (ms)", "p99 (ms)", "layout", "paint", "raster", "allocs/frm", "rss (KiB)");
+    for (const Result& result : results) {
+        std::printf("%-32s %7zu %7zu %9.1f %9.3f %9.3f %9.3f %9.3f %9.3f %11.1f %11ld\n", result.name.c_str(),
+                    result.nodes, result.frames, result.fps, result.p50Ms, result.p99Ms, result.layoutMs,
+                    result.paintMs, result.rasterMs, result.allocationsPerFrame, result.peakRssKb);
+    }
+}
+
+// Median frame times by benchmark name from a file resultsJson() wrote
+bool readBaseline(const std::string& path, std::map<std::string, double>& medians) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t name = line.find("{\"name\": \"");
+        size_t p50 = line.find("\"p50_ms\": ");
+        if (name == std::string::npos || p50 == std::string::npos) continue;
+        name += 10;
+        size_t end = line.find('"', name);
+        if (end == std::string::npos) continue;
+        medians[line.substr(name, end - name)] = std::atof(line.c_str() + p50 + 10);
+    }
+    return true;
+}
+
+bool parseViewport(const char* text, Viewport& viewport) {
+    return std::sscanf(text, "%dx%d", &viewport.width, &viewport.height) == 2 && viewport.width > 0 &&
+           viewport.height > 0;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* flag) -> const char* {
+            size_t length = std::char_traits<char>::length(flag);
+            return arg.compare(0, length, flag) == 0 ? arg.c_str() + length : nullptr;
+        };
+
+        Viewport viewport;
+        if (const char* v = value("--filter=")) {
+            options.filter = v;
+        } else if (const char* v = value("--min-time=")) {
+            options.minTime = std::atof(v);
+        } else if (const char* v = value("--min-frames=")) {
+            options.minFrames = std::max<size_t>(1, std::strtoul(v, nullptr, 10));
+        } else if (const char* v = value("--threads=")) {
+            options.threads = std::strtoul(v, nullptr, 10);
+        } else if (const char* v = value("--page=")) {
+            options.pages.push_back(v);
+        } else if (const char* v = value("--viewport="); v && parseViewport(v, viewport)) {
+            options.viewports.push_back(viewport);
+        } else if (const char* v = value("--out=")) {
+            options.out = v;
+        } else if (const char* v = value("--baseline=")) {
+            options.baseline = v;
+        } else if (const char* v = value("--tolerance=")) {
+            options.tolerance = std::atof(v);
+        } else if (const char* v = value("--save-captures=")) {
+            options.saveCaptures = v;
+        } else {
+            std::cerr << "render_bench: unknown argument " << arg << "\n"
+                      << "usage: render_bench [--filter=<substring>] [--min-time=<seconds>] [--min-frames=<n>]\n"
+                      << "                    [--threads=<n>] [--page=<file.html|file.lytc>]... [--viewport=<w>x<h>]...\n"
+                      << "                    [--out=<file.json>] [--baseline=<file.json>] [--tolerance=<fraction>]\n"
+                      << "                    [--save-captures=<dir>]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 2;
+    if (options.pages.empty()) {
+        options.pages = {RENDER_BENCH_SOURCE_DIR "/test_data/sample.html", RENDER_BENCH_SOURCE_DIR "/demo.html"};
+    }
+    if (options.viewports.empty()) {
+        // Phone, laptop and desktop
+        options.viewports = {{375, 667}, {1280, 800}, {1920, 1080}};
+    }
+
+    std::vector<Result> results;
+    for (const std::string& path : options.pages) {
+        std::string error;
+        std::unique_ptr<layout::LayoutTree> page = layout::isLayoutCaptureFile(path)
+                                                       ? layout::loadLayoutTree(path, error)
+                                                       : apollo::bench::loadPageTree(path, error);
+        if (!page) {
+            std::cerr << "render_bench: " << path << ": " << error << "\n";
+            return 1;
+        }
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        if (!options.saveCaptures.empty()) {
+            std::string capture = options.saveCaptures + "/" + name.substr(0, name.find_last_of('.')) + ".lytc";
+            if (!layout::saveLayoutTree(*page, capture, error)) {
+                std::cerr << "render_bench: " << capture << ": " << error << "\n";
+                return 1;
+            }
+        }
+        for (const Viewport& viewport : options.viewports) {
+            std::string full = name + "/" + std::to_string(viewport.width) + "x" + std::to_string(viewport.height);
+            if (!options.filter.empty() && full.find(options.filter) == std::string::npos) continue;
+            results.push_back(runPage(name, *page, viewport, options));
+        }
+    }
+
+    printTable(results);
+    if (!options.out.empty()) {
+        std::ofstream out(options.out);
+        out << resultsJson(results, options);
+        if (!out) {
+            std::cerr << "render_bench: cannot write " << options.out << "\n";
+            return 1;
+        }
+    }
+
+    if (!options.baseline.empty()) {
+        std::map<std::string, double> medians;
+        if (!readBaseline(options.baseline, medians)) {
+            std::cerr << "render_bench: cannot read " << options.baseline << "\n";
+            return 1;
+        }
+        bool regressed = false;
+        for (const Result& result : results) {
+            auto baseline = medians.find(result.name);
+            if (baseline == medians.end() || baseline->second <= 0) continue;
+            double change = result.p50Ms / baseline->second - 1;
+            if (change > options.tolerance) {
+                std::printf("REGRESSION %s: p50 %.3f ms, baseline %.3f ms (%+.1f%%)\n", result.name.c_str(),
+                            result.p50Ms, baseline->second, change * 100);
+                regressed = true;
+            }
+        }
+        if (regressed) return 3;
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+// tokenizer_bench: times js::Tokenizer over whole scripts, in MB/s, with
+// each scan kernel this CPU runs.
+//
+//   tokenizer_bench [--bundle=<file.js>]... [--isa=<scalar|sse2|avx2|neon>]...
+//                   [--min-time=<seconds>]
+//
+// A pass tokenizes the script from the first byte to end of file, comments
+// included. Without --bundle the inline scripts of test_data and demo.html
+// are run, as written and with indentation and blank lines stripped, each
+// repeated to about a megabyte so a pass is long enough to time; real
+// bundles given with --bundle run as they are. Without --isa every kernel
+// the CPU supports is run, scalar first, so the speedup reads off the table.
+
+#include "js/source_scan.h"
+#include "js/tokenizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef TOKENIZER_BENCH_SOURCE_DIR
+#define TOKENIZER_BENCH_SOURCE_DIR "."
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Built-in scripts are repeated up to this size
+constexpr size_t kDefaultBundleBytes = 1 << 20;
+// Passes run before timing, to warm the caches
+constexpr size_t kWarmupPasses = 2;
+
+struct Bundle {
+    std::string name;
+    std::string source;
+};
+
+struct Options {
+    std::vector<std::string> bundles;
+    std::vector<js::ScanIsa> isas;
+    double minTime = 0.5;
+};
+
+struct Result {
+    std::string name;
+    size_t bytes;
+    size_t tokens;
+    size_t passes;
+    double mbPerSecond;
+};
+
+const char* isaName(js::ScanIsa isa) {
+    switch (isa) {
+        case js::ScanIsa::SSE2: return "sse2";
+        case js::ScanIsa::AVX2: return "avx2";
+        case js::ScanIsa::NEON: return "neon";
+        default: return "scalar";
+    }
+}
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+// The bodies of the page's inline <script> elements, one after another
+std::string inlineScripts(const std::string& html) {
+    std::string scripts;
+    size_t position = 0;
+    while ((position = html.find("<script", position)) != std::string::npos) {
+        size_t open = html.find('>', position);
+        if (open == std::string::npos) break;
+        size_t close = html.find("</script>", open);
+        if (close == std::string::npos) break;
+        scripts.append(html, open + 1, close - open - 1);
+        scripts += '\n';
+        position = close;
+    }
+    return scripts;
+}
+
+// Leading whitespace and blank lines dropped, as a whitespace-only minifier
+// leaves a script
+std::string stripIndentation(const std::string& source) {
+    std::string stripped;
+    stripped.reserve(source.size());
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) continue;
+        stripped.append(line, first, std::string::npos);
+        stripped += '\n';
+    }
+    return stripped;
+}
+
+std::string repeatTo(const std::string& source, size_t bytes) {
+    std::string repeated;
+    if (source.empty()) return repeated;
+    repeated.reserve(bytes + source.size());
+    while (repeated.size() < bytes) {
+        repeated += source;
+    }
+    return repeated;
+}
+
+size_t tokenizeOnce(js::Tokenizer& tokenizer, const std::string& source) {
+    tokenizer.setSource(source);
+    size_t tokens = 0;
+    while (!tokenizer.nextToken().isEndOfFile()) {
+        ++tokens;
+    }
+    return tokens;
+}
+
+Result runBundle(const Bundle& bundle, js::ScanIsa isa, const Options& options) {
+    js::Tokenizer tokenizer;
+    size_t tokens = 0;
+    for (size_t i = 0; i < kWarmupPasses; ++i) {
+        tokens = tokenizeOnce(tokenizer, bundle.source);
+    }
+
+    size_t passes = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+        tokenizeOnce(tokenizer, bundle.source);
+        ++passes;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < options.minTime);
+
+    Result result;
+    result.name = bundle.name + "/" + isaName(isa);
+    result.bytes = bundle.source.size();
+    result.tokens = tokens;
+    result.passes = passes;
+    result.mbPerSecond = static_cast<double>(bundle.source.size()) * passes / elapsed / 1e6;
+    return result;
+}
+
+void printTable(const std::vector<Result>& results) {
+    std::printf("%-40s %11s %9s %7s %9s\n", "benchmark", "bytes", "tokens", "passes", "MB/s");
+    for (const Result& result : results) {
+        std::printf("%-40s %11zu %9zu %7zu %9.1f\n", result.name.c_str(), result.bytes, result.tokens, result.passes,
+                    result.mbPerSecond);
+    }
+}
+
+bool parseIsa(const char* text, js::ScanIsa& isa) {
+    for (js::ScanIsa candidate : {js::ScanIsa::Scalar, js::ScanIsa::SSE2, js::ScanIsa::AVX2, js::ScanIsa::NEON}) {
+        if (std::string(text) == isaName(candidate)) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* flag) -> const char* {
+            size_t length = std::char_traits<char>::length(flag);
+            return arg.compare(0, length, flag) == 0 ? arg.c_str() + length : nullptr;
+        };
+
+        js::ScanIsa isa;
+        if (const char* v = value("--bundle=")) {
+            options.bundles.push_back(v);
+        } else if (const char* v = value("--isa="); v && parseIsa(v, isa)) {
+            options.isas.push_back(isa);
+        } else if (const char* v = value("--min-time=")) {
+            options.minTime = std::atof(v);
+        } else {
+            std::cerr << "tokenizer_bench: unknown argument " << arg << "\n"
+                      << "usage: tokenizer_bench [--bundle=<file.js>]... [--isa=<scalar|sse2|avx2|neon>]...\n"
+                      << "                       [--min-time=<seconds>]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 2;
+    if (options.isas.empty()) {
+        options.isas = {js::ScanIsa::Scalar, js::ScanIsa::SSE2, js::ScanIsa::AVX2, js::ScanIsa::NEON};
+    }
+
+    std::vector<Bundle> bundles;
+    if (options.bundles.empty()) {
+        for (const char* page : {TOKENIZER_BENCH_SOURCE_DIR "/test_data/sample.html",
+                                 TOKENIZER_BENCH_SOURCE_DIR "/demo.html"}) {
+            std::string html;
+            if (!readFile(page, html)) {
+                std::cerr << "tokenizer_bench: cannot read " << page << "\n";
+                return 1;
+            }
+            std::string name(page);
+            name = name.substr(name.find_last_of('/') + 1);
+            std::string scripts = inlineScripts(html);
+            bundles.push_back({name, repeatTo(scripts, kDefaultBundleBytes)});
+            bundles.push_back({name + "-stripped", repeatTo(stripIndentation(scripts), kDefaultBundleBytes)});
+        }
+    } else {
+        for (const std::string& path : options.bundles) {
+            Bundle bundle;
+            if (!readFile(path, bundle.source)) {
+                std::cerr << "tokenizer_bench: cannot read " << path << "\n";
+                return 1;
+            }
+            bundle.name = path.substr(path.find_last_of('/') + 1);
+            bundles.push_back(std::move(bundle));
+        }
+    }
+
+    std::vector<Result> results;
+    for (const Bundle& bundle : bundles) {
+        if (bundle.source.empty()) continue;
+        for (js::ScanIsa isa : options.isas) {
+            // Sets this CPU cannot run are left out
+            if (!js::setScanIsa(isa)) continue;
+            results.push_back(runBundle(bundle, isa, options));
+        }
+    }
+    js::setScanIsa(js::bestScanIsa());
+
+    printTable(results);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+namespace apollo {
+
+// Writes value as a quoted JSON string. Quotes, backslashes and control
+// characters are escaped; other bytes, UTF-8 included, pass through.
+inline void appendJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                    out << escaped;
+                } else {
+                    out << c;
+                }
+                break;
+        }
+    }
+    out << '"';
+}
+
+} // namespace apollo
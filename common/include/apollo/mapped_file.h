@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define APOLLO_MAPPED_FILE_MMAP 1
+#else
+#define APOLLO_MAPPED_FILE_MMAP 0
+#endif
+
+namespace apollo {
+
+// Read-only view of a whole file, memory-mapped where the platform allows
+// and read into memory elsewhere; data() is null when the file could not
+// be opened or is empty
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : data_(nullptr), size_(0), buffer_() {
+#if APOLLO_MAPPED_FILE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data_ = static_cast<const uint8_t*>(mapped);
+                size_ = static_cast<size_t>(info.st_size);
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (in) {
+            buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            if (!buffer_.empty()) {
+                data_ = buffer_.data();
+                size_ = buffer_.size();
+            }
+        }
+#endif
+    }
+
+    ~MappedFile() {
+#if APOLLO_MAPPED_FILE_MMAP
+        if (data_) {
+            ::munmap(const_cast<uint8_t*>(data_), size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    std::vector<uint8_t> buffer_;
+};
+
+} // namespace apollo
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace js {
+
+// Bump allocator for data that dies all at once
+//
+// Memory is carved out of large chunks and only returned when the arena is
+// reset or destroyed; deallocation of individual blocks is a no-op. Code
+// that wants its allocations to come from an arena without threading it
+// through every call installs it with an Arena::Scope.
+class Arena {
+public:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    Arena();
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    // Releases every chunk but the first
+    void reset();
+
+    // Statistics
+    size_t getBytesAllocated() const { return bytesAllocated_; }
+    size_t getBytesReserved() const { return bytesReserved_; }
+    size_t getChunkCount() const { return chunks_.size(); }
+    // Reserved by every live arena in the process
+    static size_t getTotalBytesReserved();
+
+    // Arena of the innermost Scope on this thread, or nullptr
+    static Arena* current();
+
+    class Scope {
+    public:
+        explicit Scope(Arena* arena);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Arena* previous_;
+    };
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> memory;
+        size_t capacity;
+    };
+
+    std::vector<Chunk> chunks_;
+    char* cursor_;
+    char* limit_;
+    size_t bytesAllocated_;
+    size_t bytesReserved_;
+
+    void addChunk(size_t minimum);
+};
+
+// Standard allocator that draws from the arena current at construction,
+// falling back to the heap when there is none
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() : arena_(Arena::current()) {}
+    explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(size_t count) {
+        if (arena_) {
+            return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+        }
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        if (!arena_) {
+            std::allocator<T>().deallocate(pointer, count);
+        }
+    }
+
+    Arena* arena() const { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena(); }
+
+private:
+    Arena* arena_;
+};
+
+} // namespace js
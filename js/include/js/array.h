@@ -1,23 +1,86 @@
 #pragma once
 
-#include "js/value.h"
-#include <vector>
+#include "value.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 
 namespace js {
 
-class Array : public Value {
+// Fixed-length, zero-initialised byte storage shared by typed array views
+class ArrayBuffer : public Object {
 public:
-    Array();
-    ~Array();
+    explicit ArrayBuffer(size_t byteLength);
+    virtual ~ArrayBuffer() = default;
 
-    void push(std::shared_ptr<Value> value);
-    std::shared_ptr<Value> get(size_t index) const;
-    void set(size_t index, std::shared_ptr<Value> value);
-    size_t length() const;
-    void clear();
+    uint8_t* data() { return data_.get(); }
+    const uint8_t* data() const { return data_.get(); }
+    size_t byteLength() const { return byteLength_; }
+
+    // Type conversion
+    std::string toString() const override;
+
+private:
+    std::unique_ptr<uint8_t[]> data_;
+    size_t byteLength_;
+};
+
+enum class TypedArrayKind : uint8_t { Uint8, Float64 };
+
+// View of an ArrayBuffer as contiguous numbers (Uint8Array, Float64Array)
+//
+// Elements are read and written straight from the buffer: out-of-range
+// reads give undefined and out-of-range writes are dropped, as in JS.
+class TypedArray : public Object {
+public:
+    // byteOffset must be aligned to the element size and the view must fit
+    // in the buffer; the JS constructors check this before calling
+    TypedArray(TypedArrayKind kind, ArrayBuffer* buffer, size_t byteOffset, size_t length);
+    virtual ~TypedArray() = default;
+
+    static size_t elementSize(TypedArrayKind kind) { return kind == TypedArrayKind::Float64 ? 8 : 1; }
+    static const char* className(TypedArrayKind kind);
+
+    TypedArrayKind kind() const { return kind_; }
+    ArrayBuffer* buffer() const { return buffer_; }
+    size_t byteOffset() const { return byteOffset_; }
+    size_t length() const { return length_; }
+    size_t byteLength() const { return length_ * elementSize(kind_); }
+
+    JSValue at(size_t index) const {
+        if (index >= length_) {
+            return JSValue::undefined();
+        }
+        if (kind_ == TypedArrayKind::Float64) {
+            return JSValue::fromDouble(float64Data()[index]);
+        }
+        return JSValue::int32(uint8Data()[index]);
+    }
+    void put(size_t index, JSValue value) {
+        if (index >= length_) {
+            return;
+        }
+        if (kind_ == TypedArrayKind::Float64) {
+            float64Data()[index] = value.toNumber();
+        } else {
+            uint8Data()[index] = static_cast<uint8_t>(value.toUint32());
+        }
+    }
+
+    double* float64Data() const { return reinterpret_cast<double*>(buffer_->data() + byteOffset_); }
+    uint8_t* uint8Data() const { return buffer_->data() + byteOffset_; }
+
+    // Type conversion
+    std::string toString() const override;
+
+    // Garbage collection
+    void traceChildren(GC& gc) const override;
 
 private:
-    std::vector<std::shared_ptr<Value>> elements;
+    TypedArrayKind kind_;
+    ArrayBuffer* buffer_;
+    size_t byteOffset_;
+    size_t length_;
 };
 
 } // namespace js
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "types.h"
+#include "arena.h"
 #include "tokenizer.h"
 #include <memory>
 #include <vector>
@@ -9,6 +10,11 @@
 
 namespace js {
 
+// Child node lists; while an Arena::Scope is active their storage comes
+// from its arena, like the nodes themselves
+template <typename T>
+using NodeList = std::vector<std::unique_ptr<T>, ArenaAllocator<std::unique_ptr<T>>>;
+
 // Forward declarations
 class Node;
 class Statement;
@@ -69,6 +75,16 @@ class ImportDeclaration;
 class ExportDeclaration;
 class Program;
 class Module;
+class StringLiteral;
+class NumericLiteral;
+class BooleanLiteral;
+class NullLiteral;
+class UndefinedLiteral;
+class ExpressionStatement;
+class VariableStatement;
+class FunctionStatement;
+class DebuggerStatement;
+class VariableDeclarator;
 
 // Base AST node
 class Node {
@@ -86,6 +102,12 @@ public:
     bool operator==(const Node& other) const;
     bool operator!=(const Node& other) const { return !(*this == other); }
 
+    // Nodes created while an Arena::Scope is active live in its arena and
+    // deleting them only runs the destructor; ownership through
+    // std::unique_ptr works the same either way
+    static void* operator new(size_t size);
+    static void operator delete(void* memory);
+
 protected:
     NodeType type_;
     TokenPosition position_;
@@ -159,56 +181,107 @@ protected:
 class Parameter : public Node {
 public:
     Parameter(const TokenPosition& position);
+    Parameter(std::unique_ptr<Identifier> name, const TokenPosition& position);
     virtual ~Parameter() = default;
 
+    Identifier* name() const { return name_.get(); }
+    void setName(std::unique_ptr<Identifier> name) { name_ = std::move(name); }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Identifier> name_;
 };
 
 // Property node
 class Property : public Node {
 public:
     Property(PropertyType type, const TokenPosition& position);
+    Property(std::unique_ptr<Expression> key, std::unique_ptr<Expression> value, bool computed, const TokenPosition& position);
     virtual ~Property() = default;
 
     PropertyType propertyType() const { return propertyType_; }
     void setPropertyType(PropertyType type) { propertyType_ = type; }
 
+    Expression* key() const { return key_.get(); }
+    void setKey(std::unique_ptr<Expression> key) { key_ = std::move(key); }
+
+    Expression* value() const { return value_.get(); }
+    void setValue(std::unique_ptr<Expression> value) { value_ = std::move(value); }
+
+    bool computed() const { return computed_; }
+    void setComputed(bool computed) { computed_ = computed; }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 protected:
     PropertyType propertyType_;
+    std::unique_ptr<Expression> key_;
+    std::unique_ptr<Expression> value_;
+    bool computed_;
 };
 
 // Element node
 class Element : public Node {
 public:
     Element(const TokenPosition& position);
+    Element(std::unique_ptr<Expression> expression, const TokenPosition& position);
     virtual ~Element() = default;
 
+    Expression* expression() const { return expression_.get(); }
+    void setExpression(std::unique_ptr<Expression> expression) { expression_ = std::move(expression); }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Expression> expression_;
 };
 
 // Case clause node
 class CaseClause : public Node {
 public:
     CaseClause(const TokenPosition& position);
+    CaseClause(std::unique_ptr<Expression> test, NodeList<Statement> consequent, const TokenPosition& position);
     virtual ~CaseClause() = default;
 
+    // Null test means this is the default clause
+    Expression* test() const { return test_.get(); }
+    void setTest(std::unique_ptr<Expression> test) { test_ = std::move(test); }
+
+    const NodeList<Statement>& consequent() const { return consequent_; }
+    void setConsequent(NodeList<Statement> consequent) { consequent_ = std::move(consequent); }
+    NodeList<Statement> releaseConsequent() { return std::move(consequent_); }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Expression> test_;
+    NodeList<Statement> consequent_;
 };
 
 // Catch clause node
 class CatchClause : public Node {
 public:
     CatchClause(const TokenPosition& position);
+    CatchClause(std::unique_ptr<Identifier> param, std::unique_ptr<BlockStatement> body, const TokenPosition& position);
     virtual ~CatchClause() = default;
 
+    Identifier* param() const { return param_.get(); }
+    void setParam(std::unique_ptr<Identifier> param) { param_ = std::move(param); }
+
+    BlockStatement* body() const { return body_.get(); }
+    void setBody(std::unique_ptr<BlockStatement> body) { body_ = std::move(body); }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Identifier> param_;
+    std::unique_ptr<BlockStatement> body_;
 };
 
 // Import specifier node
@@ -237,8 +310,15 @@ public:
     TemplateElement(const TokenPosition& position);
     virtual ~TemplateElement() = default;
 
+    // Text with escapes applied
+    const std::string& cooked() const { return cooked_; }
+    void setCooked(std::string cooked) { cooked_ = std::move(cooked); }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::string cooked_;
 };
 
 // Meta property node
@@ -262,7 +342,7 @@ public:
 };
 
 // This expression node
-class ThisExpression : public Node {
+class ThisExpression : public Expression {
 public:
     ThisExpression(const TokenPosition& position);
     virtual ~ThisExpression() = default;
@@ -271,24 +351,40 @@ public:
     virtual void accept(ASTVisitor& visitor) override;
 };
 
-// Yield expression node
-class YieldExpression : public Node {
+// Yield expression node; delegate is set for yield*
+class YieldExpression : public Expression {
 public:
-    YieldExpression(const TokenPosition& position);
+    YieldExpression(std::unique_ptr<Expression> argument, bool delegate, const TokenPosition& position);
     virtual ~YieldExpression() = default;
 
+    Expression* argument() const { return argument_.get(); }
+    void setArgument(std::unique_ptr<Expression> argument) { argument_ = std::move(argument); }
+
+    bool delegate() const { return delegate_; }
+    void setDelegate(bool delegate) { delegate_ = delegate; }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Expression> argument_;
+    bool delegate_;
 };
 
 // Await expression node
-class AwaitExpression : public Node {
+class AwaitExpression : public Expression {
 public:
-    AwaitExpression(const TokenPosition& position);
+    AwaitExpression(std::unique_ptr<Expression> argument, const TokenPosition& position);
     virtual ~AwaitExpression() = default;
 
+    Expression* argument() const { return argument_.get(); }
+    void setArgument(std::unique_ptr<Expression> argument) { argument_ = std::move(argument); }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Expression> argument_;
 };
 
 // Identifier node
@@ -323,6 +419,71 @@ protected:
     LiteralType literalType_;
 };
 
+// String literal node
+class StringLiteral : public Literal {
+public:
+    StringLiteral(const std::string& value, const TokenPosition& position);
+    virtual ~StringLiteral() = default;
+
+    const std::string& value() const { return value_; }
+    void setValue(const std::string& value) { value_ = value; }
+
+    virtual std::string toString() const override;
+
+private:
+    std::string value_;
+};
+
+// Numeric literal node
+class NumericLiteral : public Literal {
+public:
+    NumericLiteral(const std::string& raw, const TokenPosition& position);
+    virtual ~NumericLiteral() = default;
+
+    double value() const { return value_; }
+    void setValue(double value) { value_ = value; }
+    const std::string& raw() const { return raw_; }
+
+    virtual std::string toString() const override;
+
+private:
+    std::string raw_;
+    double value_;
+};
+
+// Boolean literal node
+class BooleanLiteral : public Literal {
+public:
+    BooleanLiteral(const std::string& raw, const TokenPosition& position);
+    virtual ~BooleanLiteral() = default;
+
+    bool value() const { return value_; }
+    void setValue(bool value) { value_ = value; }
+
+    virtual std::string toString() const override;
+
+private:
+    bool value_;
+};
+
+// Null literal node
+class NullLiteral : public Literal {
+public:
+    NullLiteral(const TokenPosition& position);
+    virtual ~NullLiteral() = default;
+
+    virtual std::string toString() const override;
+};
+
+// Undefined literal node
+class UndefinedLiteral : public Literal {
+public:
+    UndefinedLiteral(const TokenPosition& position);
+    virtual ~UndefinedLiteral() = default;
+
+    virtual std::string toString() const override;
+};
+
 // Binary expression node
 class BinaryExpression : public Expression {
 public:
@@ -378,9 +539,11 @@ public:
 
     Expression* consequent() const { return consequent_.get(); }
     void setConsequent(std::unique_ptr<Expression> consequent) { consequent_ = std::move(consequent); }
+    std::unique_ptr<Expression> releaseConsequent() { return std::move(consequent_); }
 
     Expression* alternate() const { return alternate_.get(); }
     void setAlternate(std::unique_ptr<Expression> alternate) { alternate_ = std::move(alternate); }
+    std::unique_ptr<Expression> releaseAlternate() { return std::move(alternate_); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
@@ -394,21 +557,22 @@ private:
 // Call expression node
 class CallExpression : public Expression {
 public:
-    CallExpression(std::unique_ptr<Expression> callee, std::vector<std::unique_ptr<Expression>> arguments, const TokenPosition& position);
+    CallExpression(std::unique_ptr<Expression> callee, NodeList<Expression> arguments, const TokenPosition& position);
     virtual ~CallExpression() = default;
 
     Expression* callee() const { return callee_.get(); }
     void setCallee(std::unique_ptr<Expression> callee) { callee_ = std::move(callee); }
 
-    const std::vector<std::unique_ptr<Expression>>& arguments() const { return arguments_; }
-    void setArguments(std::vector<std::unique_ptr<Expression>> arguments) { arguments_ = std::move(arguments); }
+    const NodeList<Expression>& arguments() const { return arguments_; }
+    void setArguments(NodeList<Expression> arguments) { arguments_ = std::move(arguments); }
+    NodeList<Expression> releaseArguments() { return std::move(arguments_); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
     std::unique_ptr<Expression> callee_;
-    std::vector<std::unique_ptr<Expression>> arguments_;
+    NodeList<Expression> arguments_;
 };
 
 // Member expression node
@@ -438,67 +602,99 @@ private:
 // Array expression node
 class ArrayExpression : public Expression {
 public:
-    ArrayExpression(std::vector<std::unique_ptr<Element>> elements, const TokenPosition& position);
+    ArrayExpression(NodeList<Element> elements, const TokenPosition& position);
     virtual ~ArrayExpression() = default;
 
-    const std::vector<std::unique_ptr<Element>>& elements() const { return elements_; }
-    void setElements(std::vector<std::unique_ptr<Element>> elements) { elements_ = std::move(elements); }
+    const NodeList<Element>& elements() const { return elements_; }
+    void setElements(NodeList<Element> elements) { elements_ = std::move(elements); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<Element>> elements_;
+    NodeList<Element> elements_;
 };
 
 // Object expression node
 class ObjectExpression : public Expression {
 public:
-    ObjectExpression(std::vector<std::unique_ptr<Property>> properties, const TokenPosition& position);
+    ObjectExpression(NodeList<Property> properties, const TokenPosition& position);
     virtual ~ObjectExpression() = default;
 
-    const std::vector<std::unique_ptr<Property>>& properties() const { return properties_; }
-    void setProperties(std::vector<std::unique_ptr<Property>> properties) { properties_ = std::move(properties); }
+    const NodeList<Property>& properties() const { return properties_; }
+    void setProperties(NodeList<Property> properties) { properties_ = std::move(properties); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<Property>> properties_;
+    NodeList<Property> properties_;
+};
+
+// What pre-parsing recorded about a function whose body was skipped. The
+// body is parsed and compiled from source[sourceStart, sourceEnd) on the
+// function's first call.
+struct PreparseData {
+    std::shared_ptr<const std::string> source;
+    size_t sourceStart = 0;
+    size_t sourceEnd = 0;
+
+    // Identifiers the body references but does not visibly declare; a
+    // superset of the true free variables
+    std::vector<std::string> freeVariables;
+    bool usesEval = false;
+    bool usesWith = false;
+    bool usesArguments = false;
+    bool usesThis = false;
+    bool hasInnerFunctions = false;
 };
 
 // Function expression node
 class FunctionExpression : public Expression {
 public:
-    FunctionExpression(std::unique_ptr<Identifier> id, std::vector<std::unique_ptr<Parameter>> params, std::unique_ptr<BlockStatement> body, const TokenPosition& position);
+    FunctionExpression(std::unique_ptr<Identifier> id, NodeList<Parameter> params, std::unique_ptr<BlockStatement> body, const TokenPosition& position);
     virtual ~FunctionExpression() = default;
 
     Identifier* id() const { return id_.get(); }
     void setId(std::unique_ptr<Identifier> id) { id_ = std::move(id); }
 
-    const std::vector<std::unique_ptr<Parameter>>& params() const { return params_; }
-    void setParams(std::vector<std::unique_ptr<Parameter>> params) { params_ = std::move(params); }
+    const NodeList<Parameter>& params() const { return params_; }
+    void setParams(NodeList<Parameter> params) { params_ = std::move(params); }
 
     BlockStatement* body() const { return body_.get(); }
     void setBody(std::unique_ptr<BlockStatement> body) { body_ = std::move(body); }
 
+    // Set instead of a body when the parser only pre-parsed the function
+    const PreparseData* preparse() const { return preparse_.get(); }
+    void setPreparse(std::unique_ptr<PreparseData> preparse) { preparse_ = std::move(preparse); }
+    bool isLazy() const { return !body_ && preparse_; }
+
+    // function* and async function
+    bool isGenerator() const { return generator_; }
+    void setGenerator(bool generator) { generator_ = generator; }
+    bool isAsync() const { return async_; }
+    void setAsync(bool async) { async_ = async; }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
     std::unique_ptr<Identifier> id_;
-    std::vector<std::unique_ptr<Parameter>> params_;
+    NodeList<Parameter> params_;
     std::unique_ptr<BlockStatement> body_;
+    std::unique_ptr<PreparseData> preparse_;
+    bool generator_ = false;
+    bool async_ = false;
 };
 
 // Arrow function expression node
 class ArrowFunctionExpression : public Expression {
 public:
-    ArrowFunctionExpression(std::vector<std::unique_ptr<Parameter>> params, std::unique_ptr<Expression> body, const TokenPosition& position);
+    ArrowFunctionExpression(NodeList<Parameter> params, std::unique_ptr<Expression> body, const TokenPosition& position);
     virtual ~ArrowFunctionExpression() = default;
 
-    const std::vector<std::unique_ptr<Parameter>>& params() const { return params_; }
-    void setParams(std::vector<std::unique_ptr<Parameter>> params) { params_ = std::move(params); }
+    const NodeList<Parameter>& params() const { return params_; }
+    void setParams(NodeList<Parameter> params) { params_ = std::move(params); }
 
     Expression* body() const { return body_.get(); }
     void setBody(std::unique_ptr<Expression> body) { body_ = std::move(body); }
@@ -507,7 +703,7 @@ public:
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<Parameter>> params_;
+    NodeList<Parameter> params_;
     std::unique_ptr<Expression> body_;
 };
 
@@ -536,23 +732,24 @@ private:
 };
 
 // Template literal node
-class TemplateLiteral : public Expression => {
+class TemplateLiteral : public Expression {
 public:
-    TemplateLiteral(std::vector<std::unique_ptr<TemplateElement>> quasis, std::vector<std::unique_ptr<Expression>> expressions, const TokenPosition& position);
+    TemplateLiteral(NodeList<TemplateElement> quasis, NodeList<Expression> expressions, const TokenPosition& position);
     virtual ~TemplateLiteral() = default;
 
-    const std::vector<std::unique_ptr<TemplateElement>>& quasis() const { return quasis_; }
-    void setQuasis(std::vector<std::unique_ptr<TemplateElement>> quasis) { quasis_ = std::move(quasis); }
+    const NodeList<TemplateElement>& quasis() const { return quasis_; }
+    void setQuasis(NodeList<TemplateElement> quasis) { quasis_ = std::move(quasis); }
 
-    const std::vector<std::unique_ptr<Expression>>& expressions() const { return expressions_; }
-    void setExpressions(std::vector<std::unique_ptr<Expression>> expressions) { expressions_ = std::move(expressions); }
+    const NodeList<Expression>& expressions() const { return expressions_; }
+    void setExpressions(NodeList<Expression> expressions) { expressions_ = std::move(expressions); }
+    NodeList<Expression> releaseExpressions() { return std::move(expressions_); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<TemplateElement>> quasis_;
-    std::vector<std::unique_ptr<Expression>> expressions_;
+    NodeList<TemplateElement> quasis_;
+    NodeList<Expression> expressions_;
 };
 
 // Tagged template literal node
@@ -578,17 +775,18 @@ private:
 // Sequence expression node
 class SequenceExpression : public Expression {
 public:
-    SequenceExpression(std::vector<std::unique_ptr<Expression>> expressions, const TokenPosition& position);
+    SequenceExpression(NodeList<Expression> expressions, const TokenPosition& position);
     virtual ~SequenceExpression() = default;
 
-    const std::vector<std::unique_ptr<Expression>>& expressions() const { return expressions_; }
-    void setExpressions(std::vector<std::unique_ptr<Expression>> expressions) { expressions_ = std::move(expressions); }
+    const NodeList<Expression>& expressions() const { return expressions_; }
+    void setExpressions(NodeList<Expression> expressions) { expressions_ = std::move(expressions); }
+    NodeList<Expression> releaseExpressions() { return std::move(expressions_); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<Expression>> expressions_;
+    NodeList<Expression> expressions_;
 };
 
 // Assignment expression node
@@ -653,6 +851,7 @@ public:
 
     Expression* right() const { return right_.get(); }
     void setRight(std::unique_ptr<Expression> right) { right_ = std::move(right); }
+    std::unique_ptr<Expression> releaseRight() { return std::move(right_); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
@@ -666,21 +865,22 @@ private:
 // New expression node
 class NewExpression : public Expression {
 public:
-    NewExpression(std::unique_ptr<Expression> callee, std::vector<std::unique_ptr<Expression>> arguments, const TokenPosition& position);
+    NewExpression(std::unique_ptr<Expression> callee, NodeList<Expression> arguments, const TokenPosition& position);
     virtual ~NewExpression() = default;
 
     Expression* callee() const { return callee_.get(); }
     void setCallee(std::unique_ptr<Expression> callee) { callee_ = std::move(callee); }
 
-    const std::vector<std::unique_ptr<Expression>>& arguments() const { return arguments_; }
-    void setArguments(std::vector<std::unique_ptr<Expression>> arguments) { arguments_ = std::move(arguments); }
+    const NodeList<Expression>& arguments() const { return arguments_; }
+    void setArguments(NodeList<Expression> arguments) { arguments_ = std::move(arguments); }
+    NodeList<Expression> releaseArguments() { return std::move(arguments_); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
     std::unique_ptr<Expression> callee_;
-    std::vector<std::unique_ptr<Expression>> arguments_;
+    NodeList<Expression> arguments_;
 };
 
 // For statement node
@@ -810,9 +1010,11 @@ public:
 
     Statement* consequent() const { return consequent_.get(); }
     void setConsequent(std::unique_ptr<Statement> consequent) { consequent_ = std::move(consequent); }
+    std::unique_ptr<Statement> releaseConsequent() { return std::move(consequent_); }
 
     Statement* alternate() const { return alternate_.get(); }
     void setAlternate(std::unique_ptr<Statement> alternate) { alternate_ = std::move(alternate); }
+    std::unique_ptr<Statement> releaseAlternate() { return std::move(alternate_); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
@@ -826,21 +1028,21 @@ private:
 // Switch statement node
 class SwitchStatement : public Statement {
 public:
-    SwitchStatement(std::unique_ptr<Expression> discriminant, std::vector<std::unique_ptr<CaseClause>> cases, const TokenPosition& position);
+    SwitchStatement(std::unique_ptr<Expression> discriminant, NodeList<CaseClause> cases, const TokenPosition& position);
     virtual ~SwitchStatement() = default;
 
     Expression* discriminant() const { return discriminant_.get(); }
     void setDiscriminant(std::unique_ptr<Expression> discriminant) { discriminant_ = std::move(discriminant); }
 
-    const std::vector<std::unique_ptr<CaseClause>>& cases() const { return cases_; }
-    void setCases(std::vector<std::unique_ptr<CaseClause>> cases) { cases_ = std::move(cases); }
+    const NodeList<CaseClause>& cases() const { return cases_; }
+    void setCases(NodeList<CaseClause> cases) { cases_ = std::move(cases); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
     std::unique_ptr<Expression> discriminant_;
-    std::vector<std::unique_ptr<CaseClause>> cases_;
+    NodeList<CaseClause> cases_;
 };
 
 // Try statement node
@@ -974,61 +1176,152 @@ private:
 // Block statement node
 class BlockStatement : public Statement {
 public:
-    BlockStatement(std::vector<std::unique_ptr<Statement>> body, const TokenPosition& position);
+    BlockStatement(NodeList<Statement> body, const TokenPosition& position);
     virtual ~BlockStatement() = default;
 
-    const std::vector<std::unique_ptr<Statement>>& body() const { return body_; }
-    void setBody(std::vector<std::unique_ptr<Statement>> body) { body_ = std::move(body); }
+    const NodeList<Statement>& body() const { return body_; }
+    void setBody(NodeList<Statement> body) { body_ = std::move(body); }
+    NodeList<Statement> releaseBody() { return std::move(body_); }
+
+    virtual std::string toString() const override;
+    virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    NodeList<Statement> body_;
+};
+
+// Expression statement node
+class ExpressionStatement : public Statement {
+public:
+    ExpressionStatement(std::unique_ptr<Expression> expression, const TokenPosition& position);
+    virtual ~ExpressionStatement() = default;
+
+    Expression* expression() const { return expression_.get(); }
+    void setExpression(std::unique_ptr<Expression> expression) { expression_ = std::move(expression); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<Statement>> body_;
+    std::unique_ptr<Expression> expression_;
+};
+
+// Variable statement node
+class VariableStatement : public Statement {
+public:
+    VariableStatement(std::unique_ptr<Declaration> declaration, const TokenPosition& position);
+    virtual ~VariableStatement() = default;
+
+    Declaration* declaration() const { return declaration_.get(); }
+
+    virtual std::string toString() const override;
+    virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Declaration> declaration_;
+};
+
+// Function statement node
+class FunctionStatement : public Statement {
+public:
+    FunctionStatement(std::unique_ptr<Declaration> declaration, const TokenPosition& position);
+    virtual ~FunctionStatement() = default;
+
+    Declaration* declaration() const { return declaration_.get(); }
+
+    virtual std::string toString() const override;
+    virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Declaration> declaration_;
+};
+
+// Debugger statement node
+class DebuggerStatement : public Statement {
+public:
+    DebuggerStatement(const TokenPosition& position);
+    virtual ~DebuggerStatement() = default;
+
+    virtual std::string toString() const override;
+    virtual void accept(ASTVisitor& visitor) override;
+};
+
+// Variable declarator node
+class VariableDeclarator : public Node {
+public:
+    VariableDeclarator(std::unique_ptr<Identifier> id, std::unique_ptr<Expression> init, const TokenPosition& position);
+    virtual ~VariableDeclarator() = default;
+
+    Identifier* id() const { return id_.get(); }
+    void setId(std::unique_ptr<Identifier> id) { id_ = std::move(id); }
+
+    Expression* init() const { return init_.get(); }
+    void setInit(std::unique_ptr<Expression> init) { init_ = std::move(init); }
+
+    virtual std::string toString() const override;
+    virtual void accept(ASTVisitor& visitor) override;
+
+private:
+    std::unique_ptr<Identifier> id_;
+    std::unique_ptr<Expression> init_;
 };
 
 // Variable declaration node
 class VariableDeclaration : public Declaration {
 public:
-    VariableDeclaration(const std::string& kind, std::vector<std::unique_ptr<VariableDeclarator>> declarations, const TokenPosition& position);
+    VariableDeclaration(const std::string& kind, NodeList<VariableDeclarator> declarations, const TokenPosition& position);
     virtual ~VariableDeclaration() = default;
 
     const std::string& kind() const { return kind_; }
     void setKind(const std::string& kind) { kind_ = kind; }
 
-    const std::vector<std::unique_ptr<VariableDeclarator>>& declarations() const { return declarations_; }
-    void setDeclarations(std::vector<std::unique_ptr<VariableDeclarator>> declarations) { declarations_ = std::move(declarations); }
+    const NodeList<VariableDeclarator>& declarations() const { return declarations_; }
+    void setDeclarations(NodeList<VariableDeclarator> declarations) { declarations_ = std::move(declarations); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
     std::string kind_;
-    std::vector<std::unique_ptr<VariableDeclarator>> declarations_;
+    NodeList<VariableDeclarator> declarations_;
 };
 
 // Function declaration node
 class FunctionDeclaration : public Declaration {
 public:
-    FunctionDeclaration(std::unique_ptr<Identifier> id, std::vector<std::unique_ptr<Parameter>> params, std::unique_ptr<BlockStatement> body, const TokenPosition& position);
+    FunctionDeclaration(std::unique_ptr<Identifier> id, NodeList<Parameter> params, std::unique_ptr<BlockStatement> body, const TokenPosition& position);
     virtual ~FunctionDeclaration() = default;
 
     Identifier* id() const { return id_.get(); }
     void setId(std::unique_ptr<Identifier> id) { id_ = std::move(id); }
 
-    const std::vector<std::unique_ptr<Parameter>>& params() const { return params_; }
-    void setParams(std::vector<std::unique_ptr<Parameter>> params) { params_ = std::move(params); }
+    const NodeList<Parameter>& params() const { return params_; }
+    void setParams(NodeList<Parameter> params) { params_ = std::move(params); }
 
     BlockStatement* body() const { return body_.get(); }
     void setBody(std::unique_ptr<BlockStatement> body) { body_ = std::move(body); }
 
+    // Set instead of a body when the parser only pre-parsed the function
+    const PreparseData* preparse() const { return preparse_.get(); }
+    void setPreparse(std::unique_ptr<PreparseData> preparse) { preparse_ = std::move(preparse); }
+    bool isLazy() const { return !body_ && preparse_; }
+
+    // function* and async function
+    bool isGenerator() const { return generator_; }
+    void setGenerator(bool generator) { generator_ = generator; }
+    bool isAsync() const { return async_; }
+    void setAsync(bool async) { async_ = async; }
+
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
     std::unique_ptr<Identifier> id_;
-    std::vector<std::unique_ptr<Parameter>> params_;
+    NodeList<Parameter> params_;
     std::unique_ptr<BlockStatement> body_;
+    std::unique_ptr<PreparseData> preparse_;
+    bool generator_ = false;
+    bool async_ = false;
 };
 
 // Class declaration node
@@ -1058,11 +1351,11 @@ private:
 // Import declaration node
 class ImportDeclaration : public Declaration {
 public:
-    ImportDeclaration(std::vector<std::unique_ptr<ImportSpecifier>> specifiers, std::unique_ptr<Literal> source, const TokenPosition& position);
+    ImportDeclaration(NodeList<ImportSpecifier> specifiers, std::unique_ptr<Literal> source, const TokenPosition& position);
     virtual ~ImportDeclaration() = default;
 
-    const std::vector<std::unique_ptr<ImportSpecifier>>& specifiers() const { return specifiers_; }
-    void setSpecifiers(std::vector<std::unique_ptr<ImportSpecifier>> specifiers) { specifiers_ = std::move(specifiers); }
+    const NodeList<ImportSpecifier>& specifiers() const { return specifiers_; }
+    void setSpecifiers(NodeList<ImportSpecifier> specifiers) { specifiers_ = std::move(specifiers); }
 
     Literal* source() const { return source_.get(); }
     void setSource(std::unique_ptr<Literal> source) { source_ = std::move(source); }
@@ -1071,18 +1364,18 @@ public:
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<ImportSpecifier>> specifiers_;
+    NodeList<ImportSpecifier> specifiers_;
     std::unique_ptr<Literal> source_;
 };
 
 // Export declaration node
 class ExportDeclaration : public Declaration {
 public:
-    ExportDeclaration(std::vector<std::unique_ptr<ExportSpecifier>> specifiers, std::unique_ptr<Literal> source, const TokenPosition& position);
+    ExportDeclaration(NodeList<ExportSpecifier> specifiers, std::unique_ptr<Literal> source, const TokenPosition& position);
     virtual ~ExportDeclaration() = default;
 
-    const std::vector<std::unique_ptr<ExportSpecifier>>& specifiers() const { return specifiers_; }
-    void setSpecifiers(std::vector<std::unique_ptr<ExportSpecifier>> specifiers) { specifiers_ = std::move(specifiers); }
+    const NodeList<ExportSpecifier>& specifiers() const { return specifiers_; }
+    void setSpecifiers(NodeList<ExportSpecifier> specifiers) { specifiers_ = std::move(specifiers); }
 
     Literal* source() const { return source_.get(); }
     void setSource(std::unique_ptr<Literal> source) { source_ = std::move(source); }
@@ -1091,40 +1384,48 @@ public:
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<ExportSpecifier>> specifiers_;
+    NodeList<ExportSpecifier> specifiers_;
     std::unique_ptr<Literal> source_;
 };
 
 // Program node
 class Program : public Node {
 public:
-    Program(std::vector<std::unique_ptr<Statement>> body, const TokenPosition& position);
+    Program(NodeList<Statement> body, const TokenPosition& position);
     virtual ~Program() = default;
 
-    const std::vector<std::unique_ptr<Statement>>& body() const { return body_; }
-    void setBody(std::vector<std::unique_ptr<Statement>> body) { body_ = std::move(body); }
+    const NodeList<Statement>& body() const { return body_; }
+    void setBody(NodeList<Statement> body) { body_ = std::move(body); }
+    NodeList<Statement> releaseBody() { return std::move(body_); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<Statement>> body_;
+    NodeList<Statement> body_;
 };
 
 // Module node
 class Module : public Node {
 public:
-    Module(std::vector<std::unique_ptr<Statement>> body, const TokenPosition& position);
+    Module(NodeList<Statement> body, const TokenPosition& position);
     virtual ~Module() = default;
 
-    const std::vector<std::unique_ptr<Statement>>& body() const { return body_; }
-    void setBody(std::vector<std::unique_ptr<Statement>> body) { body_ = std::move(body); }
+    const NodeList<Statement>& body() const { return body_; }
+    void setBody(NodeList<Statement> body) { body_ = std::move(body); }
+    NodeList<Statement> releaseBody() { return std::move(body_); }
+
+    // The static import and re-export declarations, in source order. They
+    // are resolved by the Loader before the body runs, so are not part of it.
+    const NodeList<Declaration>& imports() const { return imports_; }
+    void setImports(NodeList<Declaration> imports) { imports_ = std::move(imports); }
 
     virtual std::string toString() const override;
     virtual void accept(ASTVisitor& visitor) override;
 
 private:
-    std::vector<std::unique_ptr<Statement>> body_;
+    NodeList<Statement> body_;
+    NodeList<Declaration> imports_;
 };
 
 // AST visitor
@@ -1197,10 +1498,16 @@ public:
 class AST {
 public:
     AST(std::unique_ptr<Node> root);
+    // The tree was allocated from arena, which is released after it
+    AST(std::unique_ptr<Node> root, std::unique_ptr<Arena> arena);
     ~AST();
 
+    Arena* arena() const { return arena_.get(); }
+
     Node* root() const { return root_.get(); }
     void setRoot(std::unique_ptr<Node> root) { root_ = std::move(root); }
+    // Only for trees not allocated from an arena, which dies with the AST
+    std::unique_ptr<Node> releaseRoot() { return std::move(root_); }
 
     std::string toString() const;
     void accept(ASTVisitor& visitor);
@@ -1209,6 +1516,8 @@ public:
     bool operator!=(const AST& other) const { return !(*this == other); }
 
 private:
+    // Declared first so it outlives the nodes it holds
+    std::unique_ptr<Arena> arena_;
     std::unique_ptr<Node> root_;
 };
 
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ast.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace js {
+
+// Simplifies a parsed tree before it is compiled
+//
+// Operators whose operands are all literals are folded to one literal:
+// arithmetic, bitwise and comparison operators on numbers, concatenation
+// and comparison of strings, !, typeof and void. Conditional and logical
+// expressions whose test folds keep the operand that would be chosen, and
+// if / while statements with a constant test lose the branch that can
+// never run, so bundler output guarded by inlined configuration constants
+// compiles to just the live side.
+//
+// Every rewrite keeps the program's behaviour: a branch is only dropped
+// when nothing in it is hoisted out of it (var and function declarations),
+// and folds that JS would evaluate differently from C++ (ToString of
+// fractional numbers, UTF-16 ordering of non-ASCII strings) are left
+// alone. Pre-parsed function bodies are not seen; they are compiled from
+// source on their first call.
+class ASTOptimizer {
+public:
+    ASTOptimizer();
+
+    // Rewrites root (a Program, Module or function body) in place
+    void optimize(Node* root);
+
+    // Statistics
+    size_t getFoldedCount() const { return folded_; }
+    size_t getEliminatedBranchCount() const { return eliminated_; }
+
+private:
+    size_t folded_;
+    size_t eliminated_;
+
+    void optimizeStatements(NodeList<Statement>& statements);
+    // In a position that takes exactly one statement
+    void optimizeStatementSlot(Statement* statement, const std::function<void(std::unique_ptr<Statement>)>& replace);
+    // The statement to put in place of statement (null with removed set
+    // when it can go, null otherwise when it stays as it is)
+    std::unique_ptr<Statement> optimizeStatement(Statement* statement, bool& removed);
+    std::unique_ptr<Statement> optimizeIf(IfStatement* statement, bool& removed);
+    // Function bodies and blocks
+    void optimizeBlock(BlockStatement* block);
+
+    void optimizeExpressions(NodeList<Expression>& expressions);
+    // With reference set the slot is a callee or the operand of delete or
+    // typeof, where an identifier or member expression means more than its
+    // value, so a fold that would leave one there is not made
+    void optimizeExpressionSlot(Expression* expression, const std::function<void(std::unique_ptr<Expression>)>& replace,
+                                bool reference = false);
+    // The expression to put in place of expression, or null to keep it
+    std::unique_ptr<Expression> optimizeExpression(Expression* expression, bool reference);
+    void optimizeChildren(Expression* expression);
+    std::unique_ptr<Expression> foldUnary(UnaryExpression* expression);
+    std::unique_ptr<Expression> foldBinary(BinaryExpression* expression);
+    std::unique_ptr<Expression> foldLogical(LogicalExpression* expression, bool reference);
+    std::unique_ptr<Expression> foldConditional(ConditionalExpression* expression, bool reference);
+};
+
+} // namespace js
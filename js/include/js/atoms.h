@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace js {
+
+using Atom = uint32_t;
+
+// Interned identifier names
+//
+// Every distinct name is stored once and identified by a small integer, so
+// identifiers compare by id and their text stays valid for the table's
+// lifetime regardless of what happens to the source it was scanned from.
+class AtomTable {
+public:
+    static constexpr Atom kNone = 0;
+
+    AtomTable();
+
+    AtomTable(const AtomTable&) = delete;
+    AtomTable& operator=(const AtomTable&) = delete;
+
+    Atom intern(std::string_view name);
+    // kNone if name has never been interned
+    Atom find(std::string_view name) const;
+    std::string_view name(Atom atom) const;
+
+    // Statistics
+    size_t size() const { return names_.size(); }
+
+private:
+    // deque keeps the stored strings at stable addresses as it grows
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, Atom> index_;
+};
+
+} // namespace js
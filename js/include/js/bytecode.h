@@ -0,0 +1,292 @@
+#pragma once
+
+#include "jsvalue.h"
+#include "types.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace js {
+
+class BaselineCode;
+class Shape;
+
+// Bytecode opcodes
+//
+// Register machine: every operand names a slot in the current frame's
+// register window. "k" operands index the function's constant pool, "n"
+// operands index its name table and "f" operands index its inner functions.
+// Slot operands address scope[depth] on the runtime scope chain, where depth
+// 0 is the innermost named scope.
+// Jump targets are absolute instruction indices stored in b/c (see target()).
+enum class Opcode : uint16_t {
+    // Loads and moves
+    LoadConst,          // a = k[b]
+    LoadUndefined,      // a = undefined
+    LoadNull,           // a = null
+    LoadTrue,           // a = true
+    LoadFalse,          // a = false
+    LoadThis,           // a = this
+    LoadCallee,         // a = currently executing closure
+    Move,               // a = b
+
+    // Named (context) bindings
+    LoadName,           // a = resolve(n[b])
+    StoreName,          // assign(n[b], a)
+    DeclareName,        // declare(n[b], a)
+
+    // Resolved scope bindings
+    LoadSlot,           // a = scope[b].slots[c]
+    StoreSlot,          // scope[b].slots[c] = a
+
+    // Property access
+    GetProperty,        // a = b.n[c]
+    SetProperty,        // a.n[b] = c
+    GetElement,         // a = b[c]
+    SetElement,         // a[b] = c
+
+    // Arithmetic
+    Add,                // a = b + c
+    Subtract,           // a = b - c
+    Multiply,           // a = b * c
+    Divide,             // a = b / c
+    Modulo,             // a = b % c
+    Exponent,           // a = b ** c
+
+    // Bitwise
+    BitwiseAnd,         // a = b & c
+    BitwiseOr,          // a = b | c
+    BitwiseXor,         // a = b ^ c
+    LeftShift,          // a = b << c
+    RightShift,         // a = b >> c
+    UnsignedRightShift, // a = b >>> c
+
+    // Comparison
+    Equal,              // a = b == c
+    NotEqual,           // a = b != c
+    StrictEqual,        // a = b === c
+    StrictNotEqual,     // a = b !== c
+    LessThan,           // a = b < c
+    LessThanOrEqual,    // a = b <= c
+    GreaterThan,        // a = b > c
+    GreaterThanOrEqual, // a = b >= c
+
+    // Unary
+    Negate,             // a = -b
+    UnaryPlus,          // a = +b
+    LogicalNot,         // a = !b
+    BitwiseNot,         // a = ~b
+    TypeOf,             // a = typeof b
+    Increment,          // a = b + 1
+    Decrement,          // a = b - 1
+
+    // Control flow
+    Jump,               // pc = target
+    JumpIfTrue,         // if (a) pc = target
+    JumpIfFalse,        // if (!a) pc = target
+    JumpIfNotNullish,   // if (a != null) pc = target
+
+    // Calls
+    Call,               // a = b(b+1 .. b+c)
+    CallMethod,         // a = b.call(this = b+1, b+2 .. b+c+1)
+    Construct,          // a = new b(b+1 .. b+c)
+    Return,             // return a
+    ReturnUndefined,    // return undefined
+
+    // Object construction
+    NewObject,          // a = {}
+    NewArray,           // a = []
+    ArrayPush,          // a.push(b)
+    Closure,            // a = closure(f[b])
+
+    // Exceptions
+    Throw,              // throw a
+    PushHandler,        // on throw: a = exception, pc = target
+    PopHandler,         // drop innermost handler
+
+    // Coroutines (generator and async function bodies only)
+    Yield,              // suspend yielding b; a = value passed to next()
+    Await,              // suspend until b settles; a = fulfillment value
+
+    // Misc
+    Debugger,           // debugger statement
+    Nop,
+
+    Count
+};
+
+const char* opcodeName(Opcode op);
+
+// Single fixed-width instruction (8 bytes)
+struct Instruction {
+    Opcode op;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+
+    Instruction() : op(Opcode::Nop), a(0), b(0), c(0) {}
+    Instruction(Opcode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0) : op(op), a(a), b(b), c(c) {}
+
+    // Jump target packed into b (low) and c (high)
+    uint32_t target() const { return static_cast<uint32_t>(b) | (static_cast<uint32_t>(c) << 16); }
+    void setTarget(uint32_t target) {
+        b = static_cast<uint16_t>(target & 0xFFFF);
+        c = static_cast<uint16_t>(target >> 16);
+    }
+};
+
+static_assert(sizeof(Instruction) == 8, "Instruction must stay 8 bytes");
+
+// Constant pool entry
+struct Constant {
+    enum class Kind : uint8_t { Number, String };
+
+    Kind kind;
+    double number;
+    std::string string;
+
+    Constant() : kind(Kind::Number), number(0.0), string() {}
+    explicit Constant(double value) : kind(Kind::Number), number(value), string() {}
+    explicit Constant(const std::string& value) : kind(Kind::String), number(0.0), string(value) {}
+
+    bool operator==(const Constant& other) const {
+        if (kind != other.kind) {
+            return false;
+        }
+        return kind == Kind::Number ? number == other.number : string == other.string;
+    }
+};
+
+// Inline cache for one GetProperty / SetProperty site
+//
+// Up to kEntries shapes are remembered (monomorphic with one, polymorphic
+// beyond that); once a site sees more it goes megamorphic and stops caching.
+// For stores that add a property, transition holds the resulting shape.
+struct PropertyCache {
+    static constexpr size_t kEntries = 4;
+
+    struct Entry {
+        Shape* shape;
+        Shape* transition;
+        uint32_t slot;
+    };
+
+    Entry entries[kEntries];
+    uint8_t count;
+    bool megamorphic;
+
+    PropertyCache() : entries(), count(0), megamorphic(false) {}
+
+    const Entry* find(const Shape* shape) const {
+        for (uint8_t i = 0; i < count; ++i) {
+            if (entries[i].shape == shape) {
+                return &entries[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void add(Shape* shape, Shape* transition, uint32_t slot) {
+        if (megamorphic) {
+            return;
+        }
+        if (count == kEntries) {
+            megamorphic = true;
+            return;
+        }
+        entries[count++] = Entry{shape, transition, slot};
+    }
+
+    bool isMonomorphic() const { return count == 1 && !megamorphic; }
+};
+
+// Slot names of one named scope, resolved by the compiler. parent is the
+// layout of the next named scope out, matching the runtime scope chain.
+struct ScopeLayout {
+    std::vector<std::string> names;
+    std::shared_ptr<const ScopeLayout> parent;
+
+    // Slot of name, or -1 when this scope does not bind it
+    int find(const std::string& name) const {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+};
+
+// Where to find the body of a function that was only pre-parsed
+struct LazyFunction {
+    std::shared_ptr<const std::string> source;
+    size_t begin;
+    size_t end;
+    // Declarations do not bind their own name inside the body
+    bool isDeclaration;
+    // Scopes the body resolves free identifiers against when compiled
+    std::shared_ptr<const ScopeLayout> enclosing;
+};
+
+// Hotness and deoptimization counts kept by the Optimizer
+struct TierState {
+    uint32_t calls = 0;
+    uint32_t backEdges = 0;
+    uint32_t deoptimizations = 0;
+    // Compilation failed or the code deoptimized too often
+    bool disabled = false;
+};
+
+// Compiled function body
+struct BytecodeFunction {
+    std::string name;
+    uint16_t paramCount;
+    uint16_t registerCount;
+
+    // Parameters and locals live in registers unless the function contains
+    // inner functions, in which case they get slots in a fresh ClosureScope
+    // (laid out by scope) so the inner functions can see them.
+    bool usesNamedScope;
+    bool isTopLevel;
+
+    // Arrow functions capture `this` when the closure is created
+    bool isArrow;
+
+    // function* and async function bodies run on a Coroutine's saved frame
+    bool isGenerator;
+    bool isAsync;
+
+    std::vector<Instruction> code;
+    std::vector<Constant> constants;
+    // Tagged copies of constants, filled in by the VM on first entry
+    std::vector<JSValue> constantValues;
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<BytecodeFunction>> functions;
+    std::shared_ptr<const ScopeLayout> scope;
+
+    // Source position of each instruction, for error reporting and profiling
+    std::vector<TokenPosition> positions;
+
+    // Property inline caches; cacheSlots maps an instruction index to its
+    // entry in propertyCaches (only meaningful for Get/SetProperty)
+    std::vector<PropertyCache> propertyCaches;
+    std::vector<uint32_t> cacheSlots;
+
+    // Set on stubs for pre-parsed functions: only name and paramCount are
+    // valid until Compiler::compileLazy() fills in the rest
+    std::shared_ptr<const LazyFunction> lazy;
+
+    // Native code from the Optimizer, entered by the VM when set
+    TierState tier;
+    std::shared_ptr<BaselineCode> baseline;
+
+    BytecodeFunction()
+        : name(), paramCount(0), registerCount(0), usesNamedScope(false), isTopLevel(false), isArrow(false),
+          isGenerator(false), isAsync(false), code(), constants(), constantValues(), names(), functions(), scope(), positions(), propertyCaches(),
+          cacheSlots(), lazy(), tier(), baseline() {}
+
+    std::string disassemble() const;
+};
+
+} // namespace js
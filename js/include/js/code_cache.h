@@ -0,0 +1,74 @@
+#pragma once
+
+#include "bytecode.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace js {
+
+// On-disk cache of compiled scripts
+//
+// Each script compiles to one blob named after a 64-bit hash of its
+// source. The blob holds the whole BytecodeFunction tree: code, constants,
+// name tables and the scope slot layouts the compiler resolved. A later
+// load of the same source maps the blob and rebuilds the functions without
+// tokenizing or parsing. Blobs of another format version or opcode table,
+// and blobs whose code does not verify, are rejected and removed. Once the
+// directory grows past maxBytes, the least recently used blobs are
+// evicted.
+class CodeCache {
+public:
+    // Bump whenever the blob layout or what existing opcodes do changes
+    static constexpr uint32_t kFormatVersion = 4;
+    static constexpr size_t kDefaultMaxBytes = 64 * 1024 * 1024;
+
+    explicit CodeCache(std::string directory, size_t maxBytes = kDefaultMaxBytes);
+    ~CodeCache();
+
+    CodeCache(const CodeCache&) = delete;
+    CodeCache& operator=(const CodeCache&) = delete;
+
+    // nullptr on a miss
+    std::shared_ptr<BytecodeFunction> load(const std::string& source);
+    // compileTime is what producing function took, in seconds; hits are
+    // credited with it minus their own load time
+    bool store(const std::string& source, const BytecodeFunction& function, double compileTime);
+    void clear();
+
+    static uint64_t hashSource(const std::string& source);
+    // Changes with kFormatVersion, the opcode table and the instruction layout
+    static uint64_t buildId();
+
+    const std::string& directory() const { return directory_; }
+    size_t maxBytes() const { return maxBytes_; }
+    void setMaxBytes(size_t maxBytes);
+
+    // Statistics
+    size_t getHitCount() const { return hits_; }
+    size_t getMissCount() const { return misses_; }
+    size_t getRejectedCount() const { return rejected_; }
+    size_t getStoreCount() const { return stores_; }
+    size_t getEvictionCount() const { return evictions_; }
+    double getHitRate() const;
+    // Seconds of parse + compile time avoided by hits
+    double getSavedTime() const { return savedTime_; }
+    void resetStatistics();
+
+private:
+    std::string directory_;
+    size_t maxBytes_;
+
+    size_t hits_;
+    size_t misses_;
+    size_t rejected_;
+    size_t stores_;
+    size_t evictions_;
+    double savedTime_;
+
+    std::string pathFor(uint64_t hash) const;
+    void evict();
+};
+
+} // namespace js
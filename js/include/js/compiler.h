@@ -0,0 +1,194 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace js {
+
+// Raised for constructs the bytecode tier does not handle yet. The engine
+// catches it and falls back to the AST interpreter for that script.
+class CompileError : public std::runtime_error {
+public:
+    CompileError(const std::string& message, const TokenPosition& position)
+        : std::runtime_error(message), position_(position) {}
+
+    const TokenPosition& position() const { return position_; }
+
+private:
+    TokenPosition position_;
+};
+
+// Lowers Program / function ASTs into register bytecode for the VM
+class Compiler {
+public:
+    Compiler();
+    ~Compiler();
+
+    // Compilation
+    std::shared_ptr<BytecodeFunction> compile(Program* program);
+    std::shared_ptr<BytecodeFunction> compile(Module* module);
+    std::shared_ptr<BytecodeFunction> compileFunction(FunctionExpression* function);
+    std::shared_ptr<BytecodeFunction> compileFunction(FunctionDeclaration* function);
+    // Parses and compiles a pre-parsed function's body into its stub in
+    // place, so every closure sharing the stub sees the code
+    static void compileLazy(BytecodeFunction& function);
+
+    // Statistics
+    size_t getCompiledFunctionCount() const { return compiledFunctionCount_; }
+    size_t getLazyFunctionCount() const { return lazyFunctionCount_; }
+    size_t getEmittedInstructionCount() const { return emittedInstructionCount_; }
+    void resetStatistics();
+
+private:
+    // Break/continue bookkeeping for the innermost loops and switches
+    struct JumpScope {
+        std::string label;
+        bool isLoop;
+        size_t handlerDepth;
+        std::vector<size_t> breakJumps;
+        std::vector<size_t> continueJumps;
+    };
+
+    // A try with a finalizer around the code being compiled; break,
+    // continue and return leaving it run an inline copy of the finalizer
+    struct FinallyScope {
+        BlockStatement* finalizer;
+        // Handlers and jump scopes around the try statement
+        size_t handlerDepth;
+        size_t jumpScopeCount;
+    };
+
+    // Per-function compilation state
+    struct FunctionState {
+        std::shared_ptr<BytecodeFunction> function;
+        std::unordered_map<std::string, uint16_t> locals;
+        std::unordered_map<std::string, uint16_t> constantIndex;
+        std::unordered_map<std::string, uint16_t> nameIndex;
+        // Named functions only: the slot of each binding in their scope
+        std::shared_ptr<ScopeLayout> layout;
+        std::unordered_map<std::string, uint16_t> slots;
+        std::vector<std::string> varNames;
+        std::vector<FunctionDeclaration*> hoisted;
+        std::string selfName;
+        bool named = false;
+        uint16_t nextRegister = 0;
+        uint16_t maxRegister = 0;
+        uint16_t firstTemporary = 0;
+        uint16_t completionRegister = 0;
+        size_t handlerDepth = 0;
+        std::vector<JumpScope> jumpScopes;
+        std::vector<FinallyScope> finallyScopes;
+        std::string pendingLabel;
+    };
+
+    // Heap-allocated so references stay valid while nested functions compile
+    std::vector<std::unique_ptr<FunctionState>> states_;
+    // Named scopes around the outermost function being compiled; only set
+    // when a lazy function body is compiled on its own
+    std::shared_ptr<const ScopeLayout> enclosingScope_;
+    size_t compiledFunctionCount_;
+    size_t lazyFunctionCount_;
+    size_t emittedInstructionCount_;
+
+    FunctionState& state() { return *states_.back(); }
+    BytecodeFunction& function() { return *states_.back()->function; }
+
+    // Function bodies
+    std::shared_ptr<BytecodeFunction> lazyStub(const std::string& name, const NodeList<Parameter>& params,
+                                               const PreparseData& preparse, bool isDeclaration, bool isGenerator,
+                                               bool isAsync);
+    std::shared_ptr<BytecodeFunction> compileBody(const std::string& name,
+                                                  const std::string& selfName,
+                                                  const NodeList<Parameter>* params,
+                                                  const NodeList<Statement>& body,
+                                                  Expression* expressionBody,
+                                                  bool isTopLevel,
+                                                  bool isArrow,
+                                                  bool isGenerator = false,
+                                                  bool isAsync = false);
+    std::shared_ptr<BytecodeFunction> compileBodyAttempt(const std::string& name,
+                                                         const std::string& selfName,
+                                                         const NodeList<Parameter>* params,
+                                                         const NodeList<Statement>& body,
+                                                         Expression* expressionBody,
+                                                         bool isTopLevel,
+                                                         bool isArrow,
+                                                         bool isGenerator,
+                                                         bool isAsync,
+                                                         bool named);
+    void collectDeclarations(const NodeList<Statement>& body);
+    void collectDeclarations(Node* node);
+
+    // Statements
+    void compileStatement(Node* node);
+    void compileStatements(const NodeList<Statement>& statements);
+    void compileVariableDeclaration(VariableDeclaration* declaration);
+    void compileIfStatement(IfStatement* statement);
+    void compileWhileStatement(WhileStatement* statement);
+    void compileDoWhileStatement(DoWhileStatement* statement);
+    void compileForStatement(ForStatement* statement);
+    void compileSwitchStatement(SwitchStatement* statement);
+    void compileTryStatement(TryStatement* statement);
+    void compileReturnStatement(ReturnStatement* statement);
+    void compileBreakStatement(BreakStatement* statement);
+    void compileContinueStatement(ContinueStatement* statement);
+    void compileLabeledStatement(LabeledStatement* statement);
+
+    // Expressions
+    void compileExpression(Expression* expression, uint16_t dst);
+    uint16_t compileToRegister(Expression* expression);
+    void compileIdentifier(Identifier* identifier, uint16_t dst);
+    void compileLiteral(Literal* literal, uint16_t dst);
+    void compileBinaryExpression(BinaryExpression* expression, uint16_t dst);
+    void compileLogicalExpression(LogicalExpression* expression, uint16_t dst);
+    void compileUnaryExpression(UnaryExpression* expression, uint16_t dst);
+    void compileUpdateExpression(UpdateExpression* expression, uint16_t dst);
+    void compileAssignmentExpression(AssignmentExpression* expression, uint16_t dst);
+    void compileConditionalExpression(ConditionalExpression* expression, uint16_t dst);
+    void compileCallExpression(CallExpression* expression, uint16_t dst);
+    void compileNewExpression(NewExpression* expression, uint16_t dst);
+    void compileMemberExpression(MemberExpression* expression, uint16_t dst);
+    void compileArrayExpression(ArrayExpression* expression, uint16_t dst);
+    void compileObjectExpression(ObjectExpression* expression, uint16_t dst);
+    void compileSequenceExpression(SequenceExpression* expression, uint16_t dst);
+    void compileTemplateLiteral(TemplateLiteral* expression, uint16_t dst);
+    void compileYieldExpression(YieldExpression* expression, uint16_t dst);
+    void compileYieldDelegate(YieldExpression* expression, uint16_t dst);
+    void compileAwaitExpression(AwaitExpression* expression, uint16_t dst);
+    void compileClosure(std::shared_ptr<BytecodeFunction> inner, uint16_t dst);
+    uint16_t compileArguments(const NodeList<Expression>& arguments);
+
+    // Bindings
+    bool isLocal(const std::string& name) const;
+    uint16_t addSlot(const std::string& name);
+    bool resolveSlot(const std::string& name, uint16_t& depth, uint16_t& slot) const;
+    std::shared_ptr<const ScopeLayout> currentScope() const;
+    void loadBinding(const std::string& name, uint16_t dst);
+    void storeBinding(const std::string& name, uint16_t src);
+    void declareBinding(const std::string& name, uint16_t src);
+
+    // Emission helpers
+    size_t emit(Opcode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0);
+    size_t emitJump(Opcode op, uint16_t a = 0);
+    void patchJump(size_t index);
+    void patchJump(size_t index, size_t target);
+    size_t currentOffset() const;
+    uint16_t addConstant(const Constant& constant);
+    uint16_t addName(const std::string& name);
+    uint16_t allocateRegister();
+    uint16_t allocateRegisters(uint16_t count);
+    void releaseRegisters(uint16_t mark);
+    void emitPopHandlers(size_t targetDepth);
+    void emitFinalizers(size_t jumpScopeCount, size_t targetDepth);
+    Opcode binaryOpcode(OperatorType op, const TokenPosition& position) const;
+
+    TokenPosition currentPosition_;
+    [[noreturn]] void unsupported(const std::string& what, const Node* node) const;
+};
+
+} // namespace js
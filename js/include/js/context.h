@@ -42,6 +42,9 @@ public:
     void setGlobalObject(std::unique_ptr<Object> global);
     Object* getGlobalObject() const { return globalObject_.get(); }
 
+    // Garbage collection (global bindings are roots)
+    void traceRoots(GC& gc) const;
+
     // Variable environment
     void setVariableEnvironment(std::unique_ptr<Environment> environment);
     Environment* getVariableEnvironment() const { return variableEnvironment_.get(); }
@@ -94,10 +97,11 @@ public:
     void setExceptionContext(std::unique_ptr<Exception> exception);
     Exception* getExceptionContext() const { return exceptionContext_.get(); }
 
-    // Variable resolution
-    std::unique_ptr<Value> resolveVariable(const std::string& name);
-    void declareVariable(const std::string& name, std::unique_ptr<Value> value);
-    void assignVariable(const std::string& name, std::unique_ptr<Value> value);
+    // Variable resolution (global bindings are tagged slots on the global
+    // object; resolveVariable returns JSValue::empty() when unbound)
+    JSValue resolveVariable(const std::string& name) const;
+    void declareVariable(const std::string& name, JSValue value);
+    void assignVariable(const std::string& name, JSValue value);
     bool hasVariable(const std::string& name) const;
     void deleteVariable(const std::string& name);
 
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "vm.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace js {
+
+class Coroutine;
+
+// Promise state and pending reactions
+//
+// A reaction either resumes an awaiting coroutine or runs then() handlers
+// and settles the derived promise with their result. Without a handler for
+// the outcome, the outcome passes straight to the derived promise, which is
+// also how a promise adopts the state of another one it is resolved with.
+// Reactions always run as microtasks, in the order they were added.
+class PromiseObject : public Object {
+public:
+    enum class State : uint8_t { Pending, Fulfilled, Rejected };
+
+    struct Reaction {
+        JSValue onFulfilled;
+        JSValue onRejected;
+        PromiseObject* derived;
+        Coroutine* coroutine;
+    };
+
+    PromiseObject();
+    virtual ~PromiseObject() = default;
+
+    State state() const { return state_; }
+    bool isPending() const { return state_ == State::Pending; }
+    JSValue result() const { return result_; }
+
+    // Settling; both are no-ops once the promise is settled. The pending
+    // reactions are handed back for scheduling.
+    std::vector<Reaction> settle(State state, JSValue result);
+    // Queued until settlement; false if the promise is already settled and
+    // the reaction has to be scheduled right away
+    bool addReaction(const Reaction& reaction);
+
+    // Type conversion
+    std::string toString() const override;
+
+    // Garbage collection
+    void traceChildren(GC& gc) const override;
+
+private:
+    State state_;
+    JSValue result_;
+    std::vector<Reaction> reactions_;
+};
+
+// Heap frame of a generator or async function call
+//
+// A running coroutine executes on the VM register stack like any other
+// frame. Suspending copies the register window, pc and the frame's
+// exception handlers here and pops the frame; resuming pushes them back at
+// the top of the stack. A suspended coroutine therefore costs this cell
+// and its registers, never a native stack.
+class Coroutine : public Object {
+public:
+    enum class Kind : uint8_t { Generator, Async };
+    enum class State : uint8_t { SuspendedStart, Suspended, Executing, Completed };
+
+    // Saved PushHandler entry of the suspended frame
+    struct SavedHandler {
+        uint32_t target;
+        uint16_t exceptionRegister;
+    };
+
+    // Generators start suspended with their arguments in the saved
+    // registers; async calls begin executing at once and own a promise
+    Coroutine(Kind kind, BytecodeClosure* closure, JSValue thisValue, PromiseObject* promise);
+    virtual ~Coroutine() = default;
+
+    Kind kind() const { return kind_; }
+    State state() const { return state_; }
+    void setState(State state) { state_ = state; }
+
+    BytecodeClosure* closure() const { return closure_; }
+    JSValue thisValue() const { return thisValue_; }
+    PromiseObject* promise() const { return promise_; }
+
+    // Saved frame; valid while suspended
+    const std::vector<JSValue>& registers() const { return registers_; }
+    const std::vector<SavedHandler>& handlers() const { return handlers_; }
+    const std::shared_ptr<ClosureScope>& scope() const { return scope_; }
+    uint32_t pc() const { return pc_; }
+    // Register the value sent on resumption is written to
+    uint16_t resumeRegister() const { return resumeRegister_; }
+
+    void setArguments(const JSValue* arguments, size_t count);
+    void suspend(const JSValue* registers, size_t count, uint32_t pc, std::shared_ptr<ClosureScope> scope,
+                 std::vector<SavedHandler> handlers, uint16_t resumeRegister);
+    // Drops the saved frame once it is back on the register stack
+    void releaseFrame();
+
+    // Type conversion
+    std::string toString() const override;
+
+    // Garbage collection
+    void traceChildren(GC& gc) const override;
+
+private:
+    Kind kind_;
+    State state_;
+    BytecodeClosure* closure_;
+    JSValue thisValue_;
+    PromiseObject* promise_;
+
+    std::vector<JSValue> registers_;
+    std::vector<SavedHandler> handlers_;
+    std::shared_ptr<ClosureScope> scope_;
+    uint32_t pc_;
+    uint16_t resumeRegister_;
+};
+
+// resolve / reject function handed to a Promise executor
+class PromiseResolvingFunction : public NativeFunction {
+public:
+    PromiseResolvingFunction(std::string name, PromiseObject* promise, NativeCallback callback);
+    virtual ~PromiseResolvingFunction() = default;
+
+    PromiseObject* promise() const { return promise_; }
+
+    // Garbage collection
+    void traceChildren(GC& gc) const override;
+
+private:
+    PromiseObject* promise_;
+};
+
+} // namespace js
@@ -4,10 +4,17 @@
 #include "value.h"
 #include "context.h"
 #include "interpreter.h"
+#include "code_cache.h"
+#include "script_compiler.h"
+#include "watchdog.h"
+#include <chrono>
+#include <deque>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace js {
 
@@ -34,9 +41,14 @@ class Async;
 class Module;
 class Loader;
 class Compiler;
+class VM;
+struct BytecodeFunction;
 class Optimizer;
 class Debugger;
 class Profiler;
+class HeapSnapshot;
+class ReadOnlyHeap;
+struct SnapshotBindings;
 
 // JavaScript Engine
 class JavaScriptEngine {
@@ -55,6 +67,19 @@ public:
     std::unique_ptr<Value> execute(std::unique_ptr<Program> program);
     std::unique_ptr<Value> execute(std::unique_ptr<Module> module);
 
+    // Background compilation. The source is tokenized, parsed and compiled
+    // on a worker pool while this thread keeps going; the result runs here
+    // through execute(CompiledScript).
+    std::future<CompiledScript> compileInBackground(const std::string& source);
+    std::unique_ptr<Value> execute(CompiledScript script);
+    // Scripts of a document: they compile in parallel but run in the order
+    // they were queued, each once it and every script before it is ready
+    void queueScript(const std::string& source);
+    // Runs the ready scripts at the head of the queue, or with wait every
+    // queued script; returns how many ran
+    size_t runQueuedScripts(bool wait = false);
+    size_t getQueuedScriptCount() const { return scriptQueue_.size(); }
+
     // Context management
     std::unique_ptr<Context> createContext();
     void setGlobalContext(std::unique_ptr<Context> context);
@@ -78,15 +103,62 @@ public:
     void initializeConsole();
     void initializeDOM();
     void initializeMath();
+    void initializeTypedArrays();
     void initializeDate();
     void initializeJSON();
     void initializePromise();
     void initializeAsync();
+    void initializeTimers();
+
+    // Startup snapshot. The first engine in the process builds Math, the
+    // typed array constructors and the timer functions, then captures them
+    // in a HeapSnapshot; later engines and createContext() restore that
+    // image instead of building them again. The image is shared process-wide.
+    static std::shared_ptr<const HeapSnapshot> getStartupSnapshot();
+    // Disabling also drops the current image
+    static void setStartupSnapshotEnabled(bool enabled);
+
+    // Isolation. Each engine owns its heap, globals and builtins and may run
+    // on its own thread, one thread at a time; engines share nothing
+    // mutable. The strings every engine interns are allocated once per
+    // process in this read-only heap, which every engine's GC draws from.
+    static std::shared_ptr<const ReadOnlyHeap> getReadOnlyHeap();
+
+    // Event loop. A turn runs the tasks and timers that are due, each
+    // followed by a microtask checkpoint, until the deadline passes; it
+    // returns whether due work is left for the next turn.
+    bool runEventLoopTurn(std::chrono::steady_clock::time_point deadline);
+    // Runs turns until no tasks or timers remain
+    void runEventLoop();
+    EventLoop* getEventLoop() const { return eventLoop_.get(); }
+
+    // Pre-emption. The callback runs on this engine's thread at the running
+    // script's next loop back-edge or function entry; returning false, like
+    // terminateExecution(), ends the script there as an execution error,
+    // past any try/catch. Pre-empted scripts do not resume. Both may be
+    // called from any thread; between scripts they wait for the next one.
+    void requestInterrupt(std::function<bool()> callback);
+    void terminateExecution();
+    // Execution deadline. A watchdog thread interrupts the script still
+    // running when the deadline passes and reports it to the long task
+    // handler, then ends it if terminate is set. Tasks started after the
+    // deadline are not interrupted again until it is set anew.
+    void setExecutionDeadline(std::chrono::steady_clock::time_point deadline, bool terminate = false);
+    void clearExecutionDeadline();
+    void setLongTaskHandler(std::function<void(const LongTask&)> handler);
 
     // Module system
     std::unique_ptr<Module> loadModule(const std::string& specifier);
     std::unique_ptr<Module> loadModule(const std::string& specifier, const std::string& referrer);
     void registerModule(const std::string& specifier, std::unique_ptr<Module> module);
+    // Loads specifier's static import graph in parallel, then runs each of
+    // its modules not yet run in this document, dependencies first; the
+    // result is the entry module's
+    std::unique_ptr<Value> importModule(const std::string& specifier, const std::string& referrer = std::string());
+    // A new document at url: modules run again, and the loaded records of
+    // other origins are dropped
+    void navigate(const std::string& url);
+    Loader* getLoader() const { return loader_.get(); }
 
     // Error handling
     void setErrorHandler(std::function<void(const Exception&)> handler);
@@ -101,12 +173,28 @@ public:
     void enableDebugging();
     void disableDebugging();
 
+    // Execution tier: bytecode VM by default, AST interpreter as fallback
+    void enableBytecode();
+    void disableBytecode();
+    bool isBytecodeEnabled() const { return bytecodeEnabled_; }
+
+    // Persistent bytecode cache for execute(source)
+    void enableCodeCache(const std::string& directory, size_t maxBytes = CodeCache::kDefaultMaxBytes);
+    void disableCodeCache();
+    CodeCache* getCodeCache() const { return codeCache_.get(); }
+
     // Memory management
     void enableGC();
     void disableGC();
     void runGC();
     size_t getHeapSize() const;
     size_t getHeapUsed() const;
+    // Full collection, which critical pressure follows by freeing the
+    // heap's spare blocks and the loaded module records nothing runs from;
+    // a safepoint like runGC(), so not mid-script
+    void onMemoryPressure(bool critical);
+    // Bytes of the module records the loader keeps for later loads
+    size_t getModuleRecordSize() const;
 
     // Configuration
     void setStrictMode(bool strict);
@@ -119,8 +207,15 @@ public:
     // Statistics
     size_t getExecutionCount() const { return executionCount_; }
     size_t getErrorCount() const { return errorCount_; }
+    size_t getBytecodeFallbackCount() const { return bytecodeFallbackCount_; }
+    size_t getLongTaskCount() const { return longTaskCount_; }
+    uint64_t getInlineCacheHitCount() const;
+    uint64_t getInlineCacheMissCount() const;
     double getAverageExecutionTime() const;
     double getTotalExecutionTime() const;
+    double getCodeCacheHitRate() const;
+    // Seconds of parse + compile time the code cache avoided
+    double getCodeCacheSavedTime() const;
 
 private:
     bool initialized_;
@@ -131,6 +226,7 @@ private:
     bool optimizationEnabled_;
     bool debuggingEnabled_;
     bool gcEnabled_;
+    bool bytecodeEnabled_;
 
     // Core components
     std::unique_ptr<Context> globalContext_;
@@ -144,20 +240,41 @@ private:
     std::unique_ptr<Module> module_;
     std::unique_ptr<Loader> loader_;
     std::unique_ptr<Compiler> compiler_;
+    std::unique_ptr<VM> vm_;
     std::unique_ptr<Optimizer> optimizer_;
     std::unique_ptr<Debugger> debugger_;
     std::unique_ptr<Profiler> profiler_;
+    std::unique_ptr<Watchdog> watchdog_;
+    std::unique_ptr<CodeCache> codeCache_;
+    std::unique_ptr<ScriptCompiler> scriptCompiler_;
+    std::deque<std::future<CompiledScript>> scriptQueue_;
+    // URLs of the modules run in this document
+    std::unordered_set<std::string> evaluatedModules_;
 
     // Statistics
     size_t executionCount_;
     size_t errorCount_;
+    size_t bytecodeFallbackCount_;
     double totalExecutionTime_;
+    size_t longTaskCount_;
+
+    // Execution deadline; generation 0 when none is set
+    std::chrono::steady_clock::time_point deadline_;
+    uint64_t deadlineGeneration_;
+    bool deadlineTerminates_;
+    std::function<void(const LongTask&)> longTaskHandler_;
 
     // Error handling
     std::function<void(const Exception&)> errorHandler_;
 
     // Helper methods
     void setupDefaultErrorHandler();
+    std::shared_ptr<BytecodeFunction> compileBytecode(Node* root);
+    // Interrupt raised by the watchdog for the deadline of generation
+    bool onExecutionDeadline(VM& vm, uint64_t generation);
+    SnapshotBindings snapshotBindings() const;
+    bool restoreStartupSnapshot(Object& globalObject);
+    void captureStartupSnapshot(const Object& globalObject, uint32_t firstSlot);
     void collectStatistics();
     void resetStatistics();
 };
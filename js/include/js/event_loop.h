@@ -0,0 +1,164 @@
+#pragma once
+
+#include "jsvalue.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace js {
+
+class GC;
+
+// Task scheduling for the engine
+//
+// A turn runs the macrotasks that were due when it started (posted tasks
+// and expired timers) and drains the microtask queue after each one, as
+// HTML prescribes. Turns stop early at a deadline, so the embedder can
+// interleave script work with layout and paint.
+//
+// Timers live in a hierarchical timing wheel: kWheelLevels levels of
+// kWheelSize slots, 1 ms per slot at the bottom level and kWheelSize
+// times coarser at each level above. Adding and cancelling are O(1);
+// timers move down a level only when their slot comes up, and all timers
+// expiring in the same tick fire as one batch in the order they were set.
+//
+// Everything runs on the thread that owns the loop.
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+    using ErrorHandler = std::function<void(const std::exception& error)>;
+    // Positive; never reused by one loop
+    using TimerId = uint32_t;
+
+    static constexpr unsigned kWheelBits = 6;
+    static constexpr size_t kWheelSize = size_t{1} << kWheelBits;
+    static constexpr size_t kWheelLevels = 4;
+    // HTML clamps timers nested deeper than this to kMinNestedDelay
+    static constexpr uint32_t kMaxNestingLevel = 5;
+    static constexpr std::chrono::milliseconds kMinNestedDelay{4};
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Tasks. `retained` is kept alive for the collector until the task
+    // has run (or the timer is cleared); callbacks holding JSValues put
+    // them there.
+    void postTask(Callback callback, JSValue retained = JSValue::undefined());
+    void enqueueMicrotask(Callback callback, JSValue retained = JSValue::undefined());
+    // Runs microtasks until the queue is empty, including ones queued meanwhile
+    void performMicrotaskCheckpoint();
+
+    // Timers
+    TimerId setTimeout(Callback callback, std::chrono::milliseconds delay, JSValue retained = JSValue::undefined());
+    TimerId setInterval(Callback callback, std::chrono::milliseconds interval,
+                        JSValue retained = JSValue::undefined());
+    // False if the timer already fired (one-shot) or never existed
+    bool clearTimer(TimerId id);
+
+    // Running. runOneTurn() runs at least one due task if there is any,
+    // then keeps going until the deadline; it returns whether due work is
+    // left over for the next turn.
+    bool runOneTurn(Clock::time_point deadline);
+    // Runs turns, sleeping until timers are due, until no work is left or stop()
+    void run();
+    void stop() { stopRequested_ = true; }
+
+    bool hasPendingWork() const;
+    bool hasDueWork() const;
+    // Earliest pending timer, or Clock::time_point::max() without timers
+    Clock::time_point getNextTimerTime() const;
+
+    // Exceptions escaping a task or microtask; without a handler they are dropped
+    void setErrorHandler(ErrorHandler handler) { errorHandler_ = std::move(handler); }
+
+    // Garbage collection
+    void traceRoots(GC& gc) const;
+
+    // Statistics
+    size_t getPendingTaskCount() const { return tasks_.size() + dueTimers_.size(); }
+    size_t getPendingMicrotaskCount() const { return microtasks_.size() - microtaskHead_; }
+    size_t getActiveTimerCount() const { return timerIndex_.size(); }
+    uint64_t getExecutedTaskCount() const { return executedTasks_; }
+    uint64_t getExecutedMicrotaskCount() const { return executedMicrotasks_; }
+    uint64_t getFiredTimerCount() const { return firedTimers_; }
+    uint64_t getErrorCount() const { return errors_; }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Task {
+        Callback callback;
+        JSValue retained;
+    };
+
+    // Pool entry; prev/next link the wheel slot the timer waits in
+    struct Timer {
+        TimerId id;
+        Callback callback;
+        JSValue retained;
+        uint64_t expiry;   // tick
+        uint64_t interval; // ticks; 0 for one-shot timers
+        uint64_t sequence;
+        uint32_t nesting;
+        uint32_t slot;     // level * kWheelSize + index, or kNone when due
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    Clock::time_point origin_;
+    // Next tick the wheel has not processed yet
+    uint64_t currentTick_;
+
+    std::deque<Task> tasks_;
+    std::vector<Task> microtasks_;
+    size_t microtaskHead_;
+
+    std::vector<Timer> timers_;
+    std::vector<uint32_t> freeTimers_;
+    std::unordered_map<TimerId, uint32_t> timerIndex_;
+    std::array<uint32_t, kWheelSize * kWheelLevels> slots_;
+    std::array<size_t, kWheelLevels> levelCounts_;
+    // Expired timers waiting for their turn; cleared ones are skipped
+    std::deque<TimerId> dueTimers_;
+    std::vector<uint32_t> batch_;
+    TimerId nextTimerId_;
+    uint64_t nextSequence_;
+    // Nesting level of the timer whose callback is running
+    uint32_t currentNesting_;
+    // Values retained by the callbacks currently on the stack
+    std::vector<JSValue> running_;
+    bool performingMicrotasks_;
+
+    ErrorHandler errorHandler_;
+    bool stopRequested_;
+
+    uint64_t executedTasks_;
+    uint64_t executedMicrotasks_;
+    uint64_t firedTimers_;
+    uint64_t errors_;
+
+    // Timers
+    uint64_t tickFor(Clock::time_point time) const;
+    TimerId addTimer(Callback callback, std::chrono::milliseconds delay, bool repeat, JSValue retained);
+    void schedule(uint32_t index);
+    void unlink(uint32_t index);
+    void releaseTimer(uint32_t index);
+    void cascade(size_t level, size_t index);
+    // Processes every tick up to and including `tick`
+    void advanceTo(uint64_t tick);
+
+    void runTask(const Callback& callback, JSValue retained);
+    void fireTimer(TimerId id);
+};
+
+} // namespace js
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "value.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace js {
+
+struct HeapBlock;
+class ReadOnlyHeap;
+
+// Generational garbage-collected heap for cells referenced from JSValue
+//
+// Cells are bump-allocated into block-aligned nursery blocks. A minor
+// collection marks young cells reachable from the roots and the remembered
+// set, destroys the rest and promotes survivors in place: their block
+// joins the old generation. Old cells are reclaimed by a full mark-sweep,
+// and blocks whose cells have all died go back to the nursery pool.
+//
+// Collection only happens at safepoints (collectIfNeeded() / runGC()),
+// where every live value is reachable from a registered root.
+//
+// A heap belongs to one engine and is used from one thread at a time. The
+// only cells it shares are those of an attached ReadOnlyHeap, which it
+// neither marks nor frees.
+class GC {
+public:
+    static constexpr size_t kBlockSize = 256 * 1024;
+    static constexpr size_t kNurseryBlocks = 4;
+    static constexpr size_t kLargeObjectSize = kBlockSize / 4;
+    static constexpr size_t kMinMajorThreshold = 8 * 1024 * 1024;
+
+    using RootTracer = std::function<void(GC&)>;
+
+    GC();
+    ~GC();
+
+    GC(const GC&) = delete;
+    GC& operator=(const GC&) = delete;
+
+    // Allocation
+    template <typename T, typename... Args>
+    T* allocate(Args&&... args) {
+        static_assert(std::is_base_of<Value, T>::value, "GC cells must derive from js::Value");
+        size_t size = cellSize(sizeof(T));
+        void* memory = allocateRaw(size);
+        T* cell = new (memory) T(std::forward<Args>(args)...);
+        registerCell(cell, memory, size);
+        return cell;
+    }
+    // Takes ownership of a legacy heap value; it is kept alive as a root
+    Value* adopt(std::unique_ptr<Value> value);
+    // Excludes a cell from collection for the heap's lifetime
+    void pin(Value* cell);
+
+    // Strings interned from here on come from readOnly when it has them.
+    // Set before anything is interned; the heap keeps readOnly alive.
+    void setReadOnlyHeap(std::shared_ptr<const ReadOnlyHeap> readOnly);
+    const ReadOnlyHeap* readOnlyHeap() const { return readOnlyHeap_.get(); }
+
+    // Convenience constructors
+    JSValue string(const std::string& value);
+    JSValue internedString(const std::string& value);
+    // left + right; long results are ropes over the operands
+    JSValue concat(String* left, String* right);
+    // Code units [start, end) of value, clamped; long results are slices
+    JSValue substring(String* value, size_t start, size_t end);
+    JSValue object();
+    JSValue array();
+
+    // Roots
+    size_t addRoots(RootTracer tracer);
+    void removeRoots(size_t id);
+
+    // Tracing (called from roots and Value::traceChildren)
+    void markValue(JSValue value) {
+        if (value.isCell()) {
+            markCell(value.asCell());
+        }
+    }
+    void markCell(Value* cell);
+    // Scopes and other non-cell containers are traced once per collection
+    uint32_t epoch() const { return epoch_; }
+    bool isMajorCollection() const { return majorInProgress_; }
+
+    // Write barrier slow path
+    void remember(Value* owner);
+
+    // Collection
+    void enableGC() { enabled_ = true; }
+    void disableGC() { enabled_ = false; }
+    bool isEnabled() const { return enabled_; }
+    bool isCollectionRequested() const { return collectionRequested_; }
+    void collectIfNeeded();
+    void collectMinor();
+    void collectMajor();
+    void runGC();
+    // Frees the empty blocks kept for reuse; cells never move, so this is
+    // all a collection can hand back beyond the blocks it empties
+    void releaseFreeBlocks();
+
+    // Statistics
+    size_t getHeapSize() const { return heapSize_; }
+    size_t getHeapUsed() const { return heapUsed_; }
+    size_t getCellCount() const { return cellCount_; }
+    size_t getCollectionCount() const { return minorCollections_ + majorCollections_; }
+    size_t getMinorCollectionCount() const { return minorCollections_; }
+    size_t getMajorCollectionCount() const { return majorCollections_; }
+    size_t getRememberedSetSize() const { return remembered_.size(); }
+    // Strings interned by this heap rather than taken from the shared one
+    size_t getInternedCount() const { return interned_.size(); }
+
+private:
+    std::vector<HeapBlock*> nursery_;
+    std::vector<HeapBlock*> oldBlocks_;
+    std::vector<HeapBlock*> freeBlocks_;
+    size_t currentNursery_;
+
+    std::vector<Value*> remembered_;
+    std::vector<Value*> pinned_;
+    std::vector<std::unique_ptr<Value>> adopted_;
+    std::vector<Value*> markStack_;
+    std::vector<std::pair<size_t, RootTracer>> roots_;
+    std::unordered_map<std::string, JSValue> interned_;
+    std::shared_ptr<const ReadOnlyHeap> readOnlyHeap_;
+    size_t nextRootId_;
+
+    bool enabled_;
+    bool collectionRequested_;
+    bool collecting_;
+    bool majorInProgress_;
+    uint32_t epoch_;
+
+    size_t heapSize_;
+    size_t heapUsed_;
+    size_t oldBytes_;
+    size_t majorThreshold_;
+    size_t cellCount_;
+    size_t minorCollections_;
+    size_t majorCollections_;
+
+    static size_t cellSize(size_t size) { return (size + 15) & ~static_cast<size_t>(15); }
+
+    // Blocks
+    void* allocateRaw(size_t size);
+    void registerCell(Value* cell, void* memory, size_t size);
+    HeapBlock* acquireBlock(size_t size);
+    void releaseBlock(HeapBlock* block);
+
+    // Collection phases
+    void collect(bool major);
+    void traceRoots();
+    void drainMarkStack();
+    void sweep(std::vector<HeapBlock*>& blocks, bool promote);
+};
+
+} // namespace js
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "jsvalue.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace js {
+
+class GC;
+
+// JSON.parse and JSON.stringify over tagged values
+//
+// Both scan string contents 64 bytes at a time (AVX2, SSE2 or NEON, with a
+// scalar fallback) for the bytes that end a run of plain characters:
+// quotes, backslashes and control bytes. Runs between them are copied in
+// bulk, so long strings cost little more than a memcpy.
+//
+// Parsed objects are built in one step once their members are known: the
+// keys walk the shape transition tree, so records of the same layout share
+// one Shape, and the slots are installed with setLayout(). Arrays get their
+// elements at once in the narrowest packed kind that holds them.
+//
+// Stringify appends to a single growing string. Numbers that are not finite
+// become null; undefined and functions are dropped from objects, null in
+// arrays. Errors throw std::runtime_error with a "SyntaxError: " or
+// "TypeError: " message, like the other builtins.
+
+// Calls a reviver, replacer or toJSON method
+using JSONCaller = std::function<JSValue(JSValue callee, JSValue thisValue, const JSValue* arguments, size_t count)>;
+
+// Nesting deeper than this is an error rather than a native stack overflow
+constexpr size_t kMaxJSONDepth = 4096;
+
+JSValue parseJSON(std::string_view text, GC& heap);
+// Walks value bottom up, replacing each member with reviver(holder, key,
+// member) and deleting the ones it returns undefined for
+JSValue reviveJSON(JSValue value, JSValue reviver, GC& heap, const JSONCaller& call);
+
+struct JSONStringifyOptions {
+    // From the space argument; at most 10 characters
+    std::string indent;
+    // A replacer function, called for every member
+    JSValue replacer = JSValue::undefined();
+    // From a replacer array: only these keys of objects are written
+    std::vector<std::string> propertyList;
+    bool hasPropertyList = false;
+    // Without it, replacer functions and toJSON methods are not called
+    JSONCaller call;
+};
+
+// Appends the text of value to out; false when it has none (undefined, a
+// function), which JSON.stringify returns as undefined
+bool stringifyJSON(JSValue value, GC& heap, const JSONStringifyOptions& options, std::string& out);
+
+} // namespace js
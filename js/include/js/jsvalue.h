@@ -0,0 +1,181 @@
+#pragma once
+
+#include "types.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace js {
+
+class Value;
+class String;
+class Object;
+class GC;
+
+// 64-bit NaN-boxed value
+//
+// Doubles are stored as their IEEE-754 bits (every NaN is canonicalised to
+// 0x7FF8'0000'0000'0000). Everything else lives in the negative quiet-NaN
+// space, tagged by the top 16 bits:
+//
+//   0xFFF9  int32 payload in the low 32 bits
+//   0xFFFA  special: undefined, null, false, true, empty
+//   0xFFFB  String* cell
+//   0xFFFC  Object* cell (objects, arrays, functions, errors)
+//
+// Cells are owned by the GC; a JSValue never owns what it points to.
+class JSValue {
+public:
+    static constexpr uint64_t kTagMask = 0xFFFF000000000000ULL;
+    static constexpr uint64_t kPayloadMask = 0x0000FFFFFFFFFFFFULL;
+    static constexpr uint64_t kTagInt32 = 0xFFF9000000000000ULL;
+    static constexpr uint64_t kTagSpecial = 0xFFFA000000000000ULL;
+    static constexpr uint64_t kTagString = 0xFFFB000000000000ULL;
+    static constexpr uint64_t kTagObject = 0xFFFC000000000000ULL;
+    static constexpr uint64_t kCanonicalNaN = 0x7FF8000000000000ULL;
+
+    enum Special : uint64_t {
+        SpecialUndefined = 0,
+        SpecialNull = 1,
+        SpecialFalse = 2,
+        SpecialTrue = 3,
+        // Absent binding / array hole; never visible to scripts
+        SpecialEmpty = 4
+    };
+
+    constexpr JSValue() : bits_(kTagSpecial | SpecialUndefined) {}
+
+    // Construction
+    static constexpr JSValue undefined() { return JSValue(kTagSpecial | SpecialUndefined); }
+    static constexpr JSValue null() { return JSValue(kTagSpecial | SpecialNull); }
+    static constexpr JSValue empty() { return JSValue(kTagSpecial | SpecialEmpty); }
+    static constexpr JSValue boolean(bool value) { return JSValue(kTagSpecial | (value ? SpecialTrue : SpecialFalse)); }
+    static constexpr JSValue int32(int32_t value) {
+        return JSValue(kTagInt32 | static_cast<uint64_t>(static_cast<uint32_t>(value)));
+    }
+    static JSValue fromDouble(double value) {
+        if (std::isnan(value)) {
+            return JSValue(kCanonicalNaN);
+        }
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return JSValue(bits);
+    }
+    // Prefers the int32 encoding when the double is an exact small integer
+    static JSValue number(double value) {
+        if (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max()) {
+            int32_t asInt = static_cast<int32_t>(value);
+            if (static_cast<double>(asInt) == value && !(asInt == 0 && std::signbit(value))) {
+                return int32(asInt);
+            }
+        }
+        return fromDouble(value);
+    }
+    static JSValue string(String* cell) { return JSValue(kTagString | reinterpret_cast<uint64_t>(cell)); }
+    static JSValue object(Object* cell) { return JSValue(kTagObject | reinterpret_cast<uint64_t>(cell)); }
+    static JSValue fromBits(uint64_t bits) { return JSValue(bits); }
+
+    // Boxing to and from the legacy heap Value classes
+    static JSValue fromValue(const Value& value, GC& heap);
+    static JSValue fromValue(std::unique_ptr<Value> value, GC& heap);
+    std::unique_ptr<Value> toValue() const;
+
+    // Type checks
+    bool isInt32() const { return (bits_ & kTagMask) == kTagInt32; }
+    bool isDouble() const { return bits_ < kTagInt32; }
+    bool isNumber() const { return bits_ <= (kTagInt32 | 0xFFFFFFFFULL); }
+    bool isUndefined() const { return bits_ == (kTagSpecial | SpecialUndefined); }
+    bool isNull() const { return bits_ == (kTagSpecial | SpecialNull); }
+    bool isNullish() const { return isUndefined() || isNull(); }
+    bool isBoolean() const { return bits_ == (kTagSpecial | SpecialTrue) || bits_ == (kTagSpecial | SpecialFalse); }
+    bool isEmpty() const { return bits_ == (kTagSpecial | SpecialEmpty); }
+    bool isString() const { return (bits_ & kTagMask) == kTagString; }
+    bool isObject() const { return (bits_ & kTagMask) == kTagObject; }
+    bool isCell() const { return isString() || isObject(); }
+
+    // Payload access (caller checks the type first)
+    int32_t asInt32() const { return static_cast<int32_t>(static_cast<uint32_t>(bits_)); }
+    double asDouble() const {
+        double value;
+        std::memcpy(&value, &bits_, sizeof(value));
+        return value;
+    }
+    double asNumber() const { return isInt32() ? static_cast<double>(asInt32()) : asDouble(); }
+    bool asBoolean() const { return bits_ == (kTagSpecial | SpecialTrue); }
+    Value* asCell() const { return reinterpret_cast<Value*>(bits_ & kPayloadMask); }
+    String* asString() const { return reinterpret_cast<String*>(bits_ & kPayloadMask); }
+    Object* asObject() const { return reinterpret_cast<Object*>(bits_ & kPayloadMask); }
+    uint64_t bits() const { return bits_; }
+
+    // Conversions
+    ValueType type() const;
+    bool toBoolean() const {
+        if (isInt32()) {
+            return asInt32() != 0;
+        }
+        if (isDouble()) {
+            double value = asDouble();
+            return value != 0.0 && !std::isnan(value);
+        }
+        if (isCell()) {
+            return toBooleanSlow();
+        }
+        return bits_ == (kTagSpecial | SpecialTrue);
+    }
+    double toNumber() const {
+        if (isInt32()) {
+            return asInt32();
+        }
+        if (isDouble()) {
+            return asDouble();
+        }
+        return toNumberSlow();
+    }
+    int32_t toInt32() const { return isInt32() ? asInt32() : doubleToInt32(toNumber()); }
+    uint32_t toUint32() const { return static_cast<uint32_t>(toInt32()); }
+    std::string toString() const;
+
+    // Comparison
+    bool strictEquals(JSValue other) const {
+        if (isInt32() && other.isInt32()) {
+            return bits_ == other.bits_;
+        }
+        if (isNumber() && other.isNumber()) {
+            return asNumber() == other.asNumber();
+        }
+        if (isString() && other.isString()) {
+            return stringEquals(other);
+        }
+        return bits_ == other.bits_;
+    }
+    bool looseEquals(JSValue other) const;
+    // Identity of the encoding (same cell, same bits)
+    bool operator==(JSValue other) const { return bits_ == other.bits_; }
+    bool operator!=(JSValue other) const { return bits_ != other.bits_; }
+
+    static int32_t doubleToInt32(double value);
+
+private:
+    constexpr explicit JSValue(uint64_t bits) : bits_(bits) {}
+
+    bool toBooleanSlow() const;
+    double toNumberSlow() const;
+    bool stringEquals(JSValue other) const;
+
+    uint64_t bits_;
+};
+
+static_assert(sizeof(JSValue) == 8, "JSValue must stay one machine word");
+
+// Operators with non-numeric slow paths
+JSValue addValues(JSValue lhs, JSValue rhs, GC& heap);
+bool lessThan(JSValue lhs, JSValue rhs);
+bool lessThanOrEqual(JSValue lhs, JSValue rhs);
+std::string numberToString(double value);
+double stringToNumber(const std::string& text);
+const char* typeOfName(JSValue value);
+
+} // namespace js
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include "script_compiler.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace js {
+
+// One module of a graph, as fetched and compiled
+struct ModuleRecord {
+    // Resolved URL, which identifies the module
+    std::string url;
+    std::string source;
+    // Set when the bytecode tier took the module; otherwise the source is
+    // parsed again for the AST interpreter when it runs
+    std::shared_ptr<BytecodeFunction> function;
+    // Registered modules keep their tree, which their code may refer to
+    std::shared_ptr<const Module> tree;
+    // Resolved URLs of the static imports and re-exports, in source order,
+    // each once
+    std::vector<std::string> dependencies;
+    // Seconds spent parsing and compiling
+    double compileTime = 0.0;
+};
+
+// Loads ES module graphs
+//
+// load() resolves the entry specifier and follows the static imports and
+// re-exports of every module it reaches. Each URL seen for the first time
+// is fetched, parsed and compiled as one job on the ScriptCompiler pool, so
+// the imports of a module load side by side rather than in a waterfall,
+// and a URL reached from many modules loads once. When the last job is in,
+// a single depth-first pass links the graph into evaluation order:
+// dependencies before their dependents, with cycles cut at the edge that
+// closes them.
+//
+// Records are kept after a load, so later loads of the same URLs, from the
+// next document on the same origin, skip the fetch and the compile.
+// navigate() drops the records of every other origin, and purge() those no
+// graph handed out still holds, as under memory pressure. A Loader belongs to
+// one engine and is used from its thread; only the jobs run elsewhere.
+class Loader {
+public:
+    // Fills source with the module at url; false when it cannot be had.
+    // Runs on the pool threads, so must be safe to call concurrently.
+    using Fetcher = std::function<bool(const std::string& url, std::string& source)>;
+
+    // Fetches files: file:// URLs and plain paths
+    Loader();
+
+    void setFetcher(Fetcher fetcher);
+
+    // "./" and "../" are resolved against referrer's directory and "/"
+    // against its origin; URLs with a scheme and bare specifiers are kept
+    static std::string resolve(const std::string& specifier, const std::string& referrer);
+    // "scheme://host" for URLs with an authority, "file://" for paths
+    static std::string originOf(const std::string& url);
+
+    // The graph in evaluation order, entry last. Empty with error set when
+    // any module failed to fetch or parse; the records that did load are
+    // kept for the next attempt.
+    std::vector<std::shared_ptr<const ModuleRecord>> load(const std::string& specifier, const std::string& referrer,
+                                                          ScriptCompiler& compiler, bool bytecode, std::string& error);
+
+    // Keeps only the records from url's origin
+    void navigate(const std::string& url);
+    void clear();
+    // Drops the records only the loader holds, which later loads fetch and
+    // compile again; returns how many went
+    size_t purge();
+
+    // Single modules, parsed on the calling thread without their imports
+    std::unique_ptr<Module> loadModule(const std::string& specifier);
+    std::unique_ptr<Module> loadModule(const std::string& specifier, const std::string& referrer);
+    // Stands in for the fetch of specifier's URL, once
+    void registerModule(const std::string& specifier, std::unique_ptr<Module> module);
+
+    // Statistics
+    size_t getRecordCount() const { return records_.size(); }
+    uint64_t getFetchCount() const { return fetchCount_; }
+    // Modules a load found already loaded
+    uint64_t getReuseCount() const { return reuseCount_; }
+    // Bytes of the records' sources, URLs and bytecode
+    size_t memoryUsage() const;
+
+private:
+    Fetcher fetcher_;
+    std::unordered_map<std::string, std::shared_ptr<const ModuleRecord>> records_;
+    std::unordered_map<std::string, std::unique_ptr<Module>> registered_;
+    uint64_t fetchCount_;
+    uint64_t reuseCount_;
+
+    std::shared_ptr<const ModuleRecord> makeRecord(const std::string& url, CompiledScript script) const;
+    std::shared_ptr<const ModuleRecord> makeRecord(const std::string& url, std::unique_ptr<Module> module,
+                                                   std::string& error) const;
+    static std::vector<std::shared_ptr<const ModuleRecord>> link(
+        const std::shared_ptr<const ModuleRecord>& entry,
+        const std::unordered_map<std::string, std::shared_ptr<const ModuleRecord>>& graph);
+};
+
+} // namespace js
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "bytecode.h"
+#include "jsvalue.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Native baseline code is generated for x86-64 System V targets; elsewhere
+// the Optimizer still counts but functions stay on the interpreter.
+// Define JS_BASELINE_JIT=0 to turn the backend off.
+#ifndef JS_BASELINE_JIT
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JS_BASELINE_JIT 1
+#else
+#define JS_BASELINE_JIT 0
+#endif
+#endif
+
+namespace js {
+
+class Node;
+
+// Why baseline code returned to the interpreter. In every case the
+// register window is exactly what the interpreter expects at the returned
+// pc, so leaving costs nothing but the exit itself.
+enum class BaselineExit : uint32_t {
+    Interpret,  // instruction without a native translation (calls, returns, ...)
+    Deoptimize, // a type guard failed; the interpreter runs the generic path
+    Safepoint,  // back-edge budget used up; pc is the loop head
+    Throw       // a helper raised; the VM's pending exception is set
+};
+
+// State shared between the VM and running baseline code
+struct BaselineFrame {
+    // Current register window; helpers refresh it after the VM may have
+    // grown the register stack
+    JSValue* regs;
+    void* vm;
+    // Back-edges left before a Safepoint exit
+    uint32_t fuel;
+    BaselineExit exit;
+};
+
+// VM entry points for instructions compiled as calls (property and binding
+// access). They run the instruction at pc of the innermost frame and
+// return nonzero if it threw.
+struct BaselineHelpers {
+    using Helper = uint32_t (*)(BaselineFrame* frame, uint32_t pc);
+
+    Helper loadName;
+    Helper storeName;
+    Helper declareName;
+    Helper loadSlot;
+    Helper storeSlot;
+    Helper getProperty;
+    Helper setProperty;
+    Helper getElement;
+    Helper setElement;
+};
+
+// Template-compiled native code for one bytecode function
+//
+// Every instruction becomes a fixed machine-code sequence operating on the
+// VM's register window in memory, so any pc is a valid entry point (the
+// interpreter can hop in at loop heads and after calls) and any exit is a
+// deoptimization point. int32 arithmetic, comparisons, booleans and jumps
+// run inline behind tag guards; property and binding access call back into
+// the VM, which keeps using the inline caches.
+class BaselineCode {
+public:
+    static constexpr uint32_t kFuel = 4096;
+
+    ~BaselineCode();
+
+    BaselineCode(const BaselineCode&) = delete;
+    BaselineCode& operator=(const BaselineCode&) = delete;
+
+    // Null when the target has no backend or the function cannot be compiled
+    // (constants must already be materialized)
+    static std::shared_ptr<BaselineCode> compile(const BytecodeFunction& function, const BaselineHelpers& helpers);
+
+    // Runs from pc until an exit; returns the pc to resume interpreting at
+    uint32_t run(BaselineFrame& frame, uint32_t pc) const { return entry_(&frame, pc); }
+
+    size_t size() const { return size_; }
+
+private:
+    using Entry = uint32_t (*)(BaselineFrame* frame, uint32_t pc);
+
+    BaselineCode(void* memory, size_t size);
+
+    void* memory_;
+    size_t size_;
+    Entry entry_;
+};
+
+// Tier-up policy for the bytecode VM
+//
+// Functions start on the interpreter. One that is called kCallThreshold
+// times, or loops kBackEdgeThreshold times, gets baseline code; after
+// kMaxDeoptimizations guard failures the code is dropped and the function
+// stays interpreted. While enabled it also runs the ASTOptimizer over each
+// tree before the tree is compiled.
+class Optimizer {
+public:
+    static constexpr uint32_t kCallThreshold = 100;
+    static constexpr uint32_t kBackEdgeThreshold = 1000;
+    static constexpr uint32_t kMaxDeoptimizations = 16;
+
+    Optimizer();
+    ~Optimizer();
+
+    void enableOptimization() { enabled_ = true; }
+    void disableOptimization() { enabled_ = false; }
+    bool isEnabled() const { return enabled_; }
+
+    // Whether this build can generate native code at all
+    static bool isSupported() { return JS_BASELINE_JIT != 0; }
+
+    void setHelpers(const BaselineHelpers& helpers) { helpers_ = helpers; }
+
+    // VM hooks
+    void onCall(BytecodeFunction& function) {
+        if (enabled_ && !function.baseline && ++function.tier.calls >= kCallThreshold) {
+            tierUp(function);
+        }
+    }
+    // True when the loop can continue in baseline code
+    bool onBackEdge(BytecodeFunction& function) {
+        if (!enabled_) {
+            return false;
+        }
+        if (!function.baseline && ++function.tier.backEdges >= kBackEdgeThreshold) {
+            tierUp(function);
+        }
+        return function.baseline != nullptr;
+    }
+    void onDeoptimize(BytecodeFunction& function);
+
+    // Folds constants and drops dead branches of root before compilation
+    void optimizeTree(Node* root);
+
+    // Statistics
+    size_t getCompiledFunctionCount() const { return compiledFunctions_; }
+    size_t getFailedCompilationCount() const { return failedCompilations_; }
+    size_t getDeoptimizationCount() const { return deoptimizations_; }
+    size_t getInvalidationCount() const { return invalidations_; }
+    size_t getCodeSize() const { return codeSize_; }
+    size_t getFoldedExpressionCount() const { return foldedExpressions_; }
+    size_t getEliminatedBranchCount() const { return eliminatedBranches_; }
+
+private:
+    bool enabled_;
+    BaselineHelpers helpers_;
+
+    size_t compiledFunctions_;
+    size_t failedCompilations_;
+    size_t deoptimizations_;
+    size_t invalidations_;
+    size_t codeSize_;
+    size_t foldedExpressions_;
+    size_t eliminatedBranches_;
+
+    void tierUp(BytecodeFunction& function);
+};
+
+} // namespace js
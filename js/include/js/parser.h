@@ -2,7 +2,9 @@
 
 #include "tokenizer.h"
 #include "ast.h"
+#include <deque>
 #include <memory>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
@@ -104,32 +106,35 @@ public:
     std::unique_ptr<Pattern> parseAssignmentPattern();
 
     // Parameter parsing
-    std::vector<std::unique_ptr<Parameter>> parseParameters();
+    NodeList<Parameter> parseParameters();
     std::unique_ptr<Parameter> parseParameter();
 
+    // Pre-parsing: skips a function body, starting at its opening brace
+    std::unique_ptr<PreparseData> preparseFunctionBody(size_t functionStart, const NodeList<Parameter>& params);
+
     // Property parsing
-    std::vector<std::unique_ptr<Property>> parseProperties();
+    NodeList<Property> parseProperties();
     std::unique_ptr<Property> parseProperty();
 
     // Element parsing
-    std::vector<std::unique_ptr<Element>> parseElements();
+    NodeList<Element> parseElements();
     std::unique_ptr<Element> parseElement();
 
     // Clause parsing
-    std::vector<std::unique_ptr<CaseClause>> parseCaseClauses();
+    NodeList<CaseClause> parseCaseClauses();
     std::unique_ptr<CaseClause> parseCaseClause();
 
     // Catch clause parsing
     std::unique_ptr<CatchClause> parseCatchClause();
 
     // Import/Export parsing
-    std::vector<std::unique_ptr<ImportSpecifier>> parseImportSpecifiers();
+    NodeList<ImportSpecifier> parseImportSpecifiers();
     std::unique_ptr<ImportSpecifier> parseImportSpecifier();
-    std::vector<std::unique_ptr<ExportSpecifier>> parseExportSpecifiers();
+    NodeList<ExportSpecifier> parseExportSpecifiers();
     std::unique_ptr<ExportSpecifier> parseExportSpecifier();
 
     // Template parsing
-    std::vector<std::unique_ptr<TemplateElement>> parseTemplateElements();
+    NodeList<TemplateElement> parseTemplateElements();
     std::unique_ptr<TemplateElement> parseTemplateElement();
 
     // Meta property parsing
@@ -168,6 +173,7 @@ public:
     void advance();
     void retreat();
     bool hasMoreTokens() const;
+    void fill(size_t count) const;
 
     // Token checking
     bool isToken(TokenType type) const;
@@ -176,6 +182,9 @@ public:
     bool isKeyword(const std::string& keyword) const;
     bool isOperator(const std::string& op) const;
     bool isPunctuation(const std::string& punct) const;
+    // "async function" (async is also a valid identifier elsewhere)
+    bool isAsyncFunction() const;
+    bool isStartOfImportExpression() const;
 
     // Expect methods
     Token expect(TokenType type);
@@ -212,6 +221,17 @@ public:
     void setStrictMode(bool strict) { strictMode_ = strict; }
     bool isModuleMode() const { return moduleMode_; }
     void setModuleMode(bool module) { moduleMode_ = module; }
+    // Allocate each parse's tree from an arena owned by the returned AST
+    bool isArenaAllocation() const { return arenaAllocation_; }
+    void setArenaAllocation(bool arena) { arenaAllocation_ = arena; }
+    // Pre-parse function bodies and leave them to be parsed on first call;
+    // functions that look immediately invoked are still parsed eagerly
+    bool isLazyFunctions() const { return lazyFunctions_; }
+    void setLazyFunctions(bool lazy) { lazyFunctions_ = lazy; }
+    size_t getPreparsedFunctionCount() const { return preparsedFunctionCount_; }
+
+    bool hasErrors() const { return !errors_.empty(); }
+    const std::vector<ParseError>& errors() const { return errors_; }
 
     // Parser options
     void setOptions(const ParserOptions& options);
@@ -529,13 +549,19 @@ public:
 private:
     // Core components
     std::string source_;
-    Tokenizer tokenizer_;
-    std::vector<Token> tokens_;
+    mutable Tokenizer tokenizer_;
+    mutable std::deque<Token> lookahead_;
+    Token previous_;
     size_t position_;
 
     // Parser state
     bool strictMode_;
     bool moduleMode_;
+    bool arenaAllocation_;
+    bool lazyFunctions_;
+    size_t preparsedFunctionCount_;
+    // Copy of the source shared with pre-parsed functions
+    std::shared_ptr<const std::string> sharedSource_;
     bool jsxMode_;
     bool typescriptMode_;
     bool flowMode_;
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace js {
+
+// Sampling CPU profiler for script code
+//
+// A background thread raises a flag once per sampling interval. The VM
+// checks it at its safepoints (loop back-edges and calls) and reports its
+// frame stack there, so the running code never stops for a signal and a
+// sample costs one short vector of frame ids. Frames are interned by
+// function name and source position.
+//
+// Samples are recorded and exported on the thread running the VM; only
+// the flag is shared with the sampler thread.
+class Profiler {
+public:
+    static constexpr std::chrono::microseconds kDefaultInterval{1000};
+
+    // One distinct (function, position) pair seen in a sample
+    struct Frame {
+        std::string function;
+        TokenPosition position;
+    };
+
+    struct Sample {
+        // Microseconds since startProfiling()
+        uint64_t timestamp;
+        // Indices into frames(), outermost first
+        std::vector<uint32_t> stack;
+    };
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Profiling lifecycle; starting again keeps earlier samples
+    void startProfiling();
+    void stopProfiling();
+    bool isProfiling() const { return running_; }
+
+    void setSamplingInterval(std::chrono::microseconds interval);
+    std::chrono::microseconds getSamplingInterval() const { return interval_; }
+
+    // VM side
+    bool isSampleRequested() const { return sampleRequested_.load(std::memory_order_relaxed); }
+    // Starts a sample and returns its (empty) stack to push frame ids onto
+    std::vector<uint32_t>& beginSample();
+    uint32_t internFrame(const std::string& function, const TokenPosition& position);
+
+    // Results
+    const std::vector<Frame>& frames() const { return frames_; }
+    const std::vector<Sample>& samples() const { return samples_; }
+    void clear();
+
+    // "outer;inner count" lines, as consumed by flamegraph.pl and speedscope
+    std::string exportCollapsedStacks() const;
+    // Chrome trace event JSON (chrome://tracing, Perfetto)
+    std::string exportChromeTrace() const;
+
+    // Statistics
+    size_t getSampleCount() const { return samples_.size(); }
+    size_t getFrameCount() const { return frames_.size(); }
+
+private:
+    struct FrameKey {
+        std::string function;
+        size_t line;
+        size_t column;
+
+        bool operator==(const FrameKey& other) const {
+            return line == other.line && column == other.column && function == other.function;
+        }
+    };
+
+    struct FrameKeyHash {
+        size_t operator()(const FrameKey& key) const {
+            return std::hash<std::string>()(key.function) ^ (key.line * 0x9E3779B97F4A7C15ull) ^ (key.column << 20);
+        }
+    };
+
+    std::vector<Frame> frames_;
+    std::unordered_map<FrameKey, uint32_t, FrameKeyHash> frameIndex_;
+    std::vector<Sample> samples_;
+
+    std::chrono::microseconds interval_;
+    std::chrono::steady_clock::time_point startTime_;
+    uint64_t timeOffset_;
+    bool running_;
+
+    // Sampler thread
+    std::atomic<bool> sampleRequested_;
+    std::thread sampler_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopRequested_;
+
+    void samplerLoop();
+    std::string frameLabel(uint32_t frame) const;
+};
+
+} // namespace js
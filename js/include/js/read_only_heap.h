@@ -0,0 +1,55 @@
+#pragma once
+
+#include "jsvalue.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace js {
+
+class String;
+class Value;
+
+// Immutable cells shared by every engine in a process
+//
+// Engines run side by side, one per tab or worker, each on its own thread
+// with a private GC heap. Strings every engine interns (builtin and
+// property names, typeof results) are allocated once here instead and
+// handed out by GC::internedString() of any heap the table is attached to.
+//
+// Nothing here is written after create(): each string is flat, and its
+// hash and UTF-8 form are computed up front, so the lazily filled caches
+// of String are already full. The cells carry GCFlagReadOnly and not
+// GCFlagManaged, so a collector marking through them never touches their
+// header, and GCFlagOld, so storing them into an old object takes no write
+// barrier. They are never freed while an engine holds the heap.
+class ReadOnlyHeap {
+public:
+    ~ReadOnlyHeap();
+
+    ReadOnlyHeap(const ReadOnlyHeap&) = delete;
+    ReadOnlyHeap& operator=(const ReadOnlyHeap&) = delete;
+
+    // Duplicates are kept once
+    static std::shared_ptr<const ReadOnlyHeap> create(const std::vector<std::string>& strings);
+
+    // The shared cell for text, or JSValue::empty()
+    JSValue findString(std::string_view text) const;
+    bool contains(const Value* cell) const;
+
+    // Statistics
+    size_t getStringCount() const { return strings_.size(); }
+    size_t getByteCount() const { return bytes_; }
+
+private:
+    std::vector<std::unique_ptr<String>> strings_;
+    std::unordered_map<std::string_view, JSValue> index_;
+    size_t bytes_;
+
+    ReadOnlyHeap();
+};
+
+} // namespace js
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace js {
+
+// A script parsed and compiled ahead of execution
+//
+// function is set when the bytecode tier compiled the script; otherwise ast
+// holds the tree for the AST interpreter. Nothing in it refers to a GC heap
+// or a VM, so it can be built on any thread and run by any engine.
+struct CompiledScript {
+    std::string source;
+    std::shared_ptr<BytecodeFunction> function;
+    std::unique_ptr<AST> ast;
+    // Seconds spent parsing and compiling
+    double compileTime = 0.0;
+    // The compiler rejected the script and ast is the fallback
+    bool bytecodeFallback = false;
+    // For modules, the specifiers of the static imports and re-exports in
+    // source order
+    std::vector<std::string> moduleRequests;
+};
+
+// Worker pool that tokenizes, parses and compiles scripts in parallel
+//
+// Tokenizer, Parser and Compiler keep all of their state per instance and
+// AST arenas are installed per thread, so each job builds its own and the
+// workers share nothing but the job queue. Threads are started with the
+// first job, so an engine that never compiles in the background costs none.
+class ScriptCompiler {
+public:
+    // 0 picks one thread less than the hardware has, and at least one
+    explicit ScriptCompiler(size_t threadCount = 0);
+    // Jobs that have not started are dropped; their futures report
+    // std::future_errc::broken_promise
+    ~ScriptCompiler();
+
+    ScriptCompiler(const ScriptCompiler&) = delete;
+    ScriptCompiler& operator=(const ScriptCompiler&) = delete;
+
+    // Jobs run in submission order as workers free up
+    std::future<CompiledScript> compile(std::string source, bool bytecode = true);
+    // Any other job that ends in a compile, such as fetching a module first
+    std::future<CompiledScript> submit(std::function<CompiledScript()> job);
+    // The same work on the calling thread
+    static CompiledScript compileNow(std::string source, bool bytecode = true);
+    // compileNow() in module mode, listing the module's requests
+    static CompiledScript compileModuleNow(std::string source, bool bytecode = true);
+
+    // Statistics
+    size_t getThreadCount() const { return threadCount_; }
+    size_t getPendingCount() const;
+    uint64_t getCompletedCount() const { return completed_.load(std::memory_order_relaxed); }
+
+private:
+    size_t threadCount_;
+    std::vector<std::thread> workers_;
+    std::deque<std::packaged_task<CompiledScript()>> jobs_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopRequested_;
+    std::atomic<uint64_t> completed_;
+
+    void workerLoop();
+    static CompiledScript compileSource(std::string source, bool bytecode, bool module);
+};
+
+// Specifiers of module's static imports and re-exports, in source order
+std::vector<std::string> moduleRequests(const Module& module);
+
+} // namespace js
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace js {
+
+// Hidden class describing an object's property layout
+//
+// Shapes form a transition tree rooted at Shape::root(): adding property
+// "x" to an object with shape S moves it to S's child for "x", so objects
+// built the same way share one Shape and keep their values in a flat slot
+// vector at the same offsets. Shapes are immutable once created apart from
+// their transition table and are never freed before process exit.
+//
+// The tree is shared by every engine in the process, which may run on
+// different threads: transition tables sit behind one process-wide lock,
+// taken shared to follow an existing transition, and the lookup table of a
+// long chain is published atomically by whichever thread builds it first.
+class Shape {
+public:
+    static constexpr uint32_t kNotFound = 0xFFFFFFFFu;
+
+    ~Shape();
+
+    // Empty layout every new object starts from
+    static Shape* root();
+
+    const Shape* parent() const { return parent_; }
+    const std::string& key() const { return key_; }
+    uint32_t slotCount() const { return slotCount_; }
+
+    // Slot index of name, or kNotFound
+    uint32_t lookup(const std::string& name) const;
+
+    // Transitions
+    Shape* addProperty(const std::string& name);
+    Shape* removeProperty(const std::string& name, uint32_t* removedSlot);
+
+    // Property names in slot order
+    std::vector<std::string> keys() const;
+
+    // Statistics
+    static size_t getShapeCount();
+    size_t getTransitionCount() const;
+
+private:
+    Shape(Shape* parent, std::string key, uint32_t slotCount);
+
+    Shape* parent_;
+    std::string key_;
+    uint32_t slotCount_;
+    std::unordered_map<std::string, std::unique_ptr<Shape>> transitions_;
+
+    // name -> slot, built on first lookup of a long chain
+    mutable std::atomic<const std::unordered_map<std::string, uint32_t>*> table_;
+};
+
+} // namespace js
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "vm.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace js {
+
+class Shape;
+
+// Flattened image of the builtin objects on a global object
+//
+// capture() walks the heap objects reachable from a range of the global's
+// properties and records each one as an entry: its final Shape and its
+// slots as raw primitive bits, string texts, or indices of other entries.
+// restore() allocates every entry in one pass, installs each layout in one
+// step (no shape transitions, lookups or slot growth) and then patches the
+// entry indices into pointers, which is the whole relocation.
+//
+// Shapes live for the process, so an image is only valid in the process
+// that captured it; it is immutable and can be shared by any number of
+// engines. Native functions keep their callback unless it closes over an
+// engine, in which case the function's rebinder builds it anew from the
+// restoring engine's SnapshotBindings.
+class HeapSnapshot {
+public:
+    // Records global's properties from slot firstSlot on. Returns nullptr
+    // if they reach an object other than plain objects and native functions.
+    static std::shared_ptr<const HeapSnapshot> capture(const Object& global, uint32_t firstSlot);
+
+    // Adds the recorded properties to global, in capture order
+    void restore(Object& global, const SnapshotBindings& bindings) const;
+
+    // Statistics
+    size_t getObjectCount() const { return entries_.size(); }
+    size_t getGlobalCount() const { return globals_.size(); }
+
+private:
+    struct Slot {
+        enum class Kind : uint8_t { Value, String, Object };
+        Kind kind;
+        // Value: JSValue bits; String: index into strings_; Object: entry index
+        uint64_t payload;
+    };
+
+    struct Entry {
+        Shape* shape;
+        // Range of slots_
+        uint32_t firstSlot;
+        // Native functions only
+        bool native;
+        std::string name;
+        NativeCallback callback;
+        NativeRebinder rebinder;
+    };
+
+    struct Global {
+        std::string name;
+        Slot value;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<Slot> slots_;
+    std::vector<std::string> strings_;
+    std::vector<Global> globals_;
+
+    HeapSnapshot() = default;
+};
+
+} // namespace js
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace js {
+
+// Run scanning for the tokenizer
+//
+// Minified bundles are mostly long identifiers, string literals and
+// template text, and pretty-printed ones add long runs of indentation and
+// comments. Each function below returns the offset of the first byte at or
+// after position that ends its kind of run, or text.size(), testing 64
+// bytes at a time once a run has outlasted a short scalar probe. Bytes of
+// 0x80 and up are never whitespace or identifier characters, as for the
+// <cctype> tests the tokenizer used before.
+
+// First byte that is not ' ', '\t', '\n', '\v', '\f' or '\r'
+size_t skipWhitespaceRun(std::string_view text, size_t position);
+// First byte that is not an ASCII letter, digit, '_' or '$'
+size_t skipIdentifierRun(std::string_view text, size_t position);
+// First '\n' or '\r'
+size_t findLineEnd(std::string_view text, size_t position);
+// Offset of the next "*/"
+size_t findBlockCommentEnd(std::string_view text, size_t position);
+// First quote or backslash
+size_t findStringStop(std::string_view text, size_t position, char quote);
+// First '`', backslash or '$'
+size_t findTemplateStop(std::string_view text, size_t position);
+
+// Instruction sets the scanners are built for
+enum class ScanIsa {
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+// Kernel selection
+ScanIsa scanIsa();
+// The widest set this CPU runs
+ScanIsa bestScanIsa();
+// Forces a set, for comparing kernels; fails if the CPU cannot run it
+bool setScanIsa(ScanIsa isa);
+
+} // namespace js
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "types.h"
+#include "atoms.h"
+#include <cstdint>
+#include <deque>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -186,21 +190,36 @@ enum class TokenType {
     Space
 };
 
+// Scan position of a token boundary; line and column are 1-based
+struct SourceMark {
+    uint32_t offset = 0;
+    uint32_t line = 1;
+    uint32_t column = 1;
+};
+
 // Token class
+//
+// Tokens are views: value() points into the tokenizer's source, or into
+// its cooked-literal storage for strings with escapes, and stays valid
+// until the tokenizer is given a new source or reset.
 class Token {
 public:
     Token();
-    Token(TokenType type, const String& value, const TokenPosition& position);
-    ~Token();
+    Token(TokenType type, std::string_view value, const SourceMark& start, const SourceMark& end,
+          Atom atom = AtomTable::kNone);
 
     TokenType type() const { return type_; }
     void setType(TokenType type) { type_ = type; }
 
-    const String& value() const { return value_; }
-    void setValue(const String& value) { value_ = value; }
+    std::string_view value() const { return value_; }
+    void setValue(std::string_view value) { value_ = value; }
 
-    const TokenPosition& position() const { return position_; }
-    void setPosition(const TokenPosition& position) { position_ = position; }
+    // Interned name of identifiers and keywords, AtomTable::kNone otherwise
+    Atom atom() const { return atom_; }
+
+    const SourceMark& start() const { return start_; }
+    const SourceMark& end() const { return end_; }
+    TokenPosition position() const;
 
     bool isKeyword() const;
     bool isReservedWord() const;
@@ -220,8 +239,10 @@ public:
 
 private:
     TokenType type_;
-    String value_;
-    TokenPosition position_;
+    Atom atom_;
+    std::string_view value_;
+    SourceMark start_;
+    SourceMark end_;
 };
 
 // Tokenizer class
@@ -234,6 +255,11 @@ public:
     void setSource(const String& source);
     const String& source() const { return source_; }
 
+    // Identifier names are interned here; by default the tokenizer's own
+    // table, or one shared with other tokenizers via setAtomTable()
+    AtomTable& atoms() { return sharedAtoms_ ? *sharedAtoms_ : ownAtoms_; }
+    void setAtomTable(AtomTable* atoms) { sharedAtoms_ = atoms; }
+
     Vector<Token> tokenize();
     Token nextToken();
     Token peekToken();
@@ -241,7 +267,9 @@ public:
 
     bool hasMoreTokens() const;
     size_t position() const { return position_; }
-    void setPosition(size_t position) { position_ = position; }
+    void setPosition(size_t position);
+    // Jumps to a mark taken from this source without rescanning up to it
+    void setMark(const SourceMark& mark);
 
     void reset();
     void skipWhitespace();
@@ -256,6 +284,16 @@ public:
     Token readTemplateLiteral();
     Token readRegExp();
 
+    // Template literal scanning, shared with the parser. A template token
+    // is the raw text between its backticks, substitutions included.
+    // scanTemplateBody returns the offset of the closing backtick (or the
+    // end of text); scanTemplateSubstitution, given the offset just past
+    // "${", returns the offset just past its closing '}'.
+    static size_t scanTemplateBody(std::string_view text, size_t position);
+    static size_t scanTemplateSubstitution(std::string_view text, size_t position);
+    // Text between substitutions with its escapes applied
+    static std::string cookTemplateSpan(std::string_view raw);
+
     char currentChar() const;
     char nextChar() const;
     char peekChar() const;
@@ -263,6 +301,8 @@ public:
 
     void advance();
     void advance(size_t count);
+    // Moves to end, at or after position(), counting lines in one pass
+    void advanceTo(size_t end);
     void retreat();
     void retreat(size_t count);
 
@@ -281,9 +321,10 @@ public:
 
     TokenPosition getCurrentPosition() const;
     SourceLocation getCurrentLocation() const;
+    SourceMark getCurrentMark() const;
 
-    bool isKeyword(const String& value) const;
-    bool isReservedWord(const String& value) const;
+    bool isKeyword(std::string_view value) const;
+    bool isReservedWord(std::string_view value) const;
     bool isOperator(const String& value) const;
     bool isPunctuation(const String& value) const;
 
@@ -492,7 +533,18 @@ public:
 private:
     String source_;
     size_t position_;
+    uint32_t line_;
+    uint32_t column_;
     String filename_;
+
+    AtomTable ownAtoms_;
+    AtomTable* sharedAtoms_;
+    // Literal text that differs from its source spelling (escapes)
+    std::deque<std::string> cooked_;
+
+    std::string_view slice(size_t begin, size_t end) const;
+    std::string_view cook(std::string value);
+
     bool strictMode_;
     bool moduleMode_;
     bool jsxMode_;
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "types.h"
+#include "jsvalue.h"
+#include "shape.h"
 #include <memory>
 #include <string>
 #include <vector>
@@ -118,14 +120,41 @@ public:
     virtual bool isMarked() const = 0;
     virtual void unmark() = 0;
 
+    // Collector header bits (see GCFlag) and outgoing references
+    uint8_t gcFlags() const { return gcFlags_; }
+    void setGCFlags(uint8_t flags) { gcFlags_ = flags; }
+    virtual void traceChildren(GC&) const {}
+
     // Debugging
     virtual std::string debugString() const = 0;
     virtual void dump() const = 0;
 
 protected:
     ValueType type_;
+    uint8_t gcFlags_ = 0;
+};
+
+// Cell header bits maintained by js::GC
+enum GCFlag : uint8_t {
+    GCFlagManaged = 1 << 0,    // allocated by a GC heap
+    GCFlagOld = 1 << 1,        // survived a collection
+    GCFlagMarked = 1 << 2,     // reached during the current collection
+    GCFlagRemembered = 1 << 3, // old cell in the remembered set
+    GCFlagPinned = 1 << 4,     // never collected (constants, interned names)
+    GCFlagReadOnly = 1 << 5    // in a ReadOnlyHeap shared between engines
 };
 
+// Generational write barrier: an old cell that starts pointing at a young
+// one is added to its heap's remembered set so minor collections see it.
+void rememberCell(Value* owner);
+
+inline void writeBarrier(Value* owner, JSValue value) {
+    if ((owner->gcFlags() & (GCFlagOld | GCFlagRemembered)) == GCFlagOld && value.isCell() &&
+        !(value.asCell()->gcFlags() & GCFlagOld)) {
+        rememberCell(owner);
+    }
+}
+
 // Object Value
 class Object : public Value {
 public:
@@ -212,9 +241,62 @@ public:
     std::string debugString() const override;
     void dump() const override;
 
+    // Tagged property slots (JSValue::empty() when absent)
+    JSValue get(const std::string& name) const {
+        uint32_t slot = shape_->lookup(name);
+        return slot != Shape::kNotFound ? slots_[slot] : JSValue::empty();
+    }
+    void put(const std::string& name, JSValue value) {
+        writeBarrier(this, value);
+        uint32_t slot = shape_->lookup(name);
+        if (slot != Shape::kNotFound) {
+            slots_[slot] = value;
+            return;
+        }
+        shape_ = shape_->addProperty(name);
+        slots_.push_back(value);
+    }
+    bool has(const std::string& name) const { return shape_->lookup(name) != Shape::kNotFound; }
+    bool remove(const std::string& name) {
+        uint32_t slot = Shape::kNotFound;
+        shape_ = shape_->removeProperty(name, &slot);
+        if (slot == Shape::kNotFound) {
+            return false;
+        }
+        slots_.erase(slots_.begin() + slot);
+        return true;
+    }
+
+    // Shape-level access used by inline caches
+    Shape* shape() const { return shape_; }
+    JSValue slotAt(uint32_t slot) const { return slots_[slot]; }
+    void setSlot(uint32_t slot, JSValue value) {
+        writeBarrier(this, value);
+        slots_[slot] = value;
+    }
+    // Cached add-property transition; newShape must be shape()->addProperty(name)
+    void appendSlot(Shape* newShape, JSValue value) {
+        writeBarrier(this, value);
+        shape_ = newShape;
+        slots_.push_back(value);
+    }
+    const std::vector<JSValue>& slotValues() const { return slots_; }
+    // Whole layout at once, for snapshot restore; slots.size() must be
+    // shape->slotCount()
+    void setLayout(Shape* shape, std::vector<JSValue> slots) {
+        for (JSValue value : slots) {
+            writeBarrier(this, value);
+        }
+        shape_ = shape;
+        slots_ = std::move(slots);
+    }
+
+    // Garbage collection
+    void traceChildren(GC& gc) const override;
+
 private:
-    std::unordered_map<std::string, std::unique_ptr<Value>> properties_;
-    std::unordered_map<size_t, std::unique_ptr<Value>> elements_;
+    Shape* shape_ = Shape::root();
+    std::vector<JSValue> slots_;
     bool marked_;
 };
 
@@ -252,6 +334,18 @@ private:
     std::unique_ptr<FunctionDeclaration> declaration_;
 };
 
+// Element storage kinds, most specialised first. An array only ever moves
+// down the list: a double stored into a PackedInt32 array makes it
+// PackedDouble, any other value makes it Packed, a hole makes it Holey and a
+// store far past the end makes it a sparse Dictionary.
+enum class ElementsKind : uint8_t {
+    PackedInt32,  // int32 JSValues, no holes
+    PackedDouble, // raw doubles (never int32-tagged), no holes
+    Packed,       // any value, no holes
+    Holey,        // any value, holes are JSValue::empty()
+    Dictionary    // index -> value map, for arrays too sparse to store densely
+};
+
 // Array Value
 class Array : public Object {
 public:
@@ -287,18 +381,112 @@ public:
     std::unique_ptr<Value> clone() const override;
     std::unique_ptr<Value> deepClone() const override;
 
+    // Tagged element storage; holes and absent indices read as
+    // JSValue::empty(). The inline paths handle stores that keep the
+    // current kind; everything else goes through a transition.
+    static constexpr size_t kMaxHoleGap = 1024;
+
+    using Object::put;
+    ElementsKind elementsKind() const { return kind_; }
+    size_t length() const { return kind_ == ElementsKind::Dictionary ? dictionaryLength_ : elements_.size(); }
+    JSValue at(size_t index) const {
+        if (index < elements_.size()) {
+            return elements_[index];
+        }
+        return kind_ == ElementsKind::Dictionary ? dictionaryAt(index) : JSValue::empty();
+    }
+    void append(JSValue value) {
+        if (kind_ == ElementsKind::PackedDouble && value.isInt32()) {
+            value = JSValue::fromDouble(value.asInt32());
+        }
+        if (kind_ != ElementsKind::Dictionary && fitsKind(value)) {
+            writeBarrier(this, value);
+            elements_.push_back(value);
+            return;
+        }
+        putSlow(length(), value);
+    }
+    void put(size_t index, JSValue value) {
+        if (kind_ == ElementsKind::PackedDouble && value.isInt32()) {
+            value = JSValue::fromDouble(value.asInt32());
+        }
+        if (index < elements_.size() && fitsKind(value)) {
+            writeBarrier(this, value);
+            elements_[index] = value;
+            return;
+        }
+        putSlow(index, value);
+    }
+    void resize(size_t length);
+    // Whole element list at once, for JSON.parse; none may be empty. The
+    // kind becomes the narrowest packed one that holds them all.
+    void assign(std::vector<JSValue> elements);
+
+    // Dense storage (empty in Dictionary kind). With PackedDouble every
+    // entry holds raw double bits, so numeric code can read it as doubles.
+    const std::vector<JSValue>& elements() const { return elements_; }
+
+    // Garbage collection
+    void traceChildren(GC& gc) const override;
+
 private:
-    std::vector<std::unique_ptr<Value>> elements_;
+    std::vector<JSValue> elements_;
+    std::unordered_map<size_t, JSValue> dictionary_;
+    size_t dictionaryLength_ = 0;
+    ElementsKind kind_ = ElementsKind::PackedInt32;
+
+    bool fitsKind(JSValue value) const {
+        switch (kind_) {
+            case ElementsKind::PackedInt32: return value.isInt32();
+            case ElementsKind::PackedDouble: return value.isDouble();
+            case ElementsKind::Packed: return !value.isEmpty();
+            default: return true;
+        }
+    }
+    JSValue dictionaryAt(size_t index) const;
+    void putSlow(size_t index, JSValue value);
+    void transitionTo(ElementsKind kind);
 };
 
 // String Value
+//
+// Immutable. Flat strings store one-byte (Latin-1) or two-byte (UTF-16)
+// code units; concatenation makes a rope over its operands and long
+// substrings a slice of a flat string. A rope is flattened in place the
+// first time its contents are read. value() is the UTF-8 form, converted
+// once and cached (ASCII one-byte strings return their storage directly);
+// length() and indices count UTF-16 code units, as in JS.
 class String : public Value {
 public:
+    enum class Representation : uint8_t { OneByte, TwoByte, Rope, Slice };
+
+    // Shorter concatenations and substrings are copied into a flat string,
+    // which is cheaper than the extra cell
+    static constexpr size_t kMinRopeLength = 13;
+    static constexpr size_t kMinSliceLength = 13;
+
     String(const std::string& value);
+    explicit String(std::u16string units);
+    String(const String* left, const String* right);
+    // base must be flat
+    String(const String* base, size_t start, size_t length);
     virtual ~String() = default;
 
+    // Representation
+    Representation representation() const { return representation_; }
+    bool isRope() const { return representation_ == Representation::Rope; }
+    // True when every code unit fits in one byte (stored or not)
+    bool isOneByte() const { return oneByte_; }
+    void flatten() const;
+
     // String operations
-    size_t length() const { return value_.length(); }
+    const std::string& value() const;
+    size_t length() const { return length_; }
+    char16_t codeUnitAt(size_t index) const;
+    // Hash of the code units, cached; equal strings hash equally whatever
+    // their representation
+    size_t hash() const;
+    bool contentEquals(const String& other) const;
     char charAt(size_t index) const;
     std::string substring(size_t start, size_t end) const;
     std::string toUpperCase() const;
@@ -387,13 +575,35 @@ public:
     bool isMarked() const override;
     void unmark() override;
 
+    // Garbage collection
+    void traceChildren(GC& gc) const override;
+
     // Debugging
     std::string debugString() const override;
     void dump() const override;
 
 private:
-    std::string value_;
+    // Flat storage: oneByte_ selects which of the two holds the code units.
+    // A rope keeps its operands in left_/right_; a slice keeps its base in
+    // left_ and its first code unit in offset_.
+    mutable Representation representation_;
+    mutable std::string oneByteUnits_;
+    mutable std::u16string twoByteUnits_;
+    mutable const String* left_;
+    mutable const String* right_;
+    size_t offset_;
+    size_t length_;
+    bool oneByte_;
+    bool ascii_;
+
+    mutable size_t hash_;
+    mutable std::string utf8_;
+    mutable bool utf8Cached_;
     bool marked_;
+
+    // Code units of a flat string or slice
+    const char* oneByteData() const;
+    const char16_t* twoByteData() const;
 };
 
 // Number Value
@@ -0,0 +1,385 @@
+#pragma once
+
+#include "bytecode.h"
+#include "gc.h"
+#include "jsvalue.h"
+#include "optimizer.h"
+#include "profiler.h"
+#include "value.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace js {
+
+class Context;
+class Coroutine;
+class EventLoop;
+class PromiseObject;
+class VM;
+
+// Bindings of a bytecode function that contains inner functions, as a flat
+// slot array laid out by the compiler. Closures keep the scope they were
+// created in alive.
+struct ClosureScope {
+    std::vector<JSValue> slots;
+    std::shared_ptr<const ScopeLayout> layout;
+    std::shared_ptr<ClosureScope> parent;
+
+    // Collector bookkeeping: last GC epoch that traced this scope, and
+    // whether it sits in the VM's remembered-scope list
+    uint32_t markEpoch;
+    bool remembered;
+
+    ClosureScope(std::shared_ptr<const ScopeLayout> layout, std::shared_ptr<ClosureScope> parent)
+        : slots(layout ? layout->names.size() : 0, JSValue::undefined()), layout(std::move(layout)),
+          parent(std::move(parent)), markEpoch(0), remembered(false) {}
+
+    ClosureScope* ancestor(uint16_t depth) {
+        ClosureScope* scope = this;
+        while (depth-- > 0) {
+            scope = scope->parent.get();
+        }
+        return scope;
+    }
+
+    // Marks bindings along the parent chain, stopping at scopes already
+    // traced in this collection
+    void trace(GC& gc);
+};
+
+// Uncaught script exception leaving the VM. The value points into the GC
+// heap; it stays valid as long as the heap that threw it.
+class ThrownValue : public std::runtime_error {
+public:
+    explicit ThrownValue(JSValue value)
+        : std::runtime_error("Uncaught " + value.toString()), value_(value) {}
+
+    JSValue value() const { return value_; }
+
+private:
+    JSValue value_;
+};
+
+// Script execution ended by an interrupt. Script code cannot catch it: the
+// VM drops every frame it unwinds through and rethrows it to the embedder.
+class ExecutionTerminated : public std::runtime_error {
+public:
+    ExecutionTerminated() : std::runtime_error("Script execution terminated") {}
+};
+
+// Runs on the VM's thread at a safepoint; false terminates the script
+using InterruptCallback = std::function<bool(VM& vm)>;
+
+// Host function operating directly on tagged values
+using NativeCallback = std::function<JSValue(JSValue thisValue, const JSValue* arguments, size_t count)>;
+
+// Engine state a native function restored from a HeapSnapshot binds to
+struct SnapshotBindings {
+    GC* heap;
+    VM* vm;
+    EventLoop* eventLoop;
+};
+// Builds a native callback for the engine described by bindings
+using NativeRebinder = std::function<NativeCallback(const SnapshotBindings& bindings)>;
+
+class NativeFunction : public Object {
+public:
+    NativeFunction(std::string name, NativeCallback callback);
+    virtual ~NativeFunction() = default;
+
+    const std::string& name() const { return name_; }
+    JSValue invoke(JSValue thisValue, const JSValue* arguments, size_t count) const {
+        return callback_(thisValue, arguments, count);
+    }
+
+    // Snapshots copy the callback as is, unless it closes over engine state
+    // and a rebinder was set to recreate it for each engine
+    const NativeCallback& callback() const { return callback_; }
+    const NativeRebinder& rebinder() const { return rebinder_; }
+    void setRebinder(NativeRebinder rebinder) { rebinder_ = std::move(rebinder); }
+
+    // Type conversion
+    std::string toString() const override;
+
+    // Cloning
+    std::unique_ptr<Value> clone() const override;
+    std::unique_ptr<Value> deepClone() const override;
+
+private:
+    std::string name_;
+    NativeCallback callback_;
+    NativeRebinder rebinder_;
+};
+
+// Function value backed by bytecode. Cloning shares the compiled code and
+// the captured scope.
+class BytecodeClosure : public Object {
+public:
+    BytecodeClosure(VM* vm, std::shared_ptr<BytecodeFunction> function, std::shared_ptr<ClosureScope> scope,
+                    JSValue boundThis = JSValue::undefined());
+    virtual ~BytecodeClosure() = default;
+
+    const std::shared_ptr<BytecodeFunction>& function() const { return function_; }
+    const std::shared_ptr<ClosureScope>& scope() const { return scope_; }
+    JSValue boundThis() const { return boundThis_; }
+
+    // Function call (re-enters the VM)
+    std::unique_ptr<Value> call(const std::vector<std::unique_ptr<Value>>& arguments) override;
+    std::unique_ptr<Value> call(std::unique_ptr<Value> thisValue, const std::vector<std::unique_ptr<Value>>& arguments) override;
+    std::unique_ptr<Value> construct(const std::vector<std::unique_ptr<Value>>& arguments) override;
+
+    // Type conversion
+    std::string toString() const override;
+
+    // Cloning
+    std::unique_ptr<Value> clone() const override;
+    std::unique_ptr<Value> deepClone() const override;
+
+    // Garbage collection
+    void traceChildren(GC& gc) const override;
+
+private:
+    VM* vm_;
+    std::shared_ptr<BytecodeFunction> function_;
+    std::shared_ptr<ClosureScope> scope_;
+    JSValue boundThis_;
+};
+
+// Register-based bytecode virtual machine
+//
+// All frames share one register stack; calls between bytecode functions push
+// an explicit frame instead of recursing on the native stack.
+class VM {
+public:
+    explicit VM(GC& heap);
+    ~VM();
+
+    // Execution
+    JSValue execute(std::shared_ptr<BytecodeFunction> function, Context* context);
+    JSValue call(const BytecodeClosure& closure, JSValue thisValue, const JSValue* arguments, size_t count,
+                 bool isConstruct = false);
+    // Calls any callable value
+    JSValue callValue(JSValue callee, JSValue thisValue, const JSValue* arguments, size_t count);
+
+    GC& heap() { return heap_; }
+
+    // Interrupts. Any thread may request one; the callback runs at the
+    // running script's next safepoint (loop back-edges and function entry,
+    // or the baseline code's back-edge budget), or when the next script
+    // reaches one. Terminating throws ExecutionTerminated out of execute().
+    void requestInterrupt(InterruptCallback callback);
+    void terminateExecution();
+
+    // Innermost script frame; valid inside interrupt callbacks
+    struct Location {
+        std::string function;
+        TokenPosition position;
+    };
+    Location currentLocation() const;
+
+    // Sampling profiler polled at safepoints; not owned
+    void setProfiler(Profiler* profiler) { profiler_ = profiler; }
+    Profiler* getProfiler() const { return profiler_; }
+
+    // Tier-up policy for hot functions; not owned
+    void setOptimizer(Optimizer* optimizer);
+    Optimizer* getOptimizer() const { return optimizer_; }
+
+    // Queue for promise reactions (and so for resuming awaits); not owned
+    void setEventLoop(EventLoop* loop) { eventLoop_ = loop; }
+    EventLoop* getEventLoop() const { return eventLoop_; }
+
+    // Promises
+    PromiseObject* newPromise();
+    // Resolving with another promise adopts its eventual state
+    void resolvePromise(PromiseObject* promise, JSValue value);
+    void rejectPromise(PromiseObject* promise, JSValue reason);
+    // Promise constructor with resolve() and reject(), for the global object
+    JSValue createPromiseConstructor();
+
+    // Limits
+    void setMaxCallDepth(size_t depth) { maxCallDepth_ = depth; }
+    size_t getMaxCallDepth() const { return maxCallDepth_; }
+
+    // Statistics
+    uint64_t getExecutedInstructionCount() const { return executedInstructions_; }
+    uint64_t getCallCount() const { return callCount_; }
+    size_t getRegisterStackSize() const { return registers_.size(); }
+    uint64_t getInlineCacheHitCount() const { return cacheHits_; }
+    uint64_t getInlineCacheMissCount() const { return cacheMisses_; }
+    void resetStatistics();
+
+private:
+    struct Frame {
+        std::shared_ptr<BytecodeFunction> function;
+        std::shared_ptr<ClosureScope> scope;
+        std::shared_ptr<ClosureScope> capturedScope;
+        JSValue thisValue;
+        size_t base;
+        uint32_t pc;
+        uint16_t returnRegister;
+        bool isConstruct;
+        // Set while a generator or async function body runs in this frame
+        Coroutine* coroutine;
+    };
+
+    struct Handler {
+        size_t frameIndex;
+        uint32_t target;
+        uint16_t exceptionRegister;
+    };
+
+    // How unwinding an exception ended: in a handler, by an async function
+    // turning it into a rejection and returning at the entry depth, or not
+    // at all
+    enum class Unwind : uint8_t { Handled, Returned, Uncaught };
+
+    // Generator next() / return() / throw(); async functions resume with
+    // Next on fulfillment and Throw on rejection
+    enum class ResumeMode : uint8_t { Next, Return, Throw };
+    // The coroutine's frame was pushed (Resumed), pending_ holds an
+    // exception to throw (Threw), or it completed without running (Finished)
+    enum class ResumeResult : uint8_t { Resumed, Threw, Finished };
+
+    GC& heap_;
+    std::vector<JSValue> registers_;
+    std::vector<Frame> frames_;
+    std::vector<Handler> handlers_;
+    JSValue pending_;
+    Context* context_;
+    Profiler* profiler_;
+    Optimizer* optimizer_;
+    EventLoop* eventLoop_;
+
+    // Pinned methods of generator objects and promises
+    NativeFunction* generatorNext_;
+    NativeFunction* generatorReturn_;
+    NativeFunction* generatorThrow_;
+    NativeFunction* promiseThen_;
+    NativeFunction* promiseCatch_;
+
+    // Collector integration: root registration id, scopes written with
+    // young values since the last collection, and the depth of native
+    // calls (whose C++ locals are not roots, so no collection happens
+    // while any is active)
+    size_t rootsId_;
+    std::vector<std::shared_ptr<ClosureScope>> rememberedScopes_;
+    size_t nativeDepth_;
+
+    // Interrupts requested from any thread; the flag is what safepoints poll
+    std::atomic<bool> interruptRequested_;
+    std::mutex interruptMutex_;
+    std::vector<InterruptCallback> interrupts_;
+    // Set by a baseline helper that caught ExecutionTerminated, which
+    // cannot unwind through baseline code
+    bool terminating_;
+
+    // Interned typeof results: undefined, boolean, number, string, object, function
+    JSValue typeNames_[6];
+
+    size_t maxCallDepth_;
+    uint64_t executedInstructions_;
+    uint64_t callCount_;
+    uint64_t cacheHits_;
+    uint64_t cacheMisses_;
+
+    // Frames
+    void pushFrame(const BytecodeClosure& closure, JSValue thisValue, size_t base,
+                   uint16_t returnRegister, bool isConstruct);
+    void popFrame();
+
+    // Dispatch
+    JSValue run(size_t entryDepth);
+    JSValue dispatch(size_t entryDepth);
+    // result is set when unwinding returns at the entry depth
+    Unwind unwind(size_t entryDepth, JSValue& result);
+
+    // Coroutines
+    void installCoroutineMethods();
+    JSValue startGenerator(BytecodeClosure& closure, JSValue thisValue, const JSValue* arguments, size_t count);
+    void startAsync(BytecodeClosure& closure);
+    // Pushes the coroutine's frame at base unless it finishes right away
+    ResumeResult resumeCoroutine(Coroutine& coroutine, ResumeMode mode, JSValue value, size_t base,
+                                 uint16_t returnRegister, JSValue& result);
+    JSValue resumeFromHost(Coroutine& coroutine, ResumeMode mode, JSValue value);
+    // Saves and pops the innermost frame; resumption writes resumeRegister
+    void suspendCoroutine(uint16_t resumeRegister);
+    // Result the caller sees when the coroutine body returns value
+    JSValue completeCoroutine(Coroutine& coroutine, JSValue value);
+    JSValue iteratorResult(JSValue value, bool done);
+    JSValue coroutineMethod(Object* cell, const std::string& name) const;
+
+    // Promise reactions
+    PromiseObject* promiseFor(JSValue value);
+    void settlePromise(PromiseObject* promise, bool fulfilled, JSValue value);
+    void subscribe(PromiseObject* promise, JSValue onFulfilled, JSValue onRejected, PromiseObject* derived,
+                   Coroutine* coroutine);
+    void scheduleReaction(PromiseObject* promise, JSValue onFulfilled, JSValue onRejected, PromiseObject* derived,
+                          Coroutine* coroutine);
+    void runReaction(Array* job);
+
+    // Property access instructions, shared by the interpreter and the
+    // baseline helpers
+    void executeGetProperty(BytecodeFunction& fn, const Instruction& insn, uint32_t pc, JSValue* regs);
+    void executeSetProperty(BytecodeFunction& fn, const Instruction& insn, uint32_t pc, JSValue* regs);
+    void executeGetElement(const Instruction& insn, JSValue* regs);
+    void executeSetElement(const Instruction& insn, JSValue* regs);
+
+    // Entry point from baseline code for instruction op at pc of the
+    // innermost frame; exceptions become pending_ and a nonzero result
+    template <Opcode op>
+    static uint32_t baselineHelper(BaselineFrame* frame, uint32_t pc) noexcept;
+
+    // Garbage collection
+    void traceRoots(GC& gc);
+    bool isSafepointRequested() const {
+        return heap_.isCollectionRequested() || (profiler_ && profiler_->isSampleRequested()) ||
+               interruptRequested_.load(std::memory_order_relaxed);
+    }
+    void safepoint() {
+        if (heap_.isCollectionRequested() && nativeDepth_ == 0) {
+            heap_.collectIfNeeded();
+        }
+        if (profiler_ && profiler_->isSampleRequested()) {
+            takeSample();
+        }
+        if (interruptRequested_.load(std::memory_order_relaxed)) {
+            handleInterrupts();
+        }
+    }
+    void takeSample();
+    // Runs the requested interrupts; throws ExecutionTerminated if one asks
+    void handleInterrupts();
+    void rememberScope(const Frame& frame, ClosureScope* scope, JSValue value);
+
+    // Global bindings; everything else was resolved to a slot by the compiler
+    JSValue loadName(const std::string& name);
+    void storeName(const std::string& name, JSValue value);
+    void declareName(const std::string& name, JSValue value);
+
+    // Constants are boxed once per function and reused by LoadConst
+    void materializeConstants(BytecodeFunction& function);
+
+    // Property access slow paths; the Cached variants also fill the site's
+    // inline cache
+    JSValue getPropertyCached(JSValue object, const std::string& name, PropertyCache& cache);
+    void setPropertyCached(JSValue object, const std::string& name, JSValue value, PropertyCache& cache);
+    JSValue getProperty(JSValue object, const std::string& name);
+    void setProperty(JSValue object, const std::string& name, JSValue value);
+    JSValue getElement(JSValue object, JSValue key);
+    void setElement(JSValue object, JSValue key, JSValue value);
+
+    // Calls into anything that is not a BytecodeClosure
+    JSValue callHost(JSValue callee, JSValue thisValue, const JSValue* arguments, size_t count, bool isConstruct);
+
+    JSValue typeOf(JSValue value) const;
+};
+
+} // namespace js
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "types.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace js {
+
+// A script still running when its execution deadline passed
+struct LongTask {
+    std::chrono::steady_clock::time_point deadline;
+    // How far past the deadline the script was when interrupted
+    std::chrono::microseconds overrun;
+    // Innermost function at that point and the position it was running
+    std::string function;
+    TokenPosition position;
+    bool terminated;
+};
+
+// Deadline timer for script execution
+//
+// A background thread sleeps until the armed deadline and calls the
+// expiry callback there once it passes, unless the deadline was disarmed
+// or armed again first. The callback runs on the watchdog thread, so it
+// should only hand the work over, as JavaScriptEngine does with
+// VM::requestInterrupt. Each arm() returns a new generation the callback
+// receives, which tells a stale expiry from the current one.
+//
+// arm() and disarm() are called from the thread running the VM; the
+// thread starts with the first arm().
+class Watchdog {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Expired = std::function<void(uint64_t generation)>;
+
+    explicit Watchdog(Expired onExpired);
+    ~Watchdog();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    uint64_t arm(Clock::time_point deadline);
+    void disarm();
+    bool isArmed() const;
+
+private:
+    Expired onExpired_;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    Clock::time_point deadline_;
+    uint64_t generation_;
+    bool armed_;
+    bool stopRequested_;
+
+    void watchLoop();
+};
+
+} // namespace js
@@ -0,0 +1,75 @@
+#include "js/arena.h"
+#include <algorithm>
+#include <atomic>
+
+namespace js {
+
+namespace {
+
+thread_local Arena* currentArena = nullptr;
+std::atomic<size_t> totalBytesReserved{0};
+
+} // namespace
+
+Arena::Arena() : chunks_(), cursor_(nullptr), limit_(nullptr), bytesAllocated_(0), bytesReserved_(0) {
+}
+
+Arena::~Arena() {
+    totalBytesReserved.fetch_sub(bytesReserved_, std::memory_order_relaxed);
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    uintptr_t address = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(alignment - 1);
+    if (!cursor_ || address + size > reinterpret_cast<uintptr_t>(limit_)) {
+        addChunk(size + alignment);
+        address = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(alignment - 1);
+    }
+    cursor_ = reinterpret_cast<char*>(address + size);
+    bytesAllocated_ += size;
+    return reinterpret_cast<void*>(address);
+}
+
+void Arena::reset() {
+    size_t reserved = bytesReserved_;
+    if (chunks_.size() > 1) {
+        chunks_.erase(chunks_.begin() + 1, chunks_.end());
+    }
+    if (chunks_.empty()) {
+        cursor_ = nullptr;
+        limit_ = nullptr;
+        bytesReserved_ = 0;
+    } else {
+        cursor_ = chunks_.front().memory.get();
+        limit_ = cursor_ + chunks_.front().capacity;
+        bytesReserved_ = chunks_.front().capacity;
+    }
+    bytesAllocated_ = 0;
+    totalBytesReserved.fetch_sub(reserved - bytesReserved_, std::memory_order_relaxed);
+}
+
+void Arena::addChunk(size_t minimum) {
+    size_t capacity = std::max(kChunkSize, minimum);
+    chunks_.push_back(Chunk{std::unique_ptr<char[]>(new char[capacity]), capacity});
+    cursor_ = chunks_.back().memory.get();
+    limit_ = cursor_ + capacity;
+    bytesReserved_ += capacity;
+    totalBytesReserved.fetch_add(capacity, std::memory_order_relaxed);
+}
+
+size_t Arena::getTotalBytesReserved() {
+    return totalBytesReserved.load(std::memory_order_relaxed);
+}
+
+Arena* Arena::current() {
+    return currentArena;
+}
+
+Arena::Scope::Scope(Arena* arena) : previous_(currentArena) {
+    currentArena = arena;
+}
+
+Arena::Scope::~Scope() {
+    currentArena = previous_;
+}
+
+} // namespace js
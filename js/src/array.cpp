@@ -1,34 +1,157 @@
 #include "js/array.h"
+#include "js/gc.h"
+#include <algorithm>
 
 namespace js {
 
-Array::Array() : Value(ValueType::Array) {}
+namespace {
 
-Array::~Array() {}
+ElementsKind kindFor(JSValue value) {
+    if (value.isInt32()) {
+        return ElementsKind::PackedInt32;
+    }
+    if (value.isDouble()) {
+        return ElementsKind::PackedDouble;
+    }
+    return value.isEmpty() ? ElementsKind::Holey : ElementsKind::Packed;
+}
+
+} // namespace
+
+// Array element kinds
 
-void Array::push(std::shared_ptr<Value> value) {
-    elements.push_back(value);
+JSValue Array::dictionaryAt(size_t index) const {
+    auto it = dictionary_.find(index);
+    return it != dictionary_.end() ? it->second : JSValue::empty();
 }
 
-std::shared_ptr<Value> Array::get(size_t index) const {
-    if (index < elements.size()) {
-        return elements[index];
+void Array::putSlow(size_t index, JSValue value) {
+    writeBarrier(this, value);
+    if (kind_ == ElementsKind::Dictionary) {
+        if (value.isEmpty()) {
+            dictionary_.erase(index);
+        } else {
+            dictionary_[index] = value;
+        }
+        dictionaryLength_ = std::max(dictionaryLength_, index + 1);
+        return;
+    }
+
+    size_t size = elements_.size();
+    if (index > size + kMaxHoleGap) {
+        transitionTo(ElementsKind::Dictionary);
+        putSlow(index, value);
+        return;
+    }
+
+    ElementsKind needed = std::max(kindFor(value), index > size ? ElementsKind::Holey : ElementsKind::PackedInt32);
+    if (needed > kind_) {
+        transitionTo(needed);
     }
-    return nullptr;
+    if (kind_ == ElementsKind::PackedDouble && value.isInt32()) {
+        value = JSValue::fromDouble(value.asInt32());
+    }
+    if (index >= size) {
+        elements_.resize(index + 1, JSValue::empty());
+    }
+    elements_[index] = value;
+}
+
+void Array::transitionTo(ElementsKind kind) {
+    if (kind == ElementsKind::PackedDouble) {
+        for (JSValue& element : elements_) {
+            element = JSValue::fromDouble(element.asInt32());
+        }
+    } else if (kind == ElementsKind::Dictionary) {
+        dictionaryLength_ = elements_.size();
+        for (size_t i = 0; i < elements_.size(); ++i) {
+            if (!elements_[i].isEmpty()) {
+                dictionary_.emplace(i, elements_[i]);
+            }
+        }
+        std::vector<JSValue>().swap(elements_);
+    }
+    kind_ = kind;
 }
 
-void Array::set(size_t index, std::shared_ptr<Value> value) {
-    if (index < elements.size()) {
-        elements[index] = value;
+// Shrinking keeps the kind; growing adds holes
+void Array::resize(size_t length) {
+    if (kind_ == ElementsKind::Dictionary) {
+        for (auto it = dictionary_.begin(); it != dictionary_.end();) {
+            it = it->first >= length ? dictionary_.erase(it) : std::next(it);
+        }
+        dictionaryLength_ = length;
+        return;
+    }
+
+    size_t size = elements_.size();
+    if (length > size + kMaxHoleGap) {
+        transitionTo(ElementsKind::Dictionary);
+        dictionaryLength_ = length;
+        return;
+    }
+    if (length > size && kind_ < ElementsKind::Holey) {
+        transitionTo(ElementsKind::Holey);
     }
+    elements_.resize(length, JSValue::empty());
 }
 
-size_t Array::length() const {
-    return elements.size();
+void Array::assign(std::vector<JSValue> elements) {
+    ElementsKind kind = ElementsKind::PackedInt32;
+    for (JSValue element : elements) {
+        writeBarrier(this, element);
+        kind = std::max(kind, kindFor(element));
+    }
+    if (kind == ElementsKind::PackedDouble) {
+        for (JSValue& element : elements) {
+            if (element.isInt32()) {
+                element = JSValue::fromDouble(element.asInt32());
+            }
+        }
+    }
+    dictionary_.clear();
+    dictionaryLength_ = 0;
+    elements_ = std::move(elements);
+    kind_ = kind;
+}
+
+// ArrayBuffer
+
+ArrayBuffer::ArrayBuffer(size_t byteLength) : data_(new uint8_t[byteLength]()), byteLength_(byteLength) {
+}
+
+std::string ArrayBuffer::toString() const {
+    return "[object ArrayBuffer]";
+}
+
+// TypedArray
+
+TypedArray::TypedArray(TypedArrayKind kind, ArrayBuffer* buffer, size_t byteOffset, size_t length)
+    : kind_(kind), buffer_(buffer), byteOffset_(byteOffset), length_(length) {
+}
+
+const char* TypedArray::className(TypedArrayKind kind) {
+    switch (kind) {
+        case TypedArrayKind::Uint8: return "Uint8Array";
+        case TypedArrayKind::Float64: return "Float64Array";
+    }
+    return "TypedArray";
+}
+
+std::string TypedArray::toString() const {
+    std::string result;
+    for (size_t i = 0; i < length_; ++i) {
+        if (i > 0) {
+            result += ',';
+        }
+        result += at(i).toString();
+    }
+    return result;
 }
 
-void Array::clear() {
-    elements.clear();
+void TypedArray::traceChildren(GC& gc) const {
+    Object::traceChildren(gc);
+    gc.markValue(JSValue::object(buffer_));
 }
 
 } // namespace js
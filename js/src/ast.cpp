@@ -88,4 +88,42 @@ std::string Identifier::get_name() const {
     return name_;
 }
 
+// Node allocation
+//
+// Every node is preceded by a header naming the arena it came from, so
+// operator delete can tell arena nodes (nothing to free) from heap ones.
+namespace {
+
+struct NodeHeader {
+    Arena* arena;
+};
+
+constexpr size_t kNodeHeaderSize = (sizeof(NodeHeader) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+} // namespace
+
+void* Node::operator new(size_t size) {
+    Arena* arena = Arena::current();
+    void* memory = arena ? arena->allocate(kNodeHeaderSize + size) : ::operator new(kNodeHeaderSize + size);
+    static_cast<NodeHeader*>(memory)->arena = arena;
+    return static_cast<char*>(memory) + kNodeHeaderSize;
+}
+
+void Node::operator delete(void* memory) {
+    if (!memory) {
+        return;
+    }
+    void* header = static_cast<char*>(memory) - kNodeHeaderSize;
+    if (!static_cast<NodeHeader*>(header)->arena) {
+        ::operator delete(header);
+    }
+}
+
+// AST implementation
+AST::AST(std::unique_ptr<Node> root) : arena_(), root_(std::move(root)) {}
+
+AST::AST(std::unique_ptr<Node> root, std::unique_ptr<Arena> arena) : arena_(std::move(arena)), root_(std::move(root)) {}
+
+AST::~AST() = default;
+
 } // namespace js
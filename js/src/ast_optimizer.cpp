@@ -0,0 +1,734 @@
+#include "js/ast_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace js {
+
+namespace {
+
+// The value of a literal operand
+struct Constant {
+    enum class Kind { Undefined, Null, Boolean, Number, String };
+    Kind kind = Kind::Undefined;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+};
+
+bool constantOf(const Expression* expression, Constant& constant) {
+    if (auto* number = dynamic_cast<const NumericLiteral*>(expression)) {
+        constant.kind = Constant::Kind::Number;
+        constant.number = number->value();
+    } else if (auto* string = dynamic_cast<const StringLiteral*>(expression)) {
+        constant.kind = Constant::Kind::String;
+        constant.string = string->value();
+    } else if (auto* boolean = dynamic_cast<const BooleanLiteral*>(expression)) {
+        constant.kind = Constant::Kind::Boolean;
+        constant.boolean = boolean->value();
+    } else if (dynamic_cast<const NullLiteral*>(expression)) {
+        constant.kind = Constant::Kind::Null;
+    } else if (dynamic_cast<const UndefinedLiteral*>(expression)) {
+        constant.kind = Constant::Kind::Undefined;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Constant numberConstant(double value) {
+    Constant constant;
+    constant.kind = Constant::Kind::Number;
+    constant.number = value;
+    return constant;
+}
+
+Constant booleanConstant(bool value) {
+    Constant constant;
+    constant.kind = Constant::Kind::Boolean;
+    constant.boolean = value;
+    return constant;
+}
+
+Constant stringConstant(std::string value) {
+    Constant constant;
+    constant.kind = Constant::Kind::String;
+    constant.string = std::move(value);
+    return constant;
+}
+
+std::string numberText(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
+
+std::unique_ptr<Expression> makeLiteral(const Constant& constant, const TokenPosition& position) {
+    switch (constant.kind) {
+        case Constant::Kind::Number: {
+            auto literal = std::make_unique<NumericLiteral>(numberText(constant.number), position);
+            literal->setValue(constant.number);
+            return literal;
+        }
+        case Constant::Kind::String:
+            return std::make_unique<StringLiteral>(constant.string, position);
+        case Constant::Kind::Boolean: {
+            auto literal = std::make_unique<BooleanLiteral>(constant.boolean ? "true" : "false", position);
+            literal->setValue(constant.boolean);
+            return literal;
+        }
+        case Constant::Kind::Null:
+            return std::make_unique<NullLiteral>(position);
+        case Constant::Kind::Undefined:
+            break;
+    }
+    return std::make_unique<UndefinedLiteral>(position);
+}
+
+bool isTruthy(const Constant& constant) {
+    switch (constant.kind) {
+        case Constant::Kind::Number: return constant.number != 0.0 && !std::isnan(constant.number);
+        case Constant::Kind::String: return !constant.string.empty();
+        case Constant::Kind::Boolean: return constant.boolean;
+        default: return false;
+    }
+}
+
+bool isNullish(const Constant& constant) {
+    return constant.kind == Constant::Kind::Null || constant.kind == Constant::Kind::Undefined;
+}
+
+// ToNumber, except for strings, whose grammar is left to the runtime
+bool toNumber(const Constant& constant, double& number) {
+    switch (constant.kind) {
+        case Constant::Kind::Number: number = constant.number; return true;
+        case Constant::Kind::Boolean: number = constant.boolean ? 1.0 : 0.0; return true;
+        case Constant::Kind::Null: number = 0.0; return true;
+        case Constant::Kind::Undefined: number = std::nan(""); return true;
+        case Constant::Kind::String: break;
+    }
+    return false;
+}
+
+// ToString, except for numbers that would need the shortest round-trip
+// form (fractions and exponents)
+bool toText(const Constant& constant, std::string& text) {
+    switch (constant.kind) {
+        case Constant::Kind::String: text = constant.string; return true;
+        case Constant::Kind::Boolean: text = constant.boolean ? "true" : "false"; return true;
+        case Constant::Kind::Null: text = "null"; return true;
+        case Constant::Kind::Undefined: text = "undefined"; return true;
+        case Constant::Kind::Number: break;
+    }
+    double value = constant.number;
+    if (std::isnan(value)) {
+        text = "NaN";
+    } else if (std::isinf(value)) {
+        text = value > 0 ? "Infinity" : "-Infinity";
+    } else if (value == std::trunc(value) && std::fabs(value) < 1e21) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.0f", value == 0.0 ? 0.0 : value);
+        text = buffer;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int32_t toInt32(double value) {
+    if (!std::isfinite(value)) {
+        return 0;
+    }
+    double wrapped = std::fmod(std::trunc(value), 4294967296.0);
+    if (wrapped < 0) {
+        wrapped += 4294967296.0;
+    }
+    return static_cast<int32_t>(static_cast<uint32_t>(wrapped));
+}
+
+double power(double base, double exponent) {
+    // pow() gives 1 where JS gives NaN
+    if (std::isnan(exponent) || (std::fabs(base) == 1.0 && std::isinf(exponent))) {
+        return std::nan("");
+    }
+    return std::pow(base, exponent);
+}
+
+bool strictEquals(const Constant& left, const Constant& right) {
+    if (left.kind != right.kind) {
+        return false;
+    }
+    switch (left.kind) {
+        case Constant::Kind::Number: return left.number == right.number;
+        case Constant::Kind::String: return left.string == right.string;
+        case Constant::Kind::Boolean: return left.boolean == right.boolean;
+        default: return true;
+    }
+}
+
+// False when the answer needs the runtime's type coercions
+bool looseEquals(const Constant& left, const Constant& right, bool& result) {
+    if (left.kind == right.kind) {
+        result = strictEquals(left, right);
+    } else if (isNullish(left) || isNullish(right)) {
+        result = isNullish(left) && isNullish(right);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool isAscii(const std::string& text) {
+    return std::all_of(text.begin(), text.end(), [](char c) { return static_cast<unsigned char>(c) < 0x80; });
+}
+
+// Relational comparison; false when undecided here. UTF-8 byte order only
+// matches JS's UTF-16 order for ASCII.
+bool lessThan(const Constant& left, const Constant& right, bool orEqual, bool& result) {
+    if (left.kind == Constant::Kind::String && right.kind == Constant::Kind::String) {
+        if (!isAscii(left.string) || !isAscii(right.string)) {
+            return false;
+        }
+        result = orEqual ? left.string <= right.string : left.string < right.string;
+        return true;
+    }
+    double a = 0.0;
+    double b = 0.0;
+    if (!toNumber(left, a) || !toNumber(right, b)) {
+        return false;
+    }
+    result = orEqual ? a <= b : a < b;
+    return true;
+}
+
+const char* typeName(const Constant& constant) {
+    switch (constant.kind) {
+        case Constant::Kind::Number: return "number";
+        case Constant::Kind::String: return "string";
+        case Constant::Kind::Boolean: return "boolean";
+        case Constant::Kind::Null: return "object";
+        case Constant::Kind::Undefined: break;
+    }
+    return "undefined";
+}
+
+bool isReference(const Expression* expression) {
+    return dynamic_cast<const Identifier*>(expression) || dynamic_cast<const MemberExpression*>(expression);
+}
+
+// Whether removing node would remove a binding its function sees outside
+// it: var and function declarations are hoisted out of blocks. Nested
+// functions are not entered.
+bool hoistsDeclarations(const Node* node) {
+    if (!node) {
+        return false;
+    }
+    if (auto* statement = dynamic_cast<const VariableStatement*>(node)) {
+        return hoistsDeclarations(statement->declaration());
+    }
+    if (auto* declaration = dynamic_cast<const VariableDeclaration*>(node)) {
+        return declaration->kind() == "var";
+    }
+    if (dynamic_cast<const FunctionStatement*>(node) || dynamic_cast<const FunctionDeclaration*>(node)) {
+        return true;
+    }
+
+    auto anyOf = [](const NodeList<Statement>& statements) {
+        return std::any_of(statements.begin(), statements.end(),
+                           [](const std::unique_ptr<Statement>& statement) { return hoistsDeclarations(statement.get()); });
+    };
+    if (auto* block = dynamic_cast<const BlockStatement*>(node)) {
+        return anyOf(block->body());
+    }
+    if (auto* statement = dynamic_cast<const IfStatement*>(node)) {
+        return hoistsDeclarations(statement->consequent()) || hoistsDeclarations(statement->alternate());
+    }
+    if (auto* statement = dynamic_cast<const ForStatement*>(node)) {
+        return hoistsDeclarations(statement->init()) || hoistsDeclarations(statement->body());
+    }
+    if (auto* statement = dynamic_cast<const ForInStatement*>(node)) {
+        return hoistsDeclarations(statement->left()) || hoistsDeclarations(statement->body());
+    }
+    if (auto* statement = dynamic_cast<const ForOfStatement*>(node)) {
+        return hoistsDeclarations(statement->left()) || hoistsDeclarations(statement->body());
+    }
+    if (auto* statement = dynamic_cast<const WhileStatement*>(node)) {
+        return hoistsDeclarations(statement->body());
+    }
+    if (auto* statement = dynamic_cast<const DoWhileStatement*>(node)) {
+        return hoistsDeclarations(statement->body());
+    }
+    if (auto* statement = dynamic_cast<const LabeledStatement*>(node)) {
+        return hoistsDeclarations(statement->body());
+    }
+    if (auto* statement = dynamic_cast<const WithStatement*>(node)) {
+        return hoistsDeclarations(statement->body());
+    }
+    if (auto* statement = dynamic_cast<const SwitchStatement*>(node)) {
+        return std::any_of(statement->cases().begin(), statement->cases().end(),
+                           [&](const std::unique_ptr<CaseClause>& clause) { return anyOf(clause->consequent()); });
+    }
+    if (auto* statement = dynamic_cast<const TryStatement*>(node)) {
+        return hoistsDeclarations(statement->block()) ||
+               (statement->handler() && hoistsDeclarations(statement->handler()->body())) ||
+               hoistsDeclarations(statement->finalizer());
+    }
+    return false;
+}
+
+} // namespace
+
+// ASTOptimizer implementation
+ASTOptimizer::ASTOptimizer()
+    : folded_(0)
+    , eliminated_(0) {
+}
+
+void ASTOptimizer::optimize(Node* root) {
+    if (auto* program = dynamic_cast<Program*>(root)) {
+        NodeList<Statement> body = program->releaseBody();
+        optimizeStatements(body);
+        program->setBody(std::move(body));
+    } else if (auto* module = dynamic_cast<Module*>(root)) {
+        NodeList<Statement> body = module->releaseBody();
+        optimizeStatements(body);
+        module->setBody(std::move(body));
+    } else if (auto* block = dynamic_cast<BlockStatement*>(root)) {
+        optimizeBlock(block);
+    }
+}
+
+// Statements
+
+void ASTOptimizer::optimizeStatements(NodeList<Statement>& statements) {
+    for (std::unique_ptr<Statement>& statement : statements) {
+        bool removed = false;
+        std::unique_ptr<Statement> replacement = optimizeStatement(statement.get(), removed);
+        if (removed) {
+            statement.reset();
+        } else if (replacement) {
+            statement = std::move(replacement);
+        }
+    }
+    statements.erase(std::remove(statements.begin(), statements.end(), nullptr), statements.end());
+}
+
+void ASTOptimizer::optimizeStatementSlot(Statement* statement,
+                                         const std::function<void(std::unique_ptr<Statement>)>& replace) {
+    bool removed = false;
+    std::unique_ptr<Statement> replacement = optimizeStatement(statement, removed);
+    if (removed) {
+        replace(std::make_unique<BlockStatement>(NodeList<Statement>(), statement->position()));
+    } else if (replacement) {
+        replace(std::move(replacement));
+    }
+}
+
+std::unique_ptr<Statement> ASTOptimizer::optimizeStatement(Statement* node, bool& removed) {
+    if (!node) {
+        return nullptr;
+    }
+
+    if (auto* statement = dynamic_cast<ExpressionStatement*>(node)) {
+        optimizeExpressionSlot(statement->expression(),
+                               [&](std::unique_ptr<Expression> e) { statement->setExpression(std::move(e)); });
+    } else if (auto* statement = dynamic_cast<VariableStatement*>(node)) {
+        if (auto* declaration = dynamic_cast<VariableDeclaration*>(statement->declaration())) {
+            for (const auto& declarator : declaration->declarations()) {
+                VariableDeclarator* target = declarator.get();
+                optimizeExpressionSlot(target->init(),
+                                       [&](std::unique_ptr<Expression> e) { target->setInit(std::move(e)); });
+            }
+        }
+    } else if (auto* statement = dynamic_cast<FunctionStatement*>(node)) {
+        if (auto* function = dynamic_cast<FunctionDeclaration*>(statement->declaration())) {
+            optimizeBlock(function->body());
+        }
+    } else if (auto* block = dynamic_cast<BlockStatement*>(node)) {
+        optimizeBlock(block);
+    } else if (auto* statement = dynamic_cast<IfStatement*>(node)) {
+        return optimizeIf(statement, removed);
+    } else if (auto* statement = dynamic_cast<WhileStatement*>(node)) {
+        optimizeExpressionSlot(statement->test(), [&](std::unique_ptr<Expression> e) { statement->setTest(std::move(e)); });
+        optimizeStatementSlot(statement->body(), [&](std::unique_ptr<Statement> s) { statement->setBody(std::move(s)); });
+        Constant test;
+        if (constantOf(statement->test(), test) && !isTruthy(test) && !hoistsDeclarations(statement->body())) {
+            ++eliminated_;
+            removed = true;
+        }
+    } else if (auto* statement = dynamic_cast<DoWhileStatement*>(node)) {
+        optimizeStatementSlot(statement->body(), [&](std::unique_ptr<Statement> s) { statement->setBody(std::move(s)); });
+        optimizeExpressionSlot(statement->test(), [&](std::unique_ptr<Expression> e) { statement->setTest(std::move(e)); });
+    } else if (auto* statement = dynamic_cast<ForStatement*>(node)) {
+        optimizeExpressionSlot(statement->init(), [&](std::unique_ptr<Expression> e) { statement->setInit(std::move(e)); });
+        optimizeExpressionSlot(statement->test(), [&](std::unique_ptr<Expression> e) { statement->setTest(std::move(e)); });
+        optimizeExpressionSlot(statement->update(),
+                               [&](std::unique_ptr<Expression> e) { statement->setUpdate(std::move(e)); });
+        optimizeStatementSlot(statement->body(), [&](std::unique_ptr<Statement> s) { statement->setBody(std::move(s)); });
+    } else if (auto* statement = dynamic_cast<ForInStatement*>(node)) {
+        optimizeExpressionSlot(statement->right(), [&](std::unique_ptr<Expression> e) { statement->setRight(std::move(e)); });
+        optimizeStatementSlot(statement->body(), [&](std::unique_ptr<Statement> s) { statement->setBody(std::move(s)); });
+    } else if (auto* statement = dynamic_cast<ForOfStatement*>(node)) {
+        optimizeExpressionSlot(statement->right(), [&](std::unique_ptr<Expression> e) { statement->setRight(std::move(e)); });
+        optimizeStatementSlot(statement->body(), [&](std::unique_ptr<Statement> s) { statement->setBody(std::move(s)); });
+    } else if (auto* statement = dynamic_cast<SwitchStatement*>(node)) {
+        optimizeExpressionSlot(statement->discriminant(),
+                               [&](std::unique_ptr<Expression> e) { statement->setDiscriminant(std::move(e)); });
+        for (const auto& entry : statement->cases()) {
+            CaseClause* clause = entry.get();
+            optimizeExpressionSlot(clause->test(), [&](std::unique_ptr<Expression> e) { clause->setTest(std::move(e)); });
+            NodeList<Statement> consequent = clause->releaseConsequent();
+            optimizeStatements(consequent);
+            clause->setConsequent(std::move(consequent));
+        }
+    } else if (auto* statement = dynamic_cast<TryStatement*>(node)) {
+        optimizeBlock(statement->block());
+        if (statement->handler()) {
+            optimizeBlock(statement->handler()->body());
+        }
+        optimizeBlock(statement->finalizer());
+    } else if (auto* statement = dynamic_cast<ThrowStatement*>(node)) {
+        optimizeExpressionSlot(statement->argument(),
+                               [&](std::unique_ptr<Expression> e) { statement->setArgument(std::move(e)); });
+    } else if (auto* statement = dynamic_cast<ReturnStatement*>(node)) {
+        optimizeExpressionSlot(statement->argument(),
+                               [&](std::unique_ptr<Expression> e) { statement->setArgument(std::move(e)); });
+    } else if (auto* statement = dynamic_cast<LabeledStatement*>(node)) {
+        optimizeStatementSlot(statement->body(), [&](std::unique_ptr<Statement> s) { statement->setBody(std::move(s)); });
+    } else if (auto* statement = dynamic_cast<WithStatement*>(node)) {
+        optimizeExpressionSlot(statement->object(), [&](std::unique_ptr<Expression> e) { statement->setObject(std::move(e)); });
+        optimizeStatementSlot(statement->body(), [&](std::unique_ptr<Statement> s) { statement->setBody(std::move(s)); });
+    }
+    return nullptr;
+}
+
+// A constant test keeps only the branch it selects, unless the other one
+// declares something hoisted
+std::unique_ptr<Statement> ASTOptimizer::optimizeIf(IfStatement* statement, bool& removed) {
+    optimizeExpressionSlot(statement->test(), [&](std::unique_ptr<Expression> e) { statement->setTest(std::move(e)); });
+    optimizeStatementSlot(statement->consequent(),
+                          [&](std::unique_ptr<Statement> s) { statement->setConsequent(std::move(s)); });
+    if (statement->alternate()) {
+        optimizeStatementSlot(statement->alternate(),
+                              [&](std::unique_ptr<Statement> s) { statement->setAlternate(std::move(s)); });
+    }
+
+    Constant test;
+    if (!constantOf(statement->test(), test)) {
+        return nullptr;
+    }
+    if (isTruthy(test)) {
+        if (hoistsDeclarations(statement->alternate())) {
+            return nullptr;
+        }
+        ++eliminated_;
+        return statement->releaseConsequent();
+    }
+    if (hoistsDeclarations(statement->consequent())) {
+        return nullptr;
+    }
+    ++eliminated_;
+    if (!statement->alternate()) {
+        removed = true;
+        return nullptr;
+    }
+    return statement->releaseAlternate();
+}
+
+void ASTOptimizer::optimizeBlock(BlockStatement* block) {
+    if (!block) {
+        return;
+    }
+    NodeList<Statement> statements = block->releaseBody();
+    optimizeStatements(statements);
+    block->setBody(std::move(statements));
+}
+
+// Expressions
+
+void ASTOptimizer::optimizeExpressions(NodeList<Expression>& expressions) {
+    for (std::unique_ptr<Expression>& expression : expressions) {
+        if (std::unique_ptr<Expression> replacement = optimizeExpression(expression.get(), false)) {
+            expression = std::move(replacement);
+        }
+    }
+}
+
+void ASTOptimizer::optimizeExpressionSlot(Expression* expression,
+                                          const std::function<void(std::unique_ptr<Expression>)>& replace,
+                                          bool reference) {
+    if (std::unique_ptr<Expression> replacement = optimizeExpression(expression, reference)) {
+        replace(std::move(replacement));
+    }
+}
+
+std::unique_ptr<Expression> ASTOptimizer::optimizeExpression(Expression* expression, bool reference) {
+    if (!expression || dynamic_cast<Literal*>(expression) || dynamic_cast<Identifier*>(expression)) {
+        return nullptr;
+    }
+    optimizeChildren(expression);
+
+    if (auto* unary = dynamic_cast<UnaryExpression*>(expression)) {
+        return foldUnary(unary);
+    }
+    if (auto* binary = dynamic_cast<BinaryExpression*>(expression)) {
+        return foldBinary(binary);
+    }
+    if (auto* logical = dynamic_cast<LogicalExpression*>(expression)) {
+        return foldLogical(logical, reference);
+    }
+    if (auto* conditional = dynamic_cast<ConditionalExpression*>(expression)) {
+        return foldConditional(conditional, reference);
+    }
+    return nullptr;
+}
+
+void ASTOptimizer::optimizeChildren(Expression* expression) {
+    if (auto* unary = dynamic_cast<UnaryExpression*>(expression)) {
+        bool reference = unary->operatorType() == OperatorType::Delete || unary->operatorType() == OperatorType::TypeOf;
+        optimizeExpressionSlot(unary->argument(), [&](std::unique_ptr<Expression> e) { unary->setArgument(std::move(e)); },
+                               reference);
+    } else if (auto* binary = dynamic_cast<BinaryExpression*>(expression)) {
+        optimizeExpressionSlot(binary->left(), [&](std::unique_ptr<Expression> e) { binary->setLeft(std::move(e)); });
+        optimizeExpressionSlot(binary->right(), [&](std::unique_ptr<Expression> e) { binary->setRight(std::move(e)); });
+    } else if (auto* logical = dynamic_cast<LogicalExpression*>(expression)) {
+        optimizeExpressionSlot(logical->left(), [&](std::unique_ptr<Expression> e) { logical->setLeft(std::move(e)); });
+        optimizeExpressionSlot(logical->right(), [&](std::unique_ptr<Expression> e) { logical->setRight(std::move(e)); });
+    } else if (auto* conditional = dynamic_cast<ConditionalExpression*>(expression)) {
+        optimizeExpressionSlot(conditional->test(),
+                               [&](std::unique_ptr<Expression> e) { conditional->setTest(std::move(e)); });
+        optimizeExpressionSlot(conditional->consequent(),
+                               [&](std::unique_ptr<Expression> e) { conditional->setConsequent(std::move(e)); });
+        optimizeExpressionSlot(conditional->alternate(),
+                               [&](std::unique_ptr<Expression> e) { conditional->setAlternate(std::move(e)); });
+    } else if (auto* assignment = dynamic_cast<AssignmentExpression*>(expression)) {
+        optimizeExpressionSlot(assignment->right(),
+                               [&](std::unique_ptr<Expression> e) { assignment->setRight(std::move(e)); });
+    } else if (auto* call = dynamic_cast<CallExpression*>(expression)) {
+        optimizeExpressionSlot(call->callee(), [&](std::unique_ptr<Expression> e) { call->setCallee(std::move(e)); }, true);
+        NodeList<Expression> arguments = call->releaseArguments();
+        optimizeExpressions(arguments);
+        call->setArguments(std::move(arguments));
+    } else if (auto* construct = dynamic_cast<NewExpression*>(expression)) {
+        optimizeExpressionSlot(construct->callee(),
+                               [&](std::unique_ptr<Expression> e) { construct->setCallee(std::move(e)); }, true);
+        NodeList<Expression> arguments = construct->releaseArguments();
+        optimizeExpressions(arguments);
+        construct->setArguments(std::move(arguments));
+    } else if (auto* member = dynamic_cast<MemberExpression*>(expression)) {
+        optimizeExpressionSlot(member->object(), [&](std::unique_ptr<Expression> e) { member->setObject(std::move(e)); });
+        if (member->computed()) {
+            optimizeExpressionSlot(member->property(),
+                                   [&](std::unique_ptr<Expression> e) { member->setProperty(std::move(e)); });
+        }
+    } else if (auto* array = dynamic_cast<ArrayExpression*>(expression)) {
+        for (const auto& entry : array->elements()) {
+            Element* element = entry.get();
+            optimizeExpressionSlot(element->expression(),
+                                   [&](std::unique_ptr<Expression> e) { element->setExpression(std::move(e)); });
+        }
+    } else if (auto* object = dynamic_cast<ObjectExpression*>(expression)) {
+        for (const auto& entry : object->properties()) {
+            Property* property = entry.get();
+            if (property->computed()) {
+                optimizeExpressionSlot(property->key(),
+                                       [&](std::unique_ptr<Expression> e) { property->setKey(std::move(e)); });
+            }
+            optimizeExpressionSlot(property->value(),
+                                   [&](std::unique_ptr<Expression> e) { property->setValue(std::move(e)); });
+        }
+    } else if (auto* sequence = dynamic_cast<SequenceExpression*>(expression)) {
+        NodeList<Expression> expressions = sequence->releaseExpressions();
+        optimizeExpressions(expressions);
+        sequence->setExpressions(std::move(expressions));
+    } else if (auto* templateLiteral = dynamic_cast<TemplateLiteral*>(expression)) {
+        NodeList<Expression> expressions = templateLiteral->releaseExpressions();
+        optimizeExpressions(expressions);
+        templateLiteral->setExpressions(std::move(expressions));
+    } else if (auto* function = dynamic_cast<FunctionExpression*>(expression)) {
+        optimizeBlock(function->body());
+    } else if (auto* arrow = dynamic_cast<ArrowFunctionExpression*>(expression)) {
+        if (auto* body = dynamic_cast<BlockStatement*>(arrow->body())) {
+            optimizeBlock(body);
+        } else {
+            optimizeExpressionSlot(arrow->body(), [&](std::unique_ptr<Expression> e) { arrow->setBody(std::move(e)); });
+        }
+    } else if (auto* yield = dynamic_cast<YieldExpression*>(expression)) {
+        optimizeExpressionSlot(yield->argument(), [&](std::unique_ptr<Expression> e) { yield->setArgument(std::move(e)); });
+    } else if (auto* await = dynamic_cast<AwaitExpression*>(expression)) {
+        optimizeExpressionSlot(await->argument(), [&](std::unique_ptr<Expression> e) { await->setArgument(std::move(e)); });
+    }
+}
+
+std::unique_ptr<Expression> ASTOptimizer::foldUnary(UnaryExpression* expression) {
+    Constant operand;
+    if (!constantOf(expression->argument(), operand)) {
+        return nullptr;
+    }
+
+    Constant result;
+    double number = 0.0;
+    switch (expression->operatorType()) {
+        case OperatorType::LogicalNot:
+            result = booleanConstant(!isTruthy(operand));
+            break;
+        case OperatorType::TypeOf:
+            result = stringConstant(typeName(operand));
+            break;
+        case OperatorType::Void:
+            result = Constant();
+            break;
+        // The parser tags unary - and + with the binary operator types
+        case OperatorType::Subtract:
+        case OperatorType::UnaryMinus:
+            if (!toNumber(operand, number)) return nullptr;
+            result = numberConstant(-number);
+            break;
+        case OperatorType::Add:
+        case OperatorType::UnaryPlus:
+            if (!toNumber(operand, number)) return nullptr;
+            result = numberConstant(number);
+            break;
+        case OperatorType::BitwiseNot:
+            if (!toNumber(operand, number)) return nullptr;
+            result = numberConstant(~toInt32(number));
+            break;
+        default:
+            return nullptr;
+    }
+    ++folded_;
+    return makeLiteral(result, expression->position());
+}
+
+std::unique_ptr<Expression> ASTOptimizer::foldBinary(BinaryExpression* expression) {
+    Constant left;
+    Constant right;
+    if (!constantOf(expression->left(), left) || !constantOf(expression->right(), right)) {
+        return nullptr;
+    }
+
+    Constant result;
+    bool decided = false;
+    double a = 0.0;
+    double b = 0.0;
+    switch (expression->operatorType()) {
+        case OperatorType::Add:
+            if (left.kind == Constant::Kind::String || right.kind == Constant::Kind::String) {
+                std::string first;
+                std::string second;
+                if (!toText(left, first) || !toText(right, second)) return nullptr;
+                result = stringConstant(first + second);
+            } else {
+                if (!toNumber(left, a) || !toNumber(right, b)) return nullptr;
+                result = numberConstant(a + b);
+            }
+            break;
+        case OperatorType::Subtract:
+        case OperatorType::Multiply:
+        case OperatorType::Divide:
+        case OperatorType::Modulo:
+        case OperatorType::Exponent:
+            if (!toNumber(left, a) || !toNumber(right, b)) return nullptr;
+            switch (expression->operatorType()) {
+                case OperatorType::Subtract: result = numberConstant(a - b); break;
+                case OperatorType::Multiply: result = numberConstant(a * b); break;
+                case OperatorType::Divide: result = numberConstant(a / b); break;
+                case OperatorType::Modulo: result = numberConstant(std::fmod(a, b)); break;
+                default: result = numberConstant(power(a, b)); break;
+            }
+            break;
+        case OperatorType::BitwiseAnd:
+        case OperatorType::BitwiseOr:
+        case OperatorType::BitwiseXor:
+        case OperatorType::LeftShift:
+        case OperatorType::RightShift:
+        case OperatorType::UnsignedRightShift: {
+            if (!toNumber(left, a) || !toNumber(right, b)) return nullptr;
+            int32_t x = toInt32(a);
+            uint32_t count = static_cast<uint32_t>(toInt32(b)) & 31;
+            switch (expression->operatorType()) {
+                case OperatorType::BitwiseAnd: result = numberConstant(x & toInt32(b)); break;
+                case OperatorType::BitwiseOr: result = numberConstant(x | toInt32(b)); break;
+                case OperatorType::BitwiseXor: result = numberConstant(x ^ toInt32(b)); break;
+                case OperatorType::LeftShift:
+                    result = numberConstant(static_cast<int32_t>(static_cast<uint32_t>(x) << count));
+                    break;
+                case OperatorType::RightShift: result = numberConstant(x >> count); break;
+                default: result = numberConstant(static_cast<uint32_t>(x) >> count); break;
+            }
+            break;
+        }
+        case OperatorType::StrictEqual:
+            result = booleanConstant(strictEquals(left, right));
+            break;
+        case OperatorType::StrictNotEqual:
+            result = booleanConstant(!strictEquals(left, right));
+            break;
+        case OperatorType::Equal:
+        case OperatorType::NotEqual:
+            if (!looseEquals(left, right, decided)) return nullptr;
+            result = booleanConstant(expression->operatorType() == OperatorType::Equal ? decided : !decided);
+            break;
+        case OperatorType::LessThan:
+            if (!lessThan(left, right, false, decided)) return nullptr;
+            result = booleanConstant(decided);
+            break;
+        case OperatorType::LessThanOrEqual:
+            if (!lessThan(left, right, true, decided)) return nullptr;
+            result = booleanConstant(decided);
+            break;
+        case OperatorType::GreaterThan:
+            if (!lessThan(right, left, false, decided)) return nullptr;
+            result = booleanConstant(decided);
+            break;
+        case OperatorType::GreaterThanOrEqual:
+            if (!lessThan(right, left, true, decided)) return nullptr;
+            result = booleanConstant(decided);
+            break;
+        default:
+            return nullptr;
+    }
+    ++folded_;
+    return makeLiteral(result, expression->position());
+}
+
+std::unique_ptr<Expression> ASTOptimizer::foldLogical(LogicalExpression* expression, bool reference) {
+    Constant left;
+    if (!constantOf(expression->left(), left)) {
+        return nullptr;
+    }
+
+    bool takeLeft;
+    switch (expression->operatorType()) {
+        case OperatorType::LogicalAnd: takeLeft = !isTruthy(left); break;
+        case OperatorType::LogicalOr: takeLeft = isTruthy(left); break;
+        case OperatorType::NullishCoalescing: takeLeft = !isNullish(left); break;
+        default: return nullptr;
+    }
+    if (takeLeft) {
+        ++folded_;
+        return makeLiteral(left, expression->position());
+    }
+    if (reference && isReference(expression->right())) {
+        return nullptr;
+    }
+    ++folded_;
+    return expression->releaseRight();
+}
+
+std::unique_ptr<Expression> ASTOptimizer::foldConditional(ConditionalExpression* expression, bool reference) {
+    Constant test;
+    if (!constantOf(expression->test(), test)) {
+        return nullptr;
+    }
+    bool consequent = isTruthy(test);
+    if (reference && isReference(consequent ? expression->consequent() : expression->alternate())) {
+        return nullptr;
+    }
+    ++eliminated_;
+    return consequent ? expression->releaseConsequent() : expression->releaseAlternate();
+}
+
+} // namespace js
@@ -0,0 +1,31 @@
+#include "js/atoms.h"
+
+namespace js {
+
+AtomTable::AtomTable() : names_(), index_() {
+}
+
+Atom AtomTable::intern(std::string_view name) {
+    auto it = index_.find(name);
+    if (it != index_.end()) {
+        return it->second;
+    }
+    names_.emplace_back(name);
+    Atom atom = static_cast<Atom>(names_.size());
+    index_.emplace(names_.back(), atom);
+    return atom;
+}
+
+Atom AtomTable::find(std::string_view name) const {
+    auto it = index_.find(name);
+    return it != index_.end() ? it->second : kNone;
+}
+
+std::string_view AtomTable::name(Atom atom) const {
+    if (atom == kNone || atom > names_.size()) {
+        return std::string_view();
+    }
+    return names_[atom - 1];
+}
+
+} // namespace js
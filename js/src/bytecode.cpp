@@ -0,0 +1,127 @@
+#include "js/bytecode.h"
+#include <sstream>
+#include <iomanip>
+
+namespace js {
+
+const char* opcodeName(Opcode op) {
+    switch (op) {
+        case Opcode::LoadConst: return "LoadConst";
+        case Opcode::LoadUndefined: return "LoadUndefined";
+        case Opcode::LoadNull: return "LoadNull";
+        case Opcode::LoadTrue: return "LoadTrue";
+        case Opcode::LoadFalse: return "LoadFalse";
+        case Opcode::LoadThis: return "LoadThis";
+        case Opcode::LoadCallee: return "LoadCallee";
+        case Opcode::Move: return "Move";
+        case Opcode::LoadName: return "LoadName";
+        case Opcode::StoreName: return "StoreName";
+        case Opcode::DeclareName: return "DeclareName";
+        case Opcode::LoadSlot: return "LoadSlot";
+        case Opcode::StoreSlot: return "StoreSlot";
+        case Opcode::GetProperty: return "GetProperty";
+        case Opcode::SetProperty: return "SetProperty";
+        case Opcode::GetElement: return "GetElement";
+        case Opcode::SetElement: return "SetElement";
+        case Opcode::Add: return "Add";
+        case Opcode::Subtract: return "Subtract";
+        case Opcode::Multiply: return "Multiply";
+        case Opcode::Divide: return "Divide";
+        case Opcode::Modulo: return "Modulo";
+        case Opcode::Exponent: return "Exponent";
+        case Opcode::BitwiseAnd: return "BitwiseAnd";
+        case Opcode::BitwiseOr: return "BitwiseOr";
+        case Opcode::BitwiseXor: return "BitwiseXor";
+        case Opcode::LeftShift: return "LeftShift";
+        case Opcode::RightShift: return "RightShift";
+        case Opcode::UnsignedRightShift: return "UnsignedRightShift";
+        case Opcode::Equal: return "Equal";
+        case Opcode::NotEqual: return "NotEqual";
+        case Opcode::StrictEqual: return "StrictEqual";
+        case Opcode::StrictNotEqual: return "StrictNotEqual";
+        case Opcode::LessThan: return "LessThan";
+        case Opcode::LessThanOrEqual: return "LessThanOrEqual";
+        case Opcode::GreaterThan: return "GreaterThan";
+        case Opcode::GreaterThanOrEqual: return "GreaterThanOrEqual";
+        case Opcode::Negate: return "Negate";
+        case Opcode::UnaryPlus: return "UnaryPlus";
+        case Opcode::LogicalNot: return "LogicalNot";
+        case Opcode::BitwiseNot: return "BitwiseNot";
+        case Opcode::TypeOf: return "TypeOf";
+        case Opcode::Increment: return "Increment";
+        case Opcode::Decrement: return "Decrement";
+        case Opcode::Jump: return "Jump";
+        case Opcode::JumpIfTrue: return "JumpIfTrue";
+        case Opcode::JumpIfFalse: return "JumpIfFalse";
+        case Opcode::JumpIfNotNullish: return "JumpIfNotNullish";
+        case Opcode::Call: return "Call";
+        case Opcode::CallMethod: return "CallMethod";
+        case Opcode::Construct: return "Construct";
+        case Opcode::Return: return "Return";
+        case Opcode::ReturnUndefined: return "ReturnUndefined";
+        case Opcode::NewObject: return "NewObject";
+        case Opcode::NewArray: return "NewArray";
+        case Opcode::ArrayPush: return "ArrayPush";
+        case Opcode::Closure: return "Closure";
+        case Opcode::Throw: return "Throw";
+        case Opcode::PushHandler: return "PushHandler";
+        case Opcode::PopHandler: return "PopHandler";
+        case Opcode::Yield: return "Yield";
+        case Opcode::Await: return "Await";
+        case Opcode::Debugger: return "Debugger";
+        case Opcode::Nop: return "Nop";
+        case Opcode::Count: break;
+    }
+    return "Unknown";
+}
+
+static bool isJump(Opcode op) {
+    return op == Opcode::Jump || op == Opcode::JumpIfTrue || op == Opcode::JumpIfFalse ||
+           op == Opcode::JumpIfNotNullish || op == Opcode::PushHandler;
+}
+
+std::string BytecodeFunction::disassemble() const {
+    std::ostringstream out;
+    out << "function " << (name.empty() ? "<anonymous>" : name)
+        << " (params: " << paramCount << ", registers: " << registerCount << ")\n";
+
+    for (size_t i = 0; i < code.size(); ++i) {
+        const Instruction& insn = code[i];
+        out << std::setw(5) << i << "  " << std::left << std::setw(20) << opcodeName(insn.op) << std::right;
+        if (isJump(insn.op)) {
+            out << " r" << insn.a << " -> " << insn.target();
+        } else {
+            out << " " << insn.a << " " << insn.b << " " << insn.c;
+        }
+        out << "\n";
+    }
+
+    for (size_t i = 0; i < constants.size(); ++i) {
+        const Constant& k = constants[i];
+        out << "  k" << i << " = ";
+        if (k.kind == Constant::Kind::Number) {
+            out << k.number;
+        } else {
+            out << '"' << k.string << '"';
+        }
+        out << "\n";
+    }
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        out << "  n" << i << " = " << names[i] << "\n";
+    }
+
+    if (scope) {
+        for (size_t i = 0; i < scope->names.size(); ++i) {
+            out << "  s" << i << " = " << scope->names[i] << "\n";
+        }
+    }
+
+    for (const auto& function : functions) {
+        out << "\n" << function->disassemble();
+    }
+
+    return out.str();
+}
+
+} // namespace js
@@ -0,0 +1,620 @@
+#include "js/code_cache.h"
+#include "apollo/mapped_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace js {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t kMagic = 0x4342534A; // "JSBC"
+constexpr const char* kExtension = ".jsbc";
+
+enum FunctionFlag : uint8_t {
+    FunctionNamedScope = 1 << 0,
+    FunctionTopLevel = 1 << 1,
+    FunctionArrow = 1 << 2,
+    FunctionLazy = 1 << 3,
+    FunctionLazyDeclaration = 1 << 4,
+    FunctionGenerator = 1 << 5,
+    FunctionAsync = 1 << 6,
+};
+
+struct BlobHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t buildId;
+    uint64_t sourceHash;
+    uint64_t sourceLength;
+    uint64_t compileMicros;
+    uint64_t payloadSize;
+};
+
+constexpr uint64_t fnv1a(std::string_view data, uint64_t hash = 0xcbf29ce484222325ull) {
+    for (char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Serialization
+
+class BlobWriter {
+public:
+    template <typename T>
+    void put(T value) {
+        static_assert(std::is_trivially_copyable<T>::value, "raw writes need trivially copyable types");
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        data_.insert(data_.end(), bytes, bytes + sizeof(T));
+    }
+
+    void putBytes(const void* bytes, size_t size) {
+        const char* begin = static_cast<const char*>(bytes);
+        data_.insert(data_.end(), begin, begin + size);
+    }
+
+    void putString(const std::string& value) {
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        putBytes(value.data(), value.size());
+    }
+
+    void putLocation(const SourceLocation& location) {
+        put<uint32_t>(static_cast<uint32_t>(location.line));
+        put<uint32_t>(static_cast<uint32_t>(location.column));
+        put<uint32_t>(static_cast<uint32_t>(location.offset));
+    }
+
+    void putFunction(const BytecodeFunction& function) {
+        uint8_t flags = 0;
+        flags |= function.usesNamedScope ? FunctionNamedScope : 0;
+        flags |= function.isTopLevel ? FunctionTopLevel : 0;
+        flags |= function.isArrow ? FunctionArrow : 0;
+        flags |= function.isGenerator ? FunctionGenerator : 0;
+        flags |= function.isAsync ? FunctionAsync : 0;
+        if (function.lazy) {
+            flags |= FunctionLazy;
+            flags |= function.lazy->isDeclaration ? FunctionLazyDeclaration : 0;
+        }
+
+        putString(function.name);
+        put<uint16_t>(function.paramCount);
+        put<uint16_t>(function.registerCount);
+        put<uint8_t>(flags);
+        if (function.lazy) {
+            put<uint64_t>(function.lazy->begin);
+            put<uint64_t>(function.lazy->end);
+            return;
+        }
+
+        put<uint32_t>(static_cast<uint32_t>(function.code.size()));
+        putBytes(function.code.data(), function.code.size() * sizeof(Instruction));
+
+        put<uint32_t>(static_cast<uint32_t>(function.constants.size()));
+        for (const Constant& constant : function.constants) {
+            put<uint8_t>(static_cast<uint8_t>(constant.kind));
+            if (constant.kind == Constant::Kind::Number) {
+                put<double>(constant.number);
+            } else {
+                putString(constant.string);
+            }
+        }
+
+        put<uint32_t>(static_cast<uint32_t>(function.names.size()));
+        for (const std::string& name : function.names) {
+            putString(name);
+        }
+
+        // Only the slot names; parents follow from the function nesting
+        if (function.usesNamedScope) {
+            const auto& slots = function.scope->names;
+            put<uint32_t>(static_cast<uint32_t>(slots.size()));
+            for (const std::string& name : slots) {
+                putString(name);
+            }
+        }
+
+        put<uint32_t>(static_cast<uint32_t>(function.positions.size()));
+        for (const TokenPosition& position : function.positions) {
+            putLocation(position.start);
+            putLocation(position.end);
+        }
+
+        put<uint32_t>(static_cast<uint32_t>(function.propertyCaches.size()));
+        put<uint32_t>(static_cast<uint32_t>(function.cacheSlots.size()));
+        putBytes(function.cacheSlots.data(), function.cacheSlots.size() * sizeof(uint32_t));
+
+        put<uint32_t>(static_cast<uint32_t>(function.functions.size()));
+        for (const auto& inner : function.functions) {
+            putFunction(*inner);
+        }
+    }
+
+    const std::vector<char>& data() const { return data_; }
+
+private:
+    std::vector<char> data_;
+};
+
+// Deserialization; every read is bounds checked, every function's code is
+// verified, and a failure poisons the reader so a truncated or corrupt blob
+// is simply rejected
+
+class BlobReader {
+public:
+    BlobReader(const char* data, size_t size) : cursor_(data), end_(data + size), ok_(true) {}
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return cursor_ == end_; }
+
+    template <typename T>
+    T get() {
+        T value{};
+        getBytes(&value, sizeof(T));
+        return value;
+    }
+
+    void getBytes(void* out, size_t size) {
+        if (!ok_ || static_cast<size_t>(end_ - cursor_) < size) {
+            ok_ = false;
+            return;
+        }
+        std::memcpy(out, cursor_, size);
+        cursor_ += size;
+    }
+
+    std::string getString() {
+        uint32_t size = get<uint32_t>();
+        if (!ok_ || static_cast<size_t>(end_ - cursor_) < size) {
+            ok_ = false;
+            return std::string();
+        }
+        std::string value(cursor_, size);
+        cursor_ += size;
+        return value;
+    }
+
+    SourceLocation getLocation() {
+        uint32_t line = get<uint32_t>();
+        uint32_t column = get<uint32_t>();
+        uint32_t offset = get<uint32_t>();
+        return SourceLocation(line, column, offset);
+    }
+
+    // Element counts are capped by the bytes left so a corrupt count
+    // cannot trigger a huge allocation
+    uint32_t getCount(size_t minimumElementSize) {
+        uint32_t count = get<uint32_t>();
+        if (ok_ && static_cast<size_t>(end_ - cursor_) / minimumElementSize < count) {
+            ok_ = false;
+            return 0;
+        }
+        return ok_ ? count : 0;
+    }
+
+    std::shared_ptr<BytecodeFunction> getFunction(const std::shared_ptr<const std::string>& source,
+                                                  const std::shared_ptr<const ScopeLayout>& enclosing) {
+        auto function = std::make_shared<BytecodeFunction>();
+        function->name = getString();
+        function->paramCount = get<uint16_t>();
+        function->registerCount = get<uint16_t>();
+        uint8_t flags = get<uint8_t>();
+        function->usesNamedScope = (flags & FunctionNamedScope) != 0;
+        function->isTopLevel = (flags & FunctionTopLevel) != 0;
+        function->isArrow = (flags & FunctionArrow) != 0;
+        function->isGenerator = (flags & FunctionGenerator) != 0;
+        function->isAsync = (flags & FunctionAsync) != 0;
+        if (flags & FunctionLazy) {
+            uint64_t begin = get<uint64_t>();
+            uint64_t end = get<uint64_t>();
+            if (begin > end || end > source->size()) {
+                ok_ = false;
+                return nullptr;
+            }
+            function->lazy = std::make_shared<const LazyFunction>(
+                LazyFunction{source, static_cast<size_t>(begin), static_cast<size_t>(end),
+                             (flags & FunctionLazyDeclaration) != 0, enclosing});
+            return ok_ ? function : nullptr;
+        }
+
+        function->code.resize(getCount(sizeof(Instruction)));
+        getBytes(function->code.data(), function->code.size() * sizeof(Instruction));
+
+        uint32_t constantCount = getCount(sizeof(uint8_t) + sizeof(uint32_t));
+        function->constants.reserve(constantCount);
+        for (uint32_t i = 0; i < constantCount && ok_; ++i) {
+            if (static_cast<Constant::Kind>(get<uint8_t>()) == Constant::Kind::Number) {
+                function->constants.emplace_back(get<double>());
+            } else {
+                function->constants.emplace_back(getString());
+            }
+        }
+
+        uint32_t nameCount = getCount(sizeof(uint32_t));
+        function->names.reserve(nameCount);
+        for (uint32_t i = 0; i < nameCount && ok_; ++i) {
+            function->names.push_back(getString());
+        }
+
+        if (function->usesNamedScope) {
+            auto layout = std::make_shared<ScopeLayout>();
+            layout->parent = enclosing;
+            uint32_t slotCount = getCount(sizeof(uint32_t));
+            layout->names.reserve(slotCount);
+            for (uint32_t i = 0; i < slotCount && ok_; ++i) {
+                layout->names.push_back(getString());
+            }
+            function->scope = std::move(layout);
+        }
+
+        uint32_t positionCount = getCount(6 * sizeof(uint32_t));
+        function->positions.reserve(positionCount);
+        for (uint32_t i = 0; i < positionCount && ok_; ++i) {
+            SourceLocation start = getLocation();
+            SourceLocation end = getLocation();
+            function->positions.emplace_back(start, end);
+        }
+
+        // Caches start cold; only their number and placement are stored
+        function->propertyCaches.resize(getCount(1));
+        function->cacheSlots.resize(getCount(sizeof(uint32_t)));
+        getBytes(function->cacheSlots.data(), function->cacheSlots.size() * sizeof(uint32_t));
+
+        const auto& scope = function->usesNamedScope ? function->scope : enclosing;
+        uint32_t functionCount = getCount(sizeof(uint32_t));
+        function->functions.reserve(functionCount);
+        for (uint32_t i = 0; i < functionCount && ok_; ++i) {
+            function->functions.push_back(getFunction(source, scope));
+        }
+        if (ok_ && !verify(*function, scope.get())) {
+            ok_ = false;
+        }
+        return ok_ ? function : nullptr;
+    }
+
+private:
+    const char* cursor_;
+    const char* end_;
+    bool ok_;
+
+    static bool slotInRange(const ScopeLayout* scope, const Instruction& insn) {
+        for (uint16_t depth = insn.b; scope && depth > 0; --depth) {
+            scope = scope->parent.get();
+        }
+        return scope && insn.c < scope->names.size();
+    }
+
+    // The interpreter and baseline code trust what the compiler guarantees:
+    // operands inside the register window and the function's tables, jumps
+    // inside the code, and code that ends by leaving the function. A blob
+    // is only accepted if every instruction keeps to that.
+    static bool verify(const BytecodeFunction& function, const ScopeLayout* scope) {
+        const auto& code = function.code;
+        if (code.empty() || function.paramCount > function.registerCount ||
+            function.cacheSlots.size() != code.size()) {
+            return false;
+        }
+        Opcode last = code.back().op;
+        if (last != Opcode::Return && last != Opcode::ReturnUndefined && last != Opcode::Jump &&
+            last != Opcode::Throw) {
+            return false;
+        }
+
+        auto reg = [&](uint32_t index) { return index < function.registerCount; };
+        auto name = [&](uint32_t index) { return index < function.names.size(); };
+        auto target = [&](const Instruction& insn) { return insn.target() < code.size(); };
+        for (size_t i = 0; i < code.size(); ++i) {
+            const Instruction& insn = code[i];
+            bool valid = false;
+            switch (insn.op) {
+                case Opcode::LoadConst:
+                    valid = reg(insn.a) && insn.b < function.constants.size();
+                    break;
+                case Opcode::LoadUndefined:
+                case Opcode::LoadNull:
+                case Opcode::LoadTrue:
+                case Opcode::LoadFalse:
+                case Opcode::LoadThis:
+                case Opcode::LoadCallee:
+                case Opcode::Return:
+                case Opcode::NewObject:
+                case Opcode::NewArray:
+                case Opcode::Throw:
+                    valid = reg(insn.a);
+                    break;
+                case Opcode::Move:
+                case Opcode::Negate:
+                case Opcode::UnaryPlus:
+                case Opcode::LogicalNot:
+                case Opcode::BitwiseNot:
+                case Opcode::TypeOf:
+                case Opcode::Increment:
+                case Opcode::Decrement:
+                case Opcode::ArrayPush:
+                case Opcode::Yield:
+                case Opcode::Await:
+                    valid = reg(insn.a) && reg(insn.b);
+                    break;
+                case Opcode::LoadName:
+                case Opcode::StoreName:
+                case Opcode::DeclareName:
+                    valid = reg(insn.a) && name(insn.b);
+                    break;
+                case Opcode::LoadSlot:
+                case Opcode::StoreSlot:
+                    valid = reg(insn.a) && slotInRange(scope, insn);
+                    break;
+                case Opcode::GetProperty:
+                    valid = reg(insn.a) && reg(insn.b) && name(insn.c) &&
+                            function.cacheSlots[i] < function.propertyCaches.size();
+                    break;
+                case Opcode::SetProperty:
+                    valid = reg(insn.a) && name(insn.b) && reg(insn.c) &&
+                            function.cacheSlots[i] < function.propertyCaches.size();
+                    break;
+                case Opcode::GetElement:
+                case Opcode::SetElement:
+                case Opcode::Add:
+                case Opcode::Subtract:
+                case Opcode::Multiply:
+                case Opcode::Divide:
+                case Opcode::Modulo:
+                case Opcode::Exponent:
+                case Opcode::BitwiseAnd:
+                case Opcode::BitwiseOr:
+                case Opcode::BitwiseXor:
+                case Opcode::LeftShift:
+                case Opcode::RightShift:
+                case Opcode::UnsignedRightShift:
+                case Opcode::Equal:
+                case Opcode::NotEqual:
+                case Opcode::StrictEqual:
+                case Opcode::StrictNotEqual:
+                case Opcode::LessThan:
+                case Opcode::LessThanOrEqual:
+                case Opcode::GreaterThan:
+                case Opcode::GreaterThanOrEqual:
+                    valid = reg(insn.a) && reg(insn.b) && reg(insn.c);
+                    break;
+                case Opcode::Jump:
+                    valid = target(insn);
+                    break;
+                case Opcode::JumpIfTrue:
+                case Opcode::JumpIfFalse:
+                case Opcode::JumpIfNotNullish:
+                case Opcode::PushHandler:
+                    valid = reg(insn.a) && target(insn);
+                    break;
+                // The callee and its arguments (and receiver) are one run
+                // of registers from b
+                case Opcode::Call:
+                case Opcode::Construct:
+                    valid = reg(insn.a) && reg(uint32_t{insn.b} + insn.c);
+                    break;
+                case Opcode::CallMethod:
+                    valid = reg(insn.a) && reg(uint32_t{insn.b} + insn.c + 1);
+                    break;
+                case Opcode::Closure:
+                    valid = reg(insn.a) && insn.b < function.functions.size();
+                    break;
+                case Opcode::ReturnUndefined:
+                case Opcode::PopHandler:
+                case Opcode::Debugger:
+                case Opcode::Nop:
+                    valid = true;
+                    break;
+                case Opcode::Count:
+                    break;
+            }
+            if (!valid) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+CodeCache::CodeCache(std::string directory, size_t maxBytes)
+    : directory_(std::move(directory)), maxBytes_(maxBytes), hits_(0), misses_(0), rejected_(0), stores_(0),
+      evictions_(0), savedTime_(0.0) {
+    std::error_code error;
+    fs::create_directories(directory_, error);
+}
+
+CodeCache::~CodeCache() = default;
+
+uint64_t CodeCache::hashSource(const std::string& source) {
+    return fnv1a(source);
+}
+
+// The opcode table in order, so adding, removing or reordering opcodes
+// retires old blobs without anyone remembering to; what an opcode means is
+// covered by kFormatVersion. Nothing depends on when the engine was built,
+// so identical builds share their caches.
+uint64_t CodeCache::buildId() {
+    static const uint64_t id = [] {
+        uint64_t hash = fnv1a(std::to_string(kFormatVersion) + ":" + std::to_string(sizeof(Instruction)));
+        for (uint16_t op = 0; op < static_cast<uint16_t>(Opcode::Count); ++op) {
+            hash = fnv1a(std::string(":") + opcodeName(static_cast<Opcode>(op)), hash);
+        }
+        return hash;
+    }();
+    return id;
+}
+
+std::string CodeCache::pathFor(uint64_t hash) const {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return (fs::path(directory_) / (std::string(name) + kExtension)).string();
+}
+
+std::shared_ptr<BytecodeFunction> CodeCache::load(const std::string& source) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t hash = hashSource(source);
+    std::string path = pathFor(hash);
+
+    apollo::MappedFile file(path);
+    const char* data = reinterpret_cast<const char*>(file.data());
+    if (!data) {
+        ++misses_;
+        return nullptr;
+    }
+
+    BlobHeader header;
+    bool valid = file.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, data, sizeof(header));
+        valid = header.magic == kMagic && header.version == kFormatVersion && header.buildId == buildId() &&
+                header.sourceHash == hash && header.sourceLength == source.size() &&
+                header.payloadSize == file.size() - sizeof(header);
+    }
+
+    std::shared_ptr<BytecodeFunction> function;
+    if (valid) {
+        auto shared = std::make_shared<const std::string>(source);
+        BlobReader reader(data + sizeof(header), file.size() - sizeof(header));
+        function = reader.getFunction(shared, nullptr);
+        if (!reader.ok() || !reader.atEnd()) {
+            function.reset();
+        }
+    }
+
+    std::error_code error;
+    if (!function) {
+        ++rejected_;
+        ++misses_;
+        fs::remove(path, error);
+        return nullptr;
+    }
+
+    // Touch the blob so eviction sees it as recently used
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    ++hits_;
+    double loadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    savedTime_ += std::max(0.0, header.compileMicros / 1000000.0 - loadTime);
+    return function;
+}
+
+bool CodeCache::store(const std::string& source, const BytecodeFunction& function, double compileTime) {
+    BlobWriter payload;
+    payload.putFunction(function);
+
+    BlobHeader header;
+    header.magic = kMagic;
+    header.version = kFormatVersion;
+    header.buildId = buildId();
+    header.sourceHash = hashSource(source);
+    header.sourceLength = source.size();
+    header.compileMicros = static_cast<uint64_t>(std::max(0.0, compileTime) * 1000000.0);
+    header.payloadSize = payload.data().size();
+    if (sizeof(header) + header.payloadSize > maxBytes_) {
+        return false;
+    }
+
+    // Written under a temporary name and renamed so readers never see a
+    // partial blob
+    std::string path = pathFor(header.sourceHash);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(payload.data().data(), static_cast<std::streamsize>(payload.data().size()));
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code error;
+    fs::rename(temporary, path, error);
+    if (error) {
+        fs::remove(temporary, error);
+        return false;
+    }
+
+    ++stores_;
+    evict();
+    return true;
+}
+
+void CodeCache::clear() {
+    std::error_code error;
+    for (fs::directory_iterator it(directory_, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() == kExtension) {
+            std::error_code ignored;
+            fs::remove(it->path(), ignored);
+        }
+    }
+}
+
+void CodeCache::setMaxBytes(size_t maxBytes) {
+    maxBytes_ = maxBytes;
+    evict();
+}
+
+double CodeCache::getHitRate() const {
+    size_t lookups = hits_ + misses_;
+    return lookups == 0 ? 0.0 : static_cast<double>(hits_) / lookups;
+}
+
+void CodeCache::resetStatistics() {
+    hits_ = 0;
+    misses_ = 0;
+    rejected_ = 0;
+    stores_ = 0;
+    evictions_ = 0;
+    savedTime_ = 0.0;
+}
+
+// Least recently used blobs go first until the directory fits
+void CodeCache::evict() {
+    struct Entry {
+        fs::path path;
+        uintmax_t size;
+        fs::file_time_type time;
+    };
+
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+    std::error_code error;
+    for (fs::directory_iterator it(directory_, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() != kExtension) {
+            continue;
+        }
+        std::error_code ignored;
+        Entry entry{it->path(), it->file_size(ignored), it->last_write_time(ignored)};
+        total += entry.size;
+        entries.push_back(std::move(entry));
+    }
+    if (total <= maxBytes_) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    for (const Entry& entry : entries) {
+        if (total <= maxBytes_) {
+            break;
+        }
+        std::error_code ignored;
+        if (fs::remove(entry.path, ignored)) {
+            total -= entry.size;
+            ++evictions_;
+        }
+    }
+}
+
+} // namespace js
@@ -0,0 +1,1536 @@
+#include "js/compiler.h"
+#include "js/parser.h"
+#include <algorithm>
+#include <limits>
+
+namespace js {
+
+namespace {
+
+// Thrown internally when a register-mode function turns out to contain an
+// inner function; the body is recompiled with named bindings.
+struct NeedsNamedScope {};
+
+constexpr uint16_t kMaxRegisters = std::numeric_limits<uint16_t>::max();
+
+// Whether evaluating expression cannot write a local: it is built of
+// literals, identifiers and operators only, with no assignment, update or
+// call anywhere in it
+bool cannotAssignLocals(Expression* expression) {
+    if (dynamic_cast<Literal*>(expression) || dynamic_cast<Identifier*>(expression)) {
+        return true;
+    }
+    if (auto* binary = dynamic_cast<BinaryExpression*>(expression)) {
+        return cannotAssignLocals(binary->left()) && cannotAssignLocals(binary->right());
+    }
+    if (auto* unary = dynamic_cast<UnaryExpression*>(expression)) {
+        return cannotAssignLocals(unary->argument());
+    }
+    return false;
+}
+
+} // namespace
+
+Compiler::Compiler()
+    : compiledFunctionCount_(0), lazyFunctionCount_(0), emittedInstructionCount_(0) {
+}
+
+Compiler::~Compiler() = default;
+
+std::shared_ptr<BytecodeFunction> Compiler::compile(Program* program) {
+    states_.clear();
+    return compileBody("<program>", "", nullptr, program->body(), nullptr, true, false);
+}
+
+std::shared_ptr<BytecodeFunction> Compiler::compile(Module* module) {
+    states_.clear();
+    return compileBody("<module>", "", nullptr, module->body(), nullptr, true, false);
+}
+
+std::shared_ptr<BytecodeFunction> Compiler::compileFunction(FunctionExpression* function) {
+    // A named function expression can refer to itself by its own name
+    std::string name = function->id() ? function->id()->name() : "";
+    if (function->isLazy()) {
+        return lazyStub(name, function->params(), *function->preparse(), false, function->isGenerator(),
+                        function->isAsync());
+    }
+    return compileBody(name, name, &function->params(), function->body()->body(), nullptr, false, false,
+                       function->isGenerator(), function->isAsync());
+}
+
+std::shared_ptr<BytecodeFunction> Compiler::compileFunction(FunctionDeclaration* function) {
+    std::string name = function->id() ? function->id()->name() : "";
+    if (function->isLazy()) {
+        return lazyStub(name, function->params(), *function->preparse(), true, function->isGenerator(),
+                        function->isAsync());
+    }
+    return compileBody(name, "", &function->params(), function->body()->body(), nullptr, false, false,
+                       function->isGenerator(), function->isAsync());
+}
+
+// The function source is re-parsed on its own, wrapped in parentheses so
+// declarations and anonymous expressions both parse as a function
+// expression. Its inner functions stay lazy relative to that text.
+void Compiler::compileLazy(BytecodeFunction& stub) {
+    std::shared_ptr<const LazyFunction> lazy = stub.lazy;
+    if (!lazy) {
+        return;
+    }
+
+    Parser parser("(" + lazy->source->substr(lazy->begin, lazy->end - lazy->begin) + ")");
+    parser.setArenaAllocation(true);
+    parser.setLazyFunctions(true);
+    auto ast = parser.parse();
+    if (parser.hasErrors()) {
+        throw std::runtime_error("SyntaxError: " + parser.errors().front().message);
+    }
+
+    FunctionExpression* function = nullptr;
+    if (auto* program = dynamic_cast<Program*>(ast->root())) {
+        if (!program->body().empty()) {
+            if (auto* statement = dynamic_cast<ExpressionStatement*>(program->body().front().get())) {
+                function = dynamic_cast<FunctionExpression*>(statement->expression());
+            }
+        }
+    }
+    if (!function || !function->body()) {
+        throw std::runtime_error("SyntaxError: invalid function source for " + stub.name);
+    }
+
+    Compiler compiler;
+    compiler.enclosingScope_ = lazy->enclosing;
+    std::string selfName = lazy->isDeclaration ? "" : stub.name;
+    auto compiled = compiler.compileBody(stub.name, selfName, &function->params(), function->body()->body(), nullptr,
+                                         false, false, function->isGenerator(), function->isAsync());
+    stub = std::move(*compiled);
+}
+
+std::shared_ptr<BytecodeFunction> Compiler::lazyStub(const std::string& name, const NodeList<Parameter>& params,
+                                                     const PreparseData& preparse, bool isDeclaration,
+                                                     bool isGenerator, bool isAsync) {
+    auto stub = std::make_shared<BytecodeFunction>();
+    stub->name = name;
+    stub->paramCount = static_cast<uint16_t>(params.size());
+    // Callers decide how to enter the function before its body is compiled
+    stub->isGenerator = isGenerator;
+    stub->isAsync = isAsync;
+    stub->registerCount = stub->paramCount;
+    stub->lazy = std::make_shared<const LazyFunction>(
+        LazyFunction{preparse.source, preparse.sourceStart, preparse.sourceEnd, isDeclaration, currentScope()});
+    ++lazyFunctionCount_;
+    return stub;
+}
+
+void Compiler::resetStatistics() {
+    compiledFunctionCount_ = 0;
+    lazyFunctionCount_ = 0;
+    emittedInstructionCount_ = 0;
+}
+
+// Function bodies
+
+std::shared_ptr<BytecodeFunction> Compiler::compileBody(const std::string& name,
+                                                        const std::string& selfName,
+                                                        const NodeList<Parameter>* params,
+                                                        const NodeList<Statement>& body,
+                                                        Expression* expressionBody,
+                                                        bool isTopLevel,
+                                                        bool isArrow,
+                                                        bool isGenerator,
+                                                        bool isAsync) {
+    if (isGenerator && isAsync) {
+        unsupported("async generator", nullptr);
+    }
+    if (isTopLevel) {
+        return compileBodyAttempt(name, selfName, params, body, expressionBody, true, isArrow, false, false, true);
+    }
+
+    try {
+        return compileBodyAttempt(name, selfName, params, body, expressionBody, false, isArrow, isGenerator, isAsync,
+                                  false);
+    } catch (const NeedsNamedScope&) {
+        return compileBodyAttempt(name, selfName, params, body, expressionBody, false, isArrow, isGenerator, isAsync,
+                                  true);
+    }
+}
+
+std::shared_ptr<BytecodeFunction> Compiler::compileBodyAttempt(const std::string& name,
+                                                               const std::string& selfName,
+                                                               const NodeList<Parameter>* params,
+                                                               const NodeList<Statement>& body,
+                                                               Expression* expressionBody,
+                                                               bool isTopLevel,
+                                                               bool isArrow,
+                                                               bool isGenerator,
+                                                               bool isAsync,
+                                                               bool named) {
+    std::shared_ptr<const ScopeLayout> enclosing = currentScope();
+    auto fresh = std::make_unique<FunctionState>();
+    fresh->function = std::make_shared<BytecodeFunction>();
+    fresh->function->name = name;
+    fresh->function->isTopLevel = isTopLevel;
+    fresh->function->isArrow = isArrow;
+    fresh->function->isGenerator = isGenerator;
+    fresh->function->isAsync = isAsync;
+    fresh->function->usesNamedScope = named && !isTopLevel;
+    fresh->selfName = selfName;
+    fresh->named = named;
+    states_.push_back(std::move(fresh));
+
+    try {
+        FunctionState& current = state();
+
+        // Parameters always arrive in the first registers
+        if (params) {
+            for (const auto& param : *params) {
+                if (!param->name()) {
+                    unsupported("destructuring parameter", param.get());
+                }
+                uint16_t reg = allocateRegister();
+                if (!named) {
+                    current.locals[param->name()->name()] = reg;
+                }
+            }
+            current.function->paramCount = static_cast<uint16_t>(params->size());
+        }
+
+        collectDeclarations(body);
+
+        if (!named) {
+            for (const auto& var : current.varNames) {
+                if (!current.locals.count(var)) {
+                    current.locals[var] = allocateRegister();
+                }
+            }
+        }
+
+        if (isTopLevel) {
+            current.completionRegister = allocateRegister();
+        }
+        current.firstTemporary = current.nextRegister;
+
+        // Prologue: lay out the scope (parameters, vars, own name) and copy
+        // the parameters into their slots; vars start out undefined
+        if (named && !isTopLevel) {
+            current.layout = std::make_shared<ScopeLayout>();
+            current.layout->parent = enclosing;
+            current.function->scope = current.layout;
+            if (params) {
+                for (size_t i = 0; i < params->size(); ++i) {
+                    emit(Opcode::StoreSlot, static_cast<uint16_t>(i), 0, addSlot((*params)[i]->name()->name()));
+                }
+            }
+            for (const auto& var : current.varNames) {
+                addSlot(var);
+            }
+            if (!selfName.empty() && !current.slots.count(selfName)) {
+                uint16_t callee = allocateRegister();
+                emit(Opcode::LoadCallee, callee);
+                emit(Opcode::StoreSlot, callee, 0, addSlot(selfName));
+            }
+            releaseRegisters(current.firstTemporary);
+        }
+
+        for (FunctionDeclaration* declaration : current.hoisted) {
+            if (!named) {
+                throw NeedsNamedScope();
+            }
+            uint16_t reg = allocateRegister();
+            compileClosure(compileFunction(declaration), reg);
+            declareBinding(declaration->id()->name(), reg);
+            releaseRegisters(current.firstTemporary);
+        }
+
+        if (expressionBody) {
+            uint16_t reg = compileToRegister(expressionBody);
+            emit(Opcode::Return, reg);
+        } else {
+            compileStatements(body);
+            if (isTopLevel) {
+                emit(Opcode::Return, current.completionRegister);
+            } else {
+                emit(Opcode::ReturnUndefined);
+            }
+        }
+    } catch (...) {
+        states_.pop_back();
+        throw;
+    }
+
+    auto result = states_.back()->function;
+    result->registerCount = std::max<uint16_t>(states_.back()->maxRegister, 1);
+    states_.pop_back();
+    ++compiledFunctionCount_;
+    return result;
+}
+
+void Compiler::collectDeclarations(const NodeList<Statement>& body) {
+    for (const auto& statement : body) {
+        collectDeclarations(statement.get());
+    }
+}
+
+// Gathers var names and function declarations of the current function body
+// without descending into nested functions. let/const are treated as
+// function-scoped here.
+void Compiler::collectDeclarations(Node* node) {
+    if (!node) {
+        return;
+    }
+
+    FunctionState& current = state();
+    auto addVar = [&current](const std::string& name) {
+        for (const auto& existing : current.varNames) {
+            if (existing == name) {
+                return;
+            }
+        }
+        current.varNames.push_back(name);
+    };
+
+    if (auto* statement = dynamic_cast<VariableStatement*>(node)) {
+        collectDeclarations(statement->declaration());
+    } else if (auto* declaration = dynamic_cast<VariableDeclaration*>(node)) {
+        for (const auto& declarator : declaration->declarations()) {
+            if (!declarator->id()) {
+                unsupported("destructuring declaration", declarator.get());
+            }
+            addVar(declarator->id()->name());
+        }
+    } else if (auto* statement = dynamic_cast<FunctionStatement*>(node)) {
+        auto* function = dynamic_cast<FunctionDeclaration*>(statement->declaration());
+        if (!function || !function->id()) {
+            unsupported("function statement", node);
+        }
+        addVar(function->id()->name());
+        current.hoisted.push_back(function);
+    } else if (auto* function = dynamic_cast<FunctionDeclaration*>(node)) {
+        if (!function->id()) {
+            unsupported("anonymous function declaration", node);
+        }
+        addVar(function->id()->name());
+        current.hoisted.push_back(function);
+    } else if (auto* block = dynamic_cast<BlockStatement*>(node)) {
+        collectDeclarations(block->body());
+    } else if (auto* statement = dynamic_cast<IfStatement*>(node)) {
+        collectDeclarations(statement->consequent());
+        collectDeclarations(statement->alternate());
+    } else if (auto* statement = dynamic_cast<ForStatement*>(node)) {
+        if (auto* init = dynamic_cast<VariableDeclaration*>(statement->init())) {
+            collectDeclarations(init);
+        }
+        collectDeclarations(statement->body());
+    } else if (auto* statement = dynamic_cast<WhileStatement*>(node)) {
+        collectDeclarations(statement->body());
+    } else if (auto* statement = dynamic_cast<DoWhileStatement*>(node)) {
+        collectDeclarations(statement->body());
+    } else if (auto* statement = dynamic_cast<LabeledStatement*>(node)) {
+        collectDeclarations(statement->body());
+    } else if (auto* statement = dynamic_cast<SwitchStatement*>(node)) {
+        for (const auto& clause : statement->cases()) {
+            collectDeclarations(clause->consequent());
+        }
+    } else if (auto* statement = dynamic_cast<TryStatement*>(node)) {
+        collectDeclarations(statement->block());
+        if (statement->handler()) {
+            if (statement->handler()->param()) {
+                addVar(statement->handler()->param()->name());
+            }
+            collectDeclarations(statement->handler()->body());
+        }
+        collectDeclarations(statement->finalizer());
+    }
+}
+
+// Statements
+
+void Compiler::compileStatements(const NodeList<Statement>& statements) {
+    for (const auto& statement : statements) {
+        compileStatement(statement.get());
+    }
+}
+
+void Compiler::compileStatement(Node* node) {
+    if (!node) {
+        return;
+    }
+
+    currentPosition_ = node->position();
+    uint16_t mark = state().nextRegister;
+
+    if (auto* statement = dynamic_cast<ExpressionStatement*>(node)) {
+        if (state().function->isTopLevel) {
+            compileExpression(statement->expression(), state().completionRegister);
+        } else {
+            compileExpression(statement->expression(), allocateRegister());
+        }
+    } else if (auto* statement = dynamic_cast<VariableStatement*>(node)) {
+        auto* declaration = dynamic_cast<VariableDeclaration*>(statement->declaration());
+        if (!declaration) {
+            unsupported("declaration", node);
+        }
+        compileVariableDeclaration(declaration);
+    } else if (auto* declaration = dynamic_cast<VariableDeclaration*>(node)) {
+        compileVariableDeclaration(declaration);
+    } else if (dynamic_cast<FunctionStatement*>(node) || dynamic_cast<FunctionDeclaration*>(node)) {
+        // Hoisted into the prologue
+    } else if (auto* block = dynamic_cast<BlockStatement*>(node)) {
+        compileStatements(block->body());
+    } else if (auto* statement = dynamic_cast<IfStatement*>(node)) {
+        compileIfStatement(statement);
+    } else if (auto* statement = dynamic_cast<WhileStatement*>(node)) {
+        compileWhileStatement(statement);
+    } else if (auto* statement = dynamic_cast<DoWhileStatement*>(node)) {
+        compileDoWhileStatement(statement);
+    } else if (auto* statement = dynamic_cast<ForStatement*>(node)) {
+        compileForStatement(statement);
+    } else if (auto* statement = dynamic_cast<SwitchStatement*>(node)) {
+        compileSwitchStatement(statement);
+    } else if (auto* statement = dynamic_cast<TryStatement*>(node)) {
+        compileTryStatement(statement);
+    } else if (auto* statement = dynamic_cast<ThrowStatement*>(node)) {
+        emit(Opcode::Throw, compileToRegister(statement->argument()));
+    } else if (auto* statement = dynamic_cast<ReturnStatement*>(node)) {
+        compileReturnStatement(statement);
+    } else if (auto* statement = dynamic_cast<BreakStatement*>(node)) {
+        compileBreakStatement(statement);
+    } else if (auto* statement = dynamic_cast<ContinueStatement*>(node)) {
+        compileContinueStatement(statement);
+    } else if (auto* statement = dynamic_cast<LabeledStatement*>(node)) {
+        compileLabeledStatement(statement);
+    } else if (dynamic_cast<DebuggerStatement*>(node)) {
+        emit(Opcode::Debugger);
+    } else {
+        unsupported("statement", node);
+    }
+
+    releaseRegisters(mark);
+}
+
+void Compiler::compileVariableDeclaration(VariableDeclaration* declaration) {
+    for (const auto& declarator : declaration->declarations()) {
+        const std::string& name = declarator->id()->name();
+        uint16_t mark = state().nextRegister;
+
+        if (isLocal(name)) {
+            uint16_t reg = state().locals[name];
+            if (declarator->init()) {
+                compileExpression(declarator->init(), reg);
+            } else if (declaration->kind() != "var") {
+                emit(Opcode::LoadUndefined, reg);
+            }
+        } else if (declarator->init()) {
+            uint16_t reg = allocateRegister();
+            compileExpression(declarator->init(), reg);
+            declareBinding(name, reg);
+        } else if (state().function->isTopLevel) {
+            uint16_t reg = allocateRegister();
+            emit(Opcode::LoadUndefined, reg);
+            declareBinding(name, reg);
+        }
+
+        releaseRegisters(mark);
+    }
+}
+
+void Compiler::compileIfStatement(IfStatement* statement) {
+    uint16_t mark = state().nextRegister;
+    uint16_t test = compileToRegister(statement->test());
+    size_t elseJump = emitJump(Opcode::JumpIfFalse, test);
+    releaseRegisters(mark);
+
+    compileStatement(statement->consequent());
+
+    if (statement->alternate()) {
+        size_t endJump = emitJump(Opcode::Jump);
+        patchJump(elseJump);
+        compileStatement(statement->alternate());
+        patchJump(endJump);
+    } else {
+        patchJump(elseJump);
+    }
+}
+
+void Compiler::compileWhileStatement(WhileStatement* statement) {
+    JumpScope scope{std::move(state().pendingLabel), true, state().handlerDepth, {}, {}};
+    state().pendingLabel.clear();
+
+    size_t loopStart = currentOffset();
+    uint16_t mark = state().nextRegister;
+    uint16_t test = compileToRegister(statement->test());
+    size_t exitJump = emitJump(Opcode::JumpIfFalse, test);
+    releaseRegisters(mark);
+
+    state().jumpScopes.push_back(std::move(scope));
+    compileStatement(statement->body());
+    JumpScope finished = std::move(state().jumpScopes.back());
+    state().jumpScopes.pop_back();
+
+    for (size_t jump : finished.continueJumps) {
+        patchJump(jump, loopStart);
+    }
+    size_t backJump = emitJump(Opcode::Jump);
+    patchJump(backJump, loopStart);
+    patchJump(exitJump);
+    for (size_t jump : finished.breakJumps) {
+        patchJump(jump);
+    }
+}
+
+void Compiler::compileDoWhileStatement(DoWhileStatement* statement) {
+    JumpScope scope{std::move(state().pendingLabel), true, state().handlerDepth, {}, {}};
+    state().pendingLabel.clear();
+
+    size_t loopStart = currentOffset();
+    state().jumpScopes.push_back(std::move(scope));
+    compileStatement(statement->body());
+    JumpScope finished = std::move(state().jumpScopes.back());
+    state().jumpScopes.pop_back();
+
+    for (size_t jump : finished.continueJumps) {
+        patchJump(jump);
+    }
+    uint16_t mark = state().nextRegister;
+    uint16_t test = compileToRegister(statement->test());
+    size_t backJump = emitJump(Opcode::JumpIfTrue, test);
+    patchJump(backJump, loopStart);
+    releaseRegisters(mark);
+
+    for (size_t jump : finished.breakJumps) {
+        patchJump(jump);
+    }
+}
+
+void Compiler::compileForStatement(ForStatement* statement) {
+    JumpScope scope{std::move(state().pendingLabel), true, state().handlerDepth, {}, {}};
+    state().pendingLabel.clear();
+
+    uint16_t mark = state().nextRegister;
+    if (auto* declaration = dynamic_cast<VariableDeclaration*>(statement->init())) {
+        compileVariableDeclaration(declaration);
+    } else if (statement->init()) {
+        compileExpression(statement->init(), allocateRegister());
+    }
+    releaseRegisters(mark);
+
+    size_t loopStart = currentOffset();
+    size_t exitJump = 0;
+    bool hasTest = statement->test() != nullptr;
+    if (hasTest) {
+        uint16_t test = compileToRegister(statement->test());
+        exitJump = emitJump(Opcode::JumpIfFalse, test);
+        releaseRegisters(mark);
+    }
+
+    state().jumpScopes.push_back(std::move(scope));
+    compileStatement(statement->body());
+    JumpScope finished = std::move(state().jumpScopes.back());
+    state().jumpScopes.pop_back();
+
+    for (size_t jump : finished.continueJumps) {
+        patchJump(jump);
+    }
+    if (statement->update()) {
+        compileExpression(statement->update(), allocateRegister());
+        releaseRegisters(mark);
+    }
+    size_t backJump = emitJump(Opcode::Jump);
+    patchJump(backJump, loopStart);
+
+    if (hasTest) {
+        patchJump(exitJump);
+    }
+    for (size_t jump : finished.breakJumps) {
+        patchJump(jump);
+    }
+}
+
+void Compiler::compileSwitchStatement(SwitchStatement* statement) {
+    JumpScope scope{std::move(state().pendingLabel), false, state().handlerDepth, {}, {}};
+    state().pendingLabel.clear();
+
+    uint16_t discriminant = allocateRegister();
+    compileExpression(statement->discriminant(), discriminant);
+
+    const auto& cases = statement->cases();
+    std::vector<size_t> caseJumps(cases.size(), 0);
+    uint16_t test = allocateRegister();
+    for (size_t i = 0; i < cases.size(); ++i) {
+        if (!cases[i]->test()) {
+            continue;
+        }
+        compileExpression(cases[i]->test(), test);
+        emit(Opcode::StrictEqual, test, discriminant, test);
+        caseJumps[i] = emitJump(Opcode::JumpIfTrue, test);
+    }
+    size_t defaultJump = emitJump(Opcode::Jump);
+
+    state().jumpScopes.push_back(std::move(scope));
+    bool hasDefault = false;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        if (cases[i]->test()) {
+            patchJump(caseJumps[i]);
+        } else {
+            patchJump(defaultJump);
+            hasDefault = true;
+        }
+        compileStatements(cases[i]->consequent());
+    }
+    JumpScope finished = std::move(state().jumpScopes.back());
+    state().jumpScopes.pop_back();
+
+    if (!hasDefault) {
+        patchJump(defaultJump);
+    }
+    for (size_t jump : finished.breakJumps) {
+        patchJump(jump);
+    }
+    if (!finished.continueJumps.empty()) {
+        // continue inside a switch targets the enclosing loop
+        for (auto it = state().jumpScopes.rbegin(); it != state().jumpScopes.rend(); ++it) {
+            if (it->isLoop) {
+                it->continueJumps.insert(it->continueJumps.end(), finished.continueJumps.begin(), finished.continueJumps.end());
+                break;
+            }
+        }
+    }
+}
+
+// Layout of try/catch/finally:
+//
+//     PushHandler exc -> catch
+//     <block>
+//     PopHandler
+//     Jump finally
+//   catch:
+//     [PushHandler exc2 -> rethrow]     only with a finalizer
+//     <catch body>
+//     [PopHandler; Jump finally]
+//   rethrow:
+//     [<finalizer>; Throw exc2]
+//   finally:
+//     <finalizer>
+//
+// break, continue and return leaving the block or the catch body pop the
+// try's handlers and run their own copy of the finalizer on the way out.
+void Compiler::compileTryStatement(TryStatement* statement) {
+    CatchClause* handler = statement->handler();
+    BlockStatement* finalizer = statement->finalizer();
+
+    uint16_t exception = allocateRegister();
+    if (handler && handler->param() && isLocal(handler->param()->name())) {
+        exception = state().locals[handler->param()->name()];
+    }
+
+    if (finalizer) {
+        state().finallyScopes.push_back(FinallyScope{finalizer, state().handlerDepth, state().jumpScopes.size()});
+    }
+    size_t handlerJump = emitJump(Opcode::PushHandler, exception);
+    ++state().handlerDepth;
+    compileStatement(statement->block());
+    --state().handlerDepth;
+    emit(Opcode::PopHandler);
+    size_t normalJump = emitJump(Opcode::Jump);
+
+    patchJump(handlerJump);
+    std::vector<size_t> finallyJumps{normalJump};
+
+    if (handler) {
+        size_t rethrowJump = 0;
+        uint16_t pending = 0;
+        if (finalizer) {
+            pending = allocateRegister();
+            rethrowJump = emitJump(Opcode::PushHandler, pending);
+            ++state().handlerDepth;
+        }
+
+        if (handler->param() && !isLocal(handler->param()->name())) {
+            declareBinding(handler->param()->name(), exception);
+        }
+        compileStatement(handler->body());
+
+        if (finalizer) {
+            state().finallyScopes.pop_back();
+            --state().handlerDepth;
+            emit(Opcode::PopHandler);
+            finallyJumps.push_back(emitJump(Opcode::Jump));
+            patchJump(rethrowJump);
+            compileStatement(finalizer);
+            emit(Opcode::Throw, pending);
+        }
+    } else if (finalizer) {
+        state().finallyScopes.pop_back();
+        compileStatement(finalizer);
+        emit(Opcode::Throw, exception);
+    }
+
+    for (size_t jump : finallyJumps) {
+        patchJump(jump);
+    }
+    if (finalizer) {
+        compileStatement(finalizer);
+    }
+}
+
+void Compiler::compileReturnStatement(ReturnStatement* statement) {
+    if (state().finallyScopes.empty()) {
+        if (!statement->argument()) {
+            emit(Opcode::ReturnUndefined);
+            return;
+        }
+        emit(Opcode::Return, compileToRegister(statement->argument()));
+        return;
+    }
+
+    // The value is taken before the finalizers run, which may assign it
+    uint16_t value = 0;
+    if (statement->argument()) {
+        value = allocateRegister();
+        compileExpression(statement->argument(), value);
+    }
+    emitFinalizers(0, state().handlerDepth);
+    if (statement->argument()) {
+        emit(Opcode::Return, value);
+    } else {
+        emit(Opcode::ReturnUndefined);
+    }
+}
+
+// Jump scopes are found by index: inlining a finalizer may push scopes of
+// its own and move the vector
+void Compiler::compileBreakStatement(BreakStatement* statement) {
+    for (size_t i = state().jumpScopes.size(); i-- > 0;) {
+        const JumpScope& scope = state().jumpScopes[i];
+        if (statement->label() ? scope.label == statement->label()->name() : true) {
+            emitFinalizers(i + 1, scope.handlerDepth);
+            state().jumpScopes[i].breakJumps.push_back(emitJump(Opcode::Jump));
+            return;
+        }
+    }
+    unsupported("break outside of loop", statement);
+}
+
+void Compiler::compileContinueStatement(ContinueStatement* statement) {
+    for (size_t i = state().jumpScopes.size(); i-- > 0;) {
+        const JumpScope& scope = state().jumpScopes[i];
+        if (!scope.isLoop) {
+            continue;
+        }
+        if (statement->label() ? scope.label == statement->label()->name() : true) {
+            emitFinalizers(i + 1, scope.handlerDepth);
+            state().jumpScopes[i].continueJumps.push_back(emitJump(Opcode::Jump));
+            return;
+        }
+    }
+    unsupported("continue outside of loop", statement);
+}
+
+void Compiler::compileLabeledStatement(LabeledStatement* statement) {
+    Statement* body = statement->body();
+    if (dynamic_cast<WhileStatement*>(body) || dynamic_cast<DoWhileStatement*>(body) ||
+        dynamic_cast<ForStatement*>(body) || dynamic_cast<SwitchStatement*>(body)) {
+        state().pendingLabel = statement->label()->name();
+        compileStatement(body);
+        return;
+    }
+
+    // Labeled block: only `break label` is meaningful
+    state().jumpScopes.push_back(JumpScope{statement->label()->name(), false, state().handlerDepth, {}, {}});
+    compileStatement(body);
+    JumpScope finished = std::move(state().jumpScopes.back());
+    state().jumpScopes.pop_back();
+    for (size_t jump : finished.breakJumps) {
+        patchJump(jump);
+    }
+}
+
+// Expressions
+
+uint16_t Compiler::compileToRegister(Expression* expression) {
+    if (auto* identifier = dynamic_cast<Identifier*>(expression)) {
+        auto it = state().locals.find(identifier->name());
+        if (it != state().locals.end()) {
+            return it->second;
+        }
+    }
+    uint16_t reg = allocateRegister();
+    compileExpression(expression, reg);
+    return reg;
+}
+
+void Compiler::compileExpression(Expression* expression, uint16_t dst) {
+    if (!expression) {
+        emit(Opcode::LoadUndefined, dst);
+        return;
+    }
+
+    currentPosition_ = expression->position();
+    uint16_t mark = state().nextRegister;
+
+    if (auto* identifier = dynamic_cast<Identifier*>(expression)) {
+        compileIdentifier(identifier, dst);
+    } else if (auto* literal = dynamic_cast<Literal*>(expression)) {
+        compileLiteral(literal, dst);
+    } else if (dynamic_cast<ThisExpression*>(expression)) {
+        emit(Opcode::LoadThis, dst);
+    } else if (auto* binary = dynamic_cast<BinaryExpression*>(expression)) {
+        compileBinaryExpression(binary, dst);
+    } else if (auto* logical = dynamic_cast<LogicalExpression*>(expression)) {
+        compileLogicalExpression(logical, dst);
+    } else if (auto* unary = dynamic_cast<UnaryExpression*>(expression)) {
+        compileUnaryExpression(unary, dst);
+    } else if (auto* update = dynamic_cast<UpdateExpression*>(expression)) {
+        compileUpdateExpression(update, dst);
+    } else if (auto* assignment = dynamic_cast<AssignmentExpression*>(expression)) {
+        compileAssignmentExpression(assignment, dst);
+    } else if (auto* conditional = dynamic_cast<ConditionalExpression*>(expression)) {
+        compileConditionalExpression(conditional, dst);
+    } else if (auto* call = dynamic_cast<CallExpression*>(expression)) {
+        compileCallExpression(call, dst);
+    } else if (auto* construct = dynamic_cast<NewExpression*>(expression)) {
+        compileNewExpression(construct, dst);
+    } else if (auto* member = dynamic_cast<MemberExpression*>(expression)) {
+        compileMemberExpression(member, dst);
+    } else if (auto* array = dynamic_cast<ArrayExpression*>(expression)) {
+        compileArrayExpression(array, dst);
+    } else if (auto* object = dynamic_cast<ObjectExpression*>(expression)) {
+        compileObjectExpression(object, dst);
+    } else if (auto* sequence = dynamic_cast<SequenceExpression*>(expression)) {
+        compileSequenceExpression(sequence, dst);
+    } else if (auto* templateLiteral = dynamic_cast<TemplateLiteral*>(expression)) {
+        compileTemplateLiteral(templateLiteral, dst);
+    } else if (auto* yield = dynamic_cast<YieldExpression*>(expression)) {
+        compileYieldExpression(yield, dst);
+    } else if (auto* await = dynamic_cast<AwaitExpression*>(expression)) {
+        compileAwaitExpression(await, dst);
+    } else if (auto* function = dynamic_cast<FunctionExpression*>(expression)) {
+        if (!state().named) {
+            throw NeedsNamedScope();
+        }
+        compileClosure(compileFunction(function), dst);
+    } else if (auto* arrow = dynamic_cast<ArrowFunctionExpression*>(expression)) {
+        if (!state().named) {
+            throw NeedsNamedScope();
+        }
+        static const NodeList<Statement> noStatements;
+        compileClosure(compileBody("", "", &arrow->params(), noStatements, arrow->body(), false, true), dst);
+    } else {
+        unsupported("expression", expression);
+    }
+
+    releaseRegisters(mark);
+}
+
+void Compiler::compileIdentifier(Identifier* identifier, uint16_t dst) {
+    const std::string& name = identifier->name();
+    if (name == "undefined" && !isLocal(name)) {
+        emit(Opcode::LoadUndefined, dst);
+        return;
+    }
+    if (name == "arguments" && !state().function->isTopLevel && !isLocal(name)) {
+        unsupported("arguments object", identifier);
+    }
+    loadBinding(name, dst);
+}
+
+void Compiler::compileLiteral(Literal* literal, uint16_t dst) {
+    if (auto* string = dynamic_cast<StringLiteral*>(literal)) {
+        emit(Opcode::LoadConst, dst, addConstant(Constant(string->value())));
+    } else if (auto* number = dynamic_cast<NumericLiteral*>(literal)) {
+        emit(Opcode::LoadConst, dst, addConstant(Constant(number->value())));
+    } else if (auto* boolean = dynamic_cast<BooleanLiteral*>(literal)) {
+        emit(boolean->value() ? Opcode::LoadTrue : Opcode::LoadFalse, dst);
+    } else if (dynamic_cast<NullLiteral*>(literal)) {
+        emit(Opcode::LoadNull, dst);
+    } else if (dynamic_cast<UndefinedLiteral*>(literal)) {
+        emit(Opcode::LoadUndefined, dst);
+    } else {
+        unsupported("literal", literal);
+    }
+}
+
+void Compiler::compileBinaryExpression(BinaryExpression* expression, uint16_t dst) {
+    Opcode op = binaryOpcode(expression->operatorType(), expression->position());
+    uint16_t left = compileToRegister(expression->left());
+    // A local read on the left is copied when the right operand may write
+    // it, as in x + (x = 1) or i + i++
+    if (left < state().firstTemporary && !cannotAssignLocals(expression->right())) {
+        uint16_t copy = allocateRegister();
+        emit(Opcode::Move, copy, left);
+        left = copy;
+    }
+    uint16_t right = compileToRegister(expression->right());
+    emit(op, dst, left, right);
+}
+
+void Compiler::compileLogicalExpression(LogicalExpression* expression, uint16_t dst) {
+    Opcode jump;
+    switch (expression->operatorType()) {
+        case OperatorType::LogicalAnd: jump = Opcode::JumpIfFalse; break;
+        case OperatorType::LogicalOr: jump = Opcode::JumpIfTrue; break;
+        case OperatorType::NullishCoalescing: jump = Opcode::JumpIfNotNullish; break;
+        default: unsupported("logical operator", expression);
+    }
+
+    // A local destination may be read by the right operand
+    uint16_t target = dst < state().firstTemporary ? allocateRegister() : dst;
+    compileExpression(expression->left(), target);
+    size_t endJump = emitJump(jump, target);
+    compileExpression(expression->right(), target);
+    patchJump(endJump);
+    if (target != dst) {
+        emit(Opcode::Move, dst, target);
+    }
+}
+
+void Compiler::compileUnaryExpression(UnaryExpression* expression, uint16_t dst) {
+    Opcode op;
+    switch (expression->operatorType()) {
+        case OperatorType::Subtract:
+        case OperatorType::UnaryMinus: op = Opcode::Negate; break;
+        case OperatorType::Add:
+        case OperatorType::UnaryPlus: op = Opcode::UnaryPlus; break;
+        case OperatorType::LogicalNot: op = Opcode::LogicalNot; break;
+        case OperatorType::BitwiseNot: op = Opcode::BitwiseNot; break;
+        case OperatorType::TypeOf: op = Opcode::TypeOf; break;
+        case OperatorType::Void:
+            compileToRegister(expression->argument());
+            emit(Opcode::LoadUndefined, dst);
+            return;
+        default:
+            unsupported("unary operator", expression);
+    }
+    emit(op, dst, compileToRegister(expression->argument()));
+}
+
+void Compiler::compileUpdateExpression(UpdateExpression* expression, uint16_t dst) {
+    Opcode op = expression->operatorType() == OperatorType::Decrement ? Opcode::Decrement : Opcode::Increment;
+    Expression* argument = expression->argument();
+
+    if (auto* identifier = dynamic_cast<Identifier*>(argument)) {
+        const std::string& name = identifier->name();
+        if (isLocal(name)) {
+            uint16_t reg = state().locals[name];
+            if (expression->prefix()) {
+                emit(op, reg, reg);
+                if (dst != reg) {
+                    emit(Opcode::Move, dst, reg);
+                }
+            } else {
+                if (dst != reg) {
+                    emit(Opcode::UnaryPlus, dst, reg);
+                }
+                emit(op, reg, reg);
+            }
+            return;
+        }
+
+        uint16_t value = allocateRegister();
+        loadBinding(name, value);
+        if (expression->prefix()) {
+            emit(op, value, value);
+            emit(Opcode::Move, dst, value);
+        } else {
+            emit(Opcode::UnaryPlus, dst, value);
+            emit(op, value, value);
+        }
+        storeBinding(name, value);
+        return;
+    }
+
+    if (auto* member = dynamic_cast<MemberExpression*>(argument)) {
+        uint16_t object = compileToRegister(member->object());
+        uint16_t value = allocateRegister();
+        uint16_t key = 0;
+        uint16_t name = 0;
+        if (member->computed()) {
+            key = compileToRegister(member->property());
+            emit(Opcode::GetElement, value, object, key);
+        } else {
+            auto* property = dynamic_cast<Identifier*>(member->property());
+            if (!property) {
+                unsupported("member property", member);
+            }
+            name = addName(property->name());
+            emit(Opcode::GetProperty, value, object, name);
+        }
+        if (expression->prefix()) {
+            emit(op, value, value);
+            emit(Opcode::Move, dst, value);
+        } else {
+            emit(Opcode::UnaryPlus, dst, value);
+            emit(op, value, value);
+        }
+        if (member->computed()) {
+            emit(Opcode::SetElement, object, key, value);
+        } else {
+            emit(Opcode::SetProperty, object, name, value);
+        }
+        return;
+    }
+
+    unsupported("update target", expression);
+}
+
+void Compiler::compileAssignmentExpression(AssignmentExpression* expression, uint16_t dst) {
+    OperatorType type = expression->operatorType();
+    bool compound = type != OperatorType::Assign;
+    Opcode op = Opcode::Nop;
+    if (compound) {
+        switch (type) {
+            case OperatorType::AddAssign: op = Opcode::Add; break;
+            case OperatorType::SubtractAssign: op = Opcode::Subtract; break;
+            case OperatorType::MultiplyAssign: op = Opcode::Multiply; break;
+            case OperatorType::DivideAssign: op = Opcode::Divide; break;
+            case OperatorType::ModuloAssign: op = Opcode::Modulo; break;
+            case OperatorType::ExponentAssign: op = Opcode::Exponent; break;
+            case OperatorType::LeftShiftAssign: op = Opcode::LeftShift; break;
+            case OperatorType::RightShiftAssign: op = Opcode::RightShift; break;
+            case OperatorType::UnsignedRightShiftAssign: op = Opcode::UnsignedRightShift; break;
+            case OperatorType::BitwiseAndAssign: op = Opcode::BitwiseAnd; break;
+            case OperatorType::BitwiseXorAssign: op = Opcode::BitwiseXor; break;
+            case OperatorType::BitwiseOrAssign: op = Opcode::BitwiseOr; break;
+            default: unsupported("assignment operator", expression);
+        }
+    }
+
+    Expression* left = expression->left();
+
+    if (auto* identifier = dynamic_cast<Identifier*>(left)) {
+        const std::string& name = identifier->name();
+        if (isLocal(name)) {
+            uint16_t reg = state().locals[name];
+            if (compound) {
+                emit(op, reg, reg, compileToRegister(expression->right()));
+            } else {
+                compileExpression(expression->right(), reg);
+            }
+            if (dst != reg) {
+                emit(Opcode::Move, dst, reg);
+            }
+            return;
+        }
+
+        if (compound) {
+            uint16_t value = allocateRegister();
+            loadBinding(name, value);
+            emit(op, dst, value, compileToRegister(expression->right()));
+        } else {
+            compileExpression(expression->right(), dst);
+        }
+        storeBinding(name, dst);
+        return;
+    }
+
+    if (auto* member = dynamic_cast<MemberExpression*>(left)) {
+        uint16_t object = compileToRegister(member->object());
+        if (member->computed()) {
+            uint16_t key = compileToRegister(member->property());
+            if (compound) {
+                uint16_t value = allocateRegister();
+                emit(Opcode::GetElement, value, object, key);
+                emit(op, dst, value, compileToRegister(expression->right()));
+            } else {
+                compileExpression(expression->right(), dst);
+            }
+            emit(Opcode::SetElement, object, key, dst);
+        } else {
+            auto* property = dynamic_cast<Identifier*>(member->property());
+            if (!property) {
+                unsupported("member property", member);
+            }
+            uint16_t name = addName(property->name());
+            if (compound) {
+                uint16_t value = allocateRegister();
+                emit(Opcode::GetProperty, value, object, name);
+                emit(op, dst, value, compileToRegister(expression->right()));
+            } else {
+                compileExpression(expression->right(), dst);
+            }
+            emit(Opcode::SetProperty, object, name, dst);
+        }
+        return;
+    }
+
+    unsupported("assignment target", expression);
+}
+
+void Compiler::compileConditionalExpression(ConditionalExpression* expression, uint16_t dst) {
+    uint16_t mark = state().nextRegister;
+    uint16_t test = compileToRegister(expression->test());
+    size_t elseJump = emitJump(Opcode::JumpIfFalse, test);
+    releaseRegisters(mark);
+
+    uint16_t target = dst < state().firstTemporary ? allocateRegister() : dst;
+    compileExpression(expression->consequent(), target);
+    size_t endJump = emitJump(Opcode::Jump);
+    patchJump(elseJump);
+    compileExpression(expression->alternate(), target);
+    patchJump(endJump);
+    if (target != dst) {
+        emit(Opcode::Move, dst, target);
+    }
+}
+
+uint16_t Compiler::compileArguments(const NodeList<Expression>& arguments) {
+    for (const auto& argument : arguments) {
+        compileExpression(argument.get(), allocateRegister());
+    }
+    return static_cast<uint16_t>(arguments.size());
+}
+
+void Compiler::compileCallExpression(CallExpression* expression, uint16_t dst) {
+    if (auto* member = dynamic_cast<MemberExpression*>(expression->callee())) {
+        uint16_t base = allocateRegisters(2);
+        uint16_t thisReg = static_cast<uint16_t>(base + 1);
+        compileExpression(member->object(), thisReg);
+        if (member->computed()) {
+            uint16_t key = compileToRegister(member->property());
+            emit(Opcode::GetElement, base, thisReg, key);
+            releaseRegisters(static_cast<uint16_t>(base + 2));
+        } else {
+            auto* property = dynamic_cast<Identifier*>(member->property());
+            if (!property) {
+                unsupported("member property", member);
+            }
+            emit(Opcode::GetProperty, base, thisReg, addName(property->name()));
+        }
+        uint16_t argc = compileArguments(expression->arguments());
+        emit(Opcode::CallMethod, dst, base, argc);
+        return;
+    }
+
+    uint16_t base = allocateRegister();
+    compileExpression(expression->callee(), base);
+    uint16_t argc = compileArguments(expression->arguments());
+    emit(Opcode::Call, dst, base, argc);
+}
+
+void Compiler::compileNewExpression(NewExpression* expression, uint16_t dst) {
+    uint16_t base = allocateRegister();
+    compileExpression(expression->callee(), base);
+    uint16_t argc = compileArguments(expression->arguments());
+    emit(Opcode::Construct, dst, base, argc);
+}
+
+void Compiler::compileMemberExpression(MemberExpression* expression, uint16_t dst) {
+    uint16_t object = compileToRegister(expression->object());
+    if (expression->computed()) {
+        emit(Opcode::GetElement, dst, object, compileToRegister(expression->property()));
+        return;
+    }
+
+    auto* property = dynamic_cast<Identifier*>(expression->property());
+    if (!property) {
+        unsupported("member property", expression);
+    }
+    emit(Opcode::GetProperty, dst, object, addName(property->name()));
+}
+
+void Compiler::compileArrayExpression(ArrayExpression* expression, uint16_t dst) {
+    uint16_t array = allocateRegister();
+    emit(Opcode::NewArray, array);
+    uint16_t element = allocateRegister();
+    for (const auto& item : expression->elements()) {
+        if (item && item->expression()) {
+            compileExpression(item->expression(), element);
+        } else {
+            emit(Opcode::LoadUndefined, element);
+        }
+        emit(Opcode::ArrayPush, array, element);
+    }
+    emit(Opcode::Move, dst, array);
+}
+
+void Compiler::compileObjectExpression(ObjectExpression* expression, uint16_t dst) {
+    uint16_t object = allocateRegister();
+    emit(Opcode::NewObject, object);
+    uint16_t value = allocateRegister();
+    for (const auto& property : expression->properties()) {
+        Expression* key = property->key();
+        if (property->computed()) {
+            uint16_t keyReg = allocateRegister();
+            compileExpression(key, keyReg);
+            compileExpression(property->value(), value);
+            emit(Opcode::SetElement, object, keyReg, value);
+            releaseRegisters(static_cast<uint16_t>(value + 1));
+            continue;
+        }
+
+        std::string name;
+        if (auto* identifier = dynamic_cast<Identifier*>(key)) {
+            name = identifier->name();
+        } else if (auto* string = dynamic_cast<StringLiteral*>(key)) {
+            name = string->value();
+        } else if (auto* number = dynamic_cast<NumericLiteral*>(key)) {
+            name = number->raw();
+        } else {
+            unsupported("property key", property.get());
+        }
+        compileExpression(property->value(), value);
+        emit(Opcode::SetProperty, object, addName(name), value);
+    }
+    emit(Opcode::Move, dst, object);
+}
+
+void Compiler::compileSequenceExpression(SequenceExpression* expression, uint16_t dst) {
+    for (const auto& item : expression->expressions()) {
+        compileExpression(item.get(), dst);
+    }
+}
+
+// Spans and substitutions are added left to right into an accumulator
+// (dst may be a binding a substitution reads). String + anything makes a
+// rope, so the text is copied once, when the result is first read. The
+// first span is loaded even when empty, which makes the result a string.
+void Compiler::compileTemplateLiteral(TemplateLiteral* expression, uint16_t dst) {
+    const auto& quasis = expression->quasis();
+    const auto& expressions = expression->expressions();
+    uint16_t result = allocateRegister();
+    uint16_t part = allocateRegister();
+    emit(Opcode::LoadConst, result, addConstant(Constant(quasis.empty() ? std::string() : quasis[0]->cooked())));
+    for (size_t i = 0; i < expressions.size(); ++i) {
+        compileExpression(expressions[i].get(), part);
+        emit(Opcode::Add, result, result, part);
+        if (i + 1 < quasis.size() && !quasis[i + 1]->cooked().empty()) {
+            emit(Opcode::LoadConst, part, addConstant(Constant(quasis[i + 1]->cooked())));
+            emit(Opcode::Add, result, result, part);
+        }
+    }
+    emit(Opcode::Move, dst, result);
+}
+
+// The whole register window is saved when the generator suspends, so
+// temporaries live across the yield
+void Compiler::compileYieldExpression(YieldExpression* expression, uint16_t dst) {
+    if (!function().isGenerator) {
+        unsupported("yield outside of a generator", expression);
+    }
+    if (expression->delegate()) {
+        compileYieldDelegate(expression, dst);
+        return;
+    }
+    emit(Opcode::Yield, dst, compileToRegister(expression->argument()));
+}
+
+// yield* drives the inner iterator through next() and yields each value
+// until it reports done; the result is the inner iterator's return value.
+// throw() and return() are not forwarded to the inner iterator.
+void Compiler::compileYieldDelegate(YieldExpression* expression, uint16_t dst) {
+    uint16_t iterator = allocateRegister();
+    compileExpression(expression->argument(), iterator);
+    uint16_t received = allocateRegister();
+    uint16_t result = allocateRegister();
+    uint16_t flag = allocateRegister();
+    uint16_t base = allocateRegisters(3);
+    uint16_t thisReg = static_cast<uint16_t>(base + 1);
+    uint16_t argument = static_cast<uint16_t>(base + 2);
+    emit(Opcode::LoadUndefined, received);
+
+    size_t loop = currentOffset();
+    emit(Opcode::Move, thisReg, iterator);
+    emit(Opcode::GetProperty, base, thisReg, addName("next"));
+    emit(Opcode::Move, argument, received);
+    emit(Opcode::CallMethod, result, base, 1);
+    emit(Opcode::GetProperty, flag, result, addName("done"));
+    size_t exit = emitJump(Opcode::JumpIfTrue, flag);
+    emit(Opcode::GetProperty, flag, result, addName("value"));
+    emit(Opcode::Yield, received, flag);
+    patchJump(emitJump(Opcode::Jump), loop);
+
+    patchJump(exit);
+    emit(Opcode::GetProperty, dst, result, addName("value"));
+}
+
+void Compiler::compileAwaitExpression(AwaitExpression* expression, uint16_t dst) {
+    if (!function().isAsync) {
+        unsupported("await outside of an async function", expression);
+    }
+    emit(Opcode::Await, dst, compileToRegister(expression->argument()));
+}
+
+void Compiler::compileClosure(std::shared_ptr<BytecodeFunction> inner, uint16_t dst) {
+    auto& functions = function().functions;
+    if (functions.size() >= kMaxRegisters) {
+        unsupported("too many nested functions", nullptr);
+    }
+    functions.push_back(std::move(inner));
+    emit(Opcode::Closure, dst, static_cast<uint16_t>(functions.size() - 1));
+}
+
+// Bindings
+
+bool Compiler::isLocal(const std::string& name) const {
+    return states_.back()->locals.count(name) != 0;
+}
+
+uint16_t Compiler::addSlot(const std::string& name) {
+    FunctionState& current = state();
+    auto it = current.slots.find(name);
+    if (it != current.slots.end()) {
+        return it->second;
+    }
+    if (current.layout->names.size() >= kMaxRegisters) {
+        unsupported("scope slot overflow", nullptr);
+    }
+    uint16_t slot = static_cast<uint16_t>(current.layout->names.size());
+    current.layout->names.push_back(name);
+    current.slots[name] = slot;
+    return slot;
+}
+
+// Walks the named scopes a reference would see at runtime, innermost first:
+// functions still being compiled, then (for lazy bodies) the layouts
+// recorded on the stub. Names that are not found are globals.
+bool Compiler::resolveSlot(const std::string& name, uint16_t& depth, uint16_t& slot) const {
+    uint16_t hops = 0;
+    for (auto it = states_.rbegin(); it != states_.rend(); ++it) {
+        const FunctionState& enclosing = **it;
+        if (enclosing.function->isTopLevel) {
+            return false;
+        }
+        if (!enclosing.layout) {
+            continue;
+        }
+        auto found = enclosing.slots.find(name);
+        if (found != enclosing.slots.end()) {
+            depth = hops;
+            slot = found->second;
+            return true;
+        }
+        ++hops;
+    }
+
+    for (const ScopeLayout* layout = enclosingScope_.get(); layout; layout = layout->parent.get()) {
+        int found = layout->find(name);
+        if (found >= 0) {
+            depth = hops;
+            slot = static_cast<uint16_t>(found);
+            return true;
+        }
+        ++hops;
+    }
+    return false;
+}
+
+// Innermost named scope, i.e. the one a closure created here captures
+std::shared_ptr<const ScopeLayout> Compiler::currentScope() const {
+    for (auto it = states_.rbegin(); it != states_.rend(); ++it) {
+        if ((*it)->function->isTopLevel) {
+            return nullptr;
+        }
+        if ((*it)->layout) {
+            return (*it)->layout;
+        }
+    }
+    return enclosingScope_;
+}
+
+void Compiler::loadBinding(const std::string& name, uint16_t dst) {
+    auto it = state().locals.find(name);
+    if (it != state().locals.end()) {
+        if (it->second != dst) {
+            emit(Opcode::Move, dst, it->second);
+        }
+        return;
+    }
+    if (!state().named && name == state().selfName) {
+        emit(Opcode::LoadCallee, dst);
+        return;
+    }
+    uint16_t depth = 0;
+    uint16_t slot = 0;
+    if (resolveSlot(name, depth, slot)) {
+        emit(Opcode::LoadSlot, dst, depth, slot);
+        return;
+    }
+    emit(Opcode::LoadName, dst, addName(name));
+}
+
+void Compiler::storeBinding(const std::string& name, uint16_t src) {
+    auto it = state().locals.find(name);
+    if (it != state().locals.end()) {
+        if (it->second != src) {
+            emit(Opcode::Move, it->second, src);
+        }
+        return;
+    }
+    uint16_t depth = 0;
+    uint16_t slot = 0;
+    if (resolveSlot(name, depth, slot)) {
+        emit(Opcode::StoreSlot, src, depth, slot);
+        return;
+    }
+    emit(Opcode::StoreName, src, addName(name));
+}
+
+void Compiler::declareBinding(const std::string& name, uint16_t src) {
+    auto it = state().locals.find(name);
+    if (it != state().locals.end()) {
+        if (it->second != src) {
+            emit(Opcode::Move, it->second, src);
+        }
+        return;
+    }
+    if (state().layout) {
+        emit(Opcode::StoreSlot, src, 0, addSlot(name));
+        return;
+    }
+    emit(Opcode::DeclareName, src, addName(name));
+}
+
+// Emission helpers
+
+size_t Compiler::emit(Opcode op, uint16_t a, uint16_t b, uint16_t c) {
+    BytecodeFunction& fn = function();
+    fn.code.emplace_back(op, a, b, c);
+    fn.positions.push_back(currentPosition_);
+    if (op == Opcode::GetProperty || op == Opcode::SetProperty) {
+        fn.cacheSlots.push_back(static_cast<uint32_t>(fn.propertyCaches.size()));
+        fn.propertyCaches.emplace_back();
+    } else {
+        fn.cacheSlots.push_back(0);
+    }
+    ++emittedInstructionCount_;
+    return fn.code.size() - 1;
+}
+
+size_t Compiler::emitJump(Opcode op, uint16_t a) {
+    return emit(op, a);
+}
+
+void Compiler::patchJump(size_t index) {
+    patchJump(index, currentOffset());
+}
+
+void Compiler::patchJump(size_t index, size_t target) {
+    function().code[index].setTarget(static_cast<uint32_t>(target));
+}
+
+size_t Compiler::currentOffset() const {
+    return states_.back()->function->code.size();
+}
+
+uint16_t Compiler::addConstant(const Constant& constant) {
+    std::string key = constant.kind == Constant::Kind::Number
+        ? "n:" + std::to_string(constant.number)
+        : "s:" + constant.string;
+    auto& index = state().constantIndex;
+    auto it = index.find(key);
+    if (it != index.end() && function().constants[it->second] == constant) {
+        return it->second;
+    }
+
+    auto& constants = function().constants;
+    if (constants.size() >= kMaxRegisters) {
+        unsupported("constant pool overflow", nullptr);
+    }
+    constants.push_back(constant);
+    uint16_t slot = static_cast<uint16_t>(constants.size() - 1);
+    index[key] = slot;
+    return slot;
+}
+
+uint16_t Compiler::addName(const std::string& name) {
+    auto& index = state().nameIndex;
+    auto it = index.find(name);
+    if (it != index.end()) {
+        return it->second;
+    }
+
+    auto& names = function().names;
+    if (names.size() >= kMaxRegisters) {
+        unsupported("name table overflow", nullptr);
+    }
+    names.push_back(name);
+    uint16_t slot = static_cast<uint16_t>(names.size() - 1);
+    index[name] = slot;
+    return slot;
+}
+
+uint16_t Compiler::allocateRegister() {
+    return allocateRegisters(1);
+}
+
+uint16_t Compiler::allocateRegisters(uint16_t count) {
+    FunctionState& current = state();
+    if (static_cast<size_t>(current.nextRegister) + count >= kMaxRegisters) {
+        unsupported("register file overflow", nullptr);
+    }
+    uint16_t first = current.nextRegister;
+    current.nextRegister = static_cast<uint16_t>(current.nextRegister + count);
+    current.maxRegister = std::max(current.maxRegister, current.nextRegister);
+    return first;
+}
+
+void Compiler::releaseRegisters(uint16_t mark) {
+    FunctionState& current = state();
+    if (mark < current.nextRegister) {
+        current.nextRegister = std::max(mark, current.firstTemporary);
+    }
+}
+
+void Compiler::emitPopHandlers(size_t targetDepth) {
+    for (size_t depth = state().handlerDepth; depth > targetDepth; --depth) {
+        emit(Opcode::PopHandler);
+    }
+}
+
+// Runs the finalizers of the tries an exit leaves, innermost first: an
+// exit to jumpScopes[n - 1] leaves the tries entered while n or more jump
+// scopes were open, so a return passes 0. Each try's handlers are popped
+// before its finalizer so a throw from the finalizer is not caught by its
+// own catch, and each finalizer compiles with only the enclosing ones
+// active so an exit inside it does not run it again. Handlers are then
+// popped down to targetDepth.
+void Compiler::emitFinalizers(size_t jumpScopeCount, size_t targetDepth) {
+    FunctionState& current = state();
+    size_t depth = current.handlerDepth;
+    std::vector<FinallyScope> scopes = current.finallyScopes;
+
+    while (!current.finallyScopes.empty() && current.finallyScopes.back().jumpScopeCount >= jumpScopeCount) {
+        FinallyScope scope = current.finallyScopes.back();
+        current.finallyScopes.pop_back();
+        emitPopHandlers(scope.handlerDepth);
+        current.handlerDepth = scope.handlerDepth;
+        compileStatement(scope.finalizer);
+    }
+    emitPopHandlers(targetDepth);
+
+    current.handlerDepth = depth;
+    current.finallyScopes = std::move(scopes);
+}
+
+Opcode Compiler::binaryOpcode(OperatorType op, const TokenPosition& position) const {
+    switch (op) {
+        case OperatorType::Add: return Opcode::Add;
+        case OperatorType::Subtract: return Opcode::Subtract;
+        case OperatorType::Multiply: return Opcode::Multiply;
+        case OperatorType::Divide: return Opcode::Divide;
+        case OperatorType::Modulo: return Opcode::Modulo;
+        case OperatorType::Exponent: return Opcode::Exponent;
+        case OperatorType::BitwiseAnd: return Opcode::BitwiseAnd;
+        case OperatorType::BitwiseOr: return Opcode::BitwiseOr;
+        case OperatorType::BitwiseXor: return Opcode::BitwiseXor;
+        case OperatorType::LeftShift: return Opcode::LeftShift;
+        case OperatorType::RightShift: return Opcode::RightShift;
+        case OperatorType::UnsignedRightShift: return Opcode::UnsignedRightShift;
+        case OperatorType::Equal: return Opcode::Equal;
+        case OperatorType::NotEqual: return Opcode::NotEqual;
+        case OperatorType::StrictEqual: return Opcode::StrictEqual;
+        case OperatorType::StrictNotEqual: return Opcode::StrictNotEqual;
+        case OperatorType::LessThan: return Opcode::LessThan;
+        case OperatorType::LessThanOrEqual: return Opcode::LessThanOrEqual;
+        case OperatorType::GreaterThan: return Opcode::GreaterThan;
+        case OperatorType::GreaterThanOrEqual: return Opcode::GreaterThanOrEqual;
+        default: break;
+    }
+    throw CompileError("Unsupported binary operator", position);
+}
+
+void Compiler::unsupported(const std::string& what, const Node* node) const {
+    throw CompileError("Bytecode compiler does not support " + what,
+                       node ? node->position() : currentPosition_);
+}
+
+} // namespace js
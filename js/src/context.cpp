@@ -1,4 +1,5 @@
 #include "js/context.h"
+#include "js/gc.h"
 
 namespace js {
 
@@ -30,4 +31,34 @@ void Context::clear() {
     variables.clear();
 }
 
+// Variable resolution
+
+JSValue Context::resolveVariable(const std::string& name) const {
+    return globalObject_ ? globalObject_->get(name) : JSValue::empty();
+}
+
+void Context::declareVariable(const std::string& name, JSValue value) {
+    if (!globalObject_) {
+        globalObject_ = std::make_unique<Object>();
+    }
+    globalObject_->put(name, value);
+}
+
+void Context::assignVariable(const std::string& name, JSValue value) {
+    // Sloppy-mode assignment to an undeclared name creates a global
+    declareVariable(name, value);
+}
+
+bool Context::hasVariable(const std::string& name) const {
+    return globalObject_ && globalObject_->has(name);
+}
+
+// Garbage collection
+
+void Context::traceRoots(GC& gc) const {
+    if (globalObject_) {
+        globalObject_->traceChildren(gc);
+    }
+}
+
 } // namespace js
@@ -0,0 +1,124 @@
+#include "js/coroutine.h"
+#include "js/gc.h"
+
+namespace js {
+
+// PromiseObject
+
+PromiseObject::PromiseObject()
+    : Object(), state_(State::Pending), result_(JSValue::undefined()), reactions_() {
+}
+
+std::vector<PromiseObject::Reaction> PromiseObject::settle(State state, JSValue result) {
+    if (state_ != State::Pending) {
+        return {};
+    }
+    writeBarrier(this, result);
+    state_ = state;
+    result_ = result;
+    return std::move(reactions_);
+}
+
+bool PromiseObject::addReaction(const Reaction& reaction) {
+    if (state_ != State::Pending) {
+        return false;
+    }
+    writeBarrier(this, reaction.onFulfilled);
+    writeBarrier(this, reaction.onRejected);
+    if (reaction.derived) {
+        writeBarrier(this, JSValue::object(reaction.derived));
+    }
+    if (reaction.coroutine) {
+        writeBarrier(this, JSValue::object(reaction.coroutine));
+    }
+    reactions_.push_back(reaction);
+    return true;
+}
+
+std::string PromiseObject::toString() const {
+    return "[object Promise]";
+}
+
+void PromiseObject::traceChildren(GC& gc) const {
+    Object::traceChildren(gc);
+    gc.markValue(result_);
+    for (const Reaction& reaction : reactions_) {
+        gc.markValue(reaction.onFulfilled);
+        gc.markValue(reaction.onRejected);
+        if (reaction.derived) {
+            gc.markCell(reaction.derived);
+        }
+        if (reaction.coroutine) {
+            gc.markCell(reaction.coroutine);
+        }
+    }
+}
+
+// Coroutine
+
+Coroutine::Coroutine(Kind kind, BytecodeClosure* closure, JSValue thisValue, PromiseObject* promise)
+    : Object(), kind_(kind), state_(kind == Kind::Generator ? State::SuspendedStart : State::Executing),
+      closure_(closure), thisValue_(thisValue), promise_(promise), registers_(), handlers_(), scope_(), pc_(0),
+      resumeRegister_(0) {
+}
+
+void Coroutine::setArguments(const JSValue* arguments, size_t count) {
+    registers_.assign(arguments, arguments + count);
+    for (JSValue value : registers_) {
+        writeBarrier(this, value);
+    }
+}
+
+void Coroutine::suspend(const JSValue* registers, size_t count, uint32_t pc, std::shared_ptr<ClosureScope> scope,
+                        std::vector<SavedHandler> handlers, uint16_t resumeRegister) {
+    registers_.assign(registers, registers + count);
+    for (JSValue value : registers_) {
+        writeBarrier(this, value);
+    }
+    handlers_ = std::move(handlers);
+    scope_ = std::move(scope);
+    pc_ = pc;
+    resumeRegister_ = resumeRegister;
+    state_ = State::Suspended;
+}
+
+void Coroutine::releaseFrame() {
+    // Keeps the capacity: a coroutine that suspended once usually suspends again
+    registers_.clear();
+    handlers_.clear();
+    scope_.reset();
+}
+
+std::string Coroutine::toString() const {
+    return kind_ == Kind::Generator ? "[object Generator]" : "[object AsyncFunction]";
+}
+
+void Coroutine::traceChildren(GC& gc) const {
+    Object::traceChildren(gc);
+    gc.markValue(thisValue_);
+    if (closure_) {
+        gc.markCell(closure_);
+    }
+    if (promise_) {
+        gc.markCell(promise_);
+    }
+    for (JSValue value : registers_) {
+        gc.markValue(value);
+    }
+    if (scope_) {
+        scope_->trace(gc);
+    }
+}
+
+// PromiseResolvingFunction
+
+PromiseResolvingFunction::PromiseResolvingFunction(std::string name, PromiseObject* promise, NativeCallback callback)
+    : NativeFunction(std::move(name), std::move(callback)), promise_(promise) {
+}
+
+void PromiseResolvingFunction::traceChildren(GC& gc) const {
+    NativeFunction::traceChildren(gc);
+    gc.markCell(promise_);
+}
+
+} // namespace js
@@ -23,14 +23,55 @@
 #include "js/module.h"
 #include "js/loader.h"
 #include "js/compiler.h"
+#include "js/vm.h"
 #include "js/optimizer.h"
 #include "js/debugger.h"
 #include "js/profiler.h"
-#include <iostream>
+#include "js/watchdog.h"
+#include "js/snapshot.h"
+#include "js/read_only_heap.h"
+#include "js/json.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
 
 namespace js {
 
+namespace {
+
+// Shared by every engine in the process
+std::mutex startupSnapshotMutex;
+std::shared_ptr<const HeapSnapshot> startupSnapshot;
+bool startupSnapshotEnabled = true;
+
+// Strings nearly every script interns: typeof results, the names of the
+// builtins and their members, and the most common property names
+const char* const kReadOnlyStrings[] = {
+    "", "undefined", "null", "boolean", "number", "string", "object", "function", "symbol", "bigint",
+    "true", "false", "NaN", "Infinity", "length", "name", "message", "stack", "prototype", "constructor",
+    "toString", "valueOf", "toJSON", "then", "catch", "finally", "value", "done", "next", "return",
+    "throw", "get", "set", "key", "keys", "values", "entries", "push", "pop", "shift", "unshift",
+    "slice", "splice", "concat", "join", "indexOf", "includes", "map", "filter", "forEach", "reduce",
+    "find", "some", "every", "sort", "reverse", "apply", "call", "bind", "id", "type", "data",
+    "index", "width", "height", "x", "y", "left", "top", "style", "className", "children",
+    "parentNode", "textContent", "innerHTML", "addEventListener", "removeEventListener",
+    "console", "log", "warn", "error", "info", "document", "window", "Math", "JSON", "parse",
+    "stringify", "Date", "now", "Promise", "resolve", "reject", "all", "race", "setTimeout",
+    "clearTimeout", "setInterval", "clearInterval", "queueMicrotask", "requestAnimationFrame",
+    "abs", "floor", "ceil", "round", "trunc", "sign", "sqrt", "cbrt", "pow", "exp", "log2", "log10",
+    "sin", "cos", "tan", "atan2", "min", "max", "random", "PI", "E",
+};
+
+std::once_flag readOnlyHeapOnce;
+std::shared_ptr<const ReadOnlyHeap> readOnlyHeap;
+
+} // namespace
+
 // JavaScript Engine implementation
 JavaScriptEngine::JavaScriptEngine() 
     : initialized_(false)
@@ -41,9 +82,15 @@ JavaScriptEngine::JavaScriptEngine()
     , optimizationEnabled_(false)
     , debuggingEnabled_(false)
     , gcEnabled_(true)
+    , bytecodeEnabled_(true)
     , executionCount_(0)
     , errorCount_(0)
+    , bytecodeFallbackCount_(0)
     , totalExecutionTime_(0.0)
+    , longTaskCount_(0)
+    , deadline_()
+    , deadlineGeneration_(0)
+    , deadlineTerminates_(false)
 {
     initialize();
 }
@@ -60,26 +107,49 @@ void JavaScriptEngine::initialize() {
     // Initialize core components
     interpreter_ = std::make_unique<Interpreter>();
     gc_ = std::make_unique<GC>();
+    gc_->setReadOnlyHeap(getReadOnlyHeap());
     domBindings_ = std::make_unique<DOMBindings>();
     console_ = std::make_unique<Console>();
     eventLoop_ = std::make_unique<EventLoop>();
+    eventLoop_->setErrorHandler([this](const std::exception& e) {
+        errorCount_++;
+        std::cerr << "JavaScript execution error: " << e.what() << std::endl;
+    });
     promise_ = std::make_unique<Promise>();
     async_ = std::make_unique<Async>();
     module_ = std::make_unique<Module>();
     loader_ = std::make_unique<Loader>();
     compiler_ = std::make_unique<Compiler>();
+    vm_ = std::make_unique<VM>(*gc_);
     optimizer_ = std::make_unique<Optimizer>();
     debugger_ = std::make_unique<Debugger>();
     profiler_ = std::make_unique<Profiler>();
+    vm_->setProfiler(profiler_.get());
+    vm_->setOptimizer(optimizer_.get());
+    vm_->setEventLoop(eventLoop_.get());
+    // Expiry only queues the interrupt; the VM's thread handles it
+    watchdog_ = std::make_unique<Watchdog>([this](uint64_t generation) {
+        vm_->requestInterrupt([this, generation](VM& vm) { return onExecutionDeadline(vm, generation); });
+    });
+    if (optimizationEnabled_) {
+        optimizer_->enableOptimization();
+    }
 
-    // Create global context
+    // Create global context; its bindings are GC roots
     globalContext_ = std::make_unique<Context>();
     globalContext_->initialize();
-
-    // Initialize built-in objects
-    initializeBuiltins();
-
+    gc_->addRoots([this](GC& gc) {
+        if (globalContext_) {
+            globalContext_->traceRoots(gc);
+        }
+        if (eventLoop_) {
+            eventLoop_->traceRoots(gc);
+        }
+    });
+
+    // Initialize built-in objects (they check initialized_)
     initialized_ = true;
+    initializeBuiltins();
 }
 
 void JavaScriptEngine::shutdown() {
@@ -87,8 +157,19 @@ void JavaScriptEngine::shutdown() {
         return;
     }
 
-    // Clear global context
+    // The watchdog thread goes first; its expiry reaches into the VM
+    watchdog_.reset();
+    deadlineGeneration_ = 0;
+
+    // Clear global context (bytecode closures in it still point at the VM),
+    // then the VM, whose registers point into the GC heap
     globalContext_.reset();
+    vm_.reset();
+
+    // Pending background compiles are dropped; running ones finish first
+    scriptQueue_.clear();
+    scriptCompiler_.reset();
+    evaluatedModules_.clear();
 
     // Clear core components
     interpreter_.reset();
@@ -116,13 +197,43 @@ std::unique_ptr<Value> JavaScriptEngine::execute(const std::string& source) {
     auto start = std::chrono::high_resolution_clock::now();
 
     try {
-        // Parse the source code
-        Parser parser(source);
-        auto ast = parser.parse();
-        
-        // Execute the AST
-        auto result = execute(std::move(ast));
+        std::unique_ptr<Value> result;
+        bool cached = false;
+        if (codeCache_ && bytecodeEnabled_ && vm_) {
+            if (auto function = codeCache_->load(source)) {
+                result = vm_->execute(std::move(function), globalContext_.get()).toValue();
+                cached = true;
+            }
+        }
+
+        if (!cached) {
+            // Parse the source code; the tree only lives until it is compiled
+            Parser parser(source);
+            parser.setArenaAllocation(true);
+            parser.setLazyFunctions(true);
+            auto ast = parser.parse();
+
+            std::shared_ptr<BytecodeFunction> function;
+            bool compiled = codeCache_ && ast;
+            if (compiled) {
+                function = compileBytecode(ast->root());
+            }
+            if (function) {
+                // Stored before running so lazy stubs are cached as stubs
+                auto compileEnd = std::chrono::high_resolution_clock::now();
+                codeCache_->store(source, *function, std::chrono::duration<double>(compileEnd - start).count());
+                result = vm_->execute(std::move(function), globalContext_.get()).toValue();
+            } else if (compiled) {
+                result = interpreter_->execute(std::move(ast), globalContext_.get());
+            } else {
+                // Execute the AST
+                result = execute(std::move(ast));
+            }
+        }
         
+        // The end of a script is a microtask checkpoint
+        eventLoop_->performMicrotaskCheckpoint();
+
         executionCount_++;
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
@@ -145,7 +256,12 @@ std::unique_ptr<Value> JavaScriptEngine::execute(std::unique_ptr<AST> ast) {
 
     try {
         // Execute the AST
-        auto result = interpreter_->execute(std::move(ast), globalContext_.get());
+        std::unique_ptr<Value> result;
+        if (auto function = compileBytecode(ast->root())) {
+            result = vm_->execute(std::move(function), globalContext_.get()).toValue();
+        } else {
+            result = interpreter_->execute(std::move(ast), globalContext_.get());
+        }
         
         executionCount_++;
         auto end = std::chrono::high_resolution_clock::now();
@@ -169,7 +285,12 @@ std::unique_ptr<Value> JavaScriptEngine::execute(std::unique_ptr<Program> progra
 
     try {
         // Execute the program
-        auto result = interpreter_->execute(std::move(program), globalContext_.get());
+        std::unique_ptr<Value> result;
+        if (auto function = compileBytecode(program.get())) {
+            result = vm_->execute(std::move(function), globalContext_.get()).toValue();
+        } else {
+            result = interpreter_->execute(std::move(program), globalContext_.get());
+        }
         
         executionCount_++;
         auto end = std::chrono::high_resolution_clock::now();
@@ -193,7 +314,12 @@ std::unique_ptr<Value> JavaScriptEngine::execute(std::unique_ptr<Module> module)
 
     try {
         // Execute the module
-        auto result = interpreter_->execute(std::move(module), globalContext_.get());
+        std::unique_ptr<Value> result;
+        if (auto function = compileBytecode(module.get())) {
+            result = vm_->execute(std::move(function), globalContext_.get()).toValue();
+        } else {
+            result = interpreter_->execute(std::move(module), globalContext_.get());
+        }
         
         executionCount_++;
         auto end = std::chrono::high_resolution_clock::now();
@@ -208,6 +334,89 @@ std::unique_ptr<Value> JavaScriptEngine::execute(std::unique_ptr<Module> module)
     }
 }
 
+std::future<CompiledScript> JavaScriptEngine::compileInBackground(const std::string& source) {
+    // A cached script is ready without a trip through the pool
+    if (initialized_ && codeCache_ && bytecodeEnabled_ && vm_) {
+        if (auto function = codeCache_->load(source)) {
+            CompiledScript script;
+            script.source = source;
+            script.function = std::move(function);
+            std::promise<CompiledScript> ready;
+            ready.set_value(std::move(script));
+            return ready.get_future();
+        }
+    }
+
+    if (!scriptCompiler_) {
+        scriptCompiler_ = std::make_unique<ScriptCompiler>();
+    }
+    return scriptCompiler_->compile(source, bytecodeEnabled_);
+}
+
+std::unique_ptr<Value> JavaScriptEngine::execute(CompiledScript script) {
+    if (!initialized_) {
+        return nullptr;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    try {
+        std::unique_ptr<Value> result;
+        if (script.bytecodeFallback) {
+            bytecodeFallbackCount_++;
+        }
+        if (script.function && vm_) {
+            // Stored before running so lazy stubs are cached as stubs
+            if (codeCache_ && script.compileTime > 0.0) {
+                codeCache_->store(script.source, *script.function, script.compileTime);
+            }
+            result = vm_->execute(std::move(script.function), globalContext_.get()).toValue();
+        } else if (script.ast) {
+            result = interpreter_->execute(std::move(script.ast), globalContext_.get());
+        }
+
+        // The end of a script is a microtask checkpoint
+        eventLoop_->performMicrotaskCheckpoint();
+
+        executionCount_++;
+        auto end = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        totalExecutionTime_ += duration.count() / 1000000.0;
+
+        return result;
+    } catch (const std::exception& e) {
+        errorCount_++;
+        std::cerr << "JavaScript execution error: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void JavaScriptEngine::queueScript(const std::string& source) {
+    scriptQueue_.push_back(compileInBackground(source));
+}
+
+size_t JavaScriptEngine::runQueuedScripts(bool wait) {
+    size_t count = 0;
+    while (!scriptQueue_.empty()) {
+        std::future<CompiledScript>& next = scriptQueue_.front();
+        if (!wait && next.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            break;
+        }
+
+        std::future<CompiledScript> ready = std::move(next);
+        scriptQueue_.pop_front();
+        try {
+            execute(ready.get());
+        } catch (const std::exception& e) {
+            // Parse failures surface when the result is collected
+            errorCount_++;
+            std::cerr << "JavaScript execution error: " << e.what() << std::endl;
+        }
+        count++;
+    }
+    return count;
+}
+
 std::unique_ptr<Context> JavaScriptEngine::createContext() {
     if (!initialized_) {
         return nullptr;
@@ -215,6 +424,12 @@ std::unique_ptr<Context> JavaScriptEngine::createContext() {
 
     auto context = std::make_unique<Context>();
     context->initialize();
+
+    // Contexts get the snapshotted builtins, bound to this engine
+    if (!context->getGlobalObject()) {
+        context->setGlobalObject(std::make_unique<Object>());
+    }
+    restoreStartupSnapshot(*context->getGlobalObject());
     return context;
 }
 
@@ -270,7 +485,19 @@ void JavaScriptEngine::initializeBuiltins() {
     initializeGlobalObject();
     initializeConsole();
     initializeDOM();
-    initializeMath();
+
+    // The heap builtins are built once per process and restored after that
+    Object* globalObject = globalContext_ ? globalContext_->getGlobalObject() : nullptr;
+    if (!globalObject || !restoreStartupSnapshot(*globalObject)) {
+        uint32_t firstSlot = globalObject ? globalObject->shape()->slotCount() : 0;
+        initializeMath();
+        initializeTypedArrays();
+        initializeTimers();
+        if (globalObject) {
+            captureStartupSnapshot(*globalObject, firstSlot);
+        }
+    }
+
     initializeDate();
     initializeJSON();
     initializePromise();
@@ -314,30 +541,178 @@ void JavaScriptEngine::initializeDOM() {
 }
 
 void JavaScriptEngine::initializeMath() {
-    if (!globalContext_) {
+    if (!globalContext_ || !gc_) {
         return;
     }
 
     auto globalObject = globalContext_->getGlobalObject();
     if (globalObject) {
-        auto mathObject = std::make_unique<Object>();
-        
+        Object* mathObject = gc_->allocate<Object>();
+
         // Math constants
-        mathObject->setProperty("PI", createNumber(3.141592653589793));
-        mathObject->setProperty("E", createNumber(2.718281828459045));
-        mathObject->setProperty("LN2", createNumber(0.6931471805599453));
-        mathObject->setProperty("LN10", createNumber(2.302585092994046));
-        mathObject->setProperty("LOG2E", createNumber(1.4426950408889634));
-        mathObject->setProperty("LOG10E", createNumber(0.4342944819032518));
-        mathObject->setProperty("SQRT1_2", createNumber(0.7071067811865476));
-        mathObject->setProperty("SQRT2", createNumber(1.4142135623730951));
-        
+        mathObject->put("PI", JSValue::number(3.141592653589793));
+        mathObject->put("E", JSValue::number(2.718281828459045));
+        mathObject->put("LN2", JSValue::number(0.6931471805599453));
+        mathObject->put("LN10", JSValue::number(2.302585092994046));
+        mathObject->put("LOG2E", JSValue::number(1.4426950408889634));
+        mathObject->put("LOG10E", JSValue::number(0.4342944819032518));
+        mathObject->put("SQRT1_2", JSValue::number(0.7071067811865476));
+        mathObject->put("SQRT2", JSValue::number(1.4142135623730951));
+
         // Math methods
-        // Note: In a real implementation, these would be proper function objects
-        // For now, we'll just set them as placeholder values
-        
-        globalObject->setProperty("Math", std::move(mathObject));
+        auto unary = [&](const char* name, double (*function)(double)) {
+            auto callback = [function](JSValue, const JSValue* arguments, size_t count) {
+                double x = count > 0 ? arguments[0].toNumber() : std::nan("");
+                return JSValue::number(function(x));
+            };
+            mathObject->put(name, JSValue::object(gc_->allocate<NativeFunction>(name, callback)));
+        };
+        unary("abs", [](double x) { return std::fabs(x); });
+        unary("floor", [](double x) { return std::floor(x); });
+        unary("ceil", [](double x) { return std::ceil(x); });
+        unary("round", [](double x) { return std::floor(x + 0.5); });
+        unary("trunc", [](double x) { return std::trunc(x); });
+        unary("sqrt", [](double x) { return std::sqrt(x); });
+        unary("sin", [](double x) { return std::sin(x); });
+        unary("cos", [](double x) { return std::cos(x); });
+        unary("tan", [](double x) { return std::tan(x); });
+        unary("log", [](double x) { return std::log(x); });
+        unary("exp", [](double x) { return std::exp(x); });
+
+        mathObject->put("pow", JSValue::object(gc_->allocate<NativeFunction>("pow",
+            [](JSValue, const JSValue* arguments, size_t count) {
+                double base = count > 0 ? arguments[0].toNumber() : std::nan("");
+                double exponent = count > 1 ? arguments[1].toNumber() : std::nan("");
+                return JSValue::number(std::pow(base, exponent));
+            })));
+        mathObject->put("min", JSValue::object(gc_->allocate<NativeFunction>("min",
+            [](JSValue, const JSValue* arguments, size_t count) {
+                double result = std::numeric_limits<double>::infinity();
+                for (size_t i = 0; i < count; ++i) {
+                    double x = arguments[i].toNumber();
+                    if (std::isnan(x)) {
+                        return JSValue::fromDouble(x);
+                    }
+                    result = std::min(result, x);
+                }
+                return JSValue::number(result);
+            })));
+        mathObject->put("max", JSValue::object(gc_->allocate<NativeFunction>("max",
+            [](JSValue, const JSValue* arguments, size_t count) {
+                double result = -std::numeric_limits<double>::infinity();
+                for (size_t i = 0; i < count; ++i) {
+                    double x = arguments[i].toNumber();
+                    if (std::isnan(x)) {
+                        return JSValue::fromDouble(x);
+                    }
+                    result = std::max(result, x);
+                }
+                return JSValue::number(result);
+            })));
+
+        globalObject->put("Math", JSValue::object(mathObject));
+    }
+}
+
+namespace {
+
+// ToIndex: a non-negative integer length or offset
+size_t toIndex(JSValue value, const char* what) {
+    if (value.isUndefined()) {
+        return 0;
+    }
+    double number = value.toNumber();
+    if (std::isnan(number)) {
+        return 0;
+    }
+    if (number < 0 || std::trunc(number) != number || number > static_cast<double>(std::numeric_limits<uint32_t>::max()) * 8) {
+        throw std::runtime_error(std::string("RangeError: Invalid ") + what);
+    }
+    return static_cast<size_t>(number);
+}
+
+// A native whose callback closes over engine state; the rebinder builds
+// it again for each engine restored from the startup snapshot
+void putBoundNative(Object& target, const char* name, const SnapshotBindings& bindings, NativeRebinder rebinder) {
+    auto* function = bindings.heap->allocate<NativeFunction>(name, rebinder(bindings));
+    function->setRebinder(std::move(rebinder));
+    target.put(name, JSValue::object(function));
+}
+
+} // namespace
+
+void JavaScriptEngine::initializeTypedArrays() {
+    if (!globalContext_ || !gc_) {
+        return;
     }
+
+    auto globalObject = globalContext_->getGlobalObject();
+    if (!globalObject) {
+        return;
+    }
+
+    SnapshotBindings bindings = snapshotBindings();
+    putBoundNative(*globalObject, "ArrayBuffer", bindings, [](const SnapshotBindings& engine) -> NativeCallback {
+        GC* heap = engine.heap;
+        return [heap](JSValue, const JSValue* arguments, size_t count) {
+            size_t byteLength = toIndex(count > 0 ? arguments[0] : JSValue::undefined(), "array buffer length");
+            return JSValue::object(heap->allocate<ArrayBuffer>(byteLength));
+        };
+    });
+
+    // new T(length), new T(array or typed array) copies, and
+    // new T(buffer, byteOffset, length) views existing memory
+    auto view = [&](TypedArrayKind kind) {
+        const char* name = TypedArray::className(kind);
+        putBoundNative(*globalObject, name, bindings, [kind](const SnapshotBindings& engine) -> NativeCallback {
+            GC* heap = engine.heap;
+            return [heap, kind](JSValue, const JSValue* arguments, size_t count) {
+                size_t elementSize = TypedArray::elementSize(kind);
+                JSValue source = count > 0 ? arguments[0] : JSValue::undefined();
+                Object* object = source.isObject() ? source.asObject() : nullptr;
+
+                if (auto* buffer = dynamic_cast<ArrayBuffer*>(object)) {
+                    size_t byteOffset = toIndex(count > 1 ? arguments[1] : JSValue::undefined(), "typed array offset");
+                    if (byteOffset % elementSize != 0 || byteOffset > buffer->byteLength()) {
+                        throw std::runtime_error("RangeError: Invalid typed array offset");
+                    }
+                    size_t length = 0;
+                    if (count > 2 && !arguments[2].isUndefined()) {
+                        length = toIndex(arguments[2], "typed array length");
+                    } else if ((buffer->byteLength() - byteOffset) % elementSize != 0) {
+                        throw std::runtime_error("RangeError: Invalid typed array length");
+                    } else {
+                        length = (buffer->byteLength() - byteOffset) / elementSize;
+                    }
+                    if (length > (buffer->byteLength() - byteOffset) / elementSize) {
+                        throw std::runtime_error("RangeError: Invalid typed array length");
+                    }
+                    return JSValue::object(heap->allocate<TypedArray>(kind, buffer, byteOffset, length));
+                }
+
+                size_t length = 0;
+                auto* array = object && object->type() == ValueType::Array ? static_cast<Array*>(object) : nullptr;
+                auto* typed = dynamic_cast<TypedArray*>(object);
+                if (array) {
+                    length = array->length();
+                } else if (typed) {
+                    length = typed->length();
+                } else {
+                    length = toIndex(source, "typed array length");
+                }
+
+                auto* storage = heap->allocate<ArrayBuffer>(length * elementSize);
+                auto* result = heap->allocate<TypedArray>(kind, storage, 0, length);
+                for (size_t i = 0; (array || typed) && i < length; ++i) {
+                    JSValue element = array ? array->at(i) : typed->at(i);
+                    result->put(i, element.isEmpty() ? JSValue::undefined() : element);
+                }
+                return JSValue::object(result);
+            };
+        });
+    };
+    view(TypedArrayKind::Uint8);
+    view(TypedArrayKind::Float64);
 }
 
 void JavaScriptEngine::initializeDate() {
@@ -357,19 +732,70 @@ void JavaScriptEngine::initializeDate() {
 }
 
 void JavaScriptEngine::initializeJSON() {
-    if (!globalContext_) {
+    if (!globalContext_ || !gc_) {
         return;
     }
 
     auto globalObject = globalContext_->getGlobalObject();
     if (globalObject) {
-        auto jsonObject = std::make_unique<Object>();
-        
-        // JSON methods
-        // Note: In a real implementation, these would be proper function objects
-        // For now, we'll just set them as placeholder values
-        
-        globalObject->setProperty("JSON", std::move(jsonObject));
+        GC* heap = gc_.get();
+        // Revivers, replacers and toJSON methods run on the VM
+        JSONCaller call;
+        if (VM* vm = vm_.get()) {
+            call = [vm](JSValue callee, JSValue thisValue, const JSValue* arguments, size_t count) {
+                return vm->callValue(callee, thisValue, arguments, count);
+            };
+        }
+
+        Object* jsonObject = gc_->allocate<Object>();
+        jsonObject->put("parse", JSValue::object(gc_->allocate<NativeFunction>("parse",
+            [heap, call](JSValue, const JSValue* arguments, size_t count) {
+                std::string text = count > 0 ? arguments[0].toString() : "undefined";
+                JSValue value = parseJSON(text, *heap);
+                return count > 1 ? reviveJSON(value, arguments[1], *heap, call) : value;
+            })));
+
+        jsonObject->put("stringify", JSValue::object(gc_->allocate<NativeFunction>("stringify",
+            [heap, call](JSValue, const JSValue* arguments, size_t count) {
+                JSONStringifyOptions options;
+                options.call = call;
+                if (count > 1 && arguments[1].isObject()) {
+                    Object* replacer = arguments[1].asObject();
+                    if (replacer->type() == ValueType::Function) {
+                        options.replacer = arguments[1];
+                    } else if (replacer->type() == ValueType::Array) {
+                        auto* names = static_cast<Array*>(replacer);
+                        options.hasPropertyList = true;
+                        for (size_t i = 0; i < names->length(); ++i) {
+                            JSValue name = names->at(i);
+                            if (!name.isString() && !name.isNumber()) {
+                                continue;
+                            }
+                            std::string key = name.toString();
+                            if (std::find(options.propertyList.begin(), options.propertyList.end(), key) ==
+                                options.propertyList.end()) {
+                                options.propertyList.push_back(std::move(key));
+                            }
+                        }
+                    }
+                }
+                if (count > 2 && arguments[2].isNumber()) {
+                    double spaces = std::min(10.0, std::floor(arguments[2].asNumber()));
+                    if (spaces >= 1) {
+                        options.indent.assign(static_cast<size_t>(spaces), ' ');
+                    }
+                } else if (count > 2 && arguments[2].isString()) {
+                    options.indent = arguments[2].asString()->value().substr(0, 10);
+                }
+
+                std::string text;
+                if (!stringifyJSON(count > 0 ? arguments[0] : JSValue::undefined(), *heap, options, text)) {
+                    return JSValue::undefined();
+                }
+                return heap->string(text);
+            })));
+
+        globalObject->put("JSON", JSValue::object(jsonObject));
     }
 }
 
@@ -379,7 +805,10 @@ void JavaScriptEngine::initializePromise() {
     }
 
     auto globalObject = globalContext_->getGlobalObject();
-    if (globalObject) {
+    if (globalObject && vm_) {
+        // await and the reaction jobs work on the VM's promises
+        globalObject->put("Promise", vm_->createPromiseConstructor());
+    } else if (globalObject) {
         auto promiseObject = promise_->createPromiseObject();
         globalObject->setProperty("Promise", std::move(promiseObject));
     }
@@ -397,6 +826,186 @@ void JavaScriptEngine::initializeAsync() {
     }
 }
 
+namespace {
+
+BytecodeClosure* asClosure(JSValue value) {
+    return value.isObject() ? dynamic_cast<BytecodeClosure*>(value.asObject()) : nullptr;
+}
+
+NativeFunction* asNativeFunction(JSValue value) {
+    return value.isObject() ? dynamic_cast<NativeFunction*>(value.asObject()) : nullptr;
+}
+
+// Calls a script or host function on behalf of the event loop
+void invokeCallback(VM& vm, JSValue callee, const std::vector<JSValue>& arguments) {
+    if (BytecodeClosure* closure = asClosure(callee)) {
+        vm.call(*closure, JSValue::undefined(), arguments.data(), arguments.size());
+    } else if (NativeFunction* native = asNativeFunction(callee)) {
+        native->invoke(JSValue::undefined(), arguments.data(), arguments.size());
+    } else {
+        throw std::runtime_error("TypeError: " + callee.toString() + " is not a function");
+    }
+}
+
+JSValue requireCallback(const JSValue* arguments, size_t count, const char* name) {
+    JSValue callback = count > 0 ? arguments[0] : JSValue::undefined();
+    if (!asClosure(callback) && !asNativeFunction(callback)) {
+        throw std::runtime_error(std::string("TypeError: ") + name + ": callback is not a function");
+    }
+    return callback;
+}
+
+// HTML timeouts: ToNumber, with NaN and negative delays treated as 0 and
+// the range capped at 2^31 - 1 ms
+std::chrono::milliseconds toTimerDelay(const JSValue* arguments, size_t count) {
+    double delay = count > 1 ? arguments[1].toNumber() : 0.0;
+    if (!(delay > 0)) {
+        return std::chrono::milliseconds(0);
+    }
+    return std::chrono::milliseconds(static_cast<int64_t>(std::min(delay, 2147483647.0)));
+}
+
+} // namespace
+
+// setTimeout / setInterval keep the callback and its extra arguments in
+// one array the loop retains until the timer is done
+void JavaScriptEngine::initializeTimers() {
+    if (!globalContext_ || !gc_ || !vm_ || !eventLoop_) {
+        return;
+    }
+
+    auto globalObject = globalContext_->getGlobalObject();
+    if (!globalObject) {
+        return;
+    }
+
+    SnapshotBindings bindings = snapshotBindings();
+
+    auto timer = [&](const char* name, bool repeat) {
+        putBoundNative(*globalObject, name, bindings, [name, repeat](const SnapshotBindings& engine) -> NativeCallback {
+            GC* heap = engine.heap;
+            VM* vm = engine.vm;
+            EventLoop* loop = engine.eventLoop;
+            return [heap, vm, loop, name, repeat](JSValue, const JSValue* arguments, size_t count) {
+                JSValue callback = requireCallback(arguments, count, name);
+                JSValue bound = heap->array();
+                auto* boundArray = static_cast<Array*>(bound.asObject());
+                boundArray->append(callback);
+                for (size_t i = 2; i < count; ++i) {
+                    boundArray->append(arguments[i]);
+                }
+
+                auto run = [vm, boundArray]() {
+                    std::vector<JSValue> callArguments;
+                    for (size_t i = 1; i < boundArray->length(); ++i) {
+                        callArguments.push_back(boundArray->at(i));
+                    }
+                    invokeCallback(*vm, boundArray->at(0), callArguments);
+                };
+                std::chrono::milliseconds delay = toTimerDelay(arguments, count);
+                EventLoop::TimerId id = repeat ? loop->setInterval(run, delay, bound) : loop->setTimeout(run, delay, bound);
+                return JSValue::number(static_cast<double>(id));
+            };
+        });
+    };
+    timer("setTimeout", false);
+    timer("setInterval", true);
+
+    auto clear = [&](const char* name) {
+        putBoundNative(*globalObject, name, bindings, [](const SnapshotBindings& engine) -> NativeCallback {
+            EventLoop* loop = engine.eventLoop;
+            return [loop](JSValue, const JSValue* arguments, size_t count) {
+                double id = count > 0 ? arguments[0].toNumber() : 0.0;
+                if (id >= 1 && id <= static_cast<double>(std::numeric_limits<EventLoop::TimerId>::max())) {
+                    loop->clearTimer(static_cast<EventLoop::TimerId>(id));
+                }
+                return JSValue::undefined();
+            };
+        });
+    };
+    clear("clearTimeout");
+    clear("clearInterval");
+
+    putBoundNative(*globalObject, "queueMicrotask", bindings, [](const SnapshotBindings& engine) -> NativeCallback {
+        VM* vm = engine.vm;
+        EventLoop* loop = engine.eventLoop;
+        return [vm, loop](JSValue, const JSValue* arguments, size_t count) {
+            JSValue callback = requireCallback(arguments, count, "queueMicrotask");
+            loop->enqueueMicrotask([vm, callback]() { invokeCallback(*vm, callback, {}); }, callback);
+            return JSValue::undefined();
+        };
+    });
+}
+
+bool JavaScriptEngine::runEventLoopTurn(std::chrono::steady_clock::time_point deadline) {
+    if (!initialized_) {
+        return false;
+    }
+    return eventLoop_->runOneTurn(deadline);
+}
+
+void JavaScriptEngine::runEventLoop() {
+    if (!initialized_) {
+        return;
+    }
+    eventLoop_->run();
+}
+
+void JavaScriptEngine::requestInterrupt(std::function<bool()> callback) {
+    if (!initialized_ || !callback) {
+        return;
+    }
+    vm_->requestInterrupt([callback = std::move(callback)](VM&) { return callback(); });
+}
+
+void JavaScriptEngine::terminateExecution() {
+    if (!initialized_) {
+        return;
+    }
+    vm_->terminateExecution();
+}
+
+void JavaScriptEngine::setExecutionDeadline(std::chrono::steady_clock::time_point deadline, bool terminate) {
+    if (!initialized_) {
+        return;
+    }
+    deadline_ = deadline;
+    deadlineTerminates_ = terminate;
+    deadlineGeneration_ = watchdog_->arm(deadline);
+}
+
+void JavaScriptEngine::clearExecutionDeadline() {
+    if (!initialized_) {
+        return;
+    }
+    watchdog_->disarm();
+    deadlineGeneration_ = 0;
+}
+
+void JavaScriptEngine::setLongTaskHandler(std::function<void(const LongTask&)> handler) {
+    longTaskHandler_ = std::move(handler);
+}
+
+// An expiry that raced a cleared or moved deadline finds another generation
+bool JavaScriptEngine::onExecutionDeadline(VM& vm, uint64_t generation) {
+    if (generation == 0 || generation != deadlineGeneration_) {
+        return true;
+    }
+
+    VM::Location location = vm.currentLocation();
+    LongTask task;
+    task.deadline = deadline_;
+    task.overrun = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - deadline_);
+    task.function = std::move(location.function);
+    task.position = location.position;
+    task.terminated = deadlineTerminates_;
+    longTaskCount_++;
+    if (longTaskHandler_) {
+        longTaskHandler_(task);
+    }
+    return !task.terminated;
+}
+
 std::unique_ptr<Module> JavaScriptEngine::loadModule(const std::string& specifier) {
     if (!initialized_) {
         return nullptr;
@@ -421,6 +1030,48 @@ void JavaScriptEngine::registerModule(const std::string& specifier, std::unique_
     loader_->registerModule(specifier, std::move(module));
 }
 
+std::unique_ptr<Value> JavaScriptEngine::importModule(const std::string& specifier, const std::string& referrer) {
+    if (!initialized_) {
+        return nullptr;
+    }
+
+    if (!scriptCompiler_) {
+        scriptCompiler_ = std::make_unique<ScriptCompiler>();
+    }
+    std::string error;
+    auto graph = loader_->load(specifier, referrer, *scriptCompiler_, bytecodeEnabled_ && vm_, error);
+    if (graph.empty()) {
+        errorCount_++;
+        std::cerr << "JavaScript module error: " << error << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<Value> result;
+    for (const auto& record : graph) {
+        if (!evaluatedModules_.insert(record->url).second) {
+            continue;
+        }
+        CompiledScript script;
+        script.source = record->source;
+        script.function = record->function;
+        if (!script.function) {
+            // The AST interpreter consumes its tree, so each run parses anew
+            Parser parser(record->source);
+            parser.setModuleMode(true);
+            script.ast = parser.parse();
+        }
+        result = execute(std::move(script));
+    }
+    return result;
+}
+
+void JavaScriptEngine::navigate(const std::string& url) {
+    evaluatedModules_.clear();
+    if (loader_) {
+        loader_->navigate(url);
+    }
+}
+
 void JavaScriptEngine::setErrorHandler(std::function<void(const Exception&)> handler) {
     if (globalContext_) {
         globalContext_->setErrorHandler(handler);
@@ -467,6 +1118,22 @@ void JavaScriptEngine::disableOptimization() {
     }
 }
 
+void JavaScriptEngine::enableBytecode() {
+    bytecodeEnabled_ = true;
+}
+
+void JavaScriptEngine::disableBytecode() {
+    bytecodeEnabled_ = false;
+}
+
+void JavaScriptEngine::enableCodeCache(const std::string& directory, size_t maxBytes) {
+    codeCache_ = std::make_unique<CodeCache>(directory, maxBytes);
+}
+
+void JavaScriptEngine::disableCodeCache() {
+    codeCache_.reset();
+}
+
 void JavaScriptEngine::enableDebugging() {
     debuggingEnabled_ = true;
     if (debugger_) {
@@ -501,6 +1168,23 @@ void JavaScriptEngine::runGC() {
     }
 }
 
+void JavaScriptEngine::onMemoryPressure(bool critical) {
+    if (critical && loader_) {
+        loader_->purge();
+    }
+    if (!gc_) {
+        return;
+    }
+    runGC();
+    if (critical) {
+        gc_->releaseFreeBlocks();
+    }
+}
+
+size_t JavaScriptEngine::getModuleRecordSize() const {
+    return loader_ ? loader_->memoryUsage() : 0;
+}
+
 size_t JavaScriptEngine::getHeapSize() const {
     if (gc_) {
         return gc_->getHeapSize();
@@ -538,4 +1222,100 @@ double JavaScriptEngine::getTotalExecutionTime() const {
     return totalExecutionTime_;
 }
 
+double JavaScriptEngine::getCodeCacheHitRate() const {
+    return codeCache_ ? codeCache_->getHitRate() : 0.0;
+}
+
+double JavaScriptEngine::getCodeCacheSavedTime() const {
+    return codeCache_ ? codeCache_->getSavedTime() : 0.0;
+}
+
+uint64_t JavaScriptEngine::getInlineCacheHitCount() const {
+    return vm_ ? vm_->getInlineCacheHitCount() : 0;
+}
+
+uint64_t JavaScriptEngine::getInlineCacheMissCount() const {
+    return vm_ ? vm_->getInlineCacheMissCount() : 0;
+}
+
+std::shared_ptr<const ReadOnlyHeap> JavaScriptEngine::getReadOnlyHeap() {
+    std::call_once(readOnlyHeapOnce, [] {
+        readOnlyHeap = ReadOnlyHeap::create(std::vector<std::string>(std::begin(kReadOnlyStrings),
+                                                                     std::end(kReadOnlyStrings)));
+    });
+    return readOnlyHeap;
+}
+
+std::shared_ptr<const HeapSnapshot> JavaScriptEngine::getStartupSnapshot() {
+    std::lock_guard<std::mutex> lock(startupSnapshotMutex);
+    return startupSnapshot;
+}
+
+void JavaScriptEngine::setStartupSnapshotEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(startupSnapshotMutex);
+    startupSnapshotEnabled = enabled;
+    if (!enabled) {
+        startupSnapshot.reset();
+    }
+}
+
+SnapshotBindings JavaScriptEngine::snapshotBindings() const {
+    return SnapshotBindings{gc_.get(), vm_.get(), eventLoop_.get()};
+}
+
+bool JavaScriptEngine::restoreStartupSnapshot(Object& globalObject) {
+    if (!gc_ || !vm_ || !eventLoop_) {
+        return false;
+    }
+    std::shared_ptr<const HeapSnapshot> snapshot = getStartupSnapshot();
+    if (!snapshot) {
+        return false;
+    }
+    snapshot->restore(globalObject, snapshotBindings());
+    return true;
+}
+
+// Keeps the first image; engines initializing at the same time may each
+// capture one, and they are equivalent
+void JavaScriptEngine::captureStartupSnapshot(const Object& globalObject, uint32_t firstSlot) {
+    if (!gc_ || !vm_ || !eventLoop_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(startupSnapshotMutex);
+        if (!startupSnapshotEnabled || startupSnapshot) {
+            return;
+        }
+    }
+    std::shared_ptr<const HeapSnapshot> snapshot = HeapSnapshot::capture(globalObject, firstSlot);
+    std::lock_guard<std::mutex> lock(startupSnapshotMutex);
+    if (startupSnapshotEnabled && !startupSnapshot) {
+        startupSnapshot = std::move(snapshot);
+    }
+}
+
+// Compiles a Program/Module root for the VM. Returns nullptr when the
+// bytecode tier is disabled or the script uses constructs it does not
+// support yet, in which case the caller runs the AST interpreter instead.
+std::shared_ptr<BytecodeFunction> JavaScriptEngine::compileBytecode(Node* root) {
+    if (!bytecodeEnabled_ || !compiler_ || !vm_ || !root) {
+        return nullptr;
+    }
+    if (optimizer_) {
+        optimizer_->optimizeTree(root);
+    }
+
+    try {
+        if (auto* program = dynamic_cast<Program*>(root)) {
+            return compiler_->compile(program);
+        }
+        if (auto* module = dynamic_cast<Module*>(root)) {
+            return compiler_->compile(module);
+        }
+    } catch (const CompileError&) {
+        bytecodeFallbackCount_++;
+    }
+    return nullptr;
+}
+
 } // namespace js
@@ -0,0 +1,393 @@
+#include "js/event_loop.h"
+#include "js/gc.h"
+#include <algorithm>
+#include <thread>
+
+namespace js {
+
+namespace {
+
+constexpr uint64_t kWheelMask = EventLoop::kWheelSize - 1;
+
+// Ticks covered by one slot at each level
+constexpr uint64_t levelSpan(size_t level) {
+    return uint64_t{1} << (EventLoop::kWheelBits * level);
+}
+
+constexpr uint64_t kWheelHorizon = levelSpan(EventLoop::kWheelLevels);
+
+} // namespace
+
+EventLoop::EventLoop()
+    : origin_(Clock::now()), currentTick_(0), tasks_(), microtasks_(), microtaskHead_(0), timers_(),
+      freeTimers_(), timerIndex_(), slots_(), levelCounts_(), dueTimers_(), batch_(), nextTimerId_(1),
+      nextSequence_(0), currentNesting_(0), running_(), performingMicrotasks_(false), errorHandler_(),
+      stopRequested_(false), executedTasks_(0), executedMicrotasks_(0), firedTimers_(0), errors_(0) {
+    slots_.fill(kNone);
+    levelCounts_.fill(0);
+}
+
+EventLoop::~EventLoop() = default;
+
+// Tasks
+
+void EventLoop::postTask(Callback callback, JSValue retained) {
+    tasks_.push_back(Task{std::move(callback), retained});
+}
+
+void EventLoop::enqueueMicrotask(Callback callback, JSValue retained) {
+    microtasks_.push_back(Task{std::move(callback), retained});
+}
+
+// A microtask that performs a checkpoint itself (a nested script run) does
+// not drain the queue from underneath the outer checkpoint
+void EventLoop::performMicrotaskCheckpoint() {
+    if (performingMicrotasks_) {
+        return;
+    }
+    performingMicrotasks_ = true;
+    while (microtaskHead_ < microtasks_.size()) {
+        Task task = std::move(microtasks_[microtaskHead_++]);
+        runTask(task.callback, task.retained);
+        ++executedMicrotasks_;
+    }
+    microtasks_.clear();
+    microtaskHead_ = 0;
+    performingMicrotasks_ = false;
+}
+
+void EventLoop::runTask(const Callback& callback, JSValue retained) {
+    running_.push_back(retained);
+    try {
+        callback();
+    } catch (const std::exception& e) {
+        ++errors_;
+        if (errorHandler_) {
+            errorHandler_(e);
+        }
+    }
+    running_.pop_back();
+}
+
+// Timers
+
+EventLoop::TimerId EventLoop::setTimeout(Callback callback, std::chrono::milliseconds delay, JSValue retained) {
+    return addTimer(std::move(callback), delay, false, retained);
+}
+
+EventLoop::TimerId EventLoop::setInterval(Callback callback, std::chrono::milliseconds interval, JSValue retained) {
+    return addTimer(std::move(callback), interval, true, retained);
+}
+
+bool EventLoop::clearTimer(TimerId id) {
+    auto it = timerIndex_.find(id);
+    if (it == timerIndex_.end()) {
+        return false;
+    }
+    uint32_t index = it->second;
+    unlink(index);
+    releaseTimer(index);
+    return true;
+}
+
+uint64_t EventLoop::tickFor(Clock::time_point time) const {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(time - origin_).count();
+    return elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+}
+
+EventLoop::TimerId EventLoop::addTimer(Callback callback, std::chrono::milliseconds delay, bool repeat,
+                                       JSValue retained) {
+    uint32_t nesting = currentNesting_ + 1;
+    if (delay.count() < 0) {
+        delay = std::chrono::milliseconds(0);
+    }
+    if (nesting > kMaxNestingLevel && delay < kMinNestedDelay) {
+        delay = kMinNestedDelay;
+    }
+
+    uint32_t index;
+    if (!freeTimers_.empty()) {
+        index = freeTimers_.back();
+        freeTimers_.pop_back();
+    } else {
+        index = static_cast<uint32_t>(timers_.size());
+        timers_.emplace_back();
+    }
+
+    uint64_t ticks = static_cast<uint64_t>(delay.count());
+    Timer& timer = timers_[index];
+    timer.id = nextTimerId_++;
+    timer.callback = std::move(callback);
+    timer.retained = retained;
+    timer.expiry = tickFor(Clock::now()) + ticks;
+    timer.interval = repeat ? std::max<uint64_t>(ticks, 1) : 0;
+    timer.sequence = nextSequence_++;
+    timer.nesting = nesting;
+    timer.slot = kNone;
+    timerIndex_.emplace(timer.id, index);
+    schedule(index);
+    return timer.id;
+}
+
+// Level L holds timers due within kWheelSize^(L+1) ticks, in the slot
+// their expiry selects at that level's resolution. Timers beyond the top
+// level wait in its farthest slot and are placed again when it comes up.
+void EventLoop::schedule(uint32_t index) {
+    Timer& timer = timers_[index];
+    timer.expiry = std::max(timer.expiry, currentTick_);
+    uint64_t delta = timer.expiry - currentTick_;
+    uint64_t position = delta < kWheelHorizon ? timer.expiry : currentTick_ + kWheelHorizon - 1;
+
+    size_t level = 0;
+    while (level + 1 < kWheelLevels && delta >= levelSpan(level + 1)) {
+        ++level;
+    }
+    uint32_t slot = static_cast<uint32_t>(level * kWheelSize + ((position >> (kWheelBits * level)) & kWheelMask));
+
+    timer.slot = slot;
+    timer.prev = kNone;
+    timer.next = slots_[slot];
+    if (timer.next != kNone) {
+        timers_[timer.next].prev = index;
+    }
+    slots_[slot] = index;
+    ++levelCounts_[level];
+}
+
+void EventLoop::unlink(uint32_t index) {
+    Timer& timer = timers_[index];
+    if (timer.slot == kNone) {
+        return;
+    }
+    if (timer.prev != kNone) {
+        timers_[timer.prev].next = timer.next;
+    } else {
+        slots_[timer.slot] = timer.next;
+    }
+    if (timer.next != kNone) {
+        timers_[timer.next].prev = timer.prev;
+    }
+    --levelCounts_[timer.slot / kWheelSize];
+    timer.slot = kNone;
+}
+
+void EventLoop::releaseTimer(uint32_t index) {
+    Timer& timer = timers_[index];
+    timerIndex_.erase(timer.id);
+    timer.callback = nullptr;
+    timer.retained = JSValue::undefined();
+    freeTimers_.push_back(index);
+}
+
+void EventLoop::cascade(size_t level, size_t index) {
+    uint32_t slot = static_cast<uint32_t>(level * kWheelSize + index);
+    uint32_t current = slots_[slot];
+    slots_[slot] = kNone;
+    while (current != kNone) {
+        uint32_t next = timers_[current].next;
+        timers_[current].slot = kNone;
+        --levelCounts_[level];
+        schedule(current);
+        current = next;
+    }
+}
+
+void EventLoop::advanceTo(uint64_t tick) {
+    while (currentTick_ <= tick) {
+        // Skip straight to the next slot boundary of the lowest level that
+        // holds timers; idle stretches cost nothing per tick
+        size_t lowest = 0;
+        while (lowest < kWheelLevels && levelCounts_[lowest] == 0) {
+            ++lowest;
+        }
+        if (lowest == kWheelLevels) {
+            currentTick_ = tick + 1;
+            break;
+        }
+        if (lowest > 0) {
+            uint64_t span = levelSpan(lowest);
+            uint64_t boundary = (currentTick_ + span - 1) / span * span;
+            if (boundary > tick) {
+                currentTick_ = tick + 1;
+                break;
+            }
+            currentTick_ = boundary;
+        }
+
+        // Higher levels cascade first so their timers can land in the
+        // lower slots handled right after
+        uint64_t now = currentTick_;
+        if ((now & kWheelMask) == 0) {
+            size_t top = 1;
+            while (top + 1 < kWheelLevels && ((now >> (kWheelBits * top)) & kWheelMask) == 0) {
+                ++top;
+            }
+            for (size_t level = top; level >= 1; --level) {
+                cascade(level, (now >> (kWheelBits * level)) & kWheelMask);
+            }
+        }
+
+        uint32_t& head = slots_[now & kWheelMask];
+        for (uint32_t current = head; current != kNone; current = timers_[current].next) {
+            timers_[current].slot = kNone;
+            --levelCounts_[0];
+            batch_.push_back(current);
+        }
+        head = kNone;
+        ++currentTick_;
+    }
+
+    if (batch_.empty()) {
+        return;
+    }
+    std::sort(batch_.begin(), batch_.end(), [this](uint32_t lhs, uint32_t rhs) {
+        const Timer& a = timers_[lhs];
+        const Timer& b = timers_[rhs];
+        return a.expiry != b.expiry ? a.expiry < b.expiry : a.sequence < b.sequence;
+    });
+    for (uint32_t index : batch_) {
+        dueTimers_.push_back(timers_[index].id);
+    }
+    batch_.clear();
+}
+
+// Callbacks may add timers and so reallocate the pool; nothing refers to
+// the entry across the call
+void EventLoop::fireTimer(TimerId id) {
+    auto it = timerIndex_.find(id);
+    if (it == timerIndex_.end()) {
+        return;
+    }
+    uint32_t index = it->second;
+    Timer& timer = timers_[index];
+    uint32_t nesting = timer.nesting;
+    bool repeat = timer.interval != 0;
+    JSValue retained = timer.retained;
+    Callback callback = repeat ? timer.callback : std::move(timer.callback);
+    if (!repeat) {
+        releaseTimer(index);
+    }
+
+    ++firedTimers_;
+    uint32_t outerNesting = currentNesting_;
+    currentNesting_ = nesting;
+    runTask(callback, retained);
+    currentNesting_ = outerNesting;
+
+    // Repeats count as nesting too, so a zero interval settles at 4 ms
+    it = timerIndex_.find(id);
+    if (!repeat || it == timerIndex_.end()) {
+        return;
+    }
+    Timer& again = timers_[it->second];
+    again.nesting = nesting + 1;
+    if (again.nesting > kMaxNestingLevel) {
+        again.interval = std::max<uint64_t>(again.interval, static_cast<uint64_t>(kMinNestedDelay.count()));
+    }
+    again.expiry = tickFor(Clock::now()) + again.interval;
+    again.sequence = nextSequence_++;
+    schedule(it->second);
+}
+
+// Running
+
+bool EventLoop::runOneTurn(Clock::time_point deadline) {
+    performMicrotaskCheckpoint();
+    advanceTo(tickFor(Clock::now()));
+
+    // Work queued by this turn's tasks waits for the next turn
+    size_t timerBudget = dueTimers_.size();
+    size_t taskBudget = tasks_.size();
+    bool ranTask = false;
+    while ((timerBudget > 0 || taskBudget > 0) && !stopRequested_) {
+        if (ranTask && Clock::now() >= deadline) {
+            break;
+        }
+        ranTask = true;
+        if (timerBudget > 0) {
+            --timerBudget;
+            TimerId id = dueTimers_.front();
+            dueTimers_.pop_front();
+            fireTimer(id);
+        } else {
+            --taskBudget;
+            Task task = std::move(tasks_.front());
+            tasks_.pop_front();
+            runTask(task.callback, task.retained);
+        }
+        ++executedTasks_;
+        performMicrotaskCheckpoint();
+    }
+    return hasDueWork();
+}
+
+void EventLoop::run() {
+    stopRequested_ = false;
+    while (!stopRequested_ && hasPendingWork()) {
+        if (runOneTurn(Clock::time_point::max()) || stopRequested_) {
+            continue;
+        }
+        Clock::time_point next = getNextTimerTime();
+        if (next == Clock::time_point::max()) {
+            break;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+bool EventLoop::hasPendingWork() const {
+    return !tasks_.empty() || !dueTimers_.empty() || getPendingMicrotaskCount() > 0 || !timerIndex_.empty();
+}
+
+bool EventLoop::hasDueWork() const {
+    return !tasks_.empty() || !dueTimers_.empty() || getPendingMicrotaskCount() > 0 ||
+           getNextTimerTime() <= Clock::now();
+}
+
+// The first occupied slot of each level, in wheel order from the next
+// slot to be processed, holds that level's earliest timers
+EventLoop::Clock::time_point EventLoop::getNextTimerTime() const {
+    uint64_t earliest = UINT64_MAX;
+    for (size_t level = 0; level < kWheelLevels; ++level) {
+        if (levelCounts_[level] == 0) {
+            continue;
+        }
+        uint64_t start = (currentTick_ + levelSpan(level) - 1) >> (kWheelBits * level);
+        for (size_t step = 0; step < kWheelSize; ++step) {
+            uint32_t current = slots_[level * kWheelSize + ((start + step) & kWheelMask)];
+            if (current == kNone) {
+                continue;
+            }
+            for (; current != kNone; current = timers_[current].next) {
+                earliest = std::min(earliest, timers_[current].expiry);
+            }
+            break;
+        }
+    }
+    if (!dueTimers_.empty()) {
+        earliest = std::min(earliest, currentTick_);
+    }
+    if (earliest == UINT64_MAX) {
+        return Clock::time_point::max();
+    }
+    return origin_ + std::chrono::milliseconds(static_cast<int64_t>(earliest));
+}
+
+// Garbage collection
+
+void EventLoop::traceRoots(GC& gc) const {
+    for (const Task& task : tasks_) {
+        gc.markValue(task.retained);
+    }
+    for (size_t i = microtaskHead_; i < microtasks_.size(); ++i) {
+        gc.markValue(microtasks_[i].retained);
+    }
+    for (const auto& entry : timerIndex_) {
+        gc.markValue(timers_[entry.second].retained);
+    }
+    for (JSValue value : running_) {
+        gc.markValue(value);
+    }
+}
+
+} // namespace js
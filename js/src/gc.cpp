@@ -0,0 +1,444 @@
+#include "js/gc.h"
+#include "js/read_only_heap.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace js {
+
+// Block header placed at the start of every kBlockSize-aligned region, so
+// the owning block of any cell is found by masking its address.
+struct HeapBlock {
+    struct Cell {
+        Value* value;
+        size_t size;
+    };
+
+    GC* heap;
+    char* begin;
+    char* cursor;
+    char* limit;
+    size_t capacity;
+    size_t liveBytes;
+    bool large;
+    std::vector<Cell> cells;
+
+    static HeapBlock* of(const void* address) {
+        return reinterpret_cast<HeapBlock*>(reinterpret_cast<uintptr_t>(address) & ~(GC::kBlockSize - 1));
+    }
+
+    bool fits(size_t size) const { return static_cast<size_t>(limit - cursor) >= size; }
+
+    void reset() {
+        cursor = begin;
+        liveBytes = 0;
+        cells.clear();
+    }
+};
+
+namespace {
+
+constexpr size_t kBlockHeaderSize = (sizeof(HeapBlock) + 15) & ~static_cast<size_t>(15);
+
+void destroyCell(const HeapBlock::Cell& cell) {
+    cell.value->~Value();
+}
+
+} // namespace
+
+void rememberCell(Value* owner) {
+    HeapBlock::of(owner)->heap->remember(owner);
+}
+
+GC::GC()
+    : nursery_(), oldBlocks_(), freeBlocks_(), currentNursery_(0), remembered_(), pinned_(), adopted_(),
+      markStack_(), roots_(), interned_(), readOnlyHeap_(), nextRootId_(1), enabled_(true), collectionRequested_(false),
+      collecting_(false), majorInProgress_(false), epoch_(0), heapSize_(0), heapUsed_(0), oldBytes_(0),
+      majorThreshold_(kMinMajorThreshold), cellCount_(0), minorCollections_(0), majorCollections_(0) {
+}
+
+GC::~GC() {
+    for (auto* blocks : {&nursery_, &oldBlocks_}) {
+        for (HeapBlock* block : *blocks) {
+            std::for_each(block->cells.begin(), block->cells.end(), destroyCell);
+            block->~HeapBlock();
+            std::free(block);
+        }
+    }
+    for (HeapBlock* block : freeBlocks_) {
+        block->~HeapBlock();
+        std::free(block);
+    }
+}
+
+// Allocation
+
+Value* GC::adopt(std::unique_ptr<Value> value) {
+    Value* raw = value.get();
+    if (raw) {
+        raw->setGCFlags(GCFlagManaged | GCFlagPinned);
+        adopted_.push_back(std::move(value));
+    }
+    return raw;
+}
+
+void GC::pin(Value* cell) {
+    if (!(cell->gcFlags() & GCFlagPinned)) {
+        cell->setGCFlags(cell->gcFlags() | GCFlagPinned);
+        pinned_.push_back(cell);
+    }
+}
+
+JSValue GC::string(const std::string& value) {
+    return JSValue::string(allocate<String>(value));
+}
+
+void GC::setReadOnlyHeap(std::shared_ptr<const ReadOnlyHeap> readOnly) {
+    readOnlyHeap_ = std::move(readOnly);
+}
+
+JSValue GC::internedString(const std::string& value) {
+    if (readOnlyHeap_) {
+        JSValue shared = readOnlyHeap_->findString(value);
+        if (!shared.isEmpty()) {
+            return shared;
+        }
+    }
+    auto it = interned_.find(value);
+    if (it != interned_.end()) {
+        return it->second;
+    }
+    String* cell = allocate<String>(value);
+    pin(cell);
+    JSValue result = JSValue::string(cell);
+    interned_.emplace(value, result);
+    return result;
+}
+
+JSValue GC::concat(String* left, String* right) {
+    if (left->length() == 0) {
+        return JSValue::string(right);
+    }
+    if (right->length() == 0) {
+        return JSValue::string(left);
+    }
+    size_t length = left->length() + right->length();
+    if (length >= String::kMinRopeLength) {
+        return JSValue::string(allocate<String>(left, right));
+    }
+
+    std::u16string units;
+    units.reserve(length);
+    for (size_t i = 0; i < left->length(); ++i) {
+        units.push_back(left->codeUnitAt(i));
+    }
+    for (size_t i = 0; i < right->length(); ++i) {
+        units.push_back(right->codeUnitAt(i));
+    }
+    return JSValue::string(allocate<String>(std::move(units)));
+}
+
+JSValue GC::substring(String* value, size_t start, size_t end) {
+    end = std::min(end, value->length());
+    start = std::min(start, end);
+    if (start == 0 && end == value->length()) {
+        return JSValue::string(value);
+    }
+    if (end - start >= String::kMinSliceLength) {
+        return JSValue::string(allocate<String>(value, start, end - start));
+    }
+
+    std::u16string units;
+    units.reserve(end - start);
+    for (size_t i = start; i < end; ++i) {
+        units.push_back(value->codeUnitAt(i));
+    }
+    return JSValue::string(allocate<String>(std::move(units)));
+}
+
+JSValue GC::object() {
+    return JSValue::object(allocate<Object>());
+}
+
+JSValue GC::array() {
+    return JSValue::object(allocate<Array>());
+}
+
+void* GC::allocateRaw(size_t size) {
+    if (size > kLargeObjectSize) {
+        HeapBlock* block = acquireBlock(size);
+        nursery_.push_back(block);
+        void* memory = block->cursor;
+        block->cursor += size;
+        return memory;
+    }
+
+    for (; currentNursery_ < nursery_.size(); ++currentNursery_) {
+        HeapBlock* block = nursery_[currentNursery_];
+        if (!block->large && block->fits(size)) {
+            void* memory = block->cursor;
+            block->cursor += size;
+            return memory;
+        }
+    }
+
+    // Nursery exhausted: ask for a minor collection at the next safepoint
+    // and keep allocating into overflow blocks until then
+    if (nursery_.size() >= kNurseryBlocks) {
+        collectionRequested_ = true;
+    }
+    HeapBlock* block = acquireBlock(size);
+    currentNursery_ = nursery_.size();
+    nursery_.push_back(block);
+    void* memory = block->cursor;
+    block->cursor += size;
+    return memory;
+}
+
+void GC::registerCell(Value* cell, void* memory, size_t size) {
+    HeapBlock::of(memory)->cells.push_back(HeapBlock::Cell{cell, size});
+    cell->setGCFlags(GCFlagManaged);
+    heapUsed_ += size;
+    ++cellCount_;
+}
+
+HeapBlock* GC::acquireBlock(size_t size) {
+    if (size <= kLargeObjectSize && !freeBlocks_.empty()) {
+        HeapBlock* block = freeBlocks_.back();
+        freeBlocks_.pop_back();
+        block->reset();
+        return block;
+    }
+
+    size_t capacity = std::max(kBlockSize, (kBlockHeaderSize + size + kBlockSize - 1) & ~(kBlockSize - 1));
+    void* memory = std::aligned_alloc(kBlockSize, capacity);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+
+    HeapBlock* block = new (memory) HeapBlock();
+    block->heap = this;
+    block->begin = static_cast<char*>(memory) + kBlockHeaderSize;
+    block->cursor = block->begin;
+    block->limit = static_cast<char*>(memory) + capacity;
+    block->capacity = capacity;
+    block->liveBytes = 0;
+    block->large = size > kLargeObjectSize;
+    heapSize_ += capacity;
+    return block;
+}
+
+void GC::releaseBlock(HeapBlock* block) {
+    if (!block->large && freeBlocks_.size() < kNurseryBlocks) {
+        block->reset();
+        freeBlocks_.push_back(block);
+        return;
+    }
+    heapSize_ -= block->capacity;
+    block->~HeapBlock();
+    std::free(block);
+}
+
+// Roots
+
+size_t GC::addRoots(RootTracer tracer) {
+    size_t id = nextRootId_++;
+    roots_.emplace_back(id, std::move(tracer));
+    return id;
+}
+
+void GC::removeRoots(size_t id) {
+    roots_.erase(std::remove_if(roots_.begin(), roots_.end(),
+                                [id](const std::pair<size_t, RootTracer>& root) { return root.first == id; }),
+                 roots_.end());
+}
+
+// Tracing
+
+void GC::markCell(Value* cell) {
+    uint8_t flags = cell->gcFlags();
+    // Unmanaged cells, read-only ones included, are left untouched
+    if (!(flags & GCFlagManaged) || (flags & GCFlagMarked)) {
+        return;
+    }
+    // Minor collections stop at the old generation
+    if (!majorInProgress_ && (flags & GCFlagOld)) {
+        return;
+    }
+    cell->setGCFlags(flags | GCFlagMarked);
+    markStack_.push_back(cell);
+}
+
+void GC::remember(Value* owner) {
+    owner->setGCFlags(owner->gcFlags() | GCFlagRemembered);
+    remembered_.push_back(owner);
+}
+
+void GC::traceRoots() {
+    for (auto& root : roots_) {
+        root.second(*this);
+    }
+    for (Value* cell : pinned_) {
+        markCell(cell);
+    }
+    for (const auto& cell : adopted_) {
+        markCell(cell.get());
+    }
+    if (!majorInProgress_) {
+        for (Value* owner : remembered_) {
+            owner->traceChildren(*this);
+        }
+    }
+}
+
+void GC::drainMarkStack() {
+    while (!markStack_.empty()) {
+        Value* cell = markStack_.back();
+        markStack_.pop_back();
+        cell->traceChildren(*this);
+    }
+}
+
+// Collection
+
+void GC::collectIfNeeded() {
+    if (collectionRequested_ && enabled_ && !collecting_) {
+        collectMinor();
+    }
+}
+
+void GC::collectMinor() {
+    collect(false);
+    if (oldBytes_ > majorThreshold_) {
+        collect(true);
+    }
+}
+
+void GC::collectMajor() {
+    collect(true);
+}
+
+void GC::runGC() {
+    if (enabled_ && !collecting_) {
+        collectMajor();
+    }
+}
+
+void GC::releaseFreeBlocks() {
+    for (HeapBlock* block : freeBlocks_) {
+        heapSize_ -= block->capacity;
+        block->~HeapBlock();
+        std::free(block);
+    }
+    freeBlocks_.clear();
+}
+
+void GC::collect(bool major) {
+    collecting_ = true;
+    majorInProgress_ = major;
+    ++epoch_;
+
+    traceRoots();
+    drainMarkStack();
+
+    // Every survivor is old afterwards, so the remembered set starts empty
+    for (Value* owner : remembered_) {
+        owner->setGCFlags(owner->gcFlags() & ~GCFlagRemembered);
+    }
+    remembered_.clear();
+    for (const auto& cell : adopted_) {
+        cell->setGCFlags(cell->gcFlags() & ~GCFlagMarked);
+    }
+
+    // Old blocks first: the nursery sweep appends freshly promoted blocks
+    if (major) {
+        sweep(oldBlocks_, false);
+    }
+    sweep(nursery_, true);
+
+    oldBytes_ = 0;
+    for (HeapBlock* block : oldBlocks_) {
+        oldBytes_ += block->liveBytes;
+    }
+    if (major) {
+        majorThreshold_ = std::max(kMinMajorThreshold, oldBytes_ * 2);
+        ++majorCollections_;
+    } else {
+        ++minorCollections_;
+    }
+
+    currentNursery_ = 0;
+    collectionRequested_ = false;
+    majorInProgress_ = false;
+    collecting_ = false;
+}
+
+// Survivors of a nursery sweep are promoted in place: the block moves to
+// the old generation and a fresh block takes its nursery slot.
+void GC::sweep(std::vector<HeapBlock*>& blocks, bool promote) {
+    std::vector<HeapBlock*> kept;
+    kept.reserve(blocks.size());
+
+    for (HeapBlock* block : blocks) {
+        size_t live = 0;
+        auto survivor = block->cells.begin();
+        for (const HeapBlock::Cell& cell : block->cells) {
+            uint8_t flags = cell.value->gcFlags();
+            if (flags & (GCFlagMarked | GCFlagPinned)) {
+                cell.value->setGCFlags((flags & ~GCFlagMarked) | GCFlagOld);
+                *survivor++ = cell;
+                live += cell.size;
+            } else {
+                destroyCell(cell);
+                heapUsed_ -= cell.size;
+                --cellCount_;
+            }
+        }
+        block->cells.erase(survivor, block->cells.end());
+        block->liveBytes = live;
+
+        if (live == 0) {
+            if (promote && !block->large && kept.size() < kNurseryBlocks) {
+                block->reset();
+                kept.push_back(block);
+            } else {
+                releaseBlock(block);
+            }
+        } else if (promote) {
+            oldBlocks_.push_back(block);
+        } else {
+            kept.push_back(block);
+        }
+    }
+    blocks.swap(kept);
+}
+
+// Value tracing
+
+void Object::traceChildren(GC& gc) const {
+    for (JSValue value : slots_) {
+        gc.markValue(value);
+    }
+}
+
+// Numeric kinds hold no cell pointers, so large numeric arrays cost the
+// collector nothing beyond the array itself
+void Array::traceChildren(GC& gc) const {
+    Object::traceChildren(gc);
+    switch (kind_) {
+        case ElementsKind::PackedInt32:
+        case ElementsKind::PackedDouble:
+            break;
+        case ElementsKind::Dictionary:
+            for (const auto& entry : dictionary_) {
+                gc.markValue(entry.second);
+            }
+            break;
+        default:
+            for (JSValue value : elements_) {
+                gc.markValue(value);
+            }
+            break;
+    }
+}
+
+} // namespace js
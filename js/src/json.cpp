@@ -0,0 +1,874 @@
+#include "js/json.h"
+#include "js/gc.h"
+#include "js/shape.h"
+#include "js/value.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace js {
+
+namespace {
+
+// Objects with at most this many members are checked for duplicate keys
+// pairwise rather than through a set
+constexpr size_t kLinearKeyCheckLimit = 8;
+
+bool isJSONWhitespace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isDigit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Bytes that end a run of plain string content. With surrogates, 0xED too:
+// it leads the three-byte form of U+D000 to U+DFFF, which includes the lone
+// surrogates stringify must escape.
+bool isSpecialByte(unsigned char c, bool surrogates) {
+    return c == '"' || c == '\\' || c < 0x20 || (surrogates && c == 0xED);
+}
+
+// Sets bit i for each byte of a 64-byte block that isSpecialByte()
+uint64_t specialBytes(const unsigned char* bytes, bool surrogates) {
+#if defined(__AVX2__)
+    // Without surrogates the last compare repeats the quote one
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    const __m256i lead = _mm256_set1_epi8(surrogates ? static_cast<char>(0xED) : '"');
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + offset));
+        // max(v, 0x1F) is 0x1F exactly for the control bytes
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control), _mm256_cmpeq_epi8(v, lead)));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(special))) << offset;
+    }
+    return mask;
+#elif defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    const __m128i lead = _mm_set1_epi8(surrogates ? static_cast<char>(0xED) : '"');
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + offset));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, control), control), _mm_cmpeq_epi8(v, lead)));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(special))) << offset;
+    }
+    return mask;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    // NEON has no movemask; weight each lane by its bit and add the halves
+    const uint8x16_t weights = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    auto toMask = [&weights](uint8x16_t lanes) {
+        uint8x16_t bits = vandq_u8(lanes, weights);
+        return static_cast<uint64_t>(vaddv_u8(vget_low_u8(bits))) |
+               (static_cast<uint64_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+    };
+    const uint8x16_t lead = vdupq_n_u8(surrogates ? 0xED : '"');
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        uint8x16_t v = vld1q_u8(bytes + offset);
+        uint8x16_t special = vorrq_u8(
+            vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))),
+            vorrq_u8(vcltq_u8(v, vdupq_n_u8(0x20)), vceqq_u8(v, lead)));
+        mask |= toMask(special) << offset;
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        mask |= static_cast<uint64_t>(isSpecialByte(bytes[i], surrogates)) << i;
+    }
+    return mask;
+#endif
+}
+
+// Length of the run of plain content at the start of bytes[0, size)
+size_t plainRun(const unsigned char* bytes, size_t size, bool surrogates) {
+    size_t offset = 0;
+    for (; offset + 64 <= size; offset += 64) {
+        uint64_t mask = specialBytes(bytes + offset, surrogates);
+        if (mask) {
+            return offset + static_cast<size_t>(__builtin_ctzll(mask));
+        }
+    }
+    while (offset < size && !isSpecialByte(bytes[offset], surrogates)) {
+        ++offset;
+    }
+    return offset;
+}
+
+void appendUTF8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        // Lone surrogates too, as WTF-8
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+bool isCallable(JSValue value) {
+    return value.isObject() && value.asObject()->type() == ValueType::Function;
+}
+
+bool isArray(JSValue value) {
+    return value.isObject() && value.asObject()->type() == ValueType::Array;
+}
+
+// Keeps values alive across calls into script, which may collect
+class TemporaryRoots {
+public:
+    explicit TemporaryRoots(GC& heap)
+        : heap_(heap)
+        , values_()
+        , id_(heap.addRoots([this](GC& gc) {
+            for (JSValue value : values_) {
+                gc.markValue(value);
+            }
+        })) {
+    }
+    ~TemporaryRoots() { heap_.removeRoots(id_); }
+
+    TemporaryRoots(const TemporaryRoots&) = delete;
+    TemporaryRoots& operator=(const TemporaryRoots&) = delete;
+
+    void push(JSValue value) { values_.push_back(value); }
+    void pop() { values_.pop_back(); }
+
+private:
+    GC& heap_;
+    std::vector<JSValue> values_;
+    size_t id_;
+};
+
+// Parsing
+//
+// Nothing here reaches a safepoint, so the values collected for the open
+// objects and arrays need no rooting.
+class JSONParser {
+public:
+    JSONParser(std::string_view text, GC& heap)
+        : begin_(reinterpret_cast<const unsigned char*>(text.data()))
+        , cursor_(begin_)
+        , end_(begin_ + text.size())
+        , heap_(heap)
+        , text_()
+        , keys_()
+        , values_() {
+    }
+
+    JSValue parse() {
+        JSValue value = parseValue(0);
+        skipWhitespace();
+        if (cursor_ != end_) {
+            fail();
+        }
+        return value;
+    }
+
+private:
+    const unsigned char* begin_;
+    const unsigned char* cursor_;
+    const unsigned char* end_;
+    GC& heap_;
+    // Decoded contents of the last string with escapes
+    std::string text_;
+    // Members of the open objects and arrays, innermost last
+    std::vector<std::string> keys_;
+    std::vector<JSValue> values_;
+
+    [[noreturn]] void fail() const {
+        if (cursor_ >= end_) {
+            throw std::runtime_error("SyntaxError: Unexpected end of JSON input");
+        }
+        throw std::runtime_error("SyntaxError: Unexpected token '" + std::string(1, static_cast<char>(*cursor_)) +
+                                 "' in JSON at position " + std::to_string(cursor_ - begin_));
+    }
+
+    void skipWhitespace() {
+        while (cursor_ < end_ && isJSONWhitespace(*cursor_)) {
+            ++cursor_;
+        }
+    }
+
+    void expect(unsigned char c) {
+        if (cursor_ >= end_ || *cursor_ != c) {
+            fail();
+        }
+        ++cursor_;
+    }
+
+    void expectWord(const char* word) {
+        size_t length = std::strlen(word);
+        for (size_t i = 0; i < length; ++i, ++cursor_) {
+            if (cursor_ >= end_ || *cursor_ != static_cast<unsigned char>(word[i])) {
+                fail();
+            }
+        }
+    }
+
+    JSValue parseValue(size_t depth) {
+        skipWhitespace();
+        if (cursor_ >= end_) {
+            fail();
+        }
+        switch (*cursor_) {
+            case '{':
+                return parseObject(depth);
+            case '[':
+                return parseArray(depth);
+            case '"': {
+                std::string_view text = parseString();
+                return heap_.string(std::string(text));
+            }
+            case 't':
+                expectWord("true");
+                return JSValue::boolean(true);
+            case 'f':
+                expectWord("false");
+                return JSValue::boolean(false);
+            case 'n':
+                expectWord("null");
+                return JSValue::null();
+            default:
+                return parseNumber();
+        }
+    }
+
+    void enter(size_t depth) {
+        if (depth >= kMaxJSONDepth) {
+            throw std::runtime_error("SyntaxError: JSON nested too deeply at position " +
+                                     std::to_string(cursor_ - begin_));
+        }
+        ++cursor_;
+    }
+
+    JSValue parseObject(size_t depth) {
+        enter(depth);
+        size_t keyBase = keys_.size();
+        size_t valueBase = values_.size();
+        skipWhitespace();
+        if (cursor_ < end_ && *cursor_ == '}') {
+            ++cursor_;
+            return JSValue::object(heap_.allocate<Object>());
+        }
+        for (;;) {
+            skipWhitespace();
+            if (cursor_ >= end_ || *cursor_ != '"') {
+                fail();
+            }
+            keys_.emplace_back(parseString());
+            skipWhitespace();
+            expect(':');
+            values_.push_back(parseValue(depth + 1));
+            skipWhitespace();
+            if (cursor_ < end_ && *cursor_ == ',') {
+                ++cursor_;
+                continue;
+            }
+            expect('}');
+            break;
+        }
+
+        Object* object = heap_.allocate<Object>();
+        buildObject(object, keyBase, valueBase);
+        keys_.resize(keyBase);
+        values_.resize(valueBase);
+        return JSValue::object(object);
+    }
+
+    bool hasDuplicateKeys(size_t keyBase) const {
+        size_t count = keys_.size() - keyBase;
+        if (count <= kLinearKeyCheckLimit) {
+            for (size_t i = keyBase + 1; i < keys_.size(); ++i) {
+                for (size_t j = keyBase; j < i; ++j) {
+                    if (keys_[i] == keys_[j]) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+        std::unordered_set<std::string_view> seen;
+        seen.reserve(count);
+        for (size_t i = keyBase; i < keys_.size(); ++i) {
+            if (!seen.insert(keys_[i]).second) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void buildObject(Object* object, size_t keyBase, size_t valueBase) {
+        Shape* shape = Shape::root();
+        if (!hasDuplicateKeys(keyBase)) {
+            for (size_t i = keyBase; i < keys_.size(); ++i) {
+                shape = shape->addProperty(keys_[i]);
+            }
+            object->setLayout(shape, std::vector<JSValue>(values_.begin() + valueBase, values_.end()));
+            return;
+        }
+
+        // A repeated key keeps its first position and its last value
+        std::unordered_map<std::string_view, uint32_t> slotOf;
+        std::vector<JSValue> slots;
+        for (size_t i = keyBase; i < keys_.size(); ++i) {
+            JSValue value = values_[valueBase + (i - keyBase)];
+            auto inserted = slotOf.emplace(keys_[i], static_cast<uint32_t>(slots.size()));
+            if (!inserted.second) {
+                slots[inserted.first->second] = value;
+                continue;
+            }
+            shape = shape->addProperty(keys_[i]);
+            slots.push_back(value);
+        }
+        object->setLayout(shape, std::move(slots));
+    }
+
+    JSValue parseArray(size_t depth) {
+        enter(depth);
+        size_t valueBase = values_.size();
+        skipWhitespace();
+        if (cursor_ < end_ && *cursor_ == ']') {
+            ++cursor_;
+            return JSValue::object(heap_.allocate<Array>());
+        }
+        for (;;) {
+            values_.push_back(parseValue(depth + 1));
+            skipWhitespace();
+            if (cursor_ < end_ && *cursor_ == ',') {
+                ++cursor_;
+                continue;
+            }
+            expect(']');
+            break;
+        }
+
+        Array* array = heap_.allocate<Array>();
+        array->assign(std::vector<JSValue>(values_.begin() + valueBase, values_.end()));
+        values_.resize(valueBase);
+        return JSValue::object(array);
+    }
+
+    // From the opening quote to past the closing one. Strings without
+    // escapes are returned in place; others are decoded into text_.
+    std::string_view parseString() {
+        ++cursor_;
+        const unsigned char* start = cursor_;
+        cursor_ += plainRun(cursor_, end_ - cursor_, false);
+        if (cursor_ < end_ && *cursor_ == '"') {
+            ++cursor_;
+            return std::string_view(reinterpret_cast<const char*>(start), cursor_ - 1 - start);
+        }
+
+        text_.assign(reinterpret_cast<const char*>(start), cursor_ - start);
+        for (;;) {
+            if (cursor_ >= end_) {
+                fail();
+            }
+            unsigned char c = *cursor_;
+            if (c == '"') {
+                ++cursor_;
+                return text_;
+            }
+            if (c != '\\') {
+                // Unescaped control byte
+                fail();
+            }
+            ++cursor_;
+            parseEscape();
+            size_t run = plainRun(cursor_, end_ - cursor_, false);
+            text_.append(reinterpret_cast<const char*>(cursor_), run);
+            cursor_ += run;
+        }
+    }
+
+    void parseEscape() {
+        if (cursor_ >= end_) {
+            fail();
+        }
+        switch (*cursor_) {
+            case '"': text_ += '"'; break;
+            case '\\': text_ += '\\'; break;
+            case '/': text_ += '/'; break;
+            case 'b': text_ += '\b'; break;
+            case 'f': text_ += '\f'; break;
+            case 'n': text_ += '\n'; break;
+            case 'r': text_ += '\r'; break;
+            case 't': text_ += '\t'; break;
+            case 'u': {
+                ++cursor_;
+                uint32_t unit = parseHex4();
+                // A high surrogate escape followed by a low one is one code point
+                if (unit >= 0xD800 && unit <= 0xDBFF && end_ - cursor_ >= 6 && cursor_[0] == '\\' &&
+                    cursor_[1] == 'u') {
+                    const unsigned char* save = cursor_;
+                    cursor_ += 2;
+                    uint32_t low = parseHex4();
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        appendUTF8(text_, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                        return;
+                    }
+                    cursor_ = save;
+                }
+                appendUTF8(text_, unit);
+                return;
+            }
+            default:
+                fail();
+        }
+        ++cursor_;
+    }
+
+    uint32_t parseHex4() {
+        uint32_t unit = 0;
+        for (int i = 0; i < 4; ++i, ++cursor_) {
+            if (cursor_ >= end_) {
+                fail();
+            }
+            unsigned char c = *cursor_;
+            uint32_t digit;
+            if (isDigit(c)) {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                fail();
+            }
+            unit = (unit << 4) | digit;
+        }
+        return unit;
+    }
+
+    JSValue parseNumber() {
+        const unsigned char* start = cursor_;
+        bool negative = cursor_ < end_ && *cursor_ == '-';
+        if (negative) {
+            ++cursor_;
+        }
+        if (cursor_ >= end_ || !isDigit(*cursor_)) {
+            fail();
+        }
+        if (*cursor_ == '0') {
+            ++cursor_;
+        } else {
+            while (cursor_ < end_ && isDigit(*cursor_)) {
+                ++cursor_;
+            }
+        }
+        const unsigned char* integerEnd = cursor_;
+
+        bool integral = true;
+        if (cursor_ < end_ && *cursor_ == '.') {
+            integral = false;
+            ++cursor_;
+            if (cursor_ >= end_ || !isDigit(*cursor_)) {
+                fail();
+            }
+            while (cursor_ < end_ && isDigit(*cursor_)) {
+                ++cursor_;
+            }
+        }
+        if (cursor_ < end_ && (*cursor_ == 'e' || *cursor_ == 'E')) {
+            integral = false;
+            ++cursor_;
+            if (cursor_ < end_ && (*cursor_ == '+' || *cursor_ == '-')) {
+                ++cursor_;
+            }
+            if (cursor_ >= end_ || !isDigit(*cursor_)) {
+                fail();
+            }
+            while (cursor_ < end_ && isDigit(*cursor_)) {
+                ++cursor_;
+            }
+        }
+
+        // Up to 15 digits are exact in a double
+        const unsigned char* digits = start + (negative ? 1 : 0);
+        if (integral && integerEnd - digits <= 15) {
+            int64_t value = 0;
+            for (const unsigned char* p = digits; p < integerEnd; ++p) {
+                value = value * 10 + (*p - '0');
+            }
+            double number = static_cast<double>(value);
+            return JSValue::number(negative ? -number : number);
+        }
+
+        // strtod needs a terminator the input may not have
+        char buffer[64];
+        size_t length = cursor_ - start;
+        if (length < sizeof(buffer)) {
+            std::memcpy(buffer, start, length);
+            buffer[length] = '\0';
+            return JSValue::number(std::strtod(buffer, nullptr));
+        }
+        std::string text(reinterpret_cast<const char*>(start), length);
+        return JSValue::number(std::strtod(text.c_str(), nullptr));
+    }
+};
+
+// Reviving
+class JSONReviver {
+public:
+    JSONReviver(JSValue reviver, GC& heap, const JSONCaller& call)
+        : reviver_(reviver)
+        , heap_(heap)
+        , call_(call) {
+    }
+
+    // holder's member name, after its own members
+    JSValue revive(Object* holder, const std::string& name, size_t depth) {
+        return finish(holder, name, holder->get(name), depth);
+    }
+
+private:
+    JSValue reviver_;
+    GC& heap_;
+    const JSONCaller& call_;
+
+    JSValue finish(Object* holder, const std::string& name, JSValue value, size_t depth) {
+        walk(value, depth);
+        JSValue arguments[2] = {heap_.string(name), value};
+        return call_(reviver_, JSValue::object(holder), arguments, 2);
+    }
+
+    void walk(JSValue value, size_t depth) {
+        if (!value.isObject() || isCallable(value)) {
+            return;
+        }
+        if (depth >= kMaxJSONDepth) {
+            throw std::runtime_error("RangeError: Maximum call stack size exceeded");
+        }
+
+        if (isArray(value)) {
+            Array* array = static_cast<Array*>(value.asObject());
+            for (size_t i = 0; i < array->length(); ++i) {
+                JSValue element = array->at(i);
+                JSValue revived =
+                    finish(array, std::to_string(i), element.isEmpty() ? JSValue::undefined() : element, depth + 1);
+                array->put(i, revived.isUndefined() ? JSValue::empty() : revived);
+            }
+            return;
+        }
+
+        Object* object = value.asObject();
+        for (const std::string& name : object->shape()->keys()) {
+            JSValue member = object->get(name);
+            if (member.isEmpty()) {
+                // Deleted by the reviver of an earlier member
+                continue;
+            }
+            JSValue revived = finish(object, name, member, depth + 1);
+            if (revived.isUndefined()) {
+                object->remove(name);
+            } else {
+                object->put(name, revived);
+            }
+        }
+    }
+};
+
+// Stringifying
+class JSONWriter {
+public:
+    JSONWriter(GC& heap, const JSONStringifyOptions& options, std::string& out)
+        : heap_(heap)
+        , options_(options)
+        , out_(out)
+        , calls_(static_cast<bool>(options.call))
+        , stack_()
+        , keys_()
+        , roots_(heap) {
+    }
+
+    bool write(JSValue value) {
+        Object* wrapper = nullptr;
+        if (calls_ && isCallable(options_.replacer)) {
+            // The replacer sees the value as the member "" of an object
+            wrapper = heap_.allocate<Object>();
+            wrapper->put("", value);
+            roots_.push(JSValue::object(wrapper));
+        }
+        std::string name;
+        return writeMember(wrapper ? JSValue::object(wrapper) : JSValue::undefined(), &name, 0, value, 0);
+    }
+
+private:
+    GC& heap_;
+    const JSONStringifyOptions& options_;
+    std::string& out_;
+    // Whether toJSON and replacer functions are called
+    bool calls_;
+    // Objects being written, for cycle detection
+    std::vector<Object*> stack_;
+    // Keys of each shape written so far; records of one layout share them
+    std::unordered_map<const Shape*, std::vector<std::string>> keys_;
+    TemporaryRoots roots_;
+
+    // The key of a member: name, or index when name is nullptr
+    JSValue keyValue(const std::string* name, size_t index) {
+        return heap_.string(name ? *name : std::to_string(index));
+    }
+
+    JSValue prepare(JSValue holder, const std::string* name, size_t index, JSValue value) {
+        if (value.isObject()) {
+            JSValue toJSON = value.asObject()->get("toJSON");
+            if (isCallable(toJSON)) {
+                JSValue key = keyValue(name, index);
+                value = options_.call(toJSON, value, &key, 1);
+            }
+        }
+        if (isCallable(options_.replacer)) {
+            roots_.push(value);
+            JSValue arguments[2] = {keyValue(name, index), value};
+            value = options_.call(options_.replacer, holder, arguments, 2);
+            roots_.pop();
+        }
+        return value;
+    }
+
+    // False, writing nothing, for values without a JSON form
+    bool writeMember(JSValue holder, const std::string* name, size_t index, JSValue value, size_t depth) {
+        if (calls_) {
+            value = prepare(holder, name, index, value);
+            roots_.push(value);
+        }
+        bool written = writeValue(value, depth);
+        if (calls_) {
+            roots_.pop();
+        }
+        return written;
+    }
+
+    bool writeValue(JSValue value, size_t depth) {
+        if (value.isInt32()) {
+            char buffer[16];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value.asInt32());
+            out_.append(buffer, result.ptr);
+            return true;
+        }
+        if (value.isNumber()) {
+            double number = value.asNumber();
+            out_ += std::isfinite(number) ? numberToString(number) : "null";
+            return true;
+        }
+        if (value.isString()) {
+            writeString(value.asString()->value());
+            return true;
+        }
+        if (value.isBoolean()) {
+            out_ += value.asBoolean() ? "true" : "false";
+            return true;
+        }
+        if (value.isNull()) {
+            out_ += "null";
+            return true;
+        }
+        if (!value.isObject() || isCallable(value)) {
+            return false;
+        }
+
+        Object* object = value.asObject();
+        if (std::find(stack_.begin(), stack_.end(), object) != stack_.end()) {
+            throw std::runtime_error("TypeError: Converting circular structure to JSON");
+        }
+        if (depth >= kMaxJSONDepth) {
+            throw std::runtime_error("RangeError: Maximum call stack size exceeded");
+        }
+        stack_.push_back(object);
+        if (object->type() == ValueType::Array) {
+            writeArray(static_cast<Array*>(object), depth);
+        } else {
+            writeObject(object, depth);
+        }
+        stack_.pop_back();
+        return true;
+    }
+
+    void newline(size_t depth) {
+        if (options_.indent.empty()) {
+            return;
+        }
+        out_ += '\n';
+        for (size_t i = 0; i < depth; ++i) {
+            out_ += options_.indent;
+        }
+    }
+
+    void writeArray(Array* array, size_t depth) {
+        out_ += '[';
+        size_t length = array->length();
+        for (size_t i = 0; i < length; ++i) {
+            if (i > 0) {
+                out_ += ',';
+            }
+            newline(depth + 1);
+            JSValue element = array->at(i);
+            if (!writeMember(JSValue::object(array), nullptr, i, element.isEmpty() ? JSValue::undefined() : element,
+                             depth + 1)) {
+                out_ += "null";
+            }
+        }
+        if (length > 0) {
+            newline(depth);
+        }
+        out_ += ']';
+    }
+
+    void writeObject(Object* object, size_t depth) {
+        out_ += '{';
+        bool empty = true;
+        auto member = [&](const std::string& name, JSValue value) {
+            size_t mark = out_.size();
+            if (!empty) {
+                out_ += ',';
+            }
+            newline(depth + 1);
+            writeString(name);
+            out_ += ':';
+            if (!options_.indent.empty()) {
+                out_ += ' ';
+            }
+            if (writeMember(JSValue::object(object), &name, 0, value, depth + 1)) {
+                empty = false;
+            } else {
+                out_.resize(mark);
+            }
+        };
+
+        if (options_.hasPropertyList) {
+            for (const std::string& name : options_.propertyList) {
+                JSValue value = object->get(name);
+                if (!value.isEmpty()) {
+                    member(name, value);
+                }
+            }
+        } else {
+            Shape* shape = object->shape();
+            auto cached = keys_.find(shape);
+            if (cached == keys_.end()) {
+                cached = keys_.emplace(shape, shape->keys()).first;
+            }
+            const std::vector<std::string>& names = cached->second;
+            for (size_t slot = 0; slot < names.size(); ++slot) {
+                // Script called while writing may have changed the object
+                JSValue value = calls_ ? object->get(names[slot]) : object->slotAt(static_cast<uint32_t>(slot));
+                if (!value.isEmpty()) {
+                    member(names[slot], value);
+                }
+            }
+        }
+
+        if (!empty) {
+            newline(depth);
+        }
+        out_ += '}';
+    }
+
+    void writeString(const std::string& text) {
+        static const char kHex[] = "0123456789abcdef";
+        out_ += '"';
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+        size_t size = text.size();
+        while (size > 0) {
+            size_t run = plainRun(bytes, size, true);
+            out_.append(reinterpret_cast<const char*>(bytes), run);
+            bytes += run;
+            size -= run;
+            if (size == 0) {
+                break;
+            }
+
+            unsigned char c = *bytes;
+            size_t consumed = 1;
+            switch (c) {
+                case '"': out_ += "\\\""; break;
+                case '\\': out_ += "\\\\"; break;
+                case '\b': out_ += "\\b"; break;
+                case '\f': out_ += "\\f"; break;
+                case '\n': out_ += "\\n"; break;
+                case '\r': out_ += "\\r"; break;
+                case '\t': out_ += "\\t"; break;
+                case 0xED:
+                    if (size >= 3 && bytes[1] >= 0xA0 && bytes[1] <= 0xBF) {
+                        // A lone surrogate; paired ones are four-byte sequences
+                        uint32_t unit = 0xD000 | ((bytes[1] & 0x3F) << 6) | (bytes[2] & 0x3F);
+                        out_ += "\\u";
+                        out_ += kHex[unit >> 12];
+                        out_ += kHex[(unit >> 8) & 0xF];
+                        out_ += kHex[(unit >> 4) & 0xF];
+                        out_ += kHex[unit & 0xF];
+                        consumed = 3;
+                    } else {
+                        out_ += static_cast<char>(c);
+                    }
+                    break;
+                default:
+                    out_ += "\\u00";
+                    out_ += kHex[c >> 4];
+                    out_ += kHex[c & 0xF];
+                    break;
+            }
+            bytes += consumed;
+            size -= consumed;
+        }
+        out_ += '"';
+    }
+};
+
+} // namespace
+
+JSValue parseJSON(std::string_view text, GC& heap) {
+    return JSONParser(text, heap).parse();
+}
+
+JSValue reviveJSON(JSValue value, JSValue reviver, GC& heap, const JSONCaller& call) {
+    if (!isCallable(reviver) || !call) {
+        return value;
+    }
+    TemporaryRoots roots(heap);
+    Object* root = heap.allocate<Object>();
+    root->put("", value);
+    roots.push(JSValue::object(root));
+    return JSONReviver(reviver, heap, call).revive(root, std::string(), 0);
+}
+
+bool stringifyJSON(JSValue value, GC& heap, const JSONStringifyOptions& options, std::string& out) {
+    size_t mark = out.size();
+    if (!JSONWriter(heap, options, out).write(value)) {
+        out.resize(mark);
+        return false;
+    }
+    return true;
+}
+
+} // namespace js
@@ -0,0 +1,332 @@
+#include "js/jsvalue.h"
+#include "js/array.h"
+#include "js/gc.h"
+#include "js/value.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+namespace js {
+
+// Boxing
+
+JSValue JSValue::fromValue(const Value& value, GC& heap) {
+    switch (value.type()) {
+        case ValueType::Undefined: return undefined();
+        case ValueType::Null: return null();
+        case ValueType::Boolean: return boolean(value.toBoolean());
+        case ValueType::Number: return number(value.toNumber());
+        case ValueType::String: return heap.string(value.toString());
+        default: return fromValue(value.clone(), heap);
+    }
+}
+
+JSValue JSValue::fromValue(std::unique_ptr<Value> value, GC& heap) {
+    if (!value) {
+        return undefined();
+    }
+    switch (value->type()) {
+        case ValueType::Undefined: return undefined();
+        case ValueType::Null: return null();
+        case ValueType::Boolean: return boolean(value->toBoolean());
+        case ValueType::Number: return number(value->toNumber());
+        case ValueType::String: return heap.string(value->toString());
+        default: break;
+    }
+
+    // Only Object subclasses may carry the object tag
+    if (!dynamic_cast<Object*>(value.get())) {
+        return heap.string(value->toString());
+    }
+    return object(static_cast<Object*>(heap.adopt(std::move(value))));
+}
+
+std::unique_ptr<Value> JSValue::toValue() const {
+    if (isNumber()) {
+        return std::make_unique<Number>(asNumber());
+    }
+    if (isString()) {
+        return std::make_unique<String>(asString()->value());
+    }
+    if (isObject()) {
+        return asObject()->clone();
+    }
+    if (isBoolean()) {
+        return std::make_unique<Boolean>(asBoolean());
+    }
+    if (isNull()) {
+        return std::make_unique<Null>();
+    }
+    return std::make_unique<Undefined>();
+}
+
+// Conversions
+
+ValueType JSValue::type() const {
+    if (isNumber()) {
+        return ValueType::Number;
+    }
+    if (isString()) {
+        return ValueType::String;
+    }
+    if (isObject()) {
+        return asObject()->type();
+    }
+    if (isBoolean()) {
+        return ValueType::Boolean;
+    }
+    if (isNull()) {
+        return ValueType::Null;
+    }
+    return ValueType::Undefined;
+}
+
+std::string JSValue::toString() const {
+    if (isInt32()) {
+        return std::to_string(asInt32());
+    }
+    if (isDouble()) {
+        return numberToString(asDouble());
+    }
+    if (isString()) {
+        return asString()->value();
+    }
+    if (isObject()) {
+        Object* cell = asObject();
+        if (auto* array = dynamic_cast<Array*>(cell)) {
+            std::string result;
+            for (size_t i = 0; i < array->length(); ++i) {
+                if (i > 0) {
+                    result += ',';
+                }
+                JSValue element = array->at(i);
+                if (!element.isNullish() && !element.isEmpty()) {
+                    result += element.toString();
+                }
+            }
+            return result;
+        }
+        if (dynamic_cast<TypedArray*>(cell) || dynamic_cast<ArrayBuffer*>(cell)) {
+            return cell->toString();
+        }
+        if (cell->type() == ValueType::Object) {
+            return "[object Object]";
+        }
+        return cell->toString();
+    }
+    if (isBoolean()) {
+        return asBoolean() ? "true" : "false";
+    }
+    if (isNull()) {
+        return "null";
+    }
+    return "undefined";
+}
+
+bool JSValue::toBooleanSlow() const {
+    if (isString()) {
+        return asString()->length() != 0;
+    }
+    return true;
+}
+
+double JSValue::toNumberSlow() const {
+    if (isString()) {
+        return stringToNumber(asString()->value());
+    }
+    if (isObject()) {
+        return stringToNumber(toString());
+    }
+    if (isNull() || bits_ == (kTagSpecial | SpecialFalse)) {
+        return 0.0;
+    }
+    if (bits_ == (kTagSpecial | SpecialTrue)) {
+        return 1.0;
+    }
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+int32_t JSValue::doubleToInt32(double value) {
+    if (!std::isfinite(value)) {
+        return 0;
+    }
+    double wrapped = std::fmod(std::trunc(value), 4294967296.0);
+    if (wrapped < 0) {
+        wrapped += 4294967296.0;
+    }
+    return static_cast<int32_t>(static_cast<uint32_t>(wrapped));
+}
+
+// Comparison
+
+bool JSValue::stringEquals(JSValue other) const {
+    return asString()->contentEquals(*other.asString());
+}
+
+bool JSValue::looseEquals(JSValue other) const {
+    if (isNullish() || isEmpty()) {
+        return other.isNullish() || other.isEmpty();
+    }
+    if (other.isNullish() || other.isEmpty()) {
+        return false;
+    }
+    if (isNumber() && other.isNumber()) {
+        return asNumber() == other.asNumber();
+    }
+    if (isString() && other.isString()) {
+        return stringEquals(other);
+    }
+    if (isObject() && other.isObject()) {
+        return bits_ == other.bits_;
+    }
+
+    // Object vs primitive compares the object's primitive (string) form
+    if (isObject() || other.isObject()) {
+        JSValue primitive = isObject() ? other : *this;
+        std::string objectText = isObject() ? toString() : other.toString();
+        if (primitive.isString()) {
+            return objectText == primitive.asString()->value();
+        }
+        return stringToNumber(objectText) == primitive.toNumber();
+    }
+    return toNumber() == other.toNumber();
+}
+
+// Operators
+
+namespace {
+
+// ToPrimitive for the operators: objects become their string form
+bool isStringLike(JSValue value) {
+    return value.isString() || value.isObject();
+}
+
+std::string primitiveString(JSValue value) {
+    return value.isString() ? value.asString()->value() : value.toString();
+}
+
+} // namespace
+
+JSValue addValues(JSValue lhs, JSValue rhs, GC& heap) {
+    if (lhs.isNumber() && rhs.isNumber()) {
+        return JSValue::number(lhs.asNumber() + rhs.asNumber());
+    }
+    // Strings concatenate into ropes, so building a string piece by piece
+    // copies it once (when it is first read) instead of on every step
+    if (isStringLike(lhs) || isStringLike(rhs)) {
+        JSValue left = lhs.isString() ? lhs : heap.string(lhs.toString());
+        JSValue right = rhs.isString() ? rhs : heap.string(rhs.toString());
+        return heap.concat(left.asString(), right.asString());
+    }
+    return JSValue::number(lhs.toNumber() + rhs.toNumber());
+}
+
+bool lessThan(JSValue lhs, JSValue rhs) {
+    if (isStringLike(lhs) && isStringLike(rhs)) {
+        return primitiveString(lhs) < primitiveString(rhs);
+    }
+    return lhs.toNumber() < rhs.toNumber();
+}
+
+bool lessThanOrEqual(JSValue lhs, JSValue rhs) {
+    if (isStringLike(lhs) && isStringLike(rhs)) {
+        return primitiveString(lhs) <= primitiveString(rhs);
+    }
+    return lhs.toNumber() <= rhs.toNumber();
+}
+
+std::string numberToString(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "Infinity" : "-Infinity";
+    }
+    if (value == 0) {
+        return "0";
+    }
+
+    char buffer[32];
+    if (std::trunc(value) == value && std::fabs(value) < 1e21) {
+        std::snprintf(buffer, sizeof(buffer), "%.0f", value);
+        return buffer;
+    }
+
+    // Shortest representation that round-trips
+    for (int precision = 1; precision <= 17; ++precision) {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        if (std::strtod(buffer, nullptr) == value) {
+            break;
+        }
+    }
+    return buffer;
+}
+
+double stringToNumber(const std::string& text) {
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) {
+        ++begin;
+    }
+    while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) {
+        --end;
+    }
+    if (begin == end) {
+        return 0.0;
+    }
+
+    std::string trimmed = text.substr(begin, end - begin);
+    if (trimmed == "Infinity" || trimmed == "+Infinity") {
+        return std::numeric_limits<double>::infinity();
+    }
+    if (trimmed == "-Infinity") {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    if (trimmed.size() > 2 && trimmed[0] == '0') {
+        int radix = 0;
+        switch (trimmed[1]) {
+            case 'x': case 'X': radix = 16; break;
+            case 'o': case 'O': radix = 8; break;
+            case 'b': case 'B': radix = 2; break;
+            default: break;
+        }
+        if (radix != 0) {
+            char* parsed = nullptr;
+            unsigned long long value = std::strtoull(trimmed.c_str() + 2, &parsed, radix);
+            return *parsed == '\0' ? static_cast<double>(value) : nan;
+        }
+    }
+
+    // strtod also accepts "inf", "nan" and hex floats, which JS does not
+    for (char c : trimmed) {
+        if (!std::isdigit(static_cast<unsigned char>(c)) && c != '.' && c != 'e' && c != 'E' && c != '+' && c != '-') {
+            return nan;
+        }
+    }
+    char* parsed = nullptr;
+    double value = std::strtod(trimmed.c_str(), &parsed);
+    return *parsed == '\0' ? value : nan;
+}
+
+const char* typeOfName(JSValue value) {
+    if (value.isNumber()) {
+        return "number";
+    }
+    if (value.isString()) {
+        return "string";
+    }
+    if (value.isBoolean()) {
+        return "boolean";
+    }
+    if (value.isNull()) {
+        return "object";
+    }
+    if (value.isObject()) {
+        return value.asObject()->type() == ValueType::Function ? "function" : "object";
+    }
+    return "undefined";
+}
+
+} // namespace js
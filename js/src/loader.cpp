@@ -0,0 +1,388 @@
+#include "js/loader.h"
+#include "js/compiler.h"
+#include "js/parser.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace js {
+
+namespace {
+
+// Length of the "scheme:" url starts with, or 0. One-letter schemes are
+// taken for drive letters.
+size_t schemeLength(const std::string& url) {
+    size_t colon = url.find(':');
+    if (colon == std::string::npos || colon < 2 || !std::isalpha(static_cast<unsigned char>(url[0]))) {
+        return 0;
+    }
+    for (size_t i = 1; i < colon; ++i) {
+        char c = url[i];
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '+' && c != '-' && c != '.') {
+            return 0;
+        }
+    }
+    return colon + 1;
+}
+
+// Where the path of url starts: after "scheme://host" or "scheme:"
+size_t pathStart(const std::string& url) {
+    size_t scheme = schemeLength(url);
+    if (url.compare(scheme, 2, "//") == 0) {
+        size_t slash = url.find('/', scheme + 2);
+        return slash == std::string::npos ? url.size() : slash;
+    }
+    return scheme;
+}
+
+// Drops empty and "." segments and applies ".."; a rooted path never
+// climbs above its root
+std::string normalizePath(const std::string& path) {
+    bool rooted = !path.empty() && path[0] == '/';
+    std::vector<std::string> segments;
+    size_t begin = 0;
+    while (begin <= path.size()) {
+        size_t end = std::min(path.find('/', begin), path.size());
+        std::string segment = path.substr(begin, end - begin);
+        if (segment == "..") {
+            if (!segments.empty() && segments.back() != "..") {
+                segments.pop_back();
+            } else if (!rooted) {
+                segments.push_back(segment);
+            }
+        } else if (!segment.empty() && segment != ".") {
+            segments.push_back(std::move(segment));
+        }
+        begin = end + 1;
+    }
+
+    std::string result = rooted ? "/" : "";
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (i > 0) {
+            result += '/';
+        }
+        result += segments[i];
+    }
+    return result;
+}
+
+bool fetchFile(const std::string& url, std::string& source) {
+    std::string path = url;
+    if (path.compare(0, 7, "file://") == 0) {
+        path.erase(0, 7);
+    } else if (schemeLength(path) > 0) {
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    source = contents.str();
+    return true;
+}
+
+void addDependencies(ModuleRecord& record, const std::vector<std::string>& requests) {
+    for (const std::string& request : requests) {
+        std::string url = Loader::resolve(request, record.url);
+        if (std::find(record.dependencies.begin(), record.dependencies.end(), url) == record.dependencies.end()) {
+            record.dependencies.push_back(std::move(url));
+        }
+    }
+}
+
+
+// Bytes function and its nested functions hold in their tables
+size_t functionBytes(const BytecodeFunction& function) {
+    size_t bytes = sizeof(BytecodeFunction) + function.name.capacity() +
+                   function.code.capacity() * sizeof(Instruction) + function.constants.capacity() * sizeof(Constant) +
+                   function.constantValues.capacity() * sizeof(JSValue) +
+                   function.positions.capacity() * sizeof(TokenPosition) +
+                   function.propertyCaches.capacity() * sizeof(PropertyCache) +
+                   function.cacheSlots.capacity() * sizeof(uint32_t);
+    for (const std::string& name : function.names) {
+        bytes += sizeof(std::string) + name.capacity();
+    }
+    for (const auto& child : function.functions) {
+        if (child) bytes += functionBytes(*child);
+    }
+    return bytes;
+}
+
+// Bytes of a record; a registered module's tree lives in its parse arena
+// and is not counted
+size_t recordBytes(const ModuleRecord& record) {
+    size_t bytes = sizeof(ModuleRecord) + record.url.capacity() + record.source.capacity();
+    for (const std::string& dependency : record.dependencies) {
+        bytes += sizeof(std::string) + dependency.capacity();
+    }
+    if (record.function) bytes += functionBytes(*record.function);
+    return bytes;
+}
+} // namespace
+
+Loader::Loader()
+    : fetcher_(fetchFile)
+    , records_()
+    , registered_()
+    , fetchCount_(0)
+    , reuseCount_(0) {
+}
+
+void Loader::setFetcher(Fetcher fetcher) {
+    fetcher_ = std::move(fetcher);
+}
+
+// Resolution
+
+std::string Loader::resolve(const std::string& specifier, const std::string& referrer) {
+    bool relative = specifier.compare(0, 2, "./") == 0 || specifier.compare(0, 3, "../") == 0;
+    bool rooted = !specifier.empty() && specifier[0] == '/';
+    if (schemeLength(specifier) > 0 || (!relative && !rooted)) {
+        return specifier;
+    }
+
+    size_t start = pathStart(referrer);
+    std::string prefix = referrer.substr(0, start);
+    if (rooted) {
+        return prefix + normalizePath(specifier);
+    }
+    std::string directory = referrer.substr(start);
+    size_t slash = directory.rfind('/');
+    directory.erase(slash == std::string::npos ? 0 : slash + 1);
+    return prefix + normalizePath(directory + specifier);
+}
+
+std::string Loader::originOf(const std::string& url) {
+    size_t scheme = schemeLength(url);
+    if (scheme == 0 || url.compare(0, scheme, "file:") == 0) {
+        return "file://";
+    }
+    return url.substr(0, pathStart(url));
+}
+
+// Graphs
+
+std::shared_ptr<const ModuleRecord> Loader::makeRecord(const std::string& url, CompiledScript script) const {
+    auto record = std::make_shared<ModuleRecord>();
+    record->url = url;
+    record->source = std::move(script.source);
+    record->function = std::move(script.function);
+    record->compileTime = script.compileTime;
+    addDependencies(*record, script.moduleRequests);
+    return record;
+}
+
+std::shared_ptr<const ModuleRecord> Loader::makeRecord(const std::string& url, std::unique_ptr<Module> module,
+                                                       std::string& error) const {
+    auto start = std::chrono::steady_clock::now();
+    auto record = std::make_shared<ModuleRecord>();
+    record->url = url;
+    try {
+        Compiler compiler;
+        record->function = compiler.compile(module.get());
+    } catch (const CompileError& e) {
+        error = url + ": " + e.what();
+        return nullptr;
+    }
+    addDependencies(*record, moduleRequests(*module));
+    record->tree = std::move(module);
+    record->compileTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return record;
+}
+
+std::vector<std::shared_ptr<const ModuleRecord>> Loader::load(const std::string& specifier, const std::string& referrer,
+                                                              ScriptCompiler& compiler, bool bytecode,
+                                                              std::string& error) {
+    struct Job {
+        std::string url;
+        std::future<CompiledScript> script;
+    };
+
+    std::string entry = resolve(specifier, referrer);
+    std::unordered_map<std::string, std::shared_ptr<const ModuleRecord>> graph;
+    std::unordered_set<std::string> seen{entry};
+    std::vector<std::string> found{entry};
+    std::deque<Job> jobs;
+    auto discover = [&](const std::shared_ptr<const ModuleRecord>& record) {
+        graph.emplace(record->url, record);
+        for (const std::string& dependency : record->dependencies) {
+            if (seen.insert(dependency).second) {
+                found.push_back(dependency);
+            }
+        }
+    };
+
+    error.clear();
+    while (!found.empty() || !jobs.empty()) {
+        // Everything found so far starts before anything is waited on
+        while (!found.empty()) {
+            std::string url = std::move(found.back());
+            found.pop_back();
+
+            auto cached = records_.find(url);
+            if (cached != records_.end()) {
+                ++reuseCount_;
+                discover(cached->second);
+                continue;
+            }
+            auto registered = registered_.find(url);
+            if (registered != registered_.end()) {
+                std::unique_ptr<Module> module = std::move(registered->second);
+                registered_.erase(registered);
+                std::shared_ptr<const ModuleRecord> record = makeRecord(url, std::move(module), error);
+                if (!record) {
+                    return {};
+                }
+                records_[url] = record;
+                discover(record);
+                continue;
+            }
+
+            ++fetchCount_;
+            jobs.push_back(Job{url, compiler.submit([fetcher = fetcher_, url, bytecode]() {
+                std::string source;
+                if (!fetcher || !fetcher(url, source)) {
+                    throw std::runtime_error("TypeError: Failed to fetch module");
+                }
+                return ScriptCompiler::compileModuleNow(std::move(source), bytecode);
+            })});
+        }
+        if (jobs.empty()) {
+            break;
+        }
+
+        // The first to finish, so its imports start as soon as they can
+        auto next = std::find_if(jobs.begin(), jobs.end(), [](const Job& job) {
+            return job.script.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        });
+        if (next == jobs.end()) {
+            next = jobs.begin();
+        }
+        Job job = std::move(*next);
+        jobs.erase(next);
+
+        CompiledScript script;
+        try {
+            script = job.script.get();
+        } catch (const std::exception& e) {
+            // Jobs still running finish on their own
+            error = job.url + ": " + e.what();
+            return {};
+        }
+        std::shared_ptr<const ModuleRecord> record = makeRecord(job.url, std::move(script));
+        records_[job.url] = record;
+        discover(record);
+    }
+
+    return link(graph.at(entry), graph);
+}
+
+// Dependencies first, each once. A dependency already on the stack closes
+// a cycle and is skipped, so the module that reached it first runs last.
+std::vector<std::shared_ptr<const ModuleRecord>> Loader::link(
+    const std::shared_ptr<const ModuleRecord>& entry,
+    const std::unordered_map<std::string, std::shared_ptr<const ModuleRecord>>& graph) {
+    std::vector<std::shared_ptr<const ModuleRecord>> order;
+    order.reserve(graph.size());
+    std::unordered_set<const ModuleRecord*> visited{entry.get()};
+    // Each record with the index of its next dependency
+    std::vector<std::pair<std::shared_ptr<const ModuleRecord>, size_t>> stack{{entry, 0}};
+    while (!stack.empty()) {
+        const ModuleRecord& record = *stack.back().first;
+        size_t next = stack.back().second;
+        if (next < record.dependencies.size()) {
+            ++stack.back().second;
+            std::shared_ptr<const ModuleRecord> dependency = graph.at(record.dependencies[next]);
+            if (visited.insert(dependency.get()).second) {
+                stack.emplace_back(std::move(dependency), 0);
+            }
+            continue;
+        }
+        order.push_back(std::move(stack.back().first));
+        stack.pop_back();
+    }
+    return order;
+}
+
+void Loader::navigate(const std::string& url) {
+    std::string origin = originOf(url);
+    for (auto it = records_.begin(); it != records_.end();) {
+        it = originOf(it->first) == origin ? std::next(it) : records_.erase(it);
+    }
+}
+
+void Loader::clear() {
+    records_.clear();
+}
+
+size_t Loader::purge() {
+    size_t dropped = 0;
+    for (auto it = records_.begin(); it != records_.end();) {
+        if (it->second.use_count() == 1) {
+            it = records_.erase(it);
+            ++dropped;
+        } else {
+            ++it;
+        }
+    }
+    return dropped;
+}
+
+size_t Loader::memoryUsage() const {
+    size_t bytes = 0;
+    for (const auto& entry : records_) {
+        bytes += recordBytes(*entry.second);
+    }
+    return bytes;
+}
+
+// Single modules
+
+std::unique_ptr<Module> Loader::loadModule(const std::string& specifier) {
+    return loadModule(specifier, std::string());
+}
+
+std::unique_ptr<Module> Loader::loadModule(const std::string& specifier, const std::string& referrer) {
+    std::string url = resolve(specifier, referrer);
+    auto registered = registered_.find(url);
+    if (registered != registered_.end()) {
+        std::unique_ptr<Module> module = std::move(registered->second);
+        registered_.erase(registered);
+        return module;
+    }
+
+    std::string source;
+    if (!fetcher_ || !fetcher_(url, source)) {
+        return nullptr;
+    }
+    ++fetchCount_;
+
+    Parser parser(source);
+    parser.setModuleMode(true);
+    std::unique_ptr<AST> ast = parser.parse();
+    if (!ast || !dynamic_cast<Module*>(ast->root())) {
+        return nullptr;
+    }
+    return std::unique_ptr<Module>(static_cast<Module*>(ast->releaseRoot().release()));
+}
+
+void Loader::registerModule(const std::string& specifier, std::unique_ptr<Module> module) {
+    if (!module) {
+        return;
+    }
+    std::string url = resolve(specifier, std::string());
+    // A record loaded earlier would hide it
+    records_.erase(url);
+    registered_[url] = std::move(module);
+}
+
+} // namespace js
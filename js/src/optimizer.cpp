@@ -0,0 +1,751 @@
+#include "js/optimizer.h"
+#include "js/ast_optimizer.h"
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+#if JS_BASELINE_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace js {
+
+// Optimizer
+
+Optimizer::Optimizer()
+    : enabled_(false), helpers_(), compiledFunctions_(0), failedCompilations_(0), deoptimizations_(0),
+      invalidations_(0), codeSize_(0), foldedExpressions_(0), eliminatedBranches_(0) {
+}
+
+Optimizer::~Optimizer() = default;
+
+void Optimizer::tierUp(BytecodeFunction& function) {
+    if (function.tier.disabled || function.lazy || !helpers_.getProperty) {
+        return;
+    }
+    function.baseline = BaselineCode::compile(function, helpers_);
+    if (!function.baseline) {
+        function.tier.disabled = true;
+        ++failedCompilations_;
+        return;
+    }
+    ++compiledFunctions_;
+    codeSize_ += function.baseline->size();
+}
+
+// Code that keeps failing its guards runs the interpreter's generic paths
+// more often than its own, so it is thrown away for good
+void Optimizer::onDeoptimize(BytecodeFunction& function) {
+    ++deoptimizations_;
+    if (++function.tier.deoptimizations < kMaxDeoptimizations || !function.baseline) {
+        return;
+    }
+    codeSize_ -= function.baseline->size();
+    function.baseline.reset();
+    function.tier.disabled = true;
+    ++invalidations_;
+}
+
+void Optimizer::optimizeTree(Node* root) {
+    if (!enabled_ || !root) {
+        return;
+    }
+    ASTOptimizer pass;
+    pass.optimize(root);
+    foldedExpressions_ += pass.getFoldedCount();
+    eliminatedBranches_ += pass.getEliminatedBranchCount();
+}
+
+#if JS_BASELINE_JIT
+
+namespace {
+
+static_assert(offsetof(BaselineFrame, regs) == 0, "baseline code reads regs at offset 0");
+static_assert(offsetof(BaselineFrame, fuel) == 16, "baseline code reads fuel at offset 16");
+static_assert(offsetof(BaselineFrame, exit) == 20, "baseline code writes exit at offset 20");
+static_assert(sizeof(JSValue) == 8, "registers are addressed as 8-byte slots");
+
+enum Reg : uint8_t { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RSI = 6, RDI = 7, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+
+// Condition codes (low nibble of Jcc / SETcc)
+enum Cond : uint8_t { kOverflow = 0x0, kBelowEqual = 0x6, kAbove = 0x7, kSign = 0x8, kEqual = 0x4, kNotEqual = 0x5,
+                      kLess = 0xC, kGreaterEqual = 0xD, kLessEqual = 0xE, kGreater = 0xF };
+
+constexpr uint32_t kInt32TagHigh = static_cast<uint32_t>(JSValue::kTagInt32 >> 32);
+constexpr uint64_t kFalseBits = JSValue::kTagSpecial | JSValue::SpecialFalse;
+
+// Minimal x86-64 encoder for the sequences the baseline compiler emits.
+// Labels are resolved once the whole function has been emitted.
+class Assembler {
+public:
+    using Label = size_t;
+
+    std::vector<uint8_t>& bytes() { return bytes_; }
+
+    Label newLabel() {
+        labels_.push_back(kUnbound);
+        return labels_.size() - 1;
+    }
+    void bind(Label label) { labels_[label] = bytes_.size(); }
+    size_t offsetOf(Label label) const { return labels_[label]; }
+
+    // Loads and stores (64-bit unless noted)
+    void loadSlot(Reg dst, uint16_t slot) { memory(0x8B, dst, R12, static_cast<int32_t>(slot) * 8, true); }
+    void storeSlot(uint16_t slot, Reg src) { memory(0x89, src, R12, static_cast<int32_t>(slot) * 8, true); }
+    void load(Reg dst, Reg base, int32_t disp) { memory(0x8B, dst, base, disp, true); }
+    void moveImmediate(Reg dst, uint64_t value) {
+        rex(true, 0, dst);
+        byte(static_cast<uint8_t>(0xB8 + (dst & 7)));
+        quad(value);
+    }
+    void moveImmediate32(Reg dst, uint32_t value) {
+        rex(false, 0, dst);
+        byte(static_cast<uint8_t>(0xB8 + (dst & 7)));
+        dword(value);
+    }
+    void move64(Reg dst, Reg src) { registers(0x89, src, dst, true); }
+    void move32(Reg dst, Reg src) { registers(0x89, src, dst, false); }
+    // mov dword [base + disp], imm32
+    void storeImmediate32(Reg base, int32_t disp, uint32_t value) {
+        memory(0xC7, static_cast<Reg>(0), base, disp, false);
+        dword(value);
+    }
+    // sub dword [base + disp], 1
+    void decrement32(Reg base, int32_t disp) {
+        memory(0x83, static_cast<Reg>(5), base, disp, false);
+        byte(1);
+    }
+
+    // 32-bit ALU (dst op= src)
+    void add32(Reg dst, Reg src) { registers(0x01, src, dst, false); }
+    void sub32(Reg dst, Reg src) { registers(0x29, src, dst, false); }
+    void and32(Reg dst, Reg src) { registers(0x21, src, dst, false); }
+    void or32(Reg dst, Reg src) { registers(0x09, src, dst, false); }
+    void xor32(Reg dst, Reg src) { registers(0x31, src, dst, false); }
+    void cmp32(Reg lhs, Reg rhs) { registers(0x39, rhs, lhs, false); }
+    void test32(Reg lhs, Reg rhs) { registers(0x85, rhs, lhs, false); }
+    void imul32(Reg dst, Reg src) {
+        rex(false, dst, src);
+        byte(0x0F);
+        byte(0xAF);
+        modrm(3, dst, src);
+    }
+    void neg32(Reg dst) { group(0xF7, 3, dst, false); }
+    void addImmediate32(Reg dst, int32_t value) {
+        group(0x81, 0, dst, false);
+        dword(static_cast<uint32_t>(value));
+    }
+    void subImmediate32(Reg dst, int32_t value) {
+        group(0x81, 5, dst, false);
+        dword(static_cast<uint32_t>(value));
+    }
+    void cmpImmediate32(Reg dst, uint32_t value) {
+        group(0x81, 7, dst, false);
+        dword(value);
+    }
+    // Shift by cl: 4 = shl, 5 = shr, 7 = sar
+    void shiftByCl32(uint8_t kind, Reg dst) { group(0xD3, kind, dst, false); }
+    void shr64(Reg dst, uint8_t amount) {
+        group(0xC1, 5, dst, true);
+        byte(amount);
+    }
+    // edx:eax / src, signed
+    void cdq() { byte(0x99); }
+    void idiv32(Reg src) { group(0xF7, 7, src, false); }
+
+    // 64-bit ALU
+    void add64(Reg dst, Reg src) { registers(0x01, src, dst, true); }
+    void or64(Reg dst, Reg src) { registers(0x09, src, dst, true); }
+    void xor64(Reg dst, Reg src) { registers(0x31, src, dst, true); }
+    void cmp64(Reg lhs, Reg rhs) { registers(0x39, rhs, lhs, true); }
+    void cmpImmediate64(Reg dst, int32_t value) {
+        group(0x81, 7, dst, true);
+        dword(static_cast<uint32_t>(value));
+    }
+
+    void setcc(Cond cond, Reg dst) {
+        rex(false, 0, dst, dst >= 4);
+        byte(0x0F);
+        byte(static_cast<uint8_t>(0x90 | cond));
+        modrm(3, 0, dst);
+    }
+    void movzx8(Reg dst, Reg src) {
+        rex(false, dst, src, src >= 4);
+        byte(0x0F);
+        byte(0xB6);
+        modrm(3, dst, src);
+    }
+
+    // Control flow
+    void jump(Label target) {
+        byte(0xE9);
+        fixup(target);
+    }
+    void jumpIf(Cond cond, Label target) {
+        byte(0x0F);
+        byte(static_cast<uint8_t>(0x80 | cond));
+        fixup(target);
+    }
+    void call(Reg target) { group(0xFF, 2, target, false); }
+    void push(Reg reg) {
+        rex(false, 0, reg);
+        byte(static_cast<uint8_t>(0x50 + (reg & 7)));
+    }
+    void pop(Reg reg) {
+        rex(false, 0, reg);
+        byte(static_cast<uint8_t>(0x58 + (reg & 7)));
+    }
+    void ret() { byte(0xC3); }
+    // jmp [rip + table + index * 8], clobbering rcx
+    void jumpThroughTable(Label table, Reg index) {
+        // lea rcx, [rip + table]
+        byte(0x48);
+        byte(0x8D);
+        byte(0x0D);
+        fixup(table);
+        // jmp [rcx + index * 8]
+        rex(false, 0, RCX, false, index);
+        byte(0xFF);
+        modrm(0, 4, 4);
+        byte(static_cast<uint8_t>(0xC0 | ((index & 7) << 3) | RCX));
+    }
+
+    void align(size_t alignment) {
+        while (bytes_.size() % alignment != 0) {
+            byte(0xCC);
+        }
+    }
+    void quad(uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            byte(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    // Patches every rel32 operand; false if a label was never bound
+    bool resolve() {
+        for (const auto& entry : fixups_) {
+            size_t target = labels_[entry.second];
+            if (target == kUnbound) {
+                return false;
+            }
+            int32_t rel = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(entry.first + 4));
+            std::memcpy(&bytes_[entry.first], &rel, sizeof(rel));
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t kUnbound = static_cast<size_t>(-1);
+
+    std::vector<uint8_t> bytes_;
+    std::vector<size_t> labels_;
+    std::vector<std::pair<size_t, Label>> fixups_;
+
+    void byte(uint8_t value) { bytes_.push_back(value); }
+    void dword(uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            byte(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+    void fixup(Label target) {
+        fixups_.emplace_back(bytes_.size(), target);
+        dword(0);
+    }
+    void modrm(uint8_t mod, uint8_t reg, uint8_t rm) {
+        byte(static_cast<uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+    }
+    // force emits a plain REX so byte registers sil/dil/spl/bpl are addressable
+    void rex(bool wide, uint8_t reg, uint8_t rm, bool force = false, uint8_t index = 0) {
+        uint8_t value = static_cast<uint8_t>(0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index & 8) ? 2 : 0) |
+                                             ((rm & 8) ? 1 : 0));
+        if (value != 0x40 || force) {
+            byte(value);
+        }
+    }
+    // op r/m, reg with both operands in registers
+    void registers(uint8_t opcode, Reg reg, Reg rm, bool wide) {
+        rex(wide, reg, rm);
+        byte(opcode);
+        modrm(3, reg, rm);
+    }
+    // op with a /digit extension on a register operand
+    void group(uint8_t opcode, uint8_t digit, Reg rm, bool wide) {
+        rex(wide, 0, rm);
+        byte(opcode);
+        modrm(3, digit, rm);
+    }
+    // op reg, [base + disp32]
+    void memory(uint8_t opcode, Reg reg, Reg base, int32_t disp, bool wide) {
+        rex(wide, reg, base);
+        byte(opcode);
+        modrm(2, reg, base);
+        if ((base & 7) == RSP) {
+            byte(0x24);
+        }
+        dword(static_cast<uint32_t>(disp));
+    }
+};
+
+bool isInt32Operation(Opcode op) {
+    switch (op) {
+        case Opcode::Add:
+        case Opcode::Subtract:
+        case Opcode::Multiply:
+        case Opcode::Modulo:
+        case Opcode::BitwiseAnd:
+        case Opcode::BitwiseOr:
+        case Opcode::BitwiseXor:
+        case Opcode::LeftShift:
+        case Opcode::RightShift:
+        case Opcode::UnsignedRightShift:
+            return true;
+        default:
+            return false;
+    }
+}
+
+Cond compareCondition(Opcode op) {
+    switch (op) {
+        case Opcode::Equal:
+        case Opcode::StrictEqual: return kEqual;
+        case Opcode::NotEqual:
+        case Opcode::StrictNotEqual: return kNotEqual;
+        case Opcode::LessThan: return kLess;
+        case Opcode::LessThanOrEqual: return kLessEqual;
+        case Opcode::GreaterThan: return kGreater;
+        default: return kGreaterEqual;
+    }
+}
+
+bool isComparison(Opcode op) {
+    return op >= Opcode::Equal && op <= Opcode::GreaterThanOrEqual;
+}
+
+// Register use inside generated code:
+//   rbx  BaselineFrame*       r12  register window
+//   r13  int32 tag            r14  false bits (true is false + 1)
+//   rax, rcx, rdx, rsi, rdi, r11  scratch
+class BaselineCompiler {
+public:
+    BaselineCompiler(const BytecodeFunction& function, const BaselineHelpers& helpers)
+        : function_(function), helpers_(helpers), masm_(), instructions_(), epilogue_(), exits_() {}
+
+    bool compile() {
+        const std::vector<Instruction>& code = function_.code;
+        if (code.empty() || function_.constantValues.size() != function_.constants.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < code.size(); ++i) {
+            instructions_.push_back(masm_.newLabel());
+        }
+        epilogue_ = masm_.newLabel();
+        Assembler::Label table = masm_.newLabel();
+
+        // uint32_t entry(BaselineFrame* rdi, uint32_t pc esi); five pushes
+        // keep rsp 16-byte aligned for helper calls
+        masm_.push(RBX);
+        masm_.push(R12);
+        masm_.push(R13);
+        masm_.push(R14);
+        masm_.push(R15);
+        masm_.move64(RBX, RDI);
+        masm_.load(R12, RBX, 0);
+        masm_.moveImmediate(R13, JSValue::kTagInt32);
+        masm_.moveImmediate(R14, kFalseBits);
+        masm_.move32(RAX, RSI);
+        masm_.jumpThroughTable(table, RAX);
+
+        for (uint32_t pc = 0; pc < code.size(); ++pc) {
+            masm_.bind(instructions_[pc]);
+            emitInstruction(code[pc], pc);
+        }
+
+        for (const auto& exit : exits_) {
+            masm_.bind(exit.second);
+            masm_.storeImmediate32(RBX, offsetof(BaselineFrame, exit), static_cast<uint32_t>(exit.first.first));
+            masm_.moveImmediate32(RAX, exit.first.second);
+            masm_.jump(epilogue_);
+        }
+
+        masm_.bind(epilogue_);
+        masm_.pop(R15);
+        masm_.pop(R14);
+        masm_.pop(R13);
+        masm_.pop(R12);
+        masm_.pop(RBX);
+        masm_.ret();
+
+        // Entry table of absolute addresses, patched once the code is placed
+        masm_.align(8);
+        masm_.bind(table);
+        tableOffset_ = masm_.bytes().size();
+        for (size_t i = 0; i < code.size(); ++i) {
+            masm_.quad(masm_.offsetOf(instructions_[i]));
+        }
+        return masm_.resolve();
+    }
+
+    const std::vector<uint8_t>& bytes() { return masm_.bytes(); }
+    size_t tableOffset() const { return tableOffset_; }
+    size_t instructionCount() const { return instructions_.size(); }
+
+private:
+    const BytecodeFunction& function_;
+    const BaselineHelpers& helpers_;
+    Assembler masm_;
+    std::vector<Assembler::Label> instructions_;
+    Assembler::Label epilogue_;
+    std::map<std::pair<BaselineExit, uint32_t>, Assembler::Label> exits_;
+    size_t tableOffset_ = 0;
+
+    // Out-of-line stub leaving with the given reason at pc
+    Assembler::Label exitTo(BaselineExit reason, uint32_t pc) {
+        auto key = std::make_pair(reason, pc);
+        auto it = exits_.find(key);
+        if (it != exits_.end()) {
+            return it->second;
+        }
+        Assembler::Label label = masm_.newLabel();
+        exits_.emplace(key, label);
+        return label;
+    }
+
+    void guardInt32(Reg value, uint32_t pc) {
+        masm_.move64(R11, value);
+        masm_.shr64(R11, 32);
+        masm_.cmpImmediate32(R11, kInt32TagHigh);
+        masm_.jumpIf(kNotEqual, exitTo(BaselineExit::Deoptimize, pc));
+    }
+
+    // eax holds the int32 result; the upper half is already clear
+    void storeInt32(uint16_t slot) {
+        masm_.or64(RAX, R13);
+        masm_.storeSlot(slot, RAX);
+    }
+
+    void storeCondition(Cond cond, uint16_t slot) {
+        masm_.setcc(cond, RAX);
+        masm_.movzx8(RAX, RAX);
+        masm_.add64(RAX, R14);
+        masm_.storeSlot(slot, RAX);
+    }
+
+    // Backward jumps spend fuel so long loops still reach safepoints
+    void jumpTo(uint32_t target, uint32_t pc) {
+        if (target <= pc) {
+            masm_.decrement32(RBX, offsetof(BaselineFrame, fuel));
+            masm_.jumpIf(kEqual, exitTo(BaselineExit::Safepoint, target));
+        }
+        masm_.jump(instructions_[target]);
+    }
+
+    void callHelper(BaselineHelpers::Helper helper, uint32_t pc) {
+        masm_.move64(RDI, RBX);
+        masm_.moveImmediate32(RSI, pc);
+        masm_.moveImmediate(RAX, reinterpret_cast<uint64_t>(helper));
+        masm_.call(RAX);
+        masm_.load(R12, RBX, 0);
+        masm_.test32(RAX, RAX);
+        masm_.jumpIf(kNotEqual, exitTo(BaselineExit::Throw, pc));
+    }
+
+    void emitInstruction(const Instruction& insn, uint32_t pc) {
+        Opcode op = insn.op;
+        if (isInt32Operation(op)) {
+            emitInt32Operation(insn, pc);
+            return;
+        }
+        if (isComparison(op)) {
+            emitComparison(insn, pc);
+            return;
+        }
+
+        switch (op) {
+            case Opcode::LoadConst:
+                masm_.moveImmediate(RAX, function_.constantValues[insn.b].bits());
+                masm_.storeSlot(insn.a, RAX);
+                break;
+            case Opcode::LoadUndefined:
+            case Opcode::LoadNull:
+            case Opcode::LoadTrue:
+            case Opcode::LoadFalse: {
+                JSValue value = op == Opcode::LoadUndefined ? JSValue::undefined()
+                                : op == Opcode::LoadNull    ? JSValue::null()
+                                                            : JSValue::boolean(op == Opcode::LoadTrue);
+                masm_.moveImmediate(RAX, value.bits());
+                masm_.storeSlot(insn.a, RAX);
+                break;
+            }
+            case Opcode::Move:
+                masm_.loadSlot(RAX, insn.b);
+                masm_.storeSlot(insn.a, RAX);
+                break;
+
+            case Opcode::Increment:
+            case Opcode::Decrement:
+                masm_.loadSlot(RAX, insn.b);
+                guardInt32(RAX, pc);
+                if (op == Opcode::Increment) {
+                    masm_.addImmediate32(RAX, 1);
+                } else {
+                    masm_.subImmediate32(RAX, 1);
+                }
+                masm_.jumpIf(kOverflow, exitTo(BaselineExit::Deoptimize, pc));
+                storeInt32(insn.a);
+                break;
+            case Opcode::Negate:
+                // 0 and INT32_MIN negate to values int32 cannot hold
+                masm_.loadSlot(RAX, insn.b);
+                guardInt32(RAX, pc);
+                masm_.test32(RAX, RAX);
+                masm_.jumpIf(kEqual, exitTo(BaselineExit::Deoptimize, pc));
+                masm_.neg32(RAX);
+                masm_.jumpIf(kOverflow, exitTo(BaselineExit::Deoptimize, pc));
+                storeInt32(insn.a);
+                break;
+            case Opcode::LogicalNot:
+                // Booleans only: false ^ 1 == true and back
+                masm_.loadSlot(RAX, insn.b);
+                masm_.move64(RCX, RAX);
+                masm_.xor64(RCX, R14);
+                masm_.cmpImmediate64(RCX, 1);
+                masm_.jumpIf(kAbove, exitTo(BaselineExit::Deoptimize, pc));
+                masm_.moveImmediate(RCX, 1);
+                masm_.xor64(RAX, RCX);
+                masm_.storeSlot(insn.a, RAX);
+                break;
+
+            case Opcode::Jump:
+                jumpTo(insn.target(), pc);
+                break;
+            case Opcode::JumpIfTrue:
+            case Opcode::JumpIfFalse:
+                emitConditionalJump(insn, pc);
+                break;
+            case Opcode::JumpIfNotNullish: {
+                Assembler::Label next = masm_.newLabel();
+                masm_.loadSlot(RAX, insn.a);
+                masm_.moveImmediate(RCX, JSValue::undefined().bits());
+                masm_.cmp64(RAX, RCX);
+                masm_.jumpIf(kEqual, next);
+                masm_.moveImmediate(RCX, JSValue::null().bits());
+                masm_.cmp64(RAX, RCX);
+                masm_.jumpIf(kEqual, next);
+                jumpTo(insn.target(), pc);
+                masm_.bind(next);
+                break;
+            }
+
+            case Opcode::LoadName: callHelper(helpers_.loadName, pc); break;
+            case Opcode::StoreName: callHelper(helpers_.storeName, pc); break;
+            case Opcode::DeclareName: callHelper(helpers_.declareName, pc); break;
+            case Opcode::LoadSlot: callHelper(helpers_.loadSlot, pc); break;
+            case Opcode::StoreSlot: callHelper(helpers_.storeSlot, pc); break;
+            case Opcode::GetProperty: callHelper(helpers_.getProperty, pc); break;
+            case Opcode::SetProperty: callHelper(helpers_.setProperty, pc); break;
+            case Opcode::GetElement: callHelper(helpers_.getElement, pc); break;
+            case Opcode::SetElement: callHelper(helpers_.setElement, pc); break;
+
+            case Opcode::Nop:
+            case Opcode::Debugger:
+                break;
+
+            default:
+                // Calls, returns, allocation, exceptions and the remaining
+                // generic operators stay with the interpreter
+                masm_.jump(exitTo(BaselineExit::Interpret, pc));
+                break;
+        }
+    }
+
+    void emitInt32Operation(const Instruction& insn, uint32_t pc) {
+        Assembler::Label deopt = exitTo(BaselineExit::Deoptimize, pc);
+        masm_.loadSlot(RAX, insn.b);
+        masm_.loadSlot(RDX, insn.c);
+        guardInt32(RAX, pc);
+        guardInt32(RDX, pc);
+
+        switch (insn.op) {
+            case Opcode::Add:
+                masm_.add32(RAX, RDX);
+                masm_.jumpIf(kOverflow, deopt);
+                break;
+            case Opcode::Subtract:
+                masm_.sub32(RAX, RDX);
+                masm_.jumpIf(kOverflow, deopt);
+                break;
+            case Opcode::Multiply: {
+                // A zero product of a negative operand is -0
+                Assembler::Label done = masm_.newLabel();
+                masm_.move32(RCX, RAX);
+                masm_.or32(RCX, RDX);
+                masm_.imul32(RAX, RDX);
+                masm_.jumpIf(kOverflow, deopt);
+                masm_.test32(RAX, RAX);
+                masm_.jumpIf(kNotEqual, done);
+                masm_.test32(RCX, RCX);
+                masm_.jumpIf(kSign, deopt);
+                masm_.bind(done);
+                break;
+            }
+            case Opcode::Modulo:
+                // Non-negative dividend and positive divisor only; the rest
+                // (including -0 results) takes the generic path
+                masm_.test32(RAX, RAX);
+                masm_.jumpIf(kSign, deopt);
+                masm_.test32(RDX, RDX);
+                masm_.jumpIf(kLessEqual, deopt);
+                masm_.move32(RCX, RDX);
+                masm_.cdq();
+                masm_.idiv32(RCX);
+                masm_.move32(RAX, RDX);
+                break;
+            case Opcode::BitwiseAnd: masm_.and32(RAX, RDX); break;
+            case Opcode::BitwiseOr: masm_.or32(RAX, RDX); break;
+            case Opcode::BitwiseXor: masm_.xor32(RAX, RDX); break;
+            case Opcode::LeftShift:
+            case Opcode::RightShift:
+            case Opcode::UnsignedRightShift:
+                masm_.move32(RCX, RDX);
+                masm_.shiftByCl32(insn.op == Opcode::LeftShift ? 4 : insn.op == Opcode::RightShift ? 7 : 5, RAX);
+                if (insn.op == Opcode::UnsignedRightShift) {
+                    // Results above INT32_MAX are doubles
+                    masm_.test32(RAX, RAX);
+                    masm_.jumpIf(kSign, deopt);
+                }
+                break;
+            default:
+                break;
+        }
+        storeInt32(insn.a);
+    }
+
+    // int32 operands compare inline. Strict (in)equality also compares
+    // bits directly when neither side is a double or a string, which
+    // covers booleans, null, undefined and object identity.
+    void emitComparison(const Instruction& insn, uint32_t pc) {
+        Assembler::Label deopt = exitTo(BaselineExit::Deoptimize, pc);
+        Cond cond = compareCondition(insn.op);
+        masm_.loadSlot(RAX, insn.b);
+        masm_.loadSlot(RDX, insn.c);
+
+        if (insn.op == Opcode::StrictEqual || insn.op == Opcode::StrictNotEqual) {
+            Assembler::Label compare = masm_.newLabel();
+            Assembler::Label notInt = masm_.newLabel();
+            masm_.move64(R11, RAX);
+            masm_.shr64(R11, 32);
+            masm_.cmpImmediate32(R11, kInt32TagHigh);
+            masm_.jumpIf(kNotEqual, notInt);
+            masm_.move64(R11, RDX);
+            masm_.shr64(R11, 32);
+            masm_.cmpImmediate32(R11, kInt32TagHigh);
+            masm_.jumpIf(kEqual, compare);
+            masm_.bind(notInt);
+            for (Reg value : {RAX, RDX}) {
+                // Tags 0xFFFA (special) and 0xFFFC (object) only
+                Assembler::Label ok = masm_.newLabel();
+                masm_.move64(R11, value);
+                masm_.shr64(R11, 48);
+                masm_.cmpImmediate32(R11, 0xFFFA);
+                masm_.jumpIf(kEqual, ok);
+                masm_.cmpImmediate32(R11, 0xFFFC);
+                masm_.jumpIf(kNotEqual, deopt);
+                masm_.bind(ok);
+            }
+            masm_.bind(compare);
+            masm_.cmp64(RAX, RDX);
+            storeCondition(cond, insn.a);
+            return;
+        }
+
+        guardInt32(RAX, pc);
+        guardInt32(RDX, pc);
+        masm_.cmp32(RAX, RDX);
+        storeCondition(cond, insn.a);
+    }
+
+    void emitConditionalJump(const Instruction& insn, uint32_t pc) {
+        bool jumpWhenTrue = insn.op == Opcode::JumpIfTrue;
+        Assembler::Label taken = masm_.newLabel();
+        Assembler::Label next = masm_.newLabel();
+        Assembler::Label notBoolean = masm_.newLabel();
+
+        masm_.loadSlot(RAX, insn.a);
+        // false -> 0, true -> 1, anything else above 1
+        masm_.move64(RCX, RAX);
+        masm_.xor64(RCX, R14);
+        masm_.cmpImmediate64(RCX, 1);
+        masm_.jumpIf(kAbove, notBoolean);
+        masm_.test32(RCX, RCX);
+        masm_.jumpIf(jumpWhenTrue ? kNotEqual : kEqual, taken);
+        masm_.jump(next);
+
+        masm_.bind(notBoolean);
+        guardInt32(RAX, pc);
+        masm_.test32(RAX, RAX);
+        masm_.jumpIf(jumpWhenTrue ? kNotEqual : kEqual, taken);
+        masm_.jump(next);
+
+        masm_.bind(taken);
+        jumpTo(insn.target(), pc);
+        masm_.bind(next);
+    }
+};
+
+} // namespace
+
+std::shared_ptr<BaselineCode> BaselineCode::compile(const BytecodeFunction& function, const BaselineHelpers& helpers) {
+    BaselineCompiler compiler(function, helpers);
+    if (!compiler.compile()) {
+        return nullptr;
+    }
+
+    const std::vector<uint8_t>& bytes = compiler.bytes();
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = (bytes.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // Written while writable, then flipped to read + execute
+    auto* base = static_cast<uint8_t*>(memory);
+    std::memcpy(base, bytes.data(), bytes.size());
+    for (size_t i = 0; i < compiler.instructionCount(); ++i) {
+        uint64_t offset;
+        std::memcpy(&offset, base + compiler.tableOffset() + i * 8, sizeof(offset));
+        uint64_t address = reinterpret_cast<uint64_t>(base) + offset;
+        std::memcpy(base + compiler.tableOffset() + i * 8, &address, sizeof(address));
+    }
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+    return std::shared_ptr<BaselineCode>(new BaselineCode(memory, size));
+}
+
+BaselineCode::BaselineCode(void* memory, size_t size)
+    : memory_(memory), size_(size), entry_(reinterpret_cast<Entry>(memory)) {
+}
+
+BaselineCode::~BaselineCode() {
+    munmap(memory_, size_);
+}
+
+#else
+
+std::shared_ptr<BaselineCode> BaselineCode::compile(const BytecodeFunction&, const BaselineHelpers&) {
+    return nullptr;
+}
+
+BaselineCode::BaselineCode(void* memory, size_t size) : memory_(memory), size_(size), entry_(nullptr) {
+}
+
+BaselineCode::~BaselineCode() = default;
+
+#endif
+
+} // namespace js
@@ -2,15 +2,38 @@
 #include "js/ast.h"
 #include <algorithm>
 #include <stdexcept>
+#include <unordered_set>
 
 namespace js {
 
+namespace {
+
+// Moves a source mark over text the tokenizer has not produced tokens for
+void advanceMark(SourceMark& mark, std::string_view text) {
+    for (char c : text) {
+        if (c == '\n') {
+            mark.line++;
+            mark.column = 1;
+        } else {
+            mark.column++;
+        }
+    }
+    mark.offset += static_cast<uint32_t>(text.size());
+}
+
+TokenPosition markPosition(const SourceMark& start, const SourceMark& end) {
+    return TokenPosition(SourceLocation(start.line, start.column, start.offset),
+                         SourceLocation(end.line, end.column, end.offset));
+}
+
+} // namespace
+
 // Parser implementation
-Parser::Parser() : source_(), tokenizer_(), tokens_(), position_(0), strictMode_(false), moduleMode_(false) {
+Parser::Parser() : source_(), tokenizer_(), lookahead_(), previous_(), position_(0), strictMode_(false), moduleMode_(false), arenaAllocation_(false), lazyFunctions_(false), preparsedFunctionCount_(0), sharedSource_() {
     initialize();
 }
 
-Parser::Parser(const std::string& source) : source_(source), tokenizer_(source), tokens_(), position_(0), strictMode_(false), moduleMode_(false) {
+Parser::Parser(const std::string& source) : source_(source), tokenizer_(source), lookahead_(), previous_(), position_(0), strictMode_(false), moduleMode_(false), arenaAllocation_(false), lazyFunctions_(false), preparsedFunctionCount_(0), sharedSource_() {
     initialize();
 }
 
@@ -19,6 +42,7 @@ Parser::~Parser() = default;
 void Parser::setSource(const std::string& source) {
     source_ = source;
     tokenizer_.setSource(source);
+    sharedSource_.reset();
     reset();
 }
 
@@ -30,14 +54,21 @@ std::unique_ptr<AST> Parser::parse() {
     }
 }
 
+// With arena allocation every node and child list of the tree comes from
+// one arena that the AST releases in one go. The scope is installed even
+// without an arena so a nested heap parse never borrows an outer one.
 std::unique_ptr<AST> Parser::parseScript() {
+    std::unique_ptr<Arena> arena = arenaAllocation_ ? std::make_unique<Arena>() : nullptr;
+    Arena::Scope scope(arena.get());
     auto program = parseProgram();
-    return std::make_unique<AST>(std::move(program));
+    return std::make_unique<AST>(std::move(program), std::move(arena));
 }
 
 std::unique_ptr<AST> Parser::parseModule() {
+    std::unique_ptr<Arena> arena = arenaAllocation_ ? std::make_unique<Arena>() : nullptr;
+    Arena::Scope scope(arena.get());
     auto module = parseModule();
-    return std::make_unique<AST>(std::move(module));
+    return std::make_unique<AST>(std::move(module), std::move(arena));
 }
 
 std::unique_ptr<AST> Parser::parseExpression() {
@@ -57,7 +88,7 @@ std::unique_ptr<AST> Parser::parseDeclaration() {
 
 std::unique_ptr<Program> Parser::parseProgram() {
     TokenPosition start = getCurrentPosition();
-    std::vector<std::unique_ptr<Statement>> body;
+    NodeList<Statement> body;
     
     while (hasMoreTokens() && !isToken(TokenType::EndOfFile)) {
         if (isToken(TokenType::Semicolon)) {
@@ -74,11 +105,16 @@ std::unique_ptr<Program> Parser::parseProgram() {
 
 std::unique_ptr<Module> Parser::parseModule() {
     TokenPosition start = getCurrentPosition();
-    std::vector<std::unique_ptr<Statement>> body;
+    NodeList<Statement> body;
+    NodeList<Declaration> imports;
     
     while (hasMoreTokens() && !isToken(TokenType::EndOfFile)) {
         if (isToken(TokenType::Semicolon)) {
             advance(); // Skip empty statement
+        } else if (isKeyword("import") && !isStartOfImportExpression()) {
+            imports.push_back(parseImportDeclaration());
+        } else if (isKeyword("export")) {
+            imports.push_back(parseExportDeclaration());
         } else {
             auto statement = parseStatement();
             body.push_back(std::move(statement));
@@ -86,7 +122,15 @@ std::unique_ptr<Module> Parser::parseModule() {
     }
     
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<Module>(std::move(body), TokenPosition(start, end));
+    auto module = std::make_unique<Module>(std::move(body), TokenPosition(start, end));
+    module->setImports(std::move(imports));
+    return module;
+}
+
+// import(...) and import.meta are expressions, not declarations
+bool Parser::isStartOfImportExpression() const {
+    Token next = peekToken();
+    return next.value() == "(" || next.value() == ".";
 }
 
 std::unique_ptr<Statement> Parser::parseStatement() {
@@ -96,7 +140,7 @@ std::unique_ptr<Statement> Parser::parseStatement() {
         return parseBlockStatement();
     } else if (isKeyword("var") || isKeyword("let") || isKeyword("const")) {
         return parseVariableStatement();
-    } else if (isKeyword("function")) {
+    } else if (isKeyword("function") || isAsyncFunction()) {
         return parseFunctionStatement();
     } else if (isKeyword("class")) {
         return parseClassStatement();
@@ -136,7 +180,7 @@ std::unique_ptr<Statement> Parser::parseBlockStatement() {
     TokenPosition start = getCurrentPosition();
     expect(TokenType::LeftBrace);
     
-    std::vector<std::unique_ptr<Statement>> body;
+    NodeList<Statement> body;
     while (!isToken(TokenType::RightBrace) && hasMoreTokens()) {
         if (isToken(TokenType::Semicolon)) {
             advance(); // Skip empty statement
@@ -198,7 +242,7 @@ std::unique_ptr<Statement> Parser::parseSwitchStatement() {
     expect(TokenType::RightParen);
     expect(TokenType::LeftBrace);
     
-    std::vector<std::unique_ptr<CaseClause>> cases;
+    NodeList<CaseClause> cases;
     while (!isToken(TokenType::RightBrace) && hasMoreTokens()) {
         auto caseClause = parseCaseClause();
         cases.push_back(std::move(caseClause));
@@ -570,7 +614,7 @@ std::unique_ptr<Expression> Parser::parseNewExpression() {
     if (isKeyword("new")) {
         advance();
         auto callee = parseNewExpression();
-        std::vector<std::unique_ptr<Expression>> arguments;
+        NodeList<Expression> arguments;
         
         if (isToken(TokenType::LeftParen)) {
             advance();
@@ -593,7 +637,7 @@ std::unique_ptr<Expression> Parser::parseCallExpression() {
     while (isToken(TokenType::LeftParen) || isToken(TokenType::LeftBracket) || isToken(TokenType::Dot)) {
         if (isToken(TokenType::LeftParen)) {
             advance();
-            std::vector<std::unique_ptr<Expression>> arguments;
+            NodeList<Expression> arguments;
             if (!isToken(TokenType::RightParen)) {
                 arguments = parseArguments();
             }
@@ -684,7 +728,7 @@ std::unique_ptr<Expression> Parser::parsePrimaryExpression() {
         return parseIdentifier();
     }
     
-    if (isKeyword("function")) {
+    if (isKeyword("function") || isAsyncFunction()) {
         return parseFunctionExpression();
     }
     
@@ -708,7 +752,7 @@ std::unique_ptr<Expression> Parser::parseArrayExpression() {
     TokenPosition start = getCurrentPosition();
     expect(TokenType::LeftBracket);
     
-    std::vector<std::unique_ptr<Element>> elements;
+    NodeList<Element> elements;
     while (!isToken(TokenType::RightBracket) && hasMoreTokens()) {
         if (isToken(TokenType::Comma)) {
             advance(); // Skip empty element
@@ -731,7 +775,7 @@ std::unique_ptr<Expression> Parser::parseObjectExpression() {
     TokenPosition start = getCurrentPosition();
     expect(TokenType::LeftBrace);
     
-    std::vector<std::unique_ptr<Property>> properties;
+    NodeList<Property> properties;
     while (!isToken(TokenType::RightBrace) && hasMoreTokens()) {
         if (isToken(TokenType::Comma)) {
             advance(); // Skip empty property
@@ -752,7 +796,11 @@ std::unique_ptr<Expression> Parser::parseObjectExpression() {
 
 std::unique_ptr<Expression> Parser::parseFunctionExpression() {
     TokenPosition start = getCurrentPosition();
+    // "(function" is usually an IIFE, which would be parsed again at once
+    bool parenthesized = previous_.type() == TokenType::LeftParen;
+    bool isAsync = optionalKeyword("async");
     expectKeyword("function");
+    bool isGenerator = optionalOperator("*");
     
     std::unique_ptr<Identifier> id = nullptr;
     if (isToken(TokenType::Identifier)) {
@@ -762,16 +810,26 @@ std::unique_ptr<Expression> Parser::parseFunctionExpression() {
     expect(TokenType::LeftParen);
     auto params = parseParameters();
     expect(TokenType::RightParen);
-    auto body = parseBlockStatement();
-    
-    TokenPosition end = getCurrentPosition();
-    return std::make_unique<FunctionExpression>(std::move(id), std::move(params), std::move(body), TokenPosition(start, end));
+    std::unique_ptr<FunctionExpression> function;
+    if (lazyFunctions_ && !parenthesized) {
+        auto preparse = preparseFunctionBody(start.start.offset, params);
+        TokenPosition end = getCurrentPosition();
+        function = std::make_unique<FunctionExpression>(std::move(id), std::move(params), nullptr, TokenPosition(start, end));
+        function->setPreparse(std::move(preparse));
+    } else {
+        auto body = parseBlockStatement();
+        TokenPosition end = getCurrentPosition();
+        function = std::make_unique<FunctionExpression>(std::move(id), std::move(params), std::move(body), TokenPosition(start, end));
+    }
+    function->setGenerator(isGenerator);
+    function->setAsync(isAsync);
+    return function;
 }
 
 std::unique_ptr<Expression> Parser::parseArrowFunctionExpression() {
     TokenPosition start = getCurrentPosition();
     
-    std::vector<std::unique_ptr<Parameter>> params;
+    NodeList<Parameter> params;
     if (isToken(TokenType::LeftParen)) {
         advance();
         if (!isToken(TokenType::RightParen)) {
@@ -810,15 +868,50 @@ std::unique_ptr<Expression> Parser::parseClassExpression() {
     return std::make_unique<ClassExpression>(std::move(id), std::move(superClass), std::move(body), TokenPosition(start, end));
 }
 
+// The token holds the raw text between the backticks. Text spans are
+// cooked here; each substitution is parsed by pointing the tokenizer at it,
+// and tokenizing resumes after the closing backtick once all are done.
 std::unique_ptr<Expression> Parser::parseTemplateLiteral() {
     TokenPosition start = getCurrentPosition();
-    expect(TokenType::TemplateLiteral);
+    Token token = expect(TokenType::TemplateLiteral);
+    std::string_view raw = token.value();
     
-    std::vector<std::unique_ptr<TemplateElement>> quasis;
-    std::vector<std::unique_ptr<Expression>> expressions;
+    NodeList<TemplateElement> quasis;
+    NodeList<Expression> expressions;
     
-    // This is a simplified implementation
-    // In a real implementation, we would parse template elements and expressions
+    SourceMark cursor = token.start();
+    advanceMark(cursor, "`");
+    size_t spanStart = 0;
+    while (true) {
+        size_t spanEnd = spanStart;
+        while (spanEnd < raw.size() && !(raw[spanEnd] == '$' && spanEnd + 1 < raw.size() && raw[spanEnd + 1] == '{')) {
+            spanEnd += raw[spanEnd] == '\\' ? 2 : 1;
+        }
+        spanEnd = std::min(spanEnd, raw.size());
+        
+        std::string_view span = raw.substr(spanStart, spanEnd - spanStart);
+        SourceMark spanMark = cursor;
+        advanceMark(cursor, span);
+        auto element = std::make_unique<TemplateElement>(markPosition(spanMark, cursor));
+        element->setCooked(Tokenizer::cookTemplateSpan(span));
+        quasis.push_back(std::move(element));
+        if (spanEnd == raw.size()) {
+            break;
+        }
+        
+        advanceMark(cursor, "${");
+        size_t close = Tokenizer::scanTemplateSubstitution(raw, spanEnd + 2);
+        lookahead_.clear();
+        tokenizer_.setMark(cursor);
+        expressions.push_back(parseExpression());
+        if (!isToken(TokenType::RightBrace)) {
+            error("Expected '}' after template substitution");
+        }
+        advanceMark(cursor, raw.substr(spanEnd + 2, close - spanEnd - 2));
+        spanStart = close;
+    }
+    lookahead_.clear();
+    tokenizer_.setMark(token.end());
     
     TokenPosition end = getCurrentPosition();
     return std::make_unique<TemplateLiteral>(std::move(quasis), std::move(expressions), TokenPosition(start, end));
@@ -835,7 +928,7 @@ std::unique_ptr<Expression> Parser::parseTaggedTemplateExpression() {
 
 std::unique_ptr<Expression> Parser::parseSequenceExpression() {
     TokenPosition start = getCurrentPosition();
-    std::vector<std::unique_ptr<Expression>> expressions;
+    NodeList<Expression> expressions;
     
     auto expression = parseExpression();
     expressions.push_back(std::move(expression));
@@ -853,7 +946,7 @@ std::unique_ptr<Expression> Parser::parseSequenceExpression() {
 std::unique_ptr<Declaration> Parser::parseDeclaration() {
     if (isKeyword("var") || isKeyword("let") || isKeyword("const")) {
         return parseVariableDeclaration();
-    } else if (isKeyword("function")) {
+    } else if (isKeyword("function") || isAsyncFunction()) {
         return parseFunctionDeclaration();
     } else if (isKeyword("class")) {
         return parseClassDeclaration();
@@ -869,10 +962,10 @@ std::unique_ptr<Declaration> Parser::parseDeclaration() {
 
 std::unique_ptr<Declaration> Parser::parseVariableDeclaration() {
     TokenPosition start = getCurrentPosition();
-    std::string kind = currentToken().value();
+    std::string kind(currentToken().value());
     advance();
     
-    std::vector<std::unique_ptr<VariableDeclarator>> declarations;
+    NodeList<VariableDeclarator> declarations;
     do {
         auto declarator = parseVariableDeclarator();
         declarations.push_back(std::move(declarator));
@@ -888,15 +981,27 @@ std::unique_ptr<Declaration> Parser::parseVariableDeclaration() {
 
 std::unique_ptr<Declaration> Parser::parseFunctionDeclaration() {
     TokenPosition start = getCurrentPosition();
+    bool isAsync = optionalKeyword("async");
     expectKeyword("function");
+    bool isGenerator = optionalOperator("*");
     auto id = parseIdentifier();
     expect(TokenType::LeftParen);
     auto params = parseParameters();
     expect(TokenType::RightParen);
-    auto body = parseBlockStatement();
-    
-    TokenPosition end = getCurrentPosition();
-    return std::make_unique<FunctionDeclaration>(std::move(id), std::move(params), std::move(body), TokenPosition(start, end));
+    std::unique_ptr<FunctionDeclaration> function;
+    if (lazyFunctions_) {
+        auto preparse = preparseFunctionBody(start.start.offset, params);
+        TokenPosition end = getCurrentPosition();
+        function = std::make_unique<FunctionDeclaration>(std::move(id), std::move(params), nullptr, TokenPosition(start, end));
+        function->setPreparse(std::move(preparse));
+    } else {
+        auto body = parseBlockStatement();
+        TokenPosition end = getCurrentPosition();
+        function = std::make_unique<FunctionDeclaration>(std::move(id), std::move(params), std::move(body), TokenPosition(start, end));
+    }
+    function->setGenerator(isGenerator);
+    function->setAsync(isAsync);
+    return function;
 }
 
 std::unique_ptr<Declaration> Parser::parseClassDeclaration() {
@@ -919,7 +1024,13 @@ std::unique_ptr<Declaration> Parser::parseImportDeclaration() {
     TokenPosition start = getCurrentPosition();
     expectKeyword("import");
     
-    std::vector<std::unique_ptr<ImportSpecifier>> specifiers;
+    NodeList<ImportSpecifier> specifiers;
+    if (isToken(TokenType::StringLiteral)) {
+        // import "specifier", for its side effects
+        auto source = parseStringLiteral();
+        TokenPosition end = getCurrentPosition();
+        return std::make_unique<ImportDeclaration>(std::move(specifiers), std::move(source), TokenPosition(start, end));
+    }
     if (isToken(TokenType::LeftBrace)) {
         advance();
         if (!isToken(TokenType::RightBrace)) {
@@ -939,7 +1050,7 @@ std::unique_ptr<Declaration> Parser::parseExportDeclaration() {
     TokenPosition start = getCurrentPosition();
     expectKeyword("export");
     
-    std::vector<std::unique_ptr<ExportSpecifier>> specifiers;
+    NodeList<ExportSpecifier> specifiers;
     if (isToken(TokenType::LeftBrace)) {
         advance();
         if (!isToken(TokenType::RightBrace)) {
@@ -959,28 +1070,28 @@ std::unique_ptr<Identifier> Parser::parseIdentifier() {
     TokenPosition start = getCurrentPosition();
     auto token = expect(TokenType::Identifier);
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<Identifier>(token.value(), TokenPosition(start, end));
+    return std::make_unique<Identifier>(std::string(token.value()), TokenPosition(start, end));
 }
 
 std::unique_ptr<Literal> Parser::parseStringLiteral() {
     TokenPosition start = getCurrentPosition();
     auto token = expect(TokenType::StringLiteral);
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<StringLiteral>(token.value(), TokenPosition(start, end));
+    return std::make_unique<StringLiteral>(std::string(token.value()), TokenPosition(start, end));
 }
 
 std::unique_ptr<Literal> Parser::parseNumericLiteral() {
     TokenPosition start = getCurrentPosition();
     auto token = expect(TokenType::NumberLiteral);
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<NumericLiteral>(token.value(), TokenPosition(start, end));
+    return std::make_unique<NumericLiteral>(std::string(token.value()), TokenPosition(start, end));
 }
 
 std::unique_ptr<Literal> Parser::parseBooleanLiteral() {
     TokenPosition start = getCurrentPosition();
     auto token = expect(TokenType::BooleanLiteral);
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<BooleanLiteral>(token.value(), TokenPosition(start, end));
+    return std::make_unique<BooleanLiteral>(std::string(token.value()), TokenPosition(start, end));
 }
 
 std::unique_ptr<Literal> Parser::parseNullLiteral() {
@@ -1001,43 +1112,58 @@ std::unique_ptr<Literal> Parser::parseRegExpLiteral() {
     TokenPosition start = getCurrentPosition();
     auto token = expect(TokenType::RegExpLiteral);
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<RegExpLiteral>(token.value(), TokenPosition(start, end));
+    return std::make_unique<RegExpLiteral>(std::string(token.value()), TokenPosition(start, end));
 }
 
 std::unique_ptr<Literal> Parser::parseBigIntLiteral() {
     TokenPosition start = getCurrentPosition();
     auto token = expect(TokenType::BigIntLiteral);
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<BigIntLiteral>(token.value(), TokenPosition(start, end));
+    return std::make_unique<BigIntLiteral>(std::string(token.value()), TokenPosition(start, end));
 }
 
 std::unique_ptr<YieldExpression> Parser::parseYieldExpression() {
     TokenPosition start = getCurrentPosition();
     expectKeyword("yield");
+    bool delegate = optionalOperator("*");
     
     std::unique_ptr<Expression> argument = nullptr;
-    if (!isToken(TokenType::Semicolon) && !isToken(TokenType::EndOfFile)) {
-        argument = parseExpression();
+    if (!isToken(TokenType::Semicolon) && !isToken(TokenType::EndOfFile) && !isToken(TokenType::RightParen) &&
+        !isToken(TokenType::RightBracket) && !isToken(TokenType::RightBrace) && !isToken(TokenType::Comma)) {
+        argument = parseAssignmentExpression();
     }
     
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<YieldExpression>(std::move(argument), TokenPosition(start, end));
+    return std::make_unique<YieldExpression>(std::move(argument), delegate, TokenPosition(start, end));
 }
 
 std::unique_ptr<AwaitExpression> Parser::parseAwaitExpression() {
     TokenPosition start = getCurrentPosition();
     expectKeyword("await");
-    auto argument = parseExpression();
+    auto argument = parseUnaryExpression();
     
     TokenPosition end = getCurrentPosition();
     return std::make_unique<AwaitExpression>(std::move(argument), TokenPosition(start, end));
 }
 
-Token Parser::currentToken() const {
-    if (position_ < tokens_.size()) {
-        return tokens_[position_];
+// Tokens are pulled from the tokenizer on demand; lookahead_ holds the
+// current token followed by any that have been peeked at.
+void Parser::fill(size_t count) const {
+    while (lookahead_.size() < count) {
+        if (!lookahead_.empty() && lookahead_.back().isEndOfFile()) {
+            lookahead_.push_back(lookahead_.back());
+            continue;
+        }
+        Token token = tokenizer_.nextToken();
+        if (!token.isComment()) {
+            lookahead_.push_back(token);
+        }
     }
-    return Token(TokenType::EndOfFile, "", TokenPosition());
+}
+
+Token Parser::currentToken() const {
+    fill(1);
+    return lookahead_.front();
 }
 
 Token Parser::peekToken() const {
@@ -1045,26 +1171,31 @@ Token Parser::peekToken() const {
 }
 
 Token Parser::peekToken(size_t offset) const {
-    if (position_ + offset < tokens_.size()) {
-        return tokens_[position_ + offset];
-    }
-    return Token(TokenType::EndOfFile, "", TokenPosition());
+    fill(offset + 1);
+    return lookahead_[offset];
 }
 
 void Parser::advance() {
-    if (position_ < tokens_.size()) {
-        position_++;
+    fill(1);
+    if (lookahead_.front().isEndOfFile()) {
+        return;
     }
+    previous_ = lookahead_.front();
+    lookahead_.pop_front();
+    position_++;
 }
 
+// Only the most recently consumed token can be pushed back
 void Parser::retreat() {
-    if (position_ > 0) {
+    if (position_ > 0 && previous_.isValid()) {
+        lookahead_.push_front(previous_);
+        previous_ = Token();
         position_--;
     }
 }
 
 bool Parser::hasMoreTokens() const {
-    return position_ < tokens_.size();
+    return !currentToken().isEndOfFile();
 }
 
 bool Parser::isToken(TokenType type) const {
@@ -1087,6 +1218,14 @@ bool Parser::isOperator(const std::string& op) const {
     return currentToken().type() == TokenType::ArithmeticOperator && currentToken().value() == op;
 }
 
+bool Parser::isAsyncFunction() const {
+    if (!isKeyword("async")) {
+        return false;
+    }
+    Token next = peekToken();
+    return next.type() == TokenType::Keyword && next.value() == "function";
+}
+
 bool Parser::isPunctuation(const std::string& punct) const {
     return currentToken().type() == TokenType::LeftParen && currentToken().value() == punct;
 }
@@ -1231,7 +1370,9 @@ void Parser::warning(const std::string& message, const Token& token) {
 
 void Parser::reset() {
     position_ = 0;
-    tokens_ = tokenizer_.tokenize();
+    tokenizer_.reset();
+    lookahead_.clear();
+    previous_ = Token();
     errors_.clear();
     warnings_.clear();
 }
@@ -1356,7 +1497,7 @@ bool Parser::isUpdateOperator(const Token& token) const {
            (token.value() == "++" || token.value() == "--");
 }
 
-OperatorType Parser::getOperatorType(const std::string& op) const {
+OperatorType Parser::getOperatorType(std::string_view op) const {
     // This is a simplified implementation
     // In a real implementation, we would map all operators to their types
     if (op == "+") return OperatorType::Add;
@@ -1378,6 +1519,35 @@ OperatorType Parser::getOperatorType(const std::string& op) const {
     if (op == "!") return OperatorType::LogicalNot;
     if (op == "++") return OperatorType::Increment;
     if (op == "--") return OperatorType::Decrement;
+    if (op == "**") return OperatorType::Exponent;
+    if (op == "&") return OperatorType::BitwiseAnd;
+    if (op == "|") return OperatorType::BitwiseOr;
+    if (op == "^") return OperatorType::BitwiseXor;
+    if (op == "~") return OperatorType::BitwiseNot;
+    if (op == "<<") return OperatorType::LeftShift;
+    if (op == ">>") return OperatorType::RightShift;
+    if (op == ">>>") return OperatorType::UnsignedRightShift;
+    if (op == "??") return OperatorType::NullishCoalescing;
+    if (op == "+=") return OperatorType::AddAssign;
+    if (op == "-=") return OperatorType::SubtractAssign;
+    if (op == "*=") return OperatorType::MultiplyAssign;
+    if (op == "/=") return OperatorType::DivideAssign;
+    if (op == "%=") return OperatorType::ModuloAssign;
+    if (op == "**=") return OperatorType::ExponentAssign;
+    if (op == "<<=") return OperatorType::LeftShiftAssign;
+    if (op == ">>=") return OperatorType::RightShiftAssign;
+    if (op == ">>>=") return OperatorType::UnsignedRightShiftAssign;
+    if (op == "&=") return OperatorType::BitwiseAndAssign;
+    if (op == "^=") return OperatorType::BitwiseXorAssign;
+    if (op == "|=") return OperatorType::BitwiseOrAssign;
+    if (op == "&&=") return OperatorType::LogicalAndAssign;
+    if (op == "||=") return OperatorType::LogicalOrAssign;
+    if (op == "??=") return OperatorType::NullishAssign;
+    if (op == "typeof") return OperatorType::TypeOf;
+    if (op == "void") return OperatorType::Void;
+    if (op == "delete") return OperatorType::Delete;
+    if (op == "instanceof") return OperatorType::InstanceOf;
+    if (op == "in") return OperatorType::In;
     return OperatorType::Add; // Default fallback
 }
 
@@ -1396,8 +1566,8 @@ void Parser::insertAutomaticSemicolon() {
     // In a real implementation, we would insert a semicolon token
 }
 
-std::vector<std::unique_ptr<Expression>> Parser::parseArguments() {
-    std::vector<std::unique_ptr<Expression>> arguments;
+NodeList<Expression> Parser::parseArguments() {
+    NodeList<Expression> arguments;
     
     auto argument = parseExpression();
     arguments.push_back(std::move(argument));
@@ -1411,8 +1581,8 @@ std::vector<std::unique_ptr<Expression>> Parser::parseArguments() {
     return arguments;
 }
 
-std::vector<std::unique_ptr<Parameter>> Parser::parseParameters() {
-    std::vector<std::unique_ptr<Parameter>> parameters;
+NodeList<Parameter> Parser::parseParameters() {
+    NodeList<Parameter> parameters;
     
     if (isToken(TokenType::Identifier)) {
         auto parameter = parseParameter();
@@ -1432,11 +1602,103 @@ std::unique_ptr<Parameter> Parser::parseParameter() {
     TokenPosition start = getCurrentPosition();
     auto identifier = parseIdentifier();
     TokenPosition end = getCurrentPosition();
-    return std::make_unique<auto>(std::move(identifier), TokenPosition(start, end));
+    return std::make_unique<Parameter>(std::move(identifier), TokenPosition(start, end));
+}
+
+// Pre-parsing only checks that brackets balance and notes the identifiers
+// and constructs that matter to the enclosing scope; the grammar itself is
+// checked when the body is parsed for real.
+std::unique_ptr<PreparseData> Parser::preparseFunctionBody(size_t functionStart, const NodeList<Parameter>& params) {
+    if (!sharedSource_) {
+        sharedSource_ = std::make_shared<const std::string>(tokenizer_.source());
+    }
+    auto data = std::make_unique<PreparseData>();
+    data->source = sharedSource_;
+    data->sourceStart = functionStart;
+
+    AtomTable& atoms = tokenizer_.atoms();
+    std::unordered_set<Atom> declared;
+    std::unordered_set<Atom> seen;
+    std::vector<Atom> referenced;
+    for (const auto& param : params) {
+        if (param->name()) {
+            declared.insert(atoms.intern(param->name()->name()));
+        }
+    }
+
+    expect(TokenType::LeftBrace);
+    std::vector<TokenType> closers{TokenType::RightBrace};
+    Token previous = previous_;
+    while (!closers.empty()) {
+        Token token = currentToken();
+        if (token.isEndOfFile()) {
+            error("Unterminated function body", token);
+            break;
+        }
+        advance();
+
+        switch (token.type()) {
+            case TokenType::LeftBrace: closers.push_back(TokenType::RightBrace); break;
+            case TokenType::LeftParen: closers.push_back(TokenType::RightParen); break;
+            case TokenType::LeftBracket: closers.push_back(TokenType::RightBracket); break;
+            case TokenType::RightBrace:
+            case TokenType::RightParen:
+            case TokenType::RightBracket:
+                if (token.type() != closers.back()) {
+                    error("Unexpected token: " + token.toString(), token);
+                }
+                closers.pop_back();
+                break;
+            case TokenType::Identifier: {
+                bool declaration = previous.type() == TokenType::Keyword &&
+                                   (previous.value() == "var" || previous.value() == "let" || previous.value() == "const" ||
+                                    previous.value() == "function" || previous.value() == "class");
+                if (declaration) {
+                    declared.insert(token.atom());
+                } else if (previous.type() != TokenType::Dot && seen.insert(token.atom()).second) {
+                    referenced.push_back(token.atom());
+                }
+                break;
+            }
+            case TokenType::Keyword:
+                if (token.value() == "this") {
+                    data->usesThis = true;
+                } else if (token.value() == "with") {
+                    data->usesWith = true;
+                } else if (token.value() == "function") {
+                    data->hasInnerFunctions = true;
+                }
+                break;
+            case TokenType::ReservedWord:
+                if (token.value() == "eval") {
+                    data->usesEval = true;
+                } else if (token.value() == "arguments") {
+                    data->usesArguments = true;
+                }
+                break;
+            case TokenType::ArithmeticOperator:
+                if (token.value() == "=>") {
+                    data->hasInnerFunctions = true;
+                }
+                break;
+            default:
+                break;
+        }
+        previous = token;
+    }
+    data->sourceEnd = previous_.end().offset;
+
+    for (Atom atom : referenced) {
+        if (!declared.count(atom)) {
+            data->freeVariables.emplace_back(atoms.name(atom));
+        }
+    }
+    ++preparsedFunctionCount_;
+    return data;
 }
 
-std::vector<std::unique_ptr<ImportSpecifier>> Parser::parseImportSpecifiers() {
-    std::vector<std::unique_ptr<ImportSpecifier>> specifiers;
+NodeList<ImportSpecifier> Parser::parseImportSpecifiers() {
+    NodeList<ImportSpecifier> specifiers;
     
     auto specifier = parseImportSpecifier();
     specifiers.push_back(std::move(specifier));
@@ -1465,8 +1727,8 @@ std::unique_ptr<ImportSpecifier> Parser::parseImportSpecifier() {
     return std::make_unique<ImportSpecifier>(std::move(imported), std::move(local), TokenPosition(start, end));
 }
 
-std::vector<std::unique_ptr<ExportSpecifier>> Parser::parseExportSpecifiers() {
-    std::vector<std::unique_ptr<ExportSpecifier>> specifiers;
+NodeList<ExportSpecifier> Parser::parseExportSpecifiers() {
+    NodeList<ExportSpecifier> specifiers;
     
     auto specifier = parseExportSpecifier();
     specifiers.push_back(std::move(specifier));
@@ -1503,7 +1765,7 @@ std::unique_ptr<CaseClause> Parser::parseCaseClause() {
         auto test = parseExpression();
         expect(TokenType::Colon);
         
-        std::vector<std::unique_ptr<Statement>> consequent;
+        NodeList<Statement> consequent;
         while (!isKeyword("case") && !isKeyword("default") && !isToken(TokenType::RightBrace) && hasMoreTokens()) {
             auto statement = parseStatement();
             consequent.push_back(std::move(statement));
@@ -1515,7 +1777,7 @@ std::unique_ptr<CaseClause> Parser::parseCaseClause() {
         advance();
         expect(TokenType::Colon);
         
-        std::vector<std::unique_ptr<Statement>> consequent;
+        NodeList<Statement> consequent;
         while (!isKeyword("case") && !isKeyword("default") && !isToken(TokenType::RightBrace) && hasMoreTokens()) {
             auto statement = parseStatement();
             consequent.push_back(std::move(statement));
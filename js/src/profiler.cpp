@@ -0,0 +1,178 @@
+#include "js/profiler.h"
+#include "apollo/json_string.h"
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+namespace js {
+
+Profiler::Profiler()
+    : frames_(), frameIndex_(), samples_(), interval_(kDefaultInterval), startTime_(), timeOffset_(0),
+      running_(false), sampleRequested_(false), sampler_(), mutex_(), wake_(), stopRequested_(false) {
+}
+
+Profiler::~Profiler() {
+    stopProfiling();
+}
+
+// Lifecycle
+
+void Profiler::startProfiling() {
+    if (running_) {
+        return;
+    }
+
+    // A restarted profile continues after the last sample so timestamps
+    // stay monotonic across sessions
+    timeOffset_ = samples_.empty() ? 0 : samples_.back().timestamp + static_cast<uint64_t>(interval_.count());
+    startTime_ = std::chrono::steady_clock::now();
+    stopRequested_ = false;
+    running_ = true;
+    sampler_ = std::thread(&Profiler::samplerLoop, this);
+}
+
+void Profiler::stopProfiling() {
+    if (!running_) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    wake_.notify_all();
+    sampler_.join();
+    sampleRequested_.store(false, std::memory_order_relaxed);
+    running_ = false;
+}
+
+void Profiler::setSamplingInterval(std::chrono::microseconds interval) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interval_ = std::max(interval, std::chrono::microseconds(1));
+}
+
+void Profiler::samplerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopRequested_) {
+        wake_.wait_for(lock, interval_, [this] { return stopRequested_; });
+        if (!stopRequested_) {
+            sampleRequested_.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Recording
+
+std::vector<uint32_t>& Profiler::beginSample() {
+    sampleRequested_.store(false, std::memory_order_relaxed);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime_);
+    samples_.push_back(Sample{timeOffset_ + static_cast<uint64_t>(elapsed.count()), {}});
+    return samples_.back().stack;
+}
+
+uint32_t Profiler::internFrame(const std::string& function, const TokenPosition& position) {
+    FrameKey key{function, position.start.line, position.start.column};
+    auto it = frameIndex_.find(key);
+    if (it != frameIndex_.end()) {
+        return it->second;
+    }
+
+    uint32_t id = static_cast<uint32_t>(frames_.size());
+    frames_.push_back(Frame{function, position});
+    frameIndex_.emplace(std::move(key), id);
+    return id;
+}
+
+void Profiler::clear() {
+    frames_.clear();
+    frameIndex_.clear();
+    samples_.clear();
+    timeOffset_ = 0;
+    startTime_ = std::chrono::steady_clock::now();
+}
+
+// Export
+
+std::string Profiler::frameLabel(uint32_t frame) const {
+    const Frame& entry = frames_[frame];
+    std::string label = entry.function.empty() ? "(anonymous)" : entry.function;
+    // ';' separates frames in collapsed stacks
+    std::replace(label.begin(), label.end(), ';', ':');
+    return label + " (" + std::to_string(entry.position.start.line) + ":" +
+           std::to_string(entry.position.start.column) + ")";
+}
+
+std::string Profiler::exportCollapsedStacks() const {
+    std::map<std::vector<uint32_t>, size_t> counts;
+    for (const Sample& sample : samples_) {
+        if (!sample.stack.empty()) {
+            ++counts[sample.stack];
+        }
+    }
+
+    std::ostringstream out;
+    for (const auto& entry : counts) {
+        for (size_t i = 0; i < entry.first.size(); ++i) {
+            if (i > 0) {
+                out << ';';
+            }
+            out << frameLabel(entry.first[i]);
+        }
+        out << ' ' << entry.second << '\n';
+    }
+    return out.str();
+}
+
+// Consecutive samples are diffed into begin/end events: frames that stay
+// on the stack become one slice spanning all the samples that saw them.
+std::string Profiler::exportChromeTrace() const {
+    std::ostringstream out;
+    bool first = true;
+    auto event = [&](char phase, uint32_t frame, uint64_t timestamp) {
+        out << (first ? "\n" : ",\n") << "{\"name\":";
+        first = false;
+        apollo::appendJsonString(out, frameLabel(frame));
+        out << ",\"cat\":\"js\",\"ph\":\"" << phase << "\",\"ts\":" << timestamp << ",\"pid\":1,\"tid\":1";
+        if (phase == 'B') {
+            const Frame& entry = frames_[frame];
+            out << ",\"args\":{\"function\":";
+            apollo::appendJsonString(out, entry.function);
+            out << ",\"line\":" << entry.position.start.line << ",\"column\":" << entry.position.start.column
+                << "}";
+        }
+        out << "}";
+    };
+
+    out << "{\"traceEvents\":[";
+    out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"JavaScript\"}}";
+    first = false;
+
+    const std::vector<uint32_t>* open = nullptr;
+    static const std::vector<uint32_t> empty;
+    for (const Sample& sample : samples_) {
+        const std::vector<uint32_t>& previous = open ? *open : empty;
+        size_t common = 0;
+        while (common < previous.size() && common < sample.stack.size() &&
+               previous[common] == sample.stack[common]) {
+            ++common;
+        }
+        for (size_t i = previous.size(); i > common; --i) {
+            event('E', previous[i - 1], sample.timestamp);
+        }
+        for (size_t i = common; i < sample.stack.size(); ++i) {
+            event('B', sample.stack[i], sample.timestamp);
+        }
+        open = &sample.stack;
+    }
+    if (open) {
+        uint64_t end = samples_.back().timestamp + static_cast<uint64_t>(interval_.count());
+        for (size_t i = open->size(); i > 0; --i) {
+            event('E', (*open)[i - 1], end);
+        }
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out.str();
+}
+
+} // namespace js
@@ -0,0 +1,44 @@
+#include "js/read_only_heap.h"
+#include "js/value.h"
+
+namespace js {
+
+ReadOnlyHeap::ReadOnlyHeap() : strings_(), index_(), bytes_(0) {
+}
+
+ReadOnlyHeap::~ReadOnlyHeap() = default;
+
+std::shared_ptr<const ReadOnlyHeap> ReadOnlyHeap::create(const std::vector<std::string>& strings) {
+    std::shared_ptr<ReadOnlyHeap> heap(new ReadOnlyHeap());
+    heap->strings_.reserve(strings.size());
+    for (const std::string& text : strings) {
+        if (heap->index_.count(text)) {
+            continue;
+        }
+        auto cell = std::make_unique<String>(text);
+        // Fill the caches now; readers on other threads must not
+        cell->hash();
+        const std::string& utf8 = cell->value();
+        cell->setGCFlags(GCFlagReadOnly | GCFlagOld | GCFlagPinned);
+
+        heap->bytes_ += sizeof(String) + utf8.size();
+        heap->index_.emplace(std::string_view(utf8), JSValue::string(cell.get()));
+        heap->strings_.push_back(std::move(cell));
+    }
+    return heap;
+}
+
+JSValue ReadOnlyHeap::findString(std::string_view text) const {
+    auto it = index_.find(text);
+    return it != index_.end() ? it->second : JSValue::empty();
+}
+
+bool ReadOnlyHeap::contains(const Value* cell) const {
+    if (!cell || !(cell->gcFlags() & GCFlagReadOnly) || !cell->isString()) {
+        return false;
+    }
+    JSValue found = findString(static_cast<const String*>(cell)->value());
+    return !found.isEmpty() && found.asCell() == cell;
+}
+
+} // namespace js
@@ -0,0 +1,142 @@
+#include "js/script_compiler.h"
+#include "js/parser.h"
+#include "js/compiler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace js {
+
+ScriptCompiler::ScriptCompiler(size_t threadCount)
+    : threadCount_(threadCount), workers_(), jobs_(), mutex_(), wake_(), stopRequested_(false), completed_(0) {
+    if (threadCount_ == 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        threadCount_ = std::max<size_t>(1, hardware > 1 ? hardware - 1 : 1);
+    }
+}
+
+ScriptCompiler::~ScriptCompiler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+        jobs_.clear();
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+// Jobs
+
+std::future<CompiledScript> ScriptCompiler::compile(std::string source, bool bytecode) {
+    return submit([source = std::move(source), bytecode]() mutable {
+        return compileNow(std::move(source), bytecode);
+    });
+}
+
+std::future<CompiledScript> ScriptCompiler::submit(std::function<CompiledScript()> work) {
+    std::packaged_task<CompiledScript()> job(std::move(work));
+    std::future<CompiledScript> result = job.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+        // Threads start on demand, one per job until the pool is full
+        if (workers_.size() < threadCount_) {
+            workers_.emplace_back(&ScriptCompiler::workerLoop, this);
+        }
+    }
+    wake_.notify_one();
+    return result;
+}
+
+CompiledScript ScriptCompiler::compileNow(std::string source, bool bytecode) {
+    return compileSource(std::move(source), bytecode, false);
+}
+
+CompiledScript ScriptCompiler::compileModuleNow(std::string source, bool bytecode) {
+    return compileSource(std::move(source), bytecode, true);
+}
+
+// Same steps as JavaScriptEngine::execute(source): an arena-allocated tree
+// with lazily compiled function bodies, and the AST kept only when the
+// bytecode tier cannot take the script
+CompiledScript ScriptCompiler::compileSource(std::string source, bool bytecode, bool module) {
+    auto start = std::chrono::steady_clock::now();
+
+    CompiledScript script;
+    Parser parser(source);
+    parser.setArenaAllocation(true);
+    parser.setLazyFunctions(true);
+    parser.setModuleMode(module);
+    script.ast = parser.parse();
+    if (module && script.ast) {
+        if (auto* root = dynamic_cast<Module*>(script.ast->root())) {
+            script.moduleRequests = moduleRequests(*root);
+        }
+    }
+
+    if (bytecode && script.ast && script.ast->root()) {
+        Compiler compiler;
+        try {
+            Node* root = script.ast->root();
+            if (auto* program = dynamic_cast<Program*>(root)) {
+                script.function = compiler.compile(program);
+            } else if (auto* module = dynamic_cast<Module*>(root)) {
+                script.function = compiler.compile(module);
+            }
+        } catch (const CompileError&) {
+            script.bytecodeFallback = true;
+        }
+        if (script.function) {
+            script.ast.reset();
+        }
+    }
+
+    script.source = std::move(source);
+    script.compileTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return script;
+}
+
+size_t ScriptCompiler::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.size();
+}
+
+std::vector<std::string> moduleRequests(const Module& module) {
+    std::vector<std::string> requests;
+    for (const auto& declaration : module.imports()) {
+        Literal* from = nullptr;
+        if (auto* import = dynamic_cast<ImportDeclaration*>(declaration.get())) {
+            from = import->source();
+        } else if (auto* reexport = dynamic_cast<ExportDeclaration*>(declaration.get())) {
+            from = reexport->source();
+        }
+        if (auto* specifier = dynamic_cast<StringLiteral*>(from)) {
+            requests.push_back(specifier->value());
+        }
+    }
+    return requests;
+}
+
+// Workers
+
+void ScriptCompiler::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return stopRequested_ || !jobs_.empty(); });
+        if (stopRequested_) {
+            return;
+        }
+
+        std::packaged_task<CompiledScript()> job = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+        // Exceptions from the parser end up in the job's future
+        job();
+        completed_.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+    }
+}
+
+} // namespace js
@@ -0,0 +1,117 @@
+#include "js/shape.h"
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+namespace js {
+
+namespace {
+
+// Chains up to this length are searched linearly
+constexpr uint32_t kLinearLookupLimit = 8;
+
+std::atomic<size_t> shapeCount{0};
+
+// Guards the transition tables of every Shape
+std::shared_mutex transitionMutex;
+
+} // namespace
+
+Shape::Shape(Shape* parent, std::string key, uint32_t slotCount)
+    : parent_(parent), key_(std::move(key)), slotCount_(slotCount), transitions_(), table_(nullptr) {
+    ++shapeCount;
+}
+
+Shape::~Shape() {
+    delete table_.load(std::memory_order_relaxed);
+}
+
+Shape* Shape::root() {
+    static Shape* rootShape = new Shape(nullptr, std::string(), 0);
+    return rootShape;
+}
+
+uint32_t Shape::lookup(const std::string& name) const {
+    if (slotCount_ <= kLinearLookupLimit) {
+        for (const Shape* shape = this; shape->parent_; shape = shape->parent_) {
+            if (shape->key_ == name) {
+                return shape->slotCount_ - 1;
+            }
+        }
+        return kNotFound;
+    }
+
+    const std::unordered_map<std::string, uint32_t>* table = table_.load(std::memory_order_acquire);
+    if (!table) {
+        auto built = new std::unordered_map<std::string, uint32_t>();
+        built->reserve(slotCount_);
+        for (const Shape* shape = this; shape->parent_; shape = shape->parent_) {
+            built->emplace(shape->key_, shape->slotCount_ - 1);
+        }
+        // Another thread may have got there first; its table is the same
+        if (table_.compare_exchange_strong(table, built, std::memory_order_acq_rel)) {
+            table = built;
+        } else {
+            delete built;
+        }
+    }
+    auto it = table->find(name);
+    return it != table->end() ? it->second : kNotFound;
+}
+
+Shape* Shape::addProperty(const std::string& name) {
+    {
+        std::shared_lock<std::shared_mutex> lock(transitionMutex);
+        auto it = transitions_.find(name);
+        if (it != transitions_.end()) {
+            return it->second.get();
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(transitionMutex);
+    auto inserted = transitions_.emplace(name, nullptr);
+    if (inserted.second) {
+        inserted.first->second.reset(new Shape(this, name, slotCount_ + 1));
+    }
+    return inserted.first->second.get();
+}
+
+Shape* Shape::removeProperty(const std::string& name, uint32_t* removedSlot) {
+    uint32_t slot = lookup(name);
+    if (removedSlot) {
+        *removedSlot = slot;
+    }
+    if (slot == kNotFound) {
+        return this;
+    }
+
+    // Replay the remaining keys from the root so the result is shared with
+    // objects that never had the property
+    Shape* shape = root();
+    for (const std::string& key : keys()) {
+        if (key != name) {
+            shape = shape->addProperty(key);
+        }
+    }
+    return shape;
+}
+
+std::vector<std::string> Shape::keys() const {
+    std::vector<std::string> result;
+    result.reserve(slotCount_);
+    for (const Shape* shape = this; shape->parent_; shape = shape->parent_) {
+        result.push_back(shape->key_);
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+size_t Shape::getTransitionCount() const {
+    std::shared_lock<std::shared_mutex> lock(transitionMutex);
+    return transitions_.size();
+}
+
+size_t Shape::getShapeCount() {
+    return shapeCount.load(std::memory_order_relaxed);
+}
+
+} // namespace js
@@ -0,0 +1,128 @@
+#include "js/snapshot.h"
+#include "js/gc.h"
+#include "js/shape.h"
+#include <typeinfo>
+#include <unordered_map>
+
+namespace js {
+
+namespace {
+
+// Objects restore() knows how to rebuild
+bool isSnapshotable(const Object* object) {
+    return typeid(*object) == typeid(Object) || typeid(*object) == typeid(NativeFunction);
+}
+
+} // namespace
+
+// Capture
+
+std::shared_ptr<const HeapSnapshot> HeapSnapshot::capture(const Object& global, uint32_t firstSlot) {
+    std::shared_ptr<HeapSnapshot> snapshot(new HeapSnapshot());
+    std::unordered_map<const Object*, uint32_t> index;
+    std::vector<const Object*> objects;
+    bool complete = true;
+
+    auto encode = [&](JSValue value) {
+        if (value.isString()) {
+            snapshot->strings_.push_back(value.toString());
+            return Slot{Slot::Kind::String, snapshot->strings_.size() - 1};
+        }
+        if (value.isObject()) {
+            const Object* object = value.asObject();
+            if (!isSnapshotable(object)) {
+                complete = false;
+                return Slot{Slot::Kind::Value, JSValue::undefined().bits()};
+            }
+            auto [it, added] = index.emplace(object, static_cast<uint32_t>(objects.size()));
+            if (added) {
+                objects.push_back(object);
+            }
+            return Slot{Slot::Kind::Object, it->second};
+        }
+        return Slot{Slot::Kind::Value, value.bits()};
+    };
+
+    std::vector<std::string> names = global.shape()->keys();
+    for (uint32_t slot = firstSlot; slot < names.size(); ++slot) {
+        snapshot->globals_.push_back({names[slot], encode(global.slotAt(slot))});
+    }
+
+    // objects grows while its entries are encoded, breadth first
+    for (size_t i = 0; i < objects.size() && complete; ++i) {
+        const Object* object = objects[i];
+        Entry entry{object->shape(), static_cast<uint32_t>(snapshot->slots_.size()), false, {}, {}, {}};
+        if (auto* function = dynamic_cast<const NativeFunction*>(object)) {
+            entry.native = true;
+            entry.name = function->name();
+            entry.rebinder = function->rebinder();
+            if (!entry.rebinder) {
+                entry.callback = function->callback();
+            }
+        }
+        snapshot->entries_.push_back(std::move(entry));
+        for (JSValue value : object->slotValues()) {
+            Slot encoded = encode(value);
+            snapshot->slots_.push_back(encoded);
+        }
+    }
+
+    if (!complete) {
+        return nullptr;
+    }
+    return snapshot;
+}
+
+// Restore
+
+void HeapSnapshot::restore(Object& global, const SnapshotBindings& bindings) const {
+    GC& heap = *bindings.heap;
+
+    // Allocation does not collect, so nothing here needs rooting until the
+    // globals are installed at the end
+    std::vector<Object*> cells;
+    cells.reserve(entries_.size());
+    for (const Entry& entry : entries_) {
+        if (!entry.native) {
+            cells.push_back(heap.allocate<Object>());
+            continue;
+        }
+        auto* function = heap.allocate<NativeFunction>(entry.name,
+            entry.rebinder ? entry.rebinder(bindings) : entry.callback);
+        function->setRebinder(entry.rebinder);
+        cells.push_back(function);
+    }
+
+    std::vector<JSValue> strings;
+    strings.reserve(strings_.size());
+    // Builtin strings live as long as the builtins; the common ones come
+    // from the heap's read-only strings
+    for (const std::string& text : strings_) {
+        strings.push_back(heap.internedString(text));
+    }
+
+    auto decode = [&](const Slot& slot) {
+        switch (slot.kind) {
+            case Slot::Kind::String: return strings[slot.payload];
+            case Slot::Kind::Object: return JSValue::object(cells[slot.payload]);
+            case Slot::Kind::Value: break;
+        }
+        return JSValue::fromBits(slot.payload);
+    };
+
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const Entry& entry = entries_[i];
+        std::vector<JSValue> values;
+        values.reserve(entry.shape->slotCount());
+        for (uint32_t slot = 0; slot < entry.shape->slotCount(); ++slot) {
+            values.push_back(decode(slots_[entry.firstSlot + slot]));
+        }
+        cells[i]->setLayout(entry.shape, std::move(values));
+    }
+
+    for (const Global& binding : globals_) {
+        global.put(binding.name, decode(binding.value));
+    }
+}
+
+} // namespace js
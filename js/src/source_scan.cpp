@@ -0,0 +1,369 @@
+#include "js/source_scan.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JS_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define JS_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace js {
+
+namespace {
+
+// Scalar probe before a run is handed to the block kernels; most
+// identifiers and whitespace runs end inside it
+constexpr size_t kProbeLength = 16;
+
+// Up to four bytes that end a run, repeated to fill
+struct Stops {
+    unsigned char bytes[4];
+};
+
+bool isWhitespaceByte(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool isIdentifierByte(unsigned char c) {
+    unsigned char lower = c | 0x20;
+    return (lower >= 'a' && lower <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '$';
+}
+
+bool isStopByte(unsigned char c, const Stops& stops) {
+    return c == stops.bytes[0] || c == stops.bytes[1] || c == stops.bytes[2] || c == stops.bytes[3];
+}
+
+// Each kernel sets bit i for each byte of a 64-byte block that ends the run
+struct Kernels {
+    ScanIsa isa;
+    uint64_t (*whitespace)(const unsigned char* bytes);
+    uint64_t (*identifier)(const unsigned char* bytes);
+    uint64_t (*stops)(const unsigned char* bytes, const Stops& stops);
+};
+
+// Scalar
+
+uint64_t whitespaceScalar(const unsigned char* bytes) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        mask |= static_cast<uint64_t>(!isWhitespaceByte(bytes[i])) << i;
+    }
+    return mask;
+}
+
+uint64_t identifierScalar(const unsigned char* bytes) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        mask |= static_cast<uint64_t>(!isIdentifierByte(bytes[i])) << i;
+    }
+    return mask;
+}
+
+uint64_t stopsScalar(const unsigned char* bytes, const Stops& stops) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        mask |= static_cast<uint64_t>(isStopByte(bytes[i], stops)) << i;
+    }
+    return mask;
+}
+
+const Kernels kScalarKernels = {ScanIsa::Scalar, whitespaceScalar, identifierScalar, stopsScalar};
+
+#if JS_SCAN_X86
+
+// Unsigned x <= limit, which SSE2 lacks: min(x, limit) is x exactly then
+#define TARGET_SSE2 __attribute__((target("sse2")))
+
+TARGET_SSE2 inline __m128i atMostSse2(__m128i x, char limit) {
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(limit)), x);
+}
+
+TARGET_SSE2 inline __m128i whitespaceLanesSse2(__m128i v) {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                        atMostSse2(_mm_sub_epi8(v, _mm_set1_epi8('\t')), '\r' - '\t'));
+}
+
+TARGET_SSE2 inline __m128i identifierLanesSse2(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i letter = atMostSse2(_mm_sub_epi8(lower, _mm_set1_epi8('a')), 'z' - 'a');
+    __m128i digit = atMostSse2(_mm_sub_epi8(v, _mm_set1_epi8('0')), 9);
+    return _mm_or_si128(_mm_or_si128(letter, digit),
+                        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')), _mm_cmpeq_epi8(v, _mm_set1_epi8('$'))));
+}
+
+TARGET_SSE2 uint64_t whitespaceSse2(const unsigned char* bytes) {
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + offset));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(whitespaceLanesSse2(v)))) << offset;
+    }
+    return ~mask;
+}
+
+TARGET_SSE2 uint64_t identifierSse2(const unsigned char* bytes) {
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + offset));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(identifierLanesSse2(v)))) << offset;
+    }
+    return ~mask;
+}
+
+TARGET_SSE2 uint64_t stopsSse2(const unsigned char* bytes, const Stops& stops) {
+    const __m128i a = _mm_set1_epi8(static_cast<char>(stops.bytes[0]));
+    const __m128i b = _mm_set1_epi8(static_cast<char>(stops.bytes[1]));
+    const __m128i c = _mm_set1_epi8(static_cast<char>(stops.bytes[2]));
+    const __m128i d = _mm_set1_epi8(static_cast<char>(stops.bytes[3]));
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + offset));
+        __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, b)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(v, c), _mm_cmpeq_epi8(v, d)));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(stop))) << offset;
+    }
+    return mask;
+}
+
+const Kernels kSse2Kernels = {ScanIsa::SSE2, whitespaceSse2, identifierSse2, stopsSse2};
+
+// AVX2: the same tests on 32 bytes at a time
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+TARGET_AVX2 inline __m256i atMostAvx2(__m256i x, char limit) {
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(limit)), x);
+}
+
+TARGET_AVX2 inline __m256i whitespaceLanesAvx2(__m256i v) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                           atMostAvx2(_mm256_sub_epi8(v, _mm256_set1_epi8('\t')), '\r' - '\t'));
+}
+
+TARGET_AVX2 inline __m256i identifierLanesAvx2(__m256i v) {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i letter = atMostAvx2(_mm256_sub_epi8(lower, _mm256_set1_epi8('a')), 'z' - 'a');
+    __m256i digit = atMostAvx2(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), 9);
+    return _mm256_or_si256(
+        _mm256_or_si256(letter, digit),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('$'))));
+}
+
+TARGET_AVX2 uint64_t whitespaceAvx2(const unsigned char* bytes) {
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + offset));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(whitespaceLanesAvx2(v)))) << offset;
+    }
+    return ~mask;
+}
+
+TARGET_AVX2 uint64_t identifierAvx2(const unsigned char* bytes) {
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + offset));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(identifierLanesAvx2(v)))) << offset;
+    }
+    return ~mask;
+}
+
+TARGET_AVX2 uint64_t stopsAvx2(const unsigned char* bytes, const Stops& stops) {
+    const __m256i a = _mm256_set1_epi8(static_cast<char>(stops.bytes[0]));
+    const __m256i b = _mm256_set1_epi8(static_cast<char>(stops.bytes[1]));
+    const __m256i c = _mm256_set1_epi8(static_cast<char>(stops.bytes[2]));
+    const __m256i d = _mm256_set1_epi8(static_cast<char>(stops.bytes[3]));
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + offset));
+        __m256i stop = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, a), _mm256_cmpeq_epi8(v, b)),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(v, c), _mm256_cmpeq_epi8(v, d)));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(stop))) << offset;
+    }
+    return mask;
+}
+
+const Kernels kAvx2Kernels = {ScanIsa::AVX2, whitespaceAvx2, identifierAvx2, stopsAvx2};
+
+#endif // JS_SCAN_X86
+
+#if JS_SCAN_NEON
+
+// NEON has no movemask; weight each lane by its bit and add the halves
+inline uint64_t toMaskNeon(uint8x16_t lanes) {
+    const uint8x16_t weights = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t bits = vandq_u8(lanes, weights);
+    return static_cast<uint64_t>(vaddv_u8(vget_low_u8(bits))) |
+           (static_cast<uint64_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+}
+
+uint64_t whitespaceNeon(const unsigned char* bytes) {
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        uint8x16_t v = vld1q_u8(bytes + offset);
+        uint8x16_t space = vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+                                    vcleq_u8(vsubq_u8(v, vdupq_n_u8('\t')), vdupq_n_u8('\r' - '\t')));
+        mask |= toMaskNeon(space) << offset;
+    }
+    return ~mask;
+}
+
+uint64_t identifierNeon(const unsigned char* bytes) {
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        uint8x16_t v = vld1q_u8(bytes + offset);
+        uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+        uint8x16_t letter = vcleq_u8(vsubq_u8(lower, vdupq_n_u8('a')), vdupq_n_u8('z' - 'a'));
+        uint8x16_t digit = vcleq_u8(vsubq_u8(v, vdupq_n_u8('0')), vdupq_n_u8(9));
+        uint8x16_t part = vorrq_u8(vorrq_u8(letter, digit),
+                                   vorrq_u8(vceqq_u8(v, vdupq_n_u8('_')), vceqq_u8(v, vdupq_n_u8('$'))));
+        mask |= toMaskNeon(part) << offset;
+    }
+    return ~mask;
+}
+
+uint64_t stopsNeon(const unsigned char* bytes, const Stops& stops) {
+    const uint8x16_t a = vdupq_n_u8(stops.bytes[0]);
+    const uint8x16_t b = vdupq_n_u8(stops.bytes[1]);
+    const uint8x16_t c = vdupq_n_u8(stops.bytes[2]);
+    const uint8x16_t d = vdupq_n_u8(stops.bytes[3]);
+    uint64_t mask = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        uint8x16_t v = vld1q_u8(bytes + offset);
+        uint8x16_t stop = vorrq_u8(vorrq_u8(vceqq_u8(v, a), vceqq_u8(v, b)), vorrq_u8(vceqq_u8(v, c), vceqq_u8(v, d)));
+        mask |= toMaskNeon(stop) << offset;
+    }
+    return mask;
+}
+
+const Kernels kNeonKernels = {ScanIsa::NEON, whitespaceNeon, identifierNeon, stopsNeon};
+
+#endif // JS_SCAN_NEON
+
+const Kernels* kernelsFor(ScanIsa isa) {
+    switch (isa) {
+#if JS_SCAN_X86
+        case ScanIsa::AVX2:
+            return __builtin_cpu_supports("avx2") ? &kAvx2Kernels : nullptr;
+        case ScanIsa::SSE2:
+            return __builtin_cpu_supports("sse2") ? &kSse2Kernels : nullptr;
+#endif
+#if JS_SCAN_NEON
+        case ScanIsa::NEON:
+            return &kNeonKernels;
+#endif
+        case ScanIsa::Scalar:
+            return &kScalarKernels;
+        default:
+            return nullptr;
+    }
+}
+
+std::atomic<const Kernels*> selectedKernels(nullptr);
+
+const Kernels& kernels() {
+    const Kernels* selected = selectedKernels.load(std::memory_order_acquire);
+    if (!selected) {
+        selected = kernelsFor(bestScanIsa());
+        selectedKernels.store(selected, std::memory_order_release);
+    }
+    return *selected;
+}
+
+// The first byte at or after position for which ends() holds; block(bytes)
+// gives the same test for 64 bytes as a mask
+template <typename Ends, typename Block>
+size_t scanRun(std::string_view text, size_t position, Ends ends, Block block) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t size = text.size();
+    size_t probe = std::min(size, position + kProbeLength);
+    for (; position < probe; ++position) {
+        if (ends(bytes[position])) {
+            return position;
+        }
+    }
+    for (; position + 64 <= size; position += 64) {
+        uint64_t mask = block(bytes + position);
+        if (mask) {
+            return position + static_cast<size_t>(__builtin_ctzll(mask));
+        }
+    }
+    while (position < size && !ends(bytes[position])) {
+        ++position;
+    }
+    return position;
+}
+
+size_t findStops(std::string_view text, size_t position, const Stops& stops) {
+    const Kernels& selected = kernels();
+    return scanRun(
+        text, position, [&stops](unsigned char c) { return isStopByte(c, stops); },
+        [&selected, &stops](const unsigned char* bytes) { return selected.stops(bytes, stops); });
+}
+
+} // namespace
+
+size_t skipWhitespaceRun(std::string_view text, size_t position) {
+    return scanRun(
+        text, position, [](unsigned char c) { return !isWhitespaceByte(c); }, kernels().whitespace);
+}
+
+size_t skipIdentifierRun(std::string_view text, size_t position) {
+    return scanRun(
+        text, position, [](unsigned char c) { return !isIdentifierByte(c); }, kernels().identifier);
+}
+
+size_t findLineEnd(std::string_view text, size_t position) {
+    return findStops(text, position, Stops{{'\n', '\r', '\n', '\r'}});
+}
+
+size_t findBlockCommentEnd(std::string_view text, size_t position) {
+    while (true) {
+        position = findStops(text, position, Stops{{'*', '*', '*', '*'}});
+        if (position + 1 >= text.size()) {
+            return text.size();
+        }
+        if (text[position + 1] == '/') {
+            return position;
+        }
+        ++position;
+    }
+}
+
+size_t findStringStop(std::string_view text, size_t position, char quote) {
+    unsigned char q = static_cast<unsigned char>(quote);
+    return findStops(text, position, Stops{{q, '\\', q, '\\'}});
+}
+
+size_t findTemplateStop(std::string_view text, size_t position) {
+    return findStops(text, position, Stops{{'`', '\\', '$', '`'}});
+}
+
+// Kernel selection
+
+ScanIsa scanIsa() {
+    return kernels().isa;
+}
+
+ScanIsa bestScanIsa() {
+    static const ScanIsa best = [] {
+        for (ScanIsa isa : {ScanIsa::AVX2, ScanIsa::SSE2, ScanIsa::NEON}) {
+            if (kernelsFor(isa)) return isa;
+        }
+        return ScanIsa::Scalar;
+    }();
+    return best;
+}
+
+bool setScanIsa(ScanIsa isa) {
+    const Kernels* selected = kernelsFor(isa);
+    if (!selected) return false;
+
+    selectedKernels.store(selected, std::memory_order_release);
+    return true;
+}
+
+} // namespace js
@@ -0,0 +1,288 @@
+#include "js/value.h"
+#include "js/gc.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace js {
+
+namespace {
+
+bool isAscii(const std::string& text) {
+    return std::all_of(text.begin(), text.end(), [](char c) { return static_cast<unsigned char>(c) < 0x80; });
+}
+
+// UTF-8 to UTF-16; malformed sequences become U+FFFD. Returns false if
+// any were found.
+bool decodeUtf8(const std::string& text, std::u16string& units) {
+    bool valid = true;
+    units.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char lead = static_cast<unsigned char>(text[i]);
+        size_t extra = lead < 0x80 ? 0 : lead >= 0xF0 && lead < 0xF5 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC2 ? 1 : 4;
+        uint32_t codePoint = extra == 0 ? lead : extra == 1 ? lead & 0x1F : extra == 2 ? lead & 0x0F : lead & 0x07;
+        bool ok = extra < 4 && i + extra < text.size();
+        for (size_t k = 1; ok && k <= extra; ++k) {
+            unsigned char next = static_cast<unsigned char>(text[i + k]);
+            ok = (next & 0xC0) == 0x80;
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+        if (!ok || (extra == 2 && codePoint < 0x800) || (extra == 3 && (codePoint < 0x10000 || codePoint > 0x10FFFF))) {
+            units.push_back(0xFFFD);
+            valid = false;
+            ++i;
+            continue;
+        }
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            units.push_back(static_cast<char16_t>(0xD800 + (codePoint >> 10)));
+            units.push_back(static_cast<char16_t>(0xDC00 + (codePoint & 0x3FF)));
+        } else {
+            units.push_back(static_cast<char16_t>(codePoint));
+        }
+        i += extra + 1;
+    }
+    return valid;
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Surrogate pairs are joined; lone surrogates are encoded as they are
+std::string encodeUtf8(const char16_t* units, size_t length) {
+    std::string out;
+    out.reserve(length);
+    for (size_t i = 0; i < length; ++i) {
+        uint32_t unit = units[i];
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 1 < length && units[i + 1] >= 0xDC00 && units[i + 1] < 0xE000) {
+            unit = 0x10000 + ((unit - 0xD800) << 10) + (units[i + 1] - 0xDC00);
+            ++i;
+        }
+        appendUtf8(out, unit);
+    }
+    return out;
+}
+
+std::string encodeUtf8(const char* bytes, size_t length) {
+    std::string out;
+    out.reserve(length);
+    for (size_t i = 0; i < length; ++i) {
+        appendUtf8(out, static_cast<unsigned char>(bytes[i]));
+    }
+    return out;
+}
+
+void widen(std::u16string& out, const char* bytes, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        out.push_back(static_cast<unsigned char>(bytes[i]));
+    }
+}
+
+} // namespace
+
+// Construction
+
+String::String(const std::string& value)
+    : Value(ValueType::String), representation_(Representation::OneByte), oneByteUnits_(), twoByteUnits_(),
+      left_(nullptr), right_(nullptr), offset_(0), length_(value.size()), oneByte_(true), ascii_(isAscii(value)),
+      hash_(0), utf8_(), utf8Cached_(false), marked_(false) {
+    if (ascii_) {
+        oneByteUnits_ = value;
+        return;
+    }
+
+    std::u16string units;
+    bool valid = decodeUtf8(value, units);
+    length_ = units.size();
+    if (std::all_of(units.begin(), units.end(), [](char16_t unit) { return unit < 0x100; })) {
+        oneByteUnits_.assign(units.begin(), units.end());
+    } else {
+        representation_ = Representation::TwoByte;
+        oneByte_ = false;
+        twoByteUnits_ = std::move(units);
+    }
+    // The source already is the UTF-8 form
+    if (valid) {
+        utf8_ = value;
+        utf8Cached_ = true;
+    }
+}
+
+String::String(std::u16string units)
+    : Value(ValueType::String), representation_(Representation::TwoByte), oneByteUnits_(), twoByteUnits_(),
+      left_(nullptr), right_(nullptr), offset_(0), length_(units.size()), oneByte_(false), ascii_(false), hash_(0),
+      utf8_(), utf8Cached_(false), marked_(false) {
+    if (std::all_of(units.begin(), units.end(), [](char16_t unit) { return unit < 0x100; })) {
+        representation_ = Representation::OneByte;
+        oneByte_ = true;
+        ascii_ = std::all_of(units.begin(), units.end(), [](char16_t unit) { return unit < 0x80; });
+        oneByteUnits_.assign(units.begin(), units.end());
+    } else {
+        twoByteUnits_ = std::move(units);
+    }
+}
+
+String::String(const String* left, const String* right)
+    : Value(ValueType::String), representation_(Representation::Rope), oneByteUnits_(), twoByteUnits_(),
+      left_(left), right_(right), offset_(0), length_(left->length_ + right->length_),
+      oneByte_(left->oneByte_ && right->oneByte_), ascii_(left->ascii_ && right->ascii_), hash_(0), utf8_(),
+      utf8Cached_(false), marked_(false) {
+}
+
+// Slices always point at flat storage: a rope base is flattened and a
+// slice base is replaced by its own base
+String::String(const String* base, size_t start, size_t length)
+    : Value(ValueType::String), representation_(Representation::Slice), oneByteUnits_(), twoByteUnits_(),
+      left_(base), right_(nullptr), offset_(start), length_(length), oneByte_(false), ascii_(false), hash_(0),
+      utf8_(), utf8Cached_(false), marked_(false) {
+    base->flatten();
+    if (base->representation_ == Representation::Slice) {
+        left_ = base->left_;
+        offset_ += base->offset_;
+    }
+    oneByte_ = left_->oneByte_;
+    ascii_ = left_->ascii_;
+}
+
+// Representation
+
+const char* String::oneByteData() const {
+    return representation_ == Representation::Slice ? left_->oneByteUnits_.data() + offset_ : oneByteUnits_.data();
+}
+
+const char16_t* String::twoByteData() const {
+    return representation_ == Representation::Slice ? left_->twoByteUnits_.data() + offset_ : twoByteUnits_.data();
+}
+
+// Copies the leaves left to right with an explicit stack, so the deep
+// left-leaning ropes built by `s += x` loops do not recurse
+void String::flatten() const {
+    if (representation_ != Representation::Rope) {
+        return;
+    }
+
+    std::string bytes;
+    std::u16string units;
+    if (oneByte_) {
+        bytes.reserve(length_);
+    } else {
+        units.reserve(length_);
+    }
+
+    std::vector<const String*> pending{this};
+    while (!pending.empty()) {
+        const String* part = pending.back();
+        pending.pop_back();
+        if (part->representation_ == Representation::Rope) {
+            pending.push_back(part->right_);
+            pending.push_back(part->left_);
+        } else if (!part->oneByte_) {
+            units.append(part->twoByteData(), part->length_);
+        } else if (oneByte_) {
+            bytes.append(part->oneByteData(), part->length_);
+        } else {
+            widen(units, part->oneByteData(), part->length_);
+        }
+    }
+
+    if (oneByte_) {
+        oneByteUnits_ = std::move(bytes);
+        representation_ = Representation::OneByte;
+    } else {
+        twoByteUnits_ = std::move(units);
+        representation_ = Representation::TwoByte;
+    }
+    left_ = nullptr;
+    right_ = nullptr;
+}
+
+// String operations
+
+const std::string& String::value() const {
+    flatten();
+    if (ascii_ && representation_ == Representation::OneByte) {
+        return oneByteUnits_;
+    }
+    if (!utf8Cached_) {
+        if (ascii_) {
+            utf8_.assign(oneByteData(), length_);
+        } else {
+            utf8_ = oneByte_ ? encodeUtf8(oneByteData(), length_) : encodeUtf8(twoByteData(), length_);
+        }
+        utf8Cached_ = true;
+    }
+    return utf8_;
+}
+
+char16_t String::codeUnitAt(size_t index) const {
+    flatten();
+    return oneByte_ ? static_cast<unsigned char>(oneByteData()[index]) : twoByteData()[index];
+}
+
+// FNV-1a over code units; 0 marks "not computed yet"
+size_t String::hash() const {
+    if (hash_ != 0) {
+        return hash_;
+    }
+    flatten();
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length_; ++i) {
+        char16_t unit = oneByte_ ? static_cast<unsigned char>(oneByteData()[i]) : twoByteData()[i];
+        hash = (hash ^ unit) * 1099511628211ull;
+    }
+    hash_ = static_cast<size_t>(hash) | 1;
+    return hash_;
+}
+
+bool String::contentEquals(const String& other) const {
+    if (this == &other) {
+        return true;
+    }
+    if (length_ != other.length_ || (hash_ != 0 && other.hash_ != 0 && hash_ != other.hash_)) {
+        return false;
+    }
+
+    flatten();
+    other.flatten();
+    if (oneByte_ && other.oneByte_) {
+        return std::memcmp(oneByteData(), other.oneByteData(), length_) == 0;
+    }
+    if (!oneByte_ && !other.oneByte_) {
+        return std::memcmp(twoByteData(), other.twoByteData(), length_ * sizeof(char16_t)) == 0;
+    }
+    for (size_t i = 0; i < length_; ++i) {
+        if (codeUnitAt(i) != other.codeUnitAt(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Garbage collection
+
+void String::traceChildren(GC& gc) const {
+    if (representation_ == Representation::Rope) {
+        gc.markCell(const_cast<String*>(left_));
+        gc.markCell(const_cast<String*>(right_));
+    } else if (representation_ == Representation::Slice) {
+        gc.markCell(const_cast<String*>(left_));
+    }
+}
+
+} // namespace js
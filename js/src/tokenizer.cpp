@@ -1,109 +1,125 @@
 #include "js/tokenizer.h"
+#include "js/source_scan.h"
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 #include <unordered_map>
 
 namespace js {
 
+namespace {
+
+// Keywords and reserved words, recognized with a perfect hash over the
+// length and the first, second and last characters
+struct KeywordEntry {
+    std::string_view name;
+    TokenType type;
+};
+
+constexpr KeywordEntry kKeywords[] = {
+    {"break", TokenType::Keyword}, {"case", TokenType::Keyword}, {"catch", TokenType::Keyword},
+    {"class", TokenType::Keyword}, {"const", TokenType::Keyword}, {"continue", TokenType::Keyword},
+    {"debugger", TokenType::Keyword}, {"default", TokenType::Keyword}, {"delete", TokenType::Keyword},
+    {"do", TokenType::Keyword}, {"else", TokenType::Keyword}, {"export", TokenType::Keyword},
+    {"extends", TokenType::Keyword}, {"finally", TokenType::Keyword}, {"for", TokenType::Keyword},
+    {"function", TokenType::Keyword}, {"if", TokenType::Keyword}, {"import", TokenType::Keyword},
+    {"in", TokenType::Keyword}, {"instanceof", TokenType::Keyword}, {"let", TokenType::Keyword},
+    {"new", TokenType::Keyword}, {"return", TokenType::Keyword}, {"super", TokenType::Keyword},
+    {"switch", TokenType::Keyword}, {"this", TokenType::Keyword}, {"throw", TokenType::Keyword},
+    {"try", TokenType::Keyword}, {"typeof", TokenType::Keyword}, {"var", TokenType::Keyword},
+    {"void", TokenType::Keyword}, {"while", TokenType::Keyword}, {"with", TokenType::Keyword},
+    {"yield", TokenType::Keyword}, {"await", TokenType::Keyword}, {"async", TokenType::Keyword},
+    {"static", TokenType::Keyword}, {"public", TokenType::Keyword}, {"private", TokenType::Keyword},
+    {"protected", TokenType::Keyword}, {"abstract", TokenType::Keyword}, {"interface", TokenType::Keyword},
+    {"enum", TokenType::Keyword}, {"namespace", TokenType::Keyword}, {"module", TokenType::Keyword},
+    {"implements", TokenType::Keyword}, {"package", TokenType::Keyword}, {"declare", TokenType::Keyword},
+    {"global", TokenType::Keyword}, {"ambient", TokenType::Keyword}, {"readonly", TokenType::Keyword},
+    {"override", TokenType::Keyword}, {"virtual", TokenType::Keyword}, {"sealed", TokenType::Keyword},
+    {"final", TokenType::Keyword}, {"volatile", TokenType::Keyword}, {"transient", TokenType::Keyword},
+    {"native", TokenType::Keyword}, {"synchronized", TokenType::Keyword}, {"strictfp", TokenType::Keyword},
+    {"arguments", TokenType::ReservedWord}, {"boolean", TokenType::ReservedWord},
+    {"byte", TokenType::ReservedWord}, {"char", TokenType::ReservedWord}, {"double", TokenType::ReservedWord},
+    {"eval", TokenType::ReservedWord}, {"float", TokenType::ReservedWord}, {"goto", TokenType::ReservedWord},
+    {"int", TokenType::ReservedWord}, {"long", TokenType::ReservedWord}, {"short", TokenType::ReservedWord},
+    {"throws", TokenType::ReservedWord},
+};
+
+constexpr size_t kKeywordTableSize = 256;
+constexpr size_t kMinKeywordLength = 2;
+constexpr size_t kMaxKeywordLength = 12;
+
+constexpr size_t keywordHash(std::string_view word) {
+    return (word.size() + static_cast<unsigned char>(word[0]) * 25u + static_cast<unsigned char>(word[1]) * 27u +
+            static_cast<unsigned char>(word[word.size() - 1]) * 19u) & (kKeywordTableSize - 1);
+}
+
+struct KeywordTable {
+    KeywordEntry slots[kKeywordTableSize];
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table{};
+    for (const KeywordEntry& entry : kKeywords) {
+        table.slots[keywordHash(entry.name)] = entry;
+    }
+    return table;
+}
+
+constexpr bool keywordHashIsPerfect() {
+    for (size_t i = 0; i < sizeof(kKeywords) / sizeof(kKeywords[0]); ++i) {
+        for (size_t j = i + 1; j < sizeof(kKeywords) / sizeof(kKeywords[0]); ++j) {
+            if (keywordHash(kKeywords[i].name) == keywordHash(kKeywords[j].name)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(keywordHashIsPerfect(), "keyword hash has collisions; pick new multipliers");
+
+constexpr KeywordTable kKeywordTable = buildKeywordTable();
+
+const KeywordEntry* findKeyword(std::string_view word) {
+    if (word.size() < kMinKeywordLength || word.size() > kMaxKeywordLength) {
+        return nullptr;
+    }
+    const KeywordEntry& entry = kKeywordTable.slots[keywordHash(word)];
+    return entry.name == word ? &entry : nullptr;
+}
+
+char unescape(char escaped) {
+    switch (escaped) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case '0': return '\0';
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        default: return escaped;
+    }
+}
+
+} // namespace
+
 // Token implementation
-Token::Token() : type_(TokenType::Invalid), value_(), position_() {}
+Token::Token() : type_(TokenType::Invalid), atom_(AtomTable::kNone), value_(), start_(), end_() {}
 
-Token::Token(TokenType type, const String& value, const TokenPosition& position)
-    : type_(type), value_(value), position_(position) {}
+Token::Token(TokenType type, std::string_view value, const SourceMark& start, const SourceMark& end, Atom atom)
+    : type_(type), atom_(atom), value_(value), start_(start), end_(end) {}
 
-Token::~Token() = default;
+TokenPosition Token::position() const {
+    return TokenPosition(SourceLocation(start_.line, start_.column, start_.offset),
+                         SourceLocation(end_.line, end_.column, end_.offset));
+}
 
 bool Token::isKeyword() const {
-    switch (type_) {
-        case TokenType::Break:
-        case TokenType::Case:
-        case TokenType::Catch:
-        case TokenType::Class:
-        case TokenType::Const:
-        case TokenType::Continue:
-        case TokenType::Debugger:
-        case TokenType::Default:
-        case TokenType::Delete:
-        case TokenType::Do:
-        case TokenType::Else:
-        case TokenType::Export:
-        case TokenType::Extends:
-        case TokenType::Finally:
-        case TokenType::For:
-        case TokenType::Function:
-        case TokenType::If:
-        case TokenType::Import:
-        case TokenType::In:
-        case TokenType::Instanceof:
-        case TokenType::Let:
-        case TokenType::New:
-        case TokenType::Return:
-        case TokenType::Super:
-        case TokenType::Switch:
-        case TokenType::This:
-        case TokenType::Throw:
-        case TokenType::Try:
-        case TokenType::Typeof:
-        case TokenType::Var:
-        case TokenType::Void:
-        case TokenType::While:
-        case TokenType::With:
-        case TokenType::Yield:
-        case TokenType::Await:
-        case TokenType::Async:
-        case TokenType::Static:
-        case TokenType::Public:
-        case TokenType::Private:
-        case TokenType::Protected:
-        case TokenType::Abstract:
-        case TokenType::Interface:
-        case TokenType::Enum:
-        case TokenType::Namespace:
-        case TokenType::Module:
-        case TokenType::Implements:
-        case TokenType::Package:
-        case TokenType::Declare:
-        case TokenType::Global:
-        case TokenType::Ambient:
-        case TokenType::Readonly:
-        case TokenType::Override:
-        case TokenType::Virtual:
-        case TokenType::Sealed:
-        case TokenType::Final:
-        case TokenType::Volatile:
-        case TokenType::Transient:
-        case TokenType::Native:
-        case TokenType::Synchronized:
-        case TokenType::Strictfp:
-            return true;
-        default:
-            return false;
-    }
+    return type_ == TokenType::Keyword;
 }
 
 bool Token::isReservedWord() const {
-    switch (type_) {
-        case TokenType::Abstract:
-        case TokenType::Arguments:
-        case TokenType::Boolean:
-        case TokenType::Byte:
-        case TokenType::Char:
-        case TokenType::Double:
-        case TokenType::Eval:
-        case TokenType::Float:
-        case TokenType::Goto:
-        case TokenType::Int:
-        case TokenType::Long:
-        case TokenType::Native:
-        case TokenType::Short:
-        case TokenType::Synchronized:
-        case TokenType::Throws:
-        case TokenType::Transient:
-        case TokenType::Volatile:
-            return true;
-        default:
-            return false;
-    }
+    return type_ == TokenType::ReservedWord;
 }
 
 bool Token::isOperator() const {
@@ -215,20 +231,26 @@ bool Token::isValid() const {
     return type_ != TokenType::Invalid;
 }
 
+
 String Token::toString() const {
-    return "Token(" + std::to_string(static_cast<int>(type_)) + ", \"" + value_ + "\")";
+    return "Token(" + std::to_string(static_cast<int>(type_)) + ", \"" + std::string(value_) + "\")";
 }
 
 bool Token::operator==(const Token& other) const {
-    return type_ == other.type_ && value_ == other.value_ && position_ == other.position_;
+    return type_ == other.type_ && value_ == other.value_ && start_.offset == other.start_.offset &&
+           end_.offset == other.end_.offset;
 }
 
 // Tokenizer implementation
-Tokenizer::Tokenizer() : source_(), position_(0), filename_(), strictMode_(false), moduleMode_(false) {
+Tokenizer::Tokenizer()
+    : source_(), position_(0), line_(1), column_(1), filename_(), ownAtoms_(), sharedAtoms_(nullptr), cooked_(),
+      strictMode_(false), moduleMode_(false) {
     initializeModes();
 }
 
-Tokenizer::Tokenizer(const String& source) : source_(source), position_(0), filename_(), strictMode_(false), moduleMode_(false) {
+Tokenizer::Tokenizer(const String& source)
+    : source_(source), position_(0), line_(1), column_(1), filename_(), ownAtoms_(), sharedAtoms_(nullptr),
+      cooked_(), strictMode_(false), moduleMode_(false) {
     initializeModes();
 }
 
@@ -236,7 +258,7 @@ Tokenizer::~Tokenizer() = default;
 
 void Tokenizer::setSource(const String& source) {
     source_ = source;
-    position_ = 0;
+    reset();
 }
 
 Vector<Token> Tokenizer::tokenize() {
@@ -257,13 +279,13 @@ Vector<Token> Tokenizer::tokenize() {
 
 Token Tokenizer::nextToken() {
     if (!hasMoreTokens()) {
-        return Token(TokenType::EndOfFile, "", getCurrentPosition());
+        return Token(TokenType::EndOfFile, std::string_view(), getCurrentMark(), getCurrentMark());
     }
     
     skipWhitespace();
     
     if (!hasMoreTokens()) {
-        return Token(TokenType::EndOfFile, "", getCurrentPosition());
+        return Token(TokenType::EndOfFile, std::string_view(), getCurrentMark(), getCurrentMark());
     }
     
     char c = currentChar();
@@ -290,7 +312,10 @@ Token Tokenizer::nextToken() {
     } else if (c == '\\') {
         return readRegExp();
     } else {
-        return Token(TokenType::Invalid, String(1, c), getCurrentPosition());
+        // Consume the character so a stream of tokens always makes progress
+        SourceMark start = getCurrentMark();
+        advance();
+        return Token(TokenType::Invalid, slice(start.offset, position_), start, getCurrentMark());
     }
 }
 
@@ -300,6 +325,8 @@ Token Tokenizer::peekToken() {
 
 Token Tokenizer::peekToken(size_t offset) {
     size_t savedPosition = position_;
+    uint32_t savedLine = line_;
+    uint32_t savedColumn = column_;
     Token token;
     
     for (size_t i = 0; i < offset; ++i) {
@@ -307,6 +334,8 @@ Token Tokenizer::peekToken(size_t offset) {
     }
     
     position_ = savedPosition;
+    line_ = savedLine;
+    column_ = savedColumn;
     return token;
 }
 
@@ -314,14 +343,30 @@ bool Tokenizer::hasMoreTokens() const {
     return position_ < source_.length();
 }
 
+void Tokenizer::setPosition(size_t position) {
+    if (position < position_) {
+        position_ = 0;
+        line_ = 1;
+        column_ = 1;
+    }
+    advance(position - position_);
+}
+
+void Tokenizer::setMark(const SourceMark& mark) {
+    position_ = std::min<size_t>(mark.offset, source_.length());
+    line_ = mark.line;
+    column_ = mark.column;
+}
+
 void Tokenizer::reset() {
     position_ = 0;
+    line_ = 1;
+    column_ = 1;
+    cooked_.clear();
 }
 
 void Tokenizer::skipWhitespace() {
-    while (hasMoreTokens() && isWhitespace(currentChar())) {
-        advance();
-    }
+    advanceTo(skipWhitespaceRun(source_, position_));
 }
 
 void Tokenizer::skipComments() {
@@ -337,250 +382,299 @@ void Tokenizer::skipComments() {
         } else if (!isWhitespace(c)) {
             break;
         } else {
-            advance();
+            skipWhitespace();
         }
     }
 }
 
+// Literals only copy their text when an escape makes it differ from the
+// source; everything else is a view of source_.
 Token Tokenizer::readString() {
-    SourceLocation start = getCurrentLocation();
+    SourceMark start = getCurrentMark();
     char quote = currentChar();
-    String value;
     
     advance(); // Skip opening quote
+    size_t begin = position_;
+    bool hasEscapes = false;
+    std::string cooked;
     
-    while (hasMoreTokens() && currentChar() != quote) {
-        char c = currentChar();
-        if (c == '\\') {
-            advance();
-            if (hasMoreTokens()) {
-                char escaped = currentChar();
-                switch (escaped) {
-                    case 'n': value += '\n'; break;
-                    case 't': value += '\t'; break;
-                    case 'r': value += '\r'; break;
-                    case '\\': value += '\\'; break;
-                    case '"': value += '"'; break;
-                    case '\'': value += '\''; break;
-                    case '0': value += '\0'; break;
-                    case 'b': value += '\b'; break;
-                    case 'f': value += '\f'; break;
-                    case 'v': value += '\v'; break;
-                    default: value += escaped; break;
-                }
-                advance();
-            }
-        } else {
-            value += c;
+    while (hasMoreTokens()) {
+        size_t stop = findStringStop(source_, position_, quote);
+        if (hasEscapes) {
+            cooked.append(source_, position_, stop - position_);
+        }
+        advanceTo(stop);
+        if (!hasMoreTokens() || currentChar() == quote) {
+            break;
+        }
+        // A backslash
+        if (!hasEscapes) {
+            cooked.assign(source_, begin, position_ - begin);
+            hasEscapes = true;
+        }
+        advance();
+        if (hasMoreTokens()) {
+            cooked += unescape(currentChar());
             advance();
         }
     }
+    size_t end = position_;
     
     if (hasMoreTokens() && currentChar() == quote) {
         advance(); // Skip closing quote
     }
     
-    SourceLocation end = getCurrentLocation();
-    return Token(TokenType::StringLiteral, value, TokenPosition(start, end));
+    std::string_view value = hasEscapes ? cook(std::move(cooked)) : slice(begin, end);
+    return Token(TokenType::StringLiteral, value, start, getCurrentMark());
 }
 
 Token Tokenizer::readNumber() {
-    SourceLocation start = getCurrentLocation();
-    String value;
+    SourceMark start = getCurrentMark();
     
     while (hasMoreTokens() && (isDigit(currentChar()) || currentChar() == '.' || currentChar() == 'e' || currentChar() == 'E' || currentChar() == '+' || currentChar() == '-')) {
-        value += currentChar();
         advance();
     }
     
-    SourceLocation end = getCurrentLocation();
-    return Token(TokenType::NumberLiteral, value, TokenPosition(start, end));
+    return Token(TokenType::NumberLiteral, slice(start.offset, position_), start, getCurrentMark());
 }
 
 Token Tokenizer::readIdentifier() {
-    SourceLocation start = getCurrentLocation();
-    String value;
-    
-    while (hasMoreTokens() && (isLetterOrDigit(currentChar()) || currentChar() == '_' || currentChar() == '$')) {
-        value += currentChar();
-        advance();
-    }
+    SourceMark start = getCurrentMark();
     
-    SourceLocation end = getCurrentLocation();
+    // No newlines in an identifier
+    size_t end = skipIdentifierRun(source_, position_);
+    column_ += static_cast<uint32_t>(end - position_);
+    position_ = end;
     
-    // Check if it's a keyword
-    if (isKeyword(value)) {
-        return Token(TokenType::Keyword, value, TokenPosition(start, end));
-    }
-    
-    // Check if it's a reserved word
-    if (isReservedWord(value)) {
-        return Token(TokenType::ReservedWord, value, TokenPosition(start, end));
-    }
-    
-    return Token(TokenType::Identifier, value, TokenPosition(start, end));
+    std::string_view value = slice(start.offset, position_);
+    const KeywordEntry* keyword = findKeyword(value);
+    TokenType type = keyword ? keyword->type : TokenType::Identifier;
+    return Token(type, value, start, getCurrentMark(), atoms().intern(value));
 }
 
 Token Tokenizer::readOperator() {
-    SourceLocation start = getCurrentLocation();
-    String value;
+    SourceMark start = getCurrentMark();
     
     while (hasMoreTokens() && isOperator(currentChar())) {
-        value += currentChar();
         advance();
     }
     
-    SourceLocation end = getCurrentLocation();
-    return Token(TokenType::ArithmeticOperator, value, TokenPosition(start, end));
+    return Token(TokenType::ArithmeticOperator, slice(start.offset, position_), start, getCurrentMark());
 }
 
 Token Tokenizer::readPunctuation() {
-    SourceLocation start = getCurrentLocation();
+    SourceMark start = getCurrentMark();
     char c = currentChar();
     advance();
     
-    SourceLocation end = getCurrentLocation();
-    
+    TokenType type;
     switch (c) {
-        case '(': return Token(TokenType::LeftParen, "(", TokenPosition(start, end));
-        case ')': return Token(TokenType::RightParen, ")", TokenPosition(start, end));
-        case '[': return Token(TokenType::LeftBracket, "[", TokenPosition(start, end));
-        case ']': return Token(TokenType::RightBracket, "]", TokenPosition(start, end));
-        case '{': return Token(TokenType::LeftBrace, "{", TokenPosition(start, end));
-        case '}': return Token(TokenType::RightBrace, "}", TokenPosition(start, end));
-        case ';': return Token(TokenType::Semicolon, ";", TokenPosition(start, end));
-        case ':': return Token(TokenType::Colon, ":", TokenPosition(start, end));
-        case ',': return Token(TokenType::Comma, ",", TokenPosition(start, end));
-        case '.': return Token(TokenType::Dot, ".", TokenPosition(start, end));
-        case '?': return Token(TokenType::QuestionMark, "?", TokenPosition(start, end));
-        case '!': return Token(TokenType::ExclamationMark, "!", TokenPosition(start, end));
-        case '@': return Token(TokenType::At, "@", TokenPosition(start, end));
-        case '#': return Token(TokenType::Hash, "#", TokenPosition(start, end));
-        case '$': return Token(TokenType::Dollar, "$", TokenPosition(start, end));
-        case '%': return Token(TokenType::Percent, "%", TokenPosition(start, end));
-        case '&': return Token(TokenType::Ampersand, "&", TokenPosition(start, end));
-        case '*': return Token(TokenType::Asterisk, "*", TokenPosition(start, end));
-        case '+': return Token(TokenType::Plus, "+", TokenPosition(start, end));
-        case '-': return Token(TokenType::Minus, "-", TokenPosition(start, end));
-        case '=': return Token(TokenType::Equals, "=", TokenPosition(start, end));
-        case '<': return Token(TokenType::LessThan, "<", TokenPosition(start, end));
-        case '>': return Token(TokenType::GreaterThan, ">", TokenPosition(start, end));
-        case '^': return Token(TokenType::Caret, "^", TokenPosition(start, end));
-        case '~': return Token(TokenType::Tilde, "~", TokenPosition(start, end));
-        case '|': return Token(TokenType::Pipe, "|", TokenPosition(start, end));
-        case '\\': return Token(TokenType::Backslash, "\\", TokenPosition(start, end));
-        case '/': return Token(TokenType::ForwardSlash, "/", TokenPosition(start, end));
-        case '`': return Token(TokenType::Backtick, "`", TokenPosition(start, end));
-        case '"': return Token(TokenType::DoubleQuote, "\"", TokenPosition(start, end));
-        case '\'': return Token(TokenType::SingleQuote, "'", TokenPosition(start, end));
-        default: return Token(TokenType::Invalid, String(1, c), TokenPosition(start, end));
+        case '(': type = TokenType::LeftParen; break;
+        case ')': type = TokenType::RightParen; break;
+        case '[': type = TokenType::LeftBracket; break;
+        case ']': type = TokenType::RightBracket; break;
+        case '{': type = TokenType::LeftBrace; break;
+        case '}': type = TokenType::RightBrace; break;
+        case ';': type = TokenType::Semicolon; break;
+        case ':': type = TokenType::Colon; break;
+        case ',': type = TokenType::Comma; break;
+        case '.': type = TokenType::Dot; break;
+        case '?': type = TokenType::QuestionMark; break;
+        case '!': type = TokenType::ExclamationMark; break;
+        case '@': type = TokenType::At; break;
+        case '#': type = TokenType::Hash; break;
+        case '$': type = TokenType::Dollar; break;
+        case '%': type = TokenType::Percent; break;
+        case '&': type = TokenType::Ampersand; break;
+        case '*': type = TokenType::Asterisk; break;
+        case '+': type = TokenType::Plus; break;
+        case '-': type = TokenType::Minus; break;
+        case '=': type = TokenType::Equals; break;
+        case '<': type = TokenType::LessThan; break;
+        case '>': type = TokenType::GreaterThan; break;
+        case '^': type = TokenType::Caret; break;
+        case '~': type = TokenType::Tilde; break;
+        case '|': type = TokenType::Pipe; break;
+        case '\\': type = TokenType::Backslash; break;
+        case '/': type = TokenType::ForwardSlash; break;
+        case '`': type = TokenType::Backtick; break;
+        case '"': type = TokenType::DoubleQuote; break;
+        case '\'': type = TokenType::SingleQuote; break;
+        default: type = TokenType::Invalid; break;
     }
+    return Token(type, slice(start.offset, position_), start, getCurrentMark());
 }
 
 Token Tokenizer::readComment() {
-    SourceLocation start = getCurrentLocation();
-    String value;
-    
-    char c = currentChar();
+    SourceMark start = getCurrentMark();
     advance();
     
     if (hasMoreTokens() && currentChar() == '/') {
         // Line comment
         advance();
-        while (hasMoreTokens() && !isNewline(currentChar())) {
-            value += currentChar();
-            advance();
-        }
-        SourceLocation end = getCurrentLocation();
-        return Token(TokenType::LineComment, value, TokenPosition(start, end));
+        size_t begin = position_;
+        size_t end = findLineEnd(source_, position_);
+        column_ += static_cast<uint32_t>(end - position_);
+        position_ = end;
+        return Token(TokenType::LineComment, slice(begin, position_), start, getCurrentMark());
     } else if (hasMoreTokens() && currentChar() == '*') {
         // Block comment
         advance();
-        while (hasMoreTokens()) {
-            char c = currentChar();
-            if (c == '*' && hasMoreTokens() && nextChar() == '/') {
-                advance(); // Skip *
-                advance(); // Skip /
-                break;
-            }
-            value += c;
-            advance();
-        }
-        SourceLocation end = getCurrentLocation();
-        return Token(TokenType::BlockComment, value, TokenPosition(start, end));
+        size_t begin = position_;
+        size_t end = findBlockCommentEnd(source_, position_);
+        advanceTo(std::min(end + 2, source_.length())); // Through */
+        return Token(TokenType::BlockComment, slice(begin, end), start, getCurrentMark());
     }
     
-    SourceLocation end = getCurrentLocation();
-    return Token(TokenType::Invalid, value, TokenPosition(start, end));
+    return Token(TokenType::Invalid, std::string_view(), start, getCurrentMark());
 }
 
 Token Tokenizer::readTemplateLiteral() {
-    SourceLocation start = getCurrentLocation();
-    String value;
+    SourceMark start = getCurrentMark();
     
     advance(); // Skip opening backtick
+    size_t begin = position_;
+    size_t end = scanTemplateBody(source_, begin);
+    advanceTo(end);
     
-    while (hasMoreTokens() && currentChar() != '`') {
-        char c = currentChar();
-        if (c == '\\') {
-            advance();
-            if (hasMoreTokens()) {
-                char escaped = currentChar();
-                value += escaped;
-                advance();
+    if (hasMoreTokens() && currentChar() == '`') {
+        advance(); // Skip closing backtick
+    }
+    
+    return Token(TokenType::TemplateLiteral, slice(begin, end), start, getCurrentMark());
+}
+
+size_t Tokenizer::scanTemplateBody(std::string_view text, size_t position) {
+    while ((position = findTemplateStop(text, position)) < text.size() && text[position] != '`') {
+        if (text[position] == '\\') {
+            position += 2;
+        } else if (position + 1 < text.size() && text[position + 1] == '{') {
+            // A '$', which only opens a substitution before '{'
+            position = scanTemplateSubstitution(text, position + 2);
+        } else {
+            position++;
+        }
+    }
+    return std::min(position, text.size());
+}
+
+// Balances braces while skipping string literals, comments and nested
+// templates, which may contain unbalanced ones
+size_t Tokenizer::scanTemplateSubstitution(std::string_view text, size_t position) {
+    size_t depth = 0;
+    while (position < text.size()) {
+        char c = text[position];
+        if (c == '}') {
+            if (depth == 0) {
+                return position + 1;
             }
-        } else if (c == '$' && hasMoreTokens() && nextChar() == '{') {
-            // Template literal expression
-            value += "${";
-            advance();
-            advance();
+            depth--;
+            position++;
+        } else if (c == '{') {
+            depth++;
+            position++;
+        } else if (c == '\'' || c == '"') {
+            position++;
+            while (position < text.size() && text[position] != c && text[position] != '\n') {
+                position += text[position] == '\\' ? 2 : 1;
+            }
+            position++;
+        } else if (c == '`') {
+            position = scanTemplateBody(text, position + 1) + 1;
+        } else if (c == '/' && position + 1 < text.size() && text[position + 1] == '/') {
+            while (position < text.size() && text[position] != '\n') {
+                position++;
+            }
+        } else if (c == '/' && position + 1 < text.size() && text[position + 1] == '*') {
+            size_t close = text.find("*/", position + 2);
+            position = close == std::string_view::npos ? text.size() : close + 2;
         } else {
-            value += c;
-            advance();
+            position++;
         }
     }
-    
-    if (hasMoreTokens() && currentChar() == '`') {
-        advance(); // Skip closing backtick
+    return text.size();
+}
+
+std::string Tokenizer::cookTemplateSpan(std::string_view raw) {
+    std::string cooked;
+    cooked.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] == '\\' && i + 1 < raw.size()) {
+            ++i;
+            // A backslash-newline is a line continuation
+            if (raw[i] != '\n') {
+                cooked += unescape(raw[i]);
+            }
+        } else if (raw[i] == '\r') {
+            // Template line terminators are normalised to \n
+            cooked += '\n';
+            if (i + 1 < raw.size() && raw[i + 1] == '\n') {
+                ++i;
+            }
+        } else {
+            cooked += raw[i];
+        }
     }
-    
-    SourceLocation end = getCurrentLocation();
-    return Token(TokenType::TemplateLiteral, value, TokenPosition(start, end));
+    return cooked;
 }
 
 Token Tokenizer::readRegExp() {
-    SourceLocation start = getCurrentLocation();
-    String value;
+    SourceMark start = getCurrentMark();
     
     advance(); // Skip opening slash
+    size_t begin = position_;
+    bool hasEscapes = false;
+    std::string cooked;
     
     while (hasMoreTokens() && currentChar() != '/') {
         char c = currentChar();
         if (c == '\\') {
+            if (!hasEscapes) {
+                cooked.assign(source_, begin, position_ - begin);
+                hasEscapes = true;
+            }
             advance();
             if (hasMoreTokens()) {
-                char escaped = currentChar();
-                value += escaped;
+                cooked += currentChar();
                 advance();
             }
         } else {
-            value += c;
+            if (hasEscapes) {
+                cooked += c;
+            }
             advance();
         }
     }
+    size_t end = position_;
     
     if (hasMoreTokens() && currentChar() == '/') {
         advance(); // Skip closing slash
     }
     
-    // Read flags
+    // Read flags; they follow the closing slash, so the value is no longer
+    // a contiguous slice of the source
+    size_t flags = position_;
     while (hasMoreTokens() && isLetter(currentChar())) {
-        value += currentChar();
         advance();
     }
     
-    SourceLocation end = getCurrentLocation();
-    return Token(TokenType::RegExpLiteral, value, TokenPosition(start, end));
+    if (!hasEscapes && flags == position_) {
+        return Token(TokenType::RegExpLiteral, slice(begin, end), start, getCurrentMark());
+    }
+    if (!hasEscapes) {
+        cooked.assign(source_, begin, end - begin);
+    }
+    cooked.append(source_, flags, position_ - flags);
+    return Token(TokenType::RegExpLiteral, cook(std::move(cooked)), start, getCurrentMark());
+}
+
+std::string_view Tokenizer::slice(size_t begin, size_t end) const {
+    return std::string_view(source_).substr(begin, end - begin);
+}
+
+std::string_view Tokenizer::cook(std::string value) {
+    cooked_.push_back(std::move(value));
+    return cooked_.back();
 }
 
 char Tokenizer::currentChar() const {
@@ -599,22 +693,53 @@ char Tokenizer::peekChar(size_t offset) const {
     return (position_ + offset < source_.length()) ? source_[position_ + offset] : '\0';
 }
 
+// Line and column are tracked as the scanner moves, so positions cost
+// nothing to produce
 void Tokenizer::advance() {
     if (hasMoreTokens()) {
+        if (source_[position_] == '\n') {
+            line_++;
+            column_ = 1;
+        } else {
+            column_++;
+        }
         position_++;
     }
 }
 
 void Tokenizer::advance(size_t count) {
-    for (size_t i = 0; i < count && hasMoreTokens(); ++i) {
-        advance();
+    advanceTo(position_ + std::min(count, source_.length() - position_));
+}
+
+void Tokenizer::advanceTo(size_t end) {
+    const char* text = source_.data();
+    const char* lineStart = nullptr;
+    const char* cursor = text + position_;
+    const char* last = text + end;
+    while (const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', last - cursor))) {
+        line_++;
+        lineStart = newline + 1;
+        cursor = lineStart;
     }
+    column_ = lineStart ? static_cast<uint32_t>(last - lineStart + 1) : column_ + static_cast<uint32_t>(last - cursor);
+    position_ = end;
 }
 
 void Tokenizer::retreat() {
-    if (position_ > 0) {
-        position_--;
+    if (position_ == 0) {
+        return;
     }
+    position_--;
+    if (source_[position_] != '\n') {
+        column_--;
+        return;
+    }
+    line_--;
+    size_t lineStart = position_;
+    while (lineStart > 0 && source_[lineStart - 1] != '\n') {
+        lineStart--;
+    }
+    column_ = static_cast<uint32_t>(position_ - lineStart + 1);
 }
 
 void Tokenizer::retreat(size_t count) {
@@ -731,49 +856,26 @@ TokenPosition Tokenizer::getCurrentPosition() const {
 }
 
 SourceLocation Tokenizer::getCurrentLocation() const {
-    size_t line = 1;
-    size_t column = 1;
-    
-    for (size_t i = 0; i < position_; ++i) {
-        if (source_[i] == '\n') {
-            line++;
-            column = 1;
-        } else {
-            column++;
-        }
-    }
-    
-    return SourceLocation(line, column, position_, filename_);
-}
-
-bool Tokenizer::isKeyword(const String& value) const {
-    static const std::unordered_map<String, bool> keywords = {
-        {"break", true}, {"case", true}, {"catch", true}, {"class", true}, {"const", true},
-        {"continue", true}, {"debugger", true}, {"default", true}, {"delete", true}, {"do", true},
-        {"else", true}, {"export", true}, {"extends", true}, {"finally", true}, {"for", true},
-        {"function", true}, {"if", true}, {"import", true}, {"in", true}, {"instanceof", true},
-        {"let", true}, {"new", true}, {"return", true}, {"super", true}, {"switch", true},
-        {"this", true}, {"throw", true}, {"try", true}, {"typeof", true}, {"var", true},
-        {"void", true}, {"while", true}, {"with", true}, {"yield", true}, {"await", true},
-        {"async", true}, {"static", true}, {"public", true}, {"private", true}, {"protected", true},
-        {"abstract", true}, {"interface", true}, {"enum", true}, {"namespace", true}, {"module", true},
-        {"implements", true}, {"package", true}, {"declare", true}, {"global", true}, {"ambient", true},
-        {"readonly", true}, {"override", true}, {"virtual", true}, {"sealed", true}, {"final", true},
-        {"volatile", true}, {"transient", true}, {"native", true}, {"synchronized", true}, {"strictfp", true}
-    };
-    
-    return keywords.find(value) != keywords.end();
+    return SourceLocation(line_, column_, position_, filename_);
 }
 
-bool Tokenizer::isReservedWord(const String& value) const {
-    static const std::unordered_map<String, bool> reservedWords = {
-        {"abstract", true}, {"arguments", true}, {"boolean", true}, {"byte", true}, {"char", true},
-        {"double", true}, {"eval", true}, {"float", true}, {"goto", true}, {"int", true},
-        {"long", true}, {"native", true}, {"short", true}, {"synchronized", true}, {"throws", true},
-        {"transient", true}, {"volatile", true}
-    };
-    
-    return reservedWords.find(value) != reservedWords.end();
+SourceMark Tokenizer::getCurrentMark() const {
+    return SourceMark{static_cast<uint32_t>(position_), line_, column_};
+}
+
+bool Tokenizer::isKeyword(std::string_view value) const {
+    const KeywordEntry* keyword = findKeyword(value);
+    return keyword && keyword->type == TokenType::Keyword;
+}
+
+// Words on both lists scan as keywords
+bool Tokenizer::isReservedWord(std::string_view value) const {
+    const KeywordEntry* keyword = findKeyword(value);
+    if (!keyword) {
+        return false;
+    }
+    return keyword->type == TokenType::ReservedWord || value == "abstract" || value == "native" ||
+           value == "synchronized" || value == "transient" || value == "volatile";
 }
 
 bool Tokenizer::isOperator(const String& value) const {
@@ -38,19 +38,6 @@ bool Value::is_function() const {
     return type_ == ValueType::Function;
 }
 
-// String implementation
-String::String(const std::string& value) : Value(ValueType::String), value_(value) {}
-
-String::~String() {}
-
-std::string String::get_value() const {
-    return value_;
-}
-
-void String::set_value(const std::string& value) {
-    value_ = value;
-}
-
 // Number implementation
 Number::Number(double value) : Value(ValueType::Number), value_(value) {}
 
@@ -0,0 +1,1788 @@
+#include "js/vm.h"
+#include "js/array.h"
+#include "js/compiler.h"
+#include "js/context.h"
+#include "js/coroutine.h"
+#include "js/event_loop.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Threaded dispatch through a label table where the compiler supports it;
+// define JS_VM_COMPUTED_GOTO=0 to force the portable switch loop.
+#ifndef JS_VM_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define JS_VM_COMPUTED_GOTO 1
+#else
+#define JS_VM_COMPUTED_GOTO 0
+#endif
+#endif
+
+namespace js {
+
+namespace {
+
+// Integer fast-path results that may overflow the int32 encoding
+inline JSValue int32OrDouble(int64_t value) {
+    if (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max()) {
+        return JSValue::int32(static_cast<int32_t>(value));
+    }
+    return JSValue::fromDouble(static_cast<double>(value));
+}
+
+inline JSValue multiplyInt32(int64_t lhs, int64_t rhs) {
+    int64_t product = lhs * rhs;
+    if (product == 0 && (lhs < 0 || rhs < 0)) {
+        return JSValue::fromDouble(-0.0);
+    }
+    return int32OrDouble(product);
+}
+
+inline JSValue moduloInt32(int64_t lhs, int64_t rhs) {
+    if (rhs == 0 || lhs < 0) {
+        return JSValue::number(std::fmod(static_cast<double>(lhs), static_cast<double>(rhs)));
+    }
+    return JSValue::int32(static_cast<int32_t>(lhs % rhs));
+}
+
+inline bool isArray(JSValue value) {
+    return value.isObject() && value.asObject()->type() == ValueType::Array;
+}
+
+// Typed arrays are plain objects to the shape system, so only objects that
+// fail the Array check pay for the cast
+inline TypedArray* asTypedArray(JSValue value) {
+    return value.isObject() ? dynamic_cast<TypedArray*>(value.asObject()) : nullptr;
+}
+
+inline BytecodeClosure* asBytecodeClosure(JSValue value) {
+    if (!value.isObject() || value.asObject()->type() != ValueType::Function) {
+        return nullptr;
+    }
+    return dynamic_cast<BytecodeClosure*>(value.asObject());
+}
+
+inline bool isCallable(JSValue value) {
+    return value.isObject() && value.asObject()->type() == ValueType::Function;
+}
+
+inline PromiseObject* asPromise(JSValue value) {
+    return value.isObject() ? dynamic_cast<PromiseObject*>(value.asObject()) : nullptr;
+}
+
+inline Coroutine* asGenerator(JSValue value) {
+    auto* coroutine = value.isObject() ? dynamic_cast<Coroutine*>(value.asObject()) : nullptr;
+    return coroutine && coroutine->kind() == Coroutine::Kind::Generator ? coroutine : nullptr;
+}
+
+} // namespace
+
+// NativeFunction
+
+NativeFunction::NativeFunction(std::string name, NativeCallback callback)
+    : Object(), name_(std::move(name)), callback_(std::move(callback)), rebinder_() {
+    type_ = ValueType::Function;
+}
+
+std::string NativeFunction::toString() const {
+    return "function " + name_ + "() { [native code] }";
+}
+
+std::unique_ptr<Value> NativeFunction::clone() const {
+    auto copy = std::make_unique<NativeFunction>(name_, callback_);
+    copy->setRebinder(rebinder_);
+    return copy;
+}
+
+std::unique_ptr<Value> NativeFunction::deepClone() const {
+    return clone();
+}
+
+// BytecodeClosure
+
+BytecodeClosure::BytecodeClosure(VM* vm, std::shared_ptr<BytecodeFunction> function,
+                                 std::shared_ptr<ClosureScope> scope, JSValue boundThis)
+    : Object(), vm_(vm), function_(std::move(function)), scope_(std::move(scope)), boundThis_(boundThis) {
+    type_ = ValueType::Function;
+}
+
+std::unique_ptr<Value> BytecodeClosure::call(const std::vector<std::unique_ptr<Value>>& arguments) {
+    return call(nullptr, arguments);
+}
+
+std::unique_ptr<Value> BytecodeClosure::call(std::unique_ptr<Value> thisValue, const std::vector<std::unique_ptr<Value>>& arguments) {
+    GC& heap = vm_->heap();
+    std::vector<JSValue> boxed;
+    boxed.reserve(arguments.size());
+    for (const auto& argument : arguments) {
+        boxed.push_back(argument ? JSValue::fromValue(*argument, heap) : JSValue::undefined());
+    }
+    JSValue self = thisValue ? JSValue::fromValue(std::move(thisValue), heap) : JSValue::undefined();
+    return vm_->call(*this, self, boxed.data(), boxed.size()).toValue();
+}
+
+std::unique_ptr<Value> BytecodeClosure::construct(const std::vector<std::unique_ptr<Value>>& arguments) {
+    GC& heap = vm_->heap();
+    std::vector<JSValue> boxed;
+    boxed.reserve(arguments.size());
+    for (const auto& argument : arguments) {
+        boxed.push_back(argument ? JSValue::fromValue(*argument, heap) : JSValue::undefined());
+    }
+    return vm_->call(*this, JSValue::undefined(), boxed.data(), boxed.size(), true).toValue();
+}
+
+std::string BytecodeClosure::toString() const {
+    return "function " + function_->name + "() { [bytecode] }";
+}
+
+std::unique_ptr<Value> BytecodeClosure::clone() const {
+    return std::make_unique<BytecodeClosure>(vm_, function_, scope_, boundThis_);
+}
+
+std::unique_ptr<Value> BytecodeClosure::deepClone() const {
+    return clone();
+}
+
+void BytecodeClosure::traceChildren(GC& gc) const {
+    Object::traceChildren(gc);
+    gc.markValue(boundThis_);
+    if (scope_) {
+        scope_->trace(gc);
+    }
+}
+
+// ClosureScope
+
+void ClosureScope::trace(GC& gc) {
+    for (ClosureScope* scope = this; scope && scope->markEpoch != gc.epoch(); scope = scope->parent.get()) {
+        scope->markEpoch = gc.epoch();
+        for (JSValue value : scope->slots) {
+            gc.markValue(value);
+        }
+    }
+}
+
+// VM
+
+VM::VM(GC& heap)
+    : heap_(heap), context_(nullptr), profiler_(nullptr), optimizer_(nullptr), eventLoop_(nullptr),
+      generatorNext_(nullptr), generatorReturn_(nullptr), generatorThrow_(nullptr), promiseThen_(nullptr),
+      promiseCatch_(nullptr), rootsId_(0), nativeDepth_(0), interruptRequested_(false),
+      interruptMutex_(), interrupts_(), terminating_(false), maxCallDepth_(10000),
+      executedInstructions_(0), callCount_(0), cacheHits_(0), cacheMisses_(0) {
+    static const char* const names[] = {"undefined", "boolean", "number", "string", "object", "function"};
+    for (size_t i = 0; i < 6; ++i) {
+        typeNames_[i] = heap_.internedString(names[i]);
+    }
+    installCoroutineMethods();
+    rootsId_ = heap_.addRoots([this](GC& gc) { traceRoots(gc); });
+}
+
+VM::~VM() {
+    heap_.removeRoots(rootsId_);
+}
+
+JSValue VM::execute(std::shared_ptr<BytecodeFunction> function, Context* context) {
+    context_ = context;
+    size_t entryDepth = frames_.size();
+    size_t base = frames_.empty() ? 0 : frames_.back().base + frames_.back().function->registerCount;
+
+    BytecodeClosure script(this, std::move(function), nullptr);
+    pushFrame(script, JSValue::undefined(), base, 0, false);
+    return run(entryDepth);
+}
+
+JSValue VM::call(const BytecodeClosure& closure, JSValue thisValue, const JSValue* arguments, size_t count,
+                 bool isConstruct) {
+    size_t entryDepth = frames_.size();
+    size_t base = frames_.empty() ? 0 : frames_.back().base + frames_.back().function->registerCount;
+
+    // Coroutine cells refer back to the closure, which is always a heap
+    // cell for generator and async functions
+    auto& callee = const_cast<BytecodeClosure&>(closure);
+    const BytecodeFunction& function = *closure.function();
+    if ((function.isGenerator || function.isAsync) && isConstruct) {
+        throw std::runtime_error("TypeError: " + function.name + " is not a constructor");
+    }
+    if (function.isGenerator) {
+        return startGenerator(callee, thisValue, arguments, count);
+    }
+
+    if (isConstruct) {
+        thisValue = heap_.object();
+    }
+    pushFrame(closure, thisValue, base, 0, isConstruct);
+    if (function.isAsync) {
+        startAsync(callee);
+    }
+
+    size_t params = std::min<size_t>(count, closure.function()->paramCount);
+    std::copy(arguments, arguments + params, registers_.begin() + static_cast<std::ptrdiff_t>(base));
+    return run(entryDepth);
+}
+
+JSValue VM::callValue(JSValue callee, JSValue thisValue, const JSValue* arguments, size_t count) {
+    if (BytecodeClosure* closure = asBytecodeClosure(callee)) {
+        return call(*closure, thisValue, arguments, count);
+    }
+    return callHost(callee, thisValue, arguments, count, false);
+}
+
+void VM::setOptimizer(Optimizer* optimizer) {
+    optimizer_ = optimizer;
+    if (optimizer_) {
+        BaselineHelpers helpers;
+        helpers.loadName = &VM::baselineHelper<Opcode::LoadName>;
+        helpers.storeName = &VM::baselineHelper<Opcode::StoreName>;
+        helpers.declareName = &VM::baselineHelper<Opcode::DeclareName>;
+        helpers.loadSlot = &VM::baselineHelper<Opcode::LoadSlot>;
+        helpers.storeSlot = &VM::baselineHelper<Opcode::StoreSlot>;
+        helpers.getProperty = &VM::baselineHelper<Opcode::GetProperty>;
+        helpers.setProperty = &VM::baselineHelper<Opcode::SetProperty>;
+        helpers.getElement = &VM::baselineHelper<Opcode::GetElement>;
+        helpers.setElement = &VM::baselineHelper<Opcode::SetElement>;
+        optimizer_->setHelpers(helpers);
+    }
+}
+
+void VM::resetStatistics() {
+    executedInstructions_ = 0;
+    callCount_ = 0;
+    cacheHits_ = 0;
+    cacheMisses_ = 0;
+}
+
+// Frames
+
+void VM::pushFrame(const BytecodeClosure& closure, JSValue thisValue, size_t base,
+                   uint16_t returnRegister, bool isConstruct) {
+    if (frames_.size() >= maxCallDepth_) {
+        throw std::runtime_error("RangeError: Maximum call stack size exceeded");
+    }
+
+    const auto& function = closure.function();
+    if (function->lazy) {
+        Compiler::compileLazy(*function);
+    }
+    if (function->constantValues.size() != function->constants.size()) {
+        materializeConstants(*function);
+    }
+    if (optimizer_) {
+        optimizer_->onCall(*function);
+    }
+
+    size_t top = base + function->registerCount;
+    if (registers_.size() < top) {
+        registers_.resize(std::max(top, registers_.size() * 2));
+    }
+
+    Frame frame;
+    frame.function = function;
+    frame.capturedScope = closure.scope();
+    frame.scope = function->usesNamedScope ? std::make_shared<ClosureScope>(function->scope, closure.scope())
+                                           : closure.scope();
+    frame.thisValue = function->isArrow ? closure.boundThis() : thisValue;
+    frame.base = base;
+    frame.pc = 0;
+    frame.returnRegister = returnRegister;
+    frame.isConstruct = isConstruct;
+    frame.coroutine = nullptr;
+    frames_.push_back(std::move(frame));
+    ++callCount_;
+}
+
+void VM::popFrame() {
+    Frame& frame = frames_.back();
+    size_t index = frames_.size() - 1;
+    while (!handlers_.empty() && handlers_.back().frameIndex >= index) {
+        handlers_.pop_back();
+    }
+    // Suspension saves the frame first; anything else ends the coroutine
+    if (frame.coroutine && frame.coroutine->state() == Coroutine::State::Executing) {
+        frame.coroutine->setState(Coroutine::State::Completed);
+    }
+    // Cleared windows keep the register stack free of stale cell pointers
+    auto begin = registers_.begin() + static_cast<std::ptrdiff_t>(frame.base);
+    std::fill(begin, begin + frame.function->registerCount, JSValue::undefined());
+    frames_.pop_back();
+}
+
+void VM::materializeConstants(BytecodeFunction& function) {
+    function.constantValues.clear();
+    function.constantValues.reserve(function.constants.size());
+    for (const Constant& constant : function.constants) {
+        if (constant.kind == Constant::Kind::Number) {
+            function.constantValues.push_back(JSValue::number(constant.number));
+        } else {
+            // Interned (pinned) so cached functions never see a dead constant
+            function.constantValues.push_back(heap_.internedString(constant.string));
+        }
+    }
+}
+
+// Coroutines
+
+void VM::installCoroutineMethods() {
+    auto method = [this](const char* name, NativeCallback callback) {
+        auto* function = heap_.allocate<NativeFunction>(name, std::move(callback));
+        heap_.pin(function);
+        return function;
+    };
+    auto generatorMethod = [this, &method](const char* name, ResumeMode mode) {
+        return method(name, [this, name, mode](JSValue thisValue, const JSValue* arguments, size_t count) {
+            Coroutine* generator = asGenerator(thisValue);
+            if (!generator) {
+                throw std::runtime_error(std::string("TypeError: Generator.prototype.") + name +
+                                         " called on a non-generator");
+            }
+            return resumeFromHost(*generator, mode, count > 0 ? arguments[0] : JSValue::undefined());
+        });
+    };
+    generatorNext_ = generatorMethod("next", ResumeMode::Next);
+    generatorReturn_ = generatorMethod("return", ResumeMode::Return);
+    generatorThrow_ = generatorMethod("throw", ResumeMode::Throw);
+
+    auto promiseMethod = [this, &method](const char* name, bool catchOnly) {
+        return method(name, [this, name, catchOnly](JSValue thisValue, const JSValue* arguments, size_t count) {
+            PromiseObject* promise = asPromise(thisValue);
+            if (!promise) {
+                throw std::runtime_error(std::string("TypeError: Promise.prototype.") + name +
+                                         " called on a non-promise");
+            }
+            JSValue onFulfilled = !catchOnly && count > 0 ? arguments[0] : JSValue::undefined();
+            JSValue onRejected = catchOnly ? (count > 0 ? arguments[0] : JSValue::undefined())
+                                           : (count > 1 ? arguments[1] : JSValue::undefined());
+            PromiseObject* derived = newPromise();
+            subscribe(promise, onFulfilled, onRejected, derived, nullptr);
+            return JSValue::object(derived);
+        });
+    };
+    promiseThen_ = promiseMethod("then", false);
+    promiseCatch_ = promiseMethod("catch", true);
+}
+
+JSValue VM::startGenerator(BytecodeClosure& closure, JSValue thisValue, const JSValue* arguments, size_t count) {
+    auto* generator = heap_.allocate<Coroutine>(Coroutine::Kind::Generator, &closure, thisValue, nullptr);
+    generator->setArguments(arguments, std::min<size_t>(count, closure.function()->paramCount));
+    return JSValue::object(generator);
+}
+
+// Called right after the async function's frame is pushed
+void VM::startAsync(BytecodeClosure& closure) {
+    Frame& frame = frames_.back();
+    frame.coroutine = heap_.allocate<Coroutine>(Coroutine::Kind::Async, &closure, frame.thisValue, newPromise());
+}
+
+VM::ResumeResult VM::resumeCoroutine(Coroutine& coroutine, ResumeMode mode, JSValue value, size_t base,
+                                     uint16_t returnRegister, JSValue& result) {
+    using State = Coroutine::State;
+    if (coroutine.state() == State::Executing) {
+        throw std::runtime_error("TypeError: Generator is already running");
+    }
+
+    // return() runs no finally blocks: the generator just completes
+    if (coroutine.state() == State::Completed || mode == ResumeMode::Return ||
+        (coroutine.state() == State::SuspendedStart && mode == ResumeMode::Throw)) {
+        coroutine.setState(State::Completed);
+        coroutine.releaseFrame();
+        if (mode == ResumeMode::Throw) {
+            pending_ = value;
+            return ResumeResult::Threw;
+        }
+        result = iteratorResult(mode == ResumeMode::Return ? value : JSValue::undefined(), true);
+        return ResumeResult::Finished;
+    }
+
+    BytecodeClosure& closure = *coroutine.closure();
+    if (coroutine.state() == State::SuspendedStart) {
+        pushFrame(closure, coroutine.thisValue(), base, returnRegister, false);
+        std::copy(coroutine.registers().begin(), coroutine.registers().end(),
+                  registers_.begin() + static_cast<std::ptrdiff_t>(base));
+    } else {
+        if (frames_.size() >= maxCallDepth_) {
+            throw std::runtime_error("RangeError: Maximum call stack size exceeded");
+        }
+        const auto& function = closure.function();
+        size_t top = base + function->registerCount;
+        if (registers_.size() < top) {
+            registers_.resize(std::max(top, registers_.size() * 2));
+        }
+
+        Frame frame;
+        frame.function = function;
+        frame.capturedScope = closure.scope();
+        frame.scope = coroutine.scope();
+        frame.thisValue = coroutine.thisValue();
+        frame.base = base;
+        frame.pc = coroutine.pc();
+        frame.returnRegister = returnRegister;
+        frame.isConstruct = false;
+        frame.coroutine = nullptr;
+        frames_.push_back(std::move(frame));
+        ++callCount_;
+
+        std::copy(coroutine.registers().begin(), coroutine.registers().end(),
+                  registers_.begin() + static_cast<std::ptrdiff_t>(base));
+        for (const Coroutine::SavedHandler& handler : coroutine.handlers()) {
+            handlers_.push_back(Handler{frames_.size() - 1, handler.target, handler.exceptionRegister});
+        }
+        if (mode == ResumeMode::Next) {
+            registers_[base + coroutine.resumeRegister()] = value;
+        }
+    }
+
+    coroutine.releaseFrame();
+    coroutine.setState(State::Executing);
+    frames_.back().coroutine = &coroutine;
+    if (mode == ResumeMode::Throw) {
+        pending_ = value;
+        return ResumeResult::Threw;
+    }
+    return ResumeResult::Resumed;
+}
+
+JSValue VM::resumeFromHost(Coroutine& coroutine, ResumeMode mode, JSValue value) {
+    size_t entryDepth = frames_.size();
+    size_t base = frames_.empty() ? 0 : frames_.back().base + frames_.back().function->registerCount;
+
+    JSValue result;
+    switch (resumeCoroutine(coroutine, mode, value, base, 0, result)) {
+        case ResumeResult::Finished:
+            return result;
+        case ResumeResult::Resumed:
+            return run(entryDepth);
+        case ResumeResult::Threw:
+            break;
+    }
+    switch (unwind(entryDepth, result)) {
+        case Unwind::Handled:
+            return run(entryDepth);
+        case Unwind::Returned:
+            return result;
+        case Unwind::Uncaught:
+            break;
+    }
+    throw ThrownValue(pending_);
+}
+
+// The frame's handlers are the innermost entries of handlers_, and its pc
+// was saved by the suspending instruction
+void VM::suspendCoroutine(uint16_t resumeRegister) {
+    Frame& frame = frames_.back();
+    size_t index = frames_.size() - 1;
+    size_t first = handlers_.size();
+    while (first > 0 && handlers_[first - 1].frameIndex == index) {
+        --first;
+    }
+    std::vector<Coroutine::SavedHandler> saved;
+    saved.reserve(handlers_.size() - first);
+    for (size_t i = first; i < handlers_.size(); ++i) {
+        saved.push_back(Coroutine::SavedHandler{handlers_[i].target, handlers_[i].exceptionRegister});
+    }
+
+    frame.coroutine->suspend(registers_.data() + frame.base, frame.function->registerCount, frame.pc, frame.scope,
+                             std::move(saved), resumeRegister);
+    popFrame();
+}
+
+JSValue VM::completeCoroutine(Coroutine& coroutine, JSValue value) {
+    coroutine.setState(Coroutine::State::Completed);
+    if (coroutine.kind() == Coroutine::Kind::Generator) {
+        return iteratorResult(value, true);
+    }
+    resolvePromise(coroutine.promise(), value);
+    return JSValue::object(coroutine.promise());
+}
+
+JSValue VM::iteratorResult(JSValue value, bool done) {
+    JSValue result = heap_.object();
+    result.asObject()->put("value", value);
+    result.asObject()->put("done", JSValue::boolean(done));
+    return result;
+}
+
+JSValue VM::coroutineMethod(Object* cell, const std::string& name) const {
+    if (auto* coroutine = dynamic_cast<Coroutine*>(cell)) {
+        if (coroutine->kind() != Coroutine::Kind::Generator) {
+            return JSValue::empty();
+        }
+        if (name == "next") {
+            return JSValue::object(generatorNext_);
+        }
+        if (name == "return") {
+            return JSValue::object(generatorReturn_);
+        }
+        if (name == "throw") {
+            return JSValue::object(generatorThrow_);
+        }
+    } else if (dynamic_cast<PromiseObject*>(cell)) {
+        if (name == "then") {
+            return JSValue::object(promiseThen_);
+        }
+        if (name == "catch") {
+            return JSValue::object(promiseCatch_);
+        }
+    }
+    return JSValue::empty();
+}
+
+// Promises
+
+PromiseObject* VM::newPromise() {
+    return heap_.allocate<PromiseObject>();
+}
+
+void VM::resolvePromise(PromiseObject* promise, JSValue value) {
+    if (PromiseObject* other = asPromise(value)) {
+        if (other == promise) {
+            rejectPromise(promise, JSValue::object(heap_.allocate<Error>("TypeError: Chaining cycle detected for promise")));
+            return;
+        }
+        subscribe(other, JSValue::undefined(), JSValue::undefined(), promise, nullptr);
+        return;
+    }
+    settlePromise(promise, true, value);
+}
+
+void VM::rejectPromise(PromiseObject* promise, JSValue reason) {
+    settlePromise(promise, false, reason);
+}
+
+JSValue VM::createPromiseConstructor() {
+    auto* constructor = heap_.allocate<NativeFunction>("Promise",
+        [this](JSValue, const JSValue* arguments, size_t count) {
+            JSValue executor = count > 0 ? arguments[0] : JSValue::undefined();
+            if (!isCallable(executor)) {
+                throw std::runtime_error("TypeError: Promise resolver is not a function");
+            }
+            PromiseObject* promise = newPromise();
+            JSValue resolvers[2] = {
+                JSValue::object(heap_.allocate<PromiseResolvingFunction>("resolve", promise,
+                    [this, promise](JSValue, const JSValue* values, size_t valueCount) {
+                        resolvePromise(promise, valueCount > 0 ? values[0] : JSValue::undefined());
+                        return JSValue::undefined();
+                    })),
+                JSValue::object(heap_.allocate<PromiseResolvingFunction>("reject", promise,
+                    [this, promise](JSValue, const JSValue* values, size_t valueCount) {
+                        rejectPromise(promise, valueCount > 0 ? values[0] : JSValue::undefined());
+                        return JSValue::undefined();
+                    })),
+            };
+            try {
+                callValue(executor, JSValue::undefined(), resolvers, 2);
+            } catch (const ThrownValue& thrown) {
+                rejectPromise(promise, thrown.value());
+            }
+            return JSValue::object(promise);
+        });
+
+    constructor->put("resolve", JSValue::object(heap_.allocate<NativeFunction>("resolve",
+        [this](JSValue, const JSValue* arguments, size_t count) {
+            JSValue value = count > 0 ? arguments[0] : JSValue::undefined();
+            if (asPromise(value)) {
+                return value;
+            }
+            PromiseObject* promise = newPromise();
+            resolvePromise(promise, value);
+            return JSValue::object(promise);
+        })));
+    constructor->put("reject", JSValue::object(heap_.allocate<NativeFunction>("reject",
+        [this](JSValue, const JSValue* arguments, size_t count) {
+            PromiseObject* promise = newPromise();
+            rejectPromise(promise, count > 0 ? arguments[0] : JSValue::undefined());
+            return JSValue::object(promise);
+        })));
+    return JSValue::object(constructor);
+}
+
+// await on a non-promise waits one microtask for the value itself
+PromiseObject* VM::promiseFor(JSValue value) {
+    if (PromiseObject* promise = asPromise(value)) {
+        return promise;
+    }
+    PromiseObject* promise = newPromise();
+    promise->settle(PromiseObject::State::Fulfilled, value);
+    return promise;
+}
+
+void VM::settlePromise(PromiseObject* promise, bool fulfilled, JSValue value) {
+    auto state = fulfilled ? PromiseObject::State::Fulfilled : PromiseObject::State::Rejected;
+    for (const PromiseObject::Reaction& reaction : promise->settle(state, value)) {
+        scheduleReaction(promise, reaction.onFulfilled, reaction.onRejected, reaction.derived, reaction.coroutine);
+    }
+}
+
+void VM::subscribe(PromiseObject* promise, JSValue onFulfilled, JSValue onRejected, PromiseObject* derived,
+                   Coroutine* coroutine) {
+    if (!promise->addReaction(PromiseObject::Reaction{onFulfilled, onRejected, derived, coroutine})) {
+        scheduleReaction(promise, onFulfilled, onRejected, derived, coroutine);
+    }
+}
+
+// The job's values sit in a heap array the event loop retains until the
+// microtask has run: the settled promise, both handlers, the derived
+// promise and the awaiting coroutine
+void VM::scheduleReaction(PromiseObject* promise, JSValue onFulfilled, JSValue onRejected, PromiseObject* derived,
+                          Coroutine* coroutine) {
+    if (!eventLoop_) {
+        throw std::runtime_error("TypeError: promise reactions need an event loop");
+    }
+    JSValue job = heap_.array();
+    auto* elements = static_cast<Array*>(job.asObject());
+    elements->append(JSValue::object(promise));
+    elements->append(onFulfilled);
+    elements->append(onRejected);
+    elements->append(derived ? JSValue::object(derived) : JSValue::undefined());
+    elements->append(coroutine ? JSValue::object(coroutine) : JSValue::undefined());
+    eventLoop_->enqueueMicrotask([this, elements]() { runReaction(elements); }, job);
+}
+
+void VM::runReaction(Array* job) {
+    auto* promise = static_cast<PromiseObject*>(job->at(0).asObject());
+    bool fulfilled = promise->state() == PromiseObject::State::Fulfilled;
+    JSValue value = promise->result();
+
+    if (job->at(4).isObject()) {
+        resumeFromHost(*static_cast<Coroutine*>(job->at(4).asObject()),
+                       fulfilled ? ResumeMode::Next : ResumeMode::Throw, value);
+        return;
+    }
+
+    PromiseObject* derived = job->at(3).isObject() ? static_cast<PromiseObject*>(job->at(3).asObject()) : nullptr;
+    JSValue handler = job->at(fulfilled ? 1 : 2);
+    if (!isCallable(handler)) {
+        if (derived) {
+            settlePromise(derived, fulfilled, value);
+        }
+        return;
+    }
+
+    JSValue result;
+    try {
+        result = callValue(handler, JSValue::undefined(), &value, 1);
+    } catch (const ThrownValue& thrown) {
+        if (derived) {
+            rejectPromise(derived, thrown.value());
+        }
+        return;
+    } catch (const ExecutionTerminated&) {
+        throw;
+    } catch (const std::exception& e) {
+        if (derived) {
+            rejectPromise(derived, JSValue::object(heap_.allocate<Error>(e.what())));
+        }
+        return;
+    }
+    if (derived) {
+        resolvePromise(derived, result);
+    }
+}
+
+// Dispatch
+
+JSValue VM::run(size_t entryDepth) {
+    for (;;) {
+        try {
+            return dispatch(entryDepth);
+        } catch (const ExecutionTerminated&) {
+            // No handler runs; the frames of this entry are dropped as is
+            while (frames_.size() > entryDepth) {
+                popFrame();
+            }
+            pending_ = JSValue::undefined();
+            throw;
+        } catch (const ThrownValue& thrown) {
+            pending_ = thrown.value();
+        } catch (const std::exception& e) {
+            pending_ = JSValue::object(heap_.allocate<Error>(e.what()));
+        }
+
+        JSValue result;
+        switch (unwind(entryDepth, result)) {
+            case Unwind::Handled:
+                break;
+            case Unwind::Returned:
+                return result;
+            case Unwind::Uncaught:
+                throw ThrownValue(pending_);
+        }
+    }
+}
+
+// Frames are popped until one has a handler. An async function frame
+// stops the exception instead: its promise is rejected and the caller gets
+// the promise as the call's result.
+VM::Unwind VM::unwind(size_t entryDepth, JSValue& result) {
+    while (frames_.size() > entryDepth) {
+        Frame& frame = frames_.back();
+        if (!handlers_.empty() && handlers_.back().frameIndex == frames_.size() - 1) {
+            Handler handler = handlers_.back();
+            handlers_.pop_back();
+            frame.pc = handler.target;
+            registers_[frame.base + handler.exceptionRegister] = pending_;
+            pending_ = JSValue::undefined();
+            return Unwind::Handled;
+        }
+
+        if (frame.coroutine && frame.coroutine->kind() == Coroutine::Kind::Async) {
+            PromiseObject* promise = frame.coroutine->promise();
+            uint16_t returnRegister = frame.returnRegister;
+            JSValue reason = pending_;
+            pending_ = JSValue::undefined();
+            popFrame();
+            rejectPromise(promise, reason);
+            result = JSValue::object(promise);
+            if (frames_.size() == entryDepth) {
+                return Unwind::Returned;
+            }
+            registers_[frames_.back().base + returnRegister] = result;
+            return Unwind::Handled;
+        }
+        popFrame();
+    }
+    return Unwind::Uncaught;
+}
+
+#if JS_VM_COMPUTED_GOTO && defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+JSValue VM::dispatch(size_t entryDepth) {
+    Frame* frame = nullptr;
+    BytecodeFunction* fn = nullptr;
+    const Instruction* code = nullptr;
+    const Instruction* ip = nullptr;
+    const Instruction* insn = nullptr;
+    JSValue* regs = nullptr;
+
+    // Shared by Call / CallMethod / Construct
+    uint16_t callArgStart = 0;
+    bool callIsMethod = false;
+    bool callIsConstruct = false;
+
+#define VM_LOAD()                                       \
+    do {                                                \
+        frame = &frames_.back();                        \
+        fn = frame->function.get();                     \
+        code = fn->code.data();                         \
+        ip = code + frame->pc;                          \
+        regs = registers_.data() + frame->base;         \
+    } while (0)
+#define VM_SAVE() (frame->pc = static_cast<uint32_t>(ip - code))
+// Loop back-edges and calls; every live value is in a register here
+#define VM_SAFEPOINT()                                  \
+    do {                                                \
+        if (isSafepointRequested()) {                   \
+            VM_SAVE();                                  \
+            safepoint();                                \
+        }                                               \
+    } while (0)
+// Function entry and call return points continue in baseline code if the
+// current function has it
+#define VM_TRY_BASELINE()                               \
+    do {                                                \
+        if (fn->baseline && optimizer_ &&               \
+            optimizer_->isEnabled()) {                  \
+            goto enter_baseline;                        \
+        }                                               \
+    } while (0)
+
+#if JS_VM_COMPUTED_GOTO
+    static void* const dispatchTable[] = {
+        &&op_LoadConst, &&op_LoadUndefined, &&op_LoadNull, &&op_LoadTrue, &&op_LoadFalse, &&op_LoadThis,
+        &&op_LoadCallee, &&op_Move, &&op_LoadName, &&op_StoreName, &&op_DeclareName, &&op_LoadSlot,
+        &&op_StoreSlot, &&op_GetProperty,
+        &&op_SetProperty, &&op_GetElement, &&op_SetElement, &&op_Add, &&op_Subtract, &&op_Multiply,
+        &&op_Divide, &&op_Modulo, &&op_Exponent, &&op_BitwiseAnd, &&op_BitwiseOr, &&op_BitwiseXor,
+        &&op_LeftShift, &&op_RightShift, &&op_UnsignedRightShift, &&op_Equal, &&op_NotEqual,
+        &&op_StrictEqual, &&op_StrictNotEqual, &&op_LessThan, &&op_LessThanOrEqual, &&op_GreaterThan,
+        &&op_GreaterThanOrEqual, &&op_Negate, &&op_UnaryPlus, &&op_LogicalNot, &&op_BitwiseNot,
+        &&op_TypeOf, &&op_Increment, &&op_Decrement, &&op_Jump, &&op_JumpIfTrue, &&op_JumpIfFalse,
+        &&op_JumpIfNotNullish, &&op_Call, &&op_CallMethod, &&op_Construct, &&op_Return,
+        &&op_ReturnUndefined, &&op_NewObject, &&op_NewArray, &&op_ArrayPush, &&op_Closure, &&op_Throw,
+        &&op_PushHandler, &&op_PopHandler, &&op_Yield, &&op_Await, &&op_Debugger, &&op_Nop,
+    };
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == static_cast<size_t>(Opcode::Count),
+                  "dispatch table out of sync with Opcode");
+
+#define VM_CASE(name) op_##name:
+#define VM_NEXT()                                                           \
+    do {                                                                    \
+        insn = ip++;                                                        \
+        ++executedInstructions_;                                            \
+        goto *dispatchTable[static_cast<size_t>(insn->op)];                 \
+    } while (0)
+#else
+#define VM_CASE(name) case Opcode::name:
+#define VM_NEXT() goto next
+#endif
+
+// int32 operands take the inline path; everything else goes through ToNumber
+#define VM_ARITHMETIC(name, intExpr, numberExpr)                            \
+    VM_CASE(name) {                                                         \
+        JSValue lhs = regs[insn->b];                                        \
+        JSValue rhs = regs[insn->c];                                        \
+        if (lhs.isInt32() && rhs.isInt32()) {                               \
+            int64_t l = lhs.asInt32();                                      \
+            int64_t r = rhs.asInt32();                                      \
+            regs[insn->a] = (intExpr);                                      \
+        } else {                                                            \
+            double l = lhs.toNumber();                                      \
+            double r = rhs.toNumber();                                      \
+            regs[insn->a] = JSValue::number(numberExpr);                    \
+        }                                                                   \
+        VM_NEXT();                                                          \
+    }
+#define VM_NUMERIC(name, numberExpr)                                        \
+    VM_CASE(name) {                                                         \
+        double l = regs[insn->b].toNumber();                                \
+        double r = regs[insn->c].toNumber();                                \
+        regs[insn->a] = JSValue::number(numberExpr);                        \
+        VM_NEXT();                                                          \
+    }
+#define VM_BITWISE(name, expr)                                              \
+    VM_CASE(name) {                                                         \
+        int32_t l = regs[insn->b].toInt32();                                \
+        int32_t r = regs[insn->c].toInt32();                                \
+        regs[insn->a] = (expr);                                             \
+        VM_NEXT();                                                          \
+    }
+#define VM_COMPARE(name, intExpr, slowExpr)                                 \
+    VM_CASE(name) {                                                         \
+        JSValue lhs = regs[insn->b];                                        \
+        JSValue rhs = regs[insn->c];                                        \
+        if (lhs.isInt32() && rhs.isInt32()) {                               \
+            int32_t l = lhs.asInt32();                                      \
+            int32_t r = rhs.asInt32();                                      \
+            regs[insn->a] = JSValue::boolean(intExpr);                      \
+        } else {                                                            \
+            regs[insn->a] = JSValue::boolean(slowExpr);                     \
+        }                                                                   \
+        VM_NEXT();                                                          \
+    }
+
+    VM_LOAD();
+    VM_TRY_BASELINE();
+
+#if JS_VM_COMPUTED_GOTO
+    VM_NEXT();
+#else
+next:
+    insn = ip++;
+    ++executedInstructions_;
+    switch (insn->op) {
+#endif
+
+    // Loads and moves
+    VM_CASE(LoadConst) {
+        regs[insn->a] = fn->constantValues[insn->b];
+        VM_NEXT();
+    }
+    VM_CASE(LoadUndefined) {
+        regs[insn->a] = JSValue::undefined();
+        VM_NEXT();
+    }
+    VM_CASE(LoadNull) {
+        regs[insn->a] = JSValue::null();
+        VM_NEXT();
+    }
+    VM_CASE(LoadTrue) {
+        regs[insn->a] = JSValue::boolean(true);
+        VM_NEXT();
+    }
+    VM_CASE(LoadFalse) {
+        regs[insn->a] = JSValue::boolean(false);
+        VM_NEXT();
+    }
+    VM_CASE(LoadThis) {
+        regs[insn->a] = frame->thisValue;
+        VM_NEXT();
+    }
+    VM_CASE(LoadCallee) {
+        regs[insn->a] = JSValue::object(heap_.allocate<BytecodeClosure>(this, frame->function, frame->capturedScope));
+        VM_NEXT();
+    }
+    VM_CASE(Move) {
+        regs[insn->a] = regs[insn->b];
+        VM_NEXT();
+    }
+
+    // Named bindings
+    VM_CASE(LoadName) {
+        regs[insn->a] = loadName(fn->names[insn->b]);
+        VM_NEXT();
+    }
+    VM_CASE(StoreName) {
+        storeName(fn->names[insn->b], regs[insn->a]);
+        VM_NEXT();
+    }
+    VM_CASE(DeclareName) {
+        declareName(fn->names[insn->b], regs[insn->a]);
+        VM_NEXT();
+    }
+
+    // Resolved scope bindings
+    VM_CASE(LoadSlot) {
+        regs[insn->a] = frame->scope->ancestor(insn->b)->slots[insn->c];
+        VM_NEXT();
+    }
+    VM_CASE(StoreSlot) {
+        ClosureScope* scope = frame->scope->ancestor(insn->b);
+        scope->slots[insn->c] = regs[insn->a];
+        rememberScope(*frame, scope, regs[insn->a]);
+        VM_NEXT();
+    }
+
+    // Property access
+    VM_CASE(GetProperty) {
+        executeGetProperty(*fn, *insn, static_cast<uint32_t>(insn - code), regs);
+        VM_NEXT();
+    }
+    VM_CASE(SetProperty) {
+        executeSetProperty(*fn, *insn, static_cast<uint32_t>(insn - code), regs);
+        VM_NEXT();
+    }
+    VM_CASE(GetElement) {
+        executeGetElement(*insn, regs);
+        VM_NEXT();
+    }
+    VM_CASE(SetElement) {
+        executeSetElement(*insn, regs);
+        VM_NEXT();
+    }
+
+    // Arithmetic
+    VM_CASE(Add) {
+        JSValue lhs = regs[insn->b];
+        JSValue rhs = regs[insn->c];
+        if (lhs.isInt32() && rhs.isInt32()) {
+            regs[insn->a] = int32OrDouble(static_cast<int64_t>(lhs.asInt32()) + rhs.asInt32());
+        } else if (lhs.isNumber() && rhs.isNumber()) {
+            regs[insn->a] = JSValue::number(lhs.asNumber() + rhs.asNumber());
+        } else {
+            regs[insn->a] = addValues(lhs, rhs, heap_);
+        }
+        VM_NEXT();
+    }
+    VM_ARITHMETIC(Subtract, int32OrDouble(l - r), l - r)
+    VM_ARITHMETIC(Multiply, multiplyInt32(l, r), l * r)
+    VM_NUMERIC(Divide, l / r)
+    VM_ARITHMETIC(Modulo, moduloInt32(l, r), std::fmod(l, r))
+    VM_NUMERIC(Exponent, std::pow(l, r))
+
+    // Bitwise
+    VM_BITWISE(BitwiseAnd, JSValue::int32(l & r))
+    VM_BITWISE(BitwiseOr, JSValue::int32(l | r))
+    VM_BITWISE(BitwiseXor, JSValue::int32(l ^ r))
+    VM_BITWISE(LeftShift, JSValue::int32(static_cast<int32_t>(static_cast<uint32_t>(l) << (r & 31))))
+    VM_BITWISE(RightShift, JSValue::int32(l >> (r & 31)))
+    VM_BITWISE(UnsignedRightShift, JSValue::number(static_cast<double>(static_cast<uint32_t>(l) >> (r & 31))))
+
+    // Comparison
+    VM_COMPARE(Equal, l == r, lhs.looseEquals(rhs))
+    VM_COMPARE(NotEqual, l != r, !lhs.looseEquals(rhs))
+    VM_COMPARE(StrictEqual, l == r, lhs.strictEquals(rhs))
+    VM_COMPARE(StrictNotEqual, l != r, !lhs.strictEquals(rhs))
+    VM_COMPARE(LessThan, l < r, lessThan(lhs, rhs))
+    VM_COMPARE(LessThanOrEqual, l <= r, lessThanOrEqual(lhs, rhs))
+    VM_COMPARE(GreaterThan, l > r, lessThan(rhs, lhs))
+    VM_COMPARE(GreaterThanOrEqual, l >= r, lessThanOrEqual(rhs, lhs))
+
+    // Unary
+    VM_CASE(Negate) {
+        JSValue operand = regs[insn->b];
+        if (operand.isInt32() && operand.asInt32() != 0 && operand.asInt32() != std::numeric_limits<int32_t>::min()) {
+            regs[insn->a] = JSValue::int32(-operand.asInt32());
+        } else {
+            regs[insn->a] = JSValue::number(-operand.toNumber());
+        }
+        VM_NEXT();
+    }
+    VM_CASE(UnaryPlus) {
+        JSValue operand = regs[insn->b];
+        regs[insn->a] = operand.isNumber() ? operand : JSValue::number(operand.toNumber());
+        VM_NEXT();
+    }
+    VM_CASE(LogicalNot) {
+        regs[insn->a] = JSValue::boolean(!regs[insn->b].toBoolean());
+        VM_NEXT();
+    }
+    VM_CASE(BitwiseNot) {
+        regs[insn->a] = JSValue::int32(~regs[insn->b].toInt32());
+        VM_NEXT();
+    }
+    VM_CASE(TypeOf) {
+        regs[insn->a] = typeOf(regs[insn->b]);
+        VM_NEXT();
+    }
+    VM_CASE(Increment) {
+        JSValue operand = regs[insn->b];
+        if (operand.isInt32() && operand.asInt32() != std::numeric_limits<int32_t>::max()) {
+            regs[insn->a] = JSValue::int32(operand.asInt32() + 1);
+        } else {
+            regs[insn->a] = JSValue::number(operand.toNumber() + 1);
+        }
+        VM_NEXT();
+    }
+    VM_CASE(Decrement) {
+        JSValue operand = regs[insn->b];
+        if (operand.isInt32() && operand.asInt32() != std::numeric_limits<int32_t>::min()) {
+            regs[insn->a] = JSValue::int32(operand.asInt32() - 1);
+        } else {
+            regs[insn->a] = JSValue::number(operand.toNumber() - 1);
+        }
+        VM_NEXT();
+    }
+
+    // Control flow
+    VM_CASE(Jump) {
+        ip = code + insn->target();
+        if (ip <= insn) {
+            VM_SAFEPOINT();
+            if (optimizer_ && optimizer_->onBackEdge(*fn)) {
+                goto enter_baseline;
+            }
+        }
+        VM_NEXT();
+    }
+    VM_CASE(JumpIfTrue) {
+        if (regs[insn->a].toBoolean()) {
+            ip = code + insn->target();
+            if (ip <= insn) {
+                VM_SAFEPOINT();
+                if (optimizer_ && optimizer_->onBackEdge(*fn)) {
+                    goto enter_baseline;
+                }
+            }
+        }
+        VM_NEXT();
+    }
+    VM_CASE(JumpIfFalse) {
+        if (!regs[insn->a].toBoolean()) {
+            ip = code + insn->target();
+        }
+        VM_NEXT();
+    }
+    VM_CASE(JumpIfNotNullish) {
+        if (!regs[insn->a].isNullish()) {
+            ip = code + insn->target();
+        }
+        VM_NEXT();
+    }
+
+    // Calls
+    VM_CASE(Call) {
+        callArgStart = static_cast<uint16_t>(insn->b + 1);
+        callIsMethod = false;
+        callIsConstruct = false;
+        goto do_call;
+    }
+    VM_CASE(CallMethod) {
+        callArgStart = static_cast<uint16_t>(insn->b + 2);
+        callIsMethod = true;
+        callIsConstruct = false;
+        goto do_call;
+    }
+    VM_CASE(Construct) {
+        callArgStart = static_cast<uint16_t>(insn->b + 1);
+        callIsMethod = false;
+        callIsConstruct = true;
+        goto do_call;
+    }
+    VM_CASE(Return) {
+        JSValue result = regs[insn->a];
+        if (frame->isConstruct && !result.isObject()) {
+            result = frame->thisValue;
+        }
+        if (frame->coroutine) {
+            result = completeCoroutine(*frame->coroutine, result);
+        }
+        uint16_t returnRegister = frame->returnRegister;
+        popFrame();
+        if (frames_.size() == entryDepth) {
+            return result;
+        }
+        VM_LOAD();
+        regs[returnRegister] = result;
+        VM_TRY_BASELINE();
+        VM_NEXT();
+    }
+    VM_CASE(ReturnUndefined) {
+        JSValue result = frame->isConstruct ? frame->thisValue : JSValue::undefined();
+        if (frame->coroutine) {
+            result = completeCoroutine(*frame->coroutine, result);
+        }
+        uint16_t returnRegister = frame->returnRegister;
+        popFrame();
+        if (frames_.size() == entryDepth) {
+            return result;
+        }
+        VM_LOAD();
+        regs[returnRegister] = result;
+        VM_TRY_BASELINE();
+        VM_NEXT();
+    }
+
+    // Object construction
+    VM_CASE(NewObject) {
+        regs[insn->a] = heap_.object();
+        VM_NEXT();
+    }
+    VM_CASE(NewArray) {
+        regs[insn->a] = heap_.array();
+        VM_NEXT();
+    }
+    VM_CASE(ArrayPush) {
+        static_cast<Array*>(regs[insn->a].asObject())->append(regs[insn->b]);
+        VM_NEXT();
+    }
+    VM_CASE(Closure) {
+        const auto& inner = fn->functions[insn->b];
+        JSValue boundThis = inner->isArrow ? frame->thisValue : JSValue::undefined();
+        regs[insn->a] = JSValue::object(heap_.allocate<BytecodeClosure>(this, inner, frame->scope, boundThis));
+        VM_NEXT();
+    }
+
+    // Exceptions
+    VM_CASE(Throw) {
+        pending_ = regs[insn->a];
+        goto do_throw;
+    }
+    VM_CASE(PushHandler) {
+        handlers_.push_back(Handler{frames_.size() - 1, insn->target(), insn->a});
+        VM_NEXT();
+    }
+    VM_CASE(PopHandler) {
+        if (!handlers_.empty()) {
+            handlers_.pop_back();
+        }
+        VM_NEXT();
+    }
+
+    // Coroutines. The suspended frame is popped like a return; the caller
+    // gets the iterator result (Yield) or the async function's promise
+    // (Await). At the entry depth it is dispatch's result instead.
+    VM_CASE(Yield) {
+        VM_SAVE();
+        JSValue value = regs[insn->b];
+        uint16_t returnRegister = frame->returnRegister;
+        suspendCoroutine(insn->a);
+        JSValue result = iteratorResult(value, false);
+        if (frames_.size() == entryDepth) {
+            return result;
+        }
+        VM_LOAD();
+        regs[returnRegister] = result;
+        VM_TRY_BASELINE();
+        VM_NEXT();
+    }
+    VM_CASE(Await) {
+        if (!eventLoop_) {
+            throw std::runtime_error("TypeError: await needs an event loop");
+        }
+        VM_SAVE();
+        Coroutine* coroutine = frame->coroutine;
+        PromiseObject* awaited = promiseFor(regs[insn->b]);
+        uint16_t returnRegister = frame->returnRegister;
+        suspendCoroutine(insn->a);
+        subscribe(awaited, JSValue::undefined(), JSValue::undefined(), nullptr, coroutine);
+        JSValue result = JSValue::object(coroutine->promise());
+        if (frames_.size() == entryDepth) {
+            return result;
+        }
+        VM_LOAD();
+        regs[returnRegister] = result;
+        VM_TRY_BASELINE();
+        VM_NEXT();
+    }
+
+    // Misc
+    VM_CASE(Debugger) {
+        VM_NEXT();
+    }
+    VM_CASE(Nop) {
+        VM_NEXT();
+    }
+
+#if !JS_VM_COMPUTED_GOTO
+    case Opcode::Count:
+        break;
+    }
+    throw std::runtime_error("Invalid opcode");
+#endif
+
+do_call: {
+    JSValue callee = regs[insn->b];
+    uint16_t argc = insn->c;
+
+    if (BytecodeClosure* closure = asBytecodeClosure(callee)) {
+        VM_SAVE();
+        size_t callerBase = frame->base;
+        size_t base = callerBase + fn->registerCount;
+        const BytecodeFunction& target = *closure->function();
+        if ((target.isGenerator || target.isAsync) && callIsConstruct) {
+            throw std::runtime_error("TypeError: " + target.name + " is not a constructor");
+        }
+        JSValue thisValue = JSValue::undefined();
+        if (callIsConstruct) {
+            thisValue = heap_.object();
+        } else if (callIsMethod) {
+            thisValue = regs[insn->b + 1];
+        }
+
+        // Generator bodies do not run until the first next()
+        if (target.isGenerator) {
+            regs[insn->a] = startGenerator(*closure, thisValue, regs + callArgStart, argc);
+            VM_NEXT();
+        }
+
+        // Registers may be reallocated by pushFrame; index from the base
+        pushFrame(*closure, thisValue, base, insn->a, callIsConstruct);
+        if (target.isAsync) {
+            startAsync(*closure);
+        }
+        size_t count = std::min<size_t>(argc, closure->function()->paramCount);
+        for (size_t i = 0; i < count; ++i) {
+            registers_[base + i] = registers_[callerBase + callArgStart + i];
+        }
+        VM_LOAD();
+        VM_SAFEPOINT();
+        VM_TRY_BASELINE();
+        VM_NEXT();
+    }
+
+    // Generator methods called from bytecode resume the generator in this
+    // dispatch loop instead of re-entering the VM from native code
+    if (callIsMethod && callee.isObject()) {
+        Object* method = callee.asObject();
+        Coroutine* generator = nullptr;
+        if ((method == generatorNext_ || method == generatorReturn_ || method == generatorThrow_) &&
+            (generator = asGenerator(regs[insn->b + 1])) != nullptr) {
+            ResumeMode mode = method == generatorNext_     ? ResumeMode::Next
+                              : method == generatorReturn_ ? ResumeMode::Return
+                                                           : ResumeMode::Throw;
+            JSValue sent = argc > 0 ? regs[callArgStart] : JSValue::undefined();
+            VM_SAVE();
+            JSValue result;
+            ResumeResult resumed =
+                resumeCoroutine(*generator, mode, sent, frame->base + fn->registerCount, insn->a, result);
+            VM_LOAD();
+            if (resumed == ResumeResult::Finished) {
+                regs[insn->a] = result;
+            } else if (resumed == ResumeResult::Threw) {
+                goto do_throw;
+            } else {
+                VM_TRY_BASELINE();
+            }
+            VM_NEXT();
+        }
+    }
+
+    // Native code may re-enter the VM and grow the register stack, so the
+    // arguments are copied out of the register window first.
+    JSValue inlineArguments[8];
+    std::vector<JSValue> spilledArguments;
+    const JSValue* arguments = inlineArguments;
+    if (argc <= 8) {
+        std::copy(regs + callArgStart, regs + callArgStart + argc, inlineArguments);
+    } else {
+        spilledArguments.assign(regs + callArgStart, regs + callArgStart + argc);
+        arguments = spilledArguments.data();
+    }
+    JSValue thisValue = callIsMethod ? regs[insn->b + 1] : JSValue::undefined();
+
+    VM_SAVE();
+    JSValue result = callHost(callee, thisValue, arguments, argc, callIsConstruct);
+    VM_LOAD();
+    regs[insn->a] = result;
+    VM_NEXT();
+}
+
+// Runs baseline code from ip until it exits back to the interpreter. The
+// code is held locally: a nested run can invalidate fn->baseline while a
+// helper call is still on the native stack.
+enter_baseline: {
+    std::shared_ptr<BaselineCode> baseline = fn->baseline;
+    BaselineFrame state{regs, this, BaselineCode::kFuel, BaselineExit::Interpret};
+    uint32_t pc = baseline->run(state, static_cast<uint32_t>(ip - code));
+    VM_LOAD();
+    ip = code + pc;
+    switch (state.exit) {
+        case BaselineExit::Deoptimize:
+            optimizer_->onDeoptimize(*fn);
+            break;
+        case BaselineExit::Safepoint:
+            VM_SAFEPOINT();
+            if (fn->baseline) {
+                goto enter_baseline;
+            }
+            break;
+        case BaselineExit::Throw:
+            if (terminating_) {
+                terminating_ = false;
+                throw ExecutionTerminated();
+            }
+            goto do_throw;
+        case BaselineExit::Interpret:
+            break;
+    }
+    VM_NEXT();
+}
+
+do_throw: {
+    VM_SAVE();
+    JSValue result;
+    switch (unwind(entryDepth, result)) {
+        case Unwind::Handled:
+            break;
+        case Unwind::Returned:
+            return result;
+        case Unwind::Uncaught:
+            throw ThrownValue(pending_);
+    }
+    VM_LOAD();
+    VM_NEXT();
+}
+
+#undef VM_COMPARE
+#undef VM_BITWISE
+#undef VM_NUMERIC
+#undef VM_ARITHMETIC
+#undef VM_NEXT
+#undef VM_CASE
+#undef VM_TRY_BASELINE
+#undef VM_SAFEPOINT
+#undef VM_SAVE
+#undef VM_LOAD
+}
+
+#if JS_VM_COMPUTED_GOTO && defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+// Garbage collection
+
+void VM::traceRoots(GC& gc) {
+    for (JSValue value : registers_) {
+        gc.markValue(value);
+    }
+    gc.markValue(pending_);
+    for (Frame& frame : frames_) {
+        gc.markValue(frame.thisValue);
+        if (frame.coroutine) {
+            gc.markCell(frame.coroutine);
+        }
+        if (frame.scope) {
+            frame.scope->trace(gc);
+        }
+        if (frame.capturedScope) {
+            frame.capturedScope->trace(gc);
+        }
+    }
+
+    // Survivors are old once this collection finishes, so the list only
+    // has to carry scopes written since the previous one
+    for (const auto& scope : rememberedScopes_) {
+        scope->trace(gc);
+        scope->remembered = false;
+    }
+    rememberedScopes_.clear();
+}
+
+// Every frame's pc is saved at a safepoint. The innermost one is about to
+// run the instruction at pc; callers' point just past their call.
+void VM::takeSample() {
+    std::vector<uint32_t>& stack = profiler_->beginSample();
+    stack.reserve(frames_.size());
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        const Frame& frame = frames_[i];
+        const BytecodeFunction& function = *frame.function;
+        uint32_t pc = (i + 1 == frames_.size() || frame.pc == 0) ? frame.pc : frame.pc - 1;
+        TokenPosition position = pc < function.positions.size() ? function.positions[pc] : TokenPosition();
+        stack.push_back(profiler_->internFrame(function.name, position));
+    }
+}
+
+// Interrupts
+
+void VM::requestInterrupt(InterruptCallback callback) {
+    std::lock_guard<std::mutex> lock(interruptMutex_);
+    interrupts_.push_back(std::move(callback));
+    interruptRequested_.store(true, std::memory_order_relaxed);
+}
+
+void VM::terminateExecution() {
+    requestInterrupt([](VM&) { return false; });
+}
+
+// Callbacks run unlocked, so they may request further interrupts; those
+// wait for the next safepoint
+void VM::handleInterrupts() {
+    std::vector<InterruptCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(interruptMutex_);
+        callbacks.swap(interrupts_);
+        interruptRequested_.store(false, std::memory_order_relaxed);
+    }
+    bool terminate = false;
+    for (InterruptCallback& callback : callbacks) {
+        terminate = !callback(*this) || terminate;
+    }
+    if (terminate) {
+        throw ExecutionTerminated();
+    }
+}
+
+VM::Location VM::currentLocation() const {
+    if (frames_.empty()) {
+        return Location();
+    }
+    const Frame& frame = frames_.back();
+    const BytecodeFunction& function = *frame.function;
+    TokenPosition position = frame.pc < function.positions.size() ? function.positions[frame.pc] : TokenPosition();
+    return Location{function.name, position};
+}
+
+// Scopes are not cells, so stores of young values into them are recorded
+// here; an old closure may be the only thing keeping the scope alive.
+void VM::rememberScope(const Frame& frame, ClosureScope* scope, JSValue value) {
+    if (scope->remembered || !value.isCell() || (value.asCell()->gcFlags() & GCFlagOld)) {
+        return;
+    }
+    for (std::shared_ptr<ClosureScope> owner = frame.scope; owner; owner = owner->parent) {
+        if (owner.get() == scope) {
+            scope->remembered = true;
+            rememberedScopes_.push_back(std::move(owner));
+            return;
+        }
+    }
+}
+
+// Global bindings
+//
+// Only references the compiler could not resolve to a slot get here. Scripts
+// using with or eval never reach the VM: the compiler rejects them and the
+// engine runs them on the AST interpreter, which keeps dynamic lookup.
+
+JSValue VM::loadName(const std::string& name) {
+    if (context_) {
+        JSValue value = context_->resolveVariable(name);
+        if (!value.isEmpty()) {
+            return value;
+        }
+    }
+    throw std::runtime_error("ReferenceError: " + name + " is not defined");
+}
+
+void VM::storeName(const std::string& name, JSValue value) {
+    if (!context_) {
+        throw std::runtime_error("ReferenceError: " + name + " is not defined");
+    }
+    context_->assignVariable(name, value);
+}
+
+void VM::declareName(const std::string& name, JSValue value) {
+    if (!context_) {
+        throw std::runtime_error("VM has no context for declaration of " + name);
+    }
+    context_->declareVariable(name, value);
+}
+
+// Property access instructions
+
+void VM::executeGetProperty(BytecodeFunction& fn, const Instruction& insn, uint32_t pc, JSValue* regs) {
+    JSValue object = regs[insn.b];
+    PropertyCache& cache = fn.propertyCaches[fn.cacheSlots[pc]];
+    if (object.isObject()) {
+        Object* cell = object.asObject();
+        if (const PropertyCache::Entry* entry = cache.find(cell->shape())) {
+            ++cacheHits_;
+            regs[insn.a] = cell->slotAt(entry->slot);
+            return;
+        }
+    }
+    ++cacheMisses_;
+    regs[insn.a] = getPropertyCached(object, fn.names[insn.c], cache);
+}
+
+void VM::executeSetProperty(BytecodeFunction& fn, const Instruction& insn, uint32_t pc, JSValue* regs) {
+    JSValue object = regs[insn.a];
+    PropertyCache& cache = fn.propertyCaches[fn.cacheSlots[pc]];
+    if (object.isObject()) {
+        Object* cell = object.asObject();
+        const PropertyCache::Entry* entry = cache.find(cell->shape());
+        // Arrays share the root shape but must not take add transitions
+        // ("length" is not a slot on them)
+        if (entry && !(entry->transition && cell->type() == ValueType::Array)) {
+            ++cacheHits_;
+            if (entry->transition) {
+                cell->appendSlot(entry->transition, regs[insn.c]);
+            } else {
+                cell->setSlot(entry->slot, regs[insn.c]);
+            }
+            return;
+        }
+    }
+    ++cacheMisses_;
+    setPropertyCached(object, fn.names[insn.b], regs[insn.c], cache);
+}
+
+void VM::executeGetElement(const Instruction& insn, JSValue* regs) {
+    JSValue object = regs[insn.b];
+    JSValue key = regs[insn.c];
+    if (key.isInt32() && key.asInt32() >= 0 && isArray(object)) {
+        JSValue value = static_cast<Array*>(object.asObject())->at(static_cast<size_t>(key.asInt32()));
+        regs[insn.a] = value.isEmpty() ? JSValue::undefined() : value;
+    } else {
+        regs[insn.a] = getElement(object, key);
+    }
+}
+
+void VM::executeSetElement(const Instruction& insn, JSValue* regs) {
+    JSValue object = regs[insn.a];
+    JSValue key = regs[insn.b];
+    if (key.isInt32() && key.asInt32() >= 0 && isArray(object)) {
+        static_cast<Array*>(object.asObject())->put(static_cast<size_t>(key.asInt32()), regs[insn.c]);
+    } else {
+        setElement(object, key, regs[insn.c]);
+    }
+}
+
+// Baseline helpers
+
+template <Opcode op>
+uint32_t VM::baselineHelper(BaselineFrame* state, uint32_t pc) noexcept {
+    VM& vm = *static_cast<VM*>(state->vm);
+    Frame& frame = vm.frames_.back();
+    BytecodeFunction& fn = *frame.function;
+    const Instruction& insn = fn.code[pc];
+    JSValue* regs = state->regs;
+    uint32_t threw = 0;
+    try {
+        switch (op) {
+            case Opcode::LoadName: regs[insn.a] = vm.loadName(fn.names[insn.b]); break;
+            case Opcode::StoreName: vm.storeName(fn.names[insn.b], regs[insn.a]); break;
+            case Opcode::DeclareName: vm.declareName(fn.names[insn.b], regs[insn.a]); break;
+            case Opcode::LoadSlot: regs[insn.a] = frame.scope->ancestor(insn.b)->slots[insn.c]; break;
+            case Opcode::StoreSlot: {
+                ClosureScope* scope = frame.scope->ancestor(insn.b);
+                scope->slots[insn.c] = regs[insn.a];
+                vm.rememberScope(frame, scope, regs[insn.a]);
+                break;
+            }
+            case Opcode::GetProperty: vm.executeGetProperty(fn, insn, pc, regs); break;
+            case Opcode::SetProperty: vm.executeSetProperty(fn, insn, pc, regs); break;
+            case Opcode::GetElement: vm.executeGetElement(insn, regs); break;
+            case Opcode::SetElement: vm.executeSetElement(insn, regs); break;
+            default: break;
+        }
+    } catch (const ThrownValue& thrown) {
+        vm.pending_ = thrown.value();
+        threw = 1;
+    } catch (const ExecutionTerminated&) {
+        vm.terminating_ = true;
+        threw = 1;
+    } catch (const std::exception& e) {
+        vm.pending_ = JSValue::object(vm.heap_.allocate<Error>(e.what()));
+        threw = 1;
+    }
+    // Getters and setters may have re-entered the VM and grown the stack
+    state->regs = vm.registers_.data() + vm.frames_.back().base;
+    return threw;
+}
+
+// Property access
+
+JSValue VM::getProperty(JSValue object, const std::string& name) {
+    if (object.isObject()) {
+        Object* cell = object.asObject();
+        if (cell->type() == ValueType::Array && name == "length") {
+            return JSValue::number(static_cast<double>(static_cast<Array*>(cell)->length()));
+        }
+        if (auto* typed = dynamic_cast<TypedArray*>(cell)) {
+            if (name == "length") {
+                return JSValue::number(static_cast<double>(typed->length()));
+            }
+            if (name == "byteLength") {
+                return JSValue::number(static_cast<double>(typed->byteLength()));
+            }
+            if (name == "byteOffset") {
+                return JSValue::number(static_cast<double>(typed->byteOffset()));
+            }
+            if (name == "buffer") {
+                return JSValue::object(typed->buffer());
+            }
+        } else if (auto* buffer = dynamic_cast<ArrayBuffer*>(cell)) {
+            if (name == "byteLength") {
+                return JSValue::number(static_cast<double>(buffer->byteLength()));
+            }
+        }
+        JSValue value = cell->get(name);
+        if (value.isEmpty()) {
+            value = coroutineMethod(cell, name);
+        }
+        return value.isEmpty() ? JSValue::undefined() : value;
+    }
+    if (object.isString()) {
+        if (name == "length") {
+            return JSValue::number(static_cast<double>(object.asString()->length()));
+        }
+        return JSValue::undefined();
+    }
+    if (object.isNullish()) {
+        throw std::runtime_error("TypeError: Cannot read property '" + name + "' of " + object.toString());
+    }
+    return JSValue::undefined();
+}
+
+// Arrays answer "length" outside their shape, so only the remaining object
+// kinds are entered into inline caches.
+JSValue VM::getPropertyCached(JSValue object, const std::string& name, PropertyCache& cache) {
+    if (object.isObject() && object.asObject()->type() != ValueType::Array) {
+        Object* cell = object.asObject();
+        uint32_t slot = cell->shape()->lookup(name);
+        if (slot != Shape::kNotFound) {
+            cache.add(cell->shape(), nullptr, slot);
+            return cell->slotAt(slot);
+        }
+    }
+    return getProperty(object, name);
+}
+
+void VM::setPropertyCached(JSValue object, const std::string& name, JSValue value, PropertyCache& cache) {
+    if (object.isObject() && object.asObject()->type() != ValueType::Array) {
+        Object* cell = object.asObject();
+        Shape* shape = cell->shape();
+        uint32_t slot = shape->lookup(name);
+        if (slot != Shape::kNotFound) {
+            cache.add(shape, nullptr, slot);
+            cell->setSlot(slot, value);
+        } else {
+            Shape* transition = shape->addProperty(name);
+            cache.add(shape, transition, transition->slotCount() - 1);
+            cell->appendSlot(transition, value);
+        }
+        return;
+    }
+    setProperty(object, name, value);
+}
+
+void VM::setProperty(JSValue object, const std::string& name, JSValue value) {
+    if (object.isObject()) {
+        Object* cell = object.asObject();
+        if (cell->type() == ValueType::Array && name == "length") {
+            double length = value.toNumber();
+            if (!(length >= 0) || std::trunc(length) != length) {
+                throw std::runtime_error("RangeError: Invalid array length");
+            }
+            static_cast<Array*>(cell)->resize(static_cast<size_t>(length));
+            return;
+        }
+        cell->put(name, value);
+        return;
+    }
+    if (object.isNullish()) {
+        throw std::runtime_error("TypeError: Cannot set property '" + name + "' of " + object.toString());
+    }
+    // Property writes on primitives are silently dropped
+}
+
+JSValue VM::getElement(JSValue object, JSValue key) {
+    if (key.isNumber()) {
+        double index = key.asNumber();
+        if (index >= 0 && std::trunc(index) == index) {
+            if (isArray(object)) {
+                JSValue value = static_cast<Array*>(object.asObject())->at(static_cast<size_t>(index));
+                return value.isEmpty() ? JSValue::undefined() : value;
+            }
+            if (TypedArray* typed = asTypedArray(object)) {
+                return typed->at(static_cast<size_t>(index));
+            }
+            if (object.isString()) {
+                String* text = object.asString();
+                size_t position = static_cast<size_t>(index);
+                return position < text->length() ? heap_.substring(text, position, position + 1)
+                                                 : JSValue::undefined();
+            }
+        }
+    }
+    return getProperty(object, key.isString() ? key.asString()->value() : key.toString());
+}
+
+void VM::setElement(JSValue object, JSValue key, JSValue value) {
+    if (key.isNumber()) {
+        double index = key.asNumber();
+        if (index >= 0 && std::trunc(index) == index) {
+            if (isArray(object)) {
+                static_cast<Array*>(object.asObject())->put(static_cast<size_t>(index), value);
+                return;
+            }
+            if (TypedArray* typed = asTypedArray(object)) {
+                typed->put(static_cast<size_t>(index), value);
+                return;
+            }
+        }
+    }
+    setProperty(object, key.isString() ? key.asString()->value() : key.toString(), value);
+}
+
+// Calls
+
+JSValue VM::callHost(JSValue callee, JSValue thisValue, const JSValue* arguments, size_t count, bool isConstruct) {
+    if (!callee.isObject()) {
+        throw std::runtime_error("TypeError: " + callee.toString() + " is not a function");
+    }
+
+    // Native frames hold JSValues the collector cannot see
+    struct NativeScope {
+        size_t& depth;
+        explicit NativeScope(size_t& depth) : depth(depth) { ++depth; }
+        ~NativeScope() { --depth; }
+    } nativeScope(nativeDepth_);
+
+    Object* cell = callee.asObject();
+    if (auto* native = dynamic_cast<NativeFunction*>(cell)) {
+        if (!isConstruct) {
+            return native->invoke(thisValue, arguments, count);
+        }
+        JSValue instance = heap_.object();
+        JSValue result = native->invoke(instance, arguments, count);
+        return result.isObject() ? result : instance;
+    }
+
+    // Legacy heap functions still take boxed arguments
+    std::vector<std::unique_ptr<Value>> boxed;
+    boxed.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        boxed.push_back(arguments[i].toValue());
+    }
+
+    std::unique_ptr<Value> result;
+    if (isConstruct) {
+        result = cell->construct(boxed);
+    } else if (!thisValue.isUndefined()) {
+        result = cell->call(thisValue.toValue(), boxed);
+    } else {
+        result = cell->call(boxed);
+    }
+    return JSValue::fromValue(std::move(result), heap_);
+}
+
+JSValue VM::typeOf(JSValue value) const {
+    if (value.isNumber()) {
+        return typeNames_[2];
+    }
+    if (value.isString()) {
+        return typeNames_[3];
+    }
+    if (value.isBoolean()) {
+        return typeNames_[1];
+    }
+    if (value.isObject()) {
+        return typeNames_[value.asObject()->type() == ValueType::Function ? 5 : 4];
+    }
+    return typeNames_[value.isNull() ? 4 : 0];
+}
+
+} // namespace js
@@ -0,0 +1,75 @@
+#include "js/watchdog.h"
+
+namespace js {
+
+Watchdog::Watchdog(Expired onExpired)
+    : onExpired_(std::move(onExpired)), thread_(), mutex_(), wake_(), deadline_(), generation_(0), armed_(false),
+      stopRequested_(false) {
+}
+
+Watchdog::~Watchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+uint64_t Watchdog::arm(Clock::time_point deadline) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deadline_ = deadline;
+        generation = ++generation_;
+        armed_ = true;
+    }
+    if (!thread_.joinable()) {
+        thread_ = std::thread(&Watchdog::watchLoop, this);
+    }
+    wake_.notify_all();
+    return generation;
+}
+
+void Watchdog::disarm() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        armed_ = false;
+    }
+    wake_.notify_all();
+}
+
+bool Watchdog::isArmed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return armed_;
+}
+
+// Waking for any change re-reads the deadline; the callback runs unlocked
+// so it may arm the watchdog again
+void Watchdog::watchLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopRequested_) {
+        if (!armed_) {
+            wake_.wait(lock, [this] { return stopRequested_ || armed_; });
+            continue;
+        }
+
+        uint64_t generation = generation_;
+        Clock::time_point deadline = deadline_;
+        bool changed = wake_.wait_until(lock, deadline, [this, generation] {
+            return stopRequested_ || !armed_ || generation_ != generation;
+        });
+        if (changed) {
+            continue;
+        }
+
+        armed_ = false;
+        lock.unlock();
+        onExpired_(generation);
+        lock.lock();
+    }
+}
+
+} // namespace js
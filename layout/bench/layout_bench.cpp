@@ -0,0 +1,344 @@
+// layout_bench: times full layout, incremental relayout and hit testing
+// over synthetic trees of typical shapes and over captured tree dumps,
+// either text dumps (see tree_dump.h) or binary layout captures.
+//
+//   layout_bench [--filter=<substring>] [--min-time=<seconds>] [--scale=<n>]
+//                [--workers=<n>] [--dump=<file>]... [--out=<file.json>]
+//                [--trace=<file.json>]
+//
+// Results go to stdout as a table and, with --out, to a JSON file in the
+// layout of Google Benchmark's --benchmark_out, so the usual comparison
+// tools can diff two releases. --trace writes the layout tracer's events
+// as a Chrome trace; the library has to be built with LAYOUT_TRACING.
+
+#include "layout/layout_capture.h"
+#include "layout/layout_engine.h"
+#include "tree_dump.h"
+#include "apollo/json_string.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace layout;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Fewer samples than this make the median meaningless
+constexpr size_t kMinIterations = 10;
+// Points cycled through by the hit-test benchmark
+constexpr size_t kHitTestPoints = 1024;
+
+struct Options {
+    std::string filter;
+    double minTime = 0.5;
+    size_t scale = 1;
+    size_t workers = 0;
+    std::vector<std::string> dumps;
+    std::string out;
+    std::string trace;
+};
+
+struct Result {
+    std::string name;
+    size_t nodes;
+    size_t iterations;
+    double meanNs;
+    double medianNs;
+    double minNs;
+};
+
+// A named tree; building it is not timed
+struct Workload {
+    std::string name;
+    std::function<std::unique_ptr<LayoutTree>()> build;
+};
+
+// Synthetic trees
+
+LayoutNode* addNode(LayoutTree& tree, LayoutNode* parent, Display display) {
+    auto box = std::make_shared<LayoutBox>();
+    box->setDisplay(display);
+    LayoutNode* node = tree.createNode(box);
+    if (parent) {
+        parent->addChild(node);
+    } else {
+        tree.setRoot(node);
+    }
+    return node;
+}
+
+// Chains of nested blocks, as in heavily wrapped markup
+std::unique_ptr<LayoutTree> buildDeepBlocks(size_t chains, size_t depth) {
+    auto tree = std::make_unique<LayoutTree>();
+    LayoutNode* root = addNode(*tree, nullptr, Display::Block);
+    for (size_t i = 0; i < chains; ++i) {
+        LayoutNode* node = root;
+        for (size_t level = 0; level < depth; ++level) {
+            node = addNode(*tree, node, Display::Block);
+        }
+    }
+    return tree;
+}
+
+std::unique_ptr<LayoutTree> buildFlexRows(size_t rows, size_t items) {
+    auto tree = std::make_unique<LayoutTree>();
+    LayoutNode* root = addNode(*tree, nullptr, Display::Block);
+    for (size_t i = 0; i < rows; ++i) {
+        LayoutNode* row = addNode(*tree, root, Display::Flex);
+        for (size_t j = 0; j < items; ++j) {
+            addNode(*tree, row, Display::Block);
+        }
+    }
+    return tree;
+}
+
+std::unique_ptr<LayoutTree> buildGrid(size_t cells) {
+    auto tree = std::make_unique<LayoutTree>();
+    LayoutNode* root = addNode(*tree, nullptr, Display::Block);
+    LayoutNode* grid = addNode(*tree, root, Display::Grid);
+    for (size_t i = 0; i < cells; ++i) {
+        addNode(*tree, grid, Display::Block);
+    }
+    return tree;
+}
+
+// Absolutely positioned boxes over a few z-index layers
+std::unique_ptr<LayoutTree> buildPositioned(size_t count) {
+    auto tree = std::make_unique<LayoutTree>();
+    LayoutNode* root = addNode(*tree, nullptr, Display::Block);
+    for (size_t i = 0; i < count; ++i) {
+        LayoutNode* node = addNode(*tree, root, Display::Block);
+        node->box()->setPosition(Position::Absolute);
+        node->box()->setZIndex(static_cast<ZIndex>(i % 7) - 3);
+    }
+    return tree;
+}
+
+std::unique_ptr<LayoutTree> buildLongText(size_t paragraphs, size_t words) {
+    static const char* const kWords[] = {"layout", "engine", "of", "the", "browser", "paints", "text", "boxes"};
+
+    auto tree = std::make_unique<LayoutTree>();
+    LayoutNode* root = addNode(*tree, nullptr, Display::Block);
+    for (size_t i = 0; i < paragraphs; ++i) {
+        LayoutNode* paragraph = addNode(*tree, root, Display::Block);
+        std::string text;
+        for (size_t j = 0; j < words; ++j) {
+            if (j > 0) text += ' ';
+            text += kWords[(i + j) % 8];
+        }
+        addNode(*tree, paragraph, Display::Inline)->setTextContent(text);
+    }
+    return tree;
+}
+
+// Measurement
+
+// Runs setup untimed and op timed until minTime has been spent in op
+template <typename Setup, typename Op>
+Result measure(const std::string& name, size_t nodes, double minTime, Setup setup, Op op) {
+    std::vector<double> samples;
+    double total = 0;
+    while (samples.size() < kMinIterations || total < minTime * 1e9) {
+        setup();
+        auto start = Clock::now();
+        op();
+        double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        samples.push_back(elapsed);
+        total += elapsed;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    Result result;
+    result.name = name;
+    result.nodes = nodes;
+    result.iterations = samples.size();
+    result.meanNs = total / samples.size();
+    result.medianNs = samples[samples.size() / 2];
+    result.minNs = samples.front();
+    return result;
+}
+
+void runWorkload(const Workload& workload, const Options& options, std::vector<Result>& results) {
+    auto selected = [&options](const std::string& name) {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    };
+    std::string prefix = workload.name + "/";
+    if (!selected(prefix + "layout") && !selected(prefix + "update_layout") && !selected(prefix + "hit_test")) return;
+
+    LayoutEngine engine;
+    engine.setWorkerCount(options.workers);
+    engine.setTree(workload.build());
+    LayoutTree* tree = engine.tree();
+    size_t nodes = tree->nodeCount();
+    engine.layout();
+
+    if (selected(prefix + "layout")) {
+        results.push_back(measure(prefix + "layout", nodes, options.minTime,
+            [&engine] { engine.invalidateLayout(); },
+            [&engine] { engine.layout(); }));
+    }
+
+    if (selected(prefix + "update_layout")) {
+        // A different leaf each time, so no run relayouts a warm path only
+        std::vector<LayoutNode*> leaves = tree->getLeafNodes();
+        size_t next = 0;
+        results.push_back(measure(prefix + "update_layout", nodes, options.minTime,
+            [&engine, &leaves, &next] { engine.invalidateLayout(leaves[next++ % leaves.size()]); },
+            [&engine] { engine.updateLayout(); }));
+    }
+
+    if (selected(prefix + "hit_test")) {
+        Rect bounds = tree->root()->getBounds();
+        std::mt19937 random(42);
+        std::uniform_real_distribution<double> x(bounds.x, bounds.right());
+        std::uniform_real_distribution<double> y(bounds.y, bounds.bottom());
+        std::vector<Point> points;
+        for (size_t i = 0; i < kHitTestPoints; ++i) {
+            points.emplace_back(x(random), y(random));
+        }
+
+        size_t next = 0;
+        LayoutNode* sink = nullptr;
+        engine.hitTest(points[0]);
+        results.push_back(measure(prefix + "hit_test", nodes, options.minTime,
+            [] {},
+            [&engine, &points, &next, &sink] { sink = engine.hitTest(points[next++ % points.size()]); }));
+        static_cast<void>(sink);
+    }
+}
+
+// Output
+
+std::string resultsJson(const std::vector<Result>& results, const Options& options) {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    std::ostringstream out;
+    out << "{\n  \"context\": {\"date\": \"" << date << "\", \"library\": \"layout-engine\""
+        << ", \"num_cpus\": " << std::thread::hardware_concurrency()
+        << ", \"workers\": " << options.workers << ", \"scale\": " << options.scale << "},\n"
+        << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        apollo::appendJsonString(out, result.name);
+        out << ", \"run_type\": \"iteration\", \"iterations\": " << result.iterations
+            << ", \"real_time\": " << result.meanNs << ", \"cpu_time\": " << result.meanNs
+            << ", \"median_time\": " << result.medianNs << ", \"min_time\": " << result.minNs
+            << ", \"time_unit\": \"ns\", \"nodes\": " << result.nodes << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+void printTable(const std::vector<Result>& results) {
+    std::printf("%-40s %10s %12s %14s %14s %14s\n", "benchmark", "nodes", "iterations", "mean (us)", "median (us)", "min (us)");
+    for (const Result& result : results) {
+        std::printf("%-40s %10zu %12zu %14.2f %14.2f %14.2f\n", result.name.c_str(), result.nodes, result.iterations,
+                    result.meanNs / 1e3, result.medianNs / 1e3, result.minNs / 1e3);
+    }
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* flag) -> const char* {
+            size_t length = std::char_traits<char>::length(flag);
+            return arg.compare(0, length, flag) == 0 ? arg.c_str() + length : nullptr;
+        };
+
+        if (const char* v = value("--filter=")) {
+            options.filter = v;
+        } else if (const char* v = value("--min-time=")) {
+            options.minTime = std::atof(v);
+        } else if (const char* v = value("--scale=")) {
+            options.scale = std::max<size_t>(1, std::strtoul(v, nullptr, 10));
+        } else if (const char* v = value("--workers=")) {
+            options.workers = std::strtoul(v, nullptr, 10);
+        } else if (const char* v = value("--dump=")) {
+            options.dumps.push_back(v);
+        } else if (const char* v = value("--out=")) {
+            options.out = v;
+        } else if (const char* v = value("--trace=")) {
+            options.trace = v;
+        } else {
+            std::cerr << "layout_bench: unknown argument " << arg << "\n"
+                      << "usage: layout_bench [--filter=<substring>] [--min-time=<seconds>] [--scale=<n>]\n"
+                      << "                    [--workers=<n>] [--dump=<file>]... [--out=<file.json>]\n"
+                      << "                    [--trace=<file.json>]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 2;
+
+    size_t scale = options.scale;
+    std::vector<Workload> workloads = {
+        {"deep_blocks", [scale] { return buildDeepBlocks(16 * scale, 64); }},
+        {"flex_rows", [scale] { return buildFlexRows(100 * scale, 50); }},
+        {"grid", [scale] { return buildGrid(5000 * scale); }},
+        {"positioned", [scale] { return buildPositioned(2000 * scale); }},
+        {"long_text", [scale] { return buildLongText(200 * scale, 500); }},
+    };
+
+    for (const std::string& path : options.dumps) {
+        std::string error;
+        std::shared_ptr<LayoutTree> dump =
+            isLayoutCaptureFile(path) ? loadLayoutTree(path, error) : bench::loadTreeDump(path, error);
+        if (!dump) {
+            std::cerr << "layout_bench: " << path << ": " << error << "\n";
+            return 1;
+        }
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        workloads.push_back({"dump/" + name, [dump] { return dump->clone(); }});
+    }
+
+    if (!options.trace.empty()) {
+        LayoutTracer::shared().start();
+    }
+
+    std::vector<Result> results;
+    for (const Workload& workload : workloads) {
+        runWorkload(workload, options, results);
+    }
+
+    printTable(results);
+    if (!options.out.empty()) {
+        std::ofstream out(options.out);
+        out << resultsJson(results, options);
+        if (!out) {
+            std::cerr << "layout_bench: cannot write " << options.out << "\n";
+            return 1;
+        }
+    }
+    if (!options.trace.empty()) {
+        LayoutTracer::shared().stop();
+        std::ofstream trace(options.trace);
+        trace << LayoutTracer::shared().exportChromeTrace();
+        if (!trace) {
+            std::cerr << "layout_bench: cannot write " << options.trace << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "tree_dump.h"
+#include <cstdlib>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+namespace layout {
+namespace bench {
+
+namespace {
+
+struct DisplayName {
+    const char* name;
+    Display display;
+};
+
+const DisplayName kDisplayNames[] = {
+    {"none", Display::None},
+    {"block", Display::Block},
+    {"inline", Display::Inline},
+    {"inline-block", Display::InlineBlock},
+    {"flex", Display::Flex},
+    {"inline-flex", Display::InlineFlex},
+    {"grid", Display::Grid},
+    {"inline-grid", Display::InlineGrid},
+    {"table", Display::Table},
+    {"inline-table", Display::InlineTable},
+    {"table-row", Display::TableRow},
+    {"table-cell", Display::TableCell},
+    {"table-row-group", Display::TableRowGroup},
+    {"list-item", Display::ListItem},
+    {"contents", Display::Contents},
+};
+
+struct PositionName {
+    const char* name;
+    Position position;
+};
+
+const PositionName kPositionNames[] = {
+    {"static", Position::Static},
+    {"relative", Position::Relative},
+    {"absolute", Position::Absolute},
+    {"fixed", Position::Fixed},
+    {"sticky", Position::Sticky},
+};
+
+bool parseDisplay(const std::string& name, Display& display) {
+    for (const auto& entry : kDisplayNames) {
+        if (name == entry.name) {
+            display = entry.display;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parsePosition(const std::string& name, Position& position) {
+    for (const auto& entry : kPositionNames) {
+        if (name == entry.name) {
+            position = entry.position;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Displays the dump format has no keyword for are written as block
+const char* displayName(Display display) {
+    for (const auto& entry : kDisplayNames) {
+        if (entry.display == display) return entry.name;
+    }
+    return "block";
+}
+
+const char* positionName(Position position) {
+    for (const auto& entry : kPositionNames) {
+        if (entry.position == position) return entry.name;
+    }
+    return "static";
+}
+
+void writeNode(const LayoutNode* node, size_t depth, std::ostream& out) {
+    const LayoutBox* box = node->box();
+    out << depth << ' ' << (box ? displayName(box->display()) : "block");
+    if (box) {
+        if (box->position() != Position::Static) out << " position=" << positionName(box->position());
+        if (box->zIndex() != 0) out << " z=" << box->zIndex();
+        if (box->opacity() < 1.0) out << " opacity=" << box->opacity();
+    }
+    // Text runs to the end of the line, so line breaks become spaces
+    if (!node->textContent().empty()) {
+        std::string text = node->textContent();
+        for (char& c : text) {
+            if (c == '\n' || c == '\r') c = ' ';
+        }
+        out << " text=" << text;
+    }
+    out << '\n';
+
+    for (auto* child : node->children()) {
+        writeNode(child, depth + 1, out);
+    }
+}
+
+} // namespace
+
+std::unique_ptr<LayoutTree> readTreeDump(std::istream& in, std::string& error) {
+    auto tree = std::make_unique<LayoutTree>();
+    // Innermost open node at each depth
+    std::vector<LayoutNode*> open;
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        auto fail = [&error, lineNumber](const std::string& message) {
+            error = "line " + std::to_string(lineNumber) + ": " + message;
+            return nullptr;
+        };
+
+        // The text, if any, is the rest of the line and may hold spaces
+        std::string text;
+        size_t textStart = line.find(" text=");
+        if (textStart != std::string::npos) {
+            text = line.substr(textStart + 6);
+            line.erase(textStart);
+        }
+
+        std::istringstream fields(line);
+        size_t depth = 0;
+        std::string displayField;
+        if (!(fields >> depth >> displayField)) return fail("expected <depth> <display>");
+        if (depth > open.size() || (depth == 0) != open.empty()) return fail("unexpected depth " + std::to_string(depth));
+
+        auto box = std::make_shared<LayoutBox>();
+        Display display = Display::Block;
+        if (!parseDisplay(displayField, display)) return fail("unknown display '" + displayField + "'");
+        box->setDisplay(display);
+
+        std::string field;
+        while (fields >> field) {
+            size_t equals = field.find('=');
+            if (equals == std::string::npos) return fail("expected key=value, got '" + field + "'");
+            std::string key = field.substr(0, equals);
+            std::string value = field.substr(equals + 1);
+
+            if (key == "position") {
+                Position position = Position::Static;
+                if (!parsePosition(value, position)) return fail("unknown position '" + value + "'");
+                box->setPosition(position);
+            } else if (key == "z") {
+                box->setZIndex(static_cast<ZIndex>(std::atoi(value.c_str())));
+            } else if (key == "opacity") {
+                box->setOpacity(std::atof(value.c_str()));
+            } else {
+                return fail("unknown key '" + key + "'");
+            }
+        }
+
+        LayoutNode* node = tree->createNode(box);
+        if (!text.empty()) node->setTextContent(text);
+        if (depth == 0) {
+            tree->setRoot(node);
+        } else {
+            open[depth - 1]->addChild(node);
+        }
+        open.resize(depth);
+        open.push_back(node);
+    }
+
+    if (!tree->root()) {
+        error = "no nodes";
+        return nullptr;
+    }
+    return tree;
+}
+
+std::unique_ptr<LayoutTree> loadTreeDump(const std::string& path, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    return readTreeDump(in, error);
+}
+
+void writeTreeDump(const LayoutTree& tree, std::ostream& out) {
+    if (tree.root()) {
+        writeNode(tree.root(), 0, out);
+    }
+}
+
+} // namespace bench
+} // namespace layout
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "layout/layout_node.h"
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+namespace layout {
+namespace bench {
+
+// Layout tree dumps, as captured from real pages, one node per line in
+// preorder:
+//
+//   <depth> <display> [position=<position>] [z=<z-index>] [opacity=<value>] [text=<rest of line>]
+//
+// The root has depth 0 and is the first node; every other node is at most
+// one level deeper than the node before it. Display and position use the
+// CSS keywords (block, inline-flex, absolute, ...). Blank lines and lines
+// starting with '#' are skipped.
+
+// nullptr with error set when the dump is malformed
+std::unique_ptr<LayoutTree> readTreeDump(std::istream& in, std::string& error);
+std::unique_ptr<LayoutTree> loadTreeDump(const std::string& path, std::string& error);
+
+void writeTreeDump(const LayoutTree& tree, std::ostream& out);
+
+} // namespace bench
+} // namespace layout
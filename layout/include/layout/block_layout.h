@@ -28,7 +28,8 @@ public:
     // Handle margin collapse
     void collapseMargins(LayoutNode* node);
 
-    // Handle floats
+    // Place node's floating children in its formatting context root's
+    // exclusion space
     void handleFloats(LayoutNode* node);
 
     // Clear floats
@@ -44,6 +45,8 @@ private:
     void clearFloatsLeft(LayoutNode* node);
     void clearFloatsRight(LayoutNode* node);
     void clearFloatsBoth(LayoutNode* node);
+    // Moves node's margin box below the floats clear applies to
+    void clearPast(LayoutNode* node, Clear clear);
 };
 
 } // namespace layout
@@ -2,12 +2,169 @@
 
 #include "types.h"
 #include "enums.h"
+#include "grid_tracks.h"
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 namespace layout {
 
+// Flex container properties
+struct FlexStyle {
+    FlexDirection direction = FlexDirection::Row;
+    FlexWrap wrap = FlexWrap::Nowrap;
+    JustifyContent justifyContent = JustifyContent::FlexStart;
+    AlignItems alignItems = AlignItems::Stretch;
+    AlignContent alignContent = AlignContent::Stretch;
+    double rowGap = 0;
+    double columnGap = 0;
+
+    bool operator==(const FlexStyle& other) const {
+        return direction == other.direction && wrap == other.wrap && justifyContent == other.justifyContent &&
+               alignItems == other.alignItems && alignContent == other.alignContent && rowGap == other.rowGap &&
+               columnGap == other.columnGap;
+    }
+    bool operator!=(const FlexStyle& other) const { return !(*this == other); }
+};
+
+// Flex item properties; a negative basis is auto
+struct FlexItemStyle {
+    double grow = 0;
+    double shrink = 1;
+    double basis = -1;
+    AlignSelf alignSelf = AlignSelf::Auto;
+
+    bool operator==(const FlexItemStyle& other) const {
+        return grow == other.grow && shrink == other.shrink && basis == other.basis && alignSelf == other.alignSelf;
+    }
+    bool operator!=(const FlexItemStyle& other) const { return !(*this == other); }
+};
+
+// Computed box-model values of a box, shared between boxes
+//
+// Everything about a box but where layout puts it: padding, borders,
+// margins and insets as floats, keywords packed into bitfields, and the
+// transform, clip, flex and grid values. Rows of a table and items of a
+// list mostly have the same values, so intern() keeps one copy of each
+// distinct style for as long as a box holds it; a box's style is
+// immutable, and setting a value interns a changed copy.
+class BoxStyle {
+public:
+    BoxStyle();
+
+    EdgeInsets padding() const { return unpack(padding_); }
+    void setPadding(const EdgeInsets& padding) { pack(padding, padding_); }
+
+    EdgeInsets border() const { return unpack(border_); }
+    void setBorder(const EdgeInsets& border) { pack(border, border_); }
+
+    EdgeInsets margin() const { return unpack(margin_); }
+    void setMargin(const EdgeInsets& margin) { pack(margin, margin_); }
+
+    BoxSizing boxSizing() const { return static_cast<BoxSizing>(boxSizing_); }
+    void setBoxSizing(BoxSizing boxSizing) { boxSizing_ = static_cast<uint32_t>(boxSizing); }
+
+    Display display() const { return static_cast<Display>(display_); }
+    void setDisplay(Display display) { display_ = static_cast<uint32_t>(display); }
+
+    Position position() const { return static_cast<Position>(position_); }
+    void setPosition(Position position) { position_ = static_cast<uint32_t>(position); }
+
+    InsetOffsets insets() const;
+    void setInsets(const InsetOffsets& insets);
+
+    Float cssFloat() const { return static_cast<Float>(float_); }
+    void setFloat(Float value) { float_ = static_cast<uint32_t>(value); }
+
+    Clear clear() const { return static_cast<Clear>(clear_); }
+    void setClear(Clear clear) { clear_ = static_cast<uint32_t>(clear); }
+
+    ZIndex zIndex() const { return zIndex_; }
+    void setZIndex(ZIndex zIndex) { zIndex_ = zIndex; }
+
+    const Transform& transform() const { return transform_; }
+    void setTransform(const Transform& transform) { transform_ = transform; }
+
+    double opacity() const { return opacity_; }
+    void setOpacity(double opacity) { opacity_ = static_cast<float>(std::max(0.0, std::min(1.0, opacity))); }
+
+    Visibility visibility() const { return static_cast<Visibility>(visibility_); }
+    void setVisibility(Visibility visibility) { visibility_ = static_cast<uint32_t>(visibility); }
+
+    Overflow overflow() const { return static_cast<Overflow>(overflow_); }
+    void setOverflow(Overflow overflow) { overflow_ = static_cast<uint32_t>(overflow); }
+
+    const Rect& clipRect() const { return clipRect_; }
+    void setClipRect(const Rect& clipRect) { clipRect_ = clipRect; }
+
+    const std::shared_ptr<const GridTemplate>& gridTemplate() const { return gridTemplate_; }
+    void setGridTemplate(std::shared_ptr<const GridTemplate> gridTemplate) { gridTemplate_ = std::move(gridTemplate); }
+
+    const GridPlacement& gridPlacement() const { return gridPlacement_; }
+    void setGridPlacement(const GridPlacement& placement) { gridPlacement_ = placement; }
+
+    const FlexStyle& flexStyle() const { return flexStyle_; }
+    void setFlexStyle(const FlexStyle& style) { flexStyle_ = style; }
+
+    const FlexItemStyle& flexItemStyle() const { return flexItemStyle_; }
+    void setFlexItemStyle(const FlexItemStyle& style) { flexItemStyle_ = style; }
+
+    bool isReplaced() const { return isReplaced_; }
+    void setIsReplaced(bool isReplaced) { isReplaced_ = isReplaced; }
+
+    bool isAnonymous() const { return isAnonymous_; }
+    void setIsAnonymous(bool isAnonymous) { isAnonymous_ = isAnonymous; }
+
+    bool isRoot() const { return isRoot_; }
+    void setIsRoot(bool isRoot) { isRoot_ = isRoot; }
+
+    // Grid templates compare by identity, as boxes share them
+    bool operator==(const BoxStyle& other) const;
+    bool operator!=(const BoxStyle& other) const { return !(*this == other); }
+    size_t hash() const;
+
+    // The shared copy of style, made if no box holds one
+    static std::shared_ptr<const BoxStyle> intern(const BoxStyle& style);
+    // The style of a new box, which is never released
+    static const std::shared_ptr<const BoxStyle>& initial();
+    // Distinct styles boxes hold
+    static size_t internedCount();
+
+private:
+    static EdgeInsets unpack(const float (&sides)[4]) { return EdgeInsets(sides[0], sides[1], sides[2], sides[3]); }
+    static void pack(const EdgeInsets& insets, float (&sides)[4]);
+
+    float padding_[4];
+    float border_[4];
+    float margin_[4];
+    float insets_[4];
+    float opacity_;
+    ZIndex zIndex_;
+    uint32_t display_ : 5;
+    uint32_t position_ : 3;
+    uint32_t float_ : 2;
+    uint32_t clear_ : 2;
+    uint32_t visibility_ : 2;
+    uint32_t overflow_ : 2;
+    uint32_t boxSizing_ : 1;
+    // Bits of the inset sides that have values, top first
+    uint32_t insetSides_ : 4;
+    uint32_t isReplaced_ : 1;
+    uint32_t isAnonymous_ : 1;
+    uint32_t isRoot_ : 1;
+    Transform transform_;
+    Rect clipRect_;
+    GridPlacement gridPlacement_;
+    FlexStyle flexStyle_;
+    FlexItemStyle flexItemStyle_;
+    std::shared_ptr<const GridTemplate> gridTemplate_;
+};
+
 // CSS box model representation
+//
+// A box holds its own content rect and an interned BoxStyle for the rest,
+// so boxes with the same values cost a pointer each.
 class BoxModel {
 public:
     BoxModel();
@@ -18,26 +175,41 @@ public:
     void setContentRect(const Rect& rect) { contentRect_ = rect; }
 
     // Padding area
-    const EdgeInsets& padding() const { return padding_; }
-    void setPadding(const EdgeInsets& padding) { padding_ = padding; }
+    EdgeInsets padding() const { return style_->padding(); }
+    void setPadding(const EdgeInsets& padding) {
+        updateStyle([&](BoxStyle& style) { style.setPadding(padding); });
+    }
     Rect paddingRect() const;
 
     // Border area
-    const EdgeInsets& border() const { return border_; }
-    void setBorder(const EdgeInsets& border) { border_ = border; }
+    EdgeInsets border() const { return style_->border(); }
+    void setBorder(const EdgeInsets& border) {
+        updateStyle([&](BoxStyle& style) { style.setBorder(border); });
+    }
     Rect borderRect() const;
 
     // Margin area
-    const EdgeInsets& margin() const { return margin_; }
-    void setMargin(const EdgeInsets& margin) { margin_ = margin; }
+    EdgeInsets margin() const { return style_->margin(); }
+    void setMargin(const EdgeInsets& margin) {
+        updateStyle([&](BoxStyle& style) { style.setMargin(margin); });
+    }
     Rect marginRect() const;
 
     // Total area including margins
     Rect totalRect() const;
 
     // Box sizing
-    BoxSizing boxSizing() const { return boxSizing_; }
-    void setBoxSizing(BoxSizing boxSizing) { boxSizing_ = boxSizing; }
+    BoxSizing boxSizing() const { return style_->boxSizing(); }
+    void setBoxSizing(BoxSizing boxSizing) {
+        updateStyle([&](BoxStyle& style) { style.setBoxSizing(boxSizing); });
+    }
+
+    // All computed values at once; set many values by copying style(),
+    // changing the copy and setting it, which interns once
+    const BoxStyle& style() const { return *style_; }
+    void setStyle(const BoxStyle& style);
+    // A style from BoxStyle::intern(), shared as it is
+    void setStyle(std::shared_ptr<const BoxStyle> style) { style_ = std::move(style); }
 
     // Calculate content size from total size
     Size calculateContentSize(const Size& totalSize) const;
@@ -80,12 +252,18 @@ public:
     BoxModel(BoxModel&& other) noexcept;
     BoxModel& operator=(BoxModel&& other) noexcept;
 
+protected:
+    // Applies update to a copy of the style and interns the result
+    template <typename Update>
+    void updateStyle(Update update) {
+        BoxStyle style = *style_;
+        update(style);
+        setStyle(style);
+    }
+
 private:
     Rect contentRect_;
-    EdgeInsets padding_;
-    EdgeInsets border_;
-    EdgeInsets margin_;
-    BoxSizing boxSizing_;
+    std::shared_ptr<const BoxStyle> style_;
 };
 
 // Layout box that extends BoxModel with layout-specific properties
@@ -95,44 +273,96 @@ public:
     ~LayoutBox();
 
     // Display type
-    Display display() const { return display_; }
-    void setDisplay(Display display) { display_ = display_; }
+    Display display() const { return style().display(); }
+    void setDisplay(Display display) {
+        updateStyle([&](BoxStyle& style) { style.setDisplay(display); });
+    }
 
     // Position
-    Position position() const { return position_; }
-    void setPosition(Position position) { position_ = position_; }
+    Position position() const { return style().position(); }
+    void setPosition(Position position) {
+        updateStyle([&](BoxStyle& style) { style.setPosition(position); });
+    }
+
+    // Insets (top, right, bottom, left) of relative, absolute, fixed and
+    // sticky boxes
+    InsetOffsets insets() const { return style().insets(); }
+    void setInsets(const InsetOffsets& insets) {
+        updateStyle([&](BoxStyle& style) { style.setInsets(insets); });
+    }
 
     // Float
-    Float float() const { return float_; }
-    void setFloat(Float float) { float_ = float_; }
+    // float is a keyword, so the getter takes the DOM's name
+    Float cssFloat() const { return style().cssFloat(); }
+    void setFloat(Float value) {
+        updateStyle([&](BoxStyle& style) { style.setFloat(value); });
+    }
 
     // Clear
-    Clear clear() const { return clear_; }
-    void setClear(Clear clear) { clear_ = clear_; }
+    Clear clear() const { return style().clear(); }
+    void setClear(Clear clear) {
+        updateStyle([&](BoxStyle& style) { style.setClear(clear); });
+    }
 
     // Z-index
-    ZIndex zIndex() const { return zIndex_; }
-    void setZIndex(ZIndex zIndex) { zIndex_ = zIndex; }
+    ZIndex zIndex() const { return style().zIndex(); }
+    void setZIndex(ZIndex zIndex) {
+        updateStyle([&](BoxStyle& style) { style.setZIndex(zIndex); });
+    }
 
     // Transform
-    const Transform& transform() const { return transform_; }
-    void setTransform(const Transform& transform) { transform_ = transform; }
+    const Transform& transform() const { return style().transform(); }
+    void setTransform(const Transform& transform) {
+        updateStyle([&](BoxStyle& style) { style.setTransform(transform); });
+    }
 
     // Opacity
-    double opacity() const { return opacity_; }
-    void setOpacity(double opacity) { opacity_ = std::max(0.0, std::min(1.0, opacity)); }
+    double opacity() const { return style().opacity(); }
+    void setOpacity(double opacity) {
+        updateStyle([&](BoxStyle& style) { style.setOpacity(opacity); });
+    }
 
     // Visibility
-    Visibility visibility() const { return visibility_; }
-    void setVisibility(Visibility visibility) { visibility_ = visibility; }
+    Visibility visibility() const { return style().visibility(); }
+    void setVisibility(Visibility visibility) {
+        updateStyle([&](BoxStyle& style) { style.setVisibility(visibility); });
+    }
 
     // Overflow
-    Overflow overflow() const { return overflow_; }
-    void setOverflow(Overflow overflow) { overflow_ = overflow; }
+    Overflow overflow() const { return style().overflow(); }
+    void setOverflow(Overflow overflow) {
+        updateStyle([&](BoxStyle& style) { style.setOverflow(overflow); });
+    }
 
     // Clipping rectangle
-    const Rect& clipRect() const { return clipRect_; }
-    void setClipRect(const Rect& clipRect) { clipRect_ = clipRect; }
+    const Rect& clipRect() const { return style().clipRect(); }
+    void setClipRect(const Rect& clipRect) {
+        updateStyle([&](BoxStyle& style) { style.setClipRect(clipRect); });
+    }
+
+    // Grid container tracks; boxes with the same template can share it
+    const GridTemplate& gridTemplate() const;
+    void setGridTemplate(std::shared_ptr<const GridTemplate> gridTemplate) {
+        updateStyle([&](BoxStyle& style) { style.setGridTemplate(std::move(gridTemplate)); });
+    }
+
+    // Grid item placement
+    const GridPlacement& gridPlacement() const { return style().gridPlacement(); }
+    void setGridPlacement(const GridPlacement& placement) {
+        updateStyle([&](BoxStyle& style) { style.setGridPlacement(placement); });
+    }
+
+    // Flex container properties
+    const FlexStyle& flexStyle() const { return style().flexStyle(); }
+    void setFlexStyle(const FlexStyle& flexStyle) {
+        updateStyle([&](BoxStyle& style) { style.setFlexStyle(flexStyle); });
+    }
+
+    // Flex item properties
+    const FlexItemStyle& flexItemStyle() const { return style().flexItemStyle(); }
+    void setFlexItemStyle(const FlexItemStyle& flexItemStyle) {
+        updateStyle([&](BoxStyle& style) { style.setFlexItemStyle(flexItemStyle); });
+    }
 
     // Is positioned
     bool isPositioned() const;
@@ -147,16 +377,22 @@ public:
     bool isInlineLevel() const;
 
     // Is replaced element
-    bool isReplaced() const { return isReplaced_; }
-    void setIsReplaced(bool isReplaced) { isReplaced_ = isReplaced; }
+    bool isReplaced() const { return style().isReplaced(); }
+    void setIsReplaced(bool isReplaced) {
+        updateStyle([&](BoxStyle& style) { style.setIsReplaced(isReplaced); });
+    }
 
     // Is anonymous
-    bool isAnonymous() const { return isAnonymous_; }
-    void setIsAnonymous(bool isAnonymous) { isAnonymous_ = isAnonymous; }
+    bool isAnonymous() const { return style().isAnonymous(); }
+    void setIsAnonymous(bool isAnonymous) {
+        updateStyle([&](BoxStyle& style) { style.setIsAnonymous(isAnonymous); });
+    }
 
     // Is root element
-    bool isRoot() const { return isRoot_; }
-    void setIsRoot(bool isRoot) { isRoot_ = isRoot; }
+    bool isRoot() const { return style().isRoot(); }
+    void setIsRoot(bool isRoot) {
+        updateStyle([&](BoxStyle& style) { style.setIsRoot(isRoot); });
+    }
 
     // Is table cell
     bool isTableCell() const;
@@ -198,21 +434,6 @@ public:
     // Move constructor and assignment
     LayoutBox(LayoutBox&& other) noexcept;
     LayoutBox& operator=(LayoutBox&& other) noexcept;
-
-private:
-    Display display_;
-    Position position_;
-    Float float_;
-    Clear clear_;
-    ZIndex zIndex_;
-    Transform transform_;
-    double opacity_;
-    Visibility visibility_;
-    Overflow overflow_;
-    Rect clipRect_;
-    bool isReplaced_;
-    bool isAnonymous_;
-    bool isRoot_;
 };
 
 // Box tree node for hierarchical layout
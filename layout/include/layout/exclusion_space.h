@@ -0,0 +1,77 @@
+#pragma once
+
+#include "enums.h"
+#include "types.h"
+#include <cstddef>
+#include <vector>
+
+namespace layout {
+
+// Inline-direction interval free of floats
+struct LayoutOpportunity {
+    double left;
+    double right;
+
+    double width() const { return right > left ? right - left : 0; }
+};
+
+// Floats placed in one block formatting context
+//
+// The block axis is cut into bands at every float's top and bottom edge.
+// Each band keeps the inline interval the floats crossing it leave free,
+// so the space next to a line or a new float is found by binary search
+// and a walk over only the bands that line or float spans. Offsets are in
+// the formatting context root's coordinates.
+class ExclusionSpace {
+public:
+    explicit ExclusionSpace(double inlineSize = kUnbounded);
+
+    // Forget all floats; the space becomes inlineSize wide
+    void reset(double inlineSize);
+    void clear();
+
+    double inlineSize() const { return inlineSize_; }
+    bool isEmpty() const { return exclusionCount_ == 0; }
+    size_t exclusionCount() const { return exclusionCount_; }
+    size_t bandCount() const { return bands_.size(); }
+
+    // Records a float's margin box on the given side
+    void addExclusion(const Rect& rect, Float side);
+
+    // Interval free of floats across [top, top + height)
+    LayoutOpportunity availableSpace(double top, double height) const;
+
+    // Margin box position for a float of size at or below top, following
+    // the CSS rules: no higher than an earlier float and at the first
+    // offset where it fits or nothing is beside it
+    Point floatPosition(const Size& size, Float side, double top) const;
+
+    // Offset below the floats clear applies to, or kNoClearance
+    double clearance(Clear clear) const;
+
+    static constexpr double kUnbounded = 1e300;
+    static constexpr double kNoClearance = -1e300;
+
+private:
+    // Interval free from top to the next band's top
+    struct Band {
+        double top;
+        double left;
+        double right;
+    };
+
+    double inlineSize_;
+    // Sorted by top; the first starts at kNoClearance when not empty
+    std::vector<Band> bands_;
+    size_t exclusionCount_;
+    double leftBottom_;
+    double rightBottom_;
+    double lastFloatTop_;
+
+    // Index of the band containing y; bands_ must not be empty
+    size_t bandAt(double y) const;
+    // Starts a band at y and returns its index
+    size_t split(double y);
+};
+
+} // namespace layout
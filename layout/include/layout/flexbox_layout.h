@@ -22,26 +22,9 @@ public:
     // Calculate flex container size
     Size calculateFlexContainerSize(LayoutNode* node, const LayoutConstraints& constraints);
 
-    // Calculate flex item size
-    Size calculateFlexItemSize(LayoutNode* item, const LayoutConstraints& constraints);
-
-    // Calculate flex item position
-    Point calculateFlexItemPosition(LayoutNode* item);
-
-    // Handle flex direction
-    void handleFlexDirection(LayoutNode* node);
-
-    // Handle flex wrap
-    void handleFlexWrap(LayoutNode* node);
-
-    // Handle justify content
-    void handleJustifyContent(LayoutNode* node);
-
-    // Handle align items
-    void handleAlignItems(LayoutNode* node);
-
-    // Handle align content
-    void handleAlignContent(LayoutNode* node);
+    // Calculate flex item size; results are cached on the item per
+    // constraints and sizing mode
+    Size calculateFlexItemSize(LayoutNode* item, const LayoutConstraints& constraints, SizingMode mode = SizingMode::Final);
 
     // Calculate flex basis
     double calculateFlexBasis(LayoutNode* item);
@@ -53,37 +36,64 @@ public:
     double calculateFlexShrink(LayoutNode* item);
 
 private:
-    void layoutFlexItem(LayoutNode* item, const LayoutConstraints& constraints);
-    void positionFlexItem(LayoutNode* item);
-    void distributeFlexSpace(LayoutNode* node);
-    void alignFlexItems(LayoutNode* node);
-    void wrapFlexItems(LayoutNode* node);
-    void calculateFlexItemSizes(LayoutNode* node);
-    void calculateFlexItemPositions(LayoutNode* node);
-    void handleFlexWrapNowrap(LayoutNode* node);
-    void handleFlexWrapWrap(LayoutNode* node);
-    void handleFlexWrapWrapReverse(LayoutNode* node);
-    void handleFlexDirectionRow(LayoutNode* node);
-    void handleFlexDirectionRowReverse(LayoutNode* node);
-    void handleFlexDirectionColumn(LayoutNode* node);
-    void handleFlexDirectionColumnReverse(LayoutNode* node);
-    void handleJustifyContentFlexStart(LayoutNode* node);
-    void handleJustifyContentFlexEnd(LayoutNode* node);
-    void handleJustifyContentCenter(LayoutNode* node);
-    void handleJustifyContentSpaceBetween(LayoutNode* node);
-    void handleJustifyContentSpaceAround(LayoutNode* node);
-    void handleJustifyContentSpaceEvenly(LayoutNode* node);
-    void handleAlignItemsStretch(LayoutNode* node);
-    void handleAlignItemsFlexStart(LayoutNode* node);
-    void handleAlignItemsFlexEnd(LayoutNode* node);
-    void handleAlignItemsCenter(LayoutNode* node);
-    void handleAlignItemsBaseline(LayoutNode* node);
-    void handleAlignContentStretch(LayoutNode* node);
-    void handleAlignContentFlexStart(LayoutNode* node);
-    void handleAlignContentFlexEnd(LayoutNode* node);
-    void handleAlignContentCenter(LayoutNode* node);
-    void handleAlignContentSpaceBetween(LayoutNode* node);
-    void handleAlignContentSpaceAround(LayoutNode* node);
+    // One in-flow child, in main/cross terms; sizes exclude margins
+    struct FlexItem {
+        LayoutNode* node;
+        double base;
+        double main;
+        double cross;
+        double grow;
+        double shrink;
+        double mainMarginBefore;
+        double mainMargins;
+        double crossMarginBefore;
+        double crossMargins;
+        // From the cross-start margin edge
+        double baseline;
+        AlignItems align;
+        bool frozen;
+
+        double outerBase() const { return base + mainMargins; }
+        double outerMain() const { return main + mainMargins; }
+        double outerCross() const { return cross + crossMargins; }
+    };
+
+    struct FlexLine {
+        size_t first;
+        size_t end;
+        double cross;
+        double baseline;
+        double offset;
+    };
+
+    // Marks where the content box sits and which way the axes run
+    struct FlexAxes {
+        bool isRow;
+        bool mainReverse;
+        bool crossReverse;
+        double originX;
+        double originY;
+        double mainSize;
+        double crossSize;
+        double mainGap;
+        double crossGap;
+    };
+
+    // First pass: hypothetical sizes of every item; false when a line
+    // would need baseline alignment
+    bool collectFlexItems(LayoutNode* node, const FlexAxes& axes, std::vector<FlexItem>& items);
+    // Second pass for one nowrap line without baselines: grows or shrinks
+    // in a single step and positions. False when an item would shrink
+    // below zero, which needs the general loop.
+    bool layoutSingleLine(LayoutNode* node, std::vector<FlexItem>& items, const FlexAxes& axes, double& lineCross);
+    // Second pass in general: breaks lines, resolves flexible lengths and
+    // positions. Returns the total cross size of the lines.
+    double layoutFlexLines(LayoutNode* node, std::vector<FlexItem>& items, const FlexAxes& axes);
+    void resolveFlexibleLengths(std::vector<FlexItem>& items, const FlexLine& line, const FlexAxes& axes);
+    void positionFlexLine(const FlexLine& line, std::vector<FlexItem>& items, const FlexAxes& axes,
+                          JustifyContent justify);
+    // Lays item out at its final size and moves it to (main, cross)
+    void placeFlexItem(FlexItem& item, const FlexAxes& axes, double main, double cross);
 };
 
 } // namespace layout
@@ -22,8 +22,9 @@ public:
     // Calculate grid container size
     Size calculateGridContainerSize(LayoutNode* node, const LayoutConstraints& constraints);
 
-    // Calculate grid item size
-    Size calculateGridItemSize(LayoutNode* item, const LayoutConstraints& constraints);
+    // Calculate grid item size; results are cached on the item per
+    // constraints and sizing mode
+    Size calculateGridItemSize(LayoutNode* item, const LayoutConstraints& constraints, SizingMode mode = SizingMode::Final);
 
     // Calculate grid item position
     Point calculateGridItemPosition(LayoutNode* item);
@@ -61,10 +62,11 @@ public:
     // Calculate grid areas
     void calculateGridAreas(LayoutNode* node);
 
-    // Place grid items
+    // Place grid items and size the tracks, through the node's
+    // GridTrackCache
     void placeGridItems(LayoutNode* node);
 
-    // Auto-place grid items
+    // Auto-place grid items; done by placeGridItems
     void autoPlaceGridItems(LayoutNode* node);
 
     // Calculate grid item placement
@@ -73,9 +75,6 @@ public:
     // Calculate grid item span
     void calculateGridItemSpan(LayoutNode* item);
 
-    // Calculate grid item position
-    void calculateGridItemPosition(LayoutNode* item);
-
     // Handle grid alignment
     void handleGridAlignment(LayoutNode* node);
 
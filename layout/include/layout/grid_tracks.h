@@ -0,0 +1,213 @@
+#pragma once
+
+#include "enums.h"
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace layout {
+
+class LayoutNode;
+
+// One track of grid-template-columns/rows or grid-auto-columns/rows
+struct GridTrackSize {
+    enum class Kind : uint8_t {
+        Fixed,
+        Auto,
+        // fr; rows are sized like Auto, as their height is indefinite
+        Flex
+    };
+
+    Kind kind;
+    double value;
+
+    static GridTrackSize fixed(double size) { return GridTrackSize{Kind::Fixed, size}; }
+    static GridTrackSize autoSize() { return GridTrackSize{Kind::Auto, 0}; }
+    static GridTrackSize flex(double fraction) { return GridTrackSize{Kind::Flex, fraction}; }
+
+    bool operator==(const GridTrackSize& other) const { return kind == other.kind && value == other.value; }
+    bool operator!=(const GridTrackSize& other) const { return !(*this == other); }
+};
+
+// Track and flow properties of a grid container
+struct GridTemplate {
+    std::vector<GridTrackSize> columns;
+    std::vector<GridTrackSize> rows;
+    GridTrackSize autoColumns = GridTrackSize::autoSize();
+    GridTrackSize autoRows = GridTrackSize::autoSize();
+    GridAutoFlow autoFlow = GridAutoFlow::Row;
+    double columnGap = 0;
+    double rowGap = 0;
+
+    const GridTrackSize& column(size_t index) const { return index < columns.size() ? columns[index] : autoColumns; }
+    const GridTrackSize& row(size_t index) const { return index < rows.size() ? rows[index] : autoRows; }
+
+    bool operator==(const GridTemplate& other) const;
+    bool operator!=(const GridTemplate& other) const { return !(*this == other); }
+};
+
+// grid-row/grid-column of an item. Lines count from 1 as in CSS; 0 is auto.
+struct GridPlacement {
+    uint32_t row = 0;
+    uint32_t column = 0;
+    uint32_t rowSpan = 1;
+    uint32_t columnSpan = 1;
+
+    bool operator==(const GridPlacement& other) const {
+        return row == other.row && column == other.column && rowSpan == other.rowSpan && columnSpan == other.columnSpan;
+    }
+    bool operator!=(const GridPlacement& other) const { return !(*this == other); }
+};
+
+// Tracks an item covers, counted from 0
+struct GridArea {
+    uint32_t row;
+    uint32_t column;
+    uint32_t rowSpan;
+    uint32_t columnSpan;
+
+    uint32_t rowEnd() const { return row + rowSpan; }
+    uint32_t columnEnd() const { return column + columnSpan; }
+};
+
+// Occupied cells of a grid, for auto-placement
+//
+// Lines run along the auto-flow direction: rows for grid-auto-flow: row,
+// columns for column. Each line keeps the occupied cells across it as
+// sorted, merged intervals, so a free slot is found by binary search
+// instead of testing cell by cell, and a long grid costs memory only for
+// the lines its items reach.
+class GridOccupancy {
+public:
+    explicit GridOccupancy(uint32_t crossCount = 1);
+
+    // Empties the grid; lines are crossCount cells long
+    void reset(uint32_t crossCount);
+
+    uint32_t crossCount() const { return crossCount_; }
+    size_t lineCount() const { return lines_.size(); }
+
+    bool isFree(uint32_t line, uint32_t cross, uint32_t lineSpan, uint32_t crossSpan) const;
+    void occupy(uint32_t line, uint32_t cross, uint32_t lineSpan, uint32_t crossSpan);
+
+    // First offset at or after cross where crossSpan cells are free in
+    // lines [line, line + lineSpan), or crossCount() when there is none
+    uint32_t findFree(uint32_t line, uint32_t cross, uint32_t lineSpan, uint32_t crossSpan) const;
+
+    // Lines before this one are full; dense packing starts here
+    size_t firstOpenLine() const { return firstOpen_; }
+
+private:
+    struct Interval {
+        uint32_t start;
+        uint32_t end;
+    };
+
+    std::vector<std::vector<Interval>> lines_;
+    uint32_t crossCount_;
+    size_t firstOpen_;
+
+    // End of the occupied interval meeting [cross, cross + span) in line,
+    // or cross when those cells are free
+    uint32_t blockedUntil(size_t line, uint32_t cross, uint32_t span) const;
+    bool isFull(size_t line) const;
+};
+
+// Placement and track sizes of one grid container, kept between layouts
+//
+// Items are compared with the previous layout in child order. When only
+// new items follow the old ones, they are auto-placed from where
+// placement stopped, and only the tracks they or changed items touch are
+// re-resolved; row positions are recomputed from the first changed row.
+// Anything else places the whole grid again.
+class GridTrackCache {
+public:
+    // Item as given to update(); size is its margin box
+    struct Item {
+        const LayoutNode* node;
+        GridPlacement placement;
+        Size size;
+    };
+
+    GridTrackCache();
+
+    // Places items and sizes the tracks for a content box availableWidth
+    // wide
+    void update(const GridTemplate& style, const std::vector<Item>& items, double availableWidth);
+    // Forget everything; the next update() starts over
+    void reset();
+
+    // Per item, in update() order
+    const std::vector<GridArea>& areas() const { return areas_; }
+
+    size_t columnCount() const { return columns_.size(); }
+    size_t rowCount() const { return rows_.size(); }
+    double columnPosition(size_t column) const { return columns_[column].position; }
+    double columnSize(size_t column) const { return columns_[column].size; }
+    double rowPosition(size_t row) const { return rows_[row].position; }
+    double rowSize(size_t row) const { return rows_[row].size; }
+    // Content size of the grid, gaps included
+    Size gridSize() const;
+    // Rectangle of area relative to the content box
+    Rect areaRect(const GridArea& area) const;
+
+    // Statistics of the last update()
+    size_t placedItemCount() const { return placedItems_; }
+    size_t resolvedTrackCount() const { return resolvedTracks_; }
+    size_t fullPlacementCount() const { return fullPlacements_; }
+
+private:
+    struct Track {
+        // Largest contribution of the items only in this track
+        double content = 0;
+        // Growth from items spanning several tracks
+        double extra = 0;
+        double size = 0;
+        double position = 0;
+        // Items only in this track
+        std::vector<uint32_t> items;
+        bool rescan = false;
+    };
+
+    struct Cursor {
+        uint32_t line = 0;
+        uint32_t cross = 0;
+    };
+
+    GridTemplate style_;
+    double availableWidth_;
+    std::vector<const LayoutNode*> nodes_;
+    std::vector<GridPlacement> placements_;
+    std::vector<Size> sizes_;
+    std::vector<GridArea> areas_;
+    // Items spanning more than one column or row
+    std::vector<uint32_t> spanning_;
+    GridOccupancy occupancy_;
+    Cursor cursor_;
+    std::vector<Track> columns_;
+    std::vector<Track> rows_;
+    // Tracks whose contributions changed since the last resolve
+    std::vector<uint32_t> dirtyColumns_;
+    std::vector<uint32_t> dirtyRows_;
+
+    size_t placedItems_;
+    size_t resolvedTracks_;
+    size_t fullPlacements_;
+
+    bool isRowFlow() const;
+    bool isDense() const;
+    // Places items [first, end); false when an item cannot be placed
+    // without moving earlier ones
+    bool placeItems(size_t first, size_t end, bool full);
+    void placeAll(const std::vector<Item>& items);
+    void placeAuto(uint32_t index);
+    void setArea(uint32_t index, uint32_t line, uint32_t cross, uint32_t lineSpan, uint32_t crossSpan);
+    void addContribution(uint32_t index);
+    void removeContribution(uint32_t index, const Size& oldSize);
+    // Re-resolves tracks; rows from firstRow on are re-positioned
+    void resolveTracks(size_t firstRow);
+    void distributeSpanning();
+};
+
+} // namespace layout
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "layout_node.h"
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace layout {
+
+// Bounding-volume hierarchy over the laid-out boxes of a tree
+//
+// Every node is indexed by the part of its box that can be hit: its
+// layout rect clipped by its ancestors', as LayoutNode::hitTest clips.
+// Nodes are numbered by their place in the tree's PaintOrderList and a
+// query returns the hit painted last. The hierarchy is rebuilt after
+// structural changes and only refit when boxes move or resize or the
+// paint order changes.
+class HitTestIndex {
+public:
+    HitTestIndex();
+
+    // Brings the index up to date with tree if it was invalidated
+    void update(const LayoutTree& tree);
+    // Boxes have moved; the next update() refits
+    void invalidate() { stale_ = true; }
+    // Forget the tree; the next update() rebuilds
+    void reset();
+
+    // Topmost node containing point, or nullptr
+    LayoutNode* hitTest(const Point& point) const;
+
+    // Statistics
+    size_t itemCount() const { return items_.size(); }
+    size_t rebuildCount() const { return rebuildCount_; }
+    size_t refitCount() const { return refitCount_; }
+
+private:
+    static constexpr size_t kLeafSize = 4;
+
+    // Edges included, like Rect::contains; empty when min > max
+    struct Bounds {
+        double minX, minY, maxX, maxY;
+
+        static Bounds empty();
+        static Bounds everything();
+        static Bounds of(const Rect& rect);
+        bool isEmpty() const { return minX > maxX || minY > maxY; }
+        bool contains(const Point& point) const {
+            return point.x >= minX && point.x <= maxX && point.y >= minY && point.y <= maxY;
+        }
+        Bounds intersection(const Bounds& other) const;
+        void expand(const Bounds& other);
+    };
+
+    struct Item {
+        LayoutNode* node;
+        Bounds bounds;
+        uint32_t paintOrder;
+    };
+
+    // count > 0: leaf over items_[start, start + count); otherwise the
+    // children are the next node and nodes_[start]
+    struct BvhNode {
+        Bounds bounds;
+        uint32_t start;
+        uint32_t count;
+        // Highest paint order below, so queries can skip what cannot win
+        uint32_t maxPaintOrder;
+    };
+
+    std::vector<Item> items_;
+    std::vector<BvhNode> nodes_;
+    // Per arena index: position in items_
+    std::vector<uint32_t> itemOf_;
+
+    const LayoutTree* tree_;
+    LayoutNode* root_;
+    uint64_t structureVersion_;
+    uint64_t paintOrderVersion_;
+    bool stale_;
+    size_t rebuildCount_;
+    size_t refitCount_;
+
+    void rebuild(const LayoutTree& tree);
+    void refit();
+    // Copies the paint order of the tree into items_
+    void assignPaintOrder(const LayoutTree& tree);
+    // Stores the clipped bounds of node's subtree into items_
+    void clipBounds(const LayoutNode* node, const Bounds& clip);
+    uint32_t buildNode(size_t begin, size_t end);
+    void refitNode(size_t index);
+};
+
+} // namespace layout
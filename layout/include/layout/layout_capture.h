@@ -0,0 +1,51 @@
+#pragma once
+
+#include "layout_node.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace layout {
+
+// Binary captures of a layout tree, for replaying real pages in the
+// benches and in bug reports without their HTML, CSS or style pass
+//
+// A capture holds the tree's structure, every box's style and box model,
+// the nodes' text, font metrics and size constraints, and the layout rects
+// they had when captured. Boxes, grid templates and font metrics shared by
+// many nodes are stored once. The file is a header followed by sections of
+// fixed-size records, each 8-byte aligned, so a mapped capture is read in
+// place:
+//
+//   header     magic "LYTC", version, record counts, section offsets
+//   nodes      preorder; parent, box and font indices, text span, sizes,
+//              layout rect, line height and baseline
+//   boxes      one per distinct style
+//   fonts      distinct font metrics
+//   templates  grid templates, naming runs of the track table
+//   tracks     grid track sizes
+//   strings    the nodes' text, back to back
+//
+// Values are stored in the writer's byte order, which must be little
+// endian; readers refuse captures of another version or byte order.
+constexpr uint32_t kLayoutCaptureVersion = 2;
+
+// Empty when the tree has no root
+std::vector<uint8_t> serializeLayoutTree(const LayoutTree& tree);
+
+// nullptr with error set when the data is not a well-formed capture. Each
+// node gets its own copy of its box.
+std::unique_ptr<LayoutTree> deserializeLayoutTree(const uint8_t* data, size_t size, std::string& error);
+
+// Written through a temporary file, so readers never see half a capture
+bool saveLayoutTree(const LayoutTree& tree, const std::string& path, std::string& error);
+// Maps the file where the platform allows
+std::unique_ptr<LayoutTree> loadLayoutTree(const std::string& path, std::string& error);
+
+// Whether data starts like a capture of any version
+bool isLayoutCapture(const uint8_t* data, size_t size);
+bool isLayoutCaptureFile(const std::string& path);
+
+} // namespace layout
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "hit_test_index.h"
 #include "layout_node.h"
+#include "layout_trace.h"
+#include "stacking_context.h"
+#include "task_pool.h"
 #include "types.h"
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -20,18 +25,50 @@ public:
     // Viewport
     const Rect& viewport() const { return viewport_; }
     void setViewport(const Rect& viewport) { viewport_ = viewport; }
+    // Moves the viewport; with lazy layout, boxes it brings into range are
+    // laid out before this returns
+    void scrollTo(const Point& position);
+
+    // Lazy layout, off by default, stacks the root's children in the block
+    // direction and lays out only those within lazyLayoutDistance()
+    // viewports of the visible region; the rest hold estimated sizes until
+    // scrolled to. When estimates above the viewport turn out wrong, the
+    // viewport moves with the box at its top so the content does not jump.
+    bool lazyLayout() const { return lazyLayout_; }
+    void setLazyLayout(bool enabled);
+    double lazyLayoutDistance() const { return lazyLayoutDistance_; }
+    void setLazyLayoutDistance(double viewports) { lazyLayoutDistance_ = std::max(0.0, viewports); }
+
+    // Threads that lay out independent formatting contexts alongside the
+    // calling thread; 0, the default, lays out sequentially
+    size_t workerCount() const;
+    void setWorkerCount(size_t count);
 
     // Layout the entire tree
     void layout();
 
-    // Update layout for dirty nodes
+    // Update layout for dirty nodes; clean subtrees whose constraints did
+    // not change keep their layout
     void updateLayout();
 
     // Invalidate layout
     void invalidateLayout();
+    // Invalidate one node after a change to it, e.g. its text
+    void invalidateLayout(LayoutNode* node);
 
-    // Hit testing
+    // Hit testing against a spatial index of the laid-out boxes, refit
+    // after each layout; the topmost box in paint order wins
     LayoutNode* hitTest(const Point& point) const;
+    // One result per point, nullptr where nothing was hit
+    std::vector<LayoutNode*> hitTest(const std::vector<Point>& points) const;
+
+    // Boxes in the order the renderer paints them, bottom first; empty
+    // without a tree
+    const std::vector<PaintItem>& paintItems() const;
+
+    // Per-phase trace events and counters of the layout algorithms; empty
+    // unless the library is built with LAYOUT_TRACING
+    LayoutTracer& tracer() const { return LayoutTracer::shared(); }
 
     // Get layout bounds
     Rect getLayoutBounds() const;
@@ -39,6 +76,16 @@ public:
 private:
     std::unique_ptr<LayoutTree> tree_;
     Rect viewport_;
+    std::unique_ptr<TaskPool> taskPool_;
+    mutable HitTestIndex hitTestIndex_;
+    bool lazyLayout_;
+    double lazyLayoutDistance_;
+
+    LayoutConstraints viewportConstraints() const;
+    // Lays out the root's children near the viewport, keeping it anchored
+    void layoutNearViewport();
+    // First laid-out child of the root reaching into the viewport
+    LayoutNode* scrollAnchor() const;
 };
 
 } // namespace layout
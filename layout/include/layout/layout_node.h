@@ -1,18 +1,41 @@
 #pragma once
 
 #include "box_model.h"
+#include "exclusion_space.h"
 #include "types.h"
+#include <atomic>
+#include <cstdint>
+#include <iterator>
 #include <memory>
+#include <new>
 #include <vector>
 #include <string>
 
+struct ApolloLayoutRecord;
+
 namespace layout {
 
 // Forward declarations
 class LayoutEngine;
 class LayoutContext;
+class LayoutTree;
+class LayoutNodeArena;
+class LayoutChildRange;
+class TaskPool;
+class PaintOrderList;
+class LayoutSnapshot;
+
+// Position of a node in its tree's arena
+using NodeIndex = uint32_t;
+constexpr NodeIndex kInvalidNodeIndex = 0xFFFFFFFFu;
 
 // Layout node that represents an element in the layout tree
+//
+// Nodes are created by LayoutTree::createNode and live in the tree's
+// arena; parent, child and sibling links are arena indices. Geometry and
+// layout flags sit in the node itself, while text, font metrics and floats
+// (which most nodes never set) are kept out of line. A node constructed on
+// its own can be measured and laid out but cannot have children.
 class LayoutNode {
 public:
     LayoutNode();
@@ -22,7 +45,11 @@ public:
     // Box data
     const LayoutBox* box() const { return box_.get(); }
     LayoutBox* box() { return box_.get(); }
-    void setBox(std::shared_ptr<LayoutBox> box) { box_ = box; }
+    void setBox(std::shared_ptr<LayoutBox> box) {
+        box_ = box;
+        markNeedsLayout();
+        markNeedsPaintOrder();
+    }
 
     // Layout properties
     const Rect& layoutRect() const { return layoutRect_; }
@@ -44,18 +71,48 @@ public:
     bool needsLayout() const { return needsLayout_; }
     void setNeedsLayout(bool needs) { needsLayout_ = needs; }
 
+    // Some descendant needs layout while this node itself may not
+    bool childNeedsLayout() const { return childNeedsLayout_; }
+    void setChildNeedsLayout(bool needs) { childNeedsLayout_ = needs; }
+
+    // Constraints of the last layout; a node that does not need layout and
+    // gets the same constraints again keeps its result
+    const LayoutConstraints& lastConstraints() const { return lastConstraints_; }
+    bool hasLayoutConstraints() const { return hasLayoutConstraints_; }
+
+    // The layout rect is a placeholder left by layoutRange(): an estimate
+    // from calculateIntrinsicSize(), or a result the node has outgrown
+    bool hasEstimatedLayout() const { return hasEstimatedLayout_; }
+
+    // The node's size does not depend on its subtree (the root, tight
+    // constraints, or out of flow), so relayout inside it stops here
+    bool isLayoutBoundary() const;
+
+    // Marks the node for layout and its ancestors up to the nearest layout
+    // boundary; the ones above only learn that a descendant is dirty
+    void markNeedsLayout();
+
+    // Call after changing the box's z-index, position, opacity or float, so
+    // the tree's paint order is sorted again where it depends on them
+    void markNeedsPaintOrder();
+
     bool isPositioned() const;
     bool isFloating() const;
     bool isBlockLevel() const;
     bool isInlineLevel() const;
 
     // Text content
-    const std::string& textContent() const { return textContent_; }
-    void setTextContent(const std::string& text) { textContent_ = text; }
+    const std::string& textContent() const { return coldData().textContent; }
+    void setTextContent(const std::string& text) {
+        if (text != textContent()) {
+            mutableColdData().textContent = text;
+            markNeedsLayout();
+        }
+    }
 
     // Font metrics
-    const FontMetrics& fontMetrics() const { return fontMetrics_; }
-    void setFontMetrics(const FontMetrics& metrics) { fontMetrics_ = metrics; }
+    const FontMetrics& fontMetrics() const { return coldData().fontMetrics; }
+    void setFontMetrics(const FontMetrics& metrics) { mutableColdData().fontMetrics = metrics; }
 
     // Line height
     double lineHeight() const { return lineHeight_; }
@@ -65,14 +122,19 @@ public:
     double baseline() const { return baseline_; }
     void setBaseline(double baseline) { baseline_ = baseline; }
 
-    // Parent-child relationships
-    LayoutNode* parent() const { return parent_; }
-    void setParent(LayoutNode* parent) { parent_ = parent; }
+    // Arena slot
+    LayoutNodeArena* arena() const { return arena_; }
+    NodeIndex index() const { return index_; }
+    // Owning tree; nullptr for standalone nodes
+    LayoutTree* tree() const;
 
-    const std::vector<LayoutNode*>& children() const { return children_; }
-    std::vector<LayoutNode*>& children() { return children_; }
+    // Parent-child relationships
+    LayoutNode* parent() const;
+    // Children in order, by following the sibling links
+    LayoutChildRange children() const;
 
-    // Add child
+    // Add child; the child must come from the same arena and is detached
+    // from its old parent first
     void addChild(LayoutNode* child);
     void insertChild(LayoutNode* child, size_t index);
 
@@ -84,7 +146,7 @@ public:
     void clearChildren();
 
     // Get child count
-    size_t childCount() const { return children_.size(); }
+    size_t childCount() const { return childCount_; }
 
     // Get child at index
     LayoutNode* childAt(size_t index) const;
@@ -114,10 +176,10 @@ public:
     size_t height() const;
 
     // Is root
-    bool isRoot() const { return parent_ == nullptr; }
+    bool isRoot() const { return parent_ == kInvalidNodeIndex; }
 
     // Is leaf
-    bool isLeaf() const { return children_.empty(); }
+    bool isLeaf() const { return firstChild_ == kInvalidNodeIndex; }
 
     // Get all descendants
     std::vector<LayoutNode*> getAllDescendants() const;
@@ -157,6 +219,13 @@ public:
     void layoutChildren(const LayoutConstraints& constraints);
     void layoutPositionedChildren();
     void layoutFloatingChildren();
+    // Lays out only the children that are dirty, each with its last constraints
+    void layoutDirtyChildren();
+    // Lays out the node with its children stacked in the block direction,
+    // but only the children overlapping [top, bottom); the others keep or
+    // get a placeholder size and are laid out when a later range reaches
+    // them
+    void layoutRange(const LayoutConstraints& constraints, double top, double bottom);
 
     // Size calculation
     Size calculateEmptyIntrinsicSize() const;
@@ -174,15 +243,24 @@ public:
     void collapseMarginsWithParent();
     void collapseMarginsWithChildren();
 
-    // Float handling
+    // Float handling. On a block formatting context root the floats placed
+    // in it are also held in its exclusion space, at their margin boxes'
+    // offsets from the root.
     void addFloat(LayoutNode* floatNode);
     void removeFloat(LayoutNode* floatNode);
+    // Removes the floats that are children of container
+    void removeFloatsOf(const LayoutNode* container);
     void clearFloats();
-    const std::vector<LayoutNode*>& floats() const { return floats_; }
+    const std::vector<LayoutNode*>& floats() const { return coldData().floats; }
+    const ExclusionSpace& exclusionSpace() const { return coldData().exclusionSpace; }
+    ExclusionSpace& mutableExclusionSpace() { return mutableColdData().exclusionSpace; }
 
-    // Clear handling
+    // Clear handling: drops the floats on the given side
     void clearFloats(Clear clear);
 
+    // Grid placement and track sizes GridLayout keeps between layouts
+    GridTrackCache& gridTrackCache();
+
     // Stacking context
     void createStackingContext();
     void destroyStackingContext();
@@ -193,8 +271,16 @@ public:
     bool isContainingBlock() const;
 
     // Formatting context
+    // Nearest ancestor-or-self whose layout is independent of the outside;
+    // the tree root when there is none
     LayoutNode* getFormattingContextRoot() const;
     bool isFormattingContextRoot() const;
+    // Offset of this node's layout rect from ancestor's
+    Point offsetFrom(const LayoutNode* ancestor) const;
+    // Formatting context roots and flex or grid items with children: their
+    // layout reads nothing outside their subtree, so siblings like these
+    // can be laid out in parallel
+    bool isIndependentFormattingContext() const;
 
     // Text layout
     void layoutText();
@@ -244,7 +330,14 @@ public:
     // Overflow
     void handleOverflow();
     void clipContent();
+    // Scrolls an overflow: scroll or auto box, clamped to its children's
+    // extent. Scrolling moves composited layers, not boxes: it marks
+    // nothing for layout and leaves snapshots valid, and the embedder hands
+    // scrollOffset() to the box's scroll container layer.
     void scrollContent(const Point& offset);
+    Point scrollOffset() const { return coldData().scrollOffset; }
+    // How far scrollContent() can go
+    Size scrollExtent() const;
 
     // Invalidation
     void invalidateLayout();
@@ -257,22 +350,55 @@ public:
     void updateChildren();
     void updateParent();
 
-    // Clone
-    std::unique_ptr<LayoutNode> clone() const;
-    std::unique_ptr<LayoutNode> cloneShallow() const;
+    // Measurement cache: sizes the flex and grid passes measured for this
+    // node, by constraints and sizing mode. Cleared whenever the node or
+    // anything its size depends on needs layout.
+    static constexpr size_t kMeasurementCacheSize = 4;
+    bool findMeasurement(const LayoutConstraints& constraints, SizingMode mode, Size& size) const;
+    void cacheMeasurement(const LayoutConstraints& constraints, SizingMode mode, const Size& size);
+    void clearMeasurementCache();
+    // Clears and frees the measurement cache
+    void releaseMeasurementCache();
+
+    // Clone into tree's arena; clone() copies the subtree
+    LayoutNode* clone(LayoutTree& tree) const;
+    LayoutNode* cloneShallow(LayoutTree& tree) const;
 
     // Reset
     void reset();
 
-    // Copy constructor and assignment
+    // Copy constructor and assignment; they copy the node's data, never
+    // its arena slot or links
     LayoutNode(const LayoutNode& other);
     LayoutNode& operator=(const LayoutNode& other);
 
-    // Move constructor and assignment
+    // Move constructor and assignment, with the same rule
     LayoutNode(LayoutNode&& other) noexcept;
     LayoutNode& operator=(LayoutNode&& other) noexcept;
 
 private:
+    friend class LayoutNodeArena;
+    friend class LayoutTree;
+
+    struct Measurement {
+        LayoutConstraints constraints;
+        SizingMode mode;
+        Size size;
+    };
+
+    // Data only some nodes have
+    struct ColdData {
+        std::string textContent;
+        FontMetrics fontMetrics;
+        std::vector<LayoutNode*> floats;
+        ExclusionSpace exclusionSpace;
+        std::unique_ptr<GridTrackCache> gridTracks;
+        // At most kMeasurementCacheSize, replaced oldest first
+        std::vector<Measurement> measurements;
+        size_t nextMeasurement = 0;
+        Point scrollOffset;
+    };
+
     std::shared_ptr<LayoutBox> box_;
     Rect layoutRect_;
     Size intrinsicSize_;
@@ -281,38 +407,203 @@ private:
     
     bool isLayoutDirty_;
     bool needsLayout_;
+    bool childNeedsLayout_;
+    bool hasLayoutConstraints_;
+    bool hasEstimatedLayout_;
+    LayoutConstraints lastConstraints_;
     
-    std::string textContent_;
-    FontMetrics fontMetrics_;
     double lineHeight_;
     double baseline_;
     
-    LayoutNode* parent_;
-    std::vector<LayoutNode*> children_;
-    std::vector<LayoutNode*> floats_;
+    LayoutNodeArena* arena_;
+    NodeIndex index_;
+    NodeIndex parent_;
+    NodeIndex firstChild_;
+    NodeIndex lastChild_;
+    NodeIndex nextSibling_;
+    NodeIndex previousSibling_;
+    uint32_t childCount_;
+
+    std::unique_ptr<ColdData> cold_;
     
-    void updateParentChildRelationships();
-    void collectDescendants(LayoutNode* node, std::vector<LayoutNode*>& descendants) const;
+    LayoutNode* nodeAt(NodeIndex index) const;
+    const ColdData& coldData() const;
+    ColdData& mutableColdData();
+    void copyData(const LayoutNode& other);
+    // Links child in front of before, or last when before is nullptr
+    void linkChild(LayoutNode* child, LayoutNode* before);
+    void unlinkChild(LayoutNode* child);
+    // Margin box as an exclusion in root's space
+    Rect floatMarginBox(const LayoutNode* root) const;
+    void rebuildExclusionSpace();
+    void collectDescendants(const LayoutNode* node, std::vector<LayoutNode*>& descendants) const;
+};
+
+// Children of a node, walked through the next-sibling links
+class LayoutChildRange {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = LayoutNode*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = LayoutNode* const*;
+        using reference = LayoutNode* const&;
+
+        explicit iterator(LayoutNode* node) : node_(node) {}
+
+        reference operator*() const { return node_; }
+        iterator& operator++() { node_ = node_->nextSibling(); return *this; }
+        iterator operator++(int) { iterator previous = *this; ++*this; return previous; }
+        bool operator==(const iterator& other) const { return node_ == other.node_; }
+        bool operator!=(const iterator& other) const { return node_ != other.node_; }
+
+    private:
+        LayoutNode* node_;
+    };
+
+    explicit LayoutChildRange(LayoutNode* first) : first_(first) {}
+
+    iterator begin() const { return iterator(first_); }
+    iterator end() const { return iterator(nullptr); }
+    bool empty() const { return first_ == nullptr; }
+
+private:
+    LayoutNode* first_;
 };
 
+// Slab owning the nodes of one LayoutTree
+//
+// Nodes are constructed in fixed-size chunks that never move, so node
+// pointers stay valid while the arena grows, and each node is named by a
+// 32-bit index. Destroyed nodes leave their slot to the next created one.
+// Tree-wide passes walk the slots in index order.
+class LayoutNodeArena {
+public:
+    static constexpr uint32_t kChunkBits = 8;
+    static constexpr uint32_t kChunkSize = 1u << kChunkBits;
+
+    explicit LayoutNodeArena(LayoutTree* tree = nullptr);
+    ~LayoutNodeArena();
+
+    LayoutNodeArena(const LayoutNodeArena&) = delete;
+    LayoutNodeArena& operator=(const LayoutNodeArena&) = delete;
+
+    LayoutNode* create(std::shared_ptr<LayoutBox> box = nullptr);
+    // Makes room for count more nodes, so creating them allocates nothing
+    void reserve(size_t count);
+    // The node must already be unlinked from the tree
+    void destroy(LayoutNode* node);
+    void clear();
+
+    // nullptr for free slots and kInvalidNodeIndex
+    LayoutNode* at(NodeIndex index) const {
+        if (index >= end_ || !live_[index]) return nullptr;
+        Slot& slot = chunks_[index >> kChunkBits][index & (kChunkSize - 1)];
+        return std::launder(reinterpret_cast<LayoutNode*>(slot.bytes));
+    }
+
+    LayoutTree* tree() const { return tree_; }
+
+    // Times a node has been created at index, so a saved index and
+    // generation tell the node from a later one reusing its slot; 0 for
+    // slots never used
+    uint32_t generation(NodeIndex index) const { return index < generations_.size() ? generations_[index] : 0; }
+
+    // Bumped whenever a node is created or destroyed, or a link changes
+    uint64_t structureVersion() const { return structureVersion_; }
+    void noteStructureChange() { ++structureVersion_; }
+
+    // One past the highest index in use so far
+    NodeIndex end() const { return end_; }
+    size_t size() const { return size_; }
+    // Bytes of slots and bookkeeping; out-of-line node data is not counted
+    size_t memoryUsage() const;
+
+private:
+    struct Slot {
+        alignas(LayoutNode) unsigned char bytes[sizeof(LayoutNode)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> chunks_;
+    std::vector<bool> live_;
+    std::vector<NodeIndex> free_;
+    // Kept across clear(), which hands out indices from 0 again
+    std::vector<uint32_t> generations_;
+    LayoutTree* tree_;
+    NodeIndex end_;
+    size_t size_;
+    uint64_t structureVersion_;
+};
+
+inline LayoutNode* LayoutNode::nodeAt(NodeIndex index) const {
+    return arena_ ? arena_->at(index) : nullptr;
+}
+
+inline LayoutNode* LayoutNode::parent() const {
+    return nodeAt(parent_);
+}
+
+inline LayoutChildRange LayoutNode::children() const {
+    return LayoutChildRange(nodeAt(firstChild_));
+}
+
+inline LayoutTree* LayoutNode::tree() const {
+    return arena_ ? arena_->tree() : nullptr;
+}
+
 // Layout tree for managing the layout hierarchy
 class LayoutTree {
 public:
     LayoutTree();
     ~LayoutTree();
 
-    // Root node
-    LayoutNode* root() const { return root_.get(); }
-    void setRoot(std::unique_ptr<LayoutNode> root);
-
-    // Create new node
-    std::unique_ptr<LayoutNode> createNode();
-    std::unique_ptr<LayoutNode> createNode(std::shared_ptr<LayoutBox> box);
+    // Root node; it must have been created by this tree
+    LayoutNode* root() const { return root_; }
+    void setRoot(LayoutNode* root);
+
+    // Create new node, owned by the tree and not linked yet
+    LayoutNode* createNode();
+    LayoutNode* createNode(std::shared_ptr<LayoutBox> box);
+
+    // Replaces the tree's nodes with those of a record array filled by the
+    // style engine (layout_records.h), linked in record order. The boxes
+    // share one allocation and records with the same values one style, so
+    // nothing is allocated per node but the text of text nodes. Returns
+    // the new root, or nullptr, leaving the tree as it was, when a record
+    // is invalid.
+    LayoutNode* adoptRecords(const ApolloLayoutRecord* records, size_t count, const char* text, size_t textLength);
+
+    // Node storage
+    const LayoutNodeArena& arena() const { return arena_; }
+    LayoutNode* nodeAt(NodeIndex index) const { return arena_.at(index); }
+
+    // Pool for laying out independent formatting contexts in parallel;
+    // nullptr lays out on the calling thread
+    TaskPool* taskPool() const { return taskPool_; }
+    void setTaskPool(TaskPool* pool) { taskPool_ = pool; }
+
+    // Measurement cache statistics, summed over the tree's nodes
+    uint64_t measurementCacheHits() const { return measurementCacheHits_.load(std::memory_order_relaxed); }
+    uint64_t measurementCacheMisses() const { return measurementCacheMisses_.load(std::memory_order_relaxed); }
+    void resetMeasurementCacheStats();
+
+    // Paint order of the attached nodes, brought up to date on each call;
+    // not to be called while the tree is being laid out in parallel
+    const PaintOrderList& paintOrder() const;
+
+    // Immutable copy of the laid-out geometry, safe to read on other
+    // threads while this tree is mutated. The same snapshot is returned
+    // until the structure, a layout or a style changes; code that moves
+    // boxes by other means calls noteContentChange().
+    std::shared_ptr<const LayoutSnapshot> snapshot() const;
+    uint64_t contentVersion() const { return contentVersion_.load(std::memory_order_relaxed); }
+    void noteContentChange() { contentVersion_.fetch_add(1, std::memory_order_relaxed); }
 
     // Add node as child
     void addChild(LayoutNode* parent, LayoutNode* child);
 
-    // Remove node
+    // Remove node; it is destroyed along with its subtree
     void removeNode(LayoutNode* node);
 
     // Move node
@@ -321,7 +612,12 @@ public:
     // Clear all nodes
     void clear();
 
-    // Get all nodes
+    // Frees every node's measurement cache, under memory pressure; layout
+    // stays valid, and the next one measures again
+    void releaseMeasurementCaches();
+
+    // Get all nodes attached to the root. This and the other tree-wide
+    // queries scan the arena, so results come in index order.
     std::vector<LayoutNode*> getAllNodes() const;
 
     // Get all leaf nodes
@@ -369,6 +665,9 @@ public:
     // Invalidate layout for all nodes
     void invalidateLayout();
 
+    // Invalidate one node; the next layout only revisits its dirty path
+    void invalidateNode(LayoutNode* node);
+
     // Validate tree structure
     bool isValid() const;
 
@@ -376,20 +675,25 @@ public:
     std::unique_ptr<LayoutTree> clone() const;
 
 private:
-    std::unique_ptr<LayoutNode> root_;
-
-    void collectAllNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const;
-    void collectLeafNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const;
+    LayoutNodeArena arena_;
+    LayoutNode* root_;
+    TaskPool* taskPool_;
+    std::atomic<uint64_t> measurementCacheHits_;
+    std::atomic<uint64_t> measurementCacheMisses_;
+    mutable std::unique_ptr<PaintOrderList> paintOrder_;
+    std::atomic<uint64_t> contentVersion_;
+    mutable std::shared_ptr<const LayoutSnapshot> snapshot_;
+
+    friend class LayoutNode;
+
+    // Attached nodes matching predicate, in index order
+    template <typename Predicate>
+    std::vector<LayoutNode*> collectNodes(Predicate predicate) const;
+    // Per index: whether the slot holds a node attached to the root
+    std::vector<bool> attachedNodes() const;
+    void destroySubtree(LayoutNode* node);
     void collectNodesAtDepth(LayoutNode* node, size_t depth, std::vector<LayoutNode*>& nodes) const;
-    void collectNodesByDisplay(LayoutNode* node, Display display, std::vector<LayoutNode*>& nodes) const;
-    void collectNodesByPosition(LayoutNode* node, Position position, std::vector<LayoutNode*>& nodes) const;
-    void collectPositionedNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const;
-    void collectFloatingNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const;
-    void collectBlockLevelNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const;
-    void collectInlineLevelNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const;
-    void collectStackingContextNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const;
     bool validateNode(LayoutNode* node) const;
-    LayoutNode* findNodeRecursive(LayoutNode* node, const LayoutBox* box) const;
 };
 
 } // namespace layout
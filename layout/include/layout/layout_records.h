@@ -0,0 +1,64 @@
+#pragma once
+
+// Flat node records for building a layout tree in one call, for the Rust
+// style engine. The style engine fills a pre-sized array of records in
+// tree order (every parent before its children, siblings in order) and a
+// text buffer the records' text spans point into; LayoutTree::adoptRecords()
+// or apollo_layout_tree_adopt() then turn the whole array into nodes without
+// a call per node. Enum fields hold the ordinal of the layout enum of the
+// same name (enums.h); lengths are in CSS pixels, top, right, bottom, left.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Parent index of the root record, which must be record 0
+#define APOLLO_LAYOUT_NO_PARENT 0xFFFFFFFFu
+
+// Record flags
+#define APOLLO_LAYOUT_REPLACED 0x01u
+#define APOLLO_LAYOUT_ANONYMOUS 0x02u
+// Inset sides that have values; the others are auto
+#define APOLLO_LAYOUT_INSET_TOP 0x04u
+#define APOLLO_LAYOUT_INSET_RIGHT 0x08u
+#define APOLLO_LAYOUT_INSET_BOTTOM 0x10u
+#define APOLLO_LAYOUT_INSET_LEFT 0x20u
+
+typedef struct ApolloLayoutRecord {
+    // Index of an earlier record
+    uint32_t parent;
+    // Span of the text buffer holding a text node's content; empty for
+    // element boxes
+    uint32_t text_offset;
+    uint32_t text_length;
+    int32_t z_index;
+    float padding[4];
+    float border[4];
+    float margin[4];
+    float insets[4];
+    float opacity;
+    // 0 leaves the line height to layout
+    float line_height;
+    uint8_t display;
+    uint8_t position;
+    uint8_t float_value;
+    uint8_t clear;
+    uint8_t visibility;
+    uint8_t overflow;
+    uint8_t box_sizing;
+    uint8_t flags;
+} ApolloLayoutRecord;
+
+typedef struct ApolloLayoutTree ApolloLayoutTree;
+
+// Replaces the tree's nodes with the records' (tree is a layout::LayoutTree);
+// returns 0, leaving the tree as it was, when a record is invalid
+int apollo_layout_tree_adopt(ApolloLayoutTree* tree, const ApolloLayoutRecord* records, size_t count,
+                             const char* text, size_t text_length);
+
+#ifdef __cplusplus
+}
+#endif
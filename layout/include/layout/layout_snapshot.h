@@ -0,0 +1,107 @@
+#pragma once
+
+#include "layout_node.h"
+#include "stacking_context.h"
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace layout {
+
+// Immutable copy of a laid-out tree's geometry, for painting off the main
+// thread
+//
+// Nodes are stored in tree order in one array, each with the box
+// properties painting reads, so a snapshot owns no LayoutBox and shares
+// nothing a later mutation of the live tree can reach. Once captured it is
+// only read and may be handed to any number of threads. LayoutTree::
+// snapshot() hands out the same snapshot until the tree changes.
+class LayoutSnapshot {
+public:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    // Box properties painting reads
+    struct Style {
+        Display display;
+        Position position;
+        Visibility visibility;
+        Overflow overflow;
+        ZIndex zIndex;
+        double opacity;
+        Transform transform;
+        EdgeInsets border;
+        EdgeInsets padding;
+        Rect clipRect;
+        InsetOffsets insets;
+    };
+
+    struct Node {
+        // Arena index of the node in the live tree
+        NodeIndex source;
+        uint32_t parent;
+        // One past the last node of this subtree
+        uint32_t subtreeEnd;
+        // Into texts(), or kNone
+        uint32_t text;
+        // Layout rect, in the parent's coordinates and in the root's
+        Rect rect;
+        Rect absoluteRect;
+        // Union of absoluteRect over the subtree, for culling
+        Rect subtreeBounds;
+        double baseline;
+        double lineHeight;
+        Style style;
+        bool hasBox;
+    };
+
+    struct Text {
+        std::string content;
+        FontMetrics metrics;
+    };
+
+    // Paint order entry; node and end index nodes() and paintOrder()
+    struct PaintEntry {
+        uint32_t node;
+        uint32_t end;
+        PaintLayer layer;
+        bool startsStackingContext;
+    };
+
+    // Copies tree as it is now; the tree must not be laid out meanwhile
+    static std::shared_ptr<const LayoutSnapshot> capture(const LayoutTree& tree);
+
+    bool empty() const { return nodes_.empty(); }
+    size_t size() const { return nodes_.size(); }
+    const std::vector<Node>& nodes() const { return nodes_; }
+    const Node& node(uint32_t index) const { return nodes_[index]; }
+    const std::vector<Text>& texts() const { return texts_; }
+    const std::vector<PaintEntry>& paintOrder() const { return paintOrder_; }
+
+    // Index of the node copied from source, or kNone
+    uint32_t find(NodeIndex source) const;
+    // Nodes whose layout rect intersects rect, in tree order; subtrees
+    // entirely outside it are skipped
+    std::vector<uint32_t> nodesIntersecting(const Rect& rect) const;
+
+    // Versions of the live tree when captured
+    uint64_t structureVersion() const { return structureVersion_; }
+    uint64_t contentVersion() const { return contentVersion_; }
+
+private:
+    LayoutSnapshot();
+
+    std::vector<Node> nodes_;
+    std::vector<Text> texts_;
+    std::vector<PaintEntry> paintOrder_;
+    // Per arena index: position in nodes_
+    std::vector<uint32_t> nodeOf_;
+    uint64_t structureVersion_;
+    uint64_t contentVersion_;
+
+    void copySubtree(const LayoutNode* root);
+};
+
+} // namespace layout
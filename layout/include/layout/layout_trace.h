@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace layout {
+
+// Layout algorithms that report to the tracer
+enum class LayoutPhase : uint8_t {
+    Block,
+    Inline,
+    Flex,
+    Grid,
+    Positioned,
+    Text
+};
+
+constexpr size_t kLayoutPhaseCount = 6;
+
+const char* layoutPhaseName(LayoutPhase phase);
+
+// Scoped trace events and per-phase counters for layout
+//
+// Each layout algorithm opens a LAYOUT_TRACE_SCOPE for the node it lays
+// out. While the tracer runs, the scope records a complete event and adds
+// to its phase's counters: nodes, self time (nested scopes excluded) and
+// measurement or text cache hits taken inside it. Events are buffered per
+// thread, so parallel layout does not contend on them. Without
+// LAYOUT_TRACING the macros compile to nothing; with it a scope costs one
+// relaxed load while the tracer is stopped.
+class LayoutTracer {
+public:
+    struct PhaseStats {
+        uint64_t nodes;
+        uint64_t selfNanoseconds;
+        uint64_t cacheHits;
+    };
+
+    struct Event {
+        LayoutPhase phase;
+        // Small per-thread number, in order of the threads' first event
+        uint32_t thread;
+        // Nanoseconds since start()
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    // Open scope on the current thread
+    class Scope {
+    public:
+        explicit Scope(LayoutPhase phase);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        LayoutTracer* tracer_;
+        Scope* parent_;
+        LayoutPhase phase_;
+        std::chrono::steady_clock::time_point start_;
+        uint64_t childNanoseconds_;
+        uint64_t cacheHits_;
+
+        friend class LayoutTracer;
+    };
+
+    LayoutTracer();
+    ~LayoutTracer();
+
+    LayoutTracer(const LayoutTracer&) = delete;
+    LayoutTracer& operator=(const LayoutTracer&) = delete;
+
+    // Tracer the macros report to
+    static LayoutTracer& shared();
+
+    // Starting again keeps earlier events; clear() only while stopped
+    void start();
+    void stop();
+    bool isRunning() const { return running_.load(std::memory_order_relaxed); }
+    void clear();
+
+    // Counts a cache hit against the innermost open scope of this thread
+    static void noteCacheHit();
+
+    // Results; events are read once layout has finished
+    PhaseStats stats(LayoutPhase phase) const;
+    std::vector<Event> events() const;
+    // Chrome trace event JSON (chrome://tracing, Perfetto). Layout threads
+    // are numbered from 2 in process 1, next to the JS profiler's thread 1
+    // when both traces are loaded together.
+    std::string exportChromeTrace() const;
+
+private:
+    struct PhaseCounters {
+        std::atomic<uint64_t> nodes;
+        std::atomic<uint64_t> selfNanoseconds;
+        std::atomic<uint64_t> cacheHits;
+    };
+
+    struct ThreadBuffer {
+        uint32_t thread;
+        std::vector<Event> events;
+    };
+
+    std::atomic<bool> running_;
+    std::chrono::steady_clock::time_point origin_;
+    std::array<PhaseCounters, kLayoutPhaseCount> counters_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+
+    ThreadBuffer& threadBuffer();
+    void record(const Scope& scope, std::chrono::steady_clock::time_point end);
+};
+
+} // namespace layout
+
+#if defined(LAYOUT_TRACING)
+#define LAYOUT_TRACE_SCOPE(phase) ::layout::LayoutTracer::Scope layoutTraceScope(phase)
+#define LAYOUT_TRACE_CACHE_HIT() ::layout::LayoutTracer::noteCacheHit()
+#else
+#define LAYOUT_TRACE_SCOPE(phase) static_cast<void>(0)
+#define LAYOUT_TRACE_CACHE_HIT() static_cast<void>(0)
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "layout_snapshot.h"
+#include "types.h"
+#include <cstdint>
+#include <vector>
+
+namespace layout {
+
+// The compositing layers a snapshot scrolls with
+//
+// Scrolling is done by the compositor, never by layout: every box whose
+// place on screen depends on a scroll offset starts a layer, and a scroll
+// only moves layers and their cached pixels. Layer 0 is the viewport,
+// which never scrolls; layer 1 is the document's scroll container, holding
+// the root box. Below them:
+//
+// - overflow: scroll boxes, and overflow: auto boxes whose content does not
+//   fit, are scroll containers; their descendants move by the scroll offset
+//   and are clipped to the box
+// - position: fixed boxes are children of the viewport, so no scroll moves
+//   them
+// - position: sticky boxes carry their insets, their rect and their
+//   containing block's content box in the space of the nearest scroll
+//   container, which the compositor resolves against its scroll offset
+//   every frame
+//
+// A box belongs to the innermost layer around it; a box that starts a layer
+// belongs to that layer. Children of a layer composite in tree order above
+// it, so fixed layers stack above the document whatever their z-index.
+class ScrollLayers {
+public:
+    static constexpr uint32_t kNone = LayoutSnapshot::kNone;
+
+    enum class Kind {
+        Viewport,
+        ScrollContainer,
+        Fixed,
+        Sticky
+    };
+
+    struct Layer {
+        Kind kind;
+        // Snapshot index of the box starting the layer; kNone for the viewport
+        uint32_t node;
+        // Index into layers(); kNone for the viewport
+        uint32_t parent;
+        // In the parent layer's content space, as laid out
+        Rect rect;
+        // Scroll containers: the size of what they scroll, at least rect's
+        Size contentSize;
+        // Sticky layers: the constraint, in the space of scroller, the
+        // nearest scroll container layer above
+        uint32_t scroller;
+        Rect stickyRect;
+        Rect containingRect;
+        InsetOffsets insets;
+    };
+
+    static ScrollLayers build(const LayoutSnapshot& snapshot, const Size& viewport);
+
+    const std::vector<Layer>& layers() const { return layers_; }
+    // Layer each snapshot node paints into
+    uint32_t layerOf(uint32_t node) const { return node < layerOf_.size() ? layerOf_[node] : kNone; }
+    // The layer node starts, or kNone
+    uint32_t layerStartedBy(uint32_t node) const;
+
+private:
+    std::vector<Layer> layers_;
+    std::vector<uint32_t> layerOf_;
+};
+
+} // namespace layout
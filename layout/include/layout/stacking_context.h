@@ -1,28 +1,119 @@
 #pragma once
 
 #include "layout/layout_node.h"
+#include <cstddef>
+#include <cstdint>
 #include <vector>
-#include <memory>
 
 namespace layout {
 
+// Layer a node is painted in within its stacking context, in painting order
+enum class PaintLayer : uint8_t {
+    Root,       // the tree root, which starts the outermost context
+    NegativeZ,  // child contexts with a negative z-index
+    Block,      // in-flow, non-positioned block-level descendants
+    Float,      // non-positioned floats and their content
+    Inline,     // in-flow, non-positioned inline-level descendants
+    ZeroZ,      // positioned descendants and child contexts at z-index 0
+    PositiveZ   // child contexts with a positive z-index
+};
+
+// One entry of a flattened paint order
+struct PaintItem {
+    LayoutNode* node;
+    // One past the last item painted as part of this item: the end of its
+    // stacking context if it starts one, the next index otherwise
+    uint32_t end;
+    ZIndex zIndex;
+    double opacity;
+    PaintLayer layer;
+    bool startsStackingContext;
+};
+
+// Descendants of a stacking context root that it paints itself, sorted by
+// layer and by tree order within a layer. Child contexts are members too
+// and are painted atomically; their own descendants are not.
 class StackingContext {
 public:
+    struct Member {
+        LayoutNode* node;
+        PaintLayer layer;
+        bool isStackingContext;
+    };
+
     StackingContext();
-    ~StackingContext();
+    explicit StackingContext(LayoutNode* root);
+
+    LayoutNode* root() const { return root_; }
+    const std::vector<Member>& members() const { return members_; }
+
+    // Collects and sorts the members again
+    void gather();
+
+    // Whether node is painted atomically in its parent's context
+    static bool formsStackingContext(const LayoutNode* node);
+    // Layer of a child context by z-index
+    static PaintLayer layerForZIndex(ZIndex zIndex);
 
-    void add_element(std::shared_ptr<LayoutNode> element);
-    void remove_element(std::shared_ptr<LayoutNode> element);
-    std::vector<std::shared_ptr<LayoutNode>> get_elements() const;
+private:
+    LayoutNode* root_;
+    std::vector<Member> members_;
+
+    void collect(LayoutNode* node, bool inFloat);
+};
+
+// Paint order of a whole tree as a flat array
+//
+// The tree is split into stacking contexts, each keeping its own sorted
+// members. Structural changes rebuild everything; a change of z-index,
+// position, opacity or float, reported through
+// LayoutNode::markNeedsPaintOrder(), only re-collects the contexts it
+// affects before the array is flattened again. Painting and hit testing
+// walk items() in order instead of the tree.
+class PaintOrderList {
+public:
+    PaintOrderList();
+
+    // Brings the list up to date with tree
+    void update(const LayoutTree& tree);
+    // node's z-index, position, opacity or float changed
+    void invalidate(LayoutNode* node);
+    // Forget the tree; the next update() rebuilds
+    void reset();
 
-    void set_z_index(int z);
-    int get_z_index() const;
+    const std::vector<PaintItem>& items() const { return items_; }
+    // Changes whenever items() does
+    uint64_t version() const { return version_; }
 
-    void sort_by_z_index();
+    // Statistics
+    size_t stackingContextCount() const { return contexts_.size() - freeContexts_.size(); }
+    size_t rebuildCount() const { return rebuildCount_; }
+    size_t regatherCount() const { return regatherCount_; }
 
 private:
-    std::vector<std::shared_ptr<LayoutNode>> elements;
-    int z_index;
+    std::vector<PaintItem> items_;
+    std::vector<StackingContext> contexts_;
+    std::vector<uint32_t> freeContexts_;
+    // Per arena index: position in contexts_
+    std::vector<uint32_t> contextOf_;
+    // Nodes reported through invalidate() since the last update
+    std::vector<LayoutNode*> changed_;
+
+    const LayoutTree* tree_;
+    LayoutNode* root_;
+    uint64_t structureVersion_;
+    uint64_t version_;
+    size_t rebuildCount_;
+    size_t regatherCount_;
+
+    void rebuild(const LayoutTree& tree);
+    uint32_t createContext(LayoutNode* root);
+    void releaseContext(uint32_t context);
+    // Re-collects a context and creates or releases its child contexts
+    void regather(uint32_t context);
+    // Nearest context strictly above node, or the root's
+    uint32_t enclosingContext(const LayoutNode* node) const;
+    void flatten(uint32_t context, PaintLayer layer);
 };
 
-} // namespace layout
\ No newline at end of file
+} // namespace layout
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace layout {
+
+class TaskGroup;
+
+// Work-stealing pool for fanning layout work out across cores
+//
+// Every worker has its own deque: it pushes and pops its own tasks at the
+// back and, when that runs dry, steals from the front of the others. Tasks
+// submitted from outside the pool go to a shared queue that all workers
+// steal from. Threads waiting on a TaskGroup run queued tasks meanwhile, so
+// groups can nest without tying up workers.
+class TaskPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit TaskPool(size_t workerCount);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // Worker count
+    size_t workerCount() const { return threads_.size(); }
+
+    // Statistics
+    size_t tasksRun() const { return tasksRun_.load(std::memory_order_relaxed); }
+    size_t tasksStolen() const { return tasksStolen_.load(std::memory_order_relaxed); }
+
+private:
+    friend class TaskGroup;
+
+    struct Job {
+        Task task;
+        TaskGroup* group;
+    };
+
+    struct Queue {
+        std::deque<Job> jobs;
+        std::mutex mutex;
+    };
+
+    // One per worker, then the shared queue
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_;
+    std::atomic<size_t> tasksRun_;
+    std::atomic<size_t> tasksStolen_;
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stopRequested_;
+
+    void submit(TaskGroup& group, Task task);
+    // Runs one queued task, if any; returns whether it did
+    bool runOne();
+    bool popJob(Job& job);
+    void runJob(Job& job);
+    void workerLoop(size_t index);
+    // Index of the calling thread's queue
+    size_t queueIndex() const;
+};
+
+// Set of tasks to be joined
+//
+// Without a pool, run() calls the task right away, so callers can use one
+// code path for sequential and parallel layout.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskPool* pool);
+    // Waits for tasks still running
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(TaskPool::Task task);
+
+    // Returns once every task has run; rethrows the first exception one threw
+    void wait();
+
+private:
+    friend class TaskPool;
+
+    TaskPool* pool_;
+    std::atomic<size_t> pending_;
+    std::mutex errorMutex_;
+    std::exception_ptr error_;
+
+    void finish(std::exception_ptr error);
+};
+
+} // namespace layout
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "exclusion_space.h"
 #include "layout_node.h"
 #include "types.h"
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -60,6 +62,17 @@ public:
 
     // Break text into lines
     std::vector<std::string> breakTextIntoLines(const std::string& text, double maxWidth, const FontMetrics& metrics);
+    // Break text into lines whose widths vary, as beside floats; lineWidth
+    // is asked for each line's width in order
+    std::vector<std::string> breakTextIntoLines(const std::string& text, const std::function<double(size_t)>& lineWidth,
+                                                const FontMetrics& metrics);
+
+    // Part of container's content free of floats across [top, top + height),
+    // relative to container
+    LayoutOpportunity lineBoxAt(const LayoutNode* container, double top, double height) const;
+
+    // Lines of node's text, each as wide as the floats beside it allow
+    std::vector<std::string> breakTextAroundFloats(LayoutNode* node);
 
     // Break text into words
     std::vector<std::string> breakTextIntoWords(const std::string& text);
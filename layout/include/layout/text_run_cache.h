@@ -0,0 +1,104 @@
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace layout {
+
+// Bounded LRU cache of shaped advance widths, keyed on font and segment
+//
+// Text is measured a word at a time: measureWidth() splits it into words
+// and whitespace runs and sums their cached widths, so a resize or a
+// re-layout only shapes words it has not seen. The cache is split into
+// shards with a lock each, so parallel layout tasks rarely contend.
+class TextRunCache {
+public:
+    static constexpr size_t kDefaultCapacity = 1 << 16;
+
+    explicit TextRunCache(size_t capacity = kDefaultCapacity);
+
+    TextRunCache(const TextRunCache&) = delete;
+    TextRunCache& operator=(const TextRunCache&) = delete;
+
+    // Process-wide cache used by TextLayout and LayoutNode
+    static TextRunCache& shared();
+
+    // Advance width of one segment, shaped on a miss
+    double advanceWidth(const FontMetrics& metrics, const std::string& segment);
+
+    // Width of text, summed over its words and whitespace runs
+    double measureWidth(const FontMetrics& metrics, const std::string& text);
+
+    // Capacity in segments; shrinking evicts the least recently used
+    size_t capacity() const { return capacity_.load(std::memory_order_relaxed); }
+    void setCapacity(size_t capacity);
+    void clear();
+    // Evicts the least recently used until at most entries remain; the
+    // capacity is unchanged
+    void purge(size_t entries = 0);
+
+    // Statistics
+    size_t size() const;
+    // Approximate bytes held by entries, their keys and the LRU lists
+    size_t memoryUsage() const;
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    void resetStats();
+
+private:
+    static constexpr size_t kShardCount = 16;
+
+    // FontMetrics is all a font is described by in the layout library
+    struct FontKey {
+        double ascent;
+        double descent;
+        double leading;
+        double xHeight;
+        double capHeight;
+
+        explicit FontKey(const FontMetrics& metrics);
+        bool operator==(const FontKey& other) const;
+    };
+
+    struct Key {
+        FontKey font;
+        std::string segment;
+
+        bool operator==(const Key& other) const { return font == other.font && segment == other.segment; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Shard {
+        struct Entry {
+            double width;
+            // Position in lru
+            std::list<const Key*>::iterator use;
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHash> entries;
+        // Most recently used first; points at the keys in entries
+        std::list<const Key*> lru;
+    };
+
+    std::vector<Shard> shards_;
+    std::atomic<size_t> capacity_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+
+    size_t shardCapacity() const;
+    void evict(Shard& shard, size_t limit);
+    static double shapeAdvanceWidth(const FontMetrics& metrics, const std::string& segment);
+};
+
+} // namespace layout
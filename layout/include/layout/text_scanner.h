@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace layout {
+
+// Break opportunities and collapsible whitespace of a text, one bit per byte
+//
+// scan() classifies 16 or 32 bytes at a time with SSE2, AVX2 or NEON,
+// whichever the build targets, and one byte at a time otherwise. Line
+// breaking then walks the bitmaps a 64-bit word at a time instead of
+// looking at every character again.
+class BreakOpportunityMap {
+public:
+    BreakOpportunityMap() : length_(0) {}
+
+    static BreakOpportunityMap scan(const std::string& text);
+
+    size_t length() const { return length_; }
+
+    // Collapsible whitespace: space, tab, line feed, carriage return, form feed
+    bool isWhitespace(size_t index) const { return testBit(whitespace_, index); }
+    // A line may start at index: it is not whitespace and follows whitespace
+    // or a hyphen
+    bool isBreakOpportunity(size_t index) const { return testBit(breaks_, index); }
+
+    // First index at or after from of each kind, or length() if none
+    size_t nextWhitespace(size_t from) const { return findBit(whitespace_, from, false); }
+    size_t nextNonWhitespace(size_t from) const { return findBit(whitespace_, from, true); }
+    size_t nextBreakOpportunity(size_t from) const { return findBit(breaks_, from, false); }
+
+private:
+    std::vector<uint64_t> whitespace_;
+    std::vector<uint64_t> breaks_;
+    size_t length_;
+
+    static bool testBit(const std::vector<uint64_t>& bits, size_t index) {
+        return (bits[index / 64] >> (index % 64)) & 1;
+    }
+    size_t findBit(const std::vector<uint64_t>& bits, size_t from, bool inverted) const;
+};
+
+} // namespace layout
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -149,6 +151,28 @@ struct EdgeInsets {
     bool operator!=(const EdgeInsets& other) const { return !(*this == other); }
 };
 
+// top, right, bottom and left of a positioned box; a side without a
+// value is auto
+struct InsetOffsets {
+    EdgeInsets values;
+    bool hasTop, hasRight, hasBottom, hasLeft;
+
+    InsetOffsets() : values(), hasTop(false), hasRight(false), hasBottom(false), hasLeft(false) {}
+
+    void setTop(double top) { values.top = top; hasTop = true; }
+    void setRight(double right) { values.right = right; hasRight = true; }
+    void setBottom(double bottom) { values.bottom = bottom; hasBottom = true; }
+    void setLeft(double left) { values.left = left; hasLeft = true; }
+
+    bool isAuto() const { return !hasTop && !hasRight && !hasBottom && !hasLeft; }
+
+    bool operator==(const InsetOffsets& other) const {
+        return values == other.values && hasTop == other.hasTop && hasRight == other.hasRight &&
+               hasBottom == other.hasBottom && hasLeft == other.hasLeft;
+    }
+    bool operator!=(const InsetOffsets& other) const { return !(*this == other); }
+};
+
 // Transform matrix for 2D transformations
 struct Transform {
     double m11, m12, m21, m22, dx, dy;
@@ -191,20 +215,25 @@ struct Transform {
         );
     }
     
+    // Bounds of the transformed rect. Each coordinate is a sum of one term
+    // in x and one in y, so its extremes pair the smaller and the larger
+    // products, which gives the corners' bounds without mapping them.
     Rect transform(const Rect& rect) const {
-        Point p1 = transform(rect.topLeft());
-        Point p2 = transform(rect.topRight());
-        Point p3 = transform(rect.bottomLeft());
-        Point p4 = transform(rect.bottomRight());
-        
-        double left = std::min({p1.x, p2.x, p3.x, p4.x});
-        double top = std::min({p1.y, p2.y, p3.y, p4.y});
-        double right = std::max({p1.x, p2.x, p3.x, p4.x});
-        double bottom = std::max({p1.y, p2.y, p3.y, p4.y});
-        
+        double x0 = m11 * rect.x, x1 = m11 * (rect.x + rect.width);
+        double y0 = m21 * rect.y, y1 = m21 * (rect.y + rect.height);
+        double left = std::min(x0, x1) + std::min(y0, y1) + dx;
+        double right = std::max(x0, x1) + std::max(y0, y1) + dx;
+        x0 = m12 * rect.x, x1 = m12 * (rect.x + rect.width);
+        y0 = m22 * rect.y, y1 = m22 * (rect.y + rect.height);
+        double top = std::min(x0, x1) + std::min(y0, y1) + dy;
+        double bottom = std::max(x0, x1) + std::max(y0, y1) + dy;
         return Rect(left, top, right - left, bottom - top);
     }
     
+    bool isTranslation() const {
+        return m11 == 1 && m12 == 0 && m21 == 0 && m22 == 1;
+    }
+    
     bool isIdentity() const {
         return m11 == 1 && m12 == 0 && m21 == 0 && m22 == 1 && dx == 0 && dy == 0;
     }
@@ -249,6 +278,13 @@ struct TextRun {
         : text(text), position(position), size(size), metrics(metrics), color(color), isWhitespace(isWhitespace) {}
 };
 
+// What a measurement is for: an intrinsic contribution or the final size
+enum class SizingMode {
+    Final,
+    MinContent,
+    MaxContent
+};
+
 // Layout constraints
 struct LayoutConstraints {
     Size minSize;
@@ -258,6 +294,11 @@ struct LayoutConstraints {
     LayoutConstraints(const Size& minSize, const Size& maxSize) : minSize(minSize), maxSize(maxSize) {}
     
     bool isValid() const { return minSize.width <= maxSize.width && minSize.height <= maxSize.height; }
+    // Only one size satisfies the constraints
+    bool isTight() const { return minSize == maxSize; }
+
+    bool operator==(const LayoutConstraints& other) const { return minSize == other.minSize && maxSize == other.maxSize; }
+    bool operator!=(const LayoutConstraints& other) const { return !(*this == other); }
     
     Size constrain(const Size& size) const {
         return Size(
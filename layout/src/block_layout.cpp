@@ -1,4 +1,6 @@
 #include "layout/block_layout.h"
+#include "layout/layout_trace.h"
+#include "layout/task_pool.h"
 #include <algorithm>
 #include <cmath>
 
@@ -10,6 +12,7 @@ BlockLayout::BlockLayout() = default;
 BlockLayout::~BlockLayout() = default;
 
 void BlockLayout::layoutBlock(LayoutNode* node, const LayoutConstraints& constraints) {
+    LAYOUT_TRACE_SCOPE(LayoutPhase::Block);
     if (!node || !node->box()) return;
     
     // Calculate block size
@@ -18,22 +21,60 @@ void BlockLayout::layoutBlock(LayoutNode* node, const LayoutConstraints& constra
     // Set layout rect
     node->setLayoutRect(Rect(0, 0, blockSize.width, blockSize.height));
     
+    // A formatting context root starts with no floats
+    if (node->getFormattingContextRoot() == node) {
+        node->clearFloats();
+        node->mutableExclusionSpace().reset(blockSize.width);
+    }
+    
     // Layout block children
     layoutBlockChildren(node, constraints);
     
     // Handle margin collapse
     collapseMargins(node);
-    
-    // Handle floats
-    handleFloats(node);
 }
 
 void BlockLayout::layoutBlockChildren(LayoutNode* node, const LayoutConstraints& constraints) {
     if (!node) return;
     
+    // Independent formatting contexts are laid out in parallel; every
+    // child is positioned after the join
+    TaskGroup group(node->tree() ? node->tree()->taskPool() : nullptr);
+    
+    // Floats go first so the line boxes of the content beside them are
+    // shortened. Floats are formatting context roots of their own.
+    bool hasFloats = false;
+    for (auto* child : node->children()) {
+        if (child && child->isFloating()) {
+            group.run([child, constraints] { child->layout(constraints); });
+            hasFloats = true;
+        }
+    }
+    if (hasFloats) {
+        group.wait();
+        for (auto* child : node->children()) {
+            if (child && child->isFloating()) {
+                positionBlockChild(child);
+            }
+        }
+        handleFloats(node);
+    }
+    
     for (auto* child : node->children()) {
-        if (child && child->isBlockLevel()) {
-            layoutBlockChild(child, constraints);
+        if (!child || !child->isBlockLevel() || child->isFloating()) continue;
+        
+        if (child->isIndependentFormattingContext()) {
+            group.run([child, constraints] { child->layout(constraints); });
+        } else {
+            child->layout(constraints);
+        }
+    }
+    group.wait();
+    
+    for (auto* child : node->children()) {
+        if (child && child->isBlockLevel() && !child->isFloating()) {
+            positionBlockChild(child);
+            clearFloats(child, child->box()->clear());
         }
     }
 }
@@ -93,7 +134,13 @@ void BlockLayout::collapseMargins(LayoutNode* node) {
 void BlockLayout::handleFloats(LayoutNode* node) {
     if (!node) return;
     
-    // Handle floating children
+    // Floats placed by an earlier layout of node are placed again
+    LayoutNode* root = node->getFormattingContextRoot();
+    if (root != node) {
+        root->removeFloatsOf(node);
+    }
+    
+    // Place floating children in source order
     for (auto* child : node->children()) {
         if (child && child->isFloating()) {
             addFloat(node, child);
@@ -174,34 +221,39 @@ void BlockLayout::collapseMarginsWithChildren(LayoutNode* node) {
 }
 
 void BlockLayout::addFloat(LayoutNode* node, LayoutNode* floatNode) {
-    if (!node || !floatNode) return;
-    
-    // Add float to node's float list
-    node->addFloat(floatNode);
-    
-    // Position the float
-    // This would be implemented by the float positioning algorithm
+    if (!node || !floatNode || !floatNode->box()) return;
+    
+    // Floats live in the exclusion space of the formatting context root,
+    // in the root's coordinates
+    LayoutNode* root = node->getFormattingContextRoot();
+    Point origin = node->offsetFrom(root);
+    const EdgeInsets& margin = floatNode->box()->margin();
+    Size marginSize(floatNode->getBounds().width + margin.horizontal(),
+                    floatNode->getBounds().height + margin.vertical());
+    double top = origin.y + floatNode->getBounds().y - margin.top;
+    
+    Point position = root->exclusionSpace().floatPosition(marginSize, floatNode->box()->cssFloat(), top);
+    floatNode->updatePosition(Point(position.x - origin.x + margin.left, position.y - origin.y + margin.top));
+    root->addFloat(floatNode);
 }
 
 void BlockLayout::removeFloat(LayoutNode* node, LayoutNode* floatNode) {
     if (!node || !floatNode) return;
     
-    // Remove float from node's float list
-    node->removeFloat(floatNode);
+    // Remove float from its formatting context root
+    node->getFormattingContextRoot()->removeFloat(floatNode);
 }
 
 void BlockLayout::clearFloatsLeft(LayoutNode* node) {
     if (!node) return;
     
-    // Clear left floats
-    // This would be implemented by the float clearing algorithm
+    clearPast(node, Clear::Left);
 }
 
 void BlockLayout::clearFloatsRight(LayoutNode* node) {
     if (!node) return;
     
-    // Clear right floats
-    // This would be implemented by the float clearing algorithm
+    clearPast(node, Clear::Right);
 }
 
 void BlockLayout::clearFloatsBoth(LayoutNode* node) {
@@ -212,4 +264,19 @@ void BlockLayout::clearFloatsBoth(LayoutNode* node) {
     clearFloatsRight(node);
 }
 
+void BlockLayout::clearPast(LayoutNode* node, Clear clear) {
+    // The exclusion space knows each side's lowest float bottom, so this
+    // does not look at the floats themselves
+    LayoutNode* root = node->parent() ? node->parent()->getFormattingContextRoot() : nullptr;
+    if (!root) return;
+    
+    double clearance = root->exclusionSpace().clearance(clear);
+    double marginTop = node->box() ? node->box()->margin().top : 0;
+    double top = node->offsetFrom(root).y - marginTop;
+    if (clearance > top) {
+        Rect bounds = node->getBounds();
+        node->updatePosition(Point(bounds.x, bounds.y + clearance - top));
+    }
+}
+
 } // namespace layout
@@ -1,44 +1,202 @@
 #include "layout/box_model.h"
 #include <algorithm>
 #include <limits>
+#include <mutex>
+#include <unordered_map>
 
 namespace layout {
 
+namespace {
+
+// Interned styles, by hash; entries whose style every box released are
+// swept when the table has doubled since the last sweep
+struct StyleTable {
+    std::mutex mutex;
+    std::unordered_multimap<size_t, std::weak_ptr<const BoxStyle>> styles;
+    size_t sweepAt = 64;
+};
+
+StyleTable& styleTable() {
+    static StyleTable table;
+    return table;
+}
+
+void sweepExpired(StyleTable& table) {
+    for (auto it = table.styles.begin(); it != table.styles.end();) {
+        it = it->second.expired() ? table.styles.erase(it) : std::next(it);
+    }
+    table.sweepAt = std::max<size_t>(64, table.styles.size() * 2);
+}
+
+void mix(size_t& hash, size_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+}
+
+} // namespace
+
+// BoxStyle implementation
+BoxStyle::BoxStyle()
+    : padding_{0, 0, 0, 0}
+    , border_{0, 0, 0, 0}
+    , margin_{0, 0, 0, 0}
+    , insets_{0, 0, 0, 0}
+    , opacity_(1.0f)
+    , zIndex_(0)
+    , display_(static_cast<uint32_t>(Display::Block))
+    , position_(static_cast<uint32_t>(Position::Static))
+    , float_(static_cast<uint32_t>(Float::None))
+    , clear_(static_cast<uint32_t>(Clear::None))
+    , visibility_(static_cast<uint32_t>(Visibility::Visible))
+    , overflow_(static_cast<uint32_t>(Overflow::Visible))
+    , boxSizing_(static_cast<uint32_t>(BoxSizing::ContentBox))
+    , insetSides_(0)
+    , isReplaced_(false)
+    , isAnonymous_(false)
+    , isRoot_(false)
+    , transform_(Transform::identity())
+    , clipRect_(0, 0, 0, 0)
+    , gridPlacement_()
+    , flexStyle_()
+    , flexItemStyle_()
+    , gridTemplate_() {
+}
+
+void BoxStyle::pack(const EdgeInsets& insets, float (&sides)[4]) {
+    sides[0] = static_cast<float>(insets.top);
+    sides[1] = static_cast<float>(insets.right);
+    sides[2] = static_cast<float>(insets.bottom);
+    sides[3] = static_cast<float>(insets.left);
+}
+
+InsetOffsets BoxStyle::insets() const {
+    InsetOffsets insets;
+    insets.values = unpack(insets_);
+    insets.hasTop = insetSides_ & 1;
+    insets.hasRight = insetSides_ & 2;
+    insets.hasBottom = insetSides_ & 4;
+    insets.hasLeft = insetSides_ & 8;
+    return insets;
+}
+
+void BoxStyle::setInsets(const InsetOffsets& insets) {
+    pack(insets.values, insets_);
+    insetSides_ = (insets.hasTop ? 1 : 0) | (insets.hasRight ? 2 : 0) | (insets.hasBottom ? 4 : 0) |
+                  (insets.hasLeft ? 8 : 0);
+}
+
+bool BoxStyle::operator==(const BoxStyle& other) const {
+    return std::equal(padding_, padding_ + 4, other.padding_) && std::equal(border_, border_ + 4, other.border_) &&
+           std::equal(margin_, margin_ + 4, other.margin_) && std::equal(insets_, insets_ + 4, other.insets_) &&
+           opacity_ == other.opacity_ && zIndex_ == other.zIndex_ && display_ == other.display_ &&
+           position_ == other.position_ && float_ == other.float_ && clear_ == other.clear_ &&
+           visibility_ == other.visibility_ && overflow_ == other.overflow_ && boxSizing_ == other.boxSizing_ &&
+           insetSides_ == other.insetSides_ && isReplaced_ == other.isReplaced_ &&
+           isAnonymous_ == other.isAnonymous_ && isRoot_ == other.isRoot_ && transform_ == other.transform_ &&
+           clipRect_ == other.clipRect_ && gridPlacement_ == other.gridPlacement_ &&
+           flexStyle_ == other.flexStyle_ && flexItemStyle_ == other.flexItemStyle_ &&
+           gridTemplate_ == other.gridTemplate_;
+}
+
+size_t BoxStyle::hash() const {
+    // The transform, clip, flex and grid placement values are left out;
+    // lengths and keywords tell most styles apart
+    std::hash<float> hashFloat;
+    size_t hash = 0;
+    for (const float* sides : {padding_, border_, margin_, insets_}) {
+        for (size_t i = 0; i < 4; ++i) {
+            mix(hash, hashFloat(sides[i]));
+        }
+    }
+    mix(hash, hashFloat(opacity_));
+    mix(hash, static_cast<size_t>(zIndex_));
+    uint32_t keywords = display_ | position_ << 5 | float_ << 8 | clear_ << 10 | visibility_ << 12 |
+                        overflow_ << 14 | boxSizing_ << 16 | insetSides_ << 17 | isReplaced_ << 21 |
+                        isAnonymous_ << 22 | isRoot_ << 23;
+    mix(hash, keywords);
+    mix(hash, std::hash<const GridTemplate*>()(gridTemplate_.get()));
+    return hash;
+}
+
+std::shared_ptr<const BoxStyle> BoxStyle::intern(const BoxStyle& style) {
+    if (style == *initial()) return initial();
+
+    size_t hash = style.hash();
+    StyleTable& table = styleTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto range = table.styles.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (std::shared_ptr<const BoxStyle> shared = it->second.lock()) {
+            if (*shared == style) return shared;
+        }
+    }
+
+    if (table.styles.size() >= table.sweepAt) {
+        sweepExpired(table);
+    }
+    auto shared = std::make_shared<const BoxStyle>(style);
+    table.styles.emplace(hash, shared);
+    return shared;
+}
+
+const std::shared_ptr<const BoxStyle>& BoxStyle::initial() {
+    static const std::shared_ptr<const BoxStyle> initial = std::make_shared<const BoxStyle>();
+    return initial;
+}
+
+size_t BoxStyle::internedCount() {
+    StyleTable& table = styleTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    size_t count = 1;
+    for (const auto& entry : table.styles) {
+        if (!entry.second.expired()) ++count;
+    }
+    return count;
+}
+
 // BoxModel implementation
 BoxModel::BoxModel() 
     : contentRect_(0, 0, 0, 0)
-    , padding_(0)
-    , border_(0)
-    , margin_(0)
-    , boxSizing_(BoxSizing::ContentBox) {
+    , style_(BoxStyle::initial()) {
 }
 
 BoxModel::~BoxModel() = default;
 
+void BoxModel::setStyle(const BoxStyle& style) {
+    if (style != *style_) {
+        style_ = BoxStyle::intern(style);
+    }
+}
+
 Rect BoxModel::paddingRect() const {
+    EdgeInsets padding = style_->padding();
     return Rect(
-        contentRect_.x - padding_.left,
-        contentRect_.y - padding_.top,
-        contentRect_.width + padding_.horizontal(),
-        contentRect_.height + padding_.vertical()
+        contentRect_.x - padding.left,
+        contentRect_.y - padding.top,
+        contentRect_.width + padding.horizontal(),
+        contentRect_.height + padding.vertical()
     );
 }
 
 Rect BoxModel::borderRect() const {
+    EdgeInsets padding = style_->padding();
+    EdgeInsets border = style_->border();
     return Rect(
-        contentRect_.x - padding_.left - border_.left,
-        contentRect_.y - padding_.top - border_.top,
-        contentRect_.width + padding_.horizontal() + border_.horizontal(),
-        contentRect_.height + padding_.vertical() + border_.vertical()
+        contentRect_.x - padding.left - border.left,
+        contentRect_.y - padding.top - border.top,
+        contentRect_.width + padding.horizontal() + border.horizontal(),
+        contentRect_.height + padding.vertical() + border.vertical()
     );
 }
 
 Rect BoxModel::marginRect() const {
+    EdgeInsets padding = style_->padding();
+    EdgeInsets border = style_->border();
+    EdgeInsets margin = style_->margin();
     return Rect(
-        contentRect_.x - padding_.left - border_.left - margin_.left,
-        contentRect_.y - padding_.top - border_.top - margin_.top,
-        contentRect_.width + padding_.horizontal() + border_.horizontal() + margin_.horizontal(),
-        contentRect_.height + padding_.vertical() + border_.vertical() + margin_.vertical()
+        contentRect_.x - padding.left - border.left - margin.left,
+        contentRect_.y - padding.top - border.top - margin.top,
+        contentRect_.width + padding.horizontal() + border.horizontal() + margin.horizontal(),
+        contentRect_.height + padding.vertical() + border.vertical() + margin.vertical()
     );
 }
 
@@ -47,10 +205,12 @@ Rect BoxModel::totalRect() const {
 }
 
 Size BoxModel::calculateContentSize(const Size& totalSize) const {
-    if (boxSizing_ == BoxSizing::BorderBox) {
+    if (style_->boxSizing() == BoxSizing::BorderBox) {
+        EdgeInsets padding = style_->padding();
+        EdgeInsets border = style_->border();
         return Size(
-            totalSize.width - padding_.horizontal() - border_.horizontal(),
-            totalSize.height - padding_.vertical() - border_.vertical()
+            totalSize.width - padding.horizontal() - border.horizontal(),
+            totalSize.height - padding.vertical() - border.vertical()
         );
     } else {
         return totalSize;
@@ -58,22 +218,28 @@ Size BoxModel::calculateContentSize(const Size& totalSize) const {
 }
 
 Size BoxModel::calculateTotalSize(const Size& contentSize) const {
-    if (boxSizing_ == BoxSizing::BorderBox) {
+    EdgeInsets padding = style_->padding();
+    EdgeInsets border = style_->border();
+    if (style_->boxSizing() == BoxSizing::BorderBox) {
         return Size(
-            contentSize.width + padding_.horizontal() + border_.horizontal(),
-            contentSize.height + padding_.vertical() + border_.vertical()
+            contentSize.width + padding.horizontal() + border.horizontal(),
+            contentSize.height + padding.vertical() + border.vertical()
         );
     } else {
+        EdgeInsets margin = style_->margin();
         return Size(
-            contentSize.width + padding_.horizontal() + border_.horizontal() + margin_.horizontal(),
-            contentSize.height + padding_.vertical() + border_.vertical() + margin_.vertical()
+            contentSize.width + padding.horizontal() + border.horizontal() + margin.horizontal(),
+            contentSize.height + padding.vertical() + border.vertical() + margin.vertical()
         );
     }
 }
 
 bool BoxModel::isEmpty() const {
-    return contentRect_.isEmpty() && padding_.horizontal() == 0 && padding_.vertical() == 0 &&
-           border_.horizontal() == 0 && border_.vertical() == 0 && margin_.horizontal() == 0 && margin_.vertical() == 0;
+    EdgeInsets padding = style_->padding();
+    EdgeInsets border = style_->border();
+    EdgeInsets margin = style_->margin();
+    return contentRect_.isEmpty() && padding.horizontal() == 0 && padding.vertical() == 0 &&
+           border.horizontal() == 0 && border.vertical() == 0 && margin.horizontal() == 0 && margin.vertical() == 0;
 }
 
 Rect BoxModel::visualBounds() const {
@@ -106,106 +272,87 @@ void BoxModel::transform(const Transform& transform) {
 
 void BoxModel::reset() {
     contentRect_ = Rect(0, 0, 0, 0);
-    padding_ = EdgeInsets(0);
-    border_ = EdgeInsets(0);
-    margin_ = EdgeInsets(0);
-    boxSizing_ = BoxSizing::ContentBox;
+    style_ = BoxStyle::initial();
 }
 
 BoxModel::BoxModel(const BoxModel& other)
     : contentRect_(other.contentRect_)
-    , padding_(other.padding_)
-    , border_(other.border_)
-    , margin_(other.margin_)
-    , boxSizing_(other.boxSizing_) {
+    , style_(other.style_) {
 }
 
 BoxModel& BoxModel::operator=(const BoxModel& other) {
     if (this != &other) {
         contentRect_ = other.contentRect_;
-        padding_ = other.padding_;
-        border_ = other.border_;
-        margin_ = other.margin_;
-        boxSizing_ = other.boxSizing_;
+        style_ = other.style_;
     }
     return *this;
 }
 
+// A moved-from box keeps its style, so it stays usable
 BoxModel::BoxModel(BoxModel&& other) noexcept
     : contentRect_(std::move(other.contentRect_))
-    , padding_(std::move(other.padding_))
-    , border_(std::move(other.border_))
-    , margin_(std::move(other.margin_))
-    , boxSizing_(other.boxSizing_) {
+    , style_(other.style_) {
 }
 
 BoxModel& BoxModel::operator=(BoxModel&& other) noexcept {
     if (this != &other) {
         contentRect_ = std::move(other.contentRect_);
-        padding_ = std::move(other.padding_);
-        border_ = std::move(other.border_);
-        margin_ = std::move(other.margin_);
-        boxSizing_ = other.boxSizing_;
+        style_ = other.style_;
     }
     return *this;
 }
 
 // LayoutBox implementation
-LayoutBox::LayoutBox()
-    : display_(Display::Block)
-    , position_(Position::Static)
-    , float_(Float::None)
-    , clear_(Clear::None)
-    , zIndex_(0)
-    , transform_(Transform::identity())
-    , opacity_(1.0)
-    , visibility_(Visibility::Visible)
-    , overflow_(Overflow::Visible)
-    , clipRect_(0, 0, 0, 0)
-    , isReplaced_(false)
-    , isAnonymous_(false)
-    , isRoot_(false) {
-}
+LayoutBox::LayoutBox() = default;
 
 LayoutBox::~LayoutBox() = default;
 
+const GridTemplate& LayoutBox::gridTemplate() const {
+    static const GridTemplate none;
+    const std::shared_ptr<const GridTemplate>& gridTemplate = style().gridTemplate();
+    return gridTemplate ? *gridTemplate : none;
+}
+
 bool LayoutBox::isPositioned() const {
-    return position_ == Position::Absolute || position_ == Position::Fixed || 
-           position_ == Position::Relative || position_ == Position::Sticky;
+    Position position = style().position();
+    return position == Position::Absolute || position == Position::Fixed || 
+           position == Position::Relative || position == Position::Sticky;
 }
 
 bool LayoutBox::isFloating() const {
-    return float_ != Float::None;
+    return style().cssFloat() != Float::None;
 }
 
 bool LayoutBox::isBlockLevel() const {
-    return display_ == Display::Block || display_ == Display::ListItem || 
-           display_ == Display::Table || display_ == Display::Flex || 
-           display_ == Display::Grid || display_ == Display::InlineBlock ||
-           display_ == Display::InlineFlex || display_ == Display::InlineGrid ||
-           display_ == Display::InlineTable;
+    Display display = style().display();
+    return display == Display::Block || display == Display::ListItem || 
+           display == Display::Table || display == Display::Flex || 
+           display == Display::Grid || display == Display::InlineBlock ||
+           display == Display::InlineFlex || display == Display::InlineGrid ||
+           display == Display::InlineTable;
 }
 
 bool LayoutBox::isInlineLevel() const {
-    return display_ == Display::Inline || display_ == Display::InlineBlock ||
-           display_ == Display::InlineFlex || display_ == Display::InlineGrid ||
-           display_ == Display::InlineTable;
+    Display display = style().display();
+    return display == Display::Inline || display == Display::InlineBlock ||
+           display == Display::InlineFlex || display == Display::InlineGrid ||
+           display == Display::InlineTable;
 }
 
 bool LayoutBox::isTableCell() const {
-    return display_ == Display::TableCell;
+    return style().display() == Display::TableCell;
 }
 
 bool LayoutBox::isTableRow() const {
-    return display_ == Display::TableRow;
+    return style().display() == Display::TableRow;
 }
 
 bool LayoutBox::isTable() const {
-    return display_ == Display::Table || display_ == Display::InlineTable;
+    return style().display() == Display::Table || style().display() == Display::InlineTable;
 }
 
 bool LayoutBox::isFlexContainer() const {
-    return display_ == Display::Flex || display_ == Display::InlineFlex;
+    return style().display() == Display::Flex || style().display() == Display::InlineFlex;
 }
 
 bool LayoutBox::isFlexItem() const {
@@ -215,7 +362,7 @@ bool LayoutBox::isFlexItem() const {
 }
 
 bool LayoutBox::isGridContainer() const {
-    return display_ == Display::Grid || display_ == Display::InlineGrid;
+    return style().display() == Display::Grid || style().display() == Display::InlineGrid;
 }
 
 bool LayoutBox::isGridItem() const {
@@ -226,108 +373,29 @@ bool LayoutBox::isGridItem() const {
 
 bool LayoutBox::isStackingContext() const {
     return isPositioned() || isFlexContainer() || isGridContainer() || 
-           opacity_ < 1.0 || transform_ != Transform::identity() ||
-           zIndex_ != 0 || isRoot_;
+           style().opacity() < 1.0 || style().transform() != Transform::identity() ||
+           style().zIndex() != 0 || style().isRoot();
 }
 
 bool LayoutBox::isContainingBlock() const {
-    return isPositioned() || isRoot_;
+    return isPositioned() || style().isRoot();
 }
 
 bool LayoutBox::isFormattingContextRoot() const {
-    return isRoot_ || isFlexContainer() || isGridContainer() || isTable();
+    return style().isRoot() || isFloating() || isFlexContainer() || isGridContainer() || isTable();
 }
 
 void LayoutBox::reset() {
     BoxModel::reset();
-    display_ = Display::Block;
-    position_ = Position::Static;
-    float_ = Float::None;
-    clear_ = Clear::None;
-    zIndex_ = 0;
-    transform_ = Transform::identity();
-    opacity_ = 1.0;
-    visibility_ = Visibility::Visible;
-    overflow_ = Overflow::Visible;
-    clipRect_ = Rect(0, 0, 0, 0);
-    isReplaced_ = false;
-    isAnonymous_ = false;
-    isRoot_ = false;
-}
-
-LayoutBox::LayoutBox(const LayoutBox& other)
-    : BoxModel(other)
-    , display_(other.display_)
-    , position_(other.position_)
-    , float_(other.float_)
-    , clear_(other.clear_)
-    , zIndex_(other.zIndex_)
-    , transform_(other.transform_)
-    , opacity_(other.opacity_)
-    , visibility_(other.visibility_)
-    , overflow_(other.overflow_)
-    , clipRect_(other.clipRect_)
-    , isReplaced_(other.isReplaced_)
-    , isAnonymous_(other.isAnonymous_)
-    , isRoot_(other.isRoot_) {
-}
-
-LayoutBox& LayoutBox::operator=(const LayoutBox& other) {
-    if (this != &other) {
-        BoxModel::operator=(other);
-        display_ = other.display_;
-        position_ = other.position_;
-        float_ = other.float_;
-        clear_ = other.clear_;
-        zIndex_ = other.zIndex_;
-        transform_ = other.transform_;
-        opacity_ = other.opacity_;
-        visibility_ = other.visibility_;
-        overflow_ = other.overflow_;
-        clipRect_ = other.clipRect_;
-        isReplaced_ = other.isReplaced_;
-        isAnonymous_ = other.isAnonymous_;
-        isRoot_ = other.isRoot_;
-    }
-    return *this;
 }
 
-LayoutBox::LayoutBox(LayoutBox&& other) noexcept
-    : BoxModel(std::move(other))
-    , display_(other.display_)
-    , position_(other.position_)
-    , float_(other.float_)
-    , clear_(other.clear_)
-    , zIndex_(other.zIndex_)
-    , transform_(std::move(other.transform_))
-    , opacity_(other.opacity_)
-    , visibility_(other.visibility_)
-    , overflow_(other.overflow_)
-    , clipRect_(std::move(other.clipRect_))
-    , isReplaced_(other.isReplaced_)
-    , isAnonymous_(other.isAnonymous_)
-    , isRoot_(other.isRoot_) {
-}
-
-LayoutBox& LayoutBox::operator=(LayoutBox&& other) noexcept {
-    if (this != &other) {
-        BoxModel::operator=(std::move(other));
-        display_ = other.display_;
-        position_ = other.position_;
-        float_ = other.float_;
-        clear_ = other.clear_;
-        zIndex_ = other.zIndex_;
-        transform_ = std::move(other.transform_);
-        opacity_ = other.opacity_;
-        visibility_ = other.visibility_;
-        overflow_ = other.overflow_;
-        clipRect_ = std::move(other.clipRect_);
-        isReplaced_ = other.isReplaced_;
-        isAnonymous_ = other.isAnonymous_;
-        isRoot_ = other.isRoot_;
-    }
-    return *this;
-}
+LayoutBox::LayoutBox(const LayoutBox& other) = default;
+
+LayoutBox& LayoutBox::operator=(const LayoutBox& other) = default;
+
+LayoutBox::LayoutBox(LayoutBox&& other) noexcept = default;
+
+LayoutBox& LayoutBox::operator=(LayoutBox&& other) noexcept = default;
 
 // BoxNode implementation
 BoxNode::BoxNode() : box_(nullptr), parent_(nullptr) {
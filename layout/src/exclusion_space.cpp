@@ -0,0 +1,109 @@
+#include "layout/exclusion_space.h"
+#include <algorithm>
+
+namespace layout {
+
+// ExclusionSpace implementation
+ExclusionSpace::ExclusionSpace(double inlineSize)
+    : inlineSize_(inlineSize)
+    , bands_()
+    , exclusionCount_(0)
+    , leftBottom_(kNoClearance)
+    , rightBottom_(kNoClearance)
+    , lastFloatTop_(kNoClearance) {
+}
+
+void ExclusionSpace::reset(double inlineSize) {
+    inlineSize_ = inlineSize;
+    clear();
+}
+
+void ExclusionSpace::clear() {
+    bands_.clear();
+    exclusionCount_ = 0;
+    leftBottom_ = kNoClearance;
+    rightBottom_ = kNoClearance;
+    lastFloatTop_ = kNoClearance;
+}
+
+void ExclusionSpace::addExclusion(const Rect& rect, Float side) {
+    if (side == Float::None) return;
+
+    ++exclusionCount_;
+    lastFloatTop_ = std::max(lastFloatTop_, rect.top());
+    if (side == Float::Left) {
+        leftBottom_ = std::max(leftBottom_, rect.bottom());
+    } else {
+        rightBottom_ = std::max(rightBottom_, rect.bottom());
+    }
+    // An empty float is cleared but takes no line space
+    if (rect.height <= 0) return;
+
+    if (bands_.empty()) {
+        bands_.push_back(Band{kNoClearance, 0, inlineSize_});
+    }
+    size_t first = split(rect.top());
+    size_t end = split(rect.bottom());
+    for (size_t i = first; i < end; ++i) {
+        if (side == Float::Left) {
+            bands_[i].left = std::max(bands_[i].left, rect.right());
+        } else {
+            bands_[i].right = std::min(bands_[i].right, rect.left());
+        }
+    }
+}
+
+LayoutOpportunity ExclusionSpace::availableSpace(double top, double height) const {
+    if (bands_.empty()) return LayoutOpportunity{0, inlineSize_};
+
+    size_t i = bandAt(top);
+    LayoutOpportunity opportunity{bands_[i].left, bands_[i].right};
+    double bottom = top + height;
+    for (++i; i < bands_.size() && bands_[i].top < bottom; ++i) {
+        opportunity.left = std::max(opportunity.left, bands_[i].left);
+        opportunity.right = std::min(opportunity.right, bands_[i].right);
+    }
+    return opportunity;
+}
+
+Point ExclusionSpace::floatPosition(const Size& size, Float side, double top) const {
+    double y = std::max(top, lastFloatTop_);
+    LayoutOpportunity opportunity = availableSpace(y, size.height);
+
+    // The band after the last float's bottom is always unobstructed
+    while (opportunity.width() < size.width && (opportunity.left > 0 || opportunity.right < inlineSize_)) {
+        size_t next = bandAt(y) + 1;
+        if (next >= bands_.size()) break;
+        y = bands_[next].top;
+        opportunity = availableSpace(y, size.height);
+    }
+
+    return Point(side == Float::Right ? opportunity.right - size.width : opportunity.left, y);
+}
+
+double ExclusionSpace::clearance(Clear clear) const {
+    switch (clear) {
+        case Clear::None: return kNoClearance;
+        case Clear::Left: return leftBottom_;
+        case Clear::Right: return rightBottom_;
+        case Clear::Both: return std::max(leftBottom_, rightBottom_);
+    }
+    return kNoClearance;
+}
+
+size_t ExclusionSpace::bandAt(double y) const {
+    auto it = std::upper_bound(bands_.begin(), bands_.end(), y,
+                               [](double value, const Band& band) { return value < band.top; });
+    return static_cast<size_t>(it - bands_.begin()) - 1;
+}
+
+size_t ExclusionSpace::split(double y) {
+    size_t i = bandAt(y);
+    if (bands_[i].top == y) return i;
+
+    Band band{y, bands_[i].left, bands_[i].right};
+    bands_.insert(bands_.begin() + static_cast<std::ptrdiff_t>(i) + 1, band);
+    return i + 1;
+}
+
+} // namespace layout
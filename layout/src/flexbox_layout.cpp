@@ -1,4 +1,5 @@
 #include "layout/flexbox_layout.h"
+#include "layout/layout_trace.h"
 #include <algorithm>
 #include <cmath>
 
@@ -10,7 +11,8 @@ FlexboxLayout::FlexboxLayout() = default;
 FlexboxLayout::~FlexboxLayout() = default;
 
 void FlexboxLayout::layoutFlexContainer(LayoutNode* node, const LayoutConstraints& constraints) {
-    if (!node || !node->box() || !node->isFlexContainer()) return;
+    LAYOUT_TRACE_SCOPE(LayoutPhase::Flex);
+    if (!node || !node->box() || !node->box()->isFlexContainer()) return;
     
     // Calculate flex container size
     Size containerSize = calculateFlexContainerSize(node, constraints);
@@ -20,30 +22,44 @@ void FlexboxLayout::layoutFlexContainer(LayoutNode* node, const LayoutConstraint
     
     // Layout flex items
     layoutFlexItems(node, constraints);
-    
-    // Handle flex direction
-    handleFlexDirection(node);
-    
-    // Handle flex wrap
-    handleFlexWrap(node);
-    
-    // Handle justify content
-    handleJustifyContent(node);
-    
-    // Handle align items
-    handleAlignItems(node);
-    
-    // Handle align content
-    handleAlignContent(node);
 }
 
 void FlexboxLayout::layoutFlexItems(LayoutNode* node, const LayoutConstraints& constraints) {
-    if (!node) return;
+    if (!node || !node->box()) return;
     
-    for (auto* child : node->children()) {
-        if (child) {
-            layoutFlexItem(child, constraints);
-        }
+    const FlexStyle& style = node->box()->flexStyle();
+    const EdgeInsets& padding = node->box()->padding();
+    const EdgeInsets& border = node->box()->border();
+    Rect bounds = node->getBounds();
+    double contentWidth = std::max(0.0, bounds.width - padding.horizontal() - border.horizontal());
+    double contentHeight = std::max(0.0, bounds.height - padding.vertical() - border.vertical());
+    
+    FlexAxes axes;
+    axes.isRow = style.direction == FlexDirection::Row || style.direction == FlexDirection::RowReverse;
+    axes.mainReverse = style.direction == FlexDirection::RowReverse || style.direction == FlexDirection::ColumnReverse;
+    axes.crossReverse = style.wrap == FlexWrap::WrapReverse;
+    axes.originX = padding.left + border.left;
+    axes.originY = padding.top + border.top;
+    axes.mainSize = axes.isRow ? contentWidth : contentHeight;
+    axes.crossSize = axes.isRow ? contentHeight : contentWidth;
+    axes.mainGap = axes.isRow ? style.columnGap : style.rowGap;
+    axes.crossGap = axes.isRow ? style.rowGap : style.columnGap;
+    
+    // Pass one fills a contiguous array; pass two resolves and positions
+    std::vector<FlexItem> items;
+    items.reserve(node->childCount());
+    bool simple = collectFlexItems(node, axes, items) && style.wrap == FlexWrap::Nowrap;
+    
+    double linesCross = 0;
+    if (!simple || !layoutSingleLine(node, items, axes, linesCross)) {
+        linesCross = layoutFlexLines(node, items, axes);
+    }
+    
+    // The container grows in the cross axis to hold its lines
+    if (linesCross > axes.crossSize) {
+        double grow = linesCross - axes.crossSize;
+        node->setLayoutRect(Rect(bounds.x, bounds.y, bounds.width + (axes.isRow ? 0 : grow),
+                                 bounds.height + (axes.isRow ? grow : 0)));
     }
 }
 
@@ -75,9 +91,13 @@ Size FlexboxLayout::calculateFlexContainerSize(LayoutNode* node, const LayoutCon
     return totalSize;
 }
 
-Size FlexboxLayout::calculateFlexItemSize(LayoutNode* item, const LayoutConstraints& constraints) {
+Size FlexboxLayout::calculateFlexItemSize(LayoutNode* item, const LayoutConstraints& constraints, SizingMode mode) {
     if (!item || !item->box()) return Size(0, 0);
     
+    // The sizing passes ask for the same item repeatedly
+    Size cached;
+    if (item->findMeasurement(constraints, mode, cached)) return cached;
+    
     // Get box model properties
     const EdgeInsets& padding = item->box()->padding();
     const EdgeInsets& border = item->box()->border();
@@ -100,247 +120,340 @@ Size FlexboxLayout::calculateFlexItemSize(LayoutNode* item, const LayoutConstrai
     // Constrain size
     totalSize = constraints.constrain(totalSize);
     
+    item->cacheMeasurement(constraints, mode, totalSize);
     return totalSize;
 }
 
-Point FlexboxLayout::calculateFlexItemPosition(LayoutNode* item) {
-    if (!item || !item->parent()) return Point(0, 0);
-    
-    // Calculate position based on flex layout
-    Point position = Point(0, 0);
-    
-    // Add margins
-    const EdgeInsets& margin = item->box()->margin();
-    position.x += margin.left;
-    position.y += margin.top;
-    
-    return position;
-}
-
-void FlexboxLayout::handleFlexDirection(LayoutNode* node) {
-    if (!node || !node->box()) return;
-    
-    // Handle flex direction based on CSS flex-direction property
-    // This is a simplified implementation
-    // In a real implementation, this would handle all flex direction values
-}
-
-void FlexboxLayout::handleFlexWrap(LayoutNode* node) {
-    if (!node || !node->box()) return;
-    
-    // Handle flex wrap based on CSS flex-wrap property
-    // This is a simplified implementation
-    // In a real implementation, this would handle all flex wrap values
-}
-
-void FlexboxLayout::handleJustifyContent(LayoutNode* node) {
-    if (!node || !node->box()) return;
-    
-    // Handle justify content based on CSS justify-content property
-    // This is a simplified implementation
-    // In a real implementation, this would handle all justify content values
-}
-
-void FlexboxLayout::handleAlignItems(LayoutNode* node) {
-    if (!node || !node->box()) return;
-    
-    // Handle align items based on CSS align-items property
-    // This is a simplified implementation
-    // In a real implementation, this would handle all align items values
-}
-
-void FlexboxLayout::handleAlignContent(LayoutNode* node) {
-    if (!node || !node->box()) return;
-    
-    // Handle align content based on CSS align-content property
-    // This is a simplified implementation
-    // In a real implementation, this would handle all align content values
-}
-
 double FlexboxLayout::calculateFlexBasis(LayoutNode* item) {
     if (!item || !item->box()) return 0;
     
-    // Calculate flex basis based on CSS flex-basis property
-    // This is a simplified implementation
-    return item->calculateIntrinsicSize().width;
+    // An auto basis is the item's current main size
+    double basis = item->box()->flexItemStyle().basis;
+    if (basis >= 0) return basis;
+    
+    const LayoutNode* container = item->parent();
+    FlexDirection direction = container && container->box() ? container->box()->flexStyle().direction : FlexDirection::Row;
+    bool isRow = direction == FlexDirection::Row || direction == FlexDirection::RowReverse;
+    return isRow ? item->getBounds().width : item->getBounds().height;
 }
 
 double FlexboxLayout::calculateFlexGrow(LayoutNode* item) {
     if (!item || !item->box()) return 0;
-    
-    // Calculate flex grow based on CSS flex-grow property
-    // This is a simplified implementation
-    return 0;
+    return std::max(0.0, item->box()->flexItemStyle().grow);
 }
 
 double FlexboxLayout::calculateFlexShrink(LayoutNode* item) {
     if (!item || !item->box()) return 1;
-    
-    // Calculate flex shrink based on CSS flex-shrink property
-    // This is a simplified implementation
-    return 1;
+    return std::max(0.0, item->box()->flexItemStyle().shrink);
 }
 
-void FlexboxLayout::layoutFlexItem(LayoutNode* item, const LayoutConstraints& constraints) {
-    if (!item) return;
+bool FlexboxLayout::collectFlexItems(LayoutNode* node, const FlexAxes& axes, std::vector<FlexItem>& items) {
+    AlignItems alignItems = node->box()->flexStyle().alignItems;
+    bool simple = alignItems != AlignItems::Baseline;
     
-    // Create constraints for flex item
-    LayoutConstraints itemConstraints = constraints;
+    for (auto* child : node->children()) {
+        if (!child || !child->box()) continue;
+        const LayoutBox* box = child->box();
+        if (box->position() == Position::Absolute || box->position() == Position::Fixed) continue;
+        
+        // Hypothetical sizes are unconstrained and come from the
+        // measurement cache
+        Size size = calculateFlexItemSize(child, LayoutConstraints(), SizingMode::MaxContent);
+        const EdgeInsets& margin = box->margin();
+        const FlexItemStyle& itemStyle = box->flexItemStyle();
+        
+        FlexItem item;
+        item.node = child;
+        item.base = itemStyle.basis >= 0 ? itemStyle.basis : (axes.isRow ? size.width : size.height);
+        item.main = item.base;
+        item.cross = axes.isRow ? size.height : size.width;
+        item.grow = std::max(0.0, itemStyle.grow);
+        item.shrink = std::max(0.0, itemStyle.shrink);
+        item.mainMarginBefore = axes.isRow ? margin.left : margin.top;
+        item.mainMargins = axes.isRow ? margin.horizontal() : margin.vertical();
+        item.crossMarginBefore = axes.isRow ? margin.top : margin.left;
+        item.crossMargins = axes.isRow ? margin.vertical() : margin.horizontal();
+        // Items without a baseline of their own align their bottom edge
+        item.baseline = item.crossMarginBefore + (child->baseline() > 0 ? child->baseline() : item.cross);
+        item.frozen = false;
+        
+        switch (itemStyle.alignSelf) {
+            case AlignSelf::Auto: item.align = alignItems; break;
+            case AlignSelf::Stretch: item.align = AlignItems::Stretch; break;
+            case AlignSelf::FlexStart: item.align = AlignItems::FlexStart; break;
+            case AlignSelf::FlexEnd: item.align = AlignItems::FlexEnd; break;
+            case AlignSelf::Center: item.align = AlignItems::Center; break;
+            case AlignSelf::Baseline: item.align = AlignItems::Baseline; break;
+        }
+        // Baselines only line up along a row
+        if (item.align == AlignItems::Baseline && !axes.isRow) {
+            item.align = AlignItems::FlexStart;
+        }
+        simple = simple && item.align != AlignItems::Baseline;
+        items.push_back(item);
+    }
+    return simple;
+}
+
+bool FlexboxLayout::layoutSingleLine(LayoutNode* node, std::vector<FlexItem>& items, const FlexAxes& axes,
+                                     double& lineCross) {
+    double used = axes.mainGap * (items.empty() ? 0 : items.size() - 1);
+    double growFactors = 0;
+    double scaledShrink = 0;
+    double maxCross = 0;
+    for (const auto& item : items) {
+        used += item.outerBase();
+        growFactors += item.grow;
+        scaledShrink += item.shrink * item.base;
+        maxCross = std::max(maxCross, item.outerCross());
+    }
     
-    // Layout the flex item
-    item->layout(itemConstraints);
+    // Without min/max sizes one step resolves every item, unless one
+    // would shrink below zero
+    double freeSpace = axes.mainSize - used;
+    if (freeSpace > 0 && growFactors > 0) {
+        double share = freeSpace / std::max(growFactors, 1.0);
+        for (auto& item : items) {
+            item.main = item.base + share * item.grow;
+        }
+    } else if (freeSpace < 0 && scaledShrink > 0) {
+        for (auto& item : items) {
+            item.main = item.base + freeSpace * item.shrink * item.base / scaledShrink;
+            if (item.main < 0) return false;
+        }
+    }
     
-    // Position the flex item
-    positionFlexItem(item);
-}
-
-void FlexboxLayout::positionFlexItem(LayoutNode* item) {
-    if (!item || !item->parent()) return;
+    // A single line fills the container's cross size
+    lineCross = std::max(maxCross, axes.crossSize);
+    FlexLine line{0, items.size(), lineCross, 0, 0};
+    positionFlexLine(line, items, axes, node->box()->flexStyle().justifyContent);
+    return true;
+}
+
+double FlexboxLayout::layoutFlexLines(LayoutNode* node, std::vector<FlexItem>& items, const FlexAxes& axes) {
+    const FlexStyle& style = node->box()->flexStyle();
+    
+    // Break lines by hypothetical outer main sizes
+    std::vector<FlexLine> lines;
+    size_t first = 0;
+    while (first < items.size() || lines.empty()) {
+        size_t end = first;
+        double used = 0;
+        if (style.wrap == FlexWrap::Nowrap) {
+            end = items.size();
+        } else {
+            while (end < items.size()) {
+                double next = used + (end > first ? axes.mainGap : 0) + items[end].outerBase();
+                if (end > first && next > axes.mainSize) break;
+                used = next;
+                ++end;
+            }
+        }
+        lines.push_back(FlexLine{first, end, 0, 0, 0});
+        first = end;
+        if (first >= items.size()) break;
+    }
     
-    // Calculate position
-    Point position = calculateFlexItemPosition(item);
+    // Resolve each line, then size it from its items; baseline-aligned
+    // items share one baseline per line
+    double linesCross = axes.crossGap * (lines.size() - 1);
+    for (auto& line : lines) {
+        resolveFlexibleLengths(items, line, axes);
+        
+        double aboveBaseline = 0;
+        double belowBaseline = 0;
+        for (size_t i = line.first; i < line.end; ++i) {
+            const FlexItem& item = items[i];
+            if (item.align == AlignItems::Baseline) {
+                aboveBaseline = std::max(aboveBaseline, item.baseline);
+                belowBaseline = std::max(belowBaseline, item.outerCross() - item.baseline);
+            } else {
+                line.cross = std::max(line.cross, item.outerCross());
+            }
+        }
+        line.baseline = aboveBaseline;
+        line.cross = std::max(line.cross, aboveBaseline + belowBaseline);
+        linesCross += line.cross;
+    }
     
-    // Update item position
-    item->updatePosition(position);
-}
-
-void FlexboxLayout::distributeFlexSpace(LayoutNode* node) {
-    if (!node) return;
+    // A single line fills the container; several share out what is left
+    if (style.wrap == FlexWrap::Nowrap) {
+        lines[0].cross = std::max(lines[0].cross, axes.crossSize);
+        linesCross = lines[0].cross;
+    }
+    double leftover = std::max(0.0, axes.crossSize - linesCross);
+    double offset = 0;
+    double between = axes.crossGap;
+    if (style.wrap != FlexWrap::Nowrap && leftover > 0) {
+        size_t count = lines.size();
+        switch (style.alignContent) {
+            case AlignContent::Stretch:
+                for (auto& line : lines) line.cross += leftover / count;
+                break;
+            case AlignContent::FlexStart:
+                break;
+            case AlignContent::FlexEnd:
+                offset = leftover;
+                break;
+            case AlignContent::Center:
+                offset = leftover / 2;
+                break;
+            case AlignContent::SpaceBetween:
+                if (count > 1) between += leftover / (count - 1);
+                break;
+            case AlignContent::SpaceAround:
+                offset = leftover / count / 2;
+                between += leftover / count;
+                break;
+        }
+    }
     
-    // Distribute flex space among flex items
-    // This is a simplified implementation
-    // In a real implementation, this would follow the flexbox algorithm
+    for (auto& line : lines) {
+        line.offset = offset;
+        offset += line.cross + between;
+        positionFlexLine(line, items, axes, style.justifyContent);
+    }
+    return std::max(linesCross, axes.crossSize);
 }
 
-void FlexboxLayout::alignFlexItems(LayoutNode* node) {
-    if (!node) return;
+void FlexboxLayout::resolveFlexibleLengths(std::vector<FlexItem>& items, const FlexLine& line, const FlexAxes& axes) {
+    double gaps = axes.mainGap * (line.end > line.first ? line.end - line.first - 1 : 0);
+    double used = gaps;
+    for (size_t i = line.first; i < line.end; ++i) {
+        used += items[i].outerBase();
+    }
+    bool growing = used < axes.mainSize;
+    
+    // Items that cannot flex keep their base size
+    double initialFree = axes.mainSize - used;
+    for (size_t i = line.first; i < line.end; ++i) {
+        FlexItem& item = items[i];
+        item.main = item.base;
+        item.frozen = growing ? item.grow == 0 : item.shrink == 0 || item.base == 0;
+    }
     
-    // Align flex items based on align-items property
-    // This is a simplified implementation
-    // In a real implementation, this would follow the flexbox algorithm
+    // Only the zero minimum can be violated, so each round freezes the
+    // items that hit it and shares the rest again
+    for (;;) {
+        double remaining = axes.mainSize - gaps;
+        double factors = 0;
+        bool anyUnfrozen = false;
+        for (size_t i = line.first; i < line.end; ++i) {
+            const FlexItem& item = items[i];
+            if (item.frozen) {
+                remaining -= item.outerMain();
+            } else {
+                remaining -= item.outerBase();
+                factors += growing ? item.grow : item.shrink * item.base;
+                anyUnfrozen = true;
+            }
+        }
+        if (!anyUnfrozen || factors <= 0) break;
+        
+        // Factors summing below one leave part of the free space unused
+        if (growing) {
+            double grow = 0;
+            for (size_t i = line.first; i < line.end; ++i) {
+                if (!items[i].frozen) grow += items[i].grow;
+            }
+            if (grow < 1) {
+                remaining = std::min(remaining, initialFree * grow);
+            }
+        }
+        
+        bool violated = false;
+        for (size_t i = line.first; i < line.end; ++i) {
+            FlexItem& item = items[i];
+            if (item.frozen) continue;
+            
+            double share = growing ? item.grow / std::max(factors, 1.0) : item.shrink * item.base / factors;
+            item.main = item.base + remaining * share;
+            if (item.main < 0) {
+                item.main = 0;
+                item.frozen = true;
+                violated = true;
+            }
+        }
+        if (!violated) break;
+    }
 }
 
-void FlexboxLayout::wrapFlexItems(LayoutNode* node) {
-    if (!node) return;
+void FlexboxLayout::positionFlexLine(const FlexLine& line, std::vector<FlexItem>& items, const FlexAxes& axes,
+                                     JustifyContent justify) {
+    size_t count = line.end - line.first;
+    double used = axes.mainGap * (count > 0 ? count - 1 : 0);
+    for (size_t i = line.first; i < line.end; ++i) {
+        used += items[i].outerMain();
+    }
     
-    // Wrap flex items based on flex-wrap property
-    // This is a simplified implementation
-    // In a real implementation, this would follow the flexbox algorithm
-}
-
-void FlexboxLayout::calculateFlexItemSizes(LayoutNode* node) {
-    if (!node) return;
+    // Space distributions that do not fit fall back to start or center
+    double leftover = axes.mainSize - used;
+    double offset = 0;
+    double between = axes.mainGap;
+    switch (justify) {
+        case JustifyContent::FlexStart:
+            break;
+        case JustifyContent::FlexEnd:
+            offset = leftover;
+            break;
+        case JustifyContent::Center:
+            offset = leftover / 2;
+            break;
+        case JustifyContent::SpaceBetween:
+            if (leftover > 0 && count > 1) between += leftover / (count - 1);
+            break;
+        case JustifyContent::SpaceAround:
+            if (leftover > 0) {
+                offset = leftover / count / 2;
+                between += leftover / count;
+            } else {
+                offset = leftover / 2;
+            }
+            break;
+        case JustifyContent::SpaceEvenly:
+            if (leftover > 0) {
+                offset = leftover / (count + 1);
+                between += leftover / (count + 1);
+            } else {
+                offset = leftover / 2;
+            }
+            break;
+    }
     
-    // Calculate sizes for all flex items
-    // This is a simplified implementation
-    // In a real implementation, this would follow the flexbox algorithm
+    for (size_t i = line.first; i < line.end; ++i) {
+        FlexItem& item = items[i];
+        double cross = 0;
+        switch (item.align) {
+            case AlignItems::Stretch:
+                item.cross = std::max(0.0, line.cross - item.crossMargins);
+                break;
+            case AlignItems::FlexStart:
+                break;
+            case AlignItems::FlexEnd:
+                cross = line.cross - item.outerCross();
+                break;
+            case AlignItems::Center:
+                cross = (line.cross - item.outerCross()) / 2;
+                break;
+            case AlignItems::Baseline:
+                cross = line.baseline - item.baseline;
+                break;
+        }
+        placeFlexItem(item, axes, offset + item.mainMarginBefore, line.offset + cross + item.crossMarginBefore);
+        offset += item.outerMain() + between;
+    }
 }
 
-void FlexboxLayout::calculateFlexItemPositions(LayoutNode* node) {
-    if (!node) return;
+void FlexboxLayout::placeFlexItem(FlexItem& item, const FlexAxes& axes, double main, double cross) {
+    // Each item is laid out once, at its final size
+    Size size = axes.isRow ? Size(item.main, item.cross) : Size(item.cross, item.main);
+    item.node->layout(LayoutConstraints(size, size));
     
-    // Calculate positions for all flex items
-    // This is a simplified implementation
-    // In a real implementation, this would follow the flexbox algorithm
-}
-
-// Additional flexbox methods would be implemented here
-// These are placeholder implementations for the various flexbox properties
-
-void FlexboxLayout::handleFlexWrapNowrap(LayoutNode* node) {
-    // Handle flex-wrap: nowrap
-}
-
-void FlexboxLayout::handleFlexWrapWrap(LayoutNode* node) {
-    // Handle flex-wrap: wrap
-}
-
-void FlexboxLayout::handleFlexWrapWrapReverse(LayoutNode* node) {
-    // Handle flex-wrap: wrap-reverse
-}
-
-void FlexboxLayout::handleFlexDirectionRow(LayoutNode* node) {
-    // Handle flex-direction: row
-}
-
-void FlexboxLayout::handleFlexDirectionRowReverse(LayoutNode* node) {
-    // Handle flex-direction: row-reverse
-}
-
-void FlexboxLayout::handleFlexDirectionColumn(LayoutNode* node) {
-    // Handle flex-direction: column
-}
-
-void FlexboxLayout::handleFlexDirectionColumnReverse(LayoutNode* node) {
-    // Handle flex-direction: column-reverse
-}
-
-void FlexboxLayout::handleJustifyContentFlexStart(LayoutNode* node) {
-    // Handle justify-content: flex-start
-}
-
-void FlexboxLayout::handleJustifyContentFlexEnd(LayoutNode* node) {
-    // Handle justify-content: flex-end
-}
-
-void FlexboxLayout::handleJustifyContentCenter(LayoutNode* node) {
-    // Handle justify-content: center
-}
-
-void FlexboxLayout::handleJustifyContentSpaceBetween(LayoutNode* node) {
-    // Handle justify-content: space-between
-}
-
-void FlexboxLayout::handleJustifyContentSpaceAround(LayoutNode* node) {
-    // Handle justify-content: space-around
-}
-
-void FlexboxLayout::handleJustifyContentSpaceEvenly(LayoutNode* node) {
-    // Handle justify-content: space-evenly
-}
-
-void FlexboxLayout::handleAlignItemsStretch(LayoutNode* node) {
-    // Handle align-items: stretch
-}
-
-void FlexboxLayout::handleAlignItemsFlexStart(LayoutNode* node) {
-    // Handle align-items: flex-start
-}
-
-void FlexboxLayout::handleAlignItemsFlexEnd(LayoutNode* node) {
-    // Handle align-items: flex-end
-}
-
-void FlexboxLayout::handleAlignItemsCenter(LayoutNode* node) {
-    // Handle align-items: center
-}
-
-void FlexboxLayout::handleAlignItemsBaseline(LayoutNode* node) {
-    // Handle align-items: baseline
-}
-
-void FlexboxLayout::handleAlignContentStretch(LayoutNode* node) {
-    // Handle align-content: stretch
-}
-
-void FlexboxLayout::handleAlignContentFlexStart(LayoutNode* node) {
-    // Handle align-content: flex-start
-}
-
-void FlexboxLayout::handleAlignContentFlexEnd(LayoutNode* node) {
-    // Handle align-content: flex-end
-}
-
-void FlexboxLayout::handleAlignContentCenter(LayoutNode* node) {
-    // Handle align-content: center
-}
-
-void FlexboxLayout::handleAlignContentSpaceBetween(LayoutNode* node) {
-    // Handle align-content: space-between
-}
-
-void FlexboxLayout::handleAlignContentSpaceAround(LayoutNode* node) {
-    // Handle align-content: space-around
+    if (axes.mainReverse) main = axes.mainSize - main - item.main;
+    if (axes.crossReverse) cross = axes.crossSize - cross - item.cross;
+    Point position = axes.isRow ? Point(axes.originX + main, axes.originY + cross)
+                                : Point(axes.originX + cross, axes.originY + main);
+    item.node->updatePosition(position);
 }
 
 } // namespace layout
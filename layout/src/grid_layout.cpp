@@ -1,16 +1,28 @@
 #include "layout/grid_layout.h"
+#include "layout/layout_trace.h"
 #include <algorithm>
 #include <cmath>
 
 namespace layout {
 
+namespace {
+
+// Absolutely positioned children do not take grid cells
+bool takesGridArea(const LayoutNode* child) {
+    return child && child->box() && child->box()->position() != Position::Absolute &&
+           child->box()->position() != Position::Fixed;
+}
+
+} // namespace
+
 // GridLayout implementation
 GridLayout::GridLayout() = default;
 
 GridLayout::~GridLayout() = default;
 
 void GridLayout::layoutGridContainer(LayoutNode* node, const LayoutConstraints& constraints) {
-    if (!node || !node->box() || !node->isGridContainer()) return;
+    LAYOUT_TRACE_SCOPE(LayoutPhase::Grid);
+    if (!node || !node->box() || !node->box()->isGridContainer()) return;
     
     // Calculate grid container size
     Size containerSize = calculateGridContainerSize(node, constraints);
@@ -48,18 +60,15 @@ void GridLayout::layoutGridContainer(LayoutNode* node, const LayoutConstraints&
     // Handle grid row gap
     handleGridRowGap(node);
     
+    // Place grid items, auto-placed ones included
+    placeGridItems(node);
+    
     // Calculate grid tracks
     calculateGridTracks(node);
     
     // Calculate grid areas
     calculateGridAreas(node);
     
-    // Place grid items
-    placeGridItems(node);
-    
-    // Auto-place grid items
-    autoPlaceGridItems(node);
-    
     // Handle grid alignment
     handleGridAlignment(node);
 }
@@ -102,9 +111,13 @@ Size GridLayout::calculateGridContainerSize(LayoutNode* node, const LayoutConstr
     return totalSize;
 }
 
-Size GridLayout::calculateGridItemSize(LayoutNode* item, const LayoutConstraints& constraints) {
+Size GridLayout::calculateGridItemSize(LayoutNode* item, const LayoutConstraints& constraints, SizingMode mode) {
     if (!item || !item->box()) return Size(0, 0);
     
+    // The sizing passes ask for the same item repeatedly
+    Size cached;
+    if (item->findMeasurement(constraints, mode, cached)) return cached;
+    
     // Get box model properties
     const EdgeInsets& padding = item->box()->padding();
     const EdgeInsets& border = item->box()->border();
@@ -127,6 +140,7 @@ Size GridLayout::calculateGridItemSize(LayoutNode* item, const LayoutConstraints
     // Constrain size
     totalSize = constraints.constrain(totalSize);
     
+    item->cacheMeasurement(constraints, mode, totalSize);
     return totalSize;
 }
 
@@ -217,11 +231,12 @@ void GridLayout::handleGridRowGap(LayoutNode* node) {
 }
 
 void GridLayout::calculateGridTracks(LayoutNode* node) {
-    if (!node) return;
+    if (!node || !node->box()) return;
     
-    // Calculate grid tracks based on grid template and auto properties
-    // This is a simplified implementation
-    // In a real implementation, this would follow the CSS Grid algorithm
+    // Track sizes were resolved with the placement
+    calculateGridTrackSizes(node);
+    calculateGridTrackPositions(node);
+    calculateGridItemPositions(node);
 }
 
 void GridLayout::calculateGridAreas(LayoutNode* node) {
@@ -233,19 +248,29 @@ void GridLayout::calculateGridAreas(LayoutNode* node) {
 }
 
 void GridLayout::placeGridItems(LayoutNode* node) {
-    if (!node) return;
+    if (!node || !node->box()) return;
     
-    // Place grid items based on their grid placement properties
-    // This is a simplified implementation
-    // In a real implementation, this would follow the CSS Grid algorithm
+    // The node's track cache re-places and re-sizes only what changed
+    // since its last layout
+    std::vector<GridTrackCache::Item> items;
+    items.reserve(node->childCount());
+    for (auto* child : node->children()) {
+        if (!takesGridArea(child)) continue;
+        
+        const EdgeInsets& margin = child->box()->margin();
+        Size size(child->getBounds().width + margin.horizontal(), child->getBounds().height + margin.vertical());
+        items.push_back(GridTrackCache::Item{child, child->box()->gridPlacement(), size});
+    }
+    
+    const EdgeInsets& padding = node->box()->padding();
+    const EdgeInsets& border = node->box()->border();
+    double availableWidth = std::max(0.0, node->getBounds().width - padding.horizontal() - border.horizontal());
+    node->gridTrackCache().update(node->box()->gridTemplate(), items, availableWidth);
 }
 
 void GridLayout::autoPlaceGridItems(LayoutNode* node) {
-    if (!node) return;
-    
-    // Auto-place grid items based on grid auto flow
-    // This is a simplified implementation
-    // In a real implementation, this would follow the CSS Grid algorithm
+    // Auto-placement runs with the explicit placement, in source order
+    placeGridItems(node);
 }
 
 void GridLayout::calculateGridItemPlacement(LayoutNode* item) {
@@ -264,14 +289,6 @@ void GridLayout::calculateGridItemSpan(LayoutNode* item) {
     // In a real implementation, this would follow the CSS Grid algorithm
 }
 
-void GridLayout::calculateGridItemPosition(LayoutNode* item) {
-    if (!item) return;
-    
-    // Calculate grid item position based on grid placement and alignment
-    // This is a simplified implementation
-    // In a real implementation, this would follow the CSS Grid algorithm
-}
-
 void GridLayout::handleGridAlignment(LayoutNode* node) {
     if (!node) return;
     
@@ -355,11 +372,17 @@ void GridLayout::positionGridItem(LayoutNode* item) {
 // These are placeholder implementations for the various grid properties
 
 void GridLayout::calculateGridTrackSizes(LayoutNode* node) {
-    // Calculate grid track sizes
+    // The container grows to hold its rows
+    const GridTrackCache& cache = node->gridTrackCache();
+    const EdgeInsets& padding = node->box()->padding();
+    const EdgeInsets& border = node->box()->border();
+    Rect bounds = node->getBounds();
+    double height = cache.gridSize().height + padding.vertical() + border.vertical();
+    node->setLayoutRect(Rect(bounds.x, bounds.y, bounds.width, std::max(bounds.height, height)));
 }
 
 void GridLayout::calculateGridTrackPositions(LayoutNode* node) {
-    // Calculate grid track positions
+    // Track positions are kept by the track cache
 }
 
 void GridLayout::calculateGridItemSizes(LayoutNode* node) {
@@ -367,7 +390,20 @@ void GridLayout::calculateGridItemSizes(LayoutNode* node) {
 }
 
 void GridLayout::calculateGridItemPositions(LayoutNode* node) {
-    // Calculate grid item positions
+    const GridTrackCache& cache = node->gridTrackCache();
+    const EdgeInsets& padding = node->box()->padding();
+    const EdgeInsets& border = node->box()->border();
+    Point origin(padding.left + border.left, padding.top + border.top);
+    
+    // Items come in the order they were given to the cache
+    size_t index = 0;
+    for (auto* child : node->children()) {
+        if (!takesGridArea(child)) continue;
+        
+        Rect area = cache.areaRect(cache.areas()[index++]);
+        const EdgeInsets& margin = child->box()->margin();
+        child->updatePosition(Point(origin.x + area.x + margin.left, origin.y + area.y + margin.top));
+    }
 }
 
 void GridLayout::handleGridAutoFlowRow(LayoutNode* node) {
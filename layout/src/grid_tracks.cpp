@@ -0,0 +1,482 @@
+#include "layout/grid_tracks.h"
+#include <algorithm>
+#include <utility>
+
+namespace layout {
+
+bool GridTemplate::operator==(const GridTemplate& other) const {
+    return columns == other.columns && rows == other.rows && autoColumns == other.autoColumns &&
+           autoRows == other.autoRows && autoFlow == other.autoFlow && columnGap == other.columnGap &&
+           rowGap == other.rowGap;
+}
+
+// GridOccupancy implementation
+GridOccupancy::GridOccupancy(uint32_t crossCount)
+    : lines_()
+    , crossCount_(std::max<uint32_t>(crossCount, 1))
+    , firstOpen_(0) {
+}
+
+void GridOccupancy::reset(uint32_t crossCount) {
+    lines_.clear();
+    crossCount_ = std::max<uint32_t>(crossCount, 1);
+    firstOpen_ = 0;
+}
+
+bool GridOccupancy::isFree(uint32_t line, uint32_t cross, uint32_t lineSpan, uint32_t crossSpan) const {
+    for (size_t i = line; i < line + lineSpan && i < lines_.size(); ++i) {
+        if (blockedUntil(i, cross, crossSpan) != cross) return false;
+    }
+    return true;
+}
+
+void GridOccupancy::occupy(uint32_t line, uint32_t cross, uint32_t lineSpan, uint32_t crossSpan) {
+    if (lines_.size() < line + lineSpan) {
+        lines_.resize(line + lineSpan);
+    }
+
+    uint32_t end = cross + crossSpan;
+    for (size_t i = line; i < line + lineSpan; ++i) {
+        // Merge with every interval that overlaps or touches [cross, end)
+        auto& intervals = lines_[i];
+        auto first = std::lower_bound(intervals.begin(), intervals.end(), cross,
+                                      [](const Interval& interval, uint32_t value) { return interval.end < value; });
+        auto last = first;
+        Interval merged{cross, end};
+        while (last != intervals.end() && last->start <= end) {
+            merged.start = std::min(merged.start, last->start);
+            merged.end = std::max(merged.end, last->end);
+            ++last;
+        }
+        first = intervals.erase(first, last);
+        intervals.insert(first, merged);
+    }
+
+    while (firstOpen_ < lines_.size() && isFull(firstOpen_)) {
+        ++firstOpen_;
+    }
+}
+
+uint32_t GridOccupancy::findFree(uint32_t line, uint32_t cross, uint32_t lineSpan, uint32_t crossSpan) const {
+    uint32_t candidate = cross;
+    while (candidate + crossSpan <= crossCount_) {
+        // Jump past whatever blocks the candidate in any spanned line
+        uint32_t next = candidate;
+        for (size_t i = line; i < line + lineSpan && i < lines_.size(); ++i) {
+            next = std::max(next, blockedUntil(i, candidate, crossSpan));
+        }
+        if (next == candidate) return candidate;
+        candidate = next;
+    }
+    return crossCount_;
+}
+
+uint32_t GridOccupancy::blockedUntil(size_t line, uint32_t cross, uint32_t span) const {
+    const auto& intervals = lines_[line];
+    // First interval ending after cross; intervals are disjoint and sorted
+    auto it = std::upper_bound(intervals.begin(), intervals.end(), cross,
+                               [](uint32_t value, const Interval& interval) { return value < interval.end; });
+    if (it != intervals.end() && it->start < cross + span) return it->end;
+    return cross;
+}
+
+bool GridOccupancy::isFull(size_t line) const {
+    const auto& intervals = lines_[line];
+    return !intervals.empty() && intervals.front().start == 0 && intervals.front().end >= crossCount_;
+}
+
+// GridTrackCache implementation
+GridTrackCache::GridTrackCache()
+    : style_()
+    , availableWidth_(0)
+    , nodes_()
+    , placements_()
+    , sizes_()
+    , areas_()
+    , spanning_()
+    , occupancy_()
+    , cursor_()
+    , columns_()
+    , rows_()
+    , dirtyColumns_()
+    , dirtyRows_()
+    , placedItems_(0)
+    , resolvedTracks_(0)
+    , fullPlacements_(0) {
+}
+
+void GridTrackCache::reset() {
+    nodes_.clear();
+    placements_.clear();
+    sizes_.clear();
+    areas_.clear();
+    spanning_.clear();
+    occupancy_.reset(1);
+    cursor_ = Cursor();
+    columns_.clear();
+    rows_.clear();
+    dirtyColumns_.clear();
+    dirtyRows_.clear();
+}
+
+void GridTrackCache::update(const GridTemplate& style, const std::vector<Item>& items, double availableWidth) {
+    placedItems_ = 0;
+    resolvedTracks_ = 0;
+    availableWidth_ = availableWidth;
+
+    // Old items still in place, in order and with the same placement
+    size_t oldCount = nodes_.size();
+    size_t kept = 0;
+    while (kept < oldCount && kept < items.size() && nodes_[kept] == items[kept].node &&
+           placements_[kept] == items[kept].placement) {
+        ++kept;
+    }
+
+    if (style != style_ || kept < oldCount) {
+        style_ = style;
+        placeAll(items);
+        return;
+    }
+
+    size_t firstRow = rows_.size();
+    nodes_.reserve(items.size());
+    for (size_t i = oldCount; i < items.size(); ++i) {
+        nodes_.push_back(items[i].node);
+        placements_.push_back(items[i].placement);
+        sizes_.push_back(Size(0, 0));
+        areas_.push_back(GridArea{0, 0, 1, 1});
+    }
+    if (!placeItems(oldCount, items.size(), false)) {
+        placeAll(items);
+        return;
+    }
+
+    // Resized items move only the tracks they sit in
+    for (size_t i = 0; i < oldCount; ++i) {
+        if (sizes_[i].width == items[i].size.width && sizes_[i].height == items[i].size.height) continue;
+
+        Size oldSize = sizes_[i];
+        sizes_[i] = items[i].size;
+        removeContribution(static_cast<uint32_t>(i), oldSize);
+        addContribution(static_cast<uint32_t>(i));
+    }
+    for (size_t i = oldCount; i < items.size(); ++i) {
+        sizes_[i] = items[i].size;
+        addContribution(static_cast<uint32_t>(i));
+        firstRow = std::min<size_t>(firstRow, areas_[i].row);
+    }
+    resolveTracks(firstRow);
+}
+
+Size GridTrackCache::gridSize() const {
+    double width = columns_.empty() ? 0 : columns_.back().position + columns_.back().size;
+    double height = rows_.empty() ? 0 : rows_.back().position + rows_.back().size;
+    return Size(width, height);
+}
+
+Rect GridTrackCache::areaRect(const GridArea& area) const {
+    const Track& firstColumn = columns_[area.column];
+    const Track& lastColumn = columns_[area.columnEnd() - 1];
+    const Track& firstRow = rows_[area.row];
+    const Track& lastRow = rows_[area.rowEnd() - 1];
+    return Rect(firstColumn.position, firstRow.position,
+                lastColumn.position + lastColumn.size - firstColumn.position,
+                lastRow.position + lastRow.size - firstRow.position);
+}
+
+bool GridTrackCache::isRowFlow() const {
+    return style_.autoFlow != GridAutoFlow::Column && style_.autoFlow != GridAutoFlow::ColumnDense;
+}
+
+bool GridTrackCache::isDense() const {
+    return style_.autoFlow == GridAutoFlow::Dense || style_.autoFlow == GridAutoFlow::RowDense ||
+           style_.autoFlow == GridAutoFlow::ColumnDense;
+}
+
+void GridTrackCache::placeAll(const std::vector<Item>& items) {
+    ++fullPlacements_;
+    nodes_.clear();
+    placements_.clear();
+    sizes_.clear();
+    for (const auto& item : items) {
+        nodes_.push_back(item.node);
+        placements_.push_back(item.placement);
+        sizes_.push_back(item.size);
+    }
+    areas_.assign(items.size(), GridArea{0, 0, 1, 1});
+    spanning_.clear();
+    columns_.clear();
+    rows_.clear();
+    dirtyColumns_.clear();
+    dirtyRows_.clear();
+    cursor_ = Cursor();
+
+    // Lines across the flow hold the explicit tracks and every item
+    bool rowFlow = isRowFlow();
+    uint32_t crossCount = static_cast<uint32_t>(rowFlow ? style_.columns.size() : style_.rows.size());
+    for (const auto& placement : placements_) {
+        uint32_t start = rowFlow ? placement.column : placement.row;
+        uint32_t span = std::max<uint32_t>(rowFlow ? placement.columnSpan : placement.rowSpan, 1);
+        crossCount = std::max(crossCount, (start > 0 ? start - 1 : 0) + span);
+    }
+    occupancy_.reset(crossCount);
+
+    placeItems(0, items.size(), true);
+    for (size_t i = 0; i < items.size(); ++i) {
+        addContribution(static_cast<uint32_t>(i));
+    }
+    resolveTracks(0);
+}
+
+bool GridTrackCache::placeItems(size_t first, size_t end, bool full) {
+    bool rowFlow = isRowFlow();
+    auto lineStart = [rowFlow](const GridPlacement& placement) { return rowFlow ? placement.row : placement.column; };
+    auto crossStart = [rowFlow](const GridPlacement& placement) { return rowFlow ? placement.column : placement.row; };
+    auto lineSpan = [rowFlow](const GridPlacement& placement) {
+        return std::max<uint32_t>(rowFlow ? placement.rowSpan : placement.columnSpan, 1);
+    };
+    auto crossSpan = [rowFlow](const GridPlacement& placement) {
+        return std::max<uint32_t>(rowFlow ? placement.columnSpan : placement.rowSpan, 1);
+    };
+
+    if (!full) {
+        // A new item may go where the old ones left room, as placing it
+        // first would not have moved them
+        for (size_t i = first; i < end; ++i) {
+            const GridPlacement& placement = placements_[i];
+            uint32_t line = lineStart(placement);
+            uint32_t cross = crossStart(placement);
+            if (cross > 0 && cross - 1 + crossSpan(placement) > occupancy_.crossCount()) return false;
+            if (crossSpan(placement) > occupancy_.crossCount()) return false;
+            if (line > 0 && cross == 0) return false;
+
+            if (line > 0) {
+                if (!occupancy_.isFree(line - 1, cross - 1, lineSpan(placement), crossSpan(placement))) return false;
+                setArea(static_cast<uint32_t>(i), line - 1, cross - 1, lineSpan(placement), crossSpan(placement));
+            } else {
+                placeAuto(static_cast<uint32_t>(i));
+            }
+        }
+        return true;
+    }
+
+    // Fully positioned items first, then those locked to a line, then the
+    // rest in order
+    for (size_t i = first; i < end; ++i) {
+        const GridPlacement& placement = placements_[i];
+        if (lineStart(placement) > 0 && crossStart(placement) > 0) {
+            setArea(static_cast<uint32_t>(i), lineStart(placement) - 1, crossStart(placement) - 1,
+                    lineSpan(placement), crossSpan(placement));
+        }
+    }
+    for (size_t i = first; i < end; ++i) {
+        const GridPlacement& placement = placements_[i];
+        if (lineStart(placement) > 0 && crossStart(placement) == 0) {
+            uint32_t line = lineStart(placement) - 1;
+            uint32_t cross = occupancy_.findFree(line, 0, lineSpan(placement), crossSpan(placement));
+            // A full line takes the item at its start, overlapping
+            if (cross >= occupancy_.crossCount()) cross = 0;
+            setArea(static_cast<uint32_t>(i), line, cross, lineSpan(placement), crossSpan(placement));
+        }
+    }
+    for (size_t i = first; i < end; ++i) {
+        if (lineStart(placements_[i]) == 0) {
+            placeAuto(static_cast<uint32_t>(i));
+        }
+    }
+    return true;
+}
+
+void GridTrackCache::placeAuto(uint32_t index) {
+    bool rowFlow = isRowFlow();
+    const GridPlacement& placement = placements_[index];
+    uint32_t crossStart = rowFlow ? placement.column : placement.row;
+    uint32_t lineSpan = std::max<uint32_t>(rowFlow ? placement.rowSpan : placement.columnSpan, 1);
+    uint32_t crossSpan = std::max<uint32_t>(rowFlow ? placement.columnSpan : placement.rowSpan, 1);
+    bool dense = isDense();
+
+    uint32_t line = dense ? static_cast<uint32_t>(occupancy_.firstOpenLine()) : cursor_.line;
+    uint32_t cross = 0;
+    if (crossStart > 0) {
+        cross = crossStart - 1;
+        if (!dense && cross < cursor_.cross) ++line;
+        while (!occupancy_.isFree(line, cross, lineSpan, crossSpan)) {
+            ++line;
+        }
+    } else {
+        uint32_t from = dense ? 0 : cursor_.cross;
+        for (;;) {
+            cross = occupancy_.findFree(line, from, lineSpan, crossSpan);
+            if (cross < occupancy_.crossCount()) break;
+            ++line;
+            from = 0;
+        }
+    }
+
+    setArea(index, line, cross, lineSpan, crossSpan);
+    if (!dense) {
+        cursor_.line = line;
+        cursor_.cross = cross + crossSpan;
+    }
+}
+
+void GridTrackCache::setArea(uint32_t index, uint32_t line, uint32_t cross, uint32_t lineSpan, uint32_t crossSpan) {
+    occupancy_.occupy(line, cross, lineSpan, crossSpan);
+    ++placedItems_;
+
+    GridArea area = isRowFlow() ? GridArea{line, cross, lineSpan, crossSpan} : GridArea{cross, line, crossSpan, lineSpan};
+    areas_[index] = area;
+    if (columns_.size() < area.columnEnd()) columns_.resize(area.columnEnd());
+    if (rows_.size() < area.rowEnd()) rows_.resize(area.rowEnd());
+
+    if (area.columnSpan == 1) columns_[area.column].items.push_back(index);
+    if (area.rowSpan == 1) rows_[area.row].items.push_back(index);
+    if (area.columnSpan > 1 || area.rowSpan > 1) spanning_.push_back(index);
+}
+
+void GridTrackCache::addContribution(uint32_t index) {
+    const GridArea& area = areas_[index];
+    if (area.columnSpan == 1) {
+        Track& column = columns_[area.column];
+        column.content = std::max(column.content, sizes_[index].width);
+        dirtyColumns_.push_back(area.column);
+    }
+    if (area.rowSpan == 1) {
+        Track& row = rows_[area.row];
+        row.content = std::max(row.content, sizes_[index].height);
+        dirtyRows_.push_back(area.row);
+    }
+}
+
+void GridTrackCache::removeContribution(uint32_t index, const Size& oldSize) {
+    // Only the largest item can shrink its track
+    const GridArea& area = areas_[index];
+    if (area.columnSpan == 1 && oldSize.width >= columns_[area.column].content) {
+        columns_[area.column].rescan = true;
+    }
+    if (area.rowSpan == 1 && oldSize.height >= rows_[area.row].content) {
+        rows_[area.row].rescan = true;
+    }
+}
+
+void GridTrackCache::resolveTracks(size_t firstRow) {
+    auto rescan = [this](std::vector<Track>& tracks, std::vector<uint32_t>& dirty, bool width) {
+        size_t first = tracks.size();
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        for (uint32_t index : dirty) {
+            Track& track = tracks[index];
+            if (track.rescan) {
+                track.content = 0;
+                for (uint32_t item : track.items) {
+                    track.content = std::max(track.content, width ? sizes_[item].width : sizes_[item].height);
+                }
+                track.rescan = false;
+            }
+            first = std::min<size_t>(first, index);
+            ++resolvedTracks_;
+        }
+        dirty.clear();
+        return first;
+    };
+    rescan(columns_, dirtyColumns_, true);
+    firstRow = std::min(firstRow, rescan(rows_, dirtyRows_, false));
+
+    // Rows whose growth from spanning items changed move the rows below
+    std::vector<std::pair<uint32_t, double>> oldExtra;
+    for (uint32_t index : spanning_) {
+        const GridArea& area = areas_[index];
+        for (uint32_t row = area.row; area.rowSpan > 1 && row < area.rowEnd(); ++row) {
+            oldExtra.emplace_back(row, rows_[row].extra);
+        }
+    }
+    distributeSpanning();
+    for (const auto& entry : oldExtra) {
+        if (rows_[entry.first].extra != entry.second) {
+            firstRow = std::min<size_t>(firstRow, entry.first);
+        }
+    }
+
+    // Columns share the available width, so they are all re-resolved;
+    // there are few of them and their contents are already known
+    double used = 0;
+    double fractions = 0;
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        const GridTrackSize& definition = style_.column(i);
+        Track& column = columns_[i];
+        column.size = definition.kind == GridTrackSize::Kind::Fixed ? definition.value : column.content + column.extra;
+        if (definition.kind == GridTrackSize::Kind::Flex) {
+            fractions += definition.value;
+        } else {
+            used += column.size;
+        }
+    }
+    if (fractions > 0) {
+        double leftover = availableWidth_ - used - style_.columnGap * (columns_.empty() ? 0 : columns_.size() - 1);
+        double unit = leftover > 0 ? leftover / std::max(fractions, 1.0) : 0;
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            const GridTrackSize& definition = style_.column(i);
+            if (definition.kind == GridTrackSize::Kind::Flex) {
+                columns_[i].size = std::max(columns_[i].size, unit * definition.value);
+            }
+        }
+    }
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        columns_[i].position = i == 0 ? 0 : columns_[i - 1].position + columns_[i - 1].size + style_.columnGap;
+    }
+
+    for (size_t i = firstRow; i < rows_.size(); ++i) {
+        const GridTrackSize& definition = style_.row(i);
+        Track& row = rows_[i];
+        row.size = definition.kind == GridTrackSize::Kind::Fixed ? definition.value : row.content + row.extra;
+        row.position = i == 0 ? 0 : rows_[i - 1].position + rows_[i - 1].size + style_.rowGap;
+    }
+}
+
+void GridTrackCache::distributeSpanning() {
+    if (spanning_.empty()) return;
+
+    for (uint32_t index : spanning_) {
+        const GridArea& area = areas_[index];
+        for (uint32_t column = area.column; column < area.columnEnd(); ++column) columns_[column].extra = 0;
+        for (uint32_t row = area.row; row < area.rowEnd(); ++row) rows_[row].extra = 0;
+    }
+
+    // Narrow spans first, so wide ones only add what is still missing
+    std::vector<uint32_t> order(spanning_);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return areas_[a].columnSpan + areas_[a].rowSpan < areas_[b].columnSpan + areas_[b].rowSpan;
+    });
+
+    auto grow = [](std::vector<Track>& tracks, uint32_t first, uint32_t span, double needed, double gap,
+                   auto definition) {
+        if (span < 2) return;
+
+        double current = gap * (span - 1);
+        uint32_t growable = 0;
+        for (uint32_t i = first; i < first + span; ++i) {
+            if (definition(i).kind == GridTrackSize::Kind::Fixed) {
+                current += definition(i).value;
+            } else {
+                current += tracks[i].content + tracks[i].extra;
+                ++growable;
+            }
+        }
+        if (needed <= current || growable == 0) return;
+
+        double share = (needed - current) / growable;
+        for (uint32_t i = first; i < first + span; ++i) {
+            if (definition(i).kind != GridTrackSize::Kind::Fixed) tracks[i].extra += share;
+        }
+    };
+
+    for (uint32_t index : order) {
+        const GridArea& area = areas_[index];
+        grow(columns_, area.column, area.columnSpan, sizes_[index].width, style_.columnGap,
+             [this](size_t i) -> const GridTrackSize& { return style_.column(i); });
+        grow(rows_, area.row, area.rowSpan, sizes_[index].height, style_.rowGap,
+             [this](size_t i) -> const GridTrackSize& { return style_.row(i); });
+    }
+}
+
+} // namespace layout
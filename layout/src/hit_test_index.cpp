@@ -0,0 +1,220 @@
+#include "layout/hit_test_index.h"
+#include "layout/stacking_context.h"
+#include <algorithm>
+#include <limits>
+
+namespace layout {
+
+namespace {
+
+constexpr uint32_t kNoItem = std::numeric_limits<uint32_t>::max();
+
+} // namespace
+
+// Bounds
+HitTestIndex::Bounds HitTestIndex::Bounds::empty() {
+    double infinity = std::numeric_limits<double>::infinity();
+    return Bounds{infinity, infinity, -infinity, -infinity};
+}
+
+HitTestIndex::Bounds HitTestIndex::Bounds::everything() {
+    double infinity = std::numeric_limits<double>::infinity();
+    return Bounds{-infinity, -infinity, infinity, infinity};
+}
+
+HitTestIndex::Bounds HitTestIndex::Bounds::of(const Rect& rect) {
+    return Bounds{rect.x, rect.y, rect.x + rect.width, rect.y + rect.height};
+}
+
+HitTestIndex::Bounds HitTestIndex::Bounds::intersection(const Bounds& other) const {
+    Bounds result{std::max(minX, other.minX), std::max(minY, other.minY),
+                  std::min(maxX, other.maxX), std::min(maxY, other.maxY)};
+    return result.isEmpty() ? empty() : result;
+}
+
+void HitTestIndex::Bounds::expand(const Bounds& other) {
+    minX = std::min(minX, other.minX);
+    minY = std::min(minY, other.minY);
+    maxX = std::max(maxX, other.maxX);
+    maxY = std::max(maxY, other.maxY);
+}
+
+// HitTestIndex implementation
+HitTestIndex::HitTestIndex()
+    : items_()
+    , nodes_()
+    , itemOf_()
+    , tree_(nullptr)
+    , root_(nullptr)
+    , structureVersion_(0)
+    , paintOrderVersion_(0)
+    , stale_(true)
+    , rebuildCount_(0)
+    , refitCount_(0) {
+}
+
+void HitTestIndex::update(const LayoutTree& tree) {
+    if (&tree != tree_ || tree.root() != root_ || tree.arena().structureVersion() != structureVersion_) {
+        rebuild(tree);
+    } else if (stale_ || tree.paintOrder().version() != paintOrderVersion_) {
+        refit();
+    }
+}
+
+void HitTestIndex::reset() {
+    tree_ = nullptr;
+    root_ = nullptr;
+    items_.clear();
+    nodes_.clear();
+    itemOf_.clear();
+    stale_ = true;
+}
+
+LayoutNode* HitTestIndex::hitTest(const Point& point) const {
+    if (nodes_.empty()) return nullptr;
+
+    const Item* best = nullptr;
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        const BvhNode& node = nodes_[index];
+
+        if (!node.bounds.contains(point)) continue;
+        if (best && node.maxPaintOrder <= best->paintOrder) continue;
+
+        if (node.count > 0) {
+            for (uint32_t i = node.start; i < node.start + node.count; ++i) {
+                const Item& item = items_[i];
+                if (item.bounds.contains(point) && (!best || item.paintOrder > best->paintOrder)) {
+                    best = &item;
+                }
+            }
+            continue;
+        }
+
+        // The child that can hold the later-painted hit goes first
+        uint32_t left = index + 1;
+        uint32_t right = node.start;
+        if (nodes_[left].maxPaintOrder > nodes_[right].maxPaintOrder) {
+            stack.push_back(right);
+            stack.push_back(left);
+        } else {
+            stack.push_back(left);
+            stack.push_back(right);
+        }
+    }
+    return best ? best->node : nullptr;
+}
+
+void HitTestIndex::rebuild(const LayoutTree& tree) {
+    tree_ = &tree;
+    root_ = tree.root();
+    structureVersion_ = tree.arena().structureVersion();
+    stale_ = false;
+    ++rebuildCount_;
+
+    items_.clear();
+    nodes_.clear();
+    itemOf_.assign(tree.arena().end(), kNoItem);
+    if (!tree.root()) return;
+
+    for (const auto& item : tree.paintOrder().items()) {
+        itemOf_[item.node->index()] = static_cast<uint32_t>(items_.size());
+        items_.push_back(Item{item.node, Bounds::empty(), 0});
+    }
+    assignPaintOrder(tree);
+    clipBounds(root_, Bounds::everything());
+
+    buildNode(0, items_.size());
+    for (size_t i = 0; i < items_.size(); ++i) {
+        itemOf_[items_[i].node->index()] = static_cast<uint32_t>(i);
+    }
+}
+
+// Same nodes and hierarchy, new boxes and paint order
+void HitTestIndex::refit() {
+    stale_ = false;
+    ++refitCount_;
+    if (!root_) return;
+
+    assignPaintOrder(*tree_);
+    clipBounds(root_, Bounds::everything());
+
+    // Children come after their parent, so a backward pass is bottom-up
+    for (size_t i = nodes_.size(); i-- > 0;) {
+        refitNode(i);
+    }
+}
+
+void HitTestIndex::assignPaintOrder(const LayoutTree& tree) {
+    const PaintOrderList& paintOrder = tree.paintOrder();
+    paintOrderVersion_ = paintOrder.version();
+
+    uint32_t order = 0;
+    for (const auto& item : paintOrder.items()) {
+        items_[itemOf_[item.node->index()]].paintOrder = order++;
+    }
+}
+
+void HitTestIndex::clipBounds(const LayoutNode* node, const Bounds& clip) {
+    Bounds bounds = clip.intersection(Bounds::of(node->getBounds()));
+    items_[itemOf_[node->index()]].bounds = bounds;
+    for (auto* child : node->children()) {
+        clipBounds(child, bounds);
+    }
+}
+
+uint32_t HitTestIndex::buildNode(size_t begin, size_t end) {
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(BvhNode{Bounds::empty(), 0, 0, 0});
+
+    Bounds bounds = Bounds::empty();
+    uint32_t maxPaintOrder = 0;
+    for (size_t i = begin; i < end; ++i) {
+        bounds.expand(items_[i].bounds);
+        maxPaintOrder = std::max(maxPaintOrder, items_[i].paintOrder);
+    }
+
+    if (end - begin <= kLeafSize) {
+        nodes_[index] = BvhNode{bounds, static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin), maxPaintOrder};
+        return index;
+    }
+
+    // Median split along the wider axis; empty items can go anywhere
+    bool splitX = bounds.maxX - bounds.minX >= bounds.maxY - bounds.minY;
+    auto centre = [splitX](const Item& item) {
+        if (item.bounds.isEmpty()) return 0.0;
+        return splitX ? item.bounds.minX + item.bounds.maxX : item.bounds.minY + item.bounds.maxY;
+    };
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(items_.begin() + begin, items_.begin() + middle, items_.begin() + end,
+        [&centre](const Item& a, const Item& b) { return centre(a) < centre(b); });
+
+    buildNode(begin, middle);
+    uint32_t right = buildNode(middle, end);
+    nodes_[index] = BvhNode{bounds, right, 0, maxPaintOrder};
+    return index;
+}
+
+void HitTestIndex::refitNode(size_t index) {
+    BvhNode& node = nodes_[index];
+    node.bounds = Bounds::empty();
+    node.maxPaintOrder = 0;
+
+    if (node.count > 0) {
+        for (uint32_t i = node.start; i < node.start + node.count; ++i) {
+            node.bounds.expand(items_[i].bounds);
+            node.maxPaintOrder = std::max(node.maxPaintOrder, items_[i].paintOrder);
+        }
+        return;
+    }
+
+    for (size_t child : {index + 1, static_cast<size_t>(node.start)}) {
+        node.bounds.expand(nodes_[child].bounds);
+        node.maxPaintOrder = std::max(node.maxPaintOrder, nodes_[child].maxPaintOrder);
+    }
+}
+
+} // namespace layout
@@ -1,4 +1,6 @@
 #include "layout/inline_layout.h"
+#include "layout/layout_trace.h"
+#include "layout/text_layout.h"
 #include <algorithm>
 #include <cmath>
 
@@ -10,6 +12,7 @@ InlineLayout::InlineLayout() = default;
 InlineLayout::~InlineLayout() = default;
 
 void InlineLayout::layoutInline(LayoutNode* node, const LayoutConstraints& constraints) {
+    LAYOUT_TRACE_SCOPE(LayoutPhase::Inline);
     if (!node || !node->box()) return;
     
     // Calculate inline size
@@ -101,11 +104,15 @@ void InlineLayout::layoutText(LayoutNode* node) {
 }
 
 void InlineLayout::breakLines(LayoutNode* node) {
-    if (!node) return;
+    if (!node || node->textContent().empty()) return;
+    
+    // Line boxes are shortened by the floats of the formatting context
+    TextLayout textLayout;
+    std::vector<std::string> lines = textLayout.breakTextAroundFloats(node);
     
-    // Break lines based on text content and available width
+    // Process lines
     // This is a simplified implementation
-    // In a real implementation, this would handle line breaking algorithms
+    // In a real implementation, this would build the line boxes
 }
 
 void InlineLayout::wrapWords(LayoutNode* node) {
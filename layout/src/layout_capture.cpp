@@ -0,0 +1,678 @@
+#include "layout/layout_capture.h"
+#include "layout/grid_tracks.h"
+#include "apollo/mapped_file.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <type_traits>
+#include <unordered_map>
+
+namespace layout {
+
+namespace {
+
+// "LYTC" read little endian; reversed when written big endian
+constexpr uint32_t kMagic = 0x4354594C;
+constexpr uint32_t kSwappedMagic = 0x4C595443;
+constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+struct CaptureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t boxCount;
+    uint32_t fontCount;
+    uint32_t templateCount;
+    uint32_t trackCount;
+    uint32_t reserved;
+    uint64_t stringBytes;
+    uint64_t nodesOffset;
+    uint64_t boxesOffset;
+    uint64_t fontsOffset;
+    uint64_t templatesOffset;
+    uint64_t tracksOffset;
+    uint64_t stringsOffset;
+};
+
+struct NodeRecord {
+    // kNone for the root, then always an earlier node
+    uint32_t parent;
+    uint32_t box;
+    // kNone for default metrics
+    uint32_t font;
+    uint32_t textLength;
+    uint64_t textOffset;
+    double intrinsicSize[2];
+    double minSize[2];
+    double maxSize[2];
+    double layoutRect[4];
+    double lineHeight;
+    double baseline;
+};
+
+// Doubles first, then narrower fields, so there is no padding and equal
+// styles compare equal byte for byte
+struct BoxRecord {
+    double contentRect[4];
+    double padding[4];
+    double border[4];
+    double margin[4];
+    double transform[6];
+    double opacity;
+    double clipRect[4];
+    double insets[4];
+    double flexRowGap;
+    double flexColumnGap;
+    double flexGrow;
+    double flexShrink;
+    double flexBasis;
+    int32_t zIndex;
+    // kNone for no template
+    uint32_t gridTemplate;
+    uint32_t gridPlacement[4];
+    uint8_t boxSizing;
+    uint8_t display;
+    uint8_t position;
+    uint8_t cssFloat;
+    uint8_t clear;
+    uint8_t visibility;
+    uint8_t overflow;
+    uint8_t flags;
+    uint8_t flexDirection;
+    uint8_t flexWrap;
+    uint8_t justifyContent;
+    uint8_t alignItems;
+    uint8_t alignContent;
+    uint8_t alignSelf;
+    // Bits 0 to 3: top, right, bottom and left have a value
+    uint8_t insetSides;
+    uint8_t reserved;
+};
+
+struct FontRecord {
+    double ascent;
+    double descent;
+    double leading;
+    double xHeight;
+    double capHeight;
+};
+
+struct TemplateRecord {
+    uint32_t firstColumn;
+    uint32_t columnCount;
+    uint32_t firstRow;
+    uint32_t rowCount;
+    double autoColumns;
+    double autoRows;
+    double columnGap;
+    double rowGap;
+    uint8_t autoColumnsKind;
+    uint8_t autoRowsKind;
+    uint8_t autoFlow;
+    uint8_t padding[5];
+};
+
+struct TrackRecord {
+    double value;
+    uint8_t kind;
+    uint8_t padding[7];
+};
+
+static_assert(sizeof(CaptureHeader) == 88, "capture header layout changed");
+static_assert(sizeof(NodeRecord) == 120, "node record layout changed");
+static_assert(sizeof(BoxRecord) == 328, "box record layout changed");
+static_assert(sizeof(FontRecord) == 40, "font record layout changed");
+static_assert(sizeof(TemplateRecord) == 56, "template record layout changed");
+static_assert(sizeof(TrackRecord) == 16, "track record layout changed");
+static_assert(std::is_trivially_copyable<BoxRecord>::value, "records are copied as bytes");
+
+enum BoxFlags : uint8_t {
+    kReplaced = 1 << 0,
+    kAnonymous = 1 << 1,
+    kRoot = 1 << 2,
+};
+
+// Highest stored value of each enum, for validating loads
+constexpr uint8_t kMaxDisplay = static_cast<uint8_t>(Display::Contents);
+constexpr uint8_t kMaxPosition = static_cast<uint8_t>(Position::Sticky);
+constexpr uint8_t kMaxFloat = static_cast<uint8_t>(Float::Right);
+constexpr uint8_t kMaxClear = static_cast<uint8_t>(Clear::Both);
+constexpr uint8_t kMaxBoxSizing = static_cast<uint8_t>(BoxSizing::BorderBox);
+constexpr uint8_t kMaxVisibility = static_cast<uint8_t>(Visibility::Collapse);
+constexpr uint8_t kMaxOverflow = static_cast<uint8_t>(Overflow::Auto);
+constexpr uint8_t kMaxFlexDirection = static_cast<uint8_t>(FlexDirection::ColumnReverse);
+constexpr uint8_t kMaxFlexWrap = static_cast<uint8_t>(FlexWrap::WrapReverse);
+constexpr uint8_t kMaxJustifyContent = static_cast<uint8_t>(JustifyContent::SpaceEvenly);
+constexpr uint8_t kMaxAlignItems = static_cast<uint8_t>(AlignItems::Baseline);
+constexpr uint8_t kMaxAlignContent = static_cast<uint8_t>(AlignContent::SpaceAround);
+constexpr uint8_t kMaxAlignSelf = static_cast<uint8_t>(AlignSelf::Baseline);
+constexpr uint8_t kMaxAutoFlow = static_cast<uint8_t>(GridAutoFlow::ColumnDense);
+constexpr uint8_t kMaxTrackKind = static_cast<uint8_t>(GridTrackSize::Kind::Flex);
+
+size_t alignUp(size_t offset) {
+    return (offset + 7) & ~size_t(7);
+}
+
+template <typename Record>
+struct RecordHash {
+    size_t operator()(const Record& record) const {
+        // FNV-1a over the record's bytes
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&record);
+        uint64_t hash = 1469598103934665603ull;
+        for (size_t i = 0; i < sizeof(Record); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+template <typename Record>
+struct RecordEqual {
+    bool operator()(const Record& a, const Record& b) const { return std::memcmp(&a, &b, sizeof(Record)) == 0; }
+};
+
+// Stores each distinct record once
+template <typename Record>
+class RecordTable {
+public:
+    uint32_t add(const Record& record) {
+        auto inserted = index_.emplace(record, static_cast<uint32_t>(records_.size()));
+        if (inserted.second) records_.push_back(record);
+        return inserted.first->second;
+    }
+
+    const std::vector<Record>& records() const { return records_; }
+
+private:
+    std::vector<Record> records_;
+    std::unordered_map<Record, uint32_t, RecordHash<Record>, RecordEqual<Record>> index_;
+};
+
+class CaptureWriter {
+public:
+    void addTree(const LayoutTree& tree) {
+        nodes_.reserve(tree.arena().size());
+        addNode(tree.root(), kNone);
+    }
+
+    std::vector<uint8_t> finish() const {
+        CaptureHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = kMagic;
+        header.version = kLayoutCaptureVersion;
+        header.nodeCount = static_cast<uint32_t>(nodes_.size());
+        header.boxCount = static_cast<uint32_t>(boxes_.records().size());
+        header.fontCount = static_cast<uint32_t>(fonts_.records().size());
+        header.templateCount = static_cast<uint32_t>(templates_.size());
+        header.trackCount = static_cast<uint32_t>(tracks_.size());
+        header.stringBytes = strings_.size();
+
+        size_t offset = sizeof(CaptureHeader);
+        header.nodesOffset = offset;
+        offset = alignUp(offset + nodes_.size() * sizeof(NodeRecord));
+        header.boxesOffset = offset;
+        offset = alignUp(offset + boxes_.records().size() * sizeof(BoxRecord));
+        header.fontsOffset = offset;
+        offset = alignUp(offset + fonts_.records().size() * sizeof(FontRecord));
+        header.templatesOffset = offset;
+        offset = alignUp(offset + templates_.size() * sizeof(TemplateRecord));
+        header.tracksOffset = offset;
+        offset = alignUp(offset + tracks_.size() * sizeof(TrackRecord));
+        header.stringsOffset = offset;
+        offset += strings_.size();
+
+        std::vector<uint8_t> out(offset, 0);
+        std::memcpy(out.data(), &header, sizeof(header));
+        copySection(out, header.nodesOffset, nodes_);
+        copySection(out, header.boxesOffset, boxes_.records());
+        copySection(out, header.fontsOffset, fonts_.records());
+        copySection(out, header.templatesOffset, templates_);
+        copySection(out, header.tracksOffset, tracks_);
+        if (!strings_.empty()) std::memcpy(out.data() + header.stringsOffset, strings_.data(), strings_.size());
+        return out;
+    }
+
+private:
+    std::vector<NodeRecord> nodes_;
+    RecordTable<BoxRecord> boxes_;
+    RecordTable<FontRecord> fonts_;
+    std::vector<TemplateRecord> templates_;
+    std::vector<TrackRecord> tracks_;
+    // Templates are shared between boxes by pointer
+    std::map<const GridTemplate*, uint32_t> templateIndex_;
+    std::string strings_;
+
+    template <typename Record>
+    static void copySection(std::vector<uint8_t>& out, uint64_t offset, const std::vector<Record>& records) {
+        if (!records.empty()) std::memcpy(out.data() + offset, records.data(), records.size() * sizeof(Record));
+    }
+
+    void addNode(const LayoutNode* node, uint32_t parent) {
+        NodeRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.parent = parent;
+        record.box = addBox(node->box());
+        record.font = addFont(node->fontMetrics());
+
+        const std::string& text = node->textContent();
+        record.textOffset = strings_.size();
+        record.textLength = static_cast<uint32_t>(text.size());
+        strings_ += text;
+
+        record.intrinsicSize[0] = node->intrinsicSize().width;
+        record.intrinsicSize[1] = node->intrinsicSize().height;
+        record.minSize[0] = node->minSize().width;
+        record.minSize[1] = node->minSize().height;
+        record.maxSize[0] = node->maxSize().width;
+        record.maxSize[1] = node->maxSize().height;
+        const Rect& rect = node->layoutRect();
+        record.layoutRect[0] = rect.x;
+        record.layoutRect[1] = rect.y;
+        record.layoutRect[2] = rect.width;
+        record.layoutRect[3] = rect.height;
+        record.lineHeight = node->lineHeight();
+        record.baseline = node->baseline();
+
+        uint32_t index = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back(record);
+        for (const LayoutNode* child : node->children()) {
+            addNode(child, index);
+        }
+    }
+
+    uint32_t addBox(const LayoutBox* box) {
+        LayoutBox defaults;
+        if (!box) box = &defaults;
+
+        BoxRecord record;
+        std::memset(&record, 0, sizeof(record));
+        putRect(record.contentRect, box->contentRect());
+        putInsets(record.padding, box->padding());
+        putInsets(record.border, box->border());
+        putInsets(record.margin, box->margin());
+        const Transform& transform = box->transform();
+        record.transform[0] = transform.m11;
+        record.transform[1] = transform.m12;
+        record.transform[2] = transform.m21;
+        record.transform[3] = transform.m22;
+        record.transform[4] = transform.dx;
+        record.transform[5] = transform.dy;
+        record.opacity = box->opacity();
+        putRect(record.clipRect, box->clipRect());
+        const InsetOffsets& insets = box->insets();
+        putInsets(record.insets, insets.values);
+        record.insetSides = static_cast<uint8_t>(insets.hasTop | insets.hasRight << 1 | insets.hasBottom << 2 |
+                                                 insets.hasLeft << 3);
+
+        const FlexStyle& flex = box->flexStyle();
+        record.flexRowGap = flex.rowGap;
+        record.flexColumnGap = flex.columnGap;
+        const FlexItemStyle& item = box->flexItemStyle();
+        record.flexGrow = item.grow;
+        record.flexShrink = item.shrink;
+        record.flexBasis = item.basis;
+
+        record.zIndex = box->zIndex();
+        record.gridTemplate = addTemplate(box->gridTemplate());
+        const GridPlacement& placement = box->gridPlacement();
+        record.gridPlacement[0] = placement.row;
+        record.gridPlacement[1] = placement.column;
+        record.gridPlacement[2] = placement.rowSpan;
+        record.gridPlacement[3] = placement.columnSpan;
+
+        record.boxSizing = static_cast<uint8_t>(box->boxSizing());
+        record.display = static_cast<uint8_t>(box->display());
+        record.position = static_cast<uint8_t>(box->position());
+        record.cssFloat = static_cast<uint8_t>(box->cssFloat());
+        record.clear = static_cast<uint8_t>(box->clear());
+        record.visibility = static_cast<uint8_t>(box->visibility());
+        record.overflow = static_cast<uint8_t>(box->overflow());
+        record.flags = (box->isReplaced() ? kReplaced : 0) | (box->isAnonymous() ? kAnonymous : 0) |
+                       (box->isRoot() ? kRoot : 0);
+        record.flexDirection = static_cast<uint8_t>(flex.direction);
+        record.flexWrap = static_cast<uint8_t>(flex.wrap);
+        record.justifyContent = static_cast<uint8_t>(flex.justifyContent);
+        record.alignItems = static_cast<uint8_t>(flex.alignItems);
+        record.alignContent = static_cast<uint8_t>(flex.alignContent);
+        record.alignSelf = static_cast<uint8_t>(item.alignSelf);
+        return boxes_.add(record);
+    }
+
+    uint32_t addFont(const FontMetrics& metrics) {
+        FontRecord record{metrics.ascent, metrics.descent, metrics.leading, metrics.xHeight, metrics.capHeight};
+        FontRecord defaults{0, 0, 0, 0, 0};
+        if (RecordEqual<FontRecord>()(record, defaults)) return kNone;
+        return fonts_.add(record);
+    }
+
+    uint32_t addTemplate(const GridTemplate& grid) {
+        // The default template is what boxes without one report
+        static const GridTemplate kDefault;
+        if (grid == kDefault) return kNone;
+        auto found = templateIndex_.find(&grid);
+        if (found != templateIndex_.end()) return found->second;
+
+        TemplateRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.firstColumn = static_cast<uint32_t>(tracks_.size());
+        record.columnCount = static_cast<uint32_t>(grid.columns.size());
+        addTracks(grid.columns);
+        record.firstRow = static_cast<uint32_t>(tracks_.size());
+        record.rowCount = static_cast<uint32_t>(grid.rows.size());
+        addTracks(grid.rows);
+        record.autoColumns = grid.autoColumns.value;
+        record.autoRows = grid.autoRows.value;
+        record.columnGap = grid.columnGap;
+        record.rowGap = grid.rowGap;
+        record.autoColumnsKind = static_cast<uint8_t>(grid.autoColumns.kind);
+        record.autoRowsKind = static_cast<uint8_t>(grid.autoRows.kind);
+        record.autoFlow = static_cast<uint8_t>(grid.autoFlow);
+
+        uint32_t index = static_cast<uint32_t>(templates_.size());
+        templates_.push_back(record);
+        templateIndex_.emplace(&grid, index);
+        return index;
+    }
+
+    void addTracks(const std::vector<GridTrackSize>& sizes) {
+        for (const GridTrackSize& size : sizes) {
+            TrackRecord record;
+            std::memset(&record, 0, sizeof(record));
+            record.value = size.value;
+            record.kind = static_cast<uint8_t>(size.kind);
+            tracks_.push_back(record);
+        }
+    }
+
+    static void putRect(double* out, const Rect& rect) {
+        out[0] = rect.x;
+        out[1] = rect.y;
+        out[2] = rect.width;
+        out[3] = rect.height;
+    }
+
+    static void putInsets(double* out, const EdgeInsets& insets) {
+        out[0] = insets.top;
+        out[1] = insets.right;
+        out[2] = insets.bottom;
+        out[3] = insets.left;
+    }
+};
+
+class CaptureReader {
+public:
+    CaptureReader(const uint8_t* data, size_t size, std::string& error)
+        : data_(data)
+        , size_(size)
+        , error_(error)
+        , header_() {
+    }
+
+    std::unique_ptr<LayoutTree> read() {
+        if (!data_ || size_ < sizeof(CaptureHeader)) return fail("truncated header");
+        std::memcpy(&header_, data_, sizeof(header_));
+        if (header_.magic == kSwappedMagic) return fail("captured on a machine of the other byte order");
+        if (header_.magic != kMagic) return fail("not a layout capture");
+        if (header_.version != kLayoutCaptureVersion) {
+            return fail("version " + std::to_string(header_.version) + ", expected " +
+                        std::to_string(kLayoutCaptureVersion));
+        }
+        if (header_.nodeCount == 0) return fail("no nodes");
+        if (!sectionFits(header_.nodesOffset, header_.nodeCount, sizeof(NodeRecord)) ||
+            !sectionFits(header_.boxesOffset, header_.boxCount, sizeof(BoxRecord)) ||
+            !sectionFits(header_.fontsOffset, header_.fontCount, sizeof(FontRecord)) ||
+            !sectionFits(header_.templatesOffset, header_.templateCount, sizeof(TemplateRecord)) ||
+            !sectionFits(header_.tracksOffset, header_.trackCount, sizeof(TrackRecord)) ||
+            !sectionFits(header_.stringsOffset, header_.stringBytes, 1)) {
+            return fail("section out of bounds");
+        }
+
+        if (!readTemplates()) return nullptr;
+        if (!readBoxes()) return nullptr;
+
+        auto tree = std::make_unique<LayoutTree>();
+        std::vector<LayoutNode*> nodes;
+        nodes.reserve(header_.nodeCount);
+        for (uint32_t i = 0; i < header_.nodeCount; ++i) {
+            NodeRecord record = recordAt<NodeRecord>(header_.nodesOffset, i);
+            if ((i == 0) != (record.parent == kNone) || (i > 0 && record.parent >= i)) {
+                return fail("node " + std::to_string(i) + " has a bad parent");
+            }
+            if (record.box >= boxes_.size()) return fail("node " + std::to_string(i) + " has a bad box");
+            if (record.font != kNone && record.font >= header_.fontCount) {
+                return fail("node " + std::to_string(i) + " has bad font metrics");
+            }
+            if (record.textOffset > header_.stringBytes || record.textLength > header_.stringBytes - record.textOffset) {
+                return fail("node " + std::to_string(i) + " has text out of bounds");
+            }
+
+            LayoutNode* node = tree->createNode(std::make_shared<LayoutBox>(boxes_[record.box]));
+            node->setIntrinsicSize(Size(record.intrinsicSize[0], record.intrinsicSize[1]));
+            node->setMinSize(Size(record.minSize[0], record.minSize[1]));
+            node->setMaxSize(Size(record.maxSize[0], record.maxSize[1]));
+            node->setLayoutRect(
+                Rect(record.layoutRect[0], record.layoutRect[1], record.layoutRect[2], record.layoutRect[3]));
+            node->setLineHeight(record.lineHeight);
+            node->setBaseline(record.baseline);
+            // Only nodes with text or fonts get cold data
+            if (record.textLength > 0) {
+                const char* text = reinterpret_cast<const char*>(data_ + header_.stringsOffset + record.textOffset);
+                node->setTextContent(std::string(text, record.textLength));
+            }
+            if (record.font != kNone) {
+                FontRecord font = recordAt<FontRecord>(header_.fontsOffset, record.font);
+                node->setFontMetrics(FontMetrics(font.ascent, font.descent, font.leading, font.xHeight, font.capHeight));
+            }
+
+            if (i == 0) {
+                tree->setRoot(node);
+            } else {
+                nodes[record.parent]->addChild(node);
+            }
+            nodes.push_back(node);
+        }
+        return tree;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    std::string& error_;
+    CaptureHeader header_;
+    std::vector<std::shared_ptr<const GridTemplate>> templates_;
+    std::vector<LayoutBox> boxes_;
+
+    std::unique_ptr<LayoutTree> fail(const std::string& message) {
+        error_ = message;
+        return nullptr;
+    }
+
+    bool sectionFits(uint64_t offset, uint64_t count, size_t recordSize) const {
+        if (offset > size_ || offset % (recordSize == 1 ? 1 : 8) != 0) return false;
+        return count <= (size_ - offset) / recordSize;
+    }
+
+    // memcpy, as buffers handed to deserializeLayoutTree need not be aligned
+    template <typename Record>
+    Record recordAt(uint64_t offset, uint32_t index) const {
+        Record record;
+        std::memcpy(&record, data_ + offset + static_cast<size_t>(index) * sizeof(Record), sizeof(Record));
+        return record;
+    }
+
+    bool readTemplates() {
+        templates_.reserve(header_.templateCount);
+        for (uint32_t i = 0; i < header_.templateCount; ++i) {
+            TemplateRecord record = recordAt<TemplateRecord>(header_.templatesOffset, i);
+            if (record.autoColumnsKind > kMaxTrackKind || record.autoRowsKind > kMaxTrackKind ||
+                record.autoFlow > kMaxAutoFlow) {
+                fail("grid template " + std::to_string(i) + " has a bad value");
+                return false;
+            }
+            auto grid = std::make_shared<GridTemplate>();
+            if (!readTracks(record.firstColumn, record.columnCount, grid->columns) ||
+                !readTracks(record.firstRow, record.rowCount, grid->rows)) {
+                fail("grid template " + std::to_string(i) + " has bad tracks");
+                return false;
+            }
+            grid->autoColumns = GridTrackSize{static_cast<GridTrackSize::Kind>(record.autoColumnsKind), record.autoColumns};
+            grid->autoRows = GridTrackSize{static_cast<GridTrackSize::Kind>(record.autoRowsKind), record.autoRows};
+            grid->autoFlow = static_cast<GridAutoFlow>(record.autoFlow);
+            grid->columnGap = record.columnGap;
+            grid->rowGap = record.rowGap;
+            templates_.push_back(std::move(grid));
+        }
+        return true;
+    }
+
+    bool readTracks(uint32_t first, uint32_t count, std::vector<GridTrackSize>& out) const {
+        if (first > header_.trackCount || count > header_.trackCount - first) return false;
+        out.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            TrackRecord record = recordAt<TrackRecord>(header_.tracksOffset, first + i);
+            if (record.kind > kMaxTrackKind) return false;
+            out.push_back(GridTrackSize{static_cast<GridTrackSize::Kind>(record.kind), record.value});
+        }
+        return true;
+    }
+
+    bool readBoxes() {
+        boxes_.reserve(header_.boxCount);
+        for (uint32_t i = 0; i < header_.boxCount; ++i) {
+            BoxRecord record = recordAt<BoxRecord>(header_.boxesOffset, i);
+            if (record.display > kMaxDisplay || record.position > kMaxPosition || record.cssFloat > kMaxFloat ||
+                record.clear > kMaxClear || record.boxSizing > kMaxBoxSizing || record.visibility > kMaxVisibility ||
+                record.overflow > kMaxOverflow || record.flexDirection > kMaxFlexDirection ||
+                record.flexWrap > kMaxFlexWrap || record.justifyContent > kMaxJustifyContent ||
+                record.alignItems > kMaxAlignItems || record.alignContent > kMaxAlignContent ||
+                record.alignSelf > kMaxAlignSelf ||
+                (record.gridTemplate != kNone && record.gridTemplate >= templates_.size())) {
+                fail("box " + std::to_string(i) + " has a bad value");
+                return false;
+            }
+
+            LayoutBox box;
+            box.setContentRect(rectAt(record.contentRect));
+            box.setPadding(insetsAt(record.padding));
+            box.setBorder(insetsAt(record.border));
+            box.setMargin(insetsAt(record.margin));
+            box.setBoxSizing(static_cast<BoxSizing>(record.boxSizing));
+            box.setDisplay(static_cast<Display>(record.display));
+            box.setPosition(static_cast<Position>(record.position));
+            box.setFloat(static_cast<Float>(record.cssFloat));
+            box.setClear(static_cast<Clear>(record.clear));
+            box.setZIndex(record.zIndex);
+            box.setTransform(Transform(record.transform[0], record.transform[1], record.transform[2],
+                                       record.transform[3], record.transform[4], record.transform[5]));
+            box.setOpacity(record.opacity);
+            box.setVisibility(static_cast<Visibility>(record.visibility));
+            box.setOverflow(static_cast<Overflow>(record.overflow));
+            box.setClipRect(rectAt(record.clipRect));
+            InsetOffsets insets;
+            insets.values = insetsAt(record.insets);
+            insets.hasTop = record.insetSides & 1;
+            insets.hasRight = record.insetSides & 2;
+            insets.hasBottom = record.insetSides & 4;
+            insets.hasLeft = record.insetSides & 8;
+            box.setInsets(insets);
+            if (record.gridTemplate != kNone) box.setGridTemplate(templates_[record.gridTemplate]);
+
+            GridPlacement placement;
+            placement.row = record.gridPlacement[0];
+            placement.column = record.gridPlacement[1];
+            placement.rowSpan = record.gridPlacement[2];
+            placement.columnSpan = record.gridPlacement[3];
+            box.setGridPlacement(placement);
+
+            FlexStyle flex;
+            flex.direction = static_cast<FlexDirection>(record.flexDirection);
+            flex.wrap = static_cast<FlexWrap>(record.flexWrap);
+            flex.justifyContent = static_cast<JustifyContent>(record.justifyContent);
+            flex.alignItems = static_cast<AlignItems>(record.alignItems);
+            flex.alignContent = static_cast<AlignContent>(record.alignContent);
+            flex.rowGap = record.flexRowGap;
+            flex.columnGap = record.flexColumnGap;
+            box.setFlexStyle(flex);
+
+            FlexItemStyle item;
+            item.grow = record.flexGrow;
+            item.shrink = record.flexShrink;
+            item.basis = record.flexBasis;
+            item.alignSelf = static_cast<AlignSelf>(record.alignSelf);
+            box.setFlexItemStyle(item);
+
+            box.setIsReplaced((record.flags & kReplaced) != 0);
+            box.setIsAnonymous((record.flags & kAnonymous) != 0);
+            box.setIsRoot((record.flags & kRoot) != 0);
+            boxes_.push_back(std::move(box));
+        }
+        return true;
+    }
+
+    static Rect rectAt(const double* values) { return Rect(values[0], values[1], values[2], values[3]); }
+    static EdgeInsets insetsAt(const double* values) { return EdgeInsets(values[0], values[1], values[2], values[3]); }
+};
+
+} // namespace
+
+std::vector<uint8_t> serializeLayoutTree(const LayoutTree& tree) {
+    if (!tree.root()) return {};
+    CaptureWriter writer;
+    writer.addTree(tree);
+    return writer.finish();
+}
+
+std::unique_ptr<LayoutTree> deserializeLayoutTree(const uint8_t* data, size_t size, std::string& error) {
+    return CaptureReader(data, size, error).read();
+}
+
+bool saveLayoutTree(const LayoutTree& tree, const std::string& path, std::string& error) {
+    std::vector<uint8_t> data = serializeLayoutTree(tree);
+    if (data.empty()) {
+        error = "tree has no root";
+        return false;
+    }
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            error = "cannot write " + temporary;
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "cannot rename " + temporary + " to " + path;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<LayoutTree> loadLayoutTree(const std::string& path, std::string& error) {
+    apollo::MappedFile file(path);
+    if (!file.data()) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    return deserializeLayoutTree(file.data(), file.size(), error);
+}
+
+bool isLayoutCapture(const uint8_t* data, size_t size) {
+    if (!data || size < sizeof(uint32_t)) return false;
+    uint32_t magic;
+    std::memcpy(&magic, data, sizeof(magic));
+    return magic == kMagic || magic == kSwappedMagic;
+}
+
+bool isLayoutCaptureFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    uint8_t magic[4];
+    if (!in.read(reinterpret_cast<char*>(magic), sizeof(magic))) return false;
+    return isLayoutCapture(magic, sizeof(magic));
+}
+
+} // namespace layout
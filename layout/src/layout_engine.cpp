@@ -9,33 +9,87 @@
 namespace layout {
 
 // LayoutEngine implementation
-LayoutEngine::LayoutEngine() : viewport_(0, 0, 1024, 768) {
+namespace {
+
+// Anchoring passes before a layout settles; each replaces the estimates
+// that moved the anchor in the previous one
+constexpr int kMaxAnchorPasses = 4;
+
+} // namespace
+
+LayoutEngine::LayoutEngine()
+    : viewport_(0, 0, 1024, 768)
+    , lazyLayout_(false)
+    , lazyLayoutDistance_(1) {
 }
 
 LayoutEngine::~LayoutEngine() = default;
 
 void LayoutEngine::setTree(std::unique_ptr<LayoutTree> tree) {
     tree_ = std::move(tree);
+    hitTestIndex_.reset();
+    if (tree_) {
+        tree_->setTaskPool(taskPool_.get());
+    }
+}
+
+size_t LayoutEngine::workerCount() const {
+    return taskPool_ ? taskPool_->workerCount() : 0;
+}
+
+void LayoutEngine::setWorkerCount(size_t count) {
+    if (count == workerCount()) return;
+    
+    // The old pool is idle between layouts, so it can simply be replaced
+    taskPool_ = count > 0 ? std::make_unique<TaskPool>(count) : nullptr;
+    if (tree_) {
+        tree_->setTaskPool(taskPool_.get());
+    }
+}
+
+void LayoutEngine::setLazyLayout(bool enabled) {
+    if (enabled == lazyLayout_) return;
+    
+    // The root's children are positioned differently in the two modes
+    lazyLayout_ = enabled;
+    if (tree_ && tree_->root()) {
+        tree_->root()->markNeedsLayout();
+    }
+}
+
+void LayoutEngine::scrollTo(const Point& position) {
+    viewport_ = Rect(position, viewport_.size());
+    if (lazyLayout_) {
+        updateLayout();
+    }
 }
 
 void LayoutEngine::layout() {
     if (!tree_ || !tree_->root()) return;
     
-    // Create layout constraints based on viewport
-    LayoutConstraints constraints(
-        Size(0, 0),
-        Size(viewport_.width, viewport_.height)
-    );
-    
     // Layout the entire tree
-    tree_->layout(constraints);
+    if (lazyLayout_) {
+        layoutNearViewport();
+    } else {
+        tree_->layout(viewportConstraints());
+    }
+    hitTestIndex_.invalidate();
 }
 
 void LayoutEngine::updateLayout() {
-    if (!tree_) return;
+    if (!tree_ || !tree_->root()) return;
+    
+    if (lazyLayout_) {
+        layoutNearViewport();
+        hitTestIndex_.invalidate();
+        return;
+    }
     
-    // Update layout for dirty nodes only
-    tree_->updateLayout();
+    // Nodes skip themselves unless they are dirty or their constraints
+    // changed, so this only walks the dirty paths and whatever a viewport
+    // resize reached
+    tree_->layout(viewportConstraints());
+    hitTestIndex_.invalidate();
 }
 
 void LayoutEngine::invalidateLayout() {
@@ -45,10 +99,67 @@ void LayoutEngine::invalidateLayout() {
     tree_->invalidateLayout();
 }
 
+void LayoutEngine::invalidateLayout(LayoutNode* node) {
+    if (!tree_) return;
+    
+    // Only the node and its ancestors up to a layout boundary are redone
+    tree_->invalidateNode(node);
+}
+
 LayoutNode* LayoutEngine::hitTest(const Point& point) const {
     if (!tree_ || !tree_->root()) return nullptr;
     
-    return tree_->root()->hitTest(point);
+    hitTestIndex_.update(*tree_);
+    return hitTestIndex_.hitTest(point);
+}
+
+std::vector<LayoutNode*> LayoutEngine::hitTest(const std::vector<Point>& points) const {
+    std::vector<LayoutNode*> results(points.size(), nullptr);
+    if (!tree_ || !tree_->root()) return results;
+    
+    hitTestIndex_.update(*tree_);
+    for (size_t i = 0; i < points.size(); ++i) {
+        results[i] = hitTestIndex_.hitTest(points[i]);
+    }
+    return results;
+}
+
+const std::vector<PaintItem>& LayoutEngine::paintItems() const {
+    static const std::vector<PaintItem> empty;
+    if (!tree_) return empty;
+    return tree_->paintOrder().items();
+}
+
+void LayoutEngine::layoutNearViewport() {
+    LayoutNode* root = tree_->root();
+    LayoutConstraints constraints = viewportConstraints();
+    double margin = viewport_.height * lazyLayoutDistance_;
+    
+    for (int pass = 0; pass < kMaxAnchorPasses; ++pass) {
+        LayoutNode* anchor = scrollAnchor();
+        double anchorTop = anchor ? anchor->layoutRect().y : 0;
+        
+        root->layoutRange(constraints, viewport_.y - margin, viewport_.bottom() + margin);
+        
+        // Boxes above the anchor got their real sizes; follow it, then lay
+        // out whatever the move brought into range
+        double shift = anchor ? anchor->layoutRect().y - anchorTop : 0;
+        if (shift == 0) break;
+        viewport_.y += shift;
+    }
+}
+
+LayoutNode* LayoutEngine::scrollAnchor() const {
+    for (auto* child : tree_->root()->children()) {
+        if (!child->hasLayoutConstraints() || child->hasEstimatedLayout()) continue;
+        if (child->layoutRect().bottom() > viewport_.y) return child;
+    }
+    return nullptr;
+}
+
+// Layout constraints based on the viewport
+LayoutConstraints LayoutEngine::viewportConstraints() const {
+    return LayoutConstraints(Size(0, 0), Size(viewport_.width, viewport_.height));
 }
 
 Rect LayoutEngine::getLayoutBounds() const {
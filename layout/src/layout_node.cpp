@@ -1,4 +1,9 @@
 #include "layout/layout_node.h"
+#include "layout/layout_snapshot.h"
+#include "layout/layout_trace.h"
+#include "layout/stacking_context.h"
+#include "layout/task_pool.h"
+#include "layout/text_run_cache.h"
 #include <algorithm>
 #include <limits>
 
@@ -13,9 +18,21 @@ LayoutNode::LayoutNode()
     , maxSize_(std::numeric_limits<double>::max(), std::numeric_limits<double>::max())
     , isLayoutDirty_(true)
     , needsLayout_(true)
+    , childNeedsLayout_(false)
+    , hasLayoutConstraints_(false)
+    , hasEstimatedLayout_(false)
+    , lastConstraints_()
     , lineHeight_(0)
     , baseline_(0)
-    , parent_(nullptr) {
+    , arena_(nullptr)
+    , index_(kInvalidNodeIndex)
+    , parent_(kInvalidNodeIndex)
+    , firstChild_(kInvalidNodeIndex)
+    , lastChild_(kInvalidNodeIndex)
+    , nextSibling_(kInvalidNodeIndex)
+    , previousSibling_(kInvalidNodeIndex)
+    , childCount_(0)
+    , cold_(nullptr) {
 }
 
 LayoutNode::LayoutNode(std::shared_ptr<LayoutBox> box)
@@ -26,14 +43,25 @@ LayoutNode::LayoutNode(std::shared_ptr<LayoutBox> box)
     , maxSize_(std::numeric_limits<double>::max(), std::numeric_limits<double>::max())
     , isLayoutDirty_(true)
     , needsLayout_(true)
+    , childNeedsLayout_(false)
+    , hasLayoutConstraints_(false)
+    , hasEstimatedLayout_(false)
+    , lastConstraints_()
     , lineHeight_(0)
     , baseline_(0)
-    , parent_(nullptr) {
+    , arena_(nullptr)
+    , index_(kInvalidNodeIndex)
+    , parent_(kInvalidNodeIndex)
+    , firstChild_(kInvalidNodeIndex)
+    , lastChild_(kInvalidNodeIndex)
+    , nextSibling_(kInvalidNodeIndex)
+    , previousSibling_(kInvalidNodeIndex)
+    , childCount_(0)
+    , cold_(nullptr) {
 }
 
-LayoutNode::~LayoutNode() {
-    clearChildren();
-}
+// The arena unlinks a node before destroying it
+LayoutNode::~LayoutNode() = default;
 
 bool LayoutNode::isPositioned() const {
     return box_ && box_->isPositioned();
@@ -52,78 +80,89 @@ bool LayoutNode::isInlineLevel() const {
 }
 
 void LayoutNode::addChild(LayoutNode* child) {
-    if (child && child != this) {
-        child->setParent(this);
-        children_.push_back(child);
+    if (child && child != this && arena_ && child->arena_ == arena_) {
+        if (child->parent()) {
+            child->parent()->removeChild(child);
+        }
+        linkChild(child, nullptr);
+        markNeedsLayout();
     }
 }
 
 void LayoutNode::insertChild(LayoutNode* child, size_t index) {
-    if (child && child != this && index <= children_.size()) {
-        child->setParent(this);
-        children_.insert(children_.begin() + index, child);
+    if (child && child != this && arena_ && child->arena_ == arena_ && index <= childCount_) {
+        LayoutNode* before = childAt(index);
+        if (before == child) {
+            before = child->nextSibling();
+        }
+        if (child->parent()) {
+            child->parent()->removeChild(child);
+        }
+        linkChild(child, before);
+        markNeedsLayout();
     }
 }
 
 void LayoutNode::removeChild(LayoutNode* child) {
-    auto it = std::find(children_.begin(), children_.end(), child);
-    if (it != children_.end()) {
-        (*it)->setParent(nullptr);
-        children_.erase(it);
+    if (child && arena_ && child->arena_ == arena_ && child->parent_ == index_) {
+        unlinkChild(child);
+        markNeedsLayout();
     }
 }
 
 void LayoutNode::removeChildAt(size_t index) {
-    if (index < children_.size()) {
-        children_[index]->setParent(nullptr);
-        children_.erase(children_.begin() + index);
-    }
+    removeChild(childAt(index));
 }
 
 void LayoutNode::clearChildren() {
-    for (auto* child : children_) {
-        child->setParent(nullptr);
+    LayoutNode* child = firstChild();
+    while (child) {
+        LayoutNode* next = child->nextSibling();
+        child->parent_ = kInvalidNodeIndex;
+        child->nextSibling_ = kInvalidNodeIndex;
+        child->previousSibling_ = kInvalidNodeIndex;
+        child = next;
+    }
+    firstChild_ = kInvalidNodeIndex;
+    lastChild_ = kInvalidNodeIndex;
+    childCount_ = 0;
+    if (arena_) {
+        arena_->noteStructureChange();
     }
-    children_.clear();
 }
 
 LayoutNode* LayoutNode::childAt(size_t index) const {
-    return (index < children_.size()) ? children_[index] : nullptr;
+    if (index >= childCount_) return nullptr;
+
+    LayoutNode* child = firstChild();
+    while (index-- > 0) {
+        child = child->nextSibling();
+    }
+    return child;
 }
 
 LayoutNode* LayoutNode::firstChild() const {
-    return children_.empty() ? nullptr : children_.front();
+    return nodeAt(firstChild_);
 }
 
 LayoutNode* LayoutNode::lastChild() const {
-    return children_.empty() ? nullptr : children_.back();
+    return nodeAt(lastChild_);
 }
 
 LayoutNode* LayoutNode::nextSibling() const {
-    if (!parent_) return nullptr;
-    
-    auto it = std::find(parent_->children_.begin(), parent_->children_.end(), this);
-    if (it != parent_->children_.end() && ++it != parent_->children_.end()) {
-        return *it;
-    }
-    return nullptr;
+    return nodeAt(nextSibling_);
 }
 
 LayoutNode* LayoutNode::previousSibling() const {
-    if (!parent_) return nullptr;
-    
-    auto it = std::find(parent_->children_.begin(), parent_->children_.end(), this);
-    if (it != parent_->children_.begin()) {
-        return *(--it);
-    }
-    return nullptr;
+    return nodeAt(previousSibling_);
 }
 
 size_t LayoutNode::indexInParent() const {
-    if (!parent_) return 0;
-    
-    auto it = std::find(parent_->children_.begin(), parent_->children_.end(), this);
-    return (it != parent_->children_.end()) ? std::distance(parent_->children_.begin(), it) : 0;
+    size_t index = 0;
+    for (LayoutNode* sibling = previousSibling(); sibling; sibling = sibling->previousSibling()) {
+        ++index;
+    }
+    return index;
 }
 
 LayoutNode* LayoutNode::findChild(size_t index) const {
@@ -132,19 +171,19 @@ LayoutNode* LayoutNode::findChild(size_t index) const {
 
 size_t LayoutNode::depth() const {
     size_t depth = 0;
-    LayoutNode* current = parent_;
+    LayoutNode* current = parent();
     while (current) {
         ++depth;
-        current = current->parent_;
+        current = current->parent();
     }
     return depth;
 }
 
 size_t LayoutNode::height() const {
-    if (children_.empty()) return 0;
+    if (isLeaf()) return 0;
     
     size_t maxChildHeight = 0;
-    for (auto* child : children_) {
+    for (auto* child : children()) {
         maxChildHeight = std::max(maxChildHeight, child->height());
     }
     return maxChildHeight + 1;
@@ -152,25 +191,25 @@ size_t LayoutNode::height() const {
 
 std::vector<LayoutNode*> LayoutNode::getAllDescendants() const {
     std::vector<LayoutNode*> descendants;
-    collectDescendants(const_cast<LayoutNode*>(this), descendants);
+    collectDescendants(this, descendants);
     return descendants;
 }
 
 std::vector<LayoutNode*> LayoutNode::getAllAncestors() const {
     std::vector<LayoutNode*> ancestors;
-    LayoutNode* current = parent_;
+    LayoutNode* current = parent();
     while (current) {
         ancestors.push_back(current);
-        current = current->parent_;
+        current = current->parent();
     }
     return ancestors;
 }
 
 std::vector<LayoutNode*> LayoutNode::getSiblings() const {
-    if (!parent_) return {};
+    if (isRoot()) return {};
     
     std::vector<LayoutNode*> siblings;
-    for (auto* child : parent_->children_) {
+    for (auto* child : parent()->children()) {
         if (child != this) {
             siblings.push_back(child);
         }
@@ -179,23 +218,21 @@ std::vector<LayoutNode*> LayoutNode::getSiblings() const {
 }
 
 std::vector<LayoutNode*> LayoutNode::getPreviousSiblings() const {
-    if (!parent_) return {};
+    if (isRoot()) return {};
     
     std::vector<LayoutNode*> siblings;
-    size_t index = indexInParent();
-    for (size_t i = 0; i < index; ++i) {
-        siblings.push_back(parent_->children_[i]);
+    for (LayoutNode* sibling = parent()->firstChild(); sibling && sibling != this; sibling = sibling->nextSibling()) {
+        siblings.push_back(sibling);
     }
     return siblings;
 }
 
 std::vector<LayoutNode*> LayoutNode::getNextSiblings() const {
-    if (!parent_) return {};
+    if (isRoot()) return {};
     
     std::vector<LayoutNode*> siblings;
-    size_t index = indexInParent();
-    for (size_t i = index + 1; i < parent_->children_.size(); ++i) {
-        siblings.push_back(parent_->children_[i]);
+    for (LayoutNode* sibling = nextSibling(); sibling; sibling = sibling->nextSibling()) {
+        siblings.push_back(sibling);
     }
     return siblings;
 }
@@ -219,7 +256,7 @@ std::vector<LayoutNode*> LayoutNode::getPathToRoot() const {
     LayoutNode* current = const_cast<LayoutNode*>(this);
     while (current) {
         path.push_back(current);
-        current = current->parent_;
+        current = current->parent();
     }
     return path;
 }
@@ -229,7 +266,7 @@ std::vector<LayoutNode*> LayoutNode::getPathToAncestor(LayoutNode* ancestor) con
     LayoutNode* current = const_cast<LayoutNode*>(this);
     while (current && current != ancestor) {
         path.push_back(current);
-        current = current->parent_;
+        current = current->parent();
     }
     if (current == ancestor) {
         path.push_back(current);
@@ -240,10 +277,10 @@ std::vector<LayoutNode*> LayoutNode::getPathToAncestor(LayoutNode* ancestor) con
 bool LayoutNode::isAncestorOf(LayoutNode* node) const {
     if (!node) return false;
     
-    LayoutNode* current = node->parent_;
+    LayoutNode* current = node->parent();
     while (current) {
         if (current == this) return true;
-        current = current->parent_;
+        current = current->parent();
     }
     return false;
 }
@@ -253,11 +290,19 @@ bool LayoutNode::isDescendantOf(LayoutNode* node) const {
 }
 
 bool LayoutNode::isSiblingOf(LayoutNode* node) const {
-    return node && parent_ && parent_ == node->parent_;
+    return node && !isRoot() && arena_ == node->arena_ && parent_ == node->parent_;
 }
 
 void LayoutNode::layout(const LayoutConstraints& constraints) {
-    if (!needsLayout_) return;
+    // A clean node keeps its result for the constraints it was laid out
+    // with; only the dirty paths below it are revisited
+    if (!needsLayout_ && hasLayoutConstraints_ && constraints == lastConstraints_) {
+        if (childNeedsLayout_) {
+            layoutDirtyChildren();
+            childNeedsLayout_ = false;
+        }
+        return;
+    }
     
     // Calculate intrinsic size
     intrinsicSize_ = calculateIntrinsicSize();
@@ -276,20 +321,87 @@ void LayoutNode::layout(const LayoutConstraints& constraints) {
     layoutChildren(constraints);
     
     // Mark as not needing layout
+    lastConstraints_ = constraints;
+    hasLayoutConstraints_ = true;
+    hasEstimatedLayout_ = false;
     needsLayout_ = false;
     isLayoutDirty_ = false;
+    childNeedsLayout_ = false;
 }
 
 void LayoutNode::layoutChildren(const LayoutConstraints& constraints) {
-    for (auto* child : children_) {
-        if (child) {
+    // Independent subtrees fan out to the pool; the rest stay on this thread
+    TaskGroup group(tree() ? tree()->taskPool() : nullptr);
+    for (auto* child : children()) {
+        if (!child) continue;
+        
+        if (child->isIndependentFormattingContext()) {
+            group.run([child, constraints] { child->layout(constraints); });
+        } else {
             child->layout(constraints);
         }
     }
+    group.wait();
+}
+
+void LayoutNode::layoutDirtyChildren() {
+    TaskGroup group(tree() ? tree()->taskPool() : nullptr);
+    for (auto* child : children()) {
+        if (!child || !(child->needsLayout_ || child->childNeedsLayout_)) continue;
+        
+        // A child layoutRange() never reached gets what layoutChildren() would pass
+        LayoutConstraints constraints = child->hasLayoutConstraints_ ? child->lastConstraints_ : lastConstraints_;
+        if (child->isIndependentFormattingContext()) {
+            group.run([child, constraints] { child->layout(constraints); });
+        } else {
+            child->layout(constraints);
+        }
+    }
+    group.wait();
+}
+
+void LayoutNode::layoutRange(const LayoutConstraints& constraints, double top, double bottom) {
+    if (needsLayout_ || !hasLayoutConstraints_ || constraints != lastConstraints_) {
+        intrinsicSize_ = calculateIntrinsicSize();
+        minSize_ = calculateMinSize();
+        maxSize_ = calculateMaxSize();
+        Size constrainedSize = constraints.constrain(intrinsicSize_);
+        layoutRect_ = Rect(0, 0, constrainedSize.width, constrainedSize.height);
+        
+        lastConstraints_ = constraints;
+        hasLayoutConstraints_ = true;
+        hasEstimatedLayout_ = false;
+        needsLayout_ = false;
+        isLayoutDirty_ = false;
+    }
+    
+    // Offsets come from the sizes known so far, real or estimated, so the
+    // range is decided child by child as the stack grows
+    bool deferred = false;
+    double offset = 0;
+    for (auto* child : children()) {
+        if (!child->hasLayoutConstraints_ && !child->hasEstimatedLayout_) {
+            Size estimate = constraints.constrain(child->calculateIntrinsicSize());
+            child->layoutRect_ = Rect(0, 0, estimate.width, estimate.height);
+            child->hasEstimatedLayout_ = true;
+        }
+        
+        if (offset < bottom && offset + child->layoutRect_.height >= top) {
+            child->layout(constraints);
+        } else if (child->needsLayout_ || child->childNeedsLayout_ || !child->hasLayoutConstraints_ ||
+                   child->lastConstraints_ != constraints) {
+            child->hasEstimatedLayout_ = true;
+            deferred = true;
+        }
+        
+        child->updatePosition(Point(child->layoutRect_.x, offset));
+        offset += child->layoutRect_.height;
+    }
+    childNeedsLayout_ = deferred;
 }
 
 void LayoutNode::layoutPositionedChildren() {
-    for (auto* child : children_) {
+    for (auto* child : children()) {
         if (child && child->isPositioned()) {
             // Layout positioned child
             // This would be implemented by the positioned layout algorithm
@@ -298,7 +410,7 @@ void LayoutNode::layoutPositionedChildren() {
 }
 
 void LayoutNode::layoutFloatingChildren() {
-    for (auto* child : children_) {
+    for (auto* child : children()) {
         if (child && child->isFloating()) {
             // Layout floating child
             // This would be implemented by the block layout algorithm
@@ -359,25 +471,81 @@ void LayoutNode::collapseMarginsWithChildren() {
 }
 
 void LayoutNode::addFloat(LayoutNode* floatNode) {
-    if (floatNode && floatNode->isFloating()) {
-        floats_.push_back(floatNode);
-    }
+    if (!floatNode || !floatNode->isFloating()) return;
+
+    ColdData& cold = mutableColdData();
+    cold.floats.push_back(floatNode);
+    cold.exclusionSpace.addExclusion(floatNode->floatMarginBox(this), floatNode->box_->cssFloat());
 }
 
 void LayoutNode::removeFloat(LayoutNode* floatNode) {
-    auto it = std::find(floats_.begin(), floats_.end(), floatNode);
-    if (it != floats_.end()) {
-        floats_.erase(it);
+    if (!cold_) return;
+
+    auto& floats = cold_->floats;
+    auto it = std::find(floats.begin(), floats.end(), floatNode);
+    if (it != floats.end()) {
+        floats.erase(it);
+        rebuildExclusionSpace();
+    }
+}
+
+void LayoutNode::removeFloatsOf(const LayoutNode* container) {
+    if (!cold_ || cold_->floats.empty()) return;
+
+    auto& floats = cold_->floats;
+    auto end = std::remove_if(floats.begin(), floats.end(),
+                              [container](const LayoutNode* floatNode) { return floatNode->parent() == container; });
+    if (end != floats.end()) {
+        floats.erase(end, floats.end());
+        rebuildExclusionSpace();
     }
 }
 
 void LayoutNode::clearFloats() {
-    floats_.clear();
+    if (cold_) {
+        cold_->floats.clear();
+        cold_->exclusionSpace.clear();
+    }
 }
 
 void LayoutNode::clearFloats(Clear clear) {
-    // Simplified clear implementation
-    clearFloats();
+    if (!cold_ || clear == Clear::None) return;
+    if (clear == Clear::Both) {
+        clearFloats();
+        return;
+    }
+
+    Float side = clear == Clear::Left ? Float::Left : Float::Right;
+    auto& floats = cold_->floats;
+    floats.erase(std::remove_if(floats.begin(), floats.end(),
+                                [side](const LayoutNode* floatNode) { return floatNode->box_->cssFloat() == side; }),
+                 floats.end());
+    rebuildExclusionSpace();
+}
+
+Rect LayoutNode::floatMarginBox(const LayoutNode* root) const {
+    Point offset = offsetFrom(root);
+    if (!box_) return Rect(offset, layoutRect_.size());
+
+    const EdgeInsets& margin = box_->margin();
+    return Rect(offset.x - margin.left, offset.y - margin.top,
+                layoutRect_.width + margin.horizontal(), layoutRect_.height + margin.vertical());
+}
+
+void LayoutNode::rebuildExclusionSpace() {
+    ExclusionSpace& space = cold_->exclusionSpace;
+    space.clear();
+    for (const auto* floatNode : cold_->floats) {
+        space.addExclusion(floatNode->floatMarginBox(this), floatNode->box_->cssFloat());
+    }
+}
+
+GridTrackCache& LayoutNode::gridTrackCache() {
+    ColdData& cold = mutableColdData();
+    if (!cold.gridTracks) {
+        cold.gridTracks = std::make_unique<GridTrackCache>();
+    }
+    return *cold.gridTracks;
 }
 
 void LayoutNode::createStackingContext() {
@@ -393,10 +561,8 @@ bool LayoutNode::isStackingContext() const {
 }
 
 LayoutNode* LayoutNode::getContainingBlock() const {
-    if (!parent_) return nullptr;
-    
     // Simplified containing block calculation
-    return parent_;
+    return parent();
 }
 
 bool LayoutNode::isContainingBlock() const {
@@ -404,16 +570,36 @@ bool LayoutNode::isContainingBlock() const {
 }
 
 LayoutNode* LayoutNode::getFormattingContextRoot() const {
-    if (!parent_) return this;
-    
-    // Simplified formatting context root calculation
-    return parent_->getFormattingContextRoot();
+    const LayoutNode* node = this;
+    while (!node->isRoot() && !node->isFormattingContextRoot() && !node->isIndependentFormattingContext()) {
+        node = node->parent();
+    }
+    return const_cast<LayoutNode*>(node);
 }
 
 bool LayoutNode::isFormattingContextRoot() const {
     return box_ && box_->isFormattingContextRoot();
 }
 
+Point LayoutNode::offsetFrom(const LayoutNode* ancestor) const {
+    Point offset(0, 0);
+    for (const LayoutNode* node = this; node && node != ancestor; node = node->parent()) {
+        offset.x += node->layoutRect_.x;
+        offset.y += node->layoutRect_.y;
+    }
+    return offset;
+}
+
+bool LayoutNode::isIndependentFormattingContext() const {
+    // A leaf is cheaper to lay out than to hand to another thread
+    if (isLeaf() || !box_) return false;
+    if (box_->isFormattingContextRoot()) return true;
+    
+    const LayoutNode* container = parent();
+    return container && container->box_ &&
+           (container->box_->isFlexContainer() || container->box_->isGridContainer());
+}
+
 void LayoutNode::layoutText() {
     // Simplified text layout
 }
@@ -451,8 +637,8 @@ void LayoutNode::wrapBlockWords() {
 }
 
 Size LayoutNode::measureText(const std::string& text) const {
-    // Simplified text measurement
-    return Size(text.length() * 10, 20); // Approximate size
+    // Same cached word widths as TextLayout
+    return Size(TextRunCache::shared().measureWidth(fontMetrics(), text), 20);
 }
 
 double LayoutNode::measureTextWidth(const std::string& text) const {
@@ -467,8 +653,8 @@ LayoutNode* LayoutNode::hitTest(const Point& point) const {
     if (!containsPoint(point)) return nullptr;
     
     // Test children in reverse order (top to bottom)
-    for (auto it = children_.rbegin(); it != children_.rend(); ++it) {
-        LayoutNode* result = (*it)->hitTest(point);
+    for (LayoutNode* child = lastChild(); child; child = child->previousSibling()) {
+        LayoutNode* result = child->hitTest(point);
         if (result) return result;
     }
     
@@ -552,16 +738,65 @@ void LayoutNode::clipContent() {
 }
 
 void LayoutNode::scrollContent(const Point& offset) {
-    // Simplified content scrolling
+    Size extent = scrollExtent();
+    Point clamped(std::clamp(offset.x, 0.0, extent.width), std::clamp(offset.y, 0.0, extent.height));
+    if (clamped == scrollOffset()) return;
+    mutableColdData().scrollOffset = clamped;
 }
 
-void LayoutNode::invalidateLayout() {
+Size LayoutNode::scrollExtent() const {
+    Rect content(0, 0, layoutRect_.width, layoutRect_.height);
+    for (LayoutNode* child : children()) {
+        content = content.unionRect(child->layoutRect());
+    }
+    return Size(std::max(0.0, content.right() - layoutRect_.width),
+                std::max(0.0, content.bottom() - layoutRect_.height));
+}
+
+bool LayoutNode::isLayoutBoundary() const {
+    if (isRoot()) return true;
+    if (hasLayoutConstraints_ && lastConstraints_.isTight()) return true;
+    return box_ && (box_->position() == Position::Absolute || box_->position() == Position::Fixed);
+}
+
+void LayoutNode::markNeedsLayout() {
     needsLayout_ = true;
     isLayoutDirty_ = true;
+    clearMeasurementCache();
+
+    // Ancestors whose size can depend on the dirty node need layout too.
+    // The walk goes on past ancestors that are already dirty, since they
+    // may have been measured again since they were marked.
+    LayoutNode* node = this;
+    while (node->parent() && !node->isLayoutBoundary()) {
+        node = node->parent();
+        node->needsLayout_ = true;
+        node->isLayoutDirty_ = true;
+        node->clearMeasurementCache();
+    }
+
+    // Above the boundary they only have to find their way down to it
+    for (LayoutNode* ancestor = node->parent(); ancestor && !ancestor->childNeedsLayout_; ancestor = ancestor->parent()) {
+        ancestor->childNeedsLayout_ = true;
+    }
+}
+
+void LayoutNode::markNeedsPaintOrder() {
+    LayoutTree* owner = tree();
+    if (owner && owner->paintOrder_) {
+        owner->paintOrder_->invalidate(this);
+    }
+    if (owner) {
+        owner->noteContentChange();
+    }
+}
+
+void LayoutNode::invalidateLayout() {
+    markNeedsLayout();
 }
 
 void LayoutNode::invalidateChildren() {
-    for (auto* child : children_) {
+    for (auto* child : children()) {
         if (child) {
             child->invalidateLayout();
         }
@@ -569,24 +804,28 @@ void LayoutNode::invalidateChildren() {
 }
 
 void LayoutNode::invalidateParent() {
-    if (parent_) {
-        parent_->invalidateLayout();
+    if (parent()) {
+        parent()->invalidateLayout();
     }
 }
 
 void LayoutNode::invalidateAll() {
     invalidateLayout();
-    invalidateChildren();
+    for (auto* child : children()) {
+        if (child) {
+            child->invalidateAll();
+        }
+    }
 }
 
 void LayoutNode::updateLayout() {
-    if (needsLayout_) {
-        layout(LayoutConstraints());
+    if (needsLayout_ || childNeedsLayout_) {
+        layout(hasLayoutConstraints_ ? lastConstraints_ : LayoutConstraints());
     }
 }
 
 void LayoutNode::updateChildren() {
-    for (auto* child : children_) {
+    for (auto* child : children()) {
         if (child) {
             child->updateLayout();
         }
@@ -594,54 +833,74 @@ void LayoutNode::updateChildren() {
 }
 
 void LayoutNode::updateParent() {
-    if (parent_) {
-        parent_->updateLayout();
+    if (parent()) {
+        parent()->updateLayout();
+    }
+}
+
+bool LayoutNode::findMeasurement(const LayoutConstraints& constraints, SizingMode mode, Size& size) const {
+    LayoutTree* owner = tree();
+    if (cold_) {
+        for (const Measurement& measurement : cold_->measurements) {
+            if (measurement.mode == mode && measurement.constraints == constraints) {
+                size = measurement.size;
+                LAYOUT_TRACE_CACHE_HIT();
+                if (owner) {
+                    owner->measurementCacheHits_.fetch_add(1, std::memory_order_relaxed);
+                }
+                return true;
+            }
+        }
     }
+    if (owner) {
+        owner->measurementCacheMisses_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return false;
 }
 
-std::unique_ptr<LayoutNode> LayoutNode::clone() const {
-    auto cloned = std::make_unique<LayoutNode>();
-    if (box_) {
-        cloned->box_ = std::make_shared<LayoutBox>(*box_);
-    }
-    cloned->layoutRect_ = layoutRect_;
-    cloned->intrinsicSize_ = intrinsicSize_;
-    cloned->minSize_ = minSize_;
-    cloned->maxSize_ = maxSize_;
-    cloned->isLayoutDirty_ = isLayoutDirty_;
-    cloned->needsLayout_ = needsLayout_;
-    cloned->textContent_ = textContent_;
-    cloned->fontMetrics_ = fontMetrics_;
-    cloned->lineHeight_ = lineHeight_;
-    cloned->baseline_ = baseline_;
-    
-    for (auto* child : children_) {
-        auto clonedChild = child->clone();
-        cloned->addChild(clonedChild.release());
+void LayoutNode::cacheMeasurement(const LayoutConstraints& constraints, SizingMode mode, const Size& size) {
+    ColdData& cold = mutableColdData();
+    if (cold.measurements.size() < kMeasurementCacheSize) {
+        cold.measurements.push_back(Measurement{constraints, mode, size});
+        return;
+    }
+    cold.measurements[cold.nextMeasurement] = Measurement{constraints, mode, size};
+    cold.nextMeasurement = (cold.nextMeasurement + 1) % kMeasurementCacheSize;
+}
+
+void LayoutNode::clearMeasurementCache() {
+    if (cold_) {
+        cold_->measurements.clear();
+        cold_->nextMeasurement = 0;
+    }
+}
+
+void LayoutNode::releaseMeasurementCache() {
+    if (cold_) {
+        std::vector<Measurement>().swap(cold_->measurements);
+        cold_->nextMeasurement = 0;
+    }
+}
+
+LayoutNode* LayoutNode::clone(LayoutTree& tree) const {
+    LayoutNode* cloned = cloneShallow(tree);
+    for (auto* child : children()) {
+        cloned->addChild(child->clone(tree));
     }
-    
     return cloned;
 }
 
-std::unique_ptr<LayoutNode> LayoutNode::cloneShallow() const {
-    auto cloned = std::make_unique<LayoutNode>();
-    if (box_) {
-        cloned->box_ = std::make_shared<LayoutBox>(*box_);
-    }
-    cloned->layoutRect_ = layoutRect_;
-    cloned->intrinsicSize_ = intrinsicSize_;
-    cloned->minSize_ = minSize_;
-    cloned->maxSize_ = maxSize_;
-    cloned->isLayoutDirty_ = isLayoutDirty_;
-    cloned->needsLayout_ = needsLayout_;
-    cloned->textContent_ = textContent_;
-    cloned->fontMetrics_ = fontMetrics_;
-    cloned->lineHeight_ = lineHeight_;
-    cloned->baseline_ = baseline_;
+LayoutNode* LayoutNode::cloneShallow(LayoutTree& tree) const {
+    LayoutNode* cloned = tree.createNode();
+    cloned->copyData(*this);
     return cloned;
 }
 
 void LayoutNode::reset() {
+    if (parent()) {
+        parent()->removeChild(this);
+    }
+    clearChildren();
     box_.reset();
     layoutRect_ = Rect(0, 0, 0, 0);
     intrinsicSize_ = Size(0, 0);
@@ -649,65 +908,30 @@ void LayoutNode::reset() {
     maxSize_ = Size(std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
     isLayoutDirty_ = true;
     needsLayout_ = true;
-    textContent_.clear();
-    fontMetrics_ = FontMetrics();
+    childNeedsLayout_ = false;
+    hasLayoutConstraints_ = false;
+    hasEstimatedLayout_ = false;
+    lastConstraints_ = LayoutConstraints();
     lineHeight_ = 0;
     baseline_ = 0;
-    parent_ = nullptr;
-    clearChildren();
-    clearFloats();
+    cold_.reset();
 }
 
 LayoutNode::LayoutNode(const LayoutNode& other)
-    : box_(other.box_ ? std::make_shared<LayoutBox>(*other.box_) : nullptr)
-    , layoutRect_(other.layoutRect_)
-    , intrinsicSize_(other.intrinsicSize_)
-    , minSize_(other.minSize_)
-    , maxSize_(other.maxSize_)
-    , isLayoutDirty_(other.isLayoutDirty_)
-    , needsLayout_(other.needsLayout_)
-    , textContent_(other.textContent_)
-    , fontMetrics_(other.fontMetrics_)
-    , lineHeight_(other.lineHeight_)
-    , baseline_(other.baseline_)
-    , parent_(nullptr) {
+    : LayoutNode() {
+    copyData(other);
 }
 
 LayoutNode& LayoutNode::operator=(const LayoutNode& other) {
     if (this != &other) {
-        box_ = other.box_ ? std::make_shared<LayoutBox>(*other.box_) : nullptr;
-        layoutRect_ = other.layoutRect_;
-        intrinsicSize_ = other.intrinsicSize_;
-        minSize_ = other.minSize_;
-        maxSize_ = other.maxSize_;
-        isLayoutDirty_ = other.isLayoutDirty_;
-        needsLayout_ = other.needsLayout_;
-        textContent_ = other.textContent_;
-        fontMetrics_ = other.fontMetrics_;
-        lineHeight_ = other.lineHeight_;
-        baseline_ = other.baseline_;
-        parent_ = nullptr;
-        clearChildren();
-        clearFloats();
+        copyData(other);
     }
     return *this;
 }
 
 LayoutNode::LayoutNode(LayoutNode&& other) noexcept
-    : box_(std::move(other.box_))
-    , layoutRect_(std::move(other.layoutRect_))
-    , intrinsicSize_(std::move(other.intrinsicSize_))
-    , minSize_(std::move(other.minSize_))
-    , maxSize_(std::move(other.maxSize_))
-    , isLayoutDirty_(other.isLayoutDirty_)
-    , needsLayout_(other.needsLayout_)
-    , textContent_(std::move(other.textContent_))
-    , fontMetrics_(std::move(other.fontMetrics_))
-    , lineHeight_(other.lineHeight_)
-    , baseline_(other.baseline_)
-    , parent_(other.parent_)
-    , children_(std::move(other.children_))
-    , floats_(std::move(other.floats_)) {
+    : LayoutNode() {
+    *this = std::move(other);
 }
 
 LayoutNode& LayoutNode::operator=(LayoutNode&& other) noexcept {
@@ -719,45 +943,234 @@ LayoutNode& LayoutNode::operator=(LayoutNode&& other) noexcept {
         maxSize_ = std::move(other.maxSize_);
         isLayoutDirty_ = other.isLayoutDirty_;
         needsLayout_ = other.needsLayout_;
-        textContent_ = std::move(other.textContent_);
-        fontMetrics_ = std::move(other.fontMetrics_);
+        childNeedsLayout_ = other.childNeedsLayout_;
+        hasLayoutConstraints_ = other.hasLayoutConstraints_;
+        hasEstimatedLayout_ = other.hasEstimatedLayout_;
+        lastConstraints_ = other.lastConstraints_;
         lineHeight_ = other.lineHeight_;
         baseline_ = other.baseline_;
-        parent_ = other.parent_;
-        children_ = std::move(other.children_);
-        floats_ = std::move(other.floats_);
+        cold_ = std::move(other.cold_);
     }
     return *this;
 }
 
-void LayoutNode::updateParentChildRelationships() {
-    for (auto* child : children_) {
-        child->parent_ = this;
+const LayoutNode::ColdData& LayoutNode::coldData() const {
+    static const ColdData empty;
+    return cold_ ? *cold_ : empty;
+}
+
+LayoutNode::ColdData& LayoutNode::mutableColdData() {
+    if (!cold_) {
+        cold_ = std::make_unique<ColdData>();
+    }
+    return *cold_;
+}
+
+// Floats refer to nodes of the source's tree and are not copied
+void LayoutNode::copyData(const LayoutNode& other) {
+    box_ = other.box_ ? std::make_shared<LayoutBox>(*other.box_) : nullptr;
+    layoutRect_ = other.layoutRect_;
+    intrinsicSize_ = other.intrinsicSize_;
+    minSize_ = other.minSize_;
+    maxSize_ = other.maxSize_;
+    isLayoutDirty_ = other.isLayoutDirty_;
+    needsLayout_ = other.needsLayout_;
+    childNeedsLayout_ = other.childNeedsLayout_;
+    hasLayoutConstraints_ = other.hasLayoutConstraints_;
+    hasEstimatedLayout_ = other.hasEstimatedLayout_;
+    lastConstraints_ = other.lastConstraints_;
+    lineHeight_ = other.lineHeight_;
+    baseline_ = other.baseline_;
+    if (other.cold_) {
+        mutableColdData().textContent = other.cold_->textContent;
+        cold_->fontMetrics = other.cold_->fontMetrics;
+        cold_->floats.clear();
+        cold_->exclusionSpace.clear();
+        cold_->gridTracks.reset();
+        clearMeasurementCache();
+    } else {
+        cold_.reset();
+    }
+}
+
+void LayoutNode::linkChild(LayoutNode* child, LayoutNode* before) {
+    child->parent_ = index_;
+    child->nextSibling_ = before ? before->index_ : kInvalidNodeIndex;
+    child->previousSibling_ = before ? before->previousSibling_ : lastChild_;
+
+    if (LayoutNode* previous = nodeAt(child->previousSibling_)) {
+        previous->nextSibling_ = child->index_;
+    } else {
+        firstChild_ = child->index_;
+    }
+    if (before) {
+        before->previousSibling_ = child->index_;
+    } else {
+        lastChild_ = child->index_;
+    }
+    ++childCount_;
+    arena_->noteStructureChange();
+}
+
+void LayoutNode::unlinkChild(LayoutNode* child) {
+    if (LayoutNode* previous = nodeAt(child->previousSibling_)) {
+        previous->nextSibling_ = child->nextSibling_;
+    } else {
+        firstChild_ = child->nextSibling_;
     }
+    if (LayoutNode* next = nodeAt(child->nextSibling_)) {
+        next->previousSibling_ = child->previousSibling_;
+    } else {
+        lastChild_ = child->previousSibling_;
+    }
+    child->parent_ = kInvalidNodeIndex;
+    child->nextSibling_ = kInvalidNodeIndex;
+    child->previousSibling_ = kInvalidNodeIndex;
+    --childCount_;
+    arena_->noteStructureChange();
 }
 
-void LayoutNode::collectDescendants(LayoutNode* node, std::vector<LayoutNode*>& descendants) {
-    for (auto* child : node->children_) {
+void LayoutNode::collectDescendants(const LayoutNode* node, std::vector<LayoutNode*>& descendants) const {
+    for (auto* child : node->children()) {
         descendants.push_back(child);
         collectDescendants(child, descendants);
     }
 }
 
+// LayoutNodeArena implementation
+LayoutNodeArena::LayoutNodeArena(LayoutTree* tree)
+    : chunks_()
+    , live_()
+    , free_()
+    , generations_()
+    , tree_(tree)
+    , end_(0)
+    , size_(0)
+    , structureVersion_(0) {
+}
+
+LayoutNodeArena::~LayoutNodeArena() {
+    clear();
+}
+
+LayoutNode* LayoutNodeArena::create(std::shared_ptr<LayoutBox> box) {
+    NodeIndex index;
+    if (!free_.empty()) {
+        index = free_.back();
+        free_.pop_back();
+    } else {
+        index = end_++;
+        if ((index >> kChunkBits) >= chunks_.size()) {
+            chunks_.push_back(std::make_unique<Slot[]>(kChunkSize));
+        }
+        live_.push_back(false);
+    }
+    if (index >= generations_.size()) {
+        generations_.push_back(0);
+    }
+    ++generations_[index];
+
+    Slot& slot = chunks_[index >> kChunkBits][index & (kChunkSize - 1)];
+    LayoutNode* node = new (slot.bytes) LayoutNode(std::move(box));
+    node->arena_ = this;
+    node->index_ = index;
+    live_[index] = true;
+    ++size_;
+    ++structureVersion_;
+    return node;
+}
+
+void LayoutNodeArena::reserve(size_t count) {
+    size_t end = static_cast<size_t>(end_) + (count > free_.size() ? count - free_.size() : 0);
+    while ((chunks_.size() << kChunkBits) < end) {
+        chunks_.push_back(std::make_unique<Slot[]>(kChunkSize));
+    }
+    live_.reserve(end);
+}
+
+void LayoutNodeArena::destroy(LayoutNode* node) {
+    if (!node || node->arena_ != this) return;
+
+    NodeIndex index = node->index_;
+    node->~LayoutNode();
+    live_[index] = false;
+    free_.push_back(index);
+    --size_;
+    ++structureVersion_;
+}
+
+size_t LayoutNodeArena::memoryUsage() const {
+    return chunks_.size() * kChunkSize * sizeof(Slot) + chunks_.capacity() * sizeof(std::unique_ptr<Slot[]>) +
+           live_.capacity() / 8 + free_.capacity() * sizeof(NodeIndex) + generations_.capacity() * sizeof(uint32_t);
+}
+
+// Chunks are kept for the next nodes
+void LayoutNodeArena::clear() {
+    for (NodeIndex index = 0; index < end_; ++index) {
+        if (LayoutNode* node = at(index)) {
+            node->~LayoutNode();
+        }
+    }
+    live_.clear();
+    free_.clear();
+    end_ = 0;
+    size_ = 0;
+    ++structureVersion_;
+}
+
 // LayoutTree implementation
-LayoutTree::LayoutTree() = default;
+LayoutTree::LayoutTree()
+    : arena_(this)
+    , root_(nullptr)
+    , taskPool_(nullptr)
+    , measurementCacheHits_(0)
+    , measurementCacheMisses_(0)
+    , paintOrder_()
+    , contentVersion_(0)
+    , snapshot_() {
+}
 
 LayoutTree::~LayoutTree() = default;
 
-void LayoutTree::setRoot(std::unique_ptr<LayoutNode> root) {
-    root_ = std::move(root);
+void LayoutTree::setRoot(LayoutNode* root) {
+    if (root && root->arena() != &arena_) return;
+    if (root && root->parent()) {
+        root->parent()->removeChild(root);
+    }
+    if (root_ && root_ != root) {
+        destroySubtree(root_);
+    }
+    root_ = root;
+    noteContentChange();
+}
+
+LayoutNode* LayoutTree::createNode() {
+    return arena_.create();
 }
 
-std::unique_ptr<LayoutNode> LayoutTree::createNode() {
-    return std::make_unique<LayoutNode>();
+LayoutNode* LayoutTree::createNode(std::shared_ptr<LayoutBox> box) {
+    return arena_.create(std::move(box));
 }
 
-std::unique_ptr<LayoutNode> LayoutTree::createNode(std::shared_ptr<LayoutBox> box) {
-    return std::make_unique<LayoutNode>(box);
+void LayoutTree::resetMeasurementCacheStats() {
+    measurementCacheHits_.store(0, std::memory_order_relaxed);
+    measurementCacheMisses_.store(0, std::memory_order_relaxed);
+}
+
+const PaintOrderList& LayoutTree::paintOrder() const {
+    if (!paintOrder_) {
+        paintOrder_ = std::make_unique<PaintOrderList>();
+    }
+    paintOrder_->update(*this);
+    return *paintOrder_;
+}
+
+std::shared_ptr<const LayoutSnapshot> LayoutTree::snapshot() const {
+    if (!snapshot_ || snapshot_->structureVersion() != arena_.structureVersion() ||
+        snapshot_->contentVersion() != contentVersion()) {
+        snapshot_ = LayoutSnapshot::capture(*this);
+    }
+    return snapshot_;
 }
 
 void LayoutTree::addChild(LayoutNode* parent, LayoutNode* child) {
@@ -767,51 +1180,51 @@ void LayoutTree::addChild(LayoutNode* parent, LayoutNode* child) {
 }
 
 void LayoutTree::removeNode(LayoutNode* node) {
-    if (node && node->parent()) {
+    if (!node || node->arena() != &arena_) return;
+
+    if (node->parent()) {
         node->parent()->removeChild(node);
-    } else if (node == root_.get()) {
-        root_.reset();
+    } else if (node == root_) {
+        root_ = nullptr;
     }
+    destroySubtree(node);
 }
 
 void LayoutTree::moveNode(LayoutNode* node, LayoutNode* newParent) {
     if (node && newParent && node != newParent) {
-        if (node->parent()) {
-            node->parent()->removeChild(node);
-        }
         newParent->addChild(node);
     }
 }
 
 void LayoutTree::clear() {
-    root_.reset();
+    root_ = nullptr;
+    arena_.clear();
 }
 
 std::vector<LayoutNode*> LayoutTree::getAllNodes() const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        nodes.push_back(root_.get());
-        collectAllNodes(root_.get(), nodes);
-    }
-    return nodes;
+    return collectNodes([](const LayoutNode*) { return true; });
 }
 
 std::vector<LayoutNode*> LayoutTree::getLeafNodes() const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        collectLeafNodes(root_.get(), nodes);
-    }
-    return nodes;
+    return collectNodes([](const LayoutNode* node) { return node->isLeaf(); });
 }
 
 std::vector<LayoutNode*> LayoutTree::getNodesAtDepth(size_t depth) const {
     std::vector<LayoutNode*> nodes;
     if (root_) {
-        collectNodesAtDepth(root_.get(), depth, nodes);
+        collectNodesAtDepth(root_, depth, nodes);
     }
     return nodes;
 }
 
+void LayoutTree::releaseMeasurementCaches() {
+    for (NodeIndex index = 0; index < arena_.end(); ++index) {
+        if (LayoutNode* node = arena_.at(index)) {
+            node->releaseMeasurementCache();
+        }
+    }
+}
+
 size_t LayoutTree::nodeCount() const {
     return getAllNodes().size();
 }
@@ -822,75 +1235,61 @@ size_t LayoutTree::height() const {
 
 LayoutNode* LayoutTree::findNode(const LayoutBox* box) const {
     if (!root_ || !box) return nullptr;
-    return findNodeRecursive(root_.get(), box);
+
+    std::vector<bool> attached = attachedNodes();
+    for (NodeIndex index = 0; index < arena_.end(); ++index) {
+        LayoutNode* node = arena_.at(index);
+        if (attached[index] && node->box() == box) {
+            return node;
+        }
+    }
+    return nullptr;
 }
 
 std::vector<LayoutNode*> LayoutTree::findNodesByDisplay(Display display) const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        collectNodesByDisplay(root_.get(), display, nodes);
-    }
-    return nodes;
+    return collectNodes([display](const LayoutNode* node) {
+        return node->box() && node->box()->display() == display;
+    });
 }
 
 std::vector<LayoutNode*> LayoutTree::findNodesByPosition(Position position) const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        collectNodesByPosition(root_.get(), position, nodes);
-    }
-    return nodes;
+    return collectNodes([position](const LayoutNode* node) {
+        return node->box() && node->box()->position() == position;
+    });
 }
 
 std::vector<LayoutNode*> LayoutTree::findPositionedNodes() const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        collectPositionedNodes(root_.get(), nodes);
-    }
-    return nodes;
+    return collectNodes([](const LayoutNode* node) { return node->isPositioned(); });
 }
 
 std::vector<LayoutNode*> LayoutTree::findFloatingNodes() const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        collectFloatingNodes(root_.get(), nodes);
-    }
-    return nodes;
+    return collectNodes([](const LayoutNode* node) { return node->isFloating(); });
 }
 
 std::vector<LayoutNode*> LayoutTree::findBlockLevelNodes() const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        collectBlockLevelNodes(root_.get(), nodes);
-    }
-    return nodes;
+    return collectNodes([](const LayoutNode* node) { return node->isBlockLevel(); });
 }
 
 std::vector<LayoutNode*> LayoutTree::findInlineLevelNodes() const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        collectInlineLevelNodes(root_.get(), nodes);
-    }
-    return nodes;
+    return collectNodes([](const LayoutNode* node) { return node->isInlineLevel(); });
 }
 
 std::vector<LayoutNode*> LayoutTree::findStackingContextNodes() const {
-    std::vector<LayoutNode*> nodes;
-    if (root_) {
-        collectStackingContextNodes(root_.get(), nodes);
-    }
-    return nodes;
+    return collectNodes([](const LayoutNode* node) { return node->isStackingContext(); });
 }
 
 void LayoutTree::layout(const LayoutConstraints& constraints) {
     if (root_) {
         root_->layout(constraints);
     }
+    noteContentChange();
 }
 
 void LayoutTree::updateLayout() {
     if (root_) {
         root_->updateLayout();
     }
+    noteContentChange();
 }
 
 void LayoutTree::invalidateLayout() {
@@ -899,113 +1298,99 @@ void LayoutTree::invalidateLayout() {
     }
 }
 
+void LayoutTree::invalidateNode(LayoutNode* node) {
+    if (node) {
+        node->markNeedsLayout();
+    }
+}
+
 bool LayoutTree::isValid() const {
-    return root_ ? validateNode(root_.get()) : true;
+    return root_ ? validateNode(root_) : true;
 }
 
 std::unique_ptr<LayoutTree> LayoutTree::clone() const {
     auto cloned = std::make_unique<LayoutTree>();
+    cloned->taskPool_ = taskPool_;
     if (root_) {
-        cloned->root_ = root_->clone();
+        cloned->root_ = root_->clone(*cloned);
     }
     return cloned;
 }
 
-void LayoutTree::collectAllNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const {
-    for (auto* child : node->children()) {
-        nodes.push_back(child);
-        collectAllNodes(child, nodes);
-    }
-}
-
-void LayoutTree::collectLeafNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const {
-    if (node->children().empty()) {
-        nodes.push_back(node);
-    } else {
-        for (auto* child : node->children()) {
-            collectLeafNodes(child, nodes);
+template <typename Predicate>
+std::vector<LayoutNode*> LayoutTree::collectNodes(Predicate predicate) const {
+    std::vector<LayoutNode*> nodes;
+    if (!root_) return nodes;
+
+    std::vector<bool> attached = attachedNodes();
+    for (NodeIndex index = 0; index < arena_.end(); ++index) {
+        if (attached[index]) {
+            LayoutNode* node = arena_.at(index);
+            if (predicate(node)) {
+                nodes.push_back(node);
+            }
         }
     }
+    return nodes;
 }
 
-void LayoutTree::collectNodesAtDepth(LayoutNode* node, size_t depth, std::vector<LayoutNode*>& nodes) const {
-    if (depth == 0) {
-        nodes.push_back(node);
-        return;
-    }
-    
-    for (auto* child : node->children()) {
-        collectNodesAtDepth(child, depth - 1, nodes);
-    }
-}
-
-void LayoutTree::collectNodesByDisplay(LayoutNode* node, Display display, std::vector<LayoutNode*>& nodes) const {
-    if (node->box() && node->box()->display() == display) {
-        nodes.push_back(node);
-    }
-    
-    for (auto* child : node->children()) {
-        collectNodesByDisplay(child, display, nodes);
-    }
-}
-
-void LayoutTree::collectNodesByPosition(LayoutNode* node, Position position, std::vector<LayoutNode*>& nodes) const {
-    if (node->box() && node->box()->position() == position) {
-        nodes.push_back(node);
-    }
-    
-    for (auto* child : node->children()) {
-        collectNodesByPosition(child, position, nodes);
+// A node is attached when its parent chain ends at the root; each chain is
+// walked once and the answer recorded for every node on it
+std::vector<bool> LayoutTree::attachedNodes() const {
+    enum : uint8_t { Unknown, Attached, Detached };
+    std::vector<uint8_t> state(arena_.end(), Unknown);
+    if (root_) {
+        state[root_->index()] = Attached;
     }
-}
 
-void LayoutTree::collectPositionedNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const {
-    if (node->isPositioned()) {
-        nodes.push_back(node);
-    }
-    
-    for (auto* child : node->children()) {
-        collectPositionedNodes(child, nodes);
-    }
-}
+    std::vector<NodeIndex> chain;
+    for (NodeIndex index = 0; index < arena_.end(); ++index) {
+        LayoutNode* node = arena_.at(index);
+        if (!node) {
+            state[index] = Detached;
+            continue;
+        }
 
-void LayoutTree::collectFloatingNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const {
-    if (node->isFloating()) {
-        nodes.push_back(node);
-    }
-    
-    for (auto* child : node->children()) {
-        collectFloatingNodes(child, nodes);
+        chain.clear();
+        while (node && state[node->index()] == Unknown) {
+            chain.push_back(node->index());
+            node = node->parent();
+        }
+        uint8_t result = Detached;
+        if (node) {
+            result = state[node->index()];
+        }
+        for (NodeIndex link : chain) {
+            state[link] = result;
+        }
     }
-}
 
-void LayoutTree::collectBlockLevelNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const {
-    if (node->isBlockLevel()) {
-        nodes.push_back(node);
-    }
-    
-    for (auto* child : node->children()) {
-        collectBlockLevelNodes(child, nodes);
+    std::vector<bool> attached(arena_.end());
+    for (NodeIndex index = 0; index < arena_.end(); ++index) {
+        attached[index] = state[index] == Attached;
     }
+    return attached;
 }
 
-void LayoutTree::collectInlineLevelNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const {
-    if (node->isInlineLevel()) {
-        nodes.push_back(node);
-    }
-    
-    for (auto* child : node->children()) {
-        collectInlineLevelNodes(child, nodes);
+void LayoutTree::destroySubtree(LayoutNode* node) {
+    LayoutNode* child = node->firstChild();
+    while (child) {
+        LayoutNode* next = child->nextSibling();
+        destroySubtree(child);
+        child = next;
     }
+    node->clearChildren();
+    arena_.destroy(node);
 }
 
-void LayoutTree::collectStackingContextNodes(LayoutNode* node, std::vector<LayoutNode*>& nodes) const {
-    if (node->isStackingContext()) {
+void LayoutTree::collectNodesAtDepth(LayoutNode* node, size_t depth, std::vector<LayoutNode*>& nodes) const {
+    if (depth == 0) {
         nodes.push_back(node);
+        return;
     }
     
     for (auto* child : node->children()) {
-        collectStackingContextNodes(child, nodes);
+        collectNodesAtDepth(child, depth - 1, nodes);
     }
 }
 
@@ -1013,6 +1398,7 @@ bool LayoutTree::validateNode(LayoutNode* node) const {
     if (!node) return false;
     
     // Check parent-child relationships
+    size_t count = 0;
     for (auto* child : node->children()) {
         if (child->parent() != node) {
             return false;
@@ -1020,24 +1406,10 @@ bool LayoutTree::validateNode(LayoutNode* node) const {
         if (!validateNode(child)) {
             return false;
         }
+        ++count;
     }
     
-    return true;
-}
-
-LayoutNode* LayoutTree::findNodeRecursive(LayoutNode* node, const LayoutBox* box) const {
-    if (node->box() == box) {
-        return node;
-    }
-    
-    for (auto* child : node->children()) {
-        LayoutNode* found = findNodeRecursive(child, box);
-        if (found) {
-            return found;
-        }
-    }
-    
-    return nullptr;
+    return count == node->childCount();
 }
 
 } // namespace layout
@@ -0,0 +1,114 @@
+#include "layout/layout_records.h"
+#include "layout/layout_node.h"
+#include <string_view>
+#include <vector>
+
+namespace layout {
+
+// The style engine's LayoutRecord mirrors this layout
+static_assert(sizeof(ApolloLayoutRecord) == 96, "record layout is shared with the style engine");
+
+namespace {
+
+bool validRecord(const ApolloLayoutRecord& record, size_t index, size_t textLength) {
+    if (index == 0 ? record.parent != APOLLO_LAYOUT_NO_PARENT : record.parent >= index) return false;
+    if (record.text_offset > textLength || record.text_length > textLength - record.text_offset) return false;
+    return record.display <= static_cast<uint8_t>(Display::Contents) &&
+           record.position <= static_cast<uint8_t>(Position::Sticky) &&
+           record.float_value <= static_cast<uint8_t>(Float::Right) &&
+           record.clear <= static_cast<uint8_t>(Clear::Both) &&
+           record.visibility <= static_cast<uint8_t>(Visibility::Collapse) &&
+           record.overflow <= static_cast<uint8_t>(Overflow::Auto) &&
+           record.box_sizing <= static_cast<uint8_t>(BoxSizing::BorderBox);
+}
+
+EdgeInsets edges(const float (&sides)[4]) {
+    return EdgeInsets(sides[0], sides[1], sides[2], sides[3]);
+}
+
+BoxStyle styleOf(const ApolloLayoutRecord& record) {
+    BoxStyle style;
+    style.setPadding(edges(record.padding));
+    style.setBorder(edges(record.border));
+    style.setMargin(edges(record.margin));
+    style.setBoxSizing(static_cast<BoxSizing>(record.box_sizing));
+    style.setDisplay(static_cast<Display>(record.display));
+    style.setPosition(static_cast<Position>(record.position));
+    InsetOffsets insets;
+    insets.values = edges(record.insets);
+    insets.hasTop = record.flags & APOLLO_LAYOUT_INSET_TOP;
+    insets.hasRight = record.flags & APOLLO_LAYOUT_INSET_RIGHT;
+    insets.hasBottom = record.flags & APOLLO_LAYOUT_INSET_BOTTOM;
+    insets.hasLeft = record.flags & APOLLO_LAYOUT_INSET_LEFT;
+    style.setInsets(insets);
+    style.setFloat(static_cast<Float>(record.float_value));
+    style.setClear(static_cast<Clear>(record.clear));
+    style.setZIndex(record.z_index);
+    style.setOpacity(record.opacity);
+    style.setVisibility(static_cast<Visibility>(record.visibility));
+    style.setOverflow(static_cast<Overflow>(record.overflow));
+    style.setIsReplaced(record.flags & APOLLO_LAYOUT_REPLACED);
+    style.setIsAnonymous(record.flags & APOLLO_LAYOUT_ANONYMOUS);
+    return style;
+}
+
+} // namespace
+
+// LayoutTree::adoptRecords implementation
+LayoutNode* LayoutTree::adoptRecords(const ApolloLayoutRecord* records, size_t count, const char* text,
+                                     size_t textLength) {
+    if (!records || count == 0 || count >= kInvalidNodeIndex) return nullptr;
+    if (!text) textLength = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!validRecord(records[i], i, textLength)) return nullptr;
+    }
+
+    clear();
+    arena_.reserve(count);
+    // Nodes hold aliases of the block, which lives until the last of them
+    // lets go of its box
+    std::shared_ptr<LayoutBox[]> boxes(new LayoutBox[count]);
+    std::vector<LayoutNode*> nodes(count);
+    // Siblings mostly repeat the previous record's values, which then skip
+    // the intern table
+    BoxStyle previous;
+    std::shared_ptr<const BoxStyle> shared = BoxStyle::initial();
+    std::string_view content(text ? text : "", textLength);
+
+    for (size_t i = 0; i < count; ++i) {
+        const ApolloLayoutRecord& record = records[i];
+        BoxStyle style = styleOf(record);
+        style.setIsRoot(i == 0);
+        if (style != previous) {
+            shared = BoxStyle::intern(style);
+            previous = style;
+        }
+        boxes[i].setStyle(shared);
+
+        LayoutNode* node = arena_.create(std::shared_ptr<LayoutBox>(boxes, &boxes[i]));
+        if (record.text_length) {
+            node->mutableColdData().textContent.assign(content.substr(record.text_offset, record.text_length));
+        }
+        node->setLineHeight(record.line_height);
+        if (i > 0) {
+            nodes[record.parent]->linkChild(node, nullptr);
+        }
+        nodes[i] = node;
+    }
+
+    setRoot(nodes[0]);
+    return nodes[0];
+}
+
+} // namespace layout
+
+extern "C" {
+
+int apollo_layout_tree_adopt(ApolloLayoutTree* tree, const ApolloLayoutRecord* records, size_t count,
+                             const char* text, size_t text_length) {
+    if (!tree) return 0;
+    layout::LayoutTree* layoutTree = reinterpret_cast<layout::LayoutTree*>(tree);
+    return layoutTree->adoptRecords(records, count, text, text_length) ? 1 : 0;
+}
+
+} // extern "C"
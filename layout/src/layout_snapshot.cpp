@@ -0,0 +1,128 @@
+#include "layout/layout_snapshot.h"
+#include <algorithm>
+
+namespace layout {
+
+// LayoutSnapshot implementation
+LayoutSnapshot::LayoutSnapshot()
+    : nodes_()
+    , texts_()
+    , paintOrder_()
+    , nodeOf_()
+    , structureVersion_(0)
+    , contentVersion_(0) {
+}
+
+std::shared_ptr<const LayoutSnapshot> LayoutSnapshot::capture(const LayoutTree& tree) {
+    // The constructor is private, so make_shared cannot reach it
+    std::shared_ptr<LayoutSnapshot> snapshot(new LayoutSnapshot());
+    snapshot->structureVersion_ = tree.arena().structureVersion();
+    snapshot->contentVersion_ = tree.contentVersion();
+    if (!tree.root()) return snapshot;
+
+    snapshot->nodes_.reserve(tree.arena().size());
+    snapshot->nodeOf_.assign(tree.arena().end(), kNone);
+    snapshot->copySubtree(tree.root());
+
+    // Paint order entries name snapshot nodes instead of live ones
+    const std::vector<PaintItem>& items = tree.paintOrder().items();
+    snapshot->paintOrder_.reserve(items.size());
+    for (const auto& item : items) {
+        snapshot->paintOrder_.push_back(PaintEntry{snapshot->find(item.node->index()), item.end, item.layer,
+                                                   item.startsStackingContext});
+    }
+    return snapshot;
+}
+
+uint32_t LayoutSnapshot::find(NodeIndex source) const {
+    return source < nodeOf_.size() ? nodeOf_[source] : kNone;
+}
+
+std::vector<uint32_t> LayoutSnapshot::nodesIntersecting(const Rect& rect) const {
+    std::vector<uint32_t> result;
+    uint32_t index = 0;
+    while (index < nodes_.size()) {
+        const Node& node = nodes_[index];
+        if (!node.subtreeBounds.intersects(rect)) {
+            index = node.subtreeEnd;
+            continue;
+        }
+        if (node.absoluteRect.intersects(rect)) {
+            result.push_back(index);
+        }
+        ++index;
+    }
+    return result;
+}
+
+// Copies in tree order with an explicit stack; a node's subtree ends where
+// the copy of its next sibling or an ancestor's begins
+void LayoutSnapshot::copySubtree(const LayoutNode* root) {
+    struct Frame {
+        const LayoutNode* node;
+        uint32_t index;
+    };
+
+    std::vector<Frame> stack;
+    auto copy = [&](const LayoutNode* node, uint32_t parent) {
+        Node entry;
+        entry.source = node->index();
+        entry.parent = parent;
+        entry.subtreeEnd = kNone;
+        entry.text = kNone;
+        entry.rect = node->layoutRect();
+        entry.absoluteRect = entry.rect;
+        if (parent != kNone) {
+            entry.absoluteRect.x += nodes_[parent].absoluteRect.x;
+            entry.absoluteRect.y += nodes_[parent].absoluteRect.y;
+        }
+        entry.subtreeBounds = entry.absoluteRect;
+        entry.baseline = node->baseline();
+        entry.lineHeight = node->lineHeight();
+        entry.hasBox = node->box() != nullptr;
+
+        const LayoutBox* box = node->box();
+        static const LayoutBox defaults;
+        if (!box) box = &defaults;
+        entry.style = Style{box->display(), box->position(), box->visibility(), box->overflow(), box->zIndex(),
+                            box->opacity(), box->transform(), box->border(), box->padding(), box->clipRect(),
+                            box->insets()};
+
+        if (!node->textContent().empty()) {
+            entry.text = static_cast<uint32_t>(texts_.size());
+            texts_.push_back(Text{node->textContent(), node->fontMetrics()});
+        }
+
+        uint32_t index = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back(entry);
+        nodeOf_[node->index()] = index;
+        stack.push_back(Frame{node, index});
+    };
+
+    copy(root, kNone);
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        Node& entry = nodes_[frame.index];
+        if (entry.subtreeEnd == kNone && !frame.node->isLeaf()) {
+            // First visit: copy the first child; the others follow as their
+            // elder siblings' subtrees close
+            entry.subtreeEnd = 0;
+            copy(frame.node->firstChild(), frame.index);
+            continue;
+        }
+
+        // The subtree is complete
+        stack.pop_back();
+        entry.subtreeEnd = static_cast<uint32_t>(nodes_.size());
+        if (entry.parent != kNone) {
+            Node& parent = nodes_[entry.parent];
+            parent.subtreeBounds = parent.subtreeBounds.unionRect(entry.subtreeBounds);
+        }
+        const LayoutNode* next = frame.node != root ? frame.node->nextSibling() : nullptr;
+        if (next) {
+            copy(next, entry.parent);
+        }
+    }
+}
+
+} // namespace layout
@@ -0,0 +1,178 @@
+#include "layout/layout_trace.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace layout {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Innermost open scope of this thread
+thread_local LayoutTracer::Scope* currentScope = nullptr;
+
+uint64_t nanosecondsBetween(Clock::time_point from, Clock::time_point to) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+} // namespace
+
+const char* layoutPhaseName(LayoutPhase phase) {
+    switch (phase) {
+        case LayoutPhase::Block: return "BlockLayout";
+        case LayoutPhase::Inline: return "InlineLayout";
+        case LayoutPhase::Flex: return "FlexboxLayout";
+        case LayoutPhase::Grid: return "GridLayout";
+        case LayoutPhase::Positioned: return "PositionedLayout";
+        case LayoutPhase::Text: return "TextLayout";
+    }
+    return "Layout";
+}
+
+// Scope implementation
+LayoutTracer::Scope::Scope(LayoutPhase phase)
+    : tracer_(nullptr)
+    , parent_(nullptr)
+    , phase_(phase)
+    , start_()
+    , childNanoseconds_(0)
+    , cacheHits_(0) {
+    LayoutTracer& tracer = LayoutTracer::shared();
+    if (!tracer.isRunning()) return;
+
+    tracer_ = &tracer;
+    parent_ = currentScope;
+    currentScope = this;
+    start_ = Clock::now();
+}
+
+LayoutTracer::Scope::~Scope() {
+    if (!tracer_) return;
+
+    Clock::time_point end = Clock::now();
+    currentScope = parent_;
+    if (parent_) {
+        parent_->childNanoseconds_ += nanosecondsBetween(start_, end);
+    }
+    tracer_->record(*this, end);
+}
+
+// LayoutTracer implementation
+LayoutTracer::LayoutTracer()
+    : running_(false)
+    , origin_()
+    , counters_()
+    , mutex_()
+    , buffers_() {
+    for (auto& counters : counters_) {
+        counters.nodes.store(0, std::memory_order_relaxed);
+        counters.selfNanoseconds.store(0, std::memory_order_relaxed);
+        counters.cacheHits.store(0, std::memory_order_relaxed);
+    }
+}
+
+LayoutTracer::~LayoutTracer() = default;
+
+LayoutTracer& LayoutTracer::shared() {
+    static LayoutTracer tracer;
+    return tracer;
+}
+
+void LayoutTracer::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (origin_ == Clock::time_point()) {
+        origin_ = Clock::now();
+    }
+    running_.store(true, std::memory_order_relaxed);
+}
+
+void LayoutTracer::stop() {
+    running_.store(false, std::memory_order_relaxed);
+}
+
+void LayoutTracer::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Threads keep pointing at their buffers, so only the events go
+    for (auto& buffer : buffers_) {
+        buffer->events.clear();
+    }
+    for (auto& counters : counters_) {
+        counters.nodes.store(0, std::memory_order_relaxed);
+        counters.selfNanoseconds.store(0, std::memory_order_relaxed);
+        counters.cacheHits.store(0, std::memory_order_relaxed);
+    }
+    origin_ = running_.load(std::memory_order_relaxed) ? Clock::now() : Clock::time_point();
+}
+
+void LayoutTracer::noteCacheHit() {
+    if (currentScope) {
+        ++currentScope->cacheHits_;
+    }
+}
+
+LayoutTracer::PhaseStats LayoutTracer::stats(LayoutPhase phase) const {
+    const PhaseCounters& counters = counters_[static_cast<size_t>(phase)];
+    return PhaseStats{counters.nodes.load(std::memory_order_relaxed),
+                      counters.selfNanoseconds.load(std::memory_order_relaxed),
+                      counters.cacheHits.load(std::memory_order_relaxed)};
+}
+
+std::vector<LayoutTracer::Event> LayoutTracer::events() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Event> events;
+    for (const auto& buffer : buffers_) {
+        events.insert(events.end(), buffer->events.begin(), buffer->events.end());
+    }
+    return events;
+}
+
+std::string LayoutTracer::exportChromeTrace() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : buffers_) {
+        uint32_t tid = buffer->thread + 2;
+        out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"Layout " << buffer->thread << "\"}}";
+        first = false;
+
+        for (const Event& event : buffer->events) {
+            out << ",\n{\"name\":\"" << layoutPhaseName(event.phase) << "\",\"cat\":\"layout\",\"ph\":\"X\",\"ts\":"
+                << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << ",\"pid\":1,\"tid\":" << tid << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out.str();
+}
+
+LayoutTracer::ThreadBuffer& LayoutTracer::threadBuffer() {
+    thread_local const LayoutTracer* owner = nullptr;
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (owner != this) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.push_back(std::make_unique<ThreadBuffer>());
+        buffers_.back()->thread = static_cast<uint32_t>(buffers_.size() - 1);
+        buffer = buffers_.back().get();
+        owner = this;
+    }
+    return *buffer;
+}
+
+void LayoutTracer::record(const Scope& scope, Clock::time_point end) {
+    uint64_t duration = nanosecondsBetween(scope.start_, end);
+    PhaseCounters& counters = counters_[static_cast<size_t>(scope.phase_)];
+    counters.nodes.fetch_add(1, std::memory_order_relaxed);
+    counters.selfNanoseconds.fetch_add(duration - std::min(duration, scope.childNanoseconds_), std::memory_order_relaxed);
+    counters.cacheHits.fetch_add(scope.cacheHits_, std::memory_order_relaxed);
+
+    // A scope left open across clear() began before the origin
+    uint64_t start = scope.start_ > origin_ ? nanosecondsBetween(origin_, scope.start_) : 0;
+    ThreadBuffer& buffer = threadBuffer();
+    buffer.events.push_back(Event{scope.phase_, buffer.thread, start, duration});
+}
+
+} // namespace layout
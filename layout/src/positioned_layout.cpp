@@ -1,15 +1,41 @@
 #include "layout/positioned_layout.h"
+#include "layout/layout_trace.h"
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
 namespace layout {
 
+namespace {
+
+// Where insets put a box of size inside a containing block of container
+// size, from start; auto sides, and right or bottom against a containing
+// block of unbounded size, leave start as it is
+Point insetPosition(const InsetOffsets& insets, const Size& size, const Size& container, const Point& start) {
+    const double unbounded = std::numeric_limits<double>::max();
+    Point position = start;
+    if (insets.hasLeft) {
+        position.x += insets.values.left;
+    } else if (insets.hasRight && container.width < unbounded) {
+        position.x += container.width - size.width - insets.values.right;
+    }
+    if (insets.hasTop) {
+        position.y += insets.values.top;
+    } else if (insets.hasBottom && container.height < unbounded) {
+        position.y += container.height - size.height - insets.values.bottom;
+    }
+    return position;
+}
+
+} // namespace
+
 // PositionedLayout implementation
 PositionedLayout::PositionedLayout() = default;
 
 PositionedLayout::~PositionedLayout() = default;
 
 void PositionedLayout::layoutPositioned(LayoutNode* node, const LayoutConstraints& constraints) {
+    LAYOUT_TRACE_SCOPE(LayoutPhase::Positioned);
     if (!node || !node->box()) return;
     
     // Determine positioning type and layout accordingly
@@ -136,6 +162,9 @@ void PositionedLayout::layoutRelative(LayoutNode* node, const LayoutConstraints&
     handleOverflow(node);
 }
 
+// Fixed boxes do not move with the document: they composite in layers
+// outside its scroll container (see ScrollLayers), so a scroll never lays
+// them out again
 void PositionedLayout::layoutFixed(LayoutNode* node, const LayoutConstraints& constraints) {
     if (!node || !node->box()) return;
     
@@ -145,8 +174,10 @@ void PositionedLayout::layoutFixed(LayoutNode* node, const LayoutConstraints& co
     // Set layout rect
     node->setLayoutRect(Rect(0, 0, positionedSize.width, positionedSize.height));
     
-    // Calculate positioned position
-    Point positionedPosition = calculatePositionedPosition(node);
+    // Calculate positioned position against the viewport, which the
+    // constraints' maximum size is
+    Point positionedPosition = insetPosition(node->box()->insets(), positionedSize, constraints.maxSize,
+                                             calculatePositionedPosition(node));
     
     // Update position
     node->updatePosition(positionedPosition);
@@ -188,6 +219,9 @@ void PositionedLayout::layoutFixed(LayoutNode* node, const LayoutConstraints& co
     handleOverflow(node);
 }
 
+// Sticky boxes are laid out where the flow puts them. How far they stick
+// depends on the scroll offset, so their insets are resolved by the
+// compositor every frame instead (see ScrollLayers), never by layout.
 void PositionedLayout::layoutSticky(LayoutNode* node, const LayoutConstraints& constraints) {
     if (!node || !node->box()) return;
     
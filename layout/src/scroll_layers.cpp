@@ -0,0 +1,117 @@
+#include "layout/scroll_layers.h"
+#include <algorithm>
+
+namespace layout {
+
+namespace {
+
+constexpr uint32_t kViewportLayer = 0;
+constexpr uint32_t kDocumentLayer = 1;
+
+// Size of what a box at rect scrolls: its subtree's extent from its origin
+Size scrolledSize(const LayoutSnapshot::Node& node) {
+    const Rect& rect = node.absoluteRect;
+    return Size(std::max(rect.width, node.subtreeBounds.right() - rect.x),
+                std::max(rect.height, node.subtreeBounds.bottom() - rect.y));
+}
+
+bool isScrollContainer(const LayoutSnapshot::Node& node) {
+    if (node.style.overflow == Overflow::Scroll) return true;
+    if (node.style.overflow != Overflow::Auto) return false;
+    Size content = scrolledSize(node);
+    return content.width > node.absoluteRect.width || content.height > node.absoluteRect.height;
+}
+
+// Content box of a node, in root coordinates
+Rect contentBox(const LayoutSnapshot::Node& node) {
+    const EdgeInsets& border = node.style.border;
+    const EdgeInsets& padding = node.style.padding;
+    const Rect& rect = node.absoluteRect;
+    return Rect(rect.x + border.left + padding.left, rect.y + border.top + padding.top,
+                std::max(0.0, rect.width - border.horizontal() - padding.horizontal()),
+                std::max(0.0, rect.height - border.vertical() - padding.vertical()));
+}
+
+} // namespace
+
+// ScrollLayers implementation
+ScrollLayers ScrollLayers::build(const LayoutSnapshot& snapshot, const Size& viewport) {
+    ScrollLayers result;
+    result.layerOf_.assign(snapshot.size(), kNone);
+    if (snapshot.empty()) return result;
+
+    const std::vector<LayoutSnapshot::Node>& nodes = snapshot.nodes();
+    Layer viewportLayer{Kind::Viewport, kNone, kNone, Rect(Point(), viewport), viewport, kNone, Rect(), Rect(),
+                        InsetOffsets()};
+    Size document(std::max(viewport.width, scrolledSize(nodes[0]).width),
+                  std::max(viewport.height, scrolledSize(nodes[0]).height));
+    Layer documentLayer{Kind::ScrollContainer, 0, kViewportLayer, Rect(Point(), viewport), document, kNone, Rect(),
+                        Rect(), InsetOffsets()};
+    result.layers_ = {viewportLayer, documentLayer};
+    // Root coordinates of each layer's content origin
+    std::vector<Point> origins = {Point(), Point()};
+
+    // Layers open around the current node, with the end of their subtrees
+    struct Open {
+        uint32_t layer;
+        uint32_t end;
+    };
+    std::vector<Open> open = {{kDocumentLayer, nodes[0].subtreeEnd}};
+    result.layerOf_[0] = kDocumentLayer;
+
+    for (uint32_t index = 1; index < nodes.size(); ++index) {
+        while (open.size() > 1 && open.back().end <= index) {
+            open.pop_back();
+        }
+        const LayoutSnapshot::Node& node = nodes[index];
+        uint32_t current = open.back().layer;
+
+        Kind kind;
+        if (node.style.position == Position::Fixed) {
+            kind = Kind::Fixed;
+        } else if (node.style.position == Position::Sticky && !node.style.insets.isAuto()) {
+            kind = Kind::Sticky;
+        } else if (isScrollContainer(node)) {
+            kind = Kind::ScrollContainer;
+        } else {
+            result.layerOf_[index] = current;
+            continue;
+        }
+
+        Layer layer{kind, index, current, Rect(), Size(), kNone, Rect(), Rect(), InsetOffsets()};
+        if (kind == Kind::Fixed) {
+            // Viewport coordinates are root coordinates unscrolled
+            layer.parent = kViewportLayer;
+            layer.rect = node.absoluteRect;
+        } else {
+            layer.rect = node.absoluteRect - origins[current];
+        }
+        layer.contentSize = kind == Kind::ScrollContainer ? scrolledSize(node) : node.absoluteRect.size();
+        if (kind == Kind::Sticky) {
+            uint32_t scroller = current;
+            while (result.layers_[scroller].kind != Kind::ScrollContainer &&
+                   result.layers_[scroller].kind != Kind::Viewport) {
+                scroller = result.layers_[scroller].parent;
+            }
+            layer.scroller = scroller;
+            layer.stickyRect = node.absoluteRect - origins[scroller];
+            layer.containingRect = node.parent != kNone ? contentBox(nodes[node.parent]) - origins[scroller]
+                                                        : layer.stickyRect;
+            layer.insets = node.style.insets;
+        }
+
+        uint32_t created = static_cast<uint32_t>(result.layers_.size());
+        result.layers_.push_back(layer);
+        origins.push_back(node.absoluteRect.origin());
+        result.layerOf_[index] = created;
+        open.push_back(Open{created, node.subtreeEnd});
+    }
+    return result;
+}
+
+uint32_t ScrollLayers::layerStartedBy(uint32_t node) const {
+    uint32_t layer = layerOf(node);
+    return layer != kNone && layers_[layer].node == node ? layer : kNone;
+}
+
+} // namespace layout
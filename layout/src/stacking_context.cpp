@@ -1,39 +1,236 @@
 #include "layout/stacking_context.h"
+#include <algorithm>
+#include <limits>
 
 namespace layout {
 
-StackingContext::StackingContext() : z_index(0) {}
+namespace {
 
-StackingContext::~StackingContext() {}
+constexpr uint32_t kNoContext = std::numeric_limits<uint32_t>::max();
 
-void StackingContext::add_element(std::shared_ptr<LayoutNode> element) {
-    elements.push_back(element);
+ZIndex zIndexOf(const LayoutNode* node) {
+    return node->box() ? node->box()->zIndex() : 0;
 }
 
-void StackingContext::remove_element(std::shared_ptr<LayoutNode> element) {
-    elements.erase(
-        std::remove(elements.begin(), elements.end(), element),
-        elements.end()
-    );
+double opacityOf(const LayoutNode* node) {
+    return node->box() ? node->box()->opacity() : 1.0;
 }
 
-std::vector<std::shared_ptr<LayoutNode>> StackingContext::get_elements() const {
-    return elements;
+} // namespace
+
+// StackingContext implementation
+StackingContext::StackingContext()
+    : root_(nullptr)
+    , members_() {
+}
+
+StackingContext::StackingContext(LayoutNode* root)
+    : root_(root)
+    , members_() {
+}
+
+void StackingContext::gather() {
+    members_.clear();
+    if (!root_) return;
+
+    for (auto* child : root_->children()) {
+        collect(child, false);
+    }
+
+    // Child contexts in the z-index layers go by z-index, then tree order
+    std::stable_sort(members_.begin(), members_.end(), [](const Member& a, const Member& b) {
+        if (a.layer != b.layer) return a.layer < b.layer;
+        if (a.layer == PaintLayer::NegativeZ || a.layer == PaintLayer::PositiveZ) {
+            return zIndexOf(a.node) < zIndexOf(b.node);
+        }
+        return false;
+    });
+}
+
+void StackingContext::collect(LayoutNode* node, bool inFloat) {
+    if (formsStackingContext(node)) {
+        members_.push_back(Member{node, layerForZIndex(zIndexOf(node)), true});
+        return;
+    }
+
+    bool floating = inFloat || node->isFloating();
+    PaintLayer layer = floating ? PaintLayer::Float
+                     : node->isInlineLevel() ? PaintLayer::Inline
+                     : PaintLayer::Block;
+    members_.push_back(Member{node, layer, false});
+    for (auto* child : node->children()) {
+        collect(child, floating);
+    }
 }
 
-void StackingContext::set_z_index(int z) {
-    z_index = z;
+bool StackingContext::formsStackingContext(const LayoutNode* node) {
+    return node->isStackingContext() || node->isPositioned();
 }
 
-int StackingContext::get_z_index() const {
-    return z_index;
+PaintLayer StackingContext::layerForZIndex(ZIndex zIndex) {
+    if (zIndex < 0) return PaintLayer::NegativeZ;
+    if (zIndex > 0) return PaintLayer::PositiveZ;
+    return PaintLayer::ZeroZ;
+}
+
+// PaintOrderList implementation
+PaintOrderList::PaintOrderList()
+    : items_()
+    , contexts_()
+    , freeContexts_()
+    , contextOf_()
+    , changed_()
+    , tree_(nullptr)
+    , root_(nullptr)
+    , structureVersion_(0)
+    , version_(0)
+    , rebuildCount_(0)
+    , regatherCount_(0) {
+}
+
+void PaintOrderList::update(const LayoutTree& tree) {
+    if (&tree != tree_ || tree.root() != root_ || tree.arena().structureVersion() != structureVersion_) {
+        rebuild(tree);
+        return;
+    }
+    if (changed_.empty()) return;
+
+    std::vector<uint32_t> dirty;
+    dirty.reserve(changed_.size());
+    for (auto* node : changed_) {
+        uint32_t context = enclosingContext(node);
+        if (context != kNoContext) {
+            dirty.push_back(context);
+        }
+    }
+    changed_.clear();
+
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    for (uint32_t context : dirty) {
+        regather(context);
+    }
+
+    items_.clear();
+    flatten(contextOf_[root_->index()], PaintLayer::Root);
+    ++version_;
+}
+
+void PaintOrderList::invalidate(LayoutNode* node) {
+    if (!tree_ || !node || node->tree() != tree_) return;
+
+    // Cheaper to start over than to chase this many changes
+    if (changed_.size() >= items_.size()) {
+        reset();
+        return;
+    }
+    changed_.push_back(node);
 }
 
-void StackingContext::sort_by_z_index() {
-    std::sort(elements.begin(), elements.end(),
-        [](const std::shared_ptr<LayoutNode>& a, const std::shared_ptr<LayoutNode>& b) {
-            return a->get_z_index() < b->get_z_index();
-        });
+void PaintOrderList::reset() {
+    tree_ = nullptr;
+    root_ = nullptr;
+    items_.clear();
+    contexts_.clear();
+    freeContexts_.clear();
+    contextOf_.clear();
+    changed_.clear();
+}
+
+void PaintOrderList::rebuild(const LayoutTree& tree) {
+    reset();
+    tree_ = &tree;
+    root_ = tree.root();
+    structureVersion_ = tree.arena().structureVersion();
+    ++rebuildCount_;
+    ++version_;
+
+    contextOf_.assign(tree.arena().end(), kNoContext);
+    if (!root_) return;
+
+    uint32_t context = createContext(root_);
+    regather(context);
+    flatten(context, PaintLayer::Root);
+}
+
+uint32_t PaintOrderList::createContext(LayoutNode* root) {
+    uint32_t context;
+    if (!freeContexts_.empty()) {
+        context = freeContexts_.back();
+        freeContexts_.pop_back();
+        contexts_[context] = StackingContext(root);
+    } else {
+        context = static_cast<uint32_t>(contexts_.size());
+        contexts_.emplace_back(root);
+    }
+    contextOf_[root->index()] = context;
+    return context;
+}
+
+void PaintOrderList::releaseContext(uint32_t context) {
+    contextOf_[contexts_[context].root()->index()] = kNoContext;
+    contexts_[context] = StackingContext();
+    freeContexts_.push_back(context);
+}
+
+void PaintOrderList::regather(uint32_t context) {
+    if (!contexts_[context].root()) return;
+
+    std::vector<LayoutNode*> before;
+    for (const auto& member : contexts_[context].members()) {
+        if (member.isStackingContext) before.push_back(member.node);
+    }
+
+    contexts_[context].gather();
+    ++regatherCount_;
+
+    // New contexts are collected from scratch; ones that stopped being a
+    // context have handed their members to this one
+    std::vector<LayoutNode*> created;
+    for (const auto& member : contexts_[context].members()) {
+        if (member.isStackingContext && contextOf_[member.node->index()] == kNoContext) {
+            created.push_back(member.node);
+        }
+    }
+    for (auto* node : before) {
+        uint32_t previous = contextOf_[node->index()];
+        if (previous != kNoContext && !StackingContext::formsStackingContext(node)) {
+            releaseContext(previous);
+        }
+    }
+    for (auto* node : created) {
+        regather(createContext(node));
+    }
+}
+
+uint32_t PaintOrderList::enclosingContext(const LayoutNode* node) const {
+    if (node == root_) return contextOf_[root_->index()];
+
+    for (const LayoutNode* ancestor = node->parent(); ancestor; ancestor = ancestor->parent()) {
+        uint32_t context = contextOf_[ancestor->index()];
+        if (context != kNoContext && (ancestor == root_ || StackingContext::formsStackingContext(ancestor))) {
+            return context;
+        }
+    }
+    return kNoContext;
+}
+
+void PaintOrderList::flatten(uint32_t context, PaintLayer layer) {
+    const StackingContext& stackingContext = contexts_[context];
+    LayoutNode* root = stackingContext.root();
+
+    size_t start = items_.size();
+    items_.push_back(PaintItem{root, 0, zIndexOf(root), opacityOf(root), layer, true});
+    for (const auto& member : stackingContext.members()) {
+        if (member.isStackingContext) {
+            flatten(contextOf_[member.node->index()], member.layer);
+        } else {
+            uint32_t next = static_cast<uint32_t>(items_.size() + 1);
+            items_.push_back(PaintItem{member.node, next, zIndexOf(member.node), opacityOf(member.node),
+                                       member.layer, false});
+        }
+    }
+    items_[start].end = static_cast<uint32_t>(items_.size());
 }
 
 } // namespace layout
@@ -0,0 +1,185 @@
+#include "layout/task_pool.h"
+
+namespace layout {
+
+namespace {
+
+// Pool and queue of the worker running on this thread
+struct WorkerSlot {
+    const TaskPool* pool = nullptr;
+    size_t index = 0;
+};
+
+thread_local WorkerSlot currentWorker;
+
+} // namespace
+
+// TaskPool implementation
+TaskPool::TaskPool(size_t workerCount)
+    : queues_()
+    , threads_()
+    , queued_(0)
+    , tasksRun_(0)
+    , tasksStolen_(0)
+    , sleepMutex_()
+    , wake_()
+    , stopRequested_(false) {
+    for (size_t i = 0; i <= workerCount; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    threads_.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        threads_.emplace_back(&TaskPool::workerLoop, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopRequested_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void TaskPool::submit(TaskGroup& group, Task task) {
+    group.pending_.fetch_add(1, std::memory_order_relaxed);
+
+    Queue& queue = *queues_[queueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(Job{std::move(task), &group});
+    }
+    {
+        // Taken so a worker cannot miss the count change between its check
+        // and its wait
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        queued_.fetch_add(1, std::memory_order_release);
+    }
+    wake_.notify_one();
+}
+
+bool TaskPool::runOne() {
+    Job job;
+    if (!popJob(job)) return false;
+
+    runJob(job);
+    return true;
+}
+
+bool TaskPool::popJob(Job& job) {
+    if (queued_.load(std::memory_order_acquire) == 0) return false;
+
+    // Own queue first, newest task first
+    size_t self = queueIndex();
+    {
+        Queue& queue = *queues_[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Then steal the oldest task of another queue
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        Queue& queue = *queues_[(self + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            tasksStolen_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::runJob(Job& job) {
+    std::exception_ptr error;
+    try {
+        job.task();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    tasksRun_.fetch_add(1, std::memory_order_relaxed);
+    job.group->finish(error);
+}
+
+void TaskPool::workerLoop(size_t index) {
+    currentWorker.pool = this;
+    currentWorker.index = index;
+
+    while (true) {
+        if (runOne()) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this] {
+            return stopRequested_ || queued_.load(std::memory_order_acquire) > 0;
+        });
+        if (stopRequested_) return;
+    }
+}
+
+size_t TaskPool::queueIndex() const {
+    return currentWorker.pool == this ? currentWorker.index : threads_.size();
+}
+
+// TaskGroup implementation
+TaskGroup::TaskGroup(TaskPool* pool)
+    : pool_(pool && pool->workerCount() > 0 ? pool : nullptr)
+    , pending_(0)
+    , errorMutex_()
+    , error_() {
+}
+
+TaskGroup::~TaskGroup() {
+    // Tasks refer to the group, so it cannot go away before they finish
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::run(TaskPool::Task task) {
+    if (pool_) {
+        pool_->submit(*this, std::move(task));
+    } else {
+        task();
+    }
+}
+
+void TaskGroup::wait() {
+    while (pending_.load(std::memory_order_acquire) > 0) {
+        // Help out instead of blocking; any queued task will do
+        if (!pool_->runOne()) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        std::swap(error, error_);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void TaskGroup::finish(std::exception_ptr error) {
+    if (error) {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        if (!error_) {
+            error_ = error;
+        }
+    }
+    pending_.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+} // namespace layout
@@ -1,4 +1,7 @@
 #include "layout/text_layout.h"
+#include "layout/layout_trace.h"
+#include "layout/text_run_cache.h"
+#include "layout/text_scanner.h"
 #include <algorithm>
 #include <cmath>
 
@@ -10,6 +13,7 @@ TextLayout::TextLayout() = default;
 TextLayout::~TextLayout() = default;
 
 void TextLayout::layoutText(LayoutNode* node, const LayoutConstraints& constraints) {
+    LAYOUT_TRACE_SCOPE(LayoutPhase::Text);
     if (!node) return;
     
     // Calculate text size
@@ -93,14 +97,8 @@ void TextLayout::breakLines(LayoutNode* node) {
     const std::string& text = node->textContent();
     if (text.empty()) return;
     
-    // Get available width
-    double availableWidth = node->parent() ? node->parent()->getBounds().width : 1000;
-    
-    // Get font metrics
-    const FontMetrics& metrics = node->fontMetrics();
-    
-    // Break text into lines
-    std::vector<std::string> lines = breakTextIntoLines(text, availableWidth, metrics);
+    // Break text into lines beside the floats of the formatting context
+    std::vector<std::string> lines = breakTextAroundFloats(node);
     
     // Process lines
     for (const auto& line : lines) {
@@ -169,9 +167,8 @@ double TextLayout::calculateBaseline(LayoutNode* node) {
 }
 
 Size TextLayout::measureText(const std::string& text, const FontMetrics& metrics) {
-    // Measure text size based on font metrics
-    // This is a simplified implementation
-    return Size(text.length() * 10, 20); // Approximate size
+    // Word widths come from the shared text-run cache
+    return Size(TextRunCache::shared().measureWidth(metrics, text), 20);
 }
 
 double TextLayout::measureTextWidth(const std::string& text, const FontMetrics& metrics) {
@@ -191,18 +188,100 @@ std::vector<TextRun> TextLayout::createTextRuns(const std::string& text, const F
 }
 
 std::vector<std::string> TextLayout::breakTextIntoLines(const std::string& text, double maxWidth, const FontMetrics& metrics) {
-    // Break text into lines based on available width
-    // This is a simplified implementation
+    return breakTextIntoLines(text, [maxWidth](size_t) { return maxWidth; }, metrics);
+}
+
+std::vector<std::string> TextLayout::breakTextIntoLines(const std::string& text, const std::function<double(size_t)>& lineWidth,
+                                                        const FontMetrics& metrics) {
+    BreakOpportunityMap map = BreakOpportunityMap::scan(text);
+    TextRunCache& cache = TextRunCache::shared();
+    double spaceWidth = cache.advanceWidth(metrics, " ");
+    
+    // Segments run from one break opportunity to the next: content, then
+    // any whitespace, which collapses to a single space
+    struct Segment {
+        size_t start;
+        size_t contentEnd;
+        bool trailingSpace;
+    };
+    std::vector<Segment> segments;
+    // prefix[i] is the width of segments [0, i) including their spaces
+    std::vector<double> prefix(1, 0.0);
+    size_t start = map.nextNonWhitespace(0);
+    while (start < text.size()) {
+        size_t next = map.nextBreakOpportunity(start + 1);
+        size_t contentEnd = std::min(map.nextWhitespace(start), next);
+        bool trailingSpace = contentEnd < next;
+        double contentWidth = cache.advanceWidth(metrics, text.substr(start, contentEnd - start));
+        segments.push_back(Segment{start, contentEnd, trailingSpace});
+        prefix.push_back(prefix.back() + contentWidth + (trailingSpace ? spaceWidth : 0));
+        start = next;
+    }
+    
+    // Width of segments [first, end) without the last one's space
+    auto segmentsWidth = [&](size_t first, size_t end) {
+        return prefix[end] - prefix[first] - (segments[end - 1].trailingSpace ? spaceWidth : 0);
+    };
+    
+    // Greedy breaking; a line holds at least one segment
     std::vector<std::string> lines;
-    // In a real implementation, this would break text into lines
+    size_t first = 0;
+    while (first < segments.size()) {
+        double maxWidth = lineWidth(lines.size());
+        size_t end = first + 1;
+        while (end < segments.size() && segmentsWidth(first, end + 1) <= maxWidth) {
+            ++end;
+        }
+        
+        std::string line;
+        for (size_t i = first; i < end; ++i) {
+            line.append(text, segments[i].start, segments[i].contentEnd - segments[i].start);
+            if (segments[i].trailingSpace && i + 1 < end) {
+                line += ' ';
+            }
+        }
+        lines.push_back(std::move(line));
+        first = end;
+    }
     return lines;
 }
 
+LayoutOpportunity TextLayout::lineBoxAt(const LayoutNode* container, double top, double height) const {
+    if (!container) return LayoutOpportunity{0, 0};
+    
+    // Floats are kept in the root's coordinates
+    const LayoutNode* root = container->getFormattingContextRoot();
+    Point origin = container->offsetFrom(root);
+    LayoutOpportunity opportunity = root->exclusionSpace().availableSpace(origin.y + top, height);
+    return LayoutOpportunity{std::max(opportunity.left - origin.x, 0.0),
+                             std::min(opportunity.right - origin.x, container->getBounds().width)};
+}
+
+std::vector<std::string> TextLayout::breakTextAroundFloats(LayoutNode* node) {
+    if (!node) return std::vector<std::string>();
+    
+    const LayoutNode* container = node->parent();
+    const FontMetrics& metrics = node->fontMetrics();
+    if (!container) return breakTextIntoLines(node->textContent(), 1000, metrics);
+    
+    // Each line asks the exclusion space once, in O(log n) floats
+    double lineHeight = node->lineHeight() > 0 ? node->lineHeight() : measureTextHeight(" ", metrics);
+    double top = node->getBounds().y;
+    return breakTextIntoLines(node->textContent(), [&](size_t line) {
+        return lineBoxAt(container, top + line * lineHeight, lineHeight).width();
+    }, metrics);
+}
+
 std::vector<std::string> TextLayout::breakTextIntoWords(const std::string& text) {
-    // Break text into words
-    // This is a simplified implementation
+    // Words are the runs between collapsible whitespace
+    BreakOpportunityMap map = BreakOpportunityMap::scan(text);
     std::vector<std::string> words;
-    // In a real implementation, this would break text into words
+    size_t start = map.nextNonWhitespace(0);
+    while (start < text.size()) {
+        size_t end = map.nextWhitespace(start);
+        words.push_back(text.substr(start, end - start));
+        start = map.nextNonWhitespace(end);
+    }
     return words;
 }
 
@@ -0,0 +1,163 @@
+#include "layout/text_run_cache.h"
+#include "layout/layout_trace.h"
+#include <cctype>
+#include <functional>
+
+namespace layout {
+
+// TextRunCache implementation
+TextRunCache::TextRunCache(size_t capacity)
+    : shards_(kShardCount)
+    , capacity_(capacity)
+    , hits_(0)
+    , misses_(0) {
+}
+
+TextRunCache& TextRunCache::shared() {
+    static TextRunCache cache;
+    return cache;
+}
+
+double TextRunCache::advanceWidth(const FontMetrics& metrics, const std::string& segment) {
+    Key key{FontKey(metrics), segment};
+    size_t hash = KeyHash()(key);
+    Shard& shard = shards_[hash % kShardCount];
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second.use);
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            LAYOUT_TRACE_CACHE_HIT();
+            return it->second.width;
+        }
+    }
+
+    // Shape outside the lock; a racing thread computes the same width
+    double width = shapeAdvanceWidth(metrics, segment);
+    misses_.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto [it, inserted] = shard.entries.emplace(std::move(key), Shard::Entry{width, {}});
+    if (inserted) {
+        shard.lru.push_front(&it->first);
+        it->second.use = shard.lru.begin();
+        evict(shard, shardCapacity());
+    }
+    return width;
+}
+
+double TextRunCache::measureWidth(const FontMetrics& metrics, const std::string& text) {
+    double width = 0;
+    size_t start = 0;
+    while (start < text.size()) {
+        bool space = std::isspace(static_cast<unsigned char>(text[start])) != 0;
+        size_t end = start + 1;
+        while (end < text.size() && (std::isspace(static_cast<unsigned char>(text[end])) != 0) == space) {
+            ++end;
+        }
+        width += advanceWidth(metrics, text.substr(start, end - start));
+        start = end;
+    }
+    return width;
+}
+
+void TextRunCache::setCapacity(size_t capacity) {
+    capacity_.store(capacity, std::memory_order_relaxed);
+    size_t limit = shardCapacity();
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        evict(shard, limit);
+    }
+}
+
+void TextRunCache::clear() {
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.lru.clear();
+        shard.entries.clear();
+    }
+}
+
+void TextRunCache::purge(size_t entries) {
+    size_t limit = entries / kShardCount;
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        evict(shard, limit);
+    }
+}
+
+size_t TextRunCache::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.entries.size();
+    }
+    return total;
+}
+
+size_t TextRunCache::memoryUsage() const {
+    // Hash and list nodes cost their payload plus about two pointers each
+    constexpr size_t kEntryBytes = sizeof(Key) + sizeof(Shard::Entry) + 2 * sizeof(void*);
+    constexpr size_t kUseBytes = sizeof(const Key*) + 2 * sizeof(void*);
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.entries.bucket_count() * sizeof(void*) + shard.entries.size() * (kEntryBytes + kUseBytes);
+        for (const auto& entry : shard.entries) {
+            if (entry.first.segment.capacity() > sizeof(std::string)) total += entry.first.segment.capacity();
+        }
+    }
+    return total;
+}
+
+void TextRunCache::resetStats() {
+    hits_.store(0, std::memory_order_relaxed);
+    misses_.store(0, std::memory_order_relaxed);
+}
+
+// Each shard holds an equal part, and at least one entry
+size_t TextRunCache::shardCapacity() const {
+    size_t capacity = capacity_.load(std::memory_order_relaxed);
+    return capacity / kShardCount > 0 ? capacity / kShardCount : 1;
+}
+
+void TextRunCache::evict(Shard& shard, size_t limit) {
+    while (shard.entries.size() > limit) {
+        const Key* oldest = shard.lru.back();
+        shard.lru.pop_back();
+        shard.entries.erase(shard.entries.find(*oldest));
+    }
+}
+
+// Simplified shaping: a fixed advance per character, as the rest of the
+// library assumes
+double TextRunCache::shapeAdvanceWidth(const FontMetrics&, const std::string& segment) {
+    return segment.length() * 10.0;
+}
+
+// Key helpers
+TextRunCache::FontKey::FontKey(const FontMetrics& metrics)
+    : ascent(metrics.ascent)
+    , descent(metrics.descent)
+    , leading(metrics.leading)
+    , xHeight(metrics.xHeight)
+    , capHeight(metrics.capHeight) {
+}
+
+bool TextRunCache::FontKey::operator==(const FontKey& other) const {
+    return ascent == other.ascent && descent == other.descent && leading == other.leading &&
+           xHeight == other.xHeight && capHeight == other.capHeight;
+}
+
+size_t TextRunCache::KeyHash::operator()(const Key& key) const {
+    std::hash<double> hashDouble;
+    size_t hash = std::hash<std::string>()(key.segment);
+    for (double field : {key.font.ascent, key.font.descent, key.font.leading, key.font.xHeight, key.font.capHeight}) {
+        hash ^= hashDouble(field) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+} // namespace layout
@@ -0,0 +1,132 @@
+#include "layout/text_scanner.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace layout {
+
+namespace {
+
+bool isCollapsibleWhitespace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+// Sets bit i of whitespace and hyphens for the corresponding byte of a
+// 64-byte block
+void classifyBlock(const unsigned char* bytes, uint64_t& whitespace, uint64_t& hyphens) {
+#if defined(__AVX2__)
+    whitespace = 0;
+    hyphens = 0;
+    for (size_t offset = 0; offset < 64; offset += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + offset));
+        __m256i space = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\f'))));
+        __m256i hyphen = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-'));
+        whitespace |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(space))) << offset;
+        hyphens |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hyphen))) << offset;
+    }
+#elif defined(__SSE2__)
+    whitespace = 0;
+    hyphens = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + offset));
+        __m128i space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\f'))));
+        __m128i hyphen = _mm_cmpeq_epi8(v, _mm_set1_epi8('-'));
+        whitespace |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(space))) << offset;
+        hyphens |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(hyphen))) << offset;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    // NEON has no movemask; weight each lane by its bit and add the halves
+    const uint8x16_t weights = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    auto toMask = [&weights](uint8x16_t lanes) {
+        uint8x16_t bits = vandq_u8(lanes, weights);
+        return static_cast<uint64_t>(vaddv_u8(vget_low_u8(bits))) |
+               (static_cast<uint64_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+    };
+    whitespace = 0;
+    hyphens = 0;
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        uint8x16_t v = vld1q_u8(bytes + offset);
+        uint8x16_t space = vorrq_u8(
+            vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+            vorrq_u8(
+                vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))),
+                vceqq_u8(v, vdupq_n_u8('\f'))));
+        uint8x16_t hyphen = vceqq_u8(v, vdupq_n_u8('-'));
+        whitespace |= toMask(space) << offset;
+        hyphens |= toMask(hyphen) << offset;
+    }
+#else
+    whitespace = 0;
+    hyphens = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        whitespace |= static_cast<uint64_t>(isCollapsibleWhitespace(bytes[i])) << i;
+        hyphens |= static_cast<uint64_t>(bytes[i] == '-') << i;
+    }
+#endif
+}
+
+} // namespace
+
+// BreakOpportunityMap implementation
+BreakOpportunityMap BreakOpportunityMap::scan(const std::string& text) {
+    BreakOpportunityMap map;
+    map.length_ = text.size();
+
+    size_t wordCount = (text.size() + 63) / 64;
+    map.whitespace_.assign(wordCount, 0);
+    map.breaks_.assign(wordCount, 0);
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    // Whitespace or hyphen in the last byte of the previous word
+    uint64_t carry = 0;
+    for (size_t word = 0; word < wordCount; ++word) {
+        size_t start = word * 64;
+        size_t count = text.size() - start < 64 ? text.size() - start : 64;
+
+        uint64_t whitespace = 0;
+        uint64_t hyphens = 0;
+        if (count == 64) {
+            classifyBlock(bytes + start, whitespace, hyphens);
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                whitespace |= static_cast<uint64_t>(isCollapsibleWhitespace(bytes[start + i])) << i;
+                hyphens |= static_cast<uint64_t>(bytes[start + i] == '-') << i;
+            }
+        }
+
+        uint64_t valid = count == 64 ? ~0ull : (1ull << count) - 1;
+        uint64_t after = ((whitespace | hyphens) << 1) | carry;
+        map.whitespace_[word] = whitespace;
+        map.breaks_[word] = after & ~whitespace & valid;
+        carry = ((whitespace | hyphens) >> 63) & 1;
+    }
+    return map;
+}
+
+size_t BreakOpportunityMap::findBit(const std::vector<uint64_t>& bits, size_t from, bool inverted) const {
+    if (from >= length_) return length_;
+
+    size_t word = from / 64;
+    uint64_t current = (inverted ? ~bits[word] : bits[word]) & (~0ull << (from % 64));
+    while (true) {
+        if (current) {
+            size_t index = word * 64 + static_cast<size_t>(__builtin_ctzll(current));
+            return index < length_ ? index : length_;
+        }
+        if (++word >= bits.size()) return length_;
+        current = inverted ? ~bits[word] : bits[word];
+    }
+}
+
+} // namespace layout
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include <memory>
+
+namespace renderer {
+
+class DisplayList;
+
+// Where a Renderer's draws go: display lists in, pixels on its target out
+//
+// Lists are recorded in device space and queued by draw(); nothing reaches
+// the target until flush(), so a backend sees a whole frame at once and can
+// reorder and batch it as long as the result is the same.
+class Backend {
+public:
+    virtual ~Backend();
+
+    virtual BackendType type() const = 0;
+
+    // Target size in device pixels; what falls outside is not drawn
+    virtual void resize(int width, int height) = 0;
+
+    // Queues list to be drawn over what was queued before it
+    virtual void draw(std::shared_ptr<const DisplayList> list) = 0;
+    // Submits everything queued since the last flush
+    virtual void flush() = 0;
+    // Flushes and waits until the target holds the result
+    virtual void finish() = 0;
+};
+
+} // namespace renderer
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "enums.h"
+#include <cstdint>
+
+namespace renderer {
+
+// Instruction sets the blend kernels are built for
+enum class BlendIsa {
+    Scalar,
+    SSE41,
+    AVX2,
+    NEON
+};
+
+// Span kernels over premultiplied RGBA8 pixels, four bytes each
+//
+// Solid fills and source-over, multiply and screen have vector versions;
+// the remaining blend modes run the scalar formulas of the compositing
+// spec on every target. The vector set is picked once, from what the CPU
+// reports, the first time a kernel runs.
+
+// Replaces count pixels with a premultiplied color
+void fillSpan(uint8_t* dst, int count, const uint8_t color[4]);
+
+// Blends a premultiplied color over count pixels; coverage, when given,
+// scales the color per pixel
+void blendSpan(uint8_t* dst, int count, const uint8_t color[4], const uint8_t* coverage, BlendMode mode);
+
+// Blends count premultiplied source pixels, scaled by alpha, over dst
+void compositeSpan(uint8_t* dst, const uint8_t* src, int count, BlendMode mode, uint8_t alpha = 255);
+
+// Kernel selection
+BlendIsa blendIsa();
+// The widest set this CPU runs
+BlendIsa bestBlendIsa();
+// Forces a set, for comparing kernels; fails if the CPU cannot run it
+bool setBlendIsa(BlendIsa isa);
+
+} // namespace renderer
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace renderer {
+
+// Gaussian blur of 8-bit coverage masks
+//
+// The Gaussian is approximated by three box blurs per axis, whose widths
+// are picked to match its variance, so a pass costs the same at any
+// radius. Vertical passes run down all columns at once with the vector
+// set blend.h selected; horizontal passes run on the transposed mask. Past
+// kMaxDirectSigma the mask is box-downsampled by powers of two, blurred
+// with the reduced sigma and upsampled bilinearly, which the blur hides.
+// Pixels outside the mask count as transparent.
+
+constexpr double kMaxDirectSigma = 8.0;
+
+// How far a blur of sigma spreads coverage, in pixels: three deviations,
+// past which the Gaussian is below 8-bit precision
+int blurOutset(double sigma);
+
+// Blurs width x height coverage bytes, stride bytes apart, in place
+void blurMask(uint8_t* mask, int width, int height, int stride, double sigma);
+
+} // namespace renderer
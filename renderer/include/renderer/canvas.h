@@ -23,6 +23,8 @@ class Device;
 class Backend;
 class Layer;
 class Compositor;
+class DisplayList;
+class DisplayListRecorder;
 
 // Canvas class for drawing operations
 class Canvas {
@@ -149,6 +151,16 @@ public:
     void drawCanvas(const Canvas& canvas, const Rect& destRect);
     void drawCanvas(const Canvas& canvas, const Rect& srcRect, const Rect& destRect);
 
+    // Recording: from beginRecording() to finishRecording() draw and state
+    // calls are captured into a display list instead of drawn. Recording
+    // starts from an identity matrix and no clip, and the canvas's own
+    // state is restored when it finishes.
+    void beginRecording();
+    std::shared_ptr<const DisplayList> finishRecording();
+    bool isRecording() const { return recorder_ != nullptr; }
+    // Replays list, skipping what lies outside the clip
+    void drawDisplayList(const DisplayList& list);
+
     // Clear operations
     void clear();
     void clear(const Color& color);
@@ -287,6 +299,11 @@ private:
     bool isValid_;
     bool isReady_;
 
+    // Recording state
+    std::unique_ptr<DisplayListRecorder> recorder_;
+    CanvasState recordingState_;
+    size_t recordingDepth_;
+
     // Helper methods
     void copyFrom(const Canvas& other);
     void moveFrom(Canvas&& other);
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "path_cache.h"
+#include "lru_byte_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace renderer {
+
+class Path;
+
+// Coverage of a clip, one byte per device pixel
+struct ClipMask {
+    // Pixels covered: x, y up to x + width, y + height
+    int x;
+    int y;
+    int width;
+    int height;
+    // Row by row; 255 is inside the clip
+    std::vector<uint8_t> coverage;
+
+    const uint8_t* row(int py) const { return coverage.data() + static_cast<size_t>(py - y) * width; }
+    size_t byteSize() const { return sizeof(ClipMask) + coverage.size(); }
+};
+
+// A mask on the surface, moved by dx, dy
+struct PlacedClipMask {
+    std::shared_ptr<const ClipMask> mask;
+    int dx;
+    int dy;
+
+    int left() const { return mask->x + dx; }
+    int top() const { return mask->y + dy; }
+    int right() const { return left() + mask->width; }
+    int bottom() const { return top() + mask->height; }
+    // Coverage of surface pixel x, y, which must be in the mask
+    uint8_t at(int px, int py) const { return mask->row(py - dy)[px - dx - mask->x]; }
+};
+
+// Covers edges, in local space, mapped through the affine matrix and filled
+// with rule; antiAlias covers four subscanlines exactly, otherwise whole
+// pixels whose centers are inside. nullptr when nothing is covered.
+std::shared_ptr<ClipMask> rasterizeClip(const std::vector<PathEdge>& edges, const Matrix& matrix, FillRule rule,
+                                        bool antiAlias);
+
+// Where both masks cover; nullptr when that is nothing
+std::shared_ptr<ClipMask> intersectClips(const PlacedClipMask& a, const PlacedClipMask& b);
+
+// Where mask does not cover, within left, top, right, bottom
+std::shared_ptr<ClipMask> invertClip(const PlacedClipMask& mask, int left, int top, int right, int bottom);
+
+// Coverage masks of path clips by path generation and transform
+//
+// A clip is cached in the space of its transform less the transform's
+// whole-pixel translation, so a clip that scrolled by whole pixels places
+// its mask at an offset instead of covering the path again, and nested
+// rounded or clip-path containers cost a lookup a frame. Curves come from
+// a PathCache. Masks are immutable and shared, and the cache is safe to use
+// from any thread.
+class ClipMaskCache {
+public:
+    static constexpr size_t kDefaultBudget = 8 << 20;
+
+    using Stats = LruByteCacheStats;
+
+    explicit ClipMaskCache(size_t budgetBytes = kDefaultBudget);
+
+    // Cache shared by the rasterizers that are not given one
+    static std::shared_ptr<ClipMaskCache> shared();
+
+    // Mask of path under the affine matrix, placed on the surface; a null
+    // mask for an empty path or one covering nothing
+    PlacedClipMask get(const Path& path, const Matrix& matrix, bool antiAlias, PathCache& paths);
+
+    size_t budget() const { return cache_.budget(); }
+    void setBudget(size_t bytes) { cache_.setBudget(bytes); }
+    void clear() { cache_.clear(); }
+    // Evicts least recently used entries until at most bytes remain
+    void purge(size_t bytes = 0) { cache_.purge(bytes); }
+    Stats stats() const { return cache_.stats(); }
+
+private:
+    struct Key {
+        uint32_t path;
+        double m11;
+        double m12;
+        double m21;
+        double m22;
+        // Translation's fraction of a pixel, in 1/64 pixels
+        int fractionX;
+        int fractionY;
+        FillRule rule;
+        bool antiAlias;
+
+        bool operator==(const Key& other) const {
+            return path == other.path && m11 == other.m11 && m12 == other.m12 && m21 == other.m21 &&
+                   m22 == other.m22 && fractionX == other.fractionX && fractionY == other.fractionY &&
+                   rule == other.rule && antiAlias == other.antiAlias;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    LruByteCache<Key, ClipMask, KeyHash> cache_;
+};
+
+} // namespace renderer
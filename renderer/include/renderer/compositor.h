@@ -0,0 +1,117 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "damage_region.h"
+#include "layer.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer {
+
+// Retained compositor of a Layer tree into a framebuffer
+//
+// Every composite() flattens the tree into placements: each visible layer
+// with its layer-to-device matrix and accumulated opacity. Comparing them
+// with the last frame's gives the damage, the old and new bounds of every
+// layer that moved, faded or changed. Only layers whose content changed
+// are rasterized; then only the damaged rects of the framebuffer are
+// recomposited from the layers' cached pixels. A frame that only animates
+// transforms or opacity rasterizes nothing.
+//
+// Translated layers composite straight from their cache rows; other
+// transforms sample the cache bilinearly.
+//
+// Scrolling happens here too. Children of a scroll container are placed
+// at its scroll offset and clipped to its (device-space bounding) rect,
+// and sticky layers are moved by their constraint against the nearest
+// scroll container, so a scroll is a composite of moved cached pixels:
+// no layout, no raster, and a cost independent of the page behind it.
+// Fixed elements are layers outside the scrolled document's container.
+class Compositor {
+public:
+    Compositor(int width, int height);
+    ~Compositor();
+
+    Compositor(const Compositor&) = delete;
+    Compositor& operator=(const Compositor&) = delete;
+
+    const std::shared_ptr<Layer>& root() const { return root_; }
+    void setRoot(std::shared_ptr<Layer> root);
+
+    // Framebuffer size; resizing damages all of it
+    int width() const { return width_; }
+    int height() const { return height_; }
+    void resize(int width, int height);
+
+    // Damages rect, in device pixels, for the next composite()
+    void invalidate(const Rect& rect);
+
+    // Brings the framebuffer up to date; returns the region recomposited
+    const DamageRegion& composite();
+
+    // Drops every layer's cached pixels, e.g. while the page is hidden
+    void releaseLayerCaches();
+
+    // Premultiplied RGBA8 framebuffer
+    ImageData pixels() { return ImageData(framebuffer_.data(), width_, height_, 4); }
+    const uint8_t* data() const { return framebuffer_.data(); }
+    // Unpremultiplied color of one pixel
+    Color pixel(int x, int y) const;
+
+    // Statistics of the last composite()
+    struct Stats {
+        size_t layers = 0;
+        size_t layersRasterized = 0;
+        size_t tilesRasterized = 0;
+        // Layer-rect pairs composited
+        size_t layersComposited = 0;
+        // Sticky layers moved off their laid-out position
+        size_t stickyLayersShifted = 0;
+        double damagedArea = 0;
+    };
+    const Stats& lastStats() const { return stats_; }
+
+private:
+    // A layer as composited this frame
+    struct Placement {
+        Layer* layer;
+        Matrix matrix;
+        Matrix inverse;
+        double opacity;
+        BlendMode blendMode;
+        Rect bounds;
+    };
+
+    int width_;
+    int height_;
+    std::vector<uint8_t> framebuffer_;
+    std::shared_ptr<Layer> root_;
+    std::vector<Placement> placements_;
+    // Last frame's placements, by layer
+    std::unordered_map<const Layer*, Placement> previous_;
+    DamageRegion damage_;
+    DamageRegion composited_;
+    std::vector<uint8_t> sampled_;
+    Stats stats_;
+
+    // What a layer inherits from the layers above it
+    struct Inherited {
+        Matrix matrix;
+        double opacity;
+        // Device-space clip of the scroll containers above
+        Rect clip;
+        // Nearest scroll container above, or nullptr
+        const Layer* scroller;
+    };
+
+    void flatten(Layer* layer, const Inherited& inherited);
+    void collectDamage();
+    void compositeRect(const Rect& rect);
+    void compositeLayer(const Placement& placement, int left, int top, int right, int bottom);
+};
+
+} // namespace renderer
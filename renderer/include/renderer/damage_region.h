@@ -0,0 +1,50 @@
+#pragma once
+
+#include "types.h"
+#include <cstddef>
+#include <vector>
+
+namespace renderer {
+
+// Dirty area of a surface as a short list of rects
+//
+// Added rects are snapped out to whole pixels. A rect merges with another
+// when their union wastes little area, and when the list outgrows its limit
+// the pair whose union wastes least merges. A caret and a spinner far apart
+// so stay two small rects instead of one that spans the window.
+class DamageRegion {
+public:
+    static constexpr size_t kDefaultMaxRects = 8;
+
+    explicit DamageRegion(size_t maxRects = kDefaultMaxRects);
+
+    void add(const Rect& rect);
+    void add(const DamageRegion& other);
+    void clear() { rects_.clear(); }
+
+    bool isEmpty() const { return rects_.empty(); }
+    size_t size() const { return rects_.size(); }
+    const std::vector<Rect>& rects() const { return rects_; }
+
+    // Union of the rects
+    Rect bounds() const;
+    // Sum of the rect areas; merged rects may overlap a little
+    double area() const;
+
+    bool intersects(const Rect& rect) const;
+    // Drops whatever lies outside rect
+    void clipTo(const Rect& rect);
+
+    size_t maxRects() const { return maxRects_; }
+
+private:
+    std::vector<Rect> rects_;
+    size_t maxRects_;
+
+    // Area the union of a and b adds beyond a and b themselves
+    static double waste(const Rect& a, const Rect& b);
+    // Merges rects_[index] with every rect it is worth merging with
+    void coalesce(size_t index);
+};
+
+} // namespace renderer
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "canvas.h"
+#include "image.h"
+#include "paint.h"
+#include "path.h"
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer {
+
+// Recorded canvas operation
+enum class DisplayOp : uint8_t {
+    Save,
+    SaveLayer,
+    Restore,
+    SetMatrix,
+    ClipRect,
+    ClipPath,
+    DrawColor,
+    DrawPaint,
+    DrawRect,
+    DrawRoundRect,
+    DrawOval,
+    DrawArc,
+    DrawPath,
+    DrawLine,
+    DrawPoints,
+    DrawImage,
+    DrawText,
+    DrawTextBlob,
+    Clear
+};
+
+// One recorded operation. Its numbers live in the list's argument pool
+// and its paint, text, path, image or blob in the list's tables.
+struct DisplayItem {
+    DisplayOp op;
+    // BlendMode, PointMode, useCenter or clip flags, by op
+    uint8_t mode;
+    // Draws the whole clip, so it is never culled
+    bool unbounded;
+    uint32_t paint;
+    // First argument in args()
+    uint32_t args;
+    // Into the table of the op's kind
+    uint32_t data;
+    // Device-space bounds at recording time
+    Rect bounds;
+};
+
+// Immutable list of canvas operations, recorded by Canvas::beginRecording()
+//
+// Operations are fixed-size items whose arguments sit in one pool, so a
+// list is a handful of contiguous arrays whatever it draws. Paints are
+// interned: the list holds one handle per distinct paint, shared with
+// every other list that draws with an equal one. Once finished a list is only read,
+// so it can be recorded on one thread and replayed on another.
+class DisplayList {
+public:
+    static constexpr uint32_t kNoPaint = 0xFFFFFFFFu;
+    // Clip flags: the clip is antialiased, and keeps what is outside it
+    static constexpr uint8_t kClipAntiAlias = 0x01;
+    static constexpr uint8_t kClipOut = 0x02;
+
+    DisplayList();
+
+    // Replays into canvas under its current matrix, skipping draws whose
+    // bounds fall outside its clip
+    void playback(Canvas& canvas) const;
+
+    bool empty() const { return items_.empty(); }
+    size_t size() const { return items_.size(); }
+    const std::vector<DisplayItem>& items() const { return items_; }
+    const std::vector<double>& args() const { return args_; }
+    const Paint& paint(uint32_t index) const { return paints_[index]->paint(); }
+    // Interned id of a paint, equal across lists for equal paints
+    uint32_t paintId(uint32_t index) const { return paints_[index]->id(); }
+    const std::string& text(uint32_t index) const { return texts_[index]; }
+    const Path& path(uint32_t index) const { return paths_[index]; }
+    const Image& image(uint32_t index) const { return images_[index]; }
+    const TextBlob& blob(uint32_t index) const { return blobs_[index]; }
+
+    // Union of the bounded items' bounds
+    const Rect& bounds() const { return bounds_; }
+    // Some item draws everywhere it is not clipped
+    bool hasUnboundedItems() const { return hasUnboundedItems_; }
+    // Approximate heap size
+    size_t memoryUsage() const;
+
+    // Statistics of the last playback(); written by const calls, so not
+    // to be read while another thread replays the list
+    size_t culledCount() const { return culled_; }
+
+private:
+    friend class DisplayListRecorder;
+
+    std::vector<DisplayItem> items_;
+    std::vector<double> args_;
+    std::vector<PaintHandle> paints_;
+    std::vector<std::string> texts_;
+    std::vector<Path> paths_;
+    std::vector<Image> images_;
+    std::vector<TextBlob> blobs_;
+    Rect bounds_;
+    bool hasUnboundedItems_;
+    mutable size_t culled_;
+
+    Point point(uint32_t arg) const { return Point(args_[arg], args_[arg + 1]); }
+    Rect rect(uint32_t arg) const { return Rect(args_[arg], args_[arg + 1], args_[arg + 2], args_[arg + 3]); }
+    Matrix matrix(uint32_t arg) const;
+    void replay(Canvas& canvas, const DisplayItem& item, const Matrix& base) const;
+};
+
+// Builds a DisplayList from the calls of a recording Canvas
+class DisplayListRecorder {
+public:
+    DisplayListRecorder();
+
+    // State operations, recorded as the canvas makes them; bounds is
+    // nullptr for an unbounded layer
+    void save();
+    void saveLayer(const Rect* bounds, const Paint& paint);
+    void restore();
+    void setMatrix(const Matrix& matrix);
+    void clipRect(const Rect& rect, uint8_t flags = 0);
+    void clipPath(const Path& path, uint8_t flags = 0);
+
+    // Draws; their bounds are taken from the arguments, mapped through the
+    // recording matrix and clipped
+    void drawColor(const Color& color, BlendMode blendMode);
+    void drawPaint(const Paint& paint);
+    void drawRect(const Rect& rect, const Paint& paint);
+    void drawRoundRect(const Rect& rect, double rx, double ry, const Paint& paint);
+    void drawOval(const Rect& rect, const Paint& paint);
+    void drawArc(const Rect& rect, double startAngle, double sweepAngle, bool useCenter, const Paint& paint);
+    void drawPath(const Path& path, const Paint& paint);
+    void drawLine(const Point& start, const Point& end, const Paint& paint);
+    void drawPoints(const std::vector<Point>& points, PointMode mode, const Paint& paint);
+    void drawImage(const Image& image, const Rect& srcRect, const Rect& destRect, const Paint& paint);
+    // extent is what the text covers; bounds, when given, is passed on to
+    // Canvas::drawText on replay
+    void drawText(const std::string& text, const Point& point, const Paint& paint, const Rect& extent,
+                  const Rect* bounds);
+    void drawTextBlob(const TextBlob& blob, const Point& point, const Paint& paint, const Rect& extent);
+    void clear(const Rect* rect, const Color& color);
+
+    // Device-space matrix and clip of the recording canvas, after each
+    // state operation
+    void setState(const Matrix& matrix, const Rect& clip) { matrix_ = matrix; clip_ = clip; }
+
+    // Hands the list over; the recorder starts a new one
+    std::shared_ptr<const DisplayList> finish();
+
+private:
+    std::shared_ptr<DisplayList> list_;
+    // The list's paint table by interned id, and the entry used last
+    std::unordered_map<uint32_t, uint32_t> paintIndex_;
+    uint32_t lastPaint_;
+    Matrix matrix_;
+    // Empty when unclipped, as on Canvas
+    Rect clip_;
+
+    uint32_t addPaint(const Paint& paint);
+    uint32_t addArgs(std::initializer_list<double> values);
+    // Appends a draw, or drops it when bounds are clipped out
+    void addDraw(DisplayOp op, const Rect* bounds, uint32_t paint, uint32_t args, uint32_t data = 0, uint8_t mode = 0);
+    void addState(DisplayOp op, uint32_t paint, uint32_t args, uint32_t data = 0, uint8_t mode = 0);
+    // Local bounds grown by what paint draws outside the geometry
+    static Rect paintBounds(const Rect& rect, const Paint& paint);
+};
+
+} // namespace renderer
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace renderer {
+
+// Where a FrameBuffer's pixels live
+enum class FrameBufferMemory : uint8_t {
+    // Heap memory the buffer allocated
+    Owned,
+    // Memory the caller owns and keeps alive
+    External,
+    // A memfd or POSIX shared-memory segment another process can map
+    SharedMemory,
+    // A dma-buf, mapped for CPU access
+    DmaBuf
+};
+
+// Premultiplied RGBA8 pixels a frame is rasterized into and handed over in
+//
+// A SoftwareRasterizer targets the buffer's pixels directly, so the
+// embedder reads the frame where it was drawn. Shared-memory and dma-buf
+// buffers are mapped here and keep their file descriptor, which the
+// embedder passes to the process or device that presents them; all
+// factories return nullptr where the memory cannot be had. CPU access to a
+// dma-buf has to be bracketed by beginAccess() and endAccess() so the
+// device's caches stay coherent; for other memory they do nothing.
+class FrameBuffer {
+public:
+    ~FrameBuffer();
+
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+    static std::shared_ptr<FrameBuffer> allocate(int width, int height);
+    // Wraps stride-byte rows at pixels, which must outlive the buffer
+    static std::shared_ptr<FrameBuffer> wrap(uint8_t* pixels, int width, int height, int stride);
+    // Creates a shared-memory segment of the frame and maps it
+    static std::shared_ptr<FrameBuffer> createShared(int width, int height);
+    // Maps a shared-memory segment or dma-buf the caller created; the
+    // buffer takes ownership of fd
+    static std::shared_ptr<FrameBuffer> importShared(int fd, int width, int height, int stride, size_t offset = 0);
+    static std::shared_ptr<FrameBuffer> importDmaBuf(int fd, int width, int height, int stride, size_t offset = 0);
+
+    FrameBufferMemory memory() const { return memory_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    // Bytes from one row to the next
+    int stride() const { return stride_; }
+    uint8_t* pixels() { return pixels_; }
+    const uint8_t* pixels() const { return pixels_; }
+    ImageData imageData() { return ImageData(pixels_, width_, height_, 4, stride_); }
+    // Descriptor of shared memory and dma-bufs, -1 for others
+    int fd() const { return fd_; }
+    // Where the pixels start within fd
+    size_t offset() const { return offset_; }
+
+    // Brackets CPU reads and writes of the pixels
+    void beginAccess(bool write);
+    void endAccess(bool write);
+
+private:
+    FrameBuffer(FrameBufferMemory memory, int width, int height, int stride);
+
+    FrameBufferMemory memory_;
+    int width_;
+    int height_;
+    int stride_;
+    uint8_t* pixels_;
+    std::unique_ptr<uint8_t[]> owned_;
+    int fd_;
+    size_t offset_;
+    // The mapping, which starts a page before pixels_ when offset_ is not
+    // page aligned
+    void* mapping_;
+    size_t mappingSize_;
+
+    static std::shared_ptr<FrameBuffer> map(FrameBufferMemory memory, int fd, int width, int height, int stride,
+                                            size_t offset);
+};
+
+} // namespace renderer
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer {
+
+class Paint;
+
+// Glyph identity in the cache
+struct GlyphKey {
+    // Hash of family, weight and style
+    uint64_t face;
+    // Pixel size in 1/64 px
+    uint32_t size;
+    // Horizontal pen offset in quarter pixels, 0-3
+    uint8_t subpixel;
+    uint32_t glyph;
+
+    bool operator==(const GlyphKey& other) const {
+        return face == other.face && size == other.size && subpixel == other.subpixel && glyph == other.glyph;
+    }
+};
+
+struct GlyphKeyHash {
+    size_t operator()(const GlyphKey& key) const;
+};
+
+// Coverage of one glyph, as a glyph rasterizer produces it
+struct GlyphBitmap {
+    int width = 0;
+    int height = 0;
+    // Offset of the bitmap's top left from the pen on the baseline
+    int left = 0;
+    int top = 0;
+    double advance = 0;
+    std::vector<uint8_t> coverage;
+};
+
+// A cached glyph to blit: where it sits in the atlas and on the surface
+struct GlyphQuad {
+    int atlasX;
+    int atlasY;
+    int width;
+    int height;
+    int x;
+    int y;
+};
+
+// Rasterizes glyphs once into a shared 8-bit coverage atlas
+//
+// Glyphs are keyed by face, size, quarter-pixel pen offset and glyph id and
+// packed into shelves of the atlas. Text becomes a list of quads that blit
+// atlas rows as coverage. When the atlas is full the least recently used
+// shelf is evicted, except shelves used since the last beginFrame(), whose
+// quads may still be waiting to be drawn.
+//
+// Glyph ids are code points: the tree has no font files or cmap to map
+// through. The default rasterizer draws each visible code point as the
+// missing-glyph box, so text has its real extent; setRasterizer() plugs in
+// real outlines.
+class GlyphCache {
+public:
+    using Rasterizer = std::function<void(const GlyphKey& key, const FontMetrics& font, GlyphBitmap& bitmap)>;
+
+    static constexpr int kDefaultAtlasSize = 512;
+
+    explicit GlyphCache(int atlasWidth = kDefaultAtlasSize, int atlasHeight = kDefaultAtlasSize);
+
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    // Cache used for measuring text; never blitted from
+    static GlyphCache& shared();
+
+    void setRasterizer(Rasterizer rasterizer);
+
+    // Font a paint draws text with
+    static FontMetrics fontFor(const Paint& paint);
+    static uint64_t faceId(const FontMetrics& font);
+
+    // Starts a frame: quads handed out from now on stay valid until the
+    // next call
+    void beginFrame();
+
+    // Appends the quads of text with its pen starting at origin, in pixels;
+    // returns the pen advance
+    double layout(const std::string& text, const FontMetrics& font, const Point& origin,
+                  std::vector<GlyphQuad>& quads);
+    // Advance and height of text, without producing quads
+    Size measure(const std::string& text, const FontMetrics& font);
+    // Box of text drawn with its pen starting at origin on the baseline
+    Rect bounds(const std::string& text, const FontMetrics& font, const Point& origin);
+
+    // Atlas for blitting: one coverage byte per pixel
+    const uint8_t* atlas() const { return atlas_.data(); }
+    int atlasWidth() const { return atlasWidth_; }
+    int atlasHeight() const { return atlasHeight_; }
+    // Changes whenever atlas pixels do, for backends that keep a copy
+    uint64_t atlasVersion() const;
+
+    // Memory budget reporting
+    struct Stats {
+        size_t glyphs = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        // Glyphs that did not fit; they are not drawn this frame
+        size_t dropped = 0;
+        size_t atlasBytes = 0;
+        // Atlas bytes holding glyphs
+        size_t usedBytes = 0;
+    };
+    Stats stats() const;
+
+    void clear();
+
+private:
+    struct Shelf {
+        int y;
+        int height;
+        int used;
+        uint64_t lastUse;
+    };
+
+    struct Entry {
+        int atlasX;
+        int atlasY;
+        int width;
+        int height;
+        int left;
+        int top;
+        double advance;
+        // Into shelves_, or -1 for glyphs with no pixels
+        int shelf;
+    };
+
+    int atlasWidth_;
+    int atlasHeight_;
+    std::vector<uint8_t> atlas_;
+    std::vector<Shelf> shelves_;
+    int nextShelfY_;
+    std::unordered_map<GlyphKey, Entry, GlyphKeyHash> entries_;
+    Rasterizer rasterizer_;
+    // Shelves last used in the current frame are not evicted
+    uint64_t frame_;
+    uint64_t atlasVersion_;
+    Stats stats_;
+    mutable std::mutex mutex_;
+
+    // Fills entry, rasterizing on a miss; false when the glyph has no
+    // pixels in the atlas, being blank or out of room this frame
+    bool lookup(const GlyphKey& key, const FontMetrics& font, Entry& entry);
+    // Atlas slot for a bitmap; false when none is free this frame
+    bool allocate(int width, int height, int& x, int& y, int& shelf);
+    void evictShelf(size_t index);
+
+    static void rasterizeMissingGlyph(const GlyphKey& key, const FontMetrics& font, GlyphBitmap& bitmap);
+};
+
+} // namespace renderer
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "backend.h"
+#include "glyph_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer {
+
+class DisplayList;
+class ImageBitmap;
+struct DisplayItem;
+
+// Shader programs of the GPU backend; each draws one quad per instance
+enum class GpuPipeline : uint8_t {
+    // Rects and round rects by distance, filled or stroked; lines and
+    // points are rotated rects
+    Rect,
+    // Ellipses by distance, filled or stroked
+    Oval,
+    // Premultiplied RGBA8 texture
+    Image,
+    // 8-bit coverage texture tinted by the instance color
+    Glyph
+};
+
+// How an instance's shape is covered
+enum class GpuStyle : uint8_t {
+    Fill,
+    Stroke,
+    FillAndStroke
+};
+
+// One quad of an instanced draw, as the vertex shader reads it
+//
+// Every pipeline reads the same layout, so all instances of a frame share
+// one buffer and batches are ranges of it.
+struct GpuInstance {
+    // Local to device: x' = a x + c y + e, y' = b x + d y + f
+    float transform[6];
+    // Shape in local units: the rect, or the oval's bounds
+    float rect[4];
+    // Corner radii of Rect
+    float radii[2];
+    // Half the stroke width in local units
+    float halfStroke;
+    GpuStyle style;
+    // Coverage is hard-edged
+    uint8_t aliased;
+    // Premultiplied RGBA8
+    uint8_t color[4];
+    // Texture rect in texels, for Image and Glyph
+    float uv[4];
+    // Device clip; pixel centers outside are discarded
+    float clip[4];
+};
+
+// Everything that forces a change of GPU state between draws
+struct GpuPipelineKey {
+    GpuPipeline pipeline;
+    BlendMode blendMode;
+    // Writes the color instead of blending it, for clears
+    bool replace;
+    // Texture the pipeline samples, 0 for none
+    uint32_t texture;
+
+    bool operator==(const GpuPipelineKey& other) const {
+        return pipeline == other.pipeline && blendMode == other.blendMode && replace == other.replace &&
+               texture == other.texture;
+    }
+    bool operator!=(const GpuPipelineKey& other) const { return !(*this == other); }
+};
+
+// One instanced draw: a range of the frame's instances under one key
+struct GpuBatch {
+    GpuPipelineKey key;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    // Union of the instances' device bounds
+    Rect bounds;
+};
+
+// What one flush() submits
+struct GpuFrame {
+    int width = 0;
+    int height = 0;
+    std::vector<GpuInstance> instances;
+    // Drawn in order
+    std::vector<GpuBatch> batches;
+};
+
+// The graphics API under GpuBackend
+//
+// An implementation owns the pipelines, the instance buffer and the
+// textures; Vulkan, GLES3 or Metal each plug in here. submit() is one
+// upload of the instances and one instanced draw per batch, each after
+// binding its key's pipeline and texture.
+class GpuDevice {
+public:
+    virtual ~GpuDevice();
+
+    // Creates a texture from pixels, or replaces the pixels of texture id
+    // when it is not 0, and returns its id; channels is 1 or 4
+    virtual uint32_t uploadTexture(uint32_t id, const uint8_t* pixels, int width, int height, int channels) = 0;
+    virtual void releaseTexture(uint32_t id) = 0;
+
+    virtual void submit(const GpuFrame& frame) = 0;
+    // Blocks until submitted frames have been drawn
+    virtual void wait() = 0;
+};
+
+// Backend that draws display lists as batched, instanced GPU draws
+//
+// Queued lists are resolved at flush(): their transforms, clips and layer
+// opacity become per-instance data, as in SoftwareRasterizer, and each draw
+// becomes one or more instances. A draw joins the most recent batch with
+// its key unless a batch after that one overlaps it, looking back
+// kBatchLookback batches, so interleaved draws that do not overlap still
+// share a pipeline and the result matches drawing in list order. The frame
+// then goes to the device in one submit().
+//
+// Text is laid out in the backend's GlyphCache, whose atlas is one texture
+// uploaded when it changes. Images upload their bitmaps once, again as
+// more rows decode. Arcs and paths other than one rect, round rect or
+// oval need tessellation the pipelines do not have; they are counted as
+// unsupported and not drawn. For the same reason path clips clip to their
+// bounds and clip-outs are ignored.
+class GpuBackend : public Backend {
+public:
+    static constexpr size_t kBatchLookback = 16;
+
+    explicit GpuBackend(std::shared_ptr<GpuDevice> device, BackendType type = BackendType::Vulkan);
+    ~GpuBackend() override;
+
+    GpuBackend(const GpuBackend&) = delete;
+    GpuBackend& operator=(const GpuBackend&) = delete;
+
+    BackendType type() const override { return type_; }
+    void resize(int width, int height) override;
+    void draw(std::shared_ptr<const DisplayList> list) override;
+    void flush() override;
+    void finish() override;
+
+    const std::shared_ptr<GpuDevice>& device() const { return device_; }
+    GlyphCache& glyphCache() { return glyphCache_; }
+
+    // The frame of the last flush()
+    const GpuFrame& lastFrame() const { return frame_; }
+
+    // Statistics of the last flush()
+    struct Stats {
+        size_t draws = 0;
+        size_t instances = 0;
+        size_t batches = 0;
+        // Batches whose pipeline differs from the one before
+        size_t pipelineChanges = 0;
+        size_t textureUploads = 0;
+        // Draws the pipelines cannot express, which were dropped
+        size_t unsupported = 0;
+    };
+    const Stats& lastStats() const { return stats_; }
+
+private:
+    // A batch being built; its instances are flattened into the frame
+    struct PendingBatch {
+        GpuPipelineKey key;
+        Rect bounds;
+        std::vector<GpuInstance> instances;
+    };
+
+    struct Texture {
+        std::weak_ptr<const ImageBitmap> bitmap;
+        uint32_t id;
+        // Rows uploaded so far
+        int rows;
+    };
+
+    // Device state of the draw being mapped
+    struct DrawState {
+        Matrix matrix;
+        Rect clip;
+        double alpha;
+    };
+
+    BackendType type_;
+    std::shared_ptr<GpuDevice> device_;
+    int width_;
+    int height_;
+    std::vector<std::shared_ptr<const DisplayList>> queued_;
+    GpuFrame frame_;
+    std::vector<PendingBatch> batches_;
+    Stats stats_;
+
+    GlyphCache glyphCache_;
+    std::vector<GlyphQuad> glyphQuads_;
+    uint32_t atlasTexture_;
+    uint64_t atlasVersion_;
+    std::unordered_map<const ImageBitmap*, Texture> textures_;
+
+    void resolve(const DisplayList& list);
+    void addDraw(const DisplayList& list, const DisplayItem& item, const DrawState& state);
+    void addText(const DisplayList& list, const DisplayItem& item, const DrawState& state, const uint8_t color[4]);
+    void addImage(const DisplayList& list, const DisplayItem& item, const DrawState& state, const uint8_t color[4]);
+    // Adds instance to the batch it can join, or to a new one
+    void addInstance(const GpuPipelineKey& key, const GpuInstance& instance, const Rect& bounds);
+    uint32_t textureFor(const std::shared_ptr<const ImageBitmap>& bitmap, int& rows);
+    void releaseTextures(bool all);
+};
+
+} // namespace renderer
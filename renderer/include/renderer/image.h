@@ -1,27 +1,87 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 namespace renderer {
 
+// Decoded pixels, premultiplied RGBA8
+//
+// A decoder fills the rows top to bottom and publishes them as it goes, so
+// a partly loaded image can be drawn from readyRows() while the rest is
+// still being decoded on another thread. A complete bitmap also has a mip
+// chain, built level by level the first time a level is asked for.
+class ImageBitmap {
+public:
+    ImageBitmap(int width, int height);
+
+    ImageBitmap(const ImageBitmap&) = delete;
+    ImageBitmap& operator=(const ImageBitmap&) = delete;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    // Unique among the bitmaps of the process, for keying caches
+    uint64_t id() const { return id_; }
+    size_t stride() const { return static_cast<size_t>(width_) * 4; }
+    size_t byteSize() const { return pixels_.size(); }
+
+    const uint8_t* data() const { return pixels_.data(); }
+    const uint8_t* row(int y) const { return pixels_.data() + y * stride(); }
+    // For the decoder; rows below readyRows() must not change
+    uint8_t* row(int y) { return pixels_.data() + y * stride(); }
+
+    // Rows that are decoded and safe to read
+    int readyRows() const { return readyRows_.load(std::memory_order_acquire); }
+    bool isComplete() const { return readyRows() == height_; }
+    void publishRows(int rows) { readyRows_.store(rows, std::memory_order_release); }
+
+    // Level 0 is the bitmap itself; each level after it halves the one
+    // before, rounding down to at least one pixel, by averaging 2x2 blocks.
+    // nullptr past the 1x1 level, and for levels above 0 of an incomplete
+    // bitmap. Levels live as long as the bitmap.
+    const ImageBitmap* mipLevel(int level) const;
+    // Levels down to 1x1, counting level 0
+    int mipLevelCount() const;
+
+private:
+    int width_;
+    int height_;
+    uint64_t id_;
+    std::vector<uint8_t> pixels_;
+    std::atomic<int> readyRows_;
+    // Built levels, from level 1
+    mutable std::mutex mipMutex_;
+    mutable std::vector<std::unique_ptr<ImageBitmap>> mips_;
+};
+
 class Image {
 public:
     Image();
     ~Image();
 
+    // Whole-buffer decodes on the calling thread; ImageCache streams
     void load_from_file(const std::string& filename);
     void load_from_data(const std::vector<uint8_t>& data);
 
+    // Intrinsic size, which the bitmap may be decoded smaller than
     int get_width() const;
     int get_height() const;
     void set_width(int width);
     void set_height(int height);
 
+    // Decoded pixels, shared with copies of the image; nullptr until loaded
+    const std::shared_ptr<const ImageBitmap>& get_bitmap() const { return bitmap; }
+    void set_bitmap(std::shared_ptr<const ImageBitmap> bitmap);
+
 private:
     int width;
     int height;
+    std::shared_ptr<const ImageBitmap> bitmap;
 };
 
 } // namespace renderer
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "image.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer {
+
+class ImageDecoder;
+
+// Decoded images by key, within a byte budget
+//
+// Images are streamed in: begin() a key with the size it is laid out at,
+// append() network bytes as they arrive, finish() at the end. Bytes are
+// decoded on the cache's workers, one stream at a time per worker, and
+// get() returns the bitmap as far as it is decoded. The decoded bytes are
+// kept under the budget by evicting the least recently used complete
+// images; bitmaps already handed out stay alive with their holders.
+// Callers wanting one source at several sizes use a key per size.
+class ImageCache {
+public:
+    static constexpr size_t kDefaultBudget = 64 << 20;
+
+    // Called on a worker when rows of key are decoded, and once more when
+    // its stream ends
+    using DecodedCallback = std::function<void(const std::string& key, int readyRows)>;
+
+    // workerCount 0 decodes on the thread that appends
+    explicit ImageCache(size_t budgetBytes = kDefaultBudget, size_t workerCount = 1);
+    ~ImageCache();
+
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    // Starts streaming key, replacing what it held; the image is decoded to
+    // fit targetWidth x targetHeight, or at its own size for 0
+    void begin(const std::string& key, int targetWidth = 0, int targetHeight = 0);
+    void append(const std::string& key, const uint8_t* data, size_t size);
+    void append(const std::string& key, const std::vector<uint8_t>& data) { append(key, data.data(), data.size()); }
+    void finish(const std::string& key);
+
+    // Pixels of key decoded so far, nullptr before its header; marks it used
+    std::shared_ptr<const ImageBitmap> get(const std::string& key);
+    // Intrinsic size of key once its header is decoded
+    bool intrinsicSize(const std::string& key, int& width, int& height) const;
+    bool contains(const std::string& key) const;
+    void remove(const std::string& key);
+
+    void setDecodedCallback(DecodedCallback callback);
+
+    // Blocks until every appended byte is decoded
+    void waitIdle();
+
+    // Budget and purging; images still streaming are never evicted
+    size_t budget() const;
+    void setBudget(size_t bytes);
+    size_t byteSize() const;
+    // Evicts least recently used images until at most bytes remain
+    void purge(size_t bytes = 0);
+    // Drops to half the budget, or everything that can go when critical
+    void onMemoryPressure(bool critical);
+
+    struct Stats {
+        size_t images = 0;
+        size_t bytes = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t failed = 0;
+        // Rows published by decoders
+        size_t rowsDecoded = 0;
+    };
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::unique_ptr<ImageDecoder> decoder;
+        int targetWidth;
+        int targetHeight;
+        int intrinsicWidth;
+        int intrinsicHeight;
+        // Bytes waiting to be decoded
+        std::vector<uint8_t> input;
+        std::shared_ptr<ImageBitmap> bitmap;
+        size_t bytes;
+        int reportedRows;
+        bool finishing;
+        bool streaming;
+        // Queued or being decoded by a worker
+        bool scheduled;
+        bool removed;
+        std::list<Entry*>::iterator use;
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries_;
+    // Most recently used first
+    std::list<Entry*> uses_;
+    std::deque<std::shared_ptr<Entry>> queue_;
+    size_t decoding_;
+    size_t budget_;
+    size_t bytes_;
+    DecodedCallback callback_;
+    Stats stats_;
+    std::vector<std::thread> workers_;
+    bool stopRequested_;
+
+    void workerLoop();
+    // Decodes entry's pending input; returns with the lock held again
+    void decode(const std::shared_ptr<Entry>& entry, std::unique_lock<std::mutex>& lock);
+    void schedule(const std::shared_ptr<Entry>& entry, std::unique_lock<std::mutex>& lock);
+    void evict(size_t bytes);
+    void erase(Entry& entry);
+};
+
+} // namespace renderer
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "image.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace renderer {
+
+// Incremental decoder of one encoded image
+//
+// Bytes are appended as they arrive; each complete source row is decoded
+// into the bitmap and published at once, so the image shows progressively.
+// With a target size the rows are box-filtered down while decoding, and
+// only one accumulator row at the source width is ever held: a large photo
+// shown as a thumbnail never exists at full size in memory.
+//
+// Formats plug in by subclassing with a header parser and a row converter
+// and registering a factory under the format's signature. The tree ships
+// binary netpbm (P5 gray, P6 RGB, P7 PAM with alpha); there is no PNG or
+// JPEG codec to wrap here.
+class ImageDecoder {
+public:
+    enum class State {
+        Header,
+        Rows,
+        Complete,
+        Failed
+    };
+
+    using Factory = std::function<std::unique_ptr<ImageDecoder>()>;
+
+    // Bytes create() needs to recognize every built-in format
+    static constexpr size_t kSignatureBytes = 2;
+    // Headers claiming more source pixels fail; a few header bytes must
+    // not commit the decoder to unbounded work
+    static constexpr uint64_t kMaxSourcePixels = uint64_t{1} << 28;
+    // Bitmaps larger than this fail instead of being allocated
+    static constexpr size_t kDefaultMaxBytes = 256 << 20;
+
+    virtual ~ImageDecoder();
+
+    // Decoder for data that starts with a registered signature; nullptr if
+    // there is none or data is too short to tell yet
+    static std::unique_ptr<ImageDecoder> create(const uint8_t* data, size_t size);
+    static void registerFormat(const std::string& signature, Factory factory);
+
+    // Decodes to fit within this size, keeping the aspect ratio and never
+    // enlarging; 0 leaves a dimension free. Only honored before the header.
+    void setTargetSize(int width, int height);
+    // Largest bitmap, in bytes, the header may ask for. Only honored before
+    // the header.
+    void setMaxBytes(size_t bytes);
+
+    // Decodes what data completes; false once the data is malformed
+    bool append(const uint8_t* data, size_t size);
+    // No more data is coming; a truncated image fails but keeps its rows
+    void finish();
+
+    State state() const { return state_; }
+    bool hasHeader() const { return state_ != State::Header && bitmap_ != nullptr; }
+    int intrinsicWidth() const { return sourceWidth_; }
+    int intrinsicHeight() const { return sourceHeight_; }
+    // Created once the header is parsed
+    const std::shared_ptr<ImageBitmap>& bitmap() const { return bitmap_; }
+
+    // Bytes buffered, waiting for the rest of a row or the header
+    size_t bufferedBytes() const { return buffer_.size() - consumed_; }
+
+protected:
+    ImageDecoder();
+
+    // Parses the header at the start of data. Returns the bytes it spans
+    // and sets the size, or returns 0 to wait for more data; sets failed
+    // on malformed data.
+    virtual size_t parseHeader(const uint8_t* data, size_t size, int& width, int& height, bool& failed) = 0;
+    // Encoded bytes per source row
+    virtual size_t rowBytes() const = 0;
+    // One source row to premultiplied RGBA8
+    virtual void convertRow(const uint8_t* source, uint8_t* rgba) const = 0;
+
+private:
+    State state_;
+    int targetWidth_;
+    int targetHeight_;
+    size_t maxBytes_;
+    int sourceWidth_;
+    int sourceHeight_;
+    std::vector<uint8_t> buffer_;
+    size_t consumed_;
+    std::shared_ptr<ImageBitmap> bitmap_;
+    int sourceRow_;
+
+    // Downscaling: the source row converted, the sums of the output row
+    // being accumulated, and the source columns that land in each pixel
+    std::vector<uint8_t> converted_;
+    std::vector<uint64_t> sums_;
+    std::vector<uint32_t> columnCounts_;
+    int rowsSummed_;
+
+    // False when the sizes the header gave are beyond the limits
+    bool startRows();
+    void decodeRow(const uint8_t* source);
+    void emitRow(int row);
+};
+
+} // namespace renderer
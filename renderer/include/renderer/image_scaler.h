@@ -0,0 +1,100 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "image.h"
+#include "lru_byte_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace renderer {
+
+// Resampling filters for drawn images
+enum class ImageFilter : uint8_t {
+    Nearest,
+    Bilinear,
+    // Mitchell-Netravali, B = C = 1/3
+    Bicubic
+};
+
+// Filter a paint's rendering hint asks for: Fast is nearest, Quality
+// bilinear and Best bicubic
+ImageFilter imageFilterFor(RenderingHint hint);
+
+// Resamples source, in bitmap pixels, to width x height premultiplied pixels
+//
+// Filtering is separable: each output row is a weighted sum of source rows,
+// then each output pixel a weighted sum of that row's pixels, in 14-bit
+// fixed point, with SSE2 or NEON kernels where the target has them. When
+// shrinking, the filter widens to cover every source pixel, so nothing
+// aliases; bilinear and bicubic start from the mip level that leaves less
+// than a 2x reduction, so a thumbnail reads a few taps per pixel whatever
+// the size of the original. Taps never leave source, and rows the bitmap
+// has not decoded yet come out transparent. nullptr for an empty size.
+std::shared_ptr<ImageBitmap> scaleBitmap(const ImageBitmap& bitmap, const Rect& source, int width, int height,
+                                         ImageFilter filter);
+
+// Scaled images by bitmap, source rect, size and filter
+//
+// Gallery pages draw the same thumbnails at the same size frame after
+// frame; the rasterizer scales each once and blits the cached pixels
+// after. Entries of partly decoded bitmaps are keyed by their ready rows,
+// so each new batch of rows is scaled again. Scaled bitmaps are immutable
+// and shared, and the cache is safe to use from any thread.
+class ScaledImageCache {
+public:
+    static constexpr size_t kDefaultBudget = 16 << 20;
+
+    using Stats = LruByteCacheStats;
+
+    explicit ScaledImageCache(size_t budgetBytes = kDefaultBudget);
+
+    // Cache shared by the rasterizers that are not given one
+    static std::shared_ptr<ScaledImageCache> shared();
+
+    // bitmap's source rect scaled as by scaleBitmap()
+    std::shared_ptr<const ImageBitmap> get(const ImageBitmap& bitmap, const Rect& source, int width, int height,
+                                           ImageFilter filter);
+
+    size_t budget() const { return cache_.budget(); }
+    void setBudget(size_t bytes) { cache_.setBudget(bytes); }
+    void clear() { cache_.clear(); }
+    // Evicts least recently used entries until at most bytes remain
+    void purge(size_t bytes = 0) { cache_.purge(bytes); }
+    Stats stats() const { return cache_.stats(); }
+
+private:
+    struct Key {
+        uint64_t bitmap;
+        int readyRows;
+        // Source rect in 1/64 pixels
+        int sourceX;
+        int sourceY;
+        int sourceWidth;
+        int sourceHeight;
+        int width;
+        int height;
+        ImageFilter filter;
+
+        bool operator==(const Key& other) const {
+            return bitmap == other.bitmap && readyRows == other.readyRows && sourceX == other.sourceX &&
+                   sourceY == other.sourceY && sourceWidth == other.sourceWidth &&
+                   sourceHeight == other.sourceHeight && width == other.width && height == other.height &&
+                   filter == other.filter;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    // Pixels and the bitmap holding them
+    struct ImageBytes {
+        size_t operator()(const ImageBitmap& image) const { return sizeof(ImageBitmap) + image.byteSize(); }
+    };
+
+    LruByteCache<Key, ImageBitmap, KeyHash, ImageBytes> cache_;
+};
+
+} // namespace renderer
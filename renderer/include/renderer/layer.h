@@ -0,0 +1,139 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "damage_region.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace renderer {
+
+class DisplayList;
+class SoftwareRasterizer;
+class Compositor;
+
+// How a position: sticky layer follows the scroll container it sticks in
+//
+// Rects are in that container's content space as laid out, unscrolled.
+// Each side with an inset keeps the layer at least that far inside the
+// container's visible rect, but never pushes it out of its containing
+// block; where top and bottom (or left and right) disagree, top and left
+// win.
+struct StickyConstraint {
+    Rect stickyRect;
+    Rect containingRect;
+    EdgeInsets insets;
+    bool top = false;
+    bool right = false;
+    bool bottom = false;
+    bool left = false;
+
+    // Offset from the laid-out position with visible, the container's
+    // scrolled-to rect, showing
+    Point offset(const Rect& visible) const;
+};
+
+// Retained compositing layer
+//
+// A layer owns a display list and caches it rasterized at the layer's size.
+// Its position, transform, opacity and blend mode only say how the cache is
+// composited, so changing them never re-rasterizes: an element animating
+// transform or opacity gets a layer of its own and each frame just
+// recomposites. Changing the content or size does re-rasterize, the damaged
+// part only where invalidateContent() says so.
+class Layer {
+public:
+    Layer();
+    explicit Layer(const Size& size);
+    ~Layer();
+
+    Layer(const Layer&) = delete;
+    Layer& operator=(const Layer&) = delete;
+
+    // Tree; children composite after their parent, in order
+    Layer* parent() const { return parent_; }
+    const std::vector<std::shared_ptr<Layer>>& children() const { return children_; }
+    void addChild(std::shared_ptr<Layer> child);
+    void removeChild(Layer* child);
+    void removeFromParent();
+
+    // Content size; resizing re-rasterizes everything
+    const Size& size() const { return size_; }
+    void setSize(const Size& size);
+
+    // Placement in the parent: the transform applies about the position
+    const Point& position() const { return position_; }
+    void setPosition(const Point& position);
+    const Matrix& transform() const { return transform_; }
+    void setTransform(const Matrix& transform);
+    // Layer to parent space
+    Matrix localMatrix() const { return Matrix::translation(position_.x, position_.y) * transform_; }
+
+    // Compositing; opacity multiplies into the children's
+    double opacity() const { return opacity_; }
+    void setOpacity(double opacity);
+    BlendMode blendMode() const { return blendMode_; }
+    void setBlendMode(BlendMode mode);
+    bool isVisible() const { return visible_; }
+    void setVisible(bool visible);
+
+    // Scrolling: a scroll container clips its children to its size and
+    // composites them moved by -scrollOffset(). Its own content stays put.
+    // A scroll only changes how cached pixels are placed, so it never
+    // re-rasterizes and never needs layout.
+    bool isScrollContainer() const { return scrollContainer_; }
+    void setScrollContainer(bool scrollContainer);
+    const Point& scrollOffset() const { return scrollOffset_; }
+    void setScrollOffset(const Point& offset);
+
+    // position: sticky, resolved against the nearest scroll container
+    // above this layer at every composite; nullptr when not sticky
+    const StickyConstraint* stickyConstraint() const { return sticky_ ? &stickyConstraint_ : nullptr; }
+    void setStickyConstraint(const StickyConstraint& constraint);
+    void clearStickyConstraint();
+
+    // Content, drawn in layer space
+    const std::shared_ptr<const DisplayList>& content() const { return content_; }
+    // Replaces the content and re-rasterizes all of it
+    void setContent(std::shared_ptr<const DisplayList> content);
+    // Replaces the content; only rect, in layer space, is re-rasterized
+    void setContent(std::shared_ptr<const DisplayList> content, const Rect& changed);
+    void invalidateContent(const Rect& rect);
+
+    bool needsRaster() const { return !contentDamage_.isEmpty(); }
+    // Cached pixels, nullptr before the first raster
+    const SoftwareRasterizer* raster() const { return raster_.get(); }
+    // Drops the cached pixels; the next composite rasterizes all of the
+    // content again
+    void releaseRaster();
+
+    // Bumped by every change, content or compositing
+    uint64_t version() const { return version_; }
+
+private:
+    friend class Compositor;
+
+    Layer* parent_;
+    std::vector<std::shared_ptr<Layer>> children_;
+    Size size_;
+    Point position_;
+    Matrix transform_;
+    double opacity_;
+    BlendMode blendMode_;
+    bool visible_;
+    bool scrollContainer_;
+    Point scrollOffset_;
+    bool sticky_;
+    StickyConstraint stickyConstraint_;
+    std::shared_ptr<const DisplayList> content_;
+    // Layer-space area whose cache is stale
+    DamageRegion contentDamage_;
+    std::unique_ptr<SoftwareRasterizer> raster_;
+    uint64_t version_;
+
+    // Brings the cache up to date; returns the tiles rasterized
+    size_t rasterize();
+};
+
+} // namespace renderer
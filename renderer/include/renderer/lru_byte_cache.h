@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace renderer {
+
+struct LruByteCacheStats {
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+};
+
+// Bytes a cached value is charged; by default what it reports itself
+template <typename Value>
+struct ValueByteSize {
+    size_t operator()(const Value& value) const { return value.byteSize(); }
+};
+
+// Immutable shared values by key, within a byte budget
+//
+// The rasterizer's caches of masks, geometry and scaled pixels differ only
+// in their key and in how a value is built from it; this holds the values
+// and evicts the least recently used once the bytes charged pass the
+// budget. Misses build without the lock, so a slow build does not hold up
+// threads hitting other keys; threads missing the same key at once may all
+// build it, and all get the value stored first. Safe to use from any
+// thread.
+template <typename Key, typename Value, typename Hash, typename ByteSize = ValueByteSize<Value>>
+class LruByteCache {
+public:
+    using Stats = LruByteCacheStats;
+
+    explicit LruByteCache(size_t budgetBytes)
+        : mutex_()
+        , entries_()
+        , uses_()
+        , budget_(budgetBytes)
+        , bytes_(0)
+        , stats_() {
+    }
+
+    LruByteCache(const LruByteCache&) = delete;
+    LruByteCache& operator=(const LruByteCache&) = delete;
+
+    // Value of key, or on a miss what build() returns; a null value is
+    // returned without being cached
+    template <typename Build>
+    std::shared_ptr<const Value> get(const Key& key, Build&& build) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it != entries_.end()) {
+                ++stats_.hits;
+                uses_.splice(uses_.begin(), uses_, it->second.use);
+                return it->second.value;
+            }
+            ++stats_.misses;
+        }
+
+        std::shared_ptr<const Value> value = build();
+        if (!value) return nullptr;
+        size_t bytes = ByteSize()(*value);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) return it->second.value;
+
+        uses_.push_front(key);
+        entries_.emplace(key, Entry{value, bytes, uses_.begin()});
+        bytes_ += bytes;
+        evict(budget_);
+        return value;
+    }
+
+    size_t budget() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return budget_;
+    }
+
+    void setBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        budget_ = bytes;
+        evict(budget_);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        uses_.clear();
+        bytes_ = 0;
+    }
+
+    // Evicts least recently used entries until at most bytes remain
+    void purge(size_t bytes = 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        evict(bytes);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats stats = stats_;
+        stats.entries = entries_.size();
+        stats.bytes = bytes_;
+        return stats;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const Value> value;
+        size_t bytes;
+        typename std::list<Key>::iterator use;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<Key, Entry, Hash> entries_;
+    // Most recently used first
+    std::list<Key> uses_;
+    size_t budget_;
+    size_t bytes_;
+    Stats stats_;
+
+    void evict(size_t limit) {
+        while (bytes_ > limit && !uses_.empty()) {
+            auto it = entries_.find(uses_.back());
+            bytes_ -= it->second.bytes;
+            entries_.erase(it);
+            uses_.pop_back();
+            ++stats_.evictions;
+        }
+    }
+};
+
+} // namespace renderer
@@ -2,7 +2,11 @@
 
 #include "types.h"
 #include "enums.h"
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace renderer {
@@ -180,6 +184,8 @@ public:
     // Equality
     bool operator==(const Paint& other) const;
     bool operator!=(const Paint& other) const { return !(*this == other); }
+    // Equal paints hash equally
+    size_t hash() const;
 
     // Reset to default values
     void reset();
@@ -269,4 +275,59 @@ private:
     void cleanup();
 };
 
+// A paint interned by PaintInterner: immutable, shared by every equal
+// paint interned while it lives, and named by an id caches can key on
+class InternedPaint {
+public:
+    InternedPaint(const Paint& paint, size_t hash, uint32_t id) : paint_(paint), hash_(hash), id_(id) {}
+
+    const Paint& paint() const { return paint_; }
+    size_t hash() const { return hash_; }
+    // Never reused by another paint
+    uint32_t id() const { return id_; }
+
+private:
+    Paint paint_;
+    size_t hash_;
+    uint32_t id_;
+};
+
+using PaintHandle = std::shared_ptr<const InternedPaint>;
+
+// Hashes paints into shared immutable handles
+//
+// A paint is copied once, when no equal paint is interned, and every later
+// equal paint gets the same handle and id. The interner holds the paints
+// weakly: one lives as long as a handle to it. Safe to use from any thread.
+class PaintInterner {
+public:
+    PaintInterner();
+
+    PaintInterner(const PaintInterner&) = delete;
+    PaintInterner& operator=(const PaintInterner&) = delete;
+
+    // Interner of display lists
+    static PaintInterner& shared();
+
+    PaintHandle intern(const Paint& paint);
+
+    struct Stats {
+        // Paints with a live handle
+        size_t paints = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+    Stats stats() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_multimap<size_t, std::weak_ptr<const InternedPaint>> entries_;
+    uint32_t nextId_;
+    // Entry count at which released paints are swept out
+    size_t sweepAt_;
+    Stats stats_;
+
+    void sweep();
+};
+
 } // namespace renderer
@@ -1,7 +1,20 @@
 #pragma once
 
+#include "types.h"
+#include "enums.h"
+#include <cstdint>
+#include <vector>
+
 namespace renderer {
 
+// Path commands; each consumes the points after the previous one's
+enum class PathVerb : uint8_t {
+    Move,   // 1 point
+    Line,   // 1 point
+    Cubic,  // 3 points
+    Close   // none
+};
+
 class Path {
 public:
     Path();
@@ -13,14 +26,56 @@ public:
     void close_path();
 
     void add_rect(float x, float y, float width, float height);
+    void add_round_rect(float x, float y, float width, float height, float rx, float ry);
     void add_circle(float cx, float cy, float radius);
     void add_ellipse(float cx, float cy, float rx, float ry);
 
     void clear();
     bool is_empty() const;
 
+    FillRule get_fill_rule() const { return fillRule_; }
+    void set_fill_rule(FillRule rule) { fillRule_ = rule; }
+
+    const std::vector<PathVerb>& verbs() const { return verbs_; }
+    const std::vector<Point>& points() const { return points_; }
+
+    // Bounds of the points; curves stay inside their control points
+    Rect get_bounds() const { return bounds_; }
+
+    // Names the geometry: copies share it and every edit makes a new one,
+    // so caches can key flattened paths by it. 0 for an empty path.
+    uint32_t generation_id() const { return generationId_; }
+
+    // Whether the path is exactly one shape of that kind, added to an empty
+    // path, which rasterizers can draw without flattening
+    bool is_rect(Rect* rect = nullptr) const;
+    bool is_oval(Rect* rect = nullptr) const;
+    bool is_round_rect(Rect* rect = nullptr, double* rx = nullptr, double* ry = nullptr) const;
+
 private:
-    // Implementation details would go here
+    enum class Shape : uint8_t {
+        None,
+        Rect,
+        Oval,
+        RoundRect
+    };
+
+    std::vector<PathVerb> verbs_;
+    std::vector<Point> points_;
+    FillRule fillRule_;
+    Rect bounds_;
+    uint32_t generationId_;
+    Shape shape_;
+    Rect shapeRect_;
+    double radiusX_;
+    double radiusY_;
+    // Start of the current contour, where close_path() returns
+    Point contourStart_;
+
+    void addPoint(const Point& point);
+    // Starts a contour at the last close point when a verb needs one
+    void ensureContour();
+    void edited(Shape shape);
 };
 
 } // namespace renderer
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "lru_byte_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace renderer {
+
+class Path;
+class Paint;
+
+// A straight edge of a tessellated path, in the path's space
+struct PathEdge {
+    Point from;
+    Point to;
+};
+
+// A path edge in device space, from top to bottom
+struct DeviceEdge {
+    double x0;
+    double y0;
+    double y1;
+    double dxdy;
+    // +1 where the path ran down, -1 where it ran up
+    int winding;
+};
+
+// What a path draw fills: closed polygons as edges
+//
+// The fill edges are filled with the path's fill rule. A stroke's outline
+// is the union of a quad per segment and a polygon per join and cap, all
+// wound the same way, so the stroke edges fill with the nonzero rule.
+struct PathGeometry {
+    std::vector<PathEdge> fill;
+    std::vector<PathEdge> stroke;
+    Rect bounds;
+
+    size_t byteSize() const { return sizeof(PathGeometry) + (fill.size() + stroke.size()) * sizeof(PathEdge); }
+};
+
+// Flattened and tessellated paths, by path generation, scale and stroke
+//
+// Curves are flattened to within a quarter device pixel at the top of the
+// draw's scale bucket; buckets are half an octave wide, so zooming reuses
+// geometry until the error could show. A path drawn again with an equal
+// paint at a similar scale costs one lookup. Geometry is immutable and
+// shared, and the cache is safe to use from any thread.
+class PathCache {
+public:
+    static constexpr size_t kDefaultBudget = 8 << 20;
+
+    using Stats = LruByteCacheStats;
+
+    explicit PathCache(size_t budgetBytes = kDefaultBudget);
+
+    // Cache shared by the rasterizers that are not given one
+    static std::shared_ptr<PathCache> shared();
+
+    // Geometry of path drawn with paint at scale device pixels per unit;
+    // nullptr for an empty path
+    std::shared_ptr<const PathGeometry> get(const Path& path, const Paint& paint, double scale);
+
+    static int scaleBucket(double scale);
+
+    size_t budget() const { return cache_.budget(); }
+    void setBudget(size_t bytes) { cache_.setBudget(bytes); }
+    void clear() { cache_.clear(); }
+    // Evicts least recently used entries until at most bytes remain
+    void purge(size_t bytes = 0) { cache_.purge(bytes); }
+    Stats stats() const { return cache_.stats(); }
+
+private:
+    struct Key {
+        uint32_t path;
+        int bucket;
+        PaintStyle style;
+        LineCap cap;
+        LineJoin join;
+        double strokeWidth;
+        double miterLimit;
+
+        bool operator==(const Key& other) const {
+            return path == other.path && bucket == other.bucket && style == other.style && cap == other.cap &&
+                   join == other.join && strokeWidth == other.strokeWidth && miterLimit == other.miterLimit;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    LruByteCache<Key, PathGeometry, KeyHash> cache_;
+
+    static std::shared_ptr<PathGeometry> build(const Path& path, const Paint& paint, double tolerance);
+};
+
+} // namespace renderer
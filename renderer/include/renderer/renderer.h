@@ -4,6 +4,7 @@
 #include "enums.h"
 #include "canvas.h"
 #include "paint.h"
+#include "damage_region.h"
 #include <memory>
 #include <vector>
 
@@ -20,6 +21,10 @@ class Device;
 class Backend;
 class Layer;
 class Compositor;
+class DisplayList;
+class DisplayListRecorder;
+class SoftwareRasterizer;
+class SwapChain;
 
 // Main Renderer class
 class Renderer {
@@ -144,6 +149,22 @@ public:
     bool isReady() const;
     bool isDirty() const;
 
+    // Damage tracking
+    //
+    // Draws, clears and invalidate(rect) add their device bounds to the
+    // damage region; flush() and finish() present it and start a new one.
+    void invalidate(const Rect& rect);
+    const DamageRegion& damage() const { return damage_; }
+    // Region the last flush() or finish() presented
+    const DamageRegion& presentedDamage() const { return presented_; }
+    // Rasterizes list into the tiles of rasterizer the damage touches;
+    // returns how many tiles were repainted
+    size_t repaint(const DisplayList& list, SoftwareRasterizer& rasterizer);
+    // Repaints into the next buffer of chain, with what changed since that
+    // buffer was drawn, and presents it as flush() does; no pixel is
+    // copied on the way to the embedder. Returns 0 when no buffer is free.
+    size_t repaint(const DisplayList& list, SoftwareRasterizer& rasterizer, SwapChain& chain);
+
     // Size queries
     Size size() const;
     Rect bounds() const;
@@ -190,6 +211,13 @@ private:
     bool isValid_;
     bool isReady_;
 
+    // Damage since the last present, and what that present covered
+    DamageRegion damage_;
+    DamageRegion presented_;
+
+    // Draws since the last flush, for the backend; nullptr without one
+    std::unique_ptr<DisplayListRecorder> recorder_;
+
     // Helper methods
     void copyFrom(const Renderer& other);
     void moveFrom(Renderer&& other);
@@ -208,6 +236,15 @@ private:
     void updateDevice();
     void updateContext();
     void updateSurface();
+    // Adds the device bounds of a local rect, within clip and surface
+    void addDamage(const Rect& rect);
+    void addDamage(const Rect& rect, const Paint& paint);
+    // Adds the clip, or the whole surface when unclipped
+    void addFullDamage();
+    void present();
+    // Hands the recording to the backend and starts the next one
+    void submitRecording();
+    void beginRecording();
 };
 
 // Renderer state for save/restore operations
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "lru_byte_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace renderer {
+
+// Shapes a blurred mask can be made of
+enum class ShadowShape : uint8_t {
+    Rect,
+    RoundRect,
+    Oval
+};
+
+// Blurred coverage of a shape, as a nine-patch where it can be
+//
+// The mask covers the shape grown by outset on every side. When stretchX
+// is not -1 the mask is narrower than the shape: columns before it are the
+// left edge, the column itself repeats across the middle, and the columns
+// after it are the right edge. Rows stretch the same way with stretchY.
+struct ShadowMask {
+    int width = 0;
+    int height = 0;
+    int outset = 0;
+    int stretchX = -1;
+    int stretchY = -1;
+    std::vector<uint8_t> coverage;
+
+    size_t byteSize() const { return sizeof(ShadowMask) + coverage.size(); }
+
+    // Mask column of column x of a draw width columns wide, and likewise rows
+    int column(int x, int width) const { return map(x, width, this->width, stretchX); }
+    int row(int y, int height) const { return map(y, height, this->height, stretchY); }
+
+private:
+    static int map(int index, int drawn, int size, int stretch) {
+        if (stretch < 0 || index < stretch) return index;
+        int fromEnd = drawn - index;
+        return fromEnd < size - stretch ? size - fromEnd : stretch;
+    }
+};
+
+// Blurred shape masks for shadows and blur filters, by shape, radius and blur
+//
+// Rects and round rects are blurred once at the smallest size that shows
+// all their corners and the reach of the blur, and stretched as nine-patches
+// to any larger size, so equal shadows on cards of different sizes share a
+// mask. Ovals are blurred at their size. Masks carry coverage only; the
+// shadow color is applied when they are blitted. Masks are immutable and
+// shared, and the cache is safe to use from any thread.
+class ShadowCache {
+public:
+    static constexpr size_t kDefaultBudget = 4 << 20;
+
+    using Stats = LruByteCacheStats;
+
+    explicit ShadowCache(size_t budgetBytes = kDefaultBudget);
+
+    // Cache shared by the rasterizers that are not given one
+    static std::shared_ptr<ShadowCache> shared();
+
+    // Mask of shape of width x height device pixels, corner radii rx and ry,
+    // blurred with a Gaussian of sigma pixels; nullptr for an empty shape
+    std::shared_ptr<const ShadowMask> get(ShadowShape shape, int width, int height, double rx, double ry,
+                                          double sigma);
+
+    size_t budget() const { return cache_.budget(); }
+    void setBudget(size_t bytes) { cache_.setBudget(bytes); }
+    void clear() { cache_.clear(); }
+    // Evicts least recently used entries until at most bytes remain
+    void purge(size_t bytes = 0) { cache_.purge(bytes); }
+    Stats stats() const { return cache_.stats(); }
+
+private:
+    struct Key {
+        ShadowShape shape;
+        // Of the blurred shape, which is smaller than the drawn one when
+        // it is stretched; radii and sigma in quarter pixels
+        int width;
+        int height;
+        int radiusX;
+        int radiusY;
+        int sigma;
+
+        bool operator==(const Key& other) const {
+            return shape == other.shape && width == other.width && height == other.height &&
+                   radiusX == other.radiusX && radiusY == other.radiusY && sigma == other.sigma;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    LruByteCache<Key, ShadowMask, KeyHash> cache_;
+
+    static std::shared_ptr<ShadowMask> build(const Key& key);
+};
+
+} // namespace renderer
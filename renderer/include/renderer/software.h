@@ -0,0 +1,260 @@
+#pragma once
+
+#include "types.h"
+#include "enums.h"
+#include "clip_mask.h"
+#include "display_list.h"
+#include "frame_buffer.h"
+#include "glyph_cache.h"
+#include "image_scaler.h"
+#include "path_cache.h"
+#include "shadow_cache.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace renderer {
+
+// Tiled, multithreaded rasterizer of the software backend
+//
+// The surface is split into kTileSize square tiles. rasterize() resolves
+// the list's transforms, clips and layer opacity once, bins each draw into
+// the tiles its device bounds touch, and rasterizes the dirty tiles on the
+// rasterizer's worker threads. Tiles own disjoint pixels, so workers never
+// share a write. Clean tiles keep their pixels until invalidated.
+//
+// Pixels are premultiplied RGBA8, four bytes per pixel in that order.
+// Geometry is covered by distance to the shape in local space, which keeps
+// rotated and scaled draws antialiased without tessellation. Text is laid
+// out into a GlyphCache while resolving and blitted from its atlas, at the
+// transformed size and origin but unrotated. Paths that are one rect,
+// round rect or oval are covered like those draws; other paths fill the
+// edges a PathCache tessellated them into, transformed to device space,
+// with four subscanlines of exact horizontal coverage per pixel row.
+// Filled rects, round rects and ovals under axis-aligned transforms get
+// their paint's shadow, and a blur filter blurs them, from masks of a
+// ShadowCache; other filters are not applied. Images with decoded bitmaps
+// under axis-aligned transforms are scaled to their device size by a
+// ScaledImageCache, with the filter of their paint's rendering hint, and
+// blitted; others are not rasterized. Rows are composited with the blend
+// kernels of blend.h in the draw's blend mode.
+//
+// Rect clips under axis-aligned transforms, aliased or on pixel edges, are
+// kept as one integer device rect that draws cull and clip against.
+// Antialiased rect clips off pixel edges, rotated rect clips, path clips
+// and clip-outs become coverage masks, path masks cached across frames in
+// a ClipMaskCache; a draw under a mask is drawn over a copy of the pixels
+// it may touch and blended back in by coverage.
+class SoftwareRasterizer {
+public:
+    static constexpr int kTileSize = 256;
+
+    // threadCount counts the calling thread; 0 picks one per core
+    SoftwareRasterizer(int width, int height, size_t threadCount = 0);
+    ~SoftwareRasterizer();
+
+    SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+    SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+
+    // Surface size; resizing clears the pixels, dirties every tile and goes
+    // back to pixels the rasterizer owns
+    int width() const { return width_; }
+    int height() const { return height_; }
+    void resize(int width, int height);
+
+    // Rasterizes into buffer's pixels from now on, as a swap chain hands
+    // them out, taking its size; nullptr goes back to owned pixels. Every
+    // tile is dirtied unless keepTiles, for a buffer that already holds the
+    // clean tiles' pixels.
+    void setTarget(std::shared_ptr<FrameBuffer> buffer, bool keepTiles = false);
+    const std::shared_ptr<FrameBuffer>& target() const { return target_; }
+
+    // Pixel access
+    ImageData pixels() { return ImageData(targetPixels_, width_, height_, 4, stride()); }
+    const uint8_t* data() const { return targetPixels_; }
+    int stride() const { return static_cast<int>(stride_); }
+    // Unpremultiplied color of one pixel
+    Color pixel(int x, int y) const;
+
+    // Tiles
+    int tilesWide() const { return tilesWide_; }
+    int tilesHigh() const { return tilesHigh_; }
+    size_t tileCount() const { return dirty_.size(); }
+    bool isTileDirty(int tileX, int tileY) const { return dirty_[tileY * tilesWide_ + tileX] != 0; }
+    size_t dirtyTileCount() const;
+
+    // Marks the tiles rect touches, in device pixels, for rasterization
+    void invalidate(const Rect& rect);
+    void invalidateAll();
+
+    // Rasterizes list into the dirty tiles, which start out transparent,
+    // and marks them clean; returns how many tiles were rasterized
+    size_t rasterize(const DisplayList& list);
+
+    size_t threadCount() const { return threads_.size() + 1; }
+
+    // Glyphs for text draws; each rasterizer starts with a cache of its own.
+    // A cache may be shared by rasterizers that do not run concurrently.
+    const std::shared_ptr<GlyphCache>& glyphCache() const { return glyphCache_; }
+    void setGlyphCache(std::shared_ptr<GlyphCache> cache);
+    // Tessellated paths; PathCache::shared() unless set
+    const std::shared_ptr<PathCache>& pathCache() const { return pathCache_; }
+    void setPathCache(std::shared_ptr<PathCache> cache);
+    // Blurred shadow masks; ShadowCache::shared() unless set
+    const std::shared_ptr<ShadowCache>& shadowCache() const { return shadowCache_; }
+    void setShadowCache(std::shared_ptr<ShadowCache> cache);
+    // Path clip masks; ClipMaskCache::shared() unless set
+    const std::shared_ptr<ClipMaskCache>& clipMaskCache() const { return clipMaskCache_; }
+    void setClipMaskCache(std::shared_ptr<ClipMaskCache> cache);
+    // Scaled images; ScaledImageCache::shared() unless set
+    const std::shared_ptr<ScaledImageCache>& scaledImageCache() const { return scaledImageCache_; }
+    void setScaledImageCache(std::shared_ptr<ScaledImageCache> cache);
+
+    // Statistics of the last rasterize()
+    struct Stats {
+        size_t tiles = 0;
+        size_t draws = 0;
+        // Draw-tile pairs rasterized, summed over tiles
+        size_t binned = 0;
+    };
+    const Stats& lastStats() const { return stats_; }
+
+private:
+    static constexpr uint32_t kNoMask = 0xFFFFFFFFu;
+
+    // A draw with its state resolved to device space
+    struct ResolvedDraw {
+        uint32_t item;
+        // Local to device; inverse maps pixel centers back
+        Matrix matrix;
+        Matrix inverse;
+        // Device pixels per local unit
+        double scale;
+        // Device clip, always within the surface
+        Rect clip;
+        // Into clipMasks_, or kNoMask when clip is all there is
+        uint32_t clipMask;
+        // What the draw may touch: its bounds within clip
+        Rect bounds;
+        // Product of enclosing layer opacities
+        double alpha;
+        // Text: the draw's run of glyphQuads_
+        uint32_t firstQuad;
+        uint32_t quadCount;
+        // Paths: the draw's fill then stroke edges in pathEdges_
+        uint32_t firstEdge;
+        uint32_t fillEdges;
+        uint32_t strokeEdges;
+        // Shapes: the draw's run of shadows_, drawn before it
+        uint32_t firstShadow;
+        uint32_t shadowCount;
+        // Images: the draw's entry of images_
+        uint32_t image;
+    };
+
+    // A scaled image placed on the surface at its device size
+    struct ResolvedImage {
+        std::shared_ptr<const ImageBitmap> pixels;
+        int x;
+        int y;
+    };
+
+    // A blurred mask placed on the surface
+    struct ResolvedShadow {
+        std::shared_ptr<const ShadowMask> mask;
+        // Device pixels the mask is stretched over
+        int x;
+        int y;
+        int width;
+        int height;
+        uint8_t color[4];
+        BlendMode blendMode;
+        // A blur filter: the mask is drawn instead of the shape
+        bool replacesShape;
+    };
+
+    int width_;
+    int height_;
+    int tilesWide_;
+    int tilesHigh_;
+    std::vector<uint8_t> pixels_;
+    std::shared_ptr<FrameBuffer> target_;
+    // Of the target, or pixels_ without one
+    uint8_t* targetPixels_;
+    size_t stride_;
+    std::vector<uint8_t> dirty_;
+    Stats stats_;
+
+    // Current job, read by workers while it runs
+    const DisplayList* list_;
+    std::vector<ResolvedDraw> draws_;
+    // Per tile index: the draws binned to it, in list order
+    std::vector<std::vector<uint32_t>> bins_;
+    std::vector<uint32_t> jobTiles_;
+    std::atomic<size_t> nextTile_;
+    std::shared_ptr<GlyphCache> glyphCache_;
+    std::vector<GlyphQuad> glyphQuads_;
+    std::shared_ptr<PathCache> pathCache_;
+    std::vector<DeviceEdge> pathEdges_;
+    std::shared_ptr<ShadowCache> shadowCache_;
+    std::vector<ResolvedShadow> shadows_;
+    std::shared_ptr<ClipMaskCache> clipMaskCache_;
+    std::vector<PlacedClipMask> clipMasks_;
+    std::shared_ptr<ScaledImageCache> scaledImageCache_;
+    std::vector<ResolvedImage> images_;
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_;
+    // Workers that took the current job, and those still running it
+    size_t started_;
+    size_t busy_;
+    bool stopRequested_;
+
+    void workerLoop();
+    // Rasterizes job tiles until none are left
+    void runTiles();
+    void rasterizeTile(uint32_t tile);
+
+    // Whether an op has geometry the rasterizer draws
+    static bool rasterizes(DisplayOp op);
+
+    uint8_t* pixelAt(int x, int y) const { return targetPixels_ + y * stride_ + static_cast<size_t>(x) * 4; }
+
+    void resolve(const DisplayList& list);
+    // Applies a clip op to a state's device clip and mask; returns the mask
+    uint32_t applyClip(const DisplayList& list, const DisplayItem& item, const Matrix& matrix, Rect& clip,
+                       uint32_t mask);
+    // Lays out a text draw's glyphs; returns their device bounds
+    Rect layoutText(const DisplayList& list, const DisplayItem& item, const Matrix& matrix, double scale);
+    // Appends a path draw's device edges, fill then stroke; returns their
+    // bounds and sets how many are fill edges
+    Rect tessellatePath(const DisplayList& list, const DisplayItem& item, const Matrix& matrix, double scale,
+                        uint32_t& fillEdges);
+    // Appends the shadow and blur masks of a shape draw
+    void resolveShadows(const DisplayList& list, const DisplayItem& item, const Matrix& matrix, double scale,
+                        double alpha);
+    // Appends an image draw's scaled pixels; returns their device bounds
+    Rect resolveImage(const DisplayList& list, const DisplayItem& item, const Matrix& matrix, const Rect& clip);
+    void bin();
+
+    void drawItem(const ResolvedDraw& draw, const Rect& tileRect);
+    // Draws within area, the part of tileRect in the draw's bounds,
+    // ignoring its mask
+    void drawArea(const ResolvedDraw& draw, Rect area, const Rect& tileRect);
+    void drawGlyphs(const ResolvedDraw& draw, const Rect& area);
+    void drawEdges(const ResolvedDraw& draw, const Rect& area);
+    void drawShadow(const ResolvedShadow& shadow, const Rect& clip, const Rect& area);
+    void drawImage(const ResolvedDraw& draw, const Rect& area);
+    // Blends color, scaled by alpha, over area, or replaces area with it
+    void fillArea(const Rect& area, const Color& color, double alpha, BlendMode mode, bool replace);
+};
+
+} // namespace renderer
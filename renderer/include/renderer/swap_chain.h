@@ -0,0 +1,157 @@
+#pragma once
+
+#include "types.h"
+#include "frame_buffer.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace renderer {
+
+// A one-shot signal that work on a buffer is done
+//
+// Waited on from any thread. Where eventfd exists, fd() is readable while
+// the fence is signaled, so an embedder can wait on it in its poll loop.
+class Fence {
+public:
+    Fence();
+    ~Fence();
+
+    Fence(const Fence&) = delete;
+    Fence& operator=(const Fence&) = delete;
+
+    void signal();
+    bool isSignaled() const;
+    // Returns whether the fence signaled within timeout
+    bool wait(std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max()) const;
+
+    // -1 where there is no eventfd
+    int fd() const { return fd_; }
+
+private:
+    mutable std::mutex mutex_;
+    mutable std::condition_variable signaled_;
+    bool isSignaled_;
+    int fd_;
+};
+
+// Double or triple buffered hand-off of frames to an embedder
+//
+// The renderer acquires a buffer nobody holds, rasterizes into it and
+// presents it; the embedder takes the newest presented frame, reads it
+// where it was drawn and releases it. A presented frame the embedder has
+// not taken when the next one is presented goes straight back to the
+// renderer, so the embedder never falls behind. Fences make the waits
+// explicit: present() can pass one the embedder must wait on before
+// reading, for pixels still being written, and release() can pass one the
+// renderer waits on before drawing, for reads still in flight.
+//
+// Each acquired frame says which of its pixels differ from the last
+// presented frame, from the damage of the frames presented since its
+// buffer was last drawn, so only those have to be redrawn. One frame is
+// drawn at a time.
+class SwapChain {
+public:
+    static constexpr size_t kMaxBuffers = 4;
+
+    struct Frame {
+        std::shared_ptr<FrameBuffer> buffer;
+        uint32_t index = 0;
+        // Counts presented frames from 1
+        uint64_t serial = 0;
+        // Frames since the buffer was last drawn, 0 when it never was
+        int age = 0;
+        // Pixels to redraw, in the renderer's frame; what the embedder got,
+        // in the embedder's
+        Rect damage;
+        // For the embedder to wait on before reading; may be null
+        std::shared_ptr<Fence> ready;
+    };
+
+    // bufferCount buffers of memory; valid() is false when they cannot
+    // be made
+    SwapChain(int width, int height, size_t bufferCount = 3,
+              FrameBufferMemory memory = FrameBufferMemory::SharedMemory);
+    // Over buffers of one size the caller made, such as imported dma-bufs
+    explicit SwapChain(std::vector<std::shared_ptr<FrameBuffer>> buffers);
+
+    SwapChain(const SwapChain&) = delete;
+    SwapChain& operator=(const SwapChain&) = delete;
+
+    bool valid() const { return !buffers_.empty(); }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t bufferCount() const { return buffers_.size(); }
+    const std::shared_ptr<FrameBuffer>& buffer(size_t index) const { return buffers_[index].buffer; }
+
+    // Renderer side
+
+    // Waits up to timeout for a free buffer, preferring the one drawn
+    // most recently; false on timeout or while a frame is being drawn
+    bool acquire(Frame& frame, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+    // Hands the acquired frame to the embedder; damage is what changed
+    // since the frame presented before it
+    void present(const Frame& frame, const Rect& damage, std::shared_ptr<Fence> ready = nullptr);
+    // Returns an acquired frame without presenting it
+    void cancel(const Frame& frame);
+
+    // Embedder side
+
+    // Takes the newest presented frame; its damage is what changed since
+    // the frame the embedder took before. False when none is new.
+    bool take(Frame& frame);
+    // Gives a taken buffer back, once done is signaled when there is one
+    void release(const Frame& frame, std::shared_ptr<Fence> done = nullptr);
+
+    struct Stats {
+        size_t presented = 0;
+        // Presented frames the embedder never took
+        size_t dropped = 0;
+        size_t acquireWaits = 0;
+    };
+    Stats stats() const;
+
+private:
+    enum class State : uint8_t {
+        Free,
+        Drawing,
+        Presented,
+        Taken
+    };
+
+    struct Slot {
+        std::shared_ptr<FrameBuffer> buffer;
+        State state = State::Free;
+        // Serial of the frame last drawn into the buffer, 0 for none
+        uint64_t serial = 0;
+        std::shared_ptr<Fence> ready;
+        std::shared_ptr<Fence> released;
+    };
+
+    struct Damage {
+        uint64_t serial;
+        Rect rect;
+    };
+
+    int width_;
+    int height_;
+    std::vector<Slot> buffers_;
+    mutable std::mutex mutex_;
+    std::condition_variable freed_;
+    uint64_t serial_;
+    // Serial of the frame the embedder took last
+    uint64_t taken_;
+    // Damage of the most recent frames, oldest first
+    std::deque<Damage> history_;
+    Stats stats_;
+
+    // What changed from frame serial to the newest presented one
+    Rect damageSince(uint64_t serial) const;
+};
+
+} // namespace renderer
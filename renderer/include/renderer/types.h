@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -185,14 +187,34 @@ struct Matrix {
         );
     }
 
+    // No perspective row, so points map without a divide
+    bool isAffine() const { return m31 == 0 && m32 == 0 && m33 == 1; }
+    bool isTranslation() const { return isAffine() && m11 == 1 && m12 == 0 && m21 == 0 && m22 == 1; }
+
     Point transform(const Point& point) const {
         double x = m11 * point.x + m12 * point.y + m13;
         double y = m21 * point.x + m22 * point.y + m23;
+        if (isAffine()) return Point(x, y);
         double w = m31 * point.x + m32 * point.y + m33;
         return Point(x / w, y / w);
     }
 
     Rect transform(const Rect& rect) const {
+        if (isAffine()) {
+            // Each coordinate is a sum of one term in x and one in y, so its
+            // extremes pair the smaller and the larger products; the same
+            // bounds as mapping the corners, for half the multiplies
+            double x0 = m11 * rect.left(), x1 = m11 * rect.right();
+            double y0 = m12 * rect.top(), y1 = m12 * rect.bottom();
+            double left = std::min(x0, x1) + std::min(y0, y1) + m13;
+            double right = std::max(x0, x1) + std::max(y0, y1) + m13;
+            x0 = m21 * rect.left(), x1 = m21 * rect.right();
+            y0 = m22 * rect.top(), y1 = m22 * rect.bottom();
+            double top = std::min(x0, x1) + std::min(y0, y1) + m23;
+            double bottom = std::max(x0, x1) + std::max(y0, y1) + m23;
+            return Rect(left, top, right - left, bottom - top);
+        }
+
         Point topLeft = transform(rect.topLeft());
         Point topRight = transform(rect.topRight());
         Point bottomLeft = transform(rect.bottomLeft());
@@ -206,8 +228,39 @@ struct Matrix {
         return Rect(left, top, right - left, bottom - top);
     }
 
+    // Batch forms for hot loops, deciding the matrix's kind once; out may
+    // be in. Translated rects keep their exact size.
+    void transform(const Point* in, Point* out, size_t count) const {
+        if (!isAffine()) {
+            for (size_t i = 0; i < count; ++i) out[i] = transform(in[i]);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            double x = in[i].x, y = in[i].y;
+            out[i] = Point(m11 * x + m12 * y + m13, m21 * x + m22 * y + m23);
+        }
+    }
+    void transform(const Rect* in, Rect* out, size_t count) const {
+        if (isTranslation()) {
+            for (size_t i = 0; i < count; ++i) out[i] = Rect(in[i].x() + m13, in[i].y() + m23, in[i].width(), in[i].height());
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) out[i] = transform(in[i]);
+    }
+
     Matrix& operator*=(const Matrix& other) { return *this = *this * other; }
 
+    // Inverse of the affine part; singular matrices map everything to the origin
+    Matrix inverted() const {
+        double det = m11 * m22 - m12 * m21;
+        if (det == 0) return Matrix(0, 0, 0, 0, 0, 0, 0, 0, 1);
+
+        double inv = 1 / det;
+        return Matrix(m22 * inv, -m12 * inv, (m12 * m23 - m22 * m13) * inv,
+                      -m21 * inv, m11 * inv, (m21 * m13 - m11 * m23) * inv,
+                      0, 0, 1);
+    }
+
     bool operator==(const Matrix& other) const {
         return m11 == other.m11 && m12 == other.m12 && m13 == other.m13 &&
                m21 == other.m21 && m22 == other.m22 && m23 == other.m23 &&
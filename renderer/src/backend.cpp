@@ -0,0 +1,8 @@
+#include "renderer/backend.h"
+
+namespace renderer {
+
+// Backend implementation
+Backend::~Backend() {}
+
+} // namespace renderer
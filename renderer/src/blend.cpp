@@ -0,0 +1,605 @@
+#include "renderer/blend.h"
+#include "pixel_math.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RENDERER_BLEND_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#define RENDERER_BLEND_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace renderer {
+
+namespace {
+
+// Modes with vector kernels
+enum class FastOp {
+    SrcOver,
+    Multiply,
+    Screen,
+    None
+};
+
+FastOp fastOp(BlendMode mode) {
+    switch (mode) {
+        case BlendMode::Normal:
+            return FastOp::SrcOver;
+        case BlendMode::Multiply:
+            return FastOp::Multiply;
+        case BlendMode::Screen:
+            return FastOp::Screen;
+        default:
+            return FastOp::None;
+    }
+}
+
+uint32_t load32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+// Scalar kernels; they also finish the spans the vector ones leave
+void fastPixel(FastOp op, uint8_t* d, const uint8_t* s) {
+    unsigned sa = s[3];
+    unsigned da = d[3];
+    for (int c = 0; c < 4; ++c) {
+        unsigned result;
+        switch (op) {
+            case FastOp::Multiply:
+                result = div255(s[c] * (255 - da)) + div255(d[c] * (255 - sa)) + div255(s[c] * d[c]);
+                break;
+            case FastOp::Screen:
+                result = s[c] + d[c] - div255(s[c] * d[c]);
+                break;
+            default:
+                result = s[c] + div255(d[c] * (255 - sa));
+                break;
+        }
+        d[c] = static_cast<uint8_t>(std::min(result, 255u));
+    }
+}
+
+// The remaining separable modes, on unpremultiplied channels in [0, 1]
+double separable(BlendMode mode, double cb, double cs) {
+    switch (mode) {
+        case BlendMode::Multiply:
+            return cb * cs;
+        case BlendMode::Screen:
+            return cb + cs - cb * cs;
+        case BlendMode::Overlay:
+            return separable(BlendMode::HardLight, cs, cb);
+        case BlendMode::Darken:
+            return std::min(cb, cs);
+        case BlendMode::Lighten:
+            return std::max(cb, cs);
+        case BlendMode::ColorDodge:
+            if (cb == 0) return 0;
+            if (cs >= 1) return 1;
+            return std::min(1.0, cb / (1 - cs));
+        case BlendMode::ColorBurn:
+            if (cb >= 1) return 1;
+            if (cs <= 0) return 0;
+            return 1 - std::min(1.0, (1 - cb) / cs);
+        case BlendMode::HardLight:
+            if (cs <= 0.5) return cb * 2 * cs;
+            return separable(BlendMode::Screen, cb, 2 * cs - 1);
+        case BlendMode::SoftLight: {
+            if (cs <= 0.5) return cb - (1 - 2 * cs) * cb * (1 - cb);
+            double d = cb <= 0.25 ? ((16 * cb - 12) * cb + 4) * cb : std::sqrt(cb);
+            return cb + (2 * cs - 1) * (d - cb);
+        }
+        case BlendMode::Difference:
+            return std::abs(cb - cs);
+        case BlendMode::Exclusion:
+            return cb + cs - 2 * cb * cs;
+        default:
+            return cs;
+    }
+}
+
+// Helpers of the non-separable modes
+double lum(const double c[3]) {
+    return 0.3 * c[0] + 0.59 * c[1] + 0.11 * c[2];
+}
+
+void clipColor(double c[3]) {
+    double l = lum(c);
+    double n = std::min({c[0], c[1], c[2]});
+    double x = std::max({c[0], c[1], c[2]});
+    for (int i = 0; i < 3; ++i) {
+        if (n < 0) c[i] = l + (c[i] - l) * l / (l - n);
+        if (x > 1) c[i] = l + (c[i] - l) * (1 - l) / (x - l);
+    }
+}
+
+void setLum(double c[3], double l) {
+    double d = l - lum(c);
+    for (int i = 0; i < 3; ++i) {
+        c[i] += d;
+    }
+    clipColor(c);
+}
+
+double sat(const double c[3]) {
+    return std::max({c[0], c[1], c[2]}) - std::min({c[0], c[1], c[2]});
+}
+
+void setSat(double c[3], double s) {
+    double n = std::min({c[0], c[1], c[2]});
+    double x = std::max({c[0], c[1], c[2]});
+    for (int i = 0; i < 3; ++i) {
+        c[i] = x > n ? (c[i] - n) * s / (x - n) : 0;
+    }
+}
+
+void nonSeparable(BlendMode mode, const double cb[3], const double cs[3], double out[3]) {
+    std::copy(cs, cs + 3, out);
+    switch (mode) {
+        case BlendMode::Hue:
+            setSat(out, sat(cb));
+            setLum(out, lum(cb));
+            break;
+        case BlendMode::Saturation:
+            std::copy(cb, cb + 3, out);
+            setSat(out, sat(cs));
+            setLum(out, lum(cb));
+            break;
+        case BlendMode::Color:
+            setLum(out, lum(cb));
+            break;
+        case BlendMode::Luminosity:
+            std::copy(cb, cb + 3, out);
+            setLum(out, lum(cs));
+            break;
+        default:
+            break;
+    }
+}
+
+// co = cs (1 - ab) + cb (1 - as) + as ab B(cb, cs), on premultiplied channels
+void generalPixel(BlendMode mode, uint8_t* d, const uint8_t* s) {
+    double as = s[3] / 255.0;
+    double ab = d[3] / 255.0;
+    if (as == 0) return;
+
+    double cs[3], cb[3], mixed[3];
+    for (int i = 0; i < 3; ++i) {
+        cs[i] = s[i] / 255.0 / as;
+        cb[i] = ab > 0 ? d[i] / 255.0 / ab : 0;
+    }
+    bool separableMode = mode != BlendMode::Hue && mode != BlendMode::Saturation && mode != BlendMode::Color &&
+                         mode != BlendMode::Luminosity;
+    if (separableMode) {
+        for (int i = 0; i < 3; ++i) {
+            mixed[i] = separable(mode, cb[i], cs[i]);
+        }
+    } else {
+        nonSeparable(mode, cb, cs, mixed);
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        double co = s[i] / 255.0 * (1 - ab) + d[i] / 255.0 * (1 - as) + as * ab * std::clamp(mixed[i], 0.0, 1.0);
+        d[i] = static_cast<uint8_t>(std::lround(std::clamp(co, 0.0, 1.0) * 255));
+    }
+    d[3] = static_cast<uint8_t>(std::lround(std::clamp(as + ab - as * ab, 0.0, 1.0) * 255));
+}
+
+void scaledColor(const uint8_t color[4], unsigned scale, uint8_t out[4]) {
+    for (int c = 0; c < 4; ++c) {
+        out[c] = static_cast<uint8_t>(div255(color[c] * scale));
+    }
+}
+
+void blendScalar(uint8_t* dst, int count, const uint8_t color[4], const uint8_t* coverage, BlendMode mode) {
+    FastOp op = fastOp(mode);
+    uint8_t s[4] = {color[0], color[1], color[2], color[3]};
+    for (int i = 0; i < count; ++i, dst += 4) {
+        if (coverage) {
+            if (coverage[i] == 0) continue;
+            scaledColor(color, coverage[i], s);
+        }
+        if (op != FastOp::None) {
+            fastPixel(op, dst, s);
+        } else {
+            generalPixel(mode, dst, s);
+        }
+    }
+}
+
+void compositeScalar(uint8_t* dst, const uint8_t* src, int count, BlendMode mode, uint8_t alpha) {
+    FastOp op = fastOp(mode);
+    uint8_t s[4];
+    for (int i = 0; i < count; ++i, dst += 4, src += 4) {
+        scaledColor(src, alpha, s);
+        if (s[3] == 0) continue;
+        if (op != FastOp::None) {
+            fastPixel(op, dst, s);
+        } else {
+            generalPixel(mode, dst, s);
+        }
+    }
+}
+
+// Vector kernels return how many pixels they handled, a multiple of their
+// width; the scalar ones do the rest
+struct Kernels {
+    BlendIsa isa;
+    int (*fill)(uint8_t* dst, int count, uint32_t color);
+    int (*blend)(uint8_t* dst, int count, const uint8_t color[4], const uint8_t* coverage, FastOp op);
+    int (*composite)(uint8_t* dst, const uint8_t* src, int count, FastOp op, uint8_t alpha);
+};
+
+int fillNone(uint8_t*, int, uint32_t) {
+    return 0;
+}
+
+int blendNone(uint8_t*, int, const uint8_t*, const uint8_t*, FastOp) {
+    return 0;
+}
+
+int compositeNone(uint8_t*, const uint8_t*, int, FastOp, uint8_t) {
+    return 0;
+}
+
+const Kernels kScalarKernels = {BlendIsa::Scalar, fillNone, blendNone, compositeNone};
+
+#if RENDERER_BLEND_X86
+
+// SSE4.1: four pixels per step, two per register as 16-bit lanes
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+
+TARGET_SSE41 inline __m128i div255x8(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+TARGET_SSE41 inline __m128i alphas(__m128i x) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xFF), 0xFF);
+}
+
+TARGET_SSE41 inline __m128i applySse41(FastOp op, __m128i s, __m128i d) {
+    const __m128i full = _mm_set1_epi16(255);
+    switch (op) {
+        case FastOp::Multiply: {
+            __m128i a = div255x8(_mm_mullo_epi16(s, _mm_sub_epi16(full, alphas(d))));
+            __m128i b = div255x8(_mm_mullo_epi16(d, _mm_sub_epi16(full, alphas(s))));
+            return _mm_add_epi16(_mm_add_epi16(a, b), div255x8(_mm_mullo_epi16(s, d)));
+        }
+        case FastOp::Screen:
+            return _mm_sub_epi16(_mm_add_epi16(s, d), div255x8(_mm_mullo_epi16(s, d)));
+        default:
+            return _mm_add_epi16(s, div255x8(_mm_mullo_epi16(d, _mm_sub_epi16(full, alphas(s)))));
+    }
+}
+
+TARGET_SSE41 int fillSse41(uint8_t* dst, int count, uint32_t color) {
+    __m128i c = _mm_set1_epi32(static_cast<int>(color));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), c);
+    }
+    return i;
+}
+
+TARGET_SSE41 int blendSse41(uint8_t* dst, int count, const uint8_t color[4], const uint8_t* coverage, FastOp op) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i packed = _mm_set1_epi32(static_cast<int>(load32(color)));
+    const __m128i c = _mm_unpacklo_epi8(packed, zero);
+    // Spread pixel coverage over the pixel's four 16-bit lanes
+    const __m128i spreadLo = _mm_setr_epi8(0, -1, 0, -1, 0, -1, 0, -1, 1, -1, 1, -1, 1, -1, 1, -1);
+    const __m128i spreadHi = _mm_setr_epi8(2, -1, 2, -1, 2, -1, 2, -1, 3, -1, 3, -1, 3, -1, 3, -1);
+    bool opaque = color[3] == 255 && op == FastOp::SrcOver;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8_t* p = dst + i * 4;
+        __m128i slo = c;
+        __m128i shi = c;
+        if (coverage) {
+            uint32_t covered = load32(coverage + i);
+            if (covered == 0) continue;
+            if (covered != 0xFFFFFFFFu) {
+                __m128i cov = _mm_cvtsi32_si128(static_cast<int>(covered));
+                slo = div255x8(_mm_mullo_epi16(c, _mm_shuffle_epi8(cov, spreadLo)));
+                shi = div255x8(_mm_mullo_epi16(c, _mm_shuffle_epi8(cov, spreadHi)));
+            } else if (opaque) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+                continue;
+            }
+        } else if (opaque) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+            continue;
+        }
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i lo = applySse41(op, slo, _mm_unpacklo_epi8(d, zero));
+        __m128i hi = applySse41(op, shi, _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+TARGET_SSE41 int compositeSse41(uint8_t* dst, const uint8_t* src, int count, FastOp op, uint8_t alpha) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i scale = _mm_set1_epi16(alpha);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i * 4));
+        __m128i slo = _mm_unpacklo_epi8(s, zero);
+        __m128i shi = _mm_unpackhi_epi8(s, zero);
+        if (alpha != 255) {
+            slo = div255x8(_mm_mullo_epi16(slo, scale));
+            shi = div255x8(_mm_mullo_epi16(shi, scale));
+        }
+        __m128i lo = applySse41(op, slo, _mm_unpacklo_epi8(d, zero));
+        __m128i hi = applySse41(op, shi, _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+// AVX2: eight pixels per step; unpacking and packing stay within 128-bit
+// lanes, so pixels 0-1 and 4-5 share a register, as do 2-3 and 6-7
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+TARGET_AVX2 inline __m256i div255x16(__m256i x) {
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+TARGET_AVX2 inline __m256i alphas(__m256i x) {
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, 0xFF), 0xFF);
+}
+
+TARGET_AVX2 inline __m256i applyAvx2(FastOp op, __m256i s, __m256i d) {
+    const __m256i full = _mm256_set1_epi16(255);
+    switch (op) {
+        case FastOp::Multiply: {
+            __m256i a = div255x16(_mm256_mullo_epi16(s, _mm256_sub_epi16(full, alphas(d))));
+            __m256i b = div255x16(_mm256_mullo_epi16(d, _mm256_sub_epi16(full, alphas(s))));
+            return _mm256_add_epi16(_mm256_add_epi16(a, b), div255x16(_mm256_mullo_epi16(s, d)));
+        }
+        case FastOp::Screen:
+            return _mm256_sub_epi16(_mm256_add_epi16(s, d), div255x16(_mm256_mullo_epi16(s, d)));
+        default:
+            return _mm256_add_epi16(s, div255x16(_mm256_mullo_epi16(d, _mm256_sub_epi16(full, alphas(s)))));
+    }
+}
+
+TARGET_AVX2 int fillAvx2(uint8_t* dst, int count, uint32_t color) {
+    __m256i c = _mm256_set1_epi32(static_cast<int>(color));
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), c);
+    }
+    return i;
+}
+
+TARGET_AVX2 int blendAvx2(uint8_t* dst, int count, const uint8_t color[4], const uint8_t* coverage, FastOp op) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i packed = _mm256_set1_epi32(static_cast<int>(load32(color)));
+    const __m256i c = _mm256_unpacklo_epi8(packed, zero);
+    const __m256i spreadLo = _mm256_setr_epi8(0, -1, 0, -1, 0, -1, 0, -1, 1, -1, 1, -1, 1, -1, 1, -1,
+                                              4, -1, 4, -1, 4, -1, 4, -1, 5, -1, 5, -1, 5, -1, 5, -1);
+    const __m256i spreadHi = _mm256_setr_epi8(2, -1, 2, -1, 2, -1, 2, -1, 3, -1, 3, -1, 3, -1, 3, -1,
+                                              6, -1, 6, -1, 6, -1, 6, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+    bool opaque = color[3] == 255 && op == FastOp::SrcOver;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8_t* p = dst + i * 4;
+        __m256i slo = c;
+        __m256i shi = c;
+        if (coverage) {
+            uint64_t covered;
+            std::memcpy(&covered, coverage + i, 8);
+            if (covered == 0) continue;
+            if (covered != ~uint64_t(0)) {
+                __m256i cov = _mm256_set1_epi64x(static_cast<long long>(covered));
+                slo = div255x16(_mm256_mullo_epi16(c, _mm256_shuffle_epi8(cov, spreadLo)));
+                shi = div255x16(_mm256_mullo_epi16(c, _mm256_shuffle_epi8(cov, spreadHi)));
+            } else if (opaque) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), packed);
+                continue;
+            }
+        } else if (opaque) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), packed);
+            continue;
+        }
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i lo = applyAvx2(op, slo, _mm256_unpacklo_epi8(d, zero));
+        __m256i hi = applyAvx2(op, shi, _mm256_unpackhi_epi8(d, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+TARGET_AVX2 int compositeAvx2(uint8_t* dst, const uint8_t* src, int count, FastOp op, uint8_t alpha) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i scale = _mm256_set1_epi16(alpha);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i * 4));
+        __m256i slo = _mm256_unpacklo_epi8(s, zero);
+        __m256i shi = _mm256_unpackhi_epi8(s, zero);
+        if (alpha != 255) {
+            slo = div255x16(_mm256_mullo_epi16(slo, scale));
+            shi = div255x16(_mm256_mullo_epi16(shi, scale));
+        }
+        __m256i lo = applyAvx2(op, slo, _mm256_unpacklo_epi8(d, zero));
+        __m256i hi = applyAvx2(op, shi, _mm256_unpackhi_epi8(d, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+const Kernels kSse41Kernels = {BlendIsa::SSE41, fillSse41, blendSse41, compositeSse41};
+const Kernels kAvx2Kernels = {BlendIsa::AVX2, fillAvx2, blendAvx2, compositeAvx2};
+
+#endif // RENDERER_BLEND_X86
+
+#if RENDERER_BLEND_NEON
+
+// NEON: eight pixels per step, loaded as one vector per channel
+inline uint8x8_t div255x8(uint16x8_t x) {
+    return vraddhn_u16(x, vrshrq_n_u16(x, 8));
+}
+
+inline uint8x8x4_t applyNeon(FastOp op, uint8x8x4_t s, uint8x8x4_t d) {
+    uint8x8x4_t out;
+    uint8x8_t inverseSa = vmvn_u8(s.val[3]);
+    uint8x8_t inverseDa = vmvn_u8(d.val[3]);
+    for (int c = 0; c < 4; ++c) {
+        switch (op) {
+            case FastOp::Multiply:
+                out.val[c] = vqadd_u8(vqadd_u8(div255x8(vmull_u8(s.val[c], inverseDa)),
+                                               div255x8(vmull_u8(d.val[c], inverseSa))),
+                                      div255x8(vmull_u8(s.val[c], d.val[c])));
+                break;
+            case FastOp::Screen:
+                out.val[c] = vqadd_u8(s.val[c], vsub_u8(d.val[c], div255x8(vmull_u8(s.val[c], d.val[c]))));
+                break;
+            default:
+                out.val[c] = vqadd_u8(s.val[c], div255x8(vmull_u8(d.val[c], inverseSa)));
+                break;
+        }
+    }
+    return out;
+}
+
+int fillNeon(uint8_t* dst, int count, uint32_t color) {
+    uint32x4_t c = vdupq_n_u32(color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(reinterpret_cast<uint32_t*>(dst + i * 4), c);
+    }
+    return i;
+}
+
+int blendNeon(uint8_t* dst, int count, const uint8_t color[4], const uint8_t* coverage, FastOp op) {
+    uint8x8x4_t c;
+    for (int channel = 0; channel < 4; ++channel) {
+        c.val[channel] = vdup_n_u8(color[channel]);
+    }
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t s = c;
+        if (coverage) {
+            uint8x8_t cov = vld1_u8(coverage + i);
+            for (int channel = 0; channel < 4; ++channel) {
+                s.val[channel] = div255x8(vmull_u8(c.val[channel], cov));
+            }
+        }
+        vst4_u8(dst + i * 4, applyNeon(op, s, vld4_u8(dst + i * 4)));
+    }
+    return i;
+}
+
+int compositeNeon(uint8_t* dst, const uint8_t* src, int count, FastOp op, uint8_t alpha) {
+    uint8x8_t scale = vdup_n_u8(alpha);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t s = vld4_u8(src + i * 4);
+        if (alpha != 255) {
+            for (int channel = 0; channel < 4; ++channel) {
+                s.val[channel] = div255x8(vmull_u8(s.val[channel], scale));
+            }
+        }
+        vst4_u8(dst + i * 4, applyNeon(op, s, vld4_u8(dst + i * 4)));
+    }
+    return i;
+}
+
+const Kernels kNeonKernels = {BlendIsa::NEON, fillNeon, blendNeon, compositeNeon};
+
+#endif // RENDERER_BLEND_NEON
+
+const Kernels* kernelsFor(BlendIsa isa) {
+    switch (isa) {
+#if RENDERER_BLEND_X86
+        case BlendIsa::AVX2:
+            return __builtin_cpu_supports("avx2") ? &kAvx2Kernels : nullptr;
+        case BlendIsa::SSE41:
+            return __builtin_cpu_supports("sse4.1") ? &kSse41Kernels : nullptr;
+#endif
+#if RENDERER_BLEND_NEON
+        case BlendIsa::NEON:
+            return &kNeonKernels;
+#endif
+        case BlendIsa::Scalar:
+            return &kScalarKernels;
+        default:
+            return nullptr;
+    }
+}
+
+std::atomic<const Kernels*> selectedKernels(nullptr);
+
+const Kernels& kernels() {
+    const Kernels* selected = selectedKernels.load(std::memory_order_acquire);
+    if (!selected) {
+        selected = kernelsFor(bestBlendIsa());
+        selectedKernels.store(selected, std::memory_order_release);
+    }
+    return *selected;
+}
+
+} // namespace
+
+void fillSpan(uint8_t* dst, int count, const uint8_t color[4]) {
+    uint32_t packed = load32(color);
+    int done = kernels().fill(dst, count, packed);
+    for (int i = done; i < count; ++i) {
+        std::memcpy(dst + i * 4, &packed, 4);
+    }
+}
+
+void blendSpan(uint8_t* dst, int count, const uint8_t color[4], const uint8_t* coverage, BlendMode mode) {
+    // A transparent premultiplied color leaves dst as it is in every mode
+    if (color[3] == 0) return;
+
+    FastOp op = fastOp(mode);
+    int done = op != FastOp::None ? kernels().blend(dst, count, color, coverage, op) : 0;
+    blendScalar(dst + done * 4, count - done, color, coverage ? coverage + done : nullptr, mode);
+}
+
+void compositeSpan(uint8_t* dst, const uint8_t* src, int count, BlendMode mode, uint8_t alpha) {
+    if (alpha == 0) return;
+
+    FastOp op = fastOp(mode);
+    int done = op != FastOp::None ? kernels().composite(dst, src, count, op, alpha) : 0;
+    compositeScalar(dst + done * 4, src + done * 4, count - done, mode, alpha);
+}
+
+BlendIsa blendIsa() {
+    return kernels().isa;
+}
+
+BlendIsa bestBlendIsa() {
+    static const BlendIsa best = [] {
+        for (BlendIsa isa : {BlendIsa::AVX2, BlendIsa::SSE41, BlendIsa::NEON}) {
+            if (kernelsFor(isa)) return isa;
+        }
+        return BlendIsa::Scalar;
+    }();
+    return best;
+}
+
+bool setBlendIsa(BlendIsa isa) {
+    const Kernels* selected = kernelsFor(isa);
+    if (!selected) return false;
+
+    selectedKernels.store(selected, std::memory_order_release);
+    return true;
+}
+
+} // namespace renderer
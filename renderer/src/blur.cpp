@@ -0,0 +1,325 @@
+#include "renderer/blur.h"
+#include "renderer/blend.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RENDERER_BLUR_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#define RENDERER_BLUR_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace renderer {
+
+namespace {
+
+// Box means are sums times a 24-bit fixed-point reciprocal
+constexpr int kScaleBits = 24;
+constexpr uint32_t kHalf = 1u << (kScaleBits - 1);
+
+uint32_t load32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+// Vertical box passes keep a running sum per column. Vector kernels return
+// how many columns they handled; the scalar loops do the rest.
+struct BlurKernels {
+    // sums += add - sub, column by column
+    int (*slide)(uint32_t* sums, const uint8_t* add, const uint8_t* sub, int count);
+    // out = sums * scale, rounded, in 8.24 fixed point
+    int (*store)(const uint32_t* sums, uint8_t* out, int count, uint32_t scale);
+};
+
+int slideNone(uint32_t*, const uint8_t*, const uint8_t*, int) {
+    return 0;
+}
+
+int storeNone(const uint32_t*, uint8_t*, int, uint32_t) {
+    return 0;
+}
+
+const BlurKernels kScalarBlur = {slideNone, storeNone};
+
+#if RENDERER_BLUR_X86
+
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+
+TARGET_SSE41 int slideSse41(uint32_t* sums, const uint8_t* add, const uint8_t* sub, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(load32(add + i))));
+        __m128i s = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(load32(sub + i))));
+        __m128i* p = reinterpret_cast<__m128i*>(sums + i);
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_sub_epi32(a, s)));
+    }
+    return i;
+}
+
+TARGET_SSE41 int storeSse41(const uint32_t* sums, uint8_t* out, int count, uint32_t scale) {
+    const __m128i factor = _mm_set1_epi32(static_cast<int>(scale));
+    const __m128i half = _mm_set1_epi32(static_cast<int>(kHalf));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + i));
+        v = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(v, factor), half), kScaleBits);
+        v = _mm_packus_epi16(_mm_packus_epi32(v, v), v);
+        uint32_t bytes = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+        std::memcpy(out + i, &bytes, 4);
+    }
+    return i;
+}
+
+const BlurKernels kSse41Blur = {slideSse41, storeSse41};
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+TARGET_AVX2 int slideAvx2(uint32_t* sums, const uint8_t* add, const uint8_t* sub, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(add + i)));
+        __m256i s = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sub + i)));
+        __m256i* p = reinterpret_cast<__m256i*>(sums + i);
+        _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), _mm256_sub_epi32(a, s)));
+    }
+    return i;
+}
+
+// Packing stays within 128-bit lanes, so each lane ends with four bytes
+TARGET_AVX2 int storeAvx2(const uint32_t* sums, uint8_t* out, int count, uint32_t scale) {
+    const __m256i factor = _mm256_set1_epi32(static_cast<int>(scale));
+    const __m256i half = _mm256_set1_epi32(static_cast<int>(kHalf));
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums + i));
+        v = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(v, factor), half), kScaleBits);
+        v = _mm256_packus_epi16(_mm256_packus_epi32(v, v), v);
+        uint32_t low = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(v)));
+        uint32_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(v, 1)));
+        std::memcpy(out + i, &low, 4);
+        std::memcpy(out + i + 4, &high, 4);
+    }
+    return i;
+}
+
+const BlurKernels kAvx2Blur = {slideAvx2, storeAvx2};
+
+#endif // RENDERER_BLUR_X86
+
+#if RENDERER_BLUR_NEON
+
+int slideNeon(uint32_t* sums, const uint8_t* add, const uint8_t* sub, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t a = vmovl_u8(vld1_u8(add + i));
+        uint16x8_t s = vmovl_u8(vld1_u8(sub + i));
+        uint32x4_t lo = vsubq_u32(vmovl_u16(vget_low_u16(a)), vmovl_u16(vget_low_u16(s)));
+        uint32x4_t hi = vsubq_u32(vmovl_u16(vget_high_u16(a)), vmovl_u16(vget_high_u16(s)));
+        vst1q_u32(sums + i, vaddq_u32(vld1q_u32(sums + i), lo));
+        vst1q_u32(sums + i + 4, vaddq_u32(vld1q_u32(sums + i + 4), hi));
+    }
+    return i;
+}
+
+int storeNeon(const uint32_t* sums, uint8_t* out, int count, uint32_t scale) {
+    const uint32x4_t half = vdupq_n_u32(kHalf);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32x4_t lo = vshrq_n_u32(vmlaq_n_u32(half, vld1q_u32(sums + i), scale), kScaleBits);
+        uint32x4_t hi = vshrq_n_u32(vmlaq_n_u32(half, vld1q_u32(sums + i + 4), scale), kScaleBits);
+        vst1_u8(out + i, vmovn_u16(vcombine_u16(vmovn_u32(lo), vmovn_u32(hi))));
+    }
+    return i;
+}
+
+const BlurKernels kNeonBlur = {slideNeon, storeNeon};
+
+#endif // RENDERER_BLUR_NEON
+
+// Follows the blend kernels' set, so forcing one for comparison forces both
+const BlurKernels& blurKernels() {
+    switch (blendIsa()) {
+#if RENDERER_BLUR_X86
+        case BlendIsa::AVX2:
+            return kAvx2Blur;
+        case BlendIsa::SSE41:
+            return kSse41Blur;
+#endif
+#if RENDERER_BLUR_NEON
+        case BlendIsa::NEON:
+            return kNeonBlur;
+#endif
+        default:
+            return kScalarBlur;
+    }
+}
+
+// Radii of the three boxes whose sum of variances is closest to sigma's
+void boxRadii(double sigma, int radii[3]) {
+    double variance = 12 * sigma * sigma;
+    int lower = static_cast<int>(std::floor(std::sqrt(variance / 3 + 1)));
+    if (lower % 2 == 0) --lower;
+    lower = std::max(lower, 1);
+    int upper = lower + 2;
+    double lowerCount = (variance - 3.0 * lower * lower - 12.0 * lower - 9) / (-4.0 * lower - 4);
+    int count = static_cast<int>(std::lround(lowerCount));
+    for (int i = 0; i < 3; ++i) {
+        radii[i] = ((i < count ? lower : upper) - 1) / 2;
+    }
+}
+
+// One vertical box pass from src to dst, both width x height and packed
+void boxColumns(const BlurKernels& kernels, const uint8_t* src, uint8_t* dst, int width, int height, int radius,
+                std::vector<uint32_t>& sums, const std::vector<uint8_t>& zeros) {
+    uint32_t size = static_cast<uint32_t>(radius * 2 + 1);
+    uint32_t scale = ((1u << kScaleBits) + size / 2) / size;
+    std::fill_n(sums.begin(), width, 0u);
+
+    auto slide = [&](const uint8_t* add, const uint8_t* sub) {
+        int done = kernels.slide(sums.data(), add, sub, width);
+        for (int x = done; x < width; ++x) {
+            sums[x] += static_cast<uint32_t>(add[x]) - sub[x];
+        }
+    };
+    auto row = [&](int y) {
+        return y >= 0 && y < height ? src + static_cast<size_t>(y) * width : zeros.data();
+    };
+
+    // The window of row 0: rows -radius to radius
+    for (int y = 0; y <= radius && y < height; ++y) {
+        slide(row(y), zeros.data());
+    }
+    for (int y = 0; y < height; ++y) {
+        uint8_t* out = dst + static_cast<size_t>(y) * width;
+        int done = kernels.store(sums.data(), out, width, scale);
+        for (int x = done; x < width; ++x) {
+            out[x] = static_cast<uint8_t>((sums[x] * scale + kHalf) >> kScaleBits);
+        }
+        if (y + radius + 1 < height || y - radius >= 0) {
+            slide(row(y + radius + 1), row(y - radius));
+        }
+    }
+}
+
+// Transposes in blocks so both sides stay in cache
+void transpose(const uint8_t* src, uint8_t* dst, int width, int height) {
+    constexpr int kBlock = 32;
+    for (int by = 0; by < height; by += kBlock) {
+        for (int bx = 0; bx < width; bx += kBlock) {
+            int yEnd = std::min(height, by + kBlock);
+            int xEnd = std::min(width, bx + kBlock);
+            for (int y = by; y < yEnd; ++y) {
+                for (int x = bx; x < xEnd; ++x) {
+                    dst[static_cast<size_t>(x) * height + y] = src[static_cast<size_t>(y) * width + x];
+                }
+            }
+        }
+    }
+}
+
+// Three box passes down the columns of a packed plane, in place
+void blurColumns(uint8_t* plane, int width, int height, const int radii[3], std::vector<uint8_t>& scratch) {
+    const BlurKernels& kernels = blurKernels();
+    std::vector<uint32_t> sums(width);
+    std::vector<uint8_t> zeros(width, 0);
+    scratch.resize(static_cast<size_t>(width) * height);
+    uint8_t* from = plane;
+    uint8_t* to = scratch.data();
+    for (int i = 0; i < 3; ++i) {
+        if (radii[i] == 0) continue;
+        boxColumns(kernels, from, to, width, height, radii[i], sums, zeros);
+        std::swap(from, to);
+    }
+    if (from != plane) {
+        std::memcpy(plane, from, static_cast<size_t>(width) * height);
+    }
+}
+
+void blurPlane(uint8_t* plane, int width, int height, double sigma) {
+    int radii[3];
+    boxRadii(sigma, radii);
+    std::vector<uint8_t> scratch;
+    blurColumns(plane, width, height, radii, scratch);
+
+    // Rows become columns, so the horizontal passes vectorize the same way
+    std::vector<uint8_t> transposed(static_cast<size_t>(width) * height);
+    transpose(plane, transposed.data(), width, height);
+    blurColumns(transposed.data(), height, width, radii, scratch);
+    transpose(transposed.data(), plane, height, width);
+}
+
+} // namespace
+
+int blurOutset(double sigma) {
+    return sigma > 0 ? static_cast<int>(std::ceil(sigma * 3)) : 0;
+}
+
+void blurMask(uint8_t* mask, int width, int height, int stride, double sigma) {
+    if (sigma <= 0 || width <= 0 || height <= 0) return;
+
+    int factor = 1;
+    while (sigma / factor > kMaxDirectSigma) {
+        factor *= 2;
+    }
+    int smallWidth = (width + factor - 1) / factor;
+    int smallHeight = (height + factor - 1) / factor;
+    std::vector<uint8_t> plane(static_cast<size_t>(smallWidth) * smallHeight);
+
+    // Box-downsample; edge blocks average what they cover
+    for (int y = 0; y < smallHeight && factor > 1; ++y) {
+        for (int x = 0; x < smallWidth; ++x) {
+            int yEnd = std::min(height, (y + 1) * factor);
+            int xEnd = std::min(width, (x + 1) * factor);
+            unsigned sum = 0, count = 0;
+            for (int sy = y * factor; sy < yEnd; ++sy) {
+                for (int sx = x * factor; sx < xEnd; ++sx) {
+                    sum += mask[static_cast<size_t>(sy) * stride + sx];
+                    ++count;
+                }
+            }
+            plane[static_cast<size_t>(y) * smallWidth + x] = static_cast<uint8_t>((sum + count / 2) / count);
+        }
+    }
+
+    if (factor == 1) {
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(&plane[static_cast<size_t>(y) * width], mask + static_cast<size_t>(y) * stride, width);
+        }
+    }
+
+    blurPlane(plane.data(), smallWidth, smallHeight, sigma / factor);
+
+    if (factor == 1) {
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(mask + static_cast<size_t>(y) * stride, &plane[static_cast<size_t>(y) * width], width);
+        }
+        return;
+    }
+
+    // Bilinear upsample from the downsampled pixel centers
+    auto sample = [&](int x, int y) { return static_cast<double>(plane[static_cast<size_t>(y) * smallWidth + x]); };
+    for (int y = 0; y < height; ++y) {
+        double v = std::clamp((y + 0.5) / factor - 0.5, 0.0, smallHeight - 1.0);
+        int y0 = static_cast<int>(v);
+        int y1 = std::min(y0 + 1, smallHeight - 1);
+        double fy = v - y0;
+        for (int x = 0; x < width; ++x) {
+            double u = std::clamp((x + 0.5) / factor - 0.5, 0.0, smallWidth - 1.0);
+            int x0 = static_cast<int>(u);
+            int x1 = std::min(x0 + 1, smallWidth - 1);
+            double fx = u - x0;
+            double top = sample(x0, y0) + (sample(x1, y0) - sample(x0, y0)) * fx;
+            double bottom = sample(x0, y1) + (sample(x1, y1) - sample(x0, y1)) * fx;
+            mask[static_cast<size_t>(y) * stride + x] = static_cast<uint8_t>(std::lround(top + (bottom - top) * fy));
+        }
+    }
+}
+
+} // namespace renderer
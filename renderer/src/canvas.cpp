@@ -1,9 +1,27 @@
 #include "renderer/canvas.h"
+#include "renderer/display_list.h"
+#include "renderer/glyph_cache.h"
+#include "renderer/image.h"
 #include <algorithm>
 #include <cmath>
 
 namespace renderer {
 
+namespace {
+
+Rect imageRect(const Image& image) {
+    return Rect(0, 0, image.get_width(), image.get_height());
+}
+
+Paint strokePaint(const Color& color, double strokeWidth) {
+    Paint paint = Paint::fromColor(color);
+    paint.setStyle(PaintStyle::Stroke);
+    paint.setStrokeWidth(strokeWidth);
+    return paint;
+}
+
+} // namespace
+
 // Canvas implementation
 Canvas::Canvas()
     : surface_(nullptr)
@@ -17,7 +35,10 @@ Canvas::Canvas()
     , currentClip_(Rect())
     , isDirty_(false)
     , isValid_(false)
-    , isReady_(false) {
+    , isReady_(false)
+    , recorder_()
+    , recordingState_()
+    , recordingDepth_(0) {
     initialize();
 }
 
@@ -33,7 +54,10 @@ Canvas::Canvas(std::shared_ptr<Surface> surface)
     , currentClip_(Rect())
     , isDirty_(false)
     , isValid_(false)
-    , isReady_(false) {
+    , isReady_(false)
+    , recorder_()
+    , recordingState_()
+    , recordingDepth_(0) {
     initialize();
 }
 
@@ -64,38 +88,60 @@ void Canvas::setBackend(std::shared_ptr<Backend> backend) {
 void Canvas::save() {
     stateStack_.push_back(currentState_);
     pushState();
+    if (recorder_) {
+        recorder_->save();
+    }
 }
 
 void Canvas::restore() {
-    if (!stateStack_.empty()) {
+    // A recording cannot restore past where it began
+    if (stateStack_.size() > (recorder_ ? recordingDepth_ : 0)) {
         currentState_ = stateStack_.back();
         stateStack_.pop_back();
         applyState(currentState_);
+        if (recorder_) {
+            recorder_->restore();
+            recorder_->setState(currentMatrix_, currentClip_);
+        }
     }
 }
 
 void Canvas::saveLayer(const Paint& paint) {
+    if (recorder_) {
+        stateStack_.push_back(currentState_);
+        pushState();
+        recorder_->saveLayer(nullptr, paint);
+        return;
+    }
+    
     // This is a simplified implementation
     // In a real implementation, this would save a layer with paint
     save();
 }
 
 void Canvas::saveLayer(const Rect& bounds, const Paint& paint) {
+    if (recorder_) {
+        stateStack_.push_back(currentState_);
+        pushState();
+        recorder_->saveLayer(&bounds, paint);
+        return;
+    }
+    
     // This is a simplified implementation
     // In a real implementation, this would save a layer with bounds and paint
     save();
 }
 
 void Canvas::saveLayerAlpha(uint8_t alpha) {
-    // This is a simplified implementation
-    // In a real implementation, this would save a layer with alpha
-    save();
+    Paint paint;
+    paint.setOpacity(alpha / 255.0);
+    saveLayer(paint);
 }
 
 void Canvas::saveLayerAlpha(const Rect& bounds, uint8_t alpha) {
-    // This is a simplified implementation
-    // In a real implementation, this would save a layer with bounds and alpha
-    save();
+    Paint paint;
+    paint.setOpacity(alpha / 255.0);
+    saveLayer(bounds, paint);
 }
 
 void Canvas::translate(double dx, double dy) {
@@ -161,30 +207,49 @@ void Canvas::resetMatrix() {
 }
 
 void Canvas::clipRect(const Rect& rect) {
+    clipRect(rect, false);
+}
+
+void Canvas::clipRect(const Rect& rect, bool antiAlias) {
+    // The clip is kept in device space
+    Rect deviceRect = currentMatrix_.transform(rect);
     if (currentClip_.isEmpty()) {
-        currentClip_ = rect;
+        currentClip_ = deviceRect;
     } else {
-        currentClip_ = currentClip_.intersection(rect);
+        currentClip_ = currentClip_.intersection(deviceRect);
+    }
+    if (recorder_) {
+        recorder_->clipRect(rect, antiAlias ? DisplayList::kClipAntiAlias : 0);
     }
     updateClip();
 }
 
-void Canvas::clipRect(const Rect& rect, bool antiAlias) {
-    // This is a simplified implementation
-    // In a real implementation, this would handle anti-aliasing
-    clipRect(rect);
-}
-
 void Canvas::clipPath(const Path& path) {
-    // This is a simplified implementation
-    // In a real implementation, this would handle path clipping
-    updateClip();
+    clipPath(path, false);
 }
 
 void Canvas::clipPath(const Path& path, bool antiAlias) {
-    // This is a simplified implementation
-    // In a real implementation, this would handle path clipping with anti-aliasing
-    clipPath(path);
+    if (path.is_empty()) {
+        updateClip();
+        return;
+    }
+    Rect rect;
+    if (path.is_rect(&rect)) {
+        clipRect(rect, antiAlias);
+        return;
+    }
+    // The canvas keeps the path's bounds, which hold everything it keeps;
+    // a recording keeps the path for the rasterizer to mask with
+    Rect deviceBounds = currentMatrix_.transform(path.get_bounds());
+    if (currentClip_.isEmpty()) {
+        currentClip_ = deviceBounds;
+    } else {
+        currentClip_ = currentClip_.intersection(deviceBounds);
+    }
+    if (recorder_) {
+        recorder_->clipPath(path, antiAlias ? DisplayList::kClipAntiAlias : 0);
+    }
+    updateClip();
 }
 
 void Canvas::clipRegion(const Rect& region) {
@@ -196,27 +261,35 @@ void Canvas::clipRegion(const Rect& region, bool antiAlias) {
 }
 
 void Canvas::clipOutRect(const Rect& rect) {
-    // This is a simplified implementation
-    // In a real implementation, this would handle clip out operations
-    updateClip();
+    clipOutRect(rect, false);
 }
 
 void Canvas::clipOutRect(const Rect& rect, bool antiAlias) {
-    // This is a simplified implementation
-    // In a real implementation, this would handle clip out operations with anti-aliasing
-    clipOutRect(rect);
+    // What is left need not be a rect, so the bounds stay
+    if (recorder_) {
+        recorder_->clipRect(rect, DisplayList::kClipOut | (antiAlias ? DisplayList::kClipAntiAlias : 0));
+    }
+    updateClip();
 }
 
 void Canvas::clipOutPath(const Path& path) {
-    // This is a simplified implementation
-    // In a real implementation, this would handle clip out path operations
-    updateClip();
+    clipOutPath(path, false);
 }
 
 void Canvas::clipOutPath(const Path& path, bool antiAlias) {
-    // This is a simplified implementation
-    // In a real implementation, this would handle clip out path operations with anti-aliasing
-    clipOutPath(path);
+    if (path.is_empty()) {
+        updateClip();
+        return;
+    }
+    Rect rect;
+    if (path.is_rect(&rect)) {
+        clipOutRect(rect, antiAlias);
+        return;
+    }
+    if (recorder_) {
+        recorder_->clipPath(path, DisplayList::kClipOut | (antiAlias ? DisplayList::kClipAntiAlias : 0));
+    }
+    updateClip();
 }
 
 void Canvas::clipOutRegion(const Rect& region) {
@@ -260,6 +333,10 @@ bool Canvas::isClipOut() const {
 }
 
 void Canvas::drawColor(const Color& color) {
+    if (recorder_) {
+        recorder_->drawColor(color, BlendMode::Normal);
+        return;
+    }
     if (!surface_) return;
     
     // Draw color to surface
@@ -269,6 +346,10 @@ void Canvas::drawColor(const Color& color) {
 }
 
 void Canvas::drawColor(const Color& color, BlendMode blendMode) {
+    if (recorder_) {
+        recorder_->drawColor(color, blendMode);
+        return;
+    }
     if (!surface_) return;
     
     // Draw color to surface with blend mode
@@ -278,6 +359,10 @@ void Canvas::drawColor(const Color& color, BlendMode blendMode) {
 }
 
 void Canvas::drawPaint(const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawPaint(paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw paint to surface
@@ -287,6 +372,10 @@ void Canvas::drawPaint(const Paint& paint) {
 }
 
 void Canvas::drawRect(const Rect& rect, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawRect(rect, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw rectangle to surface
@@ -296,6 +385,10 @@ void Canvas::drawRect(const Rect& rect, const Paint& paint) {
 }
 
 void Canvas::drawRoundRect(const Rect& rect, double rx, double ry, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawRoundRect(rect, rx, ry, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw rounded rectangle to surface
@@ -305,6 +398,10 @@ void Canvas::drawRoundRect(const Rect& rect, double rx, double ry, const Paint&
 }
 
 void Canvas::drawCircle(const Point& center, double radius, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawOval(Rect(center.x - radius, center.y - radius, radius * 2, radius * 2), paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw circle to surface
@@ -314,6 +411,10 @@ void Canvas::drawCircle(const Point& center, double radius, const Paint& paint)
 }
 
 void Canvas::drawOval(const Rect& rect, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawOval(rect, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw oval to surface
@@ -323,6 +424,10 @@ void Canvas::drawOval(const Rect& rect, const Paint& paint) {
 }
 
 void Canvas::drawArc(const Rect& rect, double startAngle, double sweepAngle, bool useCenter, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawArc(rect, startAngle, sweepAngle, useCenter, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw arc to surface
@@ -332,6 +437,10 @@ void Canvas::drawArc(const Rect& rect, double startAngle, double sweepAngle, boo
 }
 
 void Canvas::drawPath(const Path& path, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawPath(path, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw path to surface
@@ -341,6 +450,10 @@ void Canvas::drawPath(const Path& path, const Paint& paint) {
 }
 
 void Canvas::drawLine(const Point& start, const Point& end, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawLine(start, end, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw line to surface
@@ -350,6 +463,10 @@ void Canvas::drawLine(const Point& start, const Point& end, const Paint& paint)
 }
 
 void Canvas::drawPoint(const Point& point, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawPoints(std::vector<Point>{point}, PointMode::Points, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw point to surface
@@ -359,6 +476,10 @@ void Canvas::drawPoint(const Point& point, const Paint& paint) {
 }
 
 void Canvas::drawPoints(const std::vector<Point>& points, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawPoints(points, PointMode::Points, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw points to surface
@@ -368,6 +489,10 @@ void Canvas::drawPoints(const std::vector<Point>& points, const Paint& paint) {
 }
 
 void Canvas::drawPoints(const std::vector<Point>& points, PointMode mode, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawPoints(points, mode, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw points to surface with mode
@@ -377,6 +502,10 @@ void Canvas::drawPoints(const std::vector<Point>& points, PointMode mode, const
 }
 
 void Canvas::drawImage(const Image& image, const Point& point) {
+    if (recorder_) {
+        recorder_->drawImage(image, imageRect(image), Rect(point, imageRect(image).size), Paint());
+        return;
+    }
     if (!surface_) return;
     
     // Draw image to surface
@@ -386,6 +515,10 @@ void Canvas::drawImage(const Image& image, const Point& point) {
 }
 
 void Canvas::drawImage(const Image& image, const Point& point, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawImage(image, imageRect(image), Rect(point, imageRect(image).size), paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw image to surface with paint
@@ -395,6 +528,10 @@ void Canvas::drawImage(const Image& image, const Point& point, const Paint& pain
 }
 
 void Canvas::drawImage(const Image& image, const Rect& destRect) {
+    if (recorder_) {
+        recorder_->drawImage(image, imageRect(image), destRect, Paint());
+        return;
+    }
     if (!surface_) return;
     
     // Draw image to surface with destination rectangle
@@ -404,6 +541,10 @@ void Canvas::drawImage(const Image& image, const Rect& destRect) {
 }
 
 void Canvas::drawImage(const Image& image, const Rect& destRect, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawImage(image, imageRect(image), destRect, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw image to surface with destination rectangle and paint
@@ -413,6 +554,10 @@ void Canvas::drawImage(const Image& image, const Rect& destRect, const Paint& pa
 }
 
 void Canvas::drawImage(const Image& image, const Rect& srcRect, const Rect& destRect) {
+    if (recorder_) {
+        recorder_->drawImage(image, srcRect, destRect, Paint());
+        return;
+    }
     if (!surface_) return;
     
     // Draw image to surface with source and destination rectangles
@@ -422,6 +567,10 @@ void Canvas::drawImage(const Image& image, const Rect& srcRect, const Rect& dest
 }
 
 void Canvas::drawImage(const Image& image, const Rect& srcRect, const Rect& destRect, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawImage(image, srcRect, destRect, paint);
+        return;
+    }
     if (!surface_) return;
     
     // Draw image to surface with source and destination rectangles and paint
@@ -435,12 +584,15 @@ void Canvas::drawImageRect(const Image& image, const Rect& srcRect, const Rect&
 }
 
 void Canvas::drawImageRect(const Image& image, const Rect& srcRect, const Rect& destRect, const Paint& paint, SrcRectConstraint constraint) {
-    // This is a simplified implementation
-    // In a real implementation, this would handle source rectangle constraint
+    // Scaling never samples outside srcRect, so both constraints draw as Strict
     drawImage(image, srcRect, destRect, paint);
 }
 
 void Canvas::drawText(const std::string& text, const Point& point, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawText(text, point, paint, getTextBounds(text, point, paint), nullptr);
+        return;
+    }
     if (!surface_) return;
     
     // Draw text to surface
@@ -454,6 +606,10 @@ void Canvas::drawText(const std::string& text, double x, double y, const Paint&
 }
 
 void Canvas::drawText(const std::string& text, const Point& point, const Paint& paint, const Rect& bounds) {
+    if (recorder_) {
+        recorder_->drawText(text, point, paint, getTextBounds(text, point, paint), &bounds);
+        return;
+    }
     if (!surface_) return;
     
     // Draw text to surface with bounds
@@ -485,6 +641,10 @@ void Canvas::drawTextOnPath(const std::string& text, const Path& path, double hO
 }
 
 void Canvas::drawTextBlob(const TextBlob& blob, const Point& point, const Paint& paint) {
+    if (recorder_) {
+        recorder_->drawTextBlob(blob, point, paint, Rect(point + blob.bounds().origin, blob.bounds().size));
+        return;
+    }
     if (!surface_) return;
     
     // Draw text blob to surface
@@ -623,7 +783,42 @@ void Canvas::drawCanvas(const Canvas& canvas, const Rect& srcRect, const Rect& d
     isDirty_ = true;
 }
 
+void Canvas::beginRecording() {
+    if (recorder_) return;
+    
+    recordingState_ = CanvasState(currentMatrix_, currentClip_, currentPaint_);
+    recordingDepth_ = stateStack_.size();
+    currentMatrix_ = Matrix::identity();
+    currentClip_ = Rect();
+    updateState();
+    recorder_ = std::make_unique<DisplayListRecorder>();
+}
+
+std::shared_ptr<const DisplayList> Canvas::finishRecording() {
+    if (!recorder_) return nullptr;
+    
+    std::shared_ptr<const DisplayList> list = recorder_->finish();
+    recorder_.reset();
+    
+    // Saves left open by the recording are dropped with it
+    stateStack_.erase(stateStack_.begin() + static_cast<std::ptrdiff_t>(std::min(recordingDepth_, stateStack_.size())),
+                      stateStack_.end());
+    currentMatrix_ = recordingState_.matrix;
+    currentClip_ = recordingState_.clip;
+    currentPaint_ = recordingState_.paint;
+    updateState();
+    return list;
+}
+
+void Canvas::drawDisplayList(const DisplayList& list) {
+    list.playback(*this);
+}
+
 void Canvas::clear() {
+    if (recorder_) {
+        recorder_->clear(nullptr, Color::transparent());
+        return;
+    }
     if (!surface_) return;
     
     // Clear surface
@@ -633,6 +828,10 @@ void Canvas::clear() {
 }
 
 void Canvas::clear(const Color& color) {
+    if (recorder_) {
+        recorder_->clear(nullptr, color);
+        return;
+    }
     if (!surface_) return;
     
     // Clear surface with color
@@ -642,6 +841,10 @@ void Canvas::clear(const Color& color) {
 }
 
 void Canvas::clear(const Rect& rect) {
+    if (recorder_) {
+        recorder_->clear(&rect, Color::transparent());
+        return;
+    }
     if (!surface_) return;
     
     // Clear surface rectangle
@@ -651,6 +854,10 @@ void Canvas::clear(const Rect& rect) {
 }
 
 void Canvas::clear(const Rect& rect, const Color& color) {
+    if (recorder_) {
+        recorder_->clear(&rect, color);
+        return;
+    }
     if (!surface_) return;
     
     // Clear surface rectangle with color
@@ -660,6 +867,10 @@ void Canvas::clear(const Rect& rect, const Color& color) {
 }
 
 void Canvas::fillRect(const Rect& rect, const Color& color) {
+    if (recorder_) {
+        recorder_->drawRect(rect, Paint::fromColor(color));
+        return;
+    }
     if (!surface_) return;
     
     // Fill rectangle with color
@@ -669,6 +880,10 @@ void Canvas::fillRect(const Rect& rect, const Color& color) {
 }
 
 void Canvas::fillRoundRect(const Rect& rect, double rx, double ry, const Color& color) {
+    if (recorder_) {
+        recorder_->drawRoundRect(rect, rx, ry, Paint::fromColor(color));
+        return;
+    }
     if (!surface_) return;
     
     // Fill rounded rectangle with color
@@ -678,6 +893,10 @@ void Canvas::fillRoundRect(const Rect& rect, double rx, double ry, const Color&
 }
 
 void Canvas::fillCircle(const Point& center, double radius, const Color& color) {
+    if (recorder_) {
+        recorder_->drawOval(Rect(center.x - radius, center.y - radius, radius * 2, radius * 2), Paint::fromColor(color));
+        return;
+    }
     if (!surface_) return;
     
     // Fill circle with color
@@ -687,6 +906,10 @@ void Canvas::fillCircle(const Point& center, double radius, const Color& color)
 }
 
 void Canvas::fillOval(const Rect& rect, const Color& color) {
+    if (recorder_) {
+        recorder_->drawOval(rect, Paint::fromColor(color));
+        return;
+    }
     if (!surface_) return;
     
     // Fill oval with color
@@ -696,6 +919,10 @@ void Canvas::fillOval(const Rect& rect, const Color& color) {
 }
 
 void Canvas::fillArc(const Rect& rect, double startAngle, double sweepAngle, bool useCenter, const Color& color) {
+    if (recorder_) {
+        recorder_->drawArc(rect, startAngle, sweepAngle, useCenter, Paint::fromColor(color));
+        return;
+    }
     if (!surface_) return;
     
     // Fill arc with color
@@ -705,6 +932,10 @@ void Canvas::fillArc(const Rect& rect, double startAngle, double sweepAngle, boo
 }
 
 void Canvas::fillPath(const Path& path, const Color& color) {
+    if (recorder_) {
+        recorder_->drawPath(path, Paint::fromColor(color));
+        return;
+    }
     if (!surface_) return;
     
     // Fill path with color
@@ -714,6 +945,10 @@ void Canvas::fillPath(const Path& path, const Color& color) {
 }
 
 void Canvas::strokeRect(const Rect& rect, const Color& color) {
+    if (recorder_) {
+        recorder_->drawRect(rect, strokePaint(color, 1));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke rectangle with color
@@ -723,6 +958,10 @@ void Canvas::strokeRect(const Rect& rect, const Color& color) {
 }
 
 void Canvas::strokeRect(const Rect& rect, const Color& color, double strokeWidth) {
+    if (recorder_) {
+        recorder_->drawRect(rect, strokePaint(color, strokeWidth));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke rectangle with color and width
@@ -732,6 +971,10 @@ void Canvas::strokeRect(const Rect& rect, const Color& color, double strokeWidth
 }
 
 void Canvas::strokeRoundRect(const Rect& rect, double rx, double ry, const Color& color) {
+    if (recorder_) {
+        recorder_->drawRoundRect(rect, rx, ry, strokePaint(color, 1));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke rounded rectangle with color
@@ -741,6 +984,10 @@ void Canvas::strokeRoundRect(const Rect& rect, double rx, double ry, const Color
 }
 
 void Canvas::strokeRoundRect(const Rect& rect, double rx, double ry, const Color& color, double strokeWidth) {
+    if (recorder_) {
+        recorder_->drawRoundRect(rect, rx, ry, strokePaint(color, strokeWidth));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke rounded rectangle with color and width
@@ -750,6 +997,10 @@ void Canvas::strokeRoundRect(const Rect& rect, double rx, double ry, const Color
 }
 
 void Canvas::strokeCircle(const Point& center, double radius, const Color& color) {
+    if (recorder_) {
+        recorder_->drawOval(Rect(center.x - radius, center.y - radius, radius * 2, radius * 2), strokePaint(color, 1));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke circle with color
@@ -759,6 +1010,10 @@ void Canvas::strokeCircle(const Point& center, double radius, const Color& color
 }
 
 void Canvas::strokeCircle(const Point& center, double radius, const Color& color, double strokeWidth) {
+    if (recorder_) {
+        recorder_->drawOval(Rect(center.x - radius, center.y - radius, radius * 2, radius * 2), strokePaint(color, strokeWidth));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke circle with color and width
@@ -768,6 +1023,10 @@ void Canvas::strokeCircle(const Point& center, double radius, const Color& color
 }
 
 void Canvas::strokeOval(const Rect& rect, const Color& color) {
+    if (recorder_) {
+        recorder_->drawOval(rect, strokePaint(color, 1));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke oval with color
@@ -777,6 +1036,10 @@ void Canvas::strokeOval(const Rect& rect, const Color& color) {
 }
 
 void Canvas::strokeOval(const Rect& rect, const Color& color, double strokeWidth) {
+    if (recorder_) {
+        recorder_->drawOval(rect, strokePaint(color, strokeWidth));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke oval with color and width
@@ -786,6 +1049,10 @@ void Canvas::strokeOval(const Rect& rect, const Color& color, double strokeWidth
 }
 
 void Canvas::strokeArc(const Rect& rect, double startAngle, double sweepAngle, bool useCenter, const Color& color) {
+    if (recorder_) {
+        recorder_->drawArc(rect, startAngle, sweepAngle, useCenter, strokePaint(color, 1));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke arc with color
@@ -795,6 +1062,10 @@ void Canvas::strokeArc(const Rect& rect, double startAngle, double sweepAngle, b
 }
 
 void Canvas::strokeArc(const Rect& rect, double startAngle, double sweepAngle, bool useCenter, const Color& color, double strokeWidth) {
+    if (recorder_) {
+        recorder_->drawArc(rect, startAngle, sweepAngle, useCenter, strokePaint(color, strokeWidth));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke arc with color and width
@@ -804,6 +1075,10 @@ void Canvas::strokeArc(const Rect& rect, double startAngle, double sweepAngle, b
 }
 
 void Canvas::strokePath(const Path& path, const Color& color) {
+    if (recorder_) {
+        recorder_->drawPath(path, strokePaint(color, 1));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke path with color
@@ -813,6 +1088,10 @@ void Canvas::strokePath(const Path& path, const Color& color) {
 }
 
 void Canvas::strokePath(const Path& path, const Color& color, double strokeWidth) {
+    if (recorder_) {
+        recorder_->drawPath(path, strokePaint(color, strokeWidth));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke path with color and width
@@ -822,6 +1101,10 @@ void Canvas::strokePath(const Path& path, const Color& color, double strokeWidth
 }
 
 void Canvas::strokeLine(const Point& start, const Point& end, const Color& color) {
+    if (recorder_) {
+        recorder_->drawLine(start, end, strokePaint(color, 1));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke line with color
@@ -831,6 +1114,10 @@ void Canvas::strokeLine(const Point& start, const Point& end, const Color& color
 }
 
 void Canvas::strokeLine(const Point& start, const Point& end, const Color& color, double strokeWidth) {
+    if (recorder_) {
+        recorder_->drawLine(start, end, strokePaint(color, strokeWidth));
+        return;
+    }
     if (!surface_) return;
     
     // Stroke line with color and width
@@ -840,9 +1127,7 @@ void Canvas::strokeLine(const Point& start, const Point& end, const Color& color
 }
 
 Size Canvas::measureText(const std::string& text, const Paint& paint) const {
-    // This is a simplified implementation
-    // In a real implementation, this would measure text
-    return Size(text.length() * 10, 20); // Approximate size
+    return GlyphCache::shared().measure(text, GlyphCache::fontFor(paint));
 }
 
 double Canvas::measureTextWidth(const std::string& text, const Paint& paint) const {
@@ -861,10 +1146,8 @@ Rect Canvas::getTextBounds(const std::string& text, const Paint& paint) const {
 }
 
 Rect Canvas::getTextBounds(const std::string& text, const Point& point, const Paint& paint) const {
-    // This is a simplified implementation
-    // In a real implementation, this would get text bounds at point
-    Size size = measureText(text, paint);
-    return Rect(point.x, point.y, size.width, size.height);
+    // point is on the baseline
+    return GlyphCache::shared().bounds(text, GlyphCache::fontFor(paint), point);
 }
 
 std::vector<Rect> Canvas::getTextRuns(const std::string& text, const Paint& paint) const {
@@ -880,8 +1163,7 @@ std::vector<Rect> Canvas::getTextRuns(const std::string& text, const Point& poin
     // This is a simplified implementation
     // In a real implementation, this would get text runs at point
     std::vector<Rect> runs;
-    Size size = measureText(text, paint);
-    runs.push_back(Rect(point.x, point.y, size.width, size.height));
+    runs.push_back(getTextBounds(text, point, paint));
     return runs;
 }
 
@@ -954,6 +1236,7 @@ void Canvas::wait() {
 }
 
 void Canvas::reset() {
+    recorder_.reset();
     stateStack_.clear();
     currentState_ = CanvasState();
     currentPaint_ = Paint();
@@ -1184,6 +1467,9 @@ void Canvas::copyFrom(const Canvas& other) {
     isDirty_ = other.isDirty_;
     isValid_ = other.isValid_;
     isReady_ = other.isReady_;
+    // A copy is never recording
+    recorder_.reset();
+    recordingDepth_ = 0;
 }
 
 void Canvas::moveFrom(Canvas&& other) {
@@ -1199,6 +1485,9 @@ void Canvas::moveFrom(Canvas&& other) {
     isDirty_ = other.isDirty_;
     isValid_ = other.isValid_;
     isReady_ = other.isReady_;
+    recorder_ = std::move(other.recorder_);
+    recordingState_ = std::move(other.recordingState_);
+    recordingDepth_ = other.recordingDepth_;
 }
 
 void Canvas::cleanup() {
@@ -1214,6 +1503,7 @@ void Canvas::cleanup() {
     isDirty_ = false;
     isValid_ = false;
     isReady_ = false;
+    recorder_.reset();
 }
 
 void Canvas::initialize() {
@@ -1280,10 +1570,17 @@ void Canvas::applyState(const CanvasState& state) {
 
 void Canvas::updateMatrix() {
     updateState();
+    if (recorder_) {
+        recorder_->setMatrix(currentMatrix_);
+        recorder_->setState(currentMatrix_, currentClip_);
+    }
 }
 
 void Canvas::updateClip() {
     updateState();
+    if (recorder_) {
+        recorder_->setState(currentMatrix_, currentClip_);
+    }
 }
 
 void Canvas::updatePaint() {
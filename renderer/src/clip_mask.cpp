@@ -0,0 +1,155 @@
+#include "renderer/clip_mask.h"
+#include "renderer/paint.h"
+#include "renderer/path.h"
+#include "pixel_math.h"
+#include "scanline.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace renderer {
+
+namespace {
+
+// Translations are keyed in 1/64 pixels
+constexpr int kFractions = 64;
+
+} // namespace
+
+std::shared_ptr<ClipMask> rasterizeClip(const std::vector<PathEdge>& edges, const Matrix& matrix, FillRule rule,
+                                        bool antiAlias) {
+    std::vector<DeviceEdge> device;
+    device.reserve(edges.size());
+    bool first = true;
+    double minX = 0, minY = 0, maxX = 0, maxY = 0;
+    for (const PathEdge& edge : edges) {
+        Point from = matrix.transform(edge.from);
+        Point to = matrix.transform(edge.to);
+        for (const Point& point : {from, to}) {
+            minX = first ? point.x : std::min(minX, point.x);
+            minY = first ? point.y : std::min(minY, point.y);
+            maxX = first ? point.x : std::max(maxX, point.x);
+            maxY = first ? point.y : std::max(maxY, point.y);
+            first = false;
+        }
+        appendDeviceEdge(device, from, to);
+    }
+    if (device.empty()) return nullptr;
+
+    int left = static_cast<int>(std::floor(minX));
+    int top = static_cast<int>(std::floor(minY));
+    int right = static_cast<int>(std::ceil(maxX));
+    int bottom = static_cast<int>(std::ceil(maxY));
+    if (left >= right || top >= bottom) return nullptr;
+
+    auto mask = std::make_shared<ClipMask>();
+    mask->x = left;
+    mask->y = top;
+    mask->width = right - left;
+    mask->height = bottom - top;
+    mask->coverage.assign(static_cast<size_t>(mask->width) * mask->height, 0);
+
+    std::sort(device.begin(), device.end(), [](const DeviceEdge& a, const DeviceEdge& b) { return a.y0 < b.y0; });
+    EdgeCoverage edgeCoverage(device.data(), device.size(), rule, antiAlias);
+    bool covered = false;
+
+    for (int y = top; y < bottom; ++y) {
+        const std::vector<float>& row = edgeCoverage.row(y, left, mask->width);
+        uint8_t* out = mask->coverage.data() + static_cast<size_t>(y - top) * mask->width;
+        for (int x = 0; x < mask->width; ++x) {
+            out[x] = static_cast<uint8_t>(std::lround(std::min(row[x], 1.0f) * 255));
+            covered = covered || out[x] != 0;
+        }
+    }
+    return covered ? mask : nullptr;
+}
+
+std::shared_ptr<ClipMask> intersectClips(const PlacedClipMask& a, const PlacedClipMask& b) {
+    int left = std::max(a.left(), b.left());
+    int top = std::max(a.top(), b.top());
+    int right = std::min(a.right(), b.right());
+    int bottom = std::min(a.bottom(), b.bottom());
+    if (left >= right || top >= bottom) return nullptr;
+
+    auto mask = std::make_shared<ClipMask>();
+    mask->x = left;
+    mask->y = top;
+    mask->width = right - left;
+    mask->height = bottom - top;
+    mask->coverage.resize(static_cast<size_t>(mask->width) * mask->height);
+    for (int y = top; y < bottom; ++y) {
+        uint8_t* out = mask->coverage.data() + static_cast<size_t>(y - top) * mask->width;
+        for (int x = left; x < right; ++x) {
+            out[x - left] = div255(static_cast<unsigned>(a.at(x, y)) * b.at(x, y));
+        }
+    }
+    return mask;
+}
+
+std::shared_ptr<ClipMask> invertClip(const PlacedClipMask& mask, int left, int top, int right, int bottom) {
+    if (left >= right || top >= bottom) return nullptr;
+
+    auto inverted = std::make_shared<ClipMask>();
+    inverted->x = left;
+    inverted->y = top;
+    inverted->width = right - left;
+    inverted->height = bottom - top;
+    inverted->coverage.assign(static_cast<size_t>(inverted->width) * inverted->height, 255);
+    for (int y = std::max(top, mask.top()); y < std::min(bottom, mask.bottom()); ++y) {
+        uint8_t* out = inverted->coverage.data() + static_cast<size_t>(y - top) * inverted->width;
+        for (int x = std::max(left, mask.left()); x < std::min(right, mask.right()); ++x) {
+            out[x - left] = static_cast<uint8_t>(255 - mask.at(x, y));
+        }
+    }
+    return inverted;
+}
+
+size_t ClipMaskCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<uint32_t>()(key.path);
+    auto mix = [&](size_t value) { hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2); };
+    mix(std::hash<double>()(key.m11));
+    mix(std::hash<double>()(key.m12));
+    mix(std::hash<double>()(key.m21));
+    mix(std::hash<double>()(key.m22));
+    mix(static_cast<size_t>(key.fractionX) | static_cast<size_t>(key.fractionY) << 8 |
+        static_cast<size_t>(key.rule) << 16 | static_cast<size_t>(key.antiAlias) << 20);
+    return hash;
+}
+
+// ClipMaskCache implementation
+ClipMaskCache::ClipMaskCache(size_t budgetBytes)
+    : cache_(budgetBytes) {
+}
+
+std::shared_ptr<ClipMaskCache> ClipMaskCache::shared() {
+    static std::shared_ptr<ClipMaskCache> cache = std::make_shared<ClipMaskCache>();
+    return cache;
+}
+
+PlacedClipMask ClipMaskCache::get(const Path& path, const Matrix& matrix, bool antiAlias, PathCache& paths) {
+    if (path.is_empty()) return PlacedClipMask{nullptr, 0, 0};
+
+    // Whole pixels of the translation move the mask; the rest is keyed
+    long long stepsX = std::llround(matrix.m13 * kFractions);
+    long long stepsY = std::llround(matrix.m23 * kFractions);
+    long long wholeX = stepsX >= 0 ? stepsX / kFractions : -((-stepsX + kFractions - 1) / kFractions);
+    long long wholeY = stepsY >= 0 ? stepsY / kFractions : -((-stepsY + kFractions - 1) / kFractions);
+    int fractionX = static_cast<int>(stepsX - wholeX * kFractions);
+    int fractionY = static_cast<int>(stepsY - wholeY * kFractions);
+    PlacedClipMask placed{nullptr, static_cast<int>(wholeX), static_cast<int>(wholeY)};
+    Key key{path.generation_id(), matrix.m11, matrix.m12, matrix.m21, matrix.m22, fractionX, fractionY,
+            path.get_fill_rule(), antiAlias};
+
+    // Covered unlocked; a racing thread may cover the same clip
+    placed.mask = cache_.get(key, [&]() -> std::shared_ptr<const ClipMask> {
+        double scale = std::sqrt(std::abs(matrix.m11 * matrix.m22 - matrix.m12 * matrix.m21));
+        std::shared_ptr<const PathGeometry> geometry = paths.get(path, Paint(), scale > 0 ? scale : 1);
+        if (!geometry) return nullptr;
+        Matrix local(matrix.m11, matrix.m12, static_cast<double>(fractionX) / kFractions, matrix.m21, matrix.m22,
+                     static_cast<double>(fractionY) / kFractions, 0, 0, 1);
+        return rasterizeClip(geometry->fill, local, path.get_fill_rule(), antiAlias);
+    });
+    return placed;
+}
+
+} // namespace renderer
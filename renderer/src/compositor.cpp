@@ -0,0 +1,259 @@
+#include "renderer/compositor.h"
+#include "renderer/blend.h"
+#include "renderer/software.h"
+#include <algorithm>
+#include <cmath>
+
+namespace renderer {
+
+namespace {
+
+bool isIntegerTranslation(const Matrix& m) {
+    return m.m11 == 1 && m.m12 == 0 && m.m21 == 0 && m.m22 == 1 && m.m31 == 0 && m.m32 == 0 && m.m33 == 1 &&
+           m.m13 == std::floor(m.m13) && m.m23 == std::floor(m.m23);
+}
+
+// Bilinear sample of premultiplied pixels; outside them is transparent
+void sample(const uint8_t* pixels, int width, int height, double x, double y, uint8_t out[4]) {
+    int x0 = static_cast<int>(std::floor(x));
+    int y0 = static_cast<int>(std::floor(y));
+    double fx = x - x0;
+    double fy = y - y0;
+    double weights[4] = {(1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy};
+    double sum[4] = {0, 0, 0, 0};
+    for (int corner = 0; corner < 4; ++corner) {
+        int px = x0 + (corner & 1);
+        int py = y0 + (corner >> 1);
+        if (px < 0 || py < 0 || px >= width || py >= height) continue;
+
+        const uint8_t* p = pixels + (static_cast<size_t>(py) * width + px) * 4;
+        for (int c = 0; c < 4; ++c) {
+            sum[c] += p[c] * weights[corner];
+        }
+    }
+    for (int c = 0; c < 4; ++c) {
+        out[c] = static_cast<uint8_t>(std::lround(std::min(sum[c], 255.0)));
+    }
+}
+
+} // namespace
+
+// Compositor implementation
+Compositor::Compositor(int width, int height)
+    : width_(0)
+    , height_(0)
+    , framebuffer_()
+    , root_(nullptr)
+    , placements_()
+    , previous_()
+    , damage_()
+    , composited_()
+    , sampled_()
+    , stats_() {
+    resize(width, height);
+}
+
+Compositor::~Compositor() = default;
+
+void Compositor::setRoot(std::shared_ptr<Layer> root) {
+    // The old tree's bounds are damaged by the next diff
+    root_ = std::move(root);
+}
+
+void Compositor::resize(int width, int height) {
+    width_ = std::max(0, width);
+    height_ = std::max(0, height);
+    framebuffer_.assign(static_cast<size_t>(width_) * height_ * 4, 0);
+    damage_.clear();
+    damage_.add(Rect(0, 0, width_, height_));
+}
+
+void Compositor::invalidate(const Rect& rect) {
+    damage_.add(rect);
+}
+
+const DamageRegion& Compositor::composite() {
+    stats_ = Stats();
+    placements_.clear();
+    if (root_) {
+        flatten(root_.get(), Inherited{Matrix::identity(), 1.0, Rect(0, 0, width_, height_), nullptr});
+    }
+    stats_.layers = placements_.size();
+
+    collectDamage();
+
+    for (const auto& placement : placements_) {
+        if (placement.layer->needsRaster()) {
+            stats_.tilesRasterized += placement.layer->rasterize();
+            ++stats_.layersRasterized;
+        }
+    }
+
+    composited_ = damage_;
+    composited_.clipTo(Rect(0, 0, width_, height_));
+    damage_.clear();
+    for (const auto& rect : composited_.rects()) {
+        compositeRect(rect);
+    }
+    stats_.damagedArea = composited_.area();
+
+    previous_.clear();
+    for (const auto& placement : placements_) {
+        previous_.emplace(placement.layer, placement);
+    }
+    return composited_;
+}
+
+void Compositor::releaseLayerCaches() {
+    if (!root_) return;
+    std::vector<Layer*> pending{root_.get()};
+    while (!pending.empty()) {
+        Layer* layer = pending.back();
+        pending.pop_back();
+        layer->releaseRaster();
+        for (const auto& child : layer->children_) {
+            pending.push_back(child.get());
+        }
+    }
+}
+
+Color Compositor::pixel(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width_ || y >= height_) return Color::transparent();
+
+    const uint8_t* p = &framebuffer_[(static_cast<size_t>(y) * width_ + x) * 4];
+    if (p[3] == 0) return Color::transparent();
+    auto unpremultiply = [&](uint8_t value) {
+        return static_cast<uint8_t>(std::min(255u, (value * 255u + p[3] / 2) / p[3]));
+    };
+    return Color(unpremultiply(p[0]), unpremultiply(p[1]), unpremultiply(p[2]), p[3]);
+}
+
+void Compositor::flatten(Layer* layer, const Inherited& inherited) {
+    if (!layer->visible_) return;
+    double opacity = inherited.opacity * layer->opacity_;
+    if (opacity <= 0) return;
+
+    Matrix local = layer->localMatrix();
+    if (layer->sticky_ && inherited.scroller) {
+        Rect visible(inherited.scroller->scrollOffset_, inherited.scroller->size_);
+        Point shift = layer->stickyConstraint_.offset(visible);
+        if (shift != Point()) {
+            local = Matrix::translation(shift.x, shift.y) * local;
+            ++stats_.stickyLayersShifted;
+        }
+    }
+    Matrix matrix = inherited.matrix * local;
+    if (layer->content_ && !layer->size_.isEmpty()) {
+        Rect bounds = matrix.transform(Rect(Point(), layer->size_)).intersection(inherited.clip);
+        if (!bounds.isEmpty()) {
+            placements_.push_back(Placement{layer, matrix, matrix.inverted(), opacity, layer->blendMode_, bounds});
+        }
+    }
+
+    Inherited children{matrix, opacity, inherited.clip, inherited.scroller};
+    if (layer->scrollContainer_) {
+        children.matrix = matrix * Matrix::translation(-layer->scrollOffset_.x, -layer->scrollOffset_.y);
+        children.clip = matrix.transform(Rect(Point(), layer->size_)).intersection(inherited.clip);
+        children.scroller = layer;
+        if (children.clip.isEmpty()) return;
+    }
+    for (const auto& child : layer->children_) {
+        flatten(child.get(), children);
+    }
+}
+
+// Layers that moved, faded or appeared damage their old and new bounds;
+// those whose content changed in place damage just that part
+void Compositor::collectDamage() {
+    std::vector<Rect> mapped;
+    for (const auto& placement : placements_) {
+        auto it = previous_.find(placement.layer);
+        if (it == previous_.end()) {
+            damage_.add(placement.bounds);
+            continue;
+        }
+
+        const Placement& before = it->second;
+        if (before.matrix != placement.matrix || before.opacity != placement.opacity ||
+            before.blendMode != placement.blendMode || before.bounds != placement.bounds) {
+            damage_.add(before.bounds);
+            damage_.add(placement.bounds);
+        } else {
+            const std::vector<Rect>& rects = placement.layer->contentDamage_.rects();
+            mapped.resize(rects.size());
+            placement.matrix.transform(rects.data(), mapped.data(), rects.size());
+            for (const auto& rect : mapped) {
+                damage_.add(rect);
+            }
+        }
+        previous_.erase(it);
+    }
+
+    // What is left was composited last frame but not now
+    for (const auto& entry : previous_) {
+        damage_.add(entry.second.bounds);
+    }
+}
+
+void Compositor::compositeRect(const Rect& rect) {
+    int left = std::max(0, static_cast<int>(std::floor(rect.left())));
+    int top = std::max(0, static_cast<int>(std::floor(rect.top())));
+    int right = std::min(width_, static_cast<int>(std::ceil(rect.right())));
+    int bottom = std::min(height_, static_cast<int>(std::ceil(rect.bottom())));
+    if (left >= right || top >= bottom) return;
+
+    static const uint8_t transparent[4] = {0, 0, 0, 0};
+    for (int y = top; y < bottom; ++y) {
+        fillSpan(&framebuffer_[(static_cast<size_t>(y) * width_ + left) * 4], right - left, transparent);
+    }
+
+    for (const auto& placement : placements_) {
+        const Rect& bounds = placement.bounds;
+        int layerLeft = std::max(left, static_cast<int>(std::floor(bounds.left())));
+        int layerTop = std::max(top, static_cast<int>(std::floor(bounds.top())));
+        int layerRight = std::min(right, static_cast<int>(std::ceil(bounds.right())));
+        int layerBottom = std::min(bottom, static_cast<int>(std::ceil(bounds.bottom())));
+        if (layerLeft >= layerRight || layerTop >= layerBottom) continue;
+
+        compositeLayer(placement, layerLeft, layerTop, layerRight, layerBottom);
+        ++stats_.layersComposited;
+    }
+}
+
+void Compositor::compositeLayer(const Placement& placement, int left, int top, int right, int bottom) {
+    const SoftwareRasterizer* raster = placement.layer->raster();
+    if (!raster || raster->width() == 0 || raster->height() == 0) return;
+
+    uint8_t alpha = static_cast<uint8_t>(std::lround(placement.opacity * 255));
+    BlendMode mode = placement.blendMode;
+    const uint8_t* pixels = raster->data();
+    int width = raster->width();
+    int height = raster->height();
+
+    if (isIntegerTranslation(placement.matrix)) {
+        // Rows of the cache line up with framebuffer rows
+        int dx = static_cast<int>(placement.matrix.m13);
+        int dy = static_cast<int>(placement.matrix.m23);
+        int x0 = std::max(left, dx);
+        int x1 = std::min(right, dx + width);
+        if (x0 >= x1) return;
+        for (int y = std::max(top, dy); y < std::min(bottom, dy + height); ++y) {
+            const uint8_t* src = pixels + (static_cast<size_t>(y - dy) * width + (x0 - dx)) * 4;
+            compositeSpan(&framebuffer_[(static_cast<size_t>(y) * width_ + x0) * 4], src, x1 - x0, mode, alpha);
+        }
+        return;
+    }
+
+    sampled_.resize(static_cast<size_t>(right - left) * 4);
+    for (int y = top; y < bottom; ++y) {
+        for (int x = left; x < right; ++x) {
+            // Pixel centers on both sides
+            Point p = placement.inverse.transform(Point(x + 0.5, y + 0.5));
+            sample(pixels, width, height, p.x - 0.5, p.y - 0.5, &sampled_[static_cast<size_t>(x - left) * 4]);
+        }
+        compositeSpan(&framebuffer_[(static_cast<size_t>(y) * width_ + left) * 4], sampled_.data(), right - left,
+                      mode, alpha);
+    }
+}
+
+} // namespace renderer
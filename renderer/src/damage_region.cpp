@@ -0,0 +1,136 @@
+#include "renderer/damage_region.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace renderer {
+
+namespace {
+
+// Unions may waste this share of the merged rects' area
+constexpr double kMergeWaste = 0.25;
+
+double rectArea(const Rect& rect) {
+    return rect.isEmpty() ? 0 : rect.width() * rect.height();
+}
+
+double overlapArea(const Rect& a, const Rect& b) {
+    double width = std::min(a.right(), b.right()) - std::max(a.left(), b.left());
+    double height = std::min(a.bottom(), b.bottom()) - std::max(a.top(), b.top());
+    return width > 0 && height > 0 ? width * height : 0;
+}
+
+Rect snapOut(const Rect& rect) {
+    double left = std::floor(rect.left());
+    double top = std::floor(rect.top());
+    return Rect(left, top, std::ceil(rect.right()) - left, std::ceil(rect.bottom()) - top);
+}
+
+} // namespace
+
+// DamageRegion implementation
+DamageRegion::DamageRegion(size_t maxRects)
+    : rects_()
+    , maxRects_(std::max<size_t>(1, maxRects)) {
+}
+
+void DamageRegion::add(const Rect& rect) {
+    if (rect.isEmpty()) return;
+
+    Rect snapped = snapOut(rect);
+    for (const auto& existing : rects_) {
+        if (existing.contains(snapped)) return;
+    }
+    rects_.erase(std::remove_if(rects_.begin(), rects_.end(),
+                                [&](const Rect& existing) { return snapped.contains(existing); }),
+                 rects_.end());
+
+    rects_.push_back(snapped);
+    coalesce(rects_.size() - 1);
+
+    while (rects_.size() > maxRects_) {
+        // Merge the cheapest pair
+        size_t bestA = 0, bestB = 1;
+        double best = std::numeric_limits<double>::max();
+        for (size_t a = 0; a < rects_.size(); ++a) {
+            for (size_t b = a + 1; b < rects_.size(); ++b) {
+                double cost = waste(rects_[a], rects_[b]);
+                if (cost < best) {
+                    best = cost;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        rects_[bestA] = rects_[bestA].unionRect(rects_[bestB]);
+        rects_.erase(rects_.begin() + bestB);
+        coalesce(bestA);
+    }
+}
+
+void DamageRegion::add(const DamageRegion& other) {
+    for (const auto& rect : other.rects_) {
+        add(rect);
+    }
+}
+
+Rect DamageRegion::bounds() const {
+    Rect result;
+    for (const auto& rect : rects_) {
+        result = result.unionRect(rect);
+    }
+    return result;
+}
+
+double DamageRegion::area() const {
+    double result = 0;
+    for (const auto& rect : rects_) {
+        result += rectArea(rect);
+    }
+    return result;
+}
+
+bool DamageRegion::intersects(const Rect& rect) const {
+    for (const auto& existing : rects_) {
+        if (overlapArea(existing, rect) > 0) return true;
+    }
+    return false;
+}
+
+void DamageRegion::clipTo(const Rect& rect) {
+    std::vector<Rect> clipped;
+    clipped.reserve(rects_.size());
+    for (const auto& existing : rects_) {
+        if (overlapArea(existing, rect) > 0) {
+            clipped.push_back(existing.intersection(rect));
+        }
+    }
+    rects_.swap(clipped);
+}
+
+double DamageRegion::waste(const Rect& a, const Rect& b) {
+    return rectArea(a.unionRect(b)) - rectArea(a) - rectArea(b) + overlapArea(a, b);
+}
+
+void DamageRegion::coalesce(size_t index) {
+    // A grown rect may now be worth merging with others, so repeat
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t other = 0; other < rects_.size(); ++other) {
+            if (other == index) continue;
+
+            const Rect& a = rects_[index];
+            const Rect& b = rects_[other];
+            if (waste(a, b) > kMergeWaste * (rectArea(a) + rectArea(b))) continue;
+
+            rects_[index] = a.unionRect(b);
+            rects_.erase(rects_.begin() + other);
+            if (other < index) --index;
+            merged = true;
+            break;
+        }
+    }
+}
+
+} // namespace renderer
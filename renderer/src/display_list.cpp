@@ -0,0 +1,372 @@
+#include "renderer/display_list.h"
+#include "renderer/blur.h"
+#include <algorithm>
+#include <cmath>
+
+namespace renderer {
+
+// DisplayList implementation
+DisplayList::DisplayList()
+    : items_()
+    , args_()
+    , paints_()
+    , texts_()
+    , paths_()
+    , images_()
+    , blobs_()
+    , bounds_()
+    , hasUnboundedItems_(false)
+    , culled_(0) {
+}
+
+void DisplayList::playback(Canvas& canvas) const {
+    culled_ = 0;
+    Matrix base = canvas.getMatrix();
+
+    // The list's own saves and restores are balanced inside this one
+    canvas.save();
+    for (const auto& item : items_) {
+        if (item.op >= DisplayOp::DrawColor && !item.unbounded) {
+            Rect clip = canvas.getClipBounds();
+            if (!clip.isEmpty() && !base.transform(item.bounds).intersects(clip)) {
+                ++culled_;
+                continue;
+            }
+        }
+        replay(canvas, item, base);
+    }
+    canvas.restore();
+}
+
+size_t DisplayList::memoryUsage() const {
+    size_t bytes = items_.capacity() * sizeof(DisplayItem) + args_.capacity() * sizeof(double) +
+                   paints_.capacity() * sizeof(PaintHandle) + paints_.size() * sizeof(InternedPaint) +
+                   texts_.capacity() * sizeof(std::string) +
+                   paths_.capacity() * sizeof(Path) + images_.capacity() * sizeof(Image) +
+                   blobs_.capacity() * sizeof(TextBlob);
+    for (const auto& text : texts_) {
+        bytes += text.capacity();
+    }
+    return bytes;
+}
+
+Matrix DisplayList::matrix(uint32_t arg) const {
+    const double* m = &args_[arg];
+    return Matrix(m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8]);
+}
+
+void DisplayList::replay(Canvas& canvas, const DisplayItem& item, const Matrix& base) const {
+    switch (item.op) {
+        case DisplayOp::Save:
+            canvas.save();
+            break;
+        case DisplayOp::SaveLayer:
+            if (item.mode) {
+                canvas.saveLayer(rect(item.args), paint(item.paint));
+            } else {
+                canvas.saveLayer(paint(item.paint));
+            }
+            break;
+        case DisplayOp::Restore:
+            canvas.restore();
+            break;
+        case DisplayOp::SetMatrix:
+            canvas.setMatrix(base * matrix(item.args));
+            break;
+        case DisplayOp::ClipRect:
+            if (item.mode & kClipOut) {
+                canvas.clipOutRect(rect(item.args), (item.mode & kClipAntiAlias) != 0);
+            } else {
+                canvas.clipRect(rect(item.args), (item.mode & kClipAntiAlias) != 0);
+            }
+            break;
+        case DisplayOp::ClipPath:
+            if (item.mode & kClipOut) {
+                canvas.clipOutPath(paths_[item.data], (item.mode & kClipAntiAlias) != 0);
+            } else {
+                canvas.clipPath(paths_[item.data], (item.mode & kClipAntiAlias) != 0);
+            }
+            break;
+        case DisplayOp::DrawColor:
+            canvas.drawColor(Color(static_cast<uint32_t>(args_[item.args])), static_cast<BlendMode>(item.mode));
+            break;
+        case DisplayOp::DrawPaint:
+            canvas.drawPaint(paint(item.paint));
+            break;
+        case DisplayOp::DrawRect:
+            canvas.drawRect(rect(item.args), paint(item.paint));
+            break;
+        case DisplayOp::DrawRoundRect:
+            canvas.drawRoundRect(rect(item.args), args_[item.args + 4], args_[item.args + 5], paint(item.paint));
+            break;
+        case DisplayOp::DrawOval:
+            canvas.drawOval(rect(item.args), paint(item.paint));
+            break;
+        case DisplayOp::DrawArc:
+            canvas.drawArc(rect(item.args), args_[item.args + 4], args_[item.args + 5], item.mode != 0,
+                           paint(item.paint));
+            break;
+        case DisplayOp::DrawPath:
+            canvas.drawPath(paths_[item.data], paint(item.paint));
+            break;
+        case DisplayOp::DrawLine:
+            canvas.drawLine(point(item.args), point(item.args + 2), paint(item.paint));
+            break;
+        case DisplayOp::DrawPoints: {
+            // The count comes first, then the coordinates
+            size_t count = static_cast<size_t>(args_[item.args]);
+            std::vector<Point> points;
+            points.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                points.push_back(point(item.args + 1 + static_cast<uint32_t>(i) * 2));
+            }
+            canvas.drawPoints(points, static_cast<PointMode>(item.mode), paint(item.paint));
+            break;
+        }
+        case DisplayOp::DrawImage:
+            canvas.drawImage(images_[item.data], rect(item.args), rect(item.args + 4), paint(item.paint));
+            break;
+        case DisplayOp::DrawText:
+            if (item.mode) {
+                canvas.drawText(texts_[item.data], point(item.args), paint(item.paint), rect(item.args + 2));
+            } else {
+                canvas.drawText(texts_[item.data], point(item.args), paint(item.paint));
+            }
+            break;
+        case DisplayOp::DrawTextBlob:
+            canvas.drawTextBlob(blobs_[item.data], point(item.args), paint(item.paint));
+            break;
+        case DisplayOp::Clear: {
+            Color color(static_cast<uint32_t>(args_[item.args]));
+            if (item.mode) {
+                canvas.clear(rect(item.args + 1), color);
+            } else {
+                canvas.clear(color);
+            }
+            break;
+        }
+    }
+}
+
+// DisplayListRecorder implementation
+DisplayListRecorder::DisplayListRecorder()
+    : list_(std::make_shared<DisplayList>())
+    , paintIndex_()
+    , lastPaint_(0)
+    , matrix_(Matrix::identity())
+    , clip_(Rect()) {
+}
+
+void DisplayListRecorder::save() {
+    addState(DisplayOp::Save, DisplayList::kNoPaint, 0);
+}
+
+void DisplayListRecorder::saveLayer(const Rect* bounds, const Paint& paint) {
+    uint32_t args = bounds ? addArgs({bounds->x(), bounds->y(), bounds->width(), bounds->height()}) : 0;
+    addState(DisplayOp::SaveLayer, addPaint(paint), args, 0, bounds ? 1 : 0);
+}
+
+void DisplayListRecorder::restore() {
+    addState(DisplayOp::Restore, DisplayList::kNoPaint, 0);
+}
+
+void DisplayListRecorder::setMatrix(const Matrix& matrix) {
+    // Runs of transforms between draws collapse into the last one
+    if (!list_->items_.empty() && list_->items_.back().op == DisplayOp::SetMatrix) {
+        double* m = &list_->args_[list_->items_.back().args];
+        m[0] = matrix.m11; m[1] = matrix.m12; m[2] = matrix.m13;
+        m[3] = matrix.m21; m[4] = matrix.m22; m[5] = matrix.m23;
+        m[6] = matrix.m31; m[7] = matrix.m32; m[8] = matrix.m33;
+        return;
+    }
+    addState(DisplayOp::SetMatrix, DisplayList::kNoPaint,
+             addArgs({matrix.m11, matrix.m12, matrix.m13, matrix.m21, matrix.m22, matrix.m23,
+                      matrix.m31, matrix.m32, matrix.m33}));
+}
+
+void DisplayListRecorder::clipRect(const Rect& rect, uint8_t flags) {
+    addState(DisplayOp::ClipRect, DisplayList::kNoPaint, addArgs({rect.x(), rect.y(), rect.width(), rect.height()}), 0,
+             flags);
+}
+
+void DisplayListRecorder::clipPath(const Path& path, uint8_t flags) {
+    uint32_t data = static_cast<uint32_t>(list_->paths_.size());
+    list_->paths_.push_back(path);
+    addState(DisplayOp::ClipPath, DisplayList::kNoPaint, 0, data, flags);
+}
+
+void DisplayListRecorder::drawColor(const Color& color, BlendMode blendMode) {
+    addDraw(DisplayOp::DrawColor, nullptr, DisplayList::kNoPaint, addArgs({static_cast<double>(color.toRGBA())}), 0,
+            static_cast<uint8_t>(blendMode));
+}
+
+void DisplayListRecorder::drawPaint(const Paint& paint) {
+    addDraw(DisplayOp::DrawPaint, nullptr, addPaint(paint), 0);
+}
+
+void DisplayListRecorder::drawRect(const Rect& rect, const Paint& paint) {
+    Rect bounds = paintBounds(rect, paint);
+    addDraw(DisplayOp::DrawRect, &bounds, addPaint(paint), addArgs({rect.x(), rect.y(), rect.width(), rect.height()}));
+}
+
+void DisplayListRecorder::drawRoundRect(const Rect& rect, double rx, double ry, const Paint& paint) {
+    Rect bounds = paintBounds(rect, paint);
+    addDraw(DisplayOp::DrawRoundRect, &bounds, addPaint(paint),
+            addArgs({rect.x(), rect.y(), rect.width(), rect.height(), rx, ry}));
+}
+
+void DisplayListRecorder::drawOval(const Rect& rect, const Paint& paint) {
+    Rect bounds = paintBounds(rect, paint);
+    addDraw(DisplayOp::DrawOval, &bounds, addPaint(paint), addArgs({rect.x(), rect.y(), rect.width(), rect.height()}));
+}
+
+void DisplayListRecorder::drawArc(const Rect& rect, double startAngle, double sweepAngle, bool useCenter,
+                                  const Paint& paint) {
+    Rect bounds = paintBounds(rect, paint);
+    addDraw(DisplayOp::DrawArc, &bounds, addPaint(paint),
+            addArgs({rect.x(), rect.y(), rect.width(), rect.height(), startAngle, sweepAngle}), 0, useCenter ? 1 : 0);
+}
+
+void DisplayListRecorder::drawPath(const Path& path, const Paint& paint) {
+    if (path.is_empty()) return;
+
+    uint32_t data = static_cast<uint32_t>(list_->paths_.size());
+    list_->paths_.push_back(path);
+    Rect bounds = paintBounds(path.get_bounds(), paint);
+    addDraw(DisplayOp::DrawPath, &bounds, addPaint(paint), 0, data);
+}
+
+void DisplayListRecorder::drawLine(const Point& start, const Point& end, const Paint& paint) {
+    Rect line(std::min(start.x, end.x), std::min(start.y, end.y), std::abs(end.x - start.x), std::abs(end.y - start.y));
+    Rect bounds = paintBounds(line, paint);
+    addDraw(DisplayOp::DrawLine, &bounds, addPaint(paint), addArgs({start.x, start.y, end.x, end.y}));
+}
+
+void DisplayListRecorder::drawPoints(const std::vector<Point>& points, PointMode mode, const Paint& paint) {
+    if (points.empty()) return;
+
+    uint32_t args = addArgs({static_cast<double>(points.size())});
+    double left = points[0].x, top = points[0].y, right = left, bottom = top;
+    for (const auto& point : points) {
+        list_->args_.push_back(point.x);
+        list_->args_.push_back(point.y);
+        left = std::min(left, point.x);
+        top = std::min(top, point.y);
+        right = std::max(right, point.x);
+        bottom = std::max(bottom, point.y);
+    }
+    Rect bounds = paintBounds(Rect(left, top, right - left, bottom - top), paint);
+    addDraw(DisplayOp::DrawPoints, &bounds, addPaint(paint), args, 0, static_cast<uint8_t>(mode));
+}
+
+void DisplayListRecorder::drawImage(const Image& image, const Rect& srcRect, const Rect& destRect, const Paint& paint) {
+    uint32_t data = static_cast<uint32_t>(list_->images_.size());
+    list_->images_.push_back(image);
+    Rect bounds = paintBounds(destRect, paint);
+    addDraw(DisplayOp::DrawImage, &bounds, addPaint(paint),
+            addArgs({srcRect.x(), srcRect.y(), srcRect.width(), srcRect.height(),
+                     destRect.x(), destRect.y(), destRect.width(), destRect.height()}), data);
+}
+
+void DisplayListRecorder::drawText(const std::string& text, const Point& point, const Paint& paint,
+                                   const Rect& extent, const Rect* bounds) {
+    uint32_t data = static_cast<uint32_t>(list_->texts_.size());
+    list_->texts_.push_back(text);
+    uint32_t args = bounds ? addArgs({point.x, point.y, bounds->x(), bounds->y(), bounds->width(), bounds->height()})
+                           : addArgs({point.x, point.y});
+    Rect cull = paintBounds(extent, paint);
+    addDraw(DisplayOp::DrawText, &cull, addPaint(paint), args, data, bounds ? 1 : 0);
+}
+
+void DisplayListRecorder::drawTextBlob(const TextBlob& blob, const Point& point, const Paint& paint,
+                                       const Rect& extent) {
+    uint32_t data = static_cast<uint32_t>(list_->blobs_.size());
+    list_->blobs_.push_back(blob);
+    Rect bounds = paintBounds(extent, paint);
+    addDraw(DisplayOp::DrawTextBlob, &bounds, addPaint(paint), addArgs({point.x, point.y}), data);
+}
+
+void DisplayListRecorder::clear(const Rect* rect, const Color& color) {
+    uint32_t args = addArgs({static_cast<double>(color.toRGBA())});
+    if (rect) {
+        addArgs({rect->x(), rect->y(), rect->width(), rect->height()});
+    }
+    addDraw(DisplayOp::Clear, rect, DisplayList::kNoPaint, args, 0, rect ? 1 : 0);
+}
+
+std::shared_ptr<const DisplayList> DisplayListRecorder::finish() {
+    std::shared_ptr<const DisplayList> list = std::move(list_);
+    list_ = std::make_shared<DisplayList>();
+    paintIndex_.clear();
+    lastPaint_ = 0;
+    matrix_ = Matrix::identity();
+    clip_ = Rect();
+    return list;
+}
+
+uint32_t DisplayListRecorder::addPaint(const Paint& paint) {
+    std::vector<PaintHandle>& paints = list_->paints_;
+    // Runs of draws with one paint skip the interner
+    if (!paints.empty() && paints[lastPaint_]->paint() == paint) return lastPaint_;
+
+    PaintHandle handle = PaintInterner::shared().intern(paint);
+    auto inserted = paintIndex_.emplace(handle->id(), static_cast<uint32_t>(paints.size()));
+    if (inserted.second) {
+        paints.push_back(std::move(handle));
+    }
+    lastPaint_ = inserted.first->second;
+    return lastPaint_;
+}
+
+uint32_t DisplayListRecorder::addArgs(std::initializer_list<double> values) {
+    uint32_t first = static_cast<uint32_t>(list_->args_.size());
+    list_->args_.insert(list_->args_.end(), values.begin(), values.end());
+    return first;
+}
+
+void DisplayListRecorder::addDraw(DisplayOp op, const Rect* bounds, uint32_t paint, uint32_t args, uint32_t data,
+                                  uint8_t mode) {
+    DisplayItem item{op, mode, bounds == nullptr, paint, args, data, Rect()};
+    if (bounds) {
+        item.bounds = matrix_.transform(*bounds);
+        if (!clip_.isEmpty()) {
+            // Whatever the clip removes at recording time is never drawn
+            if (!item.bounds.intersects(clip_)) return;
+            item.bounds = item.bounds.intersection(clip_);
+        }
+        list_->bounds_ = list_->bounds_.unionRect(item.bounds);
+    } else {
+        list_->hasUnboundedItems_ = true;
+    }
+    list_->items_.push_back(item);
+}
+
+void DisplayListRecorder::addState(DisplayOp op, uint32_t paint, uint32_t args, uint32_t data, uint8_t mode) {
+    list_->items_.push_back(DisplayItem{op, mode, false, paint, args, data, Rect()});
+}
+
+Rect DisplayListRecorder::paintBounds(const Rect& rect, const Paint& paint) {
+    Rect bounds = rect;
+    if (paint.style() != PaintStyle::Fill) {
+        // A miter join can reach miterLimit half-widths out
+        double outset = paint.strokeWidth() / 2;
+        if (paint.lineJoin() == LineJoin::Miter) {
+            outset *= std::max(1.0, paint.miterLimit());
+        }
+        bounds = Rect(bounds.x() - outset, bounds.y() - outset, bounds.width() + 2 * outset, bounds.height() + 2 * outset);
+    }
+    // Blurs reach three deviations; shadowBlur is two
+    if (paint.hasFilter() && paint.filterBlur() > 0) {
+        double blur = blurOutset(paint.filterBlur());
+        bounds = Rect(bounds.x() - blur, bounds.y() - blur, bounds.width() + 2 * blur, bounds.height() + 2 * blur);
+    }
+    if (paint.hasShadow()) {
+        double blur = blurOutset(paint.shadowBlur() / 2);
+        Rect shadow(bounds.x() + paint.shadowOffset().x - blur, bounds.y() + paint.shadowOffset().y - blur,
+                    bounds.width() + 2 * blur, bounds.height() + 2 * blur);
+        bounds = bounds.unionRect(shadow);
+    }
+    return bounds;
+}
+
+} // namespace renderer
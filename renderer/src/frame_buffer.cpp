@@ -0,0 +1,182 @@
+#include "renderer/frame_buffer.h"
+#include <cstdio>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define RENDERER_SHARED_MEMORY 1
+#else
+#define RENDERER_SHARED_MEMORY 0
+#endif
+
+#if defined(__linux__)
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define RENDERER_DMA_BUF 1
+#else
+#define RENDERER_DMA_BUF 0
+#endif
+
+namespace renderer {
+
+namespace {
+
+bool validSize(int width, int height, int stride) {
+    if (width <= 0 || height <= 0 || stride < width * 4) return false;
+    return static_cast<size_t>(stride) <= std::numeric_limits<size_t>::max() / static_cast<size_t>(height);
+}
+
+#if RENDERER_SHARED_MEMORY
+// An anonymous segment: a memfd where there is one, else a POSIX segment
+// unlinked as soon as it is open
+int createSegment(size_t size) {
+    int fd = -1;
+#if defined(__linux__) && defined(SYS_memfd_create)
+    fd = static_cast<int>(syscall(SYS_memfd_create, "renderer-frame", 1u /* MFD_CLOEXEC */));
+#endif
+    if (fd < 0) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "/renderer-frame-%ld-%p", static_cast<long>(getpid()),
+                      static_cast<void*>(&fd));
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) return -1;
+        shm_unlink(name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+#endif
+
+} // namespace
+
+// FrameBuffer implementation
+FrameBuffer::FrameBuffer(FrameBufferMemory memory, int width, int height, int stride)
+    : memory_(memory)
+    , width_(width)
+    , height_(height)
+    , stride_(stride)
+    , pixels_(nullptr)
+    , owned_()
+    , fd_(-1)
+    , offset_(0)
+    , mapping_(nullptr)
+    , mappingSize_(0) {
+}
+
+FrameBuffer::~FrameBuffer() {
+#if RENDERER_SHARED_MEMORY
+    if (mapping_) munmap(mapping_, mappingSize_);
+    if (fd_ >= 0) close(fd_);
+#endif
+}
+
+std::shared_ptr<FrameBuffer> FrameBuffer::allocate(int width, int height) {
+    if (!validSize(width, height, width * 4)) return nullptr;
+    std::shared_ptr<FrameBuffer> buffer(new FrameBuffer(FrameBufferMemory::Owned, width, height, width * 4));
+    buffer->owned_.reset(new uint8_t[static_cast<size_t>(width) * height * 4]());
+    buffer->pixels_ = buffer->owned_.get();
+    return buffer;
+}
+
+std::shared_ptr<FrameBuffer> FrameBuffer::wrap(uint8_t* pixels, int width, int height, int stride) {
+    if (!pixels || !validSize(width, height, stride)) return nullptr;
+    std::shared_ptr<FrameBuffer> buffer(new FrameBuffer(FrameBufferMemory::External, width, height, stride));
+    buffer->pixels_ = pixels;
+    return buffer;
+}
+
+std::shared_ptr<FrameBuffer> FrameBuffer::createShared(int width, int height) {
+#if RENDERER_SHARED_MEMORY
+    if (!validSize(width, height, width * 4)) return nullptr;
+    int fd = createSegment(static_cast<size_t>(width) * height * 4);
+    if (fd < 0) return nullptr;
+    return map(FrameBufferMemory::SharedMemory, fd, width, height, width * 4, 0);
+#else
+    (void)width;
+    (void)height;
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<FrameBuffer> FrameBuffer::importShared(int fd, int width, int height, int stride, size_t offset) {
+    return map(FrameBufferMemory::SharedMemory, fd, width, height, stride, offset);
+}
+
+std::shared_ptr<FrameBuffer> FrameBuffer::importDmaBuf(int fd, int width, int height, int stride, size_t offset) {
+#if RENDERER_DMA_BUF
+    return map(FrameBufferMemory::DmaBuf, fd, width, height, stride, offset);
+#else
+    (void)fd;
+    (void)width;
+    (void)height;
+    (void)stride;
+    (void)offset;
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<FrameBuffer> FrameBuffer::map(FrameBufferMemory memory, int fd, int width, int height, int stride,
+                                              size_t offset) {
+#if RENDERER_SHARED_MEMORY
+    if (fd < 0) return nullptr;
+    if (!validSize(width, height, stride)) {
+        close(fd);
+        return nullptr;
+    }
+    // mmap offsets are page aligned; map from the page offset falls in
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset - offset % page;
+    size_t size = offset - start + static_cast<size_t>(stride) * height;
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(start));
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::shared_ptr<FrameBuffer> buffer(new FrameBuffer(memory, width, height, stride));
+    buffer->fd_ = fd;
+    buffer->offset_ = offset;
+    buffer->mapping_ = mapping;
+    buffer->mappingSize_ = size;
+    buffer->pixels_ = static_cast<uint8_t*>(mapping) + (offset - start);
+    return buffer;
+#else
+    (void)memory;
+    (void)fd;
+    (void)width;
+    (void)height;
+    (void)stride;
+    (void)offset;
+    return nullptr;
+#endif
+}
+
+void FrameBuffer::beginAccess(bool write) {
+#if RENDERER_DMA_BUF
+    if (memory_ != FrameBufferMemory::DmaBuf) return;
+    dma_buf_sync sync{};
+    sync.flags = DMA_BUF_SYNC_START | (write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ);
+    ioctl(fd_, DMA_BUF_IOCTL_SYNC, &sync);
+#else
+    (void)write;
+#endif
+}
+
+void FrameBuffer::endAccess(bool write) {
+#if RENDERER_DMA_BUF
+    if (memory_ != FrameBufferMemory::DmaBuf) return;
+    dma_buf_sync sync{};
+    sync.flags = DMA_BUF_SYNC_END | (write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ);
+    ioctl(fd_, DMA_BUF_IOCTL_SYNC, &sync);
+#else
+    (void)write;
+#endif
+}
+
+} // namespace renderer
@@ -0,0 +1,313 @@
+#include "renderer/glyph_cache.h"
+#include "renderer/paint.h"
+#include <algorithm>
+#include <cmath>
+
+namespace renderer {
+
+namespace {
+
+constexpr uint32_t kReplacementCharacter = 0xFFFD;
+
+// Glyphs sit one pixel apart so bilinear reads never bleed
+constexpr int kPadding = 1;
+
+// Next code point of UTF-8 text; malformed bytes decode as U+FFFD
+uint32_t decodeUtf8(const std::string& text, size_t& index) {
+    unsigned char lead = static_cast<unsigned char>(text[index++]);
+    if (lead < 0x80) return lead;
+
+    int length = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+    if (length < 0) return kReplacementCharacter;
+
+    uint32_t codePoint = lead & (0x3F >> length);
+    for (int i = 0; i < length; ++i) {
+        if (index >= text.size() || (static_cast<unsigned char>(text[index]) & 0xC0) != 0x80) {
+            return kReplacementCharacter;
+        }
+        codePoint = (codePoint << 6) | (static_cast<unsigned char>(text[index++]) & 0x3F);
+    }
+    return codePoint;
+}
+
+bool isBlank(uint32_t codePoint) {
+    return codePoint <= 0x20 || codePoint == 0x7F || codePoint == 0xA0 || (codePoint >= 0x2000 && codePoint <= 0x200B);
+}
+
+double ascentOf(const FontMetrics& font) {
+    return font.ascent > 0 ? font.ascent : font.size * 0.8;
+}
+
+double descentOf(const FontMetrics& font) {
+    return font.descent > 0 ? font.descent : font.size * 0.2;
+}
+
+} // namespace
+
+size_t GlyphKeyHash::operator()(const GlyphKey& key) const {
+    uint64_t hash = key.face * 0x9E3779B97F4A7C15ull;
+    hash ^= (static_cast<uint64_t>(key.size) << 32 | static_cast<uint64_t>(key.glyph) << 2 | key.subpixel) +
+            0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    return static_cast<size_t>(hash);
+}
+
+// GlyphCache implementation
+GlyphCache::GlyphCache(int atlasWidth, int atlasHeight)
+    : atlasWidth_(std::max(1, atlasWidth))
+    , atlasHeight_(std::max(1, atlasHeight))
+    , atlas_(static_cast<size_t>(atlasWidth_) * atlasHeight_, 0)
+    , shelves_()
+    , nextShelfY_(0)
+    , entries_()
+    , rasterizer_(rasterizeMissingGlyph)
+    , frame_(1)
+    , atlasVersion_(0)
+    , stats_()
+    , mutex_() {
+}
+
+GlyphCache& GlyphCache::shared() {
+    static GlyphCache cache;
+    return cache;
+}
+
+void GlyphCache::setRasterizer(Rasterizer rasterizer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rasterizer_ = rasterizer ? std::move(rasterizer) : Rasterizer(rasterizeMissingGlyph);
+    // Cached glyphs came from the old rasterizer
+    entries_.clear();
+    shelves_.clear();
+    nextShelfY_ = 0;
+}
+
+FontMetrics GlyphCache::fontFor(const Paint& paint) {
+    FontMetrics font = paint.font();
+    if (!paint.textFamily().empty()) {
+        font.family = paint.textFamily();
+    }
+    font.size = paint.textSize();
+    font.weight = static_cast<double>(paint.textWeight());
+    font.bold = font.weight >= 700;
+    font.italic = paint.textStyle() != FontStyle::Normal;
+    return font;
+}
+
+uint64_t GlyphCache::faceId(const FontMetrics& font) {
+    // FNV-1a over what selects a face
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto mix = [&](uint64_t value) {
+        hash ^= value;
+        hash *= 0x100000001B3ull;
+    };
+    for (char c : font.family) {
+        mix(static_cast<unsigned char>(c));
+    }
+    mix(static_cast<uint64_t>(font.weight));
+    mix(font.italic ? 1 : 0);
+    return hash;
+}
+
+void GlyphCache::beginFrame() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++frame_;
+}
+
+double GlyphCache::layout(const std::string& text, const FontMetrics& font, const Point& origin,
+                          std::vector<GlyphQuad>& quads) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    GlyphKey key{faceId(font), static_cast<uint32_t>(std::lround(font.size * 64)), 0, 0};
+    double pen = origin.x;
+    int baseline = static_cast<int>(std::lround(origin.y));
+    size_t index = 0;
+    while (index < text.size()) {
+        key.glyph = decodeUtf8(text, index);
+        // The fraction of the pen position selects a pre-shifted bitmap
+        double whole = std::floor(pen);
+        int quarter = static_cast<int>(std::floor((pen - whole) * 4));
+        key.subpixel = static_cast<uint8_t>(std::min(quarter, 3));
+
+        Entry entry;
+        if (lookup(key, font, entry)) {
+            quads.push_back(GlyphQuad{entry.atlasX, entry.atlasY, entry.width, entry.height,
+                                      static_cast<int>(whole) + entry.left, baseline + entry.top});
+        }
+        pen += entry.advance;
+    }
+    return pen - origin.x;
+}
+
+Size GlyphCache::measure(const std::string& text, const FontMetrics& font) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    GlyphKey key{faceId(font), static_cast<uint32_t>(std::lround(font.size * 64)), 0, 0};
+    double width = 0;
+    size_t index = 0;
+    while (index < text.size()) {
+        key.glyph = decodeUtf8(text, index);
+        Entry entry;
+        lookup(key, font, entry);
+        width += entry.advance;
+    }
+    return Size(width, ascentOf(font) + descentOf(font));
+}
+
+Rect GlyphCache::bounds(const std::string& text, const FontMetrics& font, const Point& origin) {
+    Size size = measure(text, font);
+    return Rect(origin.x, origin.y - ascentOf(font), size.width, size.height);
+}
+
+GlyphCache::Stats GlyphCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.glyphs = entries_.size();
+    stats.atlasBytes = atlas_.size();
+    stats.usedBytes = 0;
+    for (const auto& entry : entries_) {
+        stats.usedBytes += static_cast<size_t>(entry.second.width) * entry.second.height;
+    }
+    return stats;
+}
+
+uint64_t GlyphCache::atlasVersion() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return atlasVersion_;
+}
+
+void GlyphCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    shelves_.clear();
+    nextShelfY_ = 0;
+    stats_ = Stats();
+}
+
+bool GlyphCache::lookup(const GlyphKey& key, const FontMetrics& font, Entry& entry) {
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        ++stats_.hits;
+        entry = it->second;
+        if (entry.shelf < 0) return false;
+        shelves_[entry.shelf].lastUse = frame_;
+        return true;
+    }
+
+    ++stats_.misses;
+    GlyphBitmap bitmap;
+    rasterizer_(key, font, bitmap);
+    entry = Entry{0, 0, bitmap.width, bitmap.height, bitmap.left, bitmap.top, bitmap.advance, -1};
+    if (bitmap.width <= 0 || bitmap.height <= 0) {
+        entry.width = entry.height = 0;
+        entries_.emplace(key, entry);
+        return false;
+    }
+
+    int x, y, shelf;
+    if (!allocate(bitmap.width, bitmap.height, x, y, shelf)) {
+        // Keep the advance; the glyph is tried again next frame
+        ++stats_.dropped;
+        return false;
+    }
+    for (int row = 0; row < bitmap.height; ++row) {
+        std::copy_n(&bitmap.coverage[static_cast<size_t>(row) * bitmap.width], bitmap.width,
+                    &atlas_[static_cast<size_t>(y + row) * atlasWidth_ + x]);
+    }
+    ++atlasVersion_;
+    entry.atlasX = x;
+    entry.atlasY = y;
+    entry.shelf = shelf;
+    shelves_[shelf].lastUse = frame_;
+    entries_.emplace(key, entry);
+    return true;
+}
+
+bool GlyphCache::allocate(int width, int height, int& x, int& y, int& shelf) {
+    int paddedWidth = width + kPadding;
+    int paddedHeight = height + kPadding;
+    if (paddedWidth > atlasWidth_ || paddedHeight > atlasHeight_) return false;
+
+    // The best-fitting shelf with room, so short glyphs do not fill tall shelves
+    int best = -1;
+    for (size_t i = 0; i < shelves_.size(); ++i) {
+        const Shelf& candidate = shelves_[i];
+        if (candidate.height < paddedHeight || candidate.used + paddedWidth > atlasWidth_) continue;
+        if (candidate.height > paddedHeight * 2) continue;
+        if (best < 0 || candidate.height < shelves_[best].height) best = static_cast<int>(i);
+    }
+
+    if (best < 0 && nextShelfY_ + paddedHeight <= atlasHeight_) {
+        shelves_.push_back(Shelf{nextShelfY_, paddedHeight, 0, frame_});
+        nextShelfY_ += paddedHeight;
+        best = static_cast<int>(shelves_.size() - 1);
+    }
+
+    if (best < 0) {
+        // Evict the least recently used shelf that is tall enough
+        for (size_t i = 0; i < shelves_.size(); ++i) {
+            const Shelf& candidate = shelves_[i];
+            if (candidate.height < paddedHeight || candidate.lastUse >= frame_) continue;
+            if (best < 0 || candidate.lastUse < shelves_[best].lastUse) best = static_cast<int>(i);
+        }
+        if (best < 0) return false;
+        evictShelf(static_cast<size_t>(best));
+    }
+
+    Shelf& chosen = shelves_[best];
+    x = chosen.used;
+    y = chosen.y;
+    shelf = best;
+    chosen.used += paddedWidth;
+    return true;
+}
+
+void GlyphCache::evictShelf(size_t index) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->second.shelf == static_cast<int>(index)) {
+            it = entries_.erase(it);
+            ++stats_.evictions;
+        } else {
+            ++it;
+        }
+    }
+    Shelf& shelf = shelves_[index];
+    for (int row = 0; row < shelf.height; ++row) {
+        std::fill_n(&atlas_[static_cast<size_t>(shelf.y + row) * atlasWidth_], atlasWidth_, 0);
+    }
+    shelf.used = 0;
+}
+
+// The missing-glyph box: an outlined rect from the baseline to cap height,
+// shifted by the subpixel offset with antialiased vertical edges
+void GlyphCache::rasterizeMissingGlyph(const GlyphKey& key, const FontMetrics& font, GlyphBitmap& bitmap) {
+    double size = font.size;
+    if (isBlank(key.glyph)) {
+        bitmap.advance = key.glyph == 0x20 || key.glyph == 0xA0 ? size * 0.3 : 0;
+        return;
+    }
+
+    bitmap.advance = size * 0.6;
+    double stroke = std::max(1.0, std::round(size / 16));
+    double left = size * 0.05 + key.subpixel / 4.0;
+    double right = left + size * 0.5;
+    int height = std::max(1, static_cast<int>(std::lround(font.capHeight > 0 ? font.capHeight : size * 0.7)));
+
+    bitmap.width = static_cast<int>(std::ceil(right));
+    bitmap.height = height;
+    bitmap.left = 0;
+    bitmap.top = -height;
+    bitmap.coverage.assign(static_cast<size_t>(bitmap.width) * height, 0);
+
+    // Horizontal coverage of [a, b] over pixel column x
+    auto span = [](double a, double b, int x) {
+        return std::clamp(std::min(b, x + 1.0) - std::max(a, static_cast<double>(x)), 0.0, 1.0);
+    };
+    for (int y = 0; y < height; ++y) {
+        bool edgeRow = y < stroke || y >= height - stroke;
+        for (int x = 0; x < bitmap.width; ++x) {
+            double covered = edgeRow ? span(left, right, x)
+                                     : span(left, left + stroke, x) + span(right - stroke, right, x);
+            bitmap.coverage[static_cast<size_t>(y) * bitmap.width + x] =
+                static_cast<uint8_t>(std::lround(std::min(covered, 1.0) * 255));
+        }
+    }
+}
+
+} // namespace renderer
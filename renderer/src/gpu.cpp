@@ -0,0 +1,464 @@
+#include "renderer/gpu.h"
+#include "renderer/display_list.h"
+#include "renderer/image.h"
+#include "renderer/paint.h"
+#include "pixel_math.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace renderer {
+
+namespace {
+
+constexpr uint64_t kNeverUploaded = std::numeric_limits<uint64_t>::max();
+
+GpuStyle styleOf(PaintStyle style) {
+    switch (style) {
+        case PaintStyle::Fill:
+            return GpuStyle::Fill;
+        case PaintStyle::Stroke:
+            return GpuStyle::Stroke;
+        case PaintStyle::FillAndStroke:
+            return GpuStyle::FillAndStroke;
+    }
+    return GpuStyle::Fill;
+}
+
+GpuInstance makeInstance(const Matrix& matrix, const Rect& rect, const Rect& clip, const uint8_t color[4]) {
+    GpuInstance instance{};
+    instance.transform[0] = static_cast<float>(matrix.m11);
+    instance.transform[1] = static_cast<float>(matrix.m21);
+    instance.transform[2] = static_cast<float>(matrix.m12);
+    instance.transform[3] = static_cast<float>(matrix.m22);
+    instance.transform[4] = static_cast<float>(matrix.m13);
+    instance.transform[5] = static_cast<float>(matrix.m23);
+    instance.rect[0] = static_cast<float>(rect.x());
+    instance.rect[1] = static_cast<float>(rect.y());
+    instance.rect[2] = static_cast<float>(rect.width());
+    instance.rect[3] = static_cast<float>(rect.height());
+    instance.clip[0] = static_cast<float>(clip.x());
+    instance.clip[1] = static_cast<float>(clip.y());
+    instance.clip[2] = static_cast<float>(clip.width());
+    instance.clip[3] = static_cast<float>(clip.height());
+    std::copy_n(color, 4, instance.color);
+    return instance;
+}
+
+// Device pixels an instance may touch: its local rect grown by outset,
+// mapped, and a pixel more for antialiasing
+Rect deviceBounds(const Matrix& matrix, const Rect& rect, double outset, const Rect& clip) {
+    Rect local(rect.x() - outset, rect.y() - outset, rect.width() + outset * 2, rect.height() + outset * 2);
+    Rect device = matrix.transform(local);
+    return Rect(device.x() - 1, device.y() - 1, device.width() + 2, device.height() + 2).intersection(clip);
+}
+
+} // namespace
+
+// GpuDevice implementation
+GpuDevice::~GpuDevice() {}
+
+// GpuBackend implementation
+GpuBackend::GpuBackend(std::shared_ptr<GpuDevice> device, BackendType type)
+    : type_(type)
+    , device_(std::move(device))
+    , width_(0)
+    , height_(0)
+    , queued_()
+    , frame_()
+    , batches_()
+    , stats_()
+    , glyphCache_()
+    , glyphQuads_()
+    , atlasTexture_(0)
+    , atlasVersion_(kNeverUploaded)
+    , textures_() {
+}
+
+GpuBackend::~GpuBackend() {
+    releaseTextures(true);
+    if (atlasTexture_) {
+        device_->releaseTexture(atlasTexture_);
+    }
+}
+
+void GpuBackend::resize(int width, int height) {
+    width_ = std::max(0, width);
+    height_ = std::max(0, height);
+}
+
+void GpuBackend::draw(std::shared_ptr<const DisplayList> list) {
+    if (list && !list->empty()) {
+        queued_.push_back(std::move(list));
+    }
+}
+
+void GpuBackend::flush() {
+    stats_ = Stats();
+    frame_.width = width_;
+    frame_.height = height_;
+    frame_.instances.clear();
+    frame_.batches.clear();
+    batches_.clear();
+
+    // Glyph quads stay valid until the atlas is uploaded below
+    glyphCache_.beginFrame();
+    for (const std::shared_ptr<const DisplayList>& list : queued_) {
+        resolve(*list);
+    }
+    queued_.clear();
+
+    if (atlasTexture_) {
+        uint64_t version = glyphCache_.atlasVersion();
+        if (version != atlasVersion_) {
+            device_->uploadTexture(atlasTexture_, glyphCache_.atlas(), glyphCache_.atlasWidth(),
+                                   glyphCache_.atlasHeight(), 1);
+            atlasVersion_ = version;
+            ++stats_.textureUploads;
+        }
+    }
+
+    // One buffer for the frame; each batch is a range of it
+    const GpuPipelineKey* previous = nullptr;
+    for (PendingBatch& batch : batches_) {
+        uint32_t first = static_cast<uint32_t>(frame_.instances.size());
+        frame_.instances.insert(frame_.instances.end(), batch.instances.begin(), batch.instances.end());
+        frame_.batches.push_back(
+            GpuBatch{batch.key, first, static_cast<uint32_t>(batch.instances.size()), batch.bounds});
+        if (!previous || previous->pipeline != batch.key.pipeline || previous->blendMode != batch.key.blendMode ||
+            previous->replace != batch.key.replace) {
+            ++stats_.pipelineChanges;
+        }
+        previous = &batch.key;
+    }
+    stats_.instances = frame_.instances.size();
+    stats_.batches = frame_.batches.size();
+
+    if (!frame_.batches.empty()) {
+        device_->submit(frame_);
+    }
+    releaseTextures(false);
+}
+
+void GpuBackend::finish() {
+    flush();
+    device_->wait();
+}
+
+void GpuBackend::resolve(const DisplayList& list) {
+    Rect surface(0, 0, width_, height_);
+    DrawState state{Matrix::identity(), surface, 1.0};
+    std::vector<DrawState> stack;
+
+    for (const DisplayItem& item : list.items()) {
+        const double* args = list.args().data() + item.args;
+        switch (item.op) {
+            case DisplayOp::Save:
+                stack.push_back(state);
+                break;
+            case DisplayOp::SaveLayer:
+                // Layers are flattened: their opacity scales the draws inside
+                stack.push_back(state);
+                state.alpha *= list.paint(item.paint).opacity() * list.paint(item.paint).color().a / 255.0;
+                break;
+            case DisplayOp::Restore:
+                if (!stack.empty()) {
+                    state = stack.back();
+                    stack.pop_back();
+                }
+                break;
+            case DisplayOp::SetMatrix:
+                state.matrix = Matrix(args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8]);
+                break;
+            case DisplayOp::ClipRect:
+                if (item.mode & DisplayList::kClipOut) break;
+                state.clip = state.clip.intersection(state.matrix.transform(Rect(args[0], args[1], args[2], args[3])));
+                break;
+            case DisplayOp::ClipPath:
+                // Clipped to the path's bounds; clip-outs keep the clip
+                if (item.mode & DisplayList::kClipOut) break;
+                state.clip = state.clip.intersection(state.matrix.transform(list.path(item.data).get_bounds()));
+                break;
+            default:
+                addDraw(list, item, state);
+                break;
+        }
+    }
+}
+
+void GpuBackend::addDraw(const DisplayList& list, const DisplayItem& item, const DrawState& state) {
+    Rect bounds = item.unbounded ? state.clip : item.bounds.intersection(state.clip);
+    if (bounds.isEmpty() || state.alpha <= 0) return;
+
+    const double* args = list.args().data() + item.args;
+    const Matrix identity = Matrix::identity();
+    uint8_t color[4];
+    ++stats_.draws;
+
+    // Fills of device space: one rect over the draw's bounds
+    switch (item.op) {
+        case DisplayOp::DrawColor:
+            premultiply(Color(static_cast<uint32_t>(args[0])), state.alpha, color);
+            addInstance(GpuPipelineKey{GpuPipeline::Rect, static_cast<BlendMode>(item.mode), false, 0},
+                        makeInstance(identity, bounds, state.clip, color), bounds);
+            return;
+        case DisplayOp::DrawPaint: {
+            const Paint& paint = list.paint(item.paint);
+            premultiply(paint.color(), state.alpha * paint.opacity(), color);
+            addInstance(GpuPipelineKey{GpuPipeline::Rect, paint.blendMode(), false, 0},
+                        makeInstance(identity, bounds, state.clip, color), bounds);
+            return;
+        }
+        case DisplayOp::Clear:
+            premultiply(Color(static_cast<uint32_t>(args[0])), 1.0, color);
+            addInstance(GpuPipelineKey{GpuPipeline::Rect, BlendMode::Normal, true, 0},
+                        makeInstance(identity, bounds, state.clip, color), bounds);
+            return;
+        default:
+            break;
+    }
+
+    const Paint& paint = list.paint(item.paint);
+    premultiply(paint.color(), state.alpha * paint.opacity(), color);
+    if (color[3] == 0) return;
+
+    if (item.op == DisplayOp::DrawText || item.op == DisplayOp::DrawTextBlob) {
+        addText(list, item, state, color);
+        return;
+    }
+    if (item.op == DisplayOp::DrawImage) {
+        addImage(list, item, state, color);
+        return;
+    }
+
+    const Matrix& m = state.matrix;
+    double scale = std::sqrt(std::abs(m.m11 * m.m22 - m.m12 * m.m21));
+    scale = scale > 0 ? scale : 1;
+    // Zero-width strokes are one device pixel wide
+    double halfStroke = paint.strokeWidth() > 0 ? paint.strokeWidth() / 2 : 0.5 / scale;
+    bool aliased = paint.antialias() == AntialiasMode::None;
+
+    auto addShape = [&](GpuPipeline pipeline, const Matrix& matrix, const Rect& rect, double rx, double ry,
+                        GpuStyle style) {
+        GpuInstance instance = makeInstance(matrix, rect, state.clip, color);
+        instance.radii[0] = static_cast<float>(rx);
+        instance.radii[1] = static_cast<float>(ry);
+        instance.halfStroke = static_cast<float>(halfStroke);
+        instance.style = style;
+        instance.aliased = aliased ? 1 : 0;
+        double outset = style == GpuStyle::Fill ? 0 : halfStroke;
+        Rect device = deviceBounds(matrix, rect, outset, state.clip);
+        if (device.isEmpty()) return;
+        addInstance(GpuPipelineKey{pipeline, paint.blendMode(), false, 0}, instance, device);
+    };
+
+    // Lines are filled rects along them; caps extend or round the ends
+    auto addLine = [&](const Point& start, const Point& end, LineCap cap) {
+        double dx = end.x - start.x;
+        double dy = end.y - start.y;
+        double length = std::hypot(dx, dy);
+        if (length == 0) {
+            if (cap == LineCap::Butt) return;
+            Rect dot(start.x - halfStroke, start.y - halfStroke, halfStroke * 2, halfStroke * 2);
+            addShape(cap == LineCap::Round ? GpuPipeline::Oval : GpuPipeline::Rect, m, dot, 0, 0, GpuStyle::Fill);
+            return;
+        }
+        double ux = dx / length;
+        double uy = dy / length;
+        Matrix along = m * Matrix::translation(start.x, start.y) * Matrix(ux, -uy, 0, uy, ux, 0, 0, 0, 1);
+        double extend = cap == LineCap::Butt ? 0 : halfStroke;
+        double radius = cap == LineCap::Round ? halfStroke : 0;
+        addShape(GpuPipeline::Rect, along, Rect(-extend, -halfStroke, length + extend * 2, halfStroke * 2), radius,
+                 radius, GpuStyle::Fill);
+    };
+
+    GpuStyle style = styleOf(paint.style());
+    Rect rect;
+    double radiusX = 0, radiusY = 0;
+    switch (item.op) {
+        case DisplayOp::DrawRect:
+            addShape(GpuPipeline::Rect, m, Rect(args[0], args[1], args[2], args[3]), 0, 0, style);
+            return;
+        case DisplayOp::DrawRoundRect:
+            addShape(GpuPipeline::Rect, m, Rect(args[0], args[1], args[2], args[3]), args[4], args[5], style);
+            return;
+        case DisplayOp::DrawOval:
+            addShape(GpuPipeline::Oval, m, Rect(args[0], args[1], args[2], args[3]), 0, 0, style);
+            return;
+        case DisplayOp::DrawPath: {
+            // A path of one shape is drawn like a draw of it
+            const Path& path = list.path(item.data);
+            if (path.is_rect(&rect)) {
+                addShape(GpuPipeline::Rect, m, rect, 0, 0, style);
+            } else if (path.is_round_rect(&rect, &radiusX, &radiusY)) {
+                addShape(GpuPipeline::Rect, m, rect, radiusX, radiusY, style);
+            } else if (path.is_oval(&rect)) {
+                addShape(GpuPipeline::Oval, m, rect, 0, 0, style);
+            } else {
+                ++stats_.unsupported;
+            }
+            return;
+        }
+        case DisplayOp::DrawLine:
+            addLine(Point(args[0], args[1]), Point(args[2], args[3]), paint.lineCap());
+            return;
+        case DisplayOp::DrawPoints: {
+            // The count, then the coordinates
+            size_t count = static_cast<size_t>(args[0]);
+            const double* xy = args + 1;
+            PointMode mode = static_cast<PointMode>(item.mode);
+            if (mode == PointMode::Points) {
+                LineCap cap = paint.lineCap() == LineCap::Round ? LineCap::Round : LineCap::Square;
+                for (size_t i = 0; i < count; ++i) {
+                    Point point(xy[i * 2], xy[i * 2 + 1]);
+                    addLine(point, point, cap);
+                }
+                return;
+            }
+            size_t step = mode == PointMode::Lines ? 2 : 1;
+            for (size_t i = 0; i + 1 < count; i += step) {
+                addLine(Point(xy[i * 2], xy[i * 2 + 1]), Point(xy[i * 2 + 2], xy[i * 2 + 3]), paint.lineCap());
+            }
+            return;
+        }
+        default:
+            ++stats_.unsupported;
+            return;
+    }
+}
+
+// Glyphs are laid out at the transformed size and origin, unrotated, and
+// each becomes a quad of the atlas texture
+void GpuBackend::addText(const DisplayList& list, const DisplayItem& item, const DrawState& state,
+                         const uint8_t color[4]) {
+    const Matrix& m = state.matrix;
+    double scale = std::sqrt(std::abs(m.m11 * m.m22 - m.m12 * m.m21));
+    scale = scale > 0 ? scale : 1;
+    const double* args = list.args().data() + item.args;
+    Point origin(args[0], args[1]);
+
+    glyphQuads_.clear();
+    if (item.op == DisplayOp::DrawText) {
+        FontMetrics font = GlyphCache::fontFor(list.paint(item.paint));
+        font.size *= scale;
+        glyphCache_.layout(list.text(item.data), font, m.transform(origin), glyphQuads_);
+    } else {
+        for (const TextRun& run : list.blob(item.data).runs()) {
+            FontMetrics font = run.font;
+            font.size *= scale;
+            glyphCache_.layout(run.text, font, m.transform(origin + run.position), glyphQuads_);
+        }
+    }
+    if (glyphQuads_.empty()) return;
+
+    if (!atlasTexture_) {
+        atlasTexture_ = device_->uploadTexture(0, glyphCache_.atlas(), glyphCache_.atlasWidth(),
+                                               glyphCache_.atlasHeight(), 1);
+        atlasVersion_ = glyphCache_.atlasVersion();
+        ++stats_.textureUploads;
+    }
+
+    GpuPipelineKey key{GpuPipeline::Glyph, list.paint(item.paint).blendMode(), false, atlasTexture_};
+    const Matrix identity = Matrix::identity();
+    for (const GlyphQuad& quad : glyphQuads_) {
+        Rect rect(quad.x, quad.y, quad.width, quad.height);
+        Rect device = rect.intersection(state.clip);
+        if (device.isEmpty()) continue;
+
+        GpuInstance instance = makeInstance(identity, rect, state.clip, color);
+        instance.uv[0] = static_cast<float>(quad.atlasX);
+        instance.uv[1] = static_cast<float>(quad.atlasY);
+        instance.uv[2] = static_cast<float>(quad.width);
+        instance.uv[3] = static_cast<float>(quad.height);
+        addInstance(key, instance, device);
+    }
+}
+
+// The paint's alpha tints the texture; rows still decoding are cut off
+void GpuBackend::addImage(const DisplayList& list, const DisplayItem& item, const DrawState& state,
+                          const uint8_t color[4]) {
+    const Image& image = list.image(item.data);
+    const std::shared_ptr<const ImageBitmap>& bitmap = image.get_bitmap();
+    if (!bitmap) return;
+
+    int rows = 0;
+    uint32_t texture = textureFor(bitmap, rows);
+    if (!texture) return;
+
+    const double* args = list.args().data() + item.args;
+    Rect src(args[0], args[1], args[2], args[3]);
+    Rect dest(args[4], args[5], args[6], args[7]);
+    if (src.isEmpty() || dest.isEmpty()) return;
+
+    // Source rects are in intrinsic pixels; bitmaps may be decoded smaller
+    double sx = image.get_width() > 0 ? static_cast<double>(bitmap->width()) / image.get_width() : 1;
+    double sy = image.get_height() > 0 ? static_cast<double>(bitmap->height()) / image.get_height() : 1;
+    Rect uv(src.x() * sx, src.y() * sy, src.width() * sx, src.height() * sy);
+    if (uv.bottom() > rows) {
+        double visible = rows - uv.top();
+        if (visible <= 0) return;
+        dest = Rect(dest.x(), dest.y(), dest.width(), dest.height() * visible / uv.height());
+        uv = Rect(uv.x(), uv.y(), uv.width(), visible);
+    }
+
+    uint8_t tint[4];
+    premultiply(Color(255, 255, 255, color[3]), 1.0, tint);
+    GpuInstance instance = makeInstance(state.matrix, dest, state.clip, tint);
+    instance.uv[0] = static_cast<float>(uv.x());
+    instance.uv[1] = static_cast<float>(uv.y());
+    instance.uv[2] = static_cast<float>(uv.width());
+    instance.uv[3] = static_cast<float>(uv.height());
+    instance.aliased = list.paint(item.paint).antialias() == AntialiasMode::None ? 1 : 0;
+    Rect device = deviceBounds(state.matrix, dest, 0, state.clip);
+    if (device.isEmpty()) return;
+    addInstance(GpuPipelineKey{GpuPipeline::Image, list.paint(item.paint).blendMode(), false, texture}, instance,
+                device);
+}
+
+void GpuBackend::addInstance(const GpuPipelineKey& key, const GpuInstance& instance, const Rect& bounds) {
+    // Joining a batch draws the instance before every later batch, so no
+    // later batch may overlap it
+    size_t lookback = std::min(batches_.size(), kBatchLookback);
+    for (size_t i = 0; i < lookback; ++i) {
+        PendingBatch& batch = batches_[batches_.size() - 1 - i];
+        if (batch.key == key) {
+            batch.instances.push_back(instance);
+            batch.bounds = batch.bounds.unionRect(bounds);
+            return;
+        }
+        if (batch.bounds.intersects(bounds)) break;
+    }
+    batches_.push_back(PendingBatch{key, bounds, {instance}});
+}
+
+uint32_t GpuBackend::textureFor(const std::shared_ptr<const ImageBitmap>& bitmap, int& rows) {
+    rows = bitmap->readyRows();
+    auto it = textures_.find(bitmap.get());
+    if (it != textures_.end() && it->second.bitmap.lock() != bitmap) {
+        // A freed bitmap's address, reused
+        device_->releaseTexture(it->second.id);
+        textures_.erase(it);
+        it = textures_.end();
+    }
+    if (it != textures_.end() && it->second.rows == rows) return it->second.id;
+    if (rows == 0) return 0;
+
+    uint32_t id = it != textures_.end() ? it->second.id : 0;
+    id = device_->uploadTexture(id, bitmap->data(), bitmap->width(), rows, 4);
+    ++stats_.textureUploads;
+    textures_[bitmap.get()] = Texture{bitmap, id, rows};
+    return id;
+}
+
+void GpuBackend::releaseTextures(bool all) {
+    for (auto it = textures_.begin(); it != textures_.end();) {
+        if (all || it->second.bitmap.expired()) {
+            device_->releaseTexture(it->second.id);
+            it = textures_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace renderer
@@ -1,17 +1,99 @@
 #include "renderer/image.h"
+#include "renderer/image_decoder.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
 
 namespace renderer {
 
+namespace {
+
+std::atomic<uint64_t> nextBitmapId{1};
+
+// Next mip level of a complete bitmap: each pixel averages the 2x2 block
+// it covers, or the 2x1 or 1x2 one along an axis already one pixel long
+std::unique_ptr<ImageBitmap> halve(const ImageBitmap& source) {
+    int width = std::max(1, source.width() / 2);
+    int height = std::max(1, source.height() / 2);
+    int stepX = source.width() > 1 ? 1 : 0;
+    int stepY = source.height() > 1 ? 1 : 0;
+    auto level = std::make_unique<ImageBitmap>(width, height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* top = source.row(y * 2 * stepY);
+        const uint8_t* bottom = source.row(y * 2 * stepY + stepY);
+        uint8_t* out = level->row(y);
+        for (int x = 0; x < width; ++x) {
+            size_t left = static_cast<size_t>(x) * 2 * stepX * 4;
+            size_t right = left + stepX * 4;
+            for (int c = 0; c < 4; ++c) {
+                unsigned sum = top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c];
+                out[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+    level->publishRows(height);
+    return level;
+}
+
+} // namespace
+
+// ImageBitmap implementation
+ImageBitmap::ImageBitmap(int width, int height)
+    : width_(width)
+    , height_(height)
+    , id_(nextBitmapId.fetch_add(1, std::memory_order_relaxed))
+    , pixels_(static_cast<size_t>(width) * height * 4, 0)
+    , readyRows_(0)
+    , mipMutex_()
+    , mips_() {
+}
+
+int ImageBitmap::mipLevelCount() const {
+    int count = 1;
+    for (int size = std::max(width_, height_); size > 1; size /= 2) {
+        ++count;
+    }
+    return count;
+}
+
+const ImageBitmap* ImageBitmap::mipLevel(int level) const {
+    if (level < 0 || level >= mipLevelCount()) return nullptr;
+    if (level == 0) return this;
+    if (!isComplete()) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mipMutex_);
+    while (static_cast<int>(mips_.size()) < level) {
+        const ImageBitmap& previous = mips_.empty() ? *this : *mips_.back();
+        mips_.push_back(halve(previous));
+    }
+    return mips_[level - 1].get();
+}
+
+// Image implementation
 Image::Image() : width(0), height(0) {}
 
 Image::~Image() {}
 
 void Image::load_from_file(const std::string& filename) {
-    // Placeholder implementation
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) return;
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    load_from_data(data);
 }
 
 void Image::load_from_data(const std::vector<uint8_t>& data) {
-    // Placeholder implementation
+    std::unique_ptr<ImageDecoder> decoder = ImageDecoder::create(data.data(), data.size());
+    if (!decoder) return;
+
+    decoder->append(data.data(), data.size());
+    decoder->finish();
+    if (!decoder->bitmap()) return;
+
+    // A truncated image keeps the rows it has
+    width = decoder->intrinsicWidth();
+    height = decoder->intrinsicHeight();
+    bitmap = decoder->bitmap();
 }
 
 int Image::get_width() const {
@@ -30,4 +112,8 @@ void Image::set_height(int h) {
     height = h;
 }
 
+void Image::set_bitmap(std::shared_ptr<const ImageBitmap> b) {
+    bitmap = std::move(b);
+}
+
 } // namespace renderer
@@ -0,0 +1,288 @@
+#include "renderer/image_cache.h"
+#include "renderer/image_decoder.h"
+#include <algorithm>
+
+namespace renderer {
+
+namespace {
+
+// Longest signature the data is sniffed for before giving up on it
+constexpr size_t kSniffBytes = 16;
+
+} // namespace
+
+// ImageCache implementation
+ImageCache::ImageCache(size_t budgetBytes, size_t workerCount)
+    : mutex_()
+    , wake_()
+    , idle_()
+    , entries_()
+    , uses_()
+    , queue_()
+    , decoding_(0)
+    , budget_(budgetBytes)
+    , bytes_(0)
+    , callback_()
+    , stats_()
+    , workers_()
+    , stopRequested_(false) {
+    workers_.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers_.emplace_back(&ImageCache::workerLoop, this);
+    }
+}
+
+ImageCache::~ImageCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ImageCache::begin(const std::string& key, int targetWidth, int targetHeight) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        erase(*it->second);
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->key = key;
+    entry->targetWidth = std::max(0, targetWidth);
+    entry->targetHeight = std::max(0, targetHeight);
+    entry->intrinsicWidth = 0;
+    entry->intrinsicHeight = 0;
+    entry->bytes = 0;
+    entry->reportedRows = 0;
+    entry->finishing = false;
+    entry->streaming = true;
+    entry->scheduled = false;
+    entry->removed = false;
+    uses_.push_front(entry.get());
+    entry->use = uses_.begin();
+    entries_.emplace(key, std::move(entry));
+}
+
+void ImageCache::append(const std::string& key, const uint8_t* data, size_t size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end() || !it->second->streaming || it->second->finishing || size == 0) return;
+
+    std::shared_ptr<Entry> entry = it->second;
+    entry->input.insert(entry->input.end(), data, data + size);
+    schedule(entry, lock);
+}
+
+void ImageCache::finish(const std::string& key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end() || !it->second->streaming || it->second->finishing) return;
+
+    std::shared_ptr<Entry> entry = it->second;
+    entry->finishing = true;
+    schedule(entry, lock);
+}
+
+std::shared_ptr<const ImageBitmap> ImageCache::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+
+    ++stats_.hits;
+    Entry& entry = *it->second;
+    uses_.splice(uses_.begin(), uses_, entry.use);
+    return entry.bitmap;
+}
+
+bool ImageCache::intrinsicSize(const std::string& key, int& width, int& height) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second->intrinsicWidth == 0) return false;
+
+    width = it->second->intrinsicWidth;
+    height = it->second->intrinsicHeight;
+    return true;
+}
+
+bool ImageCache::contains(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.count(key) != 0;
+}
+
+void ImageCache::remove(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        erase(*it->second);
+    }
+}
+
+void ImageCache::setDecodedCallback(DecodedCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = std::move(callback);
+}
+
+void ImageCache::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return queue_.empty() && decoding_ == 0; });
+}
+
+size_t ImageCache::budget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+}
+
+void ImageCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    evict(budget_);
+}
+
+size_t ImageCache::byteSize() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+void ImageCache::purge(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    evict(bytes);
+}
+
+void ImageCache::onMemoryPressure(bool critical) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    evict(critical ? 0 : budget_ / 2);
+}
+
+ImageCache::Stats ImageCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.images = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+void ImageCache::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return stopRequested_ || !queue_.empty(); });
+        if (stopRequested_) return;
+
+        std::shared_ptr<Entry> entry = std::move(queue_.front());
+        queue_.pop_front();
+        ++decoding_;
+        decode(entry, lock);
+        entry->scheduled = false;
+        --decoding_;
+        if (queue_.empty() && decoding_ == 0) {
+            idle_.notify_all();
+        }
+    }
+}
+
+void ImageCache::schedule(const std::shared_ptr<Entry>& entry, std::unique_lock<std::mutex>& lock) {
+    if (entry->scheduled) return;
+
+    entry->scheduled = true;
+    if (workers_.empty()) {
+        decode(entry, lock);
+        entry->scheduled = false;
+        return;
+    }
+    queue_.push_back(entry);
+    wake_.notify_one();
+}
+
+// Only the thread that scheduled the entry touches its decoder, so it runs
+// without the lock while appends queue more input
+void ImageCache::decode(const std::shared_ptr<Entry>& entry, std::unique_lock<std::mutex>& lock) {
+    while (entry->streaming && (!entry->input.empty() || entry->finishing)) {
+        if (!entry->decoder) {
+            entry->decoder = ImageDecoder::create(entry->input.data(), entry->input.size());
+            if (!entry->decoder && entry->input.size() < kSniffBytes && !entry->finishing) return;
+            if (entry->decoder) {
+                entry->decoder->setTargetSize(entry->targetWidth, entry->targetHeight);
+                // A bitmap the cache could never hold is not worth allocating
+                entry->decoder->setMaxBytes(budget_);
+            }
+        }
+
+        std::vector<uint8_t> input = std::move(entry->input);
+        entry->input.clear();
+        bool finishing = entry->finishing;
+        ImageDecoder* decoder = entry->decoder.get();
+        lock.unlock();
+        if (decoder) {
+            decoder->append(input.data(), input.size());
+            if (finishing) decoder->finish();
+        }
+        lock.lock();
+
+        if (decoder && !entry->bitmap && decoder->bitmap()) {
+            entry->bitmap = decoder->bitmap();
+            entry->intrinsicWidth = decoder->intrinsicWidth();
+            entry->intrinsicHeight = decoder->intrinsicHeight();
+            if (!entry->removed) {
+                entry->bytes = entry->bitmap->byteSize();
+                bytes_ += entry->bytes;
+            }
+        }
+
+        bool ended = !decoder || decoder->state() == ImageDecoder::State::Failed ||
+                     decoder->state() == ImageDecoder::State::Complete;
+        if (ended) {
+            if (!decoder || decoder->state() == ImageDecoder::State::Failed) ++stats_.failed;
+            // The bitmap lives on; the decoder's buffers do not
+            entry->streaming = false;
+            entry->decoder.reset();
+            entry->input.clear();
+            entry->input.shrink_to_fit();
+        }
+
+        int rows = entry->bitmap ? entry->bitmap->readyRows() : 0;
+        bool progressed = rows != entry->reportedRows;
+        stats_.rowsDecoded += rows - entry->reportedRows;
+        entry->reportedRows = rows;
+        if (!entry->removed) evict(budget_);
+
+        if ((progressed || ended) && callback_ && !entry->removed) {
+            DecodedCallback callback = callback_;
+            lock.unlock();
+            callback(entry->key, rows);
+            lock.lock();
+        }
+    }
+}
+
+void ImageCache::evict(size_t bytes) {
+    std::vector<Entry*> victims;
+    size_t remaining = bytes_;
+    for (auto it = uses_.rbegin(); it != uses_.rend() && remaining > bytes; ++it) {
+        Entry* entry = *it;
+        if (entry->streaming || entry->scheduled) continue;
+        victims.push_back(entry);
+        remaining -= entry->bytes;
+    }
+    for (Entry* entry : victims) {
+        erase(*entry);
+        ++stats_.evictions;
+    }
+}
+
+void ImageCache::erase(Entry& entry) {
+    bytes_ -= entry.bytes;
+    entry.bytes = 0;
+    entry.removed = true;
+    uses_.erase(entry.use);
+    // May destroy entry; a worker decoding it holds a reference of its own
+    std::string key = entry.key;
+    entries_.erase(key);
+}
+
+} // namespace renderer
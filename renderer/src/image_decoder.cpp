@@ -0,0 +1,350 @@
+#include "renderer/image_decoder.h"
+#include "pixel_math.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+namespace renderer {
+
+namespace {
+
+// Larger headers are taken as garbage rather than waited on
+constexpr size_t kMaxHeaderBytes = 4096;
+
+bool isSpace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Binary netpbm: P5 graymap, P6 pixmap and P7 arbitrary map
+class NetpbmDecoder : public ImageDecoder {
+protected:
+    size_t parseHeader(const uint8_t* data, size_t size, int& width, int& height, bool& failed) override {
+        if (size < 3) return 0;
+        if (size > kMaxHeaderBytes) size = kMaxHeaderBytes;
+        size_t used = data[1] == '7' ? parsePam(data, size, failed) : parsePnm(data, size, failed);
+        if (used == 0 && !failed && size == kMaxHeaderBytes) failed = true;
+        if (used == 0 || failed) return 0;
+
+        if (width_ <= 0 || height_ <= 0 || depth_ < 1 || depth_ > 4 || maxValue_ < 1 || maxValue_ > 65535) {
+            failed = true;
+            return 0;
+        }
+        width = width_;
+        height = height_;
+        return used;
+    }
+
+    size_t rowBytes() const override {
+        return static_cast<size_t>(width_) * depth_ * (maxValue_ > 255 ? 2 : 1);
+    }
+
+    void convertRow(const uint8_t* source, uint8_t* rgba) const override {
+        bool wide = maxValue_ > 255;
+        auto sample = [&](size_t index) -> unsigned {
+            unsigned value = wide ? (source[index * 2] << 8 | source[index * 2 + 1]) : source[index];
+            value = std::min<unsigned>(value, maxValue_);
+            return maxValue_ == 255 ? value : (value * 255 + maxValue_ / 2) / maxValue_;
+        };
+
+        for (int x = 0; x < width_; ++x) {
+            size_t base = static_cast<size_t>(x) * depth_;
+            uint8_t* out = rgba + x * 4;
+            unsigned r, g, b, a = 255;
+            if (depth_ <= 2) {
+                r = g = b = sample(base);
+                if (depth_ == 2) a = sample(base + 1);
+            } else {
+                r = sample(base);
+                g = sample(base + 1);
+                b = sample(base + 2);
+                if (depth_ == 4) a = sample(base + 3);
+            }
+            out[0] = a == 255 ? r : div255(r * a);
+            out[1] = a == 255 ? g : div255(g * a);
+            out[2] = a == 255 ? b : div255(b * a);
+            out[3] = static_cast<uint8_t>(a);
+        }
+    }
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    int depth_ = 0;
+    unsigned maxValue_ = 0;
+
+    // P5 and P6: magic, width, height and maxval, separated by whitespace
+    // and comments, then a single whitespace byte before the raster
+    size_t parsePnm(const uint8_t* data, size_t size, bool& failed) {
+        size_t pos = 2;
+        long values[3];
+        for (long& value : values) {
+            while (true) {
+                if (pos >= size) return 0;
+                if (data[pos] == '#') {
+                    while (pos < size && data[pos] != '\n') ++pos;
+                } else if (isSpace(data[pos])) {
+                    ++pos;
+                } else {
+                    break;
+                }
+            }
+            if (data[pos] < '0' || data[pos] > '9') {
+                failed = true;
+                return 0;
+            }
+            value = 0;
+            while (pos < size && data[pos] >= '0' && data[pos] <= '9') {
+                value = value * 10 + (data[pos++] - '0');
+                if (value > 1 << 24) {
+                    failed = true;
+                    return 0;
+                }
+            }
+            // The number may continue in the next chunk
+            if (pos >= size) return 0;
+        }
+        if (!isSpace(data[pos])) {
+            failed = true;
+            return 0;
+        }
+        width_ = static_cast<int>(values[0]);
+        height_ = static_cast<int>(values[1]);
+        maxValue_ = static_cast<unsigned>(values[2]);
+        depth_ = data[1] == '5' ? 1 : 3;
+        return pos + 1;
+    }
+
+    // P7: "KEY value" lines up to ENDHDR
+    size_t parsePam(const uint8_t* data, size_t size, bool& failed) {
+        static const char kEnd[] = "\nENDHDR\n";
+        const uint8_t* end = std::search(data, data + size, kEnd, kEnd + sizeof(kEnd) - 1);
+        if (end == data + size) return 0;
+
+        std::string header(reinterpret_cast<const char*>(data) + 2, end - data - 2);
+        size_t pos = 0;
+        while (pos < header.size()) {
+            size_t lineEnd = header.find('\n', pos);
+            if (lineEnd == std::string::npos) lineEnd = header.size();
+            std::string line = header.substr(pos, lineEnd - pos);
+            pos = lineEnd + 1;
+
+            size_t split = line.find(' ');
+            if (line.empty() || line[0] == '#' || split == std::string::npos) continue;
+            std::string key = line.substr(0, split);
+            long value = std::strtol(line.c_str() + split + 1, nullptr, 10);
+            if (key == "WIDTH") {
+                width_ = static_cast<int>(value);
+            } else if (key == "HEIGHT") {
+                height_ = static_cast<int>(value);
+            } else if (key == "DEPTH") {
+                depth_ = static_cast<int>(value);
+            } else if (key == "MAXVAL") {
+                maxValue_ = static_cast<unsigned>(std::max(0L, value));
+            }
+        }
+        if (width_ > 1 << 24 || height_ > 1 << 24) failed = true;
+        return end - data + sizeof(kEnd) - 1;
+    }
+};
+
+struct Format {
+    std::string signature;
+    ImageDecoder::Factory factory;
+};
+
+std::mutex& formatsMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<Format>& formats() {
+    static std::vector<Format> registered = {
+        {"P5", [] { return std::unique_ptr<ImageDecoder>(new NetpbmDecoder()); }},
+        {"P6", [] { return std::unique_ptr<ImageDecoder>(new NetpbmDecoder()); }},
+        {"P7", [] { return std::unique_ptr<ImageDecoder>(new NetpbmDecoder()); }},
+    };
+    return registered;
+}
+
+} // namespace
+
+// ImageDecoder implementation
+ImageDecoder::ImageDecoder()
+    : state_(State::Header)
+    , targetWidth_(0)
+    , targetHeight_(0)
+    , maxBytes_(kDefaultMaxBytes)
+    , sourceWidth_(0)
+    , sourceHeight_(0)
+    , buffer_()
+    , consumed_(0)
+    , bitmap_()
+    , sourceRow_(0)
+    , converted_()
+    , sums_()
+    , columnCounts_()
+    , rowsSummed_(0) {
+}
+
+ImageDecoder::~ImageDecoder() = default;
+
+std::unique_ptr<ImageDecoder> ImageDecoder::create(const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(formatsMutex());
+    for (const Format& format : formats()) {
+        const std::string& signature = format.signature;
+        if (size >= signature.size() && std::memcmp(data, signature.data(), signature.size()) == 0) {
+            return format.factory();
+        }
+    }
+    return nullptr;
+}
+
+void ImageDecoder::registerFormat(const std::string& signature, Factory factory) {
+    if (signature.empty() || !factory) return;
+
+    std::lock_guard<std::mutex> lock(formatsMutex());
+    formats().push_back(Format{signature, std::move(factory)});
+}
+
+void ImageDecoder::setTargetSize(int width, int height) {
+    if (state_ != State::Header) return;
+    targetWidth_ = std::max(0, width);
+    targetHeight_ = std::max(0, height);
+}
+
+void ImageDecoder::setMaxBytes(size_t bytes) {
+    if (state_ != State::Header) return;
+    maxBytes_ = bytes;
+}
+
+bool ImageDecoder::append(const uint8_t* data, size_t size) {
+    if (state_ == State::Failed) return false;
+    if (state_ == State::Complete || size == 0) return true;
+
+    buffer_.insert(buffer_.end(), data, data + size);
+
+    if (state_ == State::Header) {
+        bool failed = false;
+        size_t used = parseHeader(buffer_.data(), buffer_.size(), sourceWidth_, sourceHeight_, failed);
+        if (failed) {
+            state_ = State::Failed;
+            return false;
+        }
+        if (used == 0) return true;
+
+        consumed_ = used;
+        if (!startRows()) {
+            state_ = State::Failed;
+            buffer_.clear();
+            buffer_.shrink_to_fit();
+            consumed_ = 0;
+            return false;
+        }
+    }
+
+    size_t bytes = rowBytes();
+    while (sourceRow_ < sourceHeight_ && buffer_.size() - consumed_ >= bytes) {
+        decodeRow(buffer_.data() + consumed_);
+        consumed_ += bytes;
+    }
+    if (sourceRow_ == sourceHeight_) {
+        state_ = State::Complete;
+        buffer_.clear();
+        buffer_.shrink_to_fit();
+        consumed_ = 0;
+    } else if (consumed_ > 0) {
+        // Keep only the partial row
+        buffer_.erase(buffer_.begin(), buffer_.begin() + consumed_);
+        consumed_ = 0;
+    }
+    return true;
+}
+
+void ImageDecoder::finish() {
+    if (state_ == State::Complete || state_ == State::Failed) return;
+
+    state_ = State::Failed;
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+    consumed_ = 0;
+}
+
+bool ImageDecoder::startRows() {
+    if (static_cast<uint64_t>(sourceWidth_) * static_cast<uint64_t>(sourceHeight_) > kMaxSourcePixels) {
+        return false;
+    }
+
+    int width = sourceWidth_;
+    int height = sourceHeight_;
+    double scale = 1;
+    if (targetWidth_ > 0) scale = std::min(scale, static_cast<double>(targetWidth_) / sourceWidth_);
+    if (targetHeight_ > 0) scale = std::min(scale, static_cast<double>(targetHeight_) / sourceHeight_);
+    if (scale < 1) {
+        width = std::max(1, static_cast<int>(sourceWidth_ * scale + 0.5));
+        height = std::max(1, static_cast<int>(sourceHeight_ * scale + 0.5));
+    }
+
+    if (static_cast<uint64_t>(width) * static_cast<uint64_t>(height) * 4 > maxBytes_) {
+        return false;
+    }
+
+    bitmap_ = std::make_shared<ImageBitmap>(width, height);
+    state_ = State::Rows;
+    if (width == sourceWidth_ && height == sourceHeight_) return true;
+
+    converted_.resize(static_cast<size_t>(sourceWidth_) * 4);
+    sums_.assign(static_cast<size_t>(width) * 4, 0);
+    columnCounts_.assign(width, 0);
+    for (int x = 0; x < sourceWidth_; ++x) {
+        ++columnCounts_[static_cast<int64_t>(x) * width / sourceWidth_];
+    }
+    rowsSummed_ = 0;
+    return true;
+}
+
+void ImageDecoder::decodeRow(const uint8_t* source) {
+    ImageBitmap& bitmap = *bitmap_;
+    int row = sourceRow_++;
+    if (converted_.empty()) {
+        convertRow(source, bitmap.row(row));
+        bitmap.publishRows(row + 1);
+        return;
+    }
+
+    // Box filter: each source pixel adds into the output pixel it lands in
+    convertRow(source, converted_.data());
+    int width = bitmap.width();
+    for (int x = 0; x < sourceWidth_; ++x) {
+        uint64_t* sum = &sums_[static_cast<size_t>(static_cast<int64_t>(x) * width / sourceWidth_) * 4];
+        const uint8_t* pixel = &converted_[static_cast<size_t>(x) * 4];
+        sum[0] += pixel[0];
+        sum[1] += pixel[1];
+        sum[2] += pixel[2];
+        sum[3] += pixel[3];
+    }
+    ++rowsSummed_;
+
+    int outputRow = static_cast<int>(static_cast<int64_t>(row) * bitmap.height() / sourceHeight_);
+    int nextRow = static_cast<int>(static_cast<int64_t>(row + 1) * bitmap.height() / sourceHeight_);
+    if (row + 1 == sourceHeight_ || nextRow != outputRow) {
+        emitRow(outputRow);
+    }
+}
+
+void ImageDecoder::emitRow(int row) {
+    ImageBitmap& bitmap = *bitmap_;
+    uint8_t* out = bitmap.row(row);
+    for (int x = 0; x < bitmap.width(); ++x) {
+        uint64_t count = static_cast<uint64_t>(columnCounts_[x]) * rowsSummed_;
+        for (int c = 0; c < 4; ++c) {
+            out[x * 4 + c] = static_cast<uint8_t>((sums_[x * 4 + c] + count / 2) / count);
+        }
+    }
+    std::fill(sums_.begin(), sums_.end(), 0);
+    rowsSummed_ = 0;
+    bitmap.publishRows(row + 1);
+}
+
+} // namespace renderer
@@ -0,0 +1,331 @@
+#include "renderer/image_scaler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#if defined(__SSE2__)
+#define RENDERER_SCALE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define RENDERER_SCALE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace renderer {
+
+namespace {
+
+constexpr int kWeightBits = 14;
+constexpr int kWeightOne = 1 << kWeightBits;
+constexpr int kRound = 1 << (kWeightBits - 1);
+// Source rects are keyed in 1/64 pixels
+constexpr double kQuantum = 64.0;
+
+// Source pixels one output pixel reads along an axis
+struct Taps {
+    int first;
+    int count;
+    // Into Filter::weights
+    size_t weights;
+};
+
+struct Filter {
+    std::vector<Taps> taps;
+    std::vector<int16_t> weights;
+};
+
+double kernelRadius(ImageFilter filter) {
+    switch (filter) {
+        case ImageFilter::Bilinear:
+            return 1;
+        case ImageFilter::Bicubic:
+            return 2;
+        default:
+            return 0.5;
+    }
+}
+
+double kernel(ImageFilter filter, double x) {
+    x = std::abs(x);
+    if (filter == ImageFilter::Bilinear) return std::max(0.0, 1 - x);
+
+    // Mitchell-Netravali with B = C = 1/3
+    constexpr double B = 1.0 / 3, C = 1.0 / 3;
+    if (x < 1) return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6;
+    if (x < 2) {
+        return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6;
+    }
+    return 0;
+}
+
+// Taps of outputs pixels spread over length source pixels from start,
+// reading only pixels in [low, high); taps past an end fold onto it
+Filter buildFilter(ImageFilter filter, double start, double length, int outputs, int low, int high) {
+    Filter result;
+    result.taps.reserve(outputs);
+    double scale = length / outputs;
+    std::vector<double> weights;
+
+    for (int i = 0; i < outputs; ++i) {
+        double center = start + (i + 0.5) * scale;
+        if (filter == ImageFilter::Nearest) {
+            int index = std::clamp(static_cast<int>(std::floor(center)), low, high - 1);
+            result.taps.push_back(Taps{index, 1, result.weights.size()});
+            result.weights.push_back(kWeightOne);
+            continue;
+        }
+
+        // Shrinking widens the kernel over every pixel it covers
+        double stretch = std::max(1.0, scale);
+        double support = kernelRadius(filter) * stretch;
+        int first = static_cast<int>(std::ceil(center - support - 0.5));
+        int last = static_cast<int>(std::floor(center + support - 0.5));
+        int from = std::clamp(first, low, high - 1);
+        int to = std::clamp(last, low, high - 1);
+        weights.assign(static_cast<size_t>(to - from + 1), 0.0);
+        double sum = 0;
+        for (int j = first; j <= last; ++j) {
+            double weight = kernel(filter, (j + 0.5 - center) / stretch);
+            weights[std::clamp(j, from, to) - from] += weight;
+            sum += weight;
+        }
+        if (sum == 0) {
+            weights.assign(1, 1.0);
+            from = to = std::clamp(static_cast<int>(std::floor(center)), low, high - 1);
+            sum = 1;
+        }
+
+        // Fixed point, with the rounding error given to the largest weight
+        // so every output sums to exactly one
+        size_t offset = result.weights.size();
+        int total = 0;
+        size_t largest = 0;
+        for (size_t k = 0; k < weights.size(); ++k) {
+            int fixed = static_cast<int>(std::lround(weights[k] / sum * kWeightOne));
+            result.weights.push_back(static_cast<int16_t>(fixed));
+            total += fixed;
+            if (std::abs(weights[k]) > std::abs(weights[largest])) largest = k;
+        }
+        result.weights[offset + largest] = static_cast<int16_t>(result.weights[offset + largest] + kWeightOne - total);
+
+        // Zero weights at the ends are not read
+        size_t begin = offset;
+        size_t end = result.weights.size();
+        while (end - begin > 1 && result.weights[begin] == 0) ++begin;
+        while (end - begin > 1 && result.weights[end - 1] == 0) --end;
+        result.taps.push_back(Taps{from + static_cast<int>(begin - offset), static_cast<int>(end - begin), begin});
+    }
+    return result;
+}
+
+uint8_t clampChannel(int value) {
+    return static_cast<uint8_t>(std::clamp(value >> kWeightBits, 0, 255));
+}
+
+// Row pass: out is the weighted sum of the taps rows, byte by byte
+void blendRows(const uint8_t* const* rows, const int16_t* weights, int taps, uint8_t* out, size_t bytes) {
+    size_t i = 0;
+#if defined(RENDERER_SCALE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i acc0 = _mm_set1_epi32(kRound);
+        __m128i acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        for (int k = 0; k < taps; k += 2) {
+            // Rows in pairs: interleaved, one madd weighs both
+            bool pair = k + 1 < taps;
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+            __m128i b = pair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i)) : zero;
+            int32_t packed = static_cast<uint16_t>(weights[k]) |
+                             (pair ? static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint16_t>(weights[k + 1])) << 16) : 0);
+            __m128i w = _mm_set1_epi32(packed);
+            __m128i aLow = _mm_unpacklo_epi8(a, zero), aHigh = _mm_unpackhi_epi8(a, zero);
+            __m128i bLow = _mm_unpacklo_epi8(b, zero), bHigh = _mm_unpackhi_epi8(b, zero);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(aLow, bLow), w));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(aLow, bLow), w));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(aHigh, bHigh), w));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(aHigh, bHigh), w));
+        }
+        __m128i low = _mm_packs_epi32(_mm_srai_epi32(acc0, kWeightBits), _mm_srai_epi32(acc1, kWeightBits));
+        __m128i high = _mm_packs_epi32(_mm_srai_epi32(acc2, kWeightBits), _mm_srai_epi32(acc3, kWeightBits));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high));
+    }
+#elif defined(RENDERER_SCALE_NEON)
+    for (; i + 16 <= bytes; i += 16) {
+        int32x4_t acc0 = vdupq_n_s32(kRound);
+        int32x4_t acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        for (int k = 0; k < taps; ++k) {
+            uint8x16_t v = vld1q_u8(rows[k] + i);
+            int16x8_t low = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v)));
+            int16x8_t high = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v)));
+            int16x4_t w = vdup_n_s16(weights[k]);
+            acc0 = vmlal_s16(acc0, vget_low_s16(low), w);
+            acc1 = vmlal_s16(acc1, vget_high_s16(low), w);
+            acc2 = vmlal_s16(acc2, vget_low_s16(high), w);
+            acc3 = vmlal_s16(acc3, vget_high_s16(high), w);
+        }
+        int16x8_t low = vcombine_s16(vqshrn_n_s32(acc0, kWeightBits), vqshrn_n_s32(acc1, kWeightBits));
+        int16x8_t high = vcombine_s16(vqshrn_n_s32(acc2, kWeightBits), vqshrn_n_s32(acc3, kWeightBits));
+        vst1q_u8(out + i, vcombine_u8(vqmovun_s16(low), vqmovun_s16(high)));
+    }
+#endif
+    for (; i < bytes; ++i) {
+        int sum = kRound;
+        for (int k = 0; k < taps; ++k) {
+            sum += rows[k][i] * weights[k];
+        }
+        out[i] = clampChannel(sum);
+    }
+}
+
+// Column pass: each output pixel is the weighted sum of its taps pixels of
+// row, whose first pixel is source column origin
+void blendColumns(const uint8_t* row, int origin, const Filter& columns, uint8_t* out, bool clampToAlpha) {
+    for (size_t x = 0; x < columns.taps.size(); ++x) {
+        const Taps& taps = columns.taps[x];
+        const uint8_t* pixels = row + static_cast<size_t>(taps.first - origin) * 4;
+        const int16_t* weights = columns.weights.data() + taps.weights;
+        uint8_t* pixel = out + x * 4;
+#if defined(RENDERER_SCALE_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_set1_epi32(kRound);
+        for (int k = 0; k < taps.count; k += 2) {
+            bool pair = k + 1 < taps.count;
+            uint32_t first, second = 0;
+            std::memcpy(&first, pixels + k * 4, 4);
+            if (pair) std::memcpy(&second, pixels + (k + 1) * 4, 4);
+            __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(first)), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(second)), zero);
+            int32_t packed = static_cast<uint16_t>(weights[k]) |
+                             (pair ? static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint16_t>(weights[k + 1])) << 16) : 0);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), _mm_set1_epi32(packed)));
+        }
+        __m128i packed16 = _mm_packs_epi32(_mm_srai_epi32(acc, kWeightBits), zero);
+        uint32_t result = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(packed16, zero)));
+        std::memcpy(pixel, &result, 4);
+#elif defined(RENDERER_SCALE_NEON)
+        int32x4_t acc = vdupq_n_s32(kRound);
+        for (int k = 0; k < taps.count; ++k) {
+            uint32_t value;
+            std::memcpy(&value, pixels + k * 4, 4);
+            int16x4_t channels = vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vcreate_u8(value))));
+            acc = vmlal_s16(acc, channels, vdup_n_s16(weights[k]));
+        }
+        int16x4_t narrowed = vqshrn_n_s32(acc, kWeightBits);
+        uint8x8_t bytes = vqmovun_s16(vcombine_s16(narrowed, narrowed));
+        uint32_t result = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+        std::memcpy(pixel, &result, 4);
+#else
+        for (int c = 0; c < 4; ++c) {
+            int sum = kRound;
+            for (int k = 0; k < taps.count; ++k) {
+                sum += pixels[k * 4 + c] * weights[k];
+            }
+            pixel[c] = clampChannel(sum);
+        }
+#endif
+        // Negative lobes can leave a color above its alpha
+        if (clampToAlpha) {
+            for (int c = 0; c < 3; ++c) {
+                pixel[c] = std::min(pixel[c], pixel[3]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+ImageFilter imageFilterFor(RenderingHint hint) {
+    switch (hint) {
+        case RenderingHint::Fast:
+            return ImageFilter::Nearest;
+        case RenderingHint::Best:
+            return ImageFilter::Bicubic;
+        default:
+            return ImageFilter::Bilinear;
+    }
+}
+
+std::shared_ptr<ImageBitmap> scaleBitmap(const ImageBitmap& bitmap, const Rect& source, int width, int height,
+                                         ImageFilter filter) {
+    if (width <= 0 || height <= 0 || bitmap.width() <= 0 || bitmap.height() <= 0) return nullptr;
+    if (source.width() <= 0 || source.height() <= 0) return nullptr;
+
+    // Shrinking by 2x or more starts from the mip level that leaves less
+    const ImageBitmap* level = &bitmap;
+    Rect area = source;
+    double reduction = std::min(source.width() / width, source.height() / height);
+    if (filter != ImageFilter::Nearest && reduction >= 2 && bitmap.isComplete()) {
+        int wanted = std::min(static_cast<int>(std::log2(reduction)), bitmap.mipLevelCount() - 1);
+        level = bitmap.mipLevel(wanted);
+        double sx = static_cast<double>(level->width()) / bitmap.width();
+        double sy = static_cast<double>(level->height()) / bitmap.height();
+        area = Rect(source.x() * sx, source.y() * sy, source.width() * sx, source.height() * sy);
+    }
+
+    // Taps stay within the source rect, rounded out to whole pixels
+    int left = std::clamp(static_cast<int>(std::floor(area.x())), 0, level->width() - 1);
+    int right = std::clamp(static_cast<int>(std::ceil(area.x() + area.width())), left + 1, level->width());
+    int top = std::clamp(static_cast<int>(std::floor(area.y())), 0, level->height() - 1);
+    int bottom = std::clamp(static_cast<int>(std::ceil(area.y() + area.height())), top + 1, level->height());
+    Filter columns = buildFilter(filter, area.x(), area.width(), width, left, right);
+    Filter rows = buildFilter(filter, area.y(), area.height(), height, top, bottom);
+
+    auto result = std::make_shared<ImageBitmap>(width, height);
+    int readyRows = level->readyRows();
+    std::vector<uint8_t> blended(static_cast<size_t>(right - left) * 4);
+    std::vector<const uint8_t*> tapRows;
+    for (int y = 0; y < height; ++y) {
+        const Taps& taps = rows.taps[y];
+        // Rows reading undecoded pixels are left transparent
+        if (taps.first + taps.count > readyRows) continue;
+
+        tapRows.clear();
+        for (int k = 0; k < taps.count; ++k) {
+            tapRows.push_back(level->row(taps.first + k) + static_cast<size_t>(left) * 4);
+        }
+        blendRows(tapRows.data(), rows.weights.data() + taps.weights, taps.count, blended.data(), blended.size());
+        blendColumns(blended.data(), left, columns, result->row(y), filter == ImageFilter::Bicubic);
+    }
+    result->publishRows(height);
+    return result;
+}
+
+size_t ScaledImageCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<uint64_t>()(key.bitmap);
+    auto mix = [&](int value) { hash ^= std::hash<int>()(value) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2); };
+    mix(key.readyRows);
+    mix(key.sourceX);
+    mix(key.sourceY);
+    mix(key.sourceWidth);
+    mix(key.sourceHeight);
+    mix(key.width);
+    mix(key.height);
+    mix(static_cast<int>(key.filter));
+    return hash;
+}
+
+// ScaledImageCache implementation
+ScaledImageCache::ScaledImageCache(size_t budgetBytes)
+    : cache_(budgetBytes) {
+}
+
+std::shared_ptr<ScaledImageCache> ScaledImageCache::shared() {
+    static std::shared_ptr<ScaledImageCache> cache = std::make_shared<ScaledImageCache>();
+    return cache;
+}
+
+std::shared_ptr<const ImageBitmap> ScaledImageCache::get(const ImageBitmap& bitmap, const Rect& source, int width,
+                                                         int height, ImageFilter filter) {
+    if (width <= 0 || height <= 0) return nullptr;
+
+    auto quantize = [](double value) { return static_cast<int>(std::lround(value * kQuantum)); };
+    Key key{bitmap.id(), bitmap.readyRows(), quantize(source.x()), quantize(source.y()), quantize(source.width()),
+            quantize(source.height()), width, height, filter};
+
+    // Scaled unlocked; a racing thread may scale the same image
+    return cache_.get(key, [&] { return scaleBitmap(bitmap, source, width, height, filter); });
+}
+
+} // namespace renderer
@@ -0,0 +1,202 @@
+#include "renderer/layer.h"
+#include "renderer/display_list.h"
+#include "renderer/software.h"
+#include <algorithm>
+#include <cmath>
+
+namespace renderer {
+
+// StickyConstraint implementation
+Point StickyConstraint::offset(const Rect& visible) const {
+    // Bottom and right first, so top and left override them
+    Point shift;
+    if (bottom) {
+        double limit = visible.bottom() - insets.bottom;
+        if (stickyRect.bottom() > limit) {
+            shift.y = std::min(0.0, std::max(limit - stickyRect.bottom(), containingRect.top() - stickyRect.top()));
+        }
+    }
+    if (top) {
+        double limit = visible.top() + insets.top;
+        if (stickyRect.top() + shift.y < limit) {
+            shift.y = std::max(0.0, std::min(limit - stickyRect.top(), containingRect.bottom() - stickyRect.bottom()));
+        }
+    }
+    if (right) {
+        double limit = visible.right() - insets.right;
+        if (stickyRect.right() > limit) {
+            shift.x = std::min(0.0, std::max(limit - stickyRect.right(), containingRect.left() - stickyRect.left()));
+        }
+    }
+    if (left) {
+        double limit = visible.left() + insets.left;
+        if (stickyRect.left() + shift.x < limit) {
+            shift.x = std::max(0.0, std::min(limit - stickyRect.left(), containingRect.right() - stickyRect.right()));
+        }
+    }
+    return shift;
+}
+
+// Layer implementation
+Layer::Layer()
+    : Layer(Size()) {
+}
+
+Layer::Layer(const Size& size)
+    : parent_(nullptr)
+    , children_()
+    , size_(size)
+    , position_()
+    , transform_(Matrix::identity())
+    , opacity_(1.0)
+    , blendMode_(BlendMode::Normal)
+    , visible_(true)
+    , scrollContainer_(false)
+    , scrollOffset_()
+    , sticky_(false)
+    , stickyConstraint_()
+    , content_(nullptr)
+    , contentDamage_()
+    , raster_(nullptr)
+    , version_(0) {
+}
+
+Layer::~Layer() {
+    for (auto& child : children_) {
+        child->parent_ = nullptr;
+    }
+}
+
+void Layer::addChild(std::shared_ptr<Layer> child) {
+    if (!child || child.get() == this) return;
+
+    child->removeFromParent();
+    child->parent_ = this;
+    children_.push_back(std::move(child));
+    ++version_;
+}
+
+void Layer::removeChild(Layer* child) {
+    auto it = std::find_if(children_.begin(), children_.end(),
+                           [&](const std::shared_ptr<Layer>& entry) { return entry.get() == child; });
+    if (it == children_.end()) return;
+
+    (*it)->parent_ = nullptr;
+    children_.erase(it);
+    ++version_;
+}
+
+void Layer::removeFromParent() {
+    if (parent_) {
+        parent_->removeChild(this);
+    }
+}
+
+void Layer::setSize(const Size& size) {
+    if (size == size_) return;
+
+    size_ = size;
+    contentDamage_.clear();
+    contentDamage_.add(Rect(Point(), size_));
+    ++version_;
+}
+
+void Layer::setPosition(const Point& position) {
+    if (position == position_) return;
+
+    position_ = position;
+    ++version_;
+}
+
+void Layer::setTransform(const Matrix& transform) {
+    transform_ = transform;
+    ++version_;
+}
+
+void Layer::setOpacity(double opacity) {
+    opacity = std::clamp(opacity, 0.0, 1.0);
+    if (opacity == opacity_) return;
+
+    opacity_ = opacity;
+    ++version_;
+}
+
+void Layer::setBlendMode(BlendMode mode) {
+    if (mode == blendMode_) return;
+
+    blendMode_ = mode;
+    ++version_;
+}
+
+void Layer::setVisible(bool visible) {
+    if (visible == visible_) return;
+
+    visible_ = visible;
+    ++version_;
+}
+
+void Layer::setScrollContainer(bool scrollContainer) {
+    if (scrollContainer == scrollContainer_) return;
+
+    scrollContainer_ = scrollContainer;
+    ++version_;
+}
+
+void Layer::setScrollOffset(const Point& offset) {
+    if (offset == scrollOffset_) return;
+
+    scrollOffset_ = offset;
+    ++version_;
+}
+
+void Layer::setStickyConstraint(const StickyConstraint& constraint) {
+    sticky_ = true;
+    stickyConstraint_ = constraint;
+    ++version_;
+}
+
+void Layer::clearStickyConstraint() {
+    if (!sticky_) return;
+
+    sticky_ = false;
+    ++version_;
+}
+
+void Layer::setContent(std::shared_ptr<const DisplayList> content) {
+    setContent(std::move(content), Rect(Point(), size_));
+}
+
+void Layer::setContent(std::shared_ptr<const DisplayList> content, const Rect& changed) {
+    content_ = std::move(content);
+    invalidateContent(changed);
+}
+
+void Layer::invalidateContent(const Rect& rect) {
+    contentDamage_.add(rect.intersection(Rect(Point(), size_)));
+    ++version_;
+}
+
+void Layer::releaseRaster() {
+    raster_.reset();
+    contentDamage_.clear();
+    contentDamage_.add(Rect(Point(), size_));
+}
+
+size_t Layer::rasterize() {
+    int width = static_cast<int>(std::ceil(size_.width));
+    int height = static_cast<int>(std::ceil(size_.height));
+    if (!raster_ || raster_->width() != width || raster_->height() != height) {
+        // One thread: layers are small, and the compositor owns the frame
+        raster_ = std::make_unique<SoftwareRasterizer>(width, height, 1);
+    } else {
+        for (const auto& rect : contentDamage_.rects()) {
+            raster_->invalidate(rect);
+        }
+    }
+    contentDamage_.clear();
+
+    static const DisplayList empty;
+    return raster_->rasterize(content_ ? *content_ : empty);
+}
+
+} // namespace renderer
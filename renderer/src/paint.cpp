@@ -1,9 +1,30 @@
 #include "renderer/paint.h"
 #include <algorithm>
 #include <cmath>
+#include <functional>
 
 namespace renderer {
 
+namespace {
+
+constexpr size_t kMinSweep = 1024;
+
+template <typename T>
+void combine(size_t& seed, const T& value) {
+    seed ^= std::hash<T>()(value) + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2);
+}
+
+void combine(size_t& seed, const Color& color) {
+    combine(seed, color.toRGBA());
+}
+
+void combine(size_t& seed, const Point& point) {
+    combine(seed, point.x);
+    combine(seed, point.y);
+}
+
+} // namespace
+
 // Paint implementation
 Paint::Paint()
     : style_(PaintStyle::Fill)
@@ -117,6 +138,63 @@ bool Paint::operator==(const Paint& other) const {
            memoryType_ == other.memoryType_;
 }
 
+// Hashes what operator== compares
+size_t Paint::hash() const {
+    size_t seed = 0;
+    combine(seed, static_cast<int>(style_));
+    combine(seed, color_);
+    combine(seed, strokeWidth_);
+    combine(seed, static_cast<int>(lineCap_));
+    combine(seed, static_cast<int>(lineJoin_));
+    combine(seed, miterLimit_);
+    combine(seed, static_cast<int>(antialias_));
+    combine(seed, static_cast<int>(blendMode_));
+    combine(seed, opacity_);
+    combine(seed, shader_.get());
+    combine(seed, gradient_.get());
+    combine(seed, pattern_.get());
+    combine(seed, image_.get());
+    combine(seed, static_cast<int>(fillRule_));
+    combine(seed, static_cast<int>(textRenderingMode_));
+    combine(seed, font_.family);
+    combine(seed, font_.size);
+    combine(seed, font_.weight);
+    combine(seed, font_.italic);
+    combine(seed, font_.bold);
+    combine(seed, static_cast<int>(textAlign_));
+    combine(seed, static_cast<int>(textBaseline_));
+    combine(seed, textSize_);
+    combine(seed, static_cast<int>(textStyle_));
+    combine(seed, static_cast<int>(textWeight_));
+    combine(seed, static_cast<int>(textStretch_));
+    combine(seed, textFamily_);
+    combine(seed, hasShadow_);
+    combine(seed, shadowColor_);
+    combine(seed, shadowOffset_);
+    combine(seed, shadowBlur_);
+    combine(seed, hasStrokeDash_);
+    for (double dash : strokeDashArray_) {
+        combine(seed, dash);
+    }
+    combine(seed, strokeDashOffset_);
+    combine(seed, hasFilter_);
+    combine(seed, static_cast<int>(filterType_));
+    combine(seed, filterColor_);
+    combine(seed, filterBlur_);
+    combine(seed, filterOffset_);
+    for (double m : {transform_.m11, transform_.m12, transform_.m13, transform_.m21, transform_.m22, transform_.m23,
+                     transform_.m31, transform_.m32, transform_.m33}) {
+        combine(seed, m);
+    }
+    combine(seed, hasClip_);
+    combine(seed, clipRect_.origin);
+    combine(seed, clipRect_.size.width);
+    combine(seed, clipRect_.size.height);
+    combine(seed, static_cast<int>(renderingHint_));
+    combine(seed, static_cast<int>(memoryType_));
+    return seed;
+}
+
 void Paint::reset() {
     *this = Paint();
 }
@@ -248,4 +326,62 @@ void Paint::cleanup() {
     image_.reset();
 }
 
+// PaintInterner implementation
+PaintInterner::PaintInterner()
+    : mutex_()
+    , entries_()
+    , nextId_(1)
+    , sweepAt_(kMinSweep)
+    , stats_() {
+}
+
+PaintInterner& PaintInterner::shared() {
+    static PaintInterner interner;
+    return interner;
+}
+
+PaintHandle PaintInterner::intern(const Paint& paint) {
+    size_t hash = paint.hash();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto range = entries_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        PaintHandle handle = it->second.lock();
+        if (handle && handle->paint() == paint) {
+            ++stats_.hits;
+            return handle;
+        }
+    }
+
+    ++stats_.misses;
+    PaintHandle handle = std::make_shared<InternedPaint>(paint, hash, nextId_++);
+    entries_.emplace(hash, handle);
+    if (entries_.size() >= sweepAt_) {
+        sweep();
+    }
+    return handle;
+}
+
+PaintInterner::Stats PaintInterner::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.paints = 0;
+    for (const auto& entry : entries_) {
+        if (!entry.second.expired()) ++stats.paints;
+    }
+    return stats;
+}
+
+// Drops the entries of released paints; runs when entries double, so its
+// cost is spread over the interns that grew them
+void PaintInterner::sweep() {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->second.expired()) {
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    sweepAt_ = std::max(kMinSweep, entries_.size() * 2);
+}
+
 } // namespace renderer
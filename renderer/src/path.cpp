@@ -1,45 +1,191 @@
 #include "renderer/path.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 
 namespace renderer {
 
-Path::Path() {}
+namespace {
+
+// Control point distance of a cubic quarter circle, per unit radius
+constexpr double kCircleControl = 0.5522847498307936;
+
+uint32_t nextGenerationId() {
+    static std::atomic<uint32_t> next(1);
+    uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+    // 0 stays reserved for the empty path
+    return id != 0 ? id : next.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// Path implementation
+Path::Path()
+    : verbs_()
+    , points_()
+    , fillRule_(FillRule::NonZero)
+    , bounds_()
+    , generationId_(0)
+    , shape_(Shape::None)
+    , shapeRect_()
+    , radiusX_(0)
+    , radiusY_(0)
+    , contourStart_() {
+}
 
 Path::~Path() {}
 
 void Path::move_to(float x, float y) {
-    // Implementation for move to command
+    verbs_.push_back(PathVerb::Move);
+    addPoint(Point(x, y));
+    contourStart_ = Point(x, y);
+    edited(Shape::None);
 }
 
 void Path::line_to(float x, float y) {
-    // Implementation for line to command
+    ensureContour();
+    verbs_.push_back(PathVerb::Line);
+    addPoint(Point(x, y));
+    edited(Shape::None);
 }
 
 void Path::curve_to(float x1, float y1, float x2, float y2, float x3, float y3) {
-    // Implementation for curve to command
+    ensureContour();
+    verbs_.push_back(PathVerb::Cubic);
+    addPoint(Point(x1, y1));
+    addPoint(Point(x2, y2));
+    addPoint(Point(x3, y3));
+    edited(Shape::None);
 }
 
 void Path::close_path() {
-    // Implementation for close path command
+    if (verbs_.empty() || verbs_.back() == PathVerb::Close) return;
+    verbs_.push_back(PathVerb::Close);
+    edited(Shape::None);
 }
 
 void Path::add_rect(float x, float y, float width, float height) {
-    // Implementation for adding rectangle
+    bool wasEmpty = verbs_.empty();
+    Rect rect(std::min(x, x + width), std::min(y, y + height), std::abs(width), std::abs(height));
+
+    move_to(rect.left(), rect.top());
+    line_to(rect.right(), rect.top());
+    line_to(rect.right(), rect.bottom());
+    line_to(rect.left(), rect.bottom());
+    close_path();
+
+    shapeRect_ = rect;
+    edited(wasEmpty ? Shape::Rect : Shape::None);
+}
+
+void Path::add_round_rect(float x, float y, float width, float height, float rx, float ry) {
+    if (rx <= 0 || ry <= 0) {
+        add_rect(x, y, width, height);
+        return;
+    }
+
+    bool wasEmpty = verbs_.empty();
+    Rect rect(std::min(x, x + width), std::min(y, y + height), std::abs(width), std::abs(height));
+    double radiusX = std::min<double>(rx, rect.width() / 2);
+    double radiusY = std::min<double>(ry, rect.height() / 2);
+    double cx = radiusX * kCircleControl;
+    double cy = radiusY * kCircleControl;
+    double l = rect.left(), t = rect.top(), r = rect.right(), b = rect.bottom();
+
+    move_to(l + radiusX, t);
+    line_to(r - radiusX, t);
+    curve_to(r - radiusX + cx, t, r, t + radiusY - cy, r, t + radiusY);
+    line_to(r, b - radiusY);
+    curve_to(r, b - radiusY + cy, r - radiusX + cx, b, r - radiusX, b);
+    line_to(l + radiusX, b);
+    curve_to(l + radiusX - cx, b, l, b - radiusY + cy, l, b - radiusY);
+    line_to(l, t + radiusY);
+    curve_to(l, t + radiusY - cy, l + radiusX - cx, t, l + radiusX, t);
+    close_path();
+
+    shapeRect_ = rect;
+    radiusX_ = radiusX;
+    radiusY_ = radiusY;
+    edited(wasEmpty ? Shape::RoundRect : Shape::None);
 }
 
 void Path::add_circle(float cx, float cy, float radius) {
-    // Implementation for adding circle
+    add_ellipse(cx, cy, radius, radius);
 }
 
 void Path::add_ellipse(float cx, float cy, float rx, float ry) {
-    // Implementation for adding ellipse
+    bool wasEmpty = verbs_.empty();
+    double radiusX = std::abs(rx);
+    double radiusY = std::abs(ry);
+    double kx = radiusX * kCircleControl;
+    double ky = radiusY * kCircleControl;
+
+    move_to(cx + radiusX, cy);
+    curve_to(cx + radiusX, cy + ky, cx + kx, cy + radiusY, cx, cy + radiusY);
+    curve_to(cx - kx, cy + radiusY, cx - radiusX, cy + ky, cx - radiusX, cy);
+    curve_to(cx - radiusX, cy - ky, cx - kx, cy - radiusY, cx, cy - radiusY);
+    curve_to(cx + kx, cy - radiusY, cx + radiusX, cy - ky, cx + radiusX, cy);
+    close_path();
+
+    shapeRect_ = Rect(cx - radiusX, cy - radiusY, radiusX * 2, radiusY * 2);
+    edited(wasEmpty ? Shape::Oval : Shape::None);
 }
 
 void Path::clear() {
-    // Clear the path
+    verbs_.clear();
+    points_.clear();
+    bounds_ = Rect();
+    generationId_ = 0;
+    shape_ = Shape::None;
+    contourStart_ = Point();
 }
 
 bool Path::is_empty() const {
-    return true; // Placeholder implementation
+    return verbs_.empty();
+}
+
+bool Path::is_rect(Rect* rect) const {
+    if (shape_ != Shape::Rect) return false;
+    if (rect) *rect = shapeRect_;
+    return true;
+}
+
+bool Path::is_oval(Rect* rect) const {
+    if (shape_ != Shape::Oval) return false;
+    if (rect) *rect = shapeRect_;
+    return true;
+}
+
+bool Path::is_round_rect(Rect* rect, double* rx, double* ry) const {
+    if (shape_ != Shape::RoundRect) return false;
+    if (rect) *rect = shapeRect_;
+    if (rx) *rx = radiusX_;
+    if (ry) *ry = radiusY_;
+    return true;
+}
+
+void Path::addPoint(const Point& point) {
+    if (points_.empty()) {
+        bounds_ = Rect(point, Size());
+    } else {
+        double left = std::min(bounds_.left(), point.x);
+        double top = std::min(bounds_.top(), point.y);
+        double right = std::max(bounds_.right(), point.x);
+        double bottom = std::max(bounds_.bottom(), point.y);
+        bounds_ = Rect(left, top, right - left, bottom - top);
+    }
+    points_.push_back(point);
+}
+
+void Path::ensureContour() {
+    if (!verbs_.empty() && verbs_.back() != PathVerb::Close) return;
+    verbs_.push_back(PathVerb::Move);
+    addPoint(contourStart_);
+}
+
+void Path::edited(Shape shape) {
+    shape_ = shape;
+    generationId_ = nextGenerationId();
 }
 
 } // namespace renderer
@@ -0,0 +1,282 @@
+#include "renderer/path_cache.h"
+#include "renderer/paint.h"
+#include "renderer/path.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace renderer {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Flattening error allowed, in device pixels
+constexpr double kTolerance = 0.25;
+
+// Segments a flattened cubic may be split into
+constexpr int kMaxCurveSegments = 256;
+
+struct Contour {
+    std::vector<Point> points;
+    bool closed;
+};
+
+double length(const Point& p) {
+    return std::sqrt(p.x * p.x + p.y * p.y);
+}
+
+// A cubic strays from its chords by at most 3/4 of its larger second
+// difference over the square of the segment count. p0 is a copy, being
+// the last point of out.
+void flattenCubic(Point p0, const Point& p1, const Point& p2, const Point& p3, double tolerance,
+                  std::vector<Point>& out) {
+    Point dd1(p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y);
+    Point dd2(p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y);
+    double dd = std::max(length(dd1), length(dd2));
+    int segments = std::clamp(static_cast<int>(std::ceil(std::sqrt(0.75 * dd / tolerance))), 1, kMaxCurveSegments);
+    for (int i = 1; i <= segments; ++i) {
+        double t = static_cast<double>(i) / segments;
+        double u = 1 - t;
+        double a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+        out.push_back(Point(a * p0.x + b * p1.x + c * p2.x + d * p3.x, a * p0.y + b * p1.y + c * p2.y + d * p3.y));
+    }
+}
+
+std::vector<Contour> flatten(const Path& path, double tolerance) {
+    std::vector<Contour> contours;
+    const std::vector<Point>& points = path.points();
+    size_t index = 0;
+    for (PathVerb verb : path.verbs()) {
+        switch (verb) {
+            case PathVerb::Move:
+                contours.push_back(Contour{{points[index++]}, false});
+                break;
+            case PathVerb::Line:
+                contours.back().points.push_back(points[index++]);
+                break;
+            case PathVerb::Cubic:
+                flattenCubic(contours.back().points.back(), points[index], points[index + 1], points[index + 2],
+                             tolerance, contours.back().points);
+                index += 3;
+                break;
+            case PathVerb::Close:
+                contours.back().closed = true;
+                break;
+        }
+    }
+
+    // Repeated points have no direction to join or cap by
+    for (Contour& contour : contours) {
+        std::vector<Point>& p = contour.points;
+        p.erase(std::unique(p.begin(), p.end(), [](const Point& a, const Point& b) { return a.x == b.x && a.y == b.y; }),
+                p.end());
+        if (contour.closed && p.size() > 1 && p.front().x == p.back().x && p.front().y == p.back().y) {
+            p.pop_back();
+        }
+    }
+    return contours;
+}
+
+// Adds polygon's edges wound the same way whichever way it was given, so
+// overlapping polygons union under the nonzero rule
+void addPolygon(std::vector<Point> polygon, std::vector<PathEdge>& edges) {
+    if (polygon.size() < 3) return;
+
+    double area = 0;
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        const Point& a = polygon[i];
+        const Point& b = polygon[(i + 1) % polygon.size()];
+        area += a.x * b.y - b.x * a.y;
+    }
+    if (area == 0) return;
+    if (area > 0) std::reverse(polygon.begin(), polygon.end());
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        edges.push_back(PathEdge{polygon[i], polygon[(i + 1) % polygon.size()]});
+    }
+}
+
+void addCircle(const Point& center, double radius, double tolerance, std::vector<PathEdge>& edges) {
+    int segments = 8;
+    if (tolerance < radius) {
+        segments = std::clamp(static_cast<int>(std::ceil(kPi / std::acos(1 - tolerance / radius))), 8, 256);
+    }
+    std::vector<Point> polygon;
+    polygon.reserve(segments);
+    for (int i = 0; i < segments; ++i) {
+        double angle = 2 * kPi * i / segments;
+        polygon.push_back(Point(center.x + radius * std::cos(angle), center.y + radius * std::sin(angle)));
+    }
+    addPolygon(std::move(polygon), edges);
+}
+
+void addStroke(const Contour& contour, const Paint& paint, double halfWidth, double tolerance,
+               std::vector<PathEdge>& edges) {
+    const std::vector<Point>& p = contour.points;
+    size_t count = p.size();
+    auto direction = [&](size_t from, size_t to) {
+        Point d(p[to].x - p[from].x, p[to].y - p[from].y);
+        double len = length(d);
+        return Point(d.x / len, d.y / len);
+    };
+    // Left of travel, scaled to the half width
+    auto normal = [&](const Point& d) { return Point(-d.y * halfWidth, d.x * halfWidth); };
+
+    if (count == 1) {
+        // A dot: only caps draw it
+        if (paint.lineCap() == LineCap::Round) {
+            addCircle(p[0], halfWidth, tolerance, edges);
+        } else if (paint.lineCap() == LineCap::Square) {
+            addPolygon({Point(p[0].x - halfWidth, p[0].y - halfWidth), Point(p[0].x + halfWidth, p[0].y - halfWidth),
+                        Point(p[0].x + halfWidth, p[0].y + halfWidth), Point(p[0].x - halfWidth, p[0].y + halfWidth)},
+                       edges);
+        }
+        return;
+    }
+
+    size_t segments = contour.closed ? count : count - 1;
+    for (size_t i = 0; i < segments; ++i) {
+        const Point& a = p[i];
+        const Point& b = p[(i + 1) % count];
+        Point n = normal(direction(i, (i + 1) % count));
+        addPolygon({Point(a.x + n.x, a.y + n.y), Point(b.x + n.x, b.y + n.y), Point(b.x - n.x, b.y - n.y),
+                    Point(a.x - n.x, a.y - n.y)},
+                   edges);
+    }
+
+    size_t firstJoin = contour.closed ? 0 : 1;
+    size_t lastJoin = contour.closed ? count : count - 1;
+    for (size_t i = firstJoin; i < lastJoin; ++i) {
+        const Point& v = p[i];
+        Point d0 = direction((i + count - 1) % count, i);
+        Point d1 = direction(i, (i + 1) % count);
+        double cross = d0.x * d1.y - d0.y * d1.x;
+        double dot = d0.x * d1.x + d0.y * d1.y;
+        if (std::abs(cross) < 1e-9 && dot > 0) continue;
+
+        if (paint.lineJoin() == LineJoin::Round) {
+            addCircle(v, halfWidth, tolerance, edges);
+            continue;
+        }
+
+        // The outer corner is on the side away from the turn
+        double side = cross > 0 ? -1 : 1;
+        Point n0 = normal(d0);
+        Point n1 = normal(d1);
+        Point a(v.x + side * n0.x, v.y + side * n0.y);
+        Point b(v.x + side * n1.x, v.y + side * n1.y);
+        double miter = 1 / std::sqrt(std::max(1e-12, (1 + dot) / 2));
+        if (paint.lineJoin() == LineJoin::Miter && miter <= paint.miterLimit()) {
+            Point bisector(n0.x + n1.x, n0.y + n1.y);
+            double len = length(bisector);
+            Point tip(v.x + side * bisector.x / len * halfWidth * miter, v.y + side * bisector.y / len * halfWidth * miter);
+            addPolygon({v, a, tip, b}, edges);
+        } else {
+            addPolygon({v, a, b}, edges);
+        }
+    }
+
+    if (contour.closed) return;
+
+    for (int end = 0; end < 2; ++end) {
+        const Point& v = end == 0 ? p[0] : p[count - 1];
+        // Outward from the contour
+        Point d = end == 0 ? direction(1, 0) : direction(count - 2, count - 1);
+        if (paint.lineCap() == LineCap::Round) {
+            addCircle(v, halfWidth, tolerance, edges);
+        } else if (paint.lineCap() == LineCap::Square) {
+            Point n = normal(d);
+            Point out(v.x + d.x * halfWidth, v.y + d.y * halfWidth);
+            addPolygon({Point(v.x + n.x, v.y + n.y), Point(out.x + n.x, out.y + n.y), Point(out.x - n.x, out.y - n.y),
+                        Point(v.x - n.x, v.y - n.y)},
+                       edges);
+        }
+    }
+}
+
+} // namespace
+
+size_t PathCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<uint32_t>()(key.path);
+    auto mix = [&](size_t value) { hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2); };
+    mix(std::hash<int>()(key.bucket));
+    mix(static_cast<size_t>(key.style) | static_cast<size_t>(key.cap) << 4 | static_cast<size_t>(key.join) << 8);
+    mix(std::hash<double>()(key.strokeWidth));
+    mix(std::hash<double>()(key.miterLimit));
+    return hash;
+}
+
+// PathCache implementation
+PathCache::PathCache(size_t budgetBytes)
+    : cache_(budgetBytes) {
+}
+
+std::shared_ptr<PathCache> PathCache::shared() {
+    static std::shared_ptr<PathCache> cache = std::make_shared<PathCache>();
+    return cache;
+}
+
+std::shared_ptr<const PathGeometry> PathCache::get(const Path& path, const Paint& paint, double scale) {
+    if (path.is_empty()) return nullptr;
+
+    int bucket = scaleBucket(scale);
+    bool stroked = paint.style() != PaintStyle::Fill;
+    // Stroke parameters only tell fills apart when they are stroked
+    Key key{path.generation_id(),
+            bucket,
+            paint.style(),
+            stroked ? paint.lineCap() : LineCap::Butt,
+            stroked ? paint.lineJoin() : LineJoin::Miter,
+            stroked ? paint.strokeWidth() : 0,
+            stroked && paint.lineJoin() == LineJoin::Miter ? paint.miterLimit() : 0};
+
+    // Built unlocked; a racing thread may build the same geometry
+    return cache_.get(key, [&] { return build(path, paint, kTolerance / std::pow(2.0, bucket / 2.0)); });
+}
+
+int PathCache::scaleBucket(double scale) {
+    scale = std::clamp(scale, 1.0 / 1024, 1024.0);
+    return static_cast<int>(std::ceil(std::log2(scale) * 2 - 1e-9));
+}
+
+std::shared_ptr<PathGeometry> PathCache::build(const Path& path, const Paint& paint, double tolerance) {
+    auto geometry = std::make_shared<PathGeometry>();
+    std::vector<Contour> contours = flatten(path, tolerance);
+
+    if (paint.style() != PaintStyle::Stroke) {
+        for (const Contour& contour : contours) {
+            const std::vector<Point>& p = contour.points;
+            if (p.size() < 2) continue;
+            // Fills close every contour
+            for (size_t i = 0; i < p.size(); ++i) {
+                geometry->fill.push_back(PathEdge{p[i], p[(i + 1) % p.size()]});
+            }
+        }
+    }
+
+    if (paint.style() != PaintStyle::Fill) {
+        // Zero-width strokes are hairlines at the bucket's scale
+        double halfWidth = paint.strokeWidth() > 0 ? paint.strokeWidth() / 2 : tolerance * 2;
+        for (const Contour& contour : contours) {
+            addStroke(contour, paint, halfWidth, tolerance, geometry->stroke);
+        }
+    }
+
+    bool first = true;
+    double left = 0, top = 0, right = 0, bottom = 0;
+    for (const auto* edges : {&geometry->fill, &geometry->stroke}) {
+        for (const PathEdge& edge : *edges) {
+            for (const Point& point : {edge.from, edge.to}) {
+                left = first ? point.x : std::min(left, point.x);
+                top = first ? point.y : std::min(top, point.y);
+                right = first ? point.x : std::max(right, point.x);
+                bottom = first ? point.y : std::max(bottom, point.y);
+                first = false;
+            }
+        }
+    }
+    geometry->bounds = Rect(left, top, right - left, bottom - top);
+    return geometry;
+}
+
+} // namespace renderer
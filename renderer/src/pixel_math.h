@@ -0,0 +1,26 @@
+#pragma once
+
+#include "renderer/types.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Pixel arithmetic shared by the rasterizers; internal to the renderer
+namespace renderer {
+
+// value / 255 rounded, exact for value up to 255 * 255
+inline uint8_t div255(unsigned value) {
+    value += 128;
+    return static_cast<uint8_t>((value + (value >> 8)) >> 8);
+}
+
+// color with its alpha scaled by alpha, as premultiplied RGBA
+inline void premultiply(const Color& color, double alpha, uint8_t out[4]) {
+    unsigned a = static_cast<unsigned>(std::lround(std::clamp(alpha, 0.0, 1.0) * color.a));
+    out[0] = div255(color.r * a);
+    out[1] = div255(color.g * a);
+    out[2] = div255(color.b * a);
+    out[3] = static_cast<uint8_t>(a);
+}
+
+} // namespace renderer
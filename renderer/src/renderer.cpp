@@ -1,4 +1,11 @@
 #include "renderer/renderer.h"
+#include "renderer/backend.h"
+#include "renderer/compositor.h"
+#include "renderer/display_list.h"
+#include "renderer/glyph_cache.h"
+#include "renderer/layer.h"
+#include "renderer/software.h"
+#include "renderer/swap_chain.h"
 #include <algorithm>
 #include <cmath>
 
@@ -16,7 +23,10 @@ Renderer::Renderer()
     , currentClip_(Rect())
     , isDirty_(false)
     , isValid_(false)
-    , isReady_(false) {
+    , isReady_(false)
+    , damage_()
+    , presented_()
+    , recorder_() {
     initialize();
 }
 
@@ -31,7 +41,10 @@ Renderer::Renderer(std::shared_ptr<Backend> backend)
     , currentClip_(Rect())
     , isDirty_(false)
     , isValid_(false)
-    , isReady_(false) {
+    , isReady_(false)
+    , damage_()
+    , presented_()
+    , recorder_(backend_ ? std::make_unique<DisplayListRecorder>() : nullptr) {
     initialize();
 }
 
@@ -97,12 +110,34 @@ std::unique_ptr<Paint> Renderer::createPaint(const Paint& paint) {
     return std::make_unique<Paint>(paint);
 }
 
+std::unique_ptr<Layer> Renderer::createLayer() {
+    return std::make_unique<Layer>();
+}
+
+std::unique_ptr<Layer> Renderer::createLayer(const Size& size) {
+    return std::make_unique<Layer>(size);
+}
+
+std::unique_ptr<Layer> Renderer::createLayer(int width, int height) {
+    return createLayer(Size(width, height));
+}
+
+std::unique_ptr<Compositor> Renderer::createCompositor() {
+    return std::make_unique<Compositor>(static_cast<int>(width()), static_cast<int>(height()));
+}
+
+std::unique_ptr<Compositor> Renderer::createCompositor(CompositorType /*type*/) {
+    // Layers are rasterized and composited in software whatever the type
+    return createCompositor();
+}
+
 void Renderer::render(Canvas* canvas) {
     if (!canvas || !isValid_) return;
     
     // Render canvas to surface
     // This is a simplified implementation
     // In a real implementation, this would handle the actual rendering
+    addFullDamage();
     isDirty_ = true;
 }
 
@@ -112,6 +147,7 @@ void Renderer::render(Canvas* canvas, const Rect& bounds) {
     // Render canvas to surface with bounds
     // This is a simplified implementation
     // In a real implementation, this would handle the actual rendering
+    damage_.add(bounds);
     isDirty_ = true;
 }
 
@@ -121,6 +157,8 @@ void Renderer::clear() {
     // Clear surface
     // This is a simplified implementation
     // In a real implementation, this would clear the surface
+    if (recorder_) recorder_->clear(nullptr, Color(0, 0, 0, 0));
+    addFullDamage();
     isDirty_ = true;
 }
 
@@ -130,6 +168,8 @@ void Renderer::clear(const Color& color) {
     // Clear surface with color
     // This is a simplified implementation
     // In a real implementation, this would clear the surface with color
+    if (recorder_) recorder_->clear(nullptr, color);
+    addFullDamage();
     isDirty_ = true;
 }
 
@@ -139,6 +179,8 @@ void Renderer::clear(const Rect& rect) {
     // Clear surface rectangle
     // This is a simplified implementation
     // In a real implementation, this would clear the surface rectangle
+    if (recorder_) recorder_->clear(&rect, Color(0, 0, 0, 0));
+    addDamage(rect);
     isDirty_ = true;
 }
 
@@ -148,24 +190,31 @@ void Renderer::clear(const Rect& rect, const Color& color) {
     // Clear surface rectangle with color
     // This is a simplified implementation
     // In a real implementation, this would clear the surface rectangle with color
+    if (recorder_) recorder_->clear(&rect, color);
+    addDamage(rect);
     isDirty_ = true;
 }
 
 void Renderer::flush() {
     if (!surface_) return;
     
-    // Flush surface
-    // This is a simplified implementation
-    // In a real implementation, this would flush the surface
+    // The backend draws what was recorded since the last flush
+    if (backend_) {
+        submitRecording();
+        backend_->flush();
+    }
+    present();
     isDirty_ = false;
 }
 
 void Renderer::finish() {
     if (!surface_) return;
     
-    // Finish surface
-    // This is a simplified implementation
-    // In a real implementation, this would finish the surface
+    if (backend_) {
+        submitRecording();
+        backend_->finish();
+    }
+    present();
     isDirty_ = false;
 }
 
@@ -190,6 +239,7 @@ void Renderer::wait() {
 void Renderer::save() {
     stateStack_.push_back(currentState_);
     pushState();
+    if (recorder_) recorder_->save();
 }
 
 void Renderer::restore() {
@@ -197,14 +247,27 @@ void Renderer::restore() {
         currentState_ = stateStack_.back();
         stateStack_.pop_back();
         applyState(currentState_);
+        if (recorder_) {
+            recorder_->restore();
+            recorder_->setState(currentMatrix_, currentClip_);
+        }
     }
 }
 
 void Renderer::reset() {
+    if (recorder_) {
+        for (size_t i = 0; i < stateStack_.size(); ++i) {
+            recorder_->restore();
+        }
+        recorder_->setMatrix(Matrix::identity());
+        recorder_->setState(Matrix::identity(), Rect());
+    }
     stateStack_.clear();
     currentState_ = RendererState();
     currentMatrix_ = Matrix::identity();
     currentClip_ = Rect();
+    damage_.clear();
+    presented_.clear();
     isDirty_ = false;
     isValid_ = true;
     isReady_ = true;
@@ -235,11 +298,14 @@ Matrix Renderer::getMatrix() const {
 }
 
 void Renderer::clipRect(const Rect& rect) {
+    // The clip is kept in device space, like the damage it bounds
+    Rect deviceRect = currentMatrix_.transform(rect);
     if (currentClip_.isEmpty()) {
-        currentClip_ = rect;
+        currentClip_ = deviceRect;
     } else {
-        currentClip_ = currentClip_.intersection(rect);
+        currentClip_ = currentClip_.intersection(deviceRect);
     }
+    if (recorder_) recorder_->clipRect(rect);
     updateClip();
 }
 
@@ -263,6 +329,8 @@ void Renderer::drawColor(const Color& color) {
     // Draw color to surface
     // This is a simplified implementation
     // In a real implementation, this would draw color to surface
+    if (recorder_) recorder_->drawColor(color, BlendMode::Normal);
+    addFullDamage();
     isDirty_ = true;
 }
 
@@ -272,6 +340,8 @@ void Renderer::drawPaint(const Paint& paint) {
     // Draw paint to surface
     // This is a simplified implementation
     // In a real implementation, this would draw paint to surface
+    if (recorder_) recorder_->drawPaint(paint);
+    addFullDamage();
     isDirty_ = true;
 }
 
@@ -281,6 +351,8 @@ void Renderer::drawRect(const Rect& rect, const Paint& paint) {
     // Draw rectangle to surface
     // This is a simplified implementation
     // In a real implementation, this would draw rectangle to surface
+    if (recorder_) recorder_->drawRect(rect, paint);
+    addDamage(rect, paint);
     isDirty_ = true;
 }
 
@@ -290,6 +362,9 @@ void Renderer::drawCircle(const Point& center, double radius, const Paint& paint
     // Draw circle to surface
     // This is a simplified implementation
     // In a real implementation, this would draw circle to surface
+    Rect oval(center.x - radius, center.y - radius, radius * 2, radius * 2);
+    if (recorder_) recorder_->drawOval(oval, paint);
+    addDamage(oval, paint);
     isDirty_ = true;
 }
 
@@ -299,6 +374,9 @@ void Renderer::drawPath(const Path& path, const Paint& paint) {
     // Draw path to surface
     // This is a simplified implementation
     // In a real implementation, this would draw path to surface
+    if (path.is_empty()) return;
+    if (recorder_) recorder_->drawPath(path, paint);
+    addDamage(path.get_bounds(), paint);
     isDirty_ = true;
 }
 
@@ -308,6 +386,9 @@ void Renderer::drawImage(const Image& image, const Point& point) {
     // Draw image to surface
     // This is a simplified implementation
     // In a real implementation, this would draw image to surface
+    Rect dest(point.x, point.y, image.get_width(), image.get_height());
+    if (recorder_) recorder_->drawImage(image, Rect(0, 0, dest.width(), dest.height()), dest, Paint());
+    addDamage(dest);
     isDirty_ = true;
 }
 
@@ -317,13 +398,15 @@ void Renderer::drawText(const std::string& text, const Point& point, const Paint
     // Draw text to surface
     // This is a simplified implementation
     // In a real implementation, this would draw text to surface
+    // point is on the baseline
+    Rect extent = GlyphCache::shared().bounds(text, GlyphCache::fontFor(paint), point);
+    if (recorder_) recorder_->drawText(text, point, paint, extent, nullptr);
+    addDamage(extent, paint);
     isDirty_ = true;
 }
 
 Size Renderer::measureText(const std::string& text, const Paint& paint) const {
-    // This is a simplified implementation
-    // In a real implementation, this would measure text
-    return Size(text.length() * 10, 20); // Approximate size
+    return GlyphCache::shared().measure(text, GlyphCache::fontFor(paint));
 }
 
 Rect Renderer::getTextBounds(const std::string& text, const Paint& paint) const {
@@ -334,11 +417,43 @@ Rect Renderer::getTextBounds(const std::string& text, const Paint& paint) const
 }
 
 void Renderer::invalidate() {
+    damage_.add(bounds());
     isDirty_ = true;
     isValid_ = false;
 }
 
+void Renderer::invalidate(const Rect& rect) {
+    Rect surface = bounds();
+    damage_.add(surface.isEmpty() ? rect : rect.intersection(surface));
+    isDirty_ = true;
+}
+
+size_t Renderer::repaint(const DisplayList& list, SoftwareRasterizer& rasterizer) {
+    for (const auto& rect : damage_.rects()) {
+        rasterizer.invalidate(rect);
+    }
+    return rasterizer.rasterize(list);
+}
+
+size_t Renderer::repaint(const DisplayList& list, SoftwareRasterizer& rasterizer, SwapChain& chain) {
+    SwapChain::Frame frame;
+    if (!chain.acquire(frame)) return 0;
+
+    // A buffer drawn before holds every tile but those the frames since
+    // then changed
+    rasterizer.setTarget(frame.buffer, frame.age > 0);
+    rasterizer.invalidate(frame.damage);
+    frame.buffer->beginAccess(true);
+    size_t tiles = repaint(list, rasterizer);
+    frame.buffer->endAccess(true);
+
+    chain.present(frame, damage_.bounds());
+    present();
+    return tiles;
+}
+
 void Renderer::validate() {
+    damage_.clear();
     isDirty_ = false;
     isValid_ = true;
     isReady_ = true;
@@ -353,7 +468,7 @@ bool Renderer::isReady() const {
 }
 
 bool Renderer::isDirty() const {
-    return isDirty_;
+    return isDirty_ || !damage_.isEmpty();
 }
 
 Size Renderer::size() const {
@@ -439,6 +554,11 @@ void Renderer::copyFrom(const Renderer& other) {
     isDirty_ = other.isDirty_;
     isValid_ = other.isValid_;
     isReady_ = other.isReady_;
+    damage_ = other.damage_;
+    presented_ = other.presented_;
+    // A copy records from here on, into a list of its own
+    recorder_ = backend_ ? std::make_unique<DisplayListRecorder>() : nullptr;
+    if (recorder_) beginRecording();
 }
 
 void Renderer::moveFrom(Renderer&& other) {
@@ -453,10 +573,14 @@ void Renderer::moveFrom(Renderer&& other) {
     isDirty_ = other.isDirty_;
     isValid_ = other.isValid_;
     isReady_ = other.isReady_;
+    damage_ = std::move(other.damage_);
+    presented_ = std::move(other.presented_);
+    recorder_ = std::move(other.recorder_);
 }
 
 void Renderer::cleanup() {
     backend_.reset();
+    recorder_.reset();
     device_.reset();
     context_.reset();
     surface_.reset();
@@ -464,6 +588,8 @@ void Renderer::cleanup() {
     currentState_ = RendererState();
     currentMatrix_ = Matrix::identity();
     currentClip_ = Rect();
+    damage_.clear();
+    presented_.clear();
     isDirty_ = false;
     isValid_ = false;
     isReady_ = false;
@@ -529,14 +655,24 @@ void Renderer::applyState(const RendererState& state) {
 
 void Renderer::updateMatrix() {
     updateState();
+    if (recorder_) {
+        recorder_->setMatrix(currentMatrix_);
+        recorder_->setState(currentMatrix_, currentClip_);
+    }
 }
 
 void Renderer::updateClip() {
     updateState();
+    if (recorder_) recorder_->setState(currentMatrix_, currentClip_);
 }
 
 void Renderer::updateBackend() {
+    // Draws are recorded only for a backend to replay
+    recorder_ = backend_ ? std::make_unique<DisplayListRecorder>() : nullptr;
     if (backend_) {
+        beginRecording();
+        Rect surface = bounds();
+        backend_->resize(static_cast<int>(surface.width()), static_cast<int>(surface.height()));
         updateState();
     }
 }
@@ -554,9 +690,76 @@ void Renderer::updateContext() {
 }
 
 void Renderer::updateSurface() {
+    if (backend_) {
+        Rect surface = bounds();
+        backend_->resize(static_cast<int>(surface.width()), static_cast<int>(surface.height()));
+    }
     if (surface_) {
         updateState();
     }
 }
 
+void Renderer::addDamage(const Rect& rect) {
+    Rect device = currentMatrix_.transform(rect);
+    if (!currentClip_.isEmpty()) {
+        device = device.intersection(currentClip_);
+    }
+    Rect surface = bounds();
+    if (!surface.isEmpty()) {
+        device = device.intersection(surface);
+    }
+    damage_.add(device);
+}
+
+void Renderer::addDamage(const Rect& rect, const Paint& paint) {
+    if (paint.style() == PaintStyle::Fill) {
+        addDamage(rect);
+        return;
+    }
+    double outset = paint.strokeWidth() / 2;
+    addDamage(Rect(rect.x() - outset, rect.y() - outset, rect.width() + 2 * outset, rect.height() + 2 * outset));
+}
+
+void Renderer::addFullDamage() {
+    Rect area = currentClip_.isEmpty() ? bounds() : currentClip_;
+    Rect surface = bounds();
+    if (!surface.isEmpty()) {
+        area = area.intersection(surface);
+    }
+    damage_.add(area);
+}
+
+void Renderer::submitRecording() {
+    std::shared_ptr<const DisplayList> list = recorder_->finish();
+    if (!list->empty()) {
+        backend_->draw(std::move(list));
+    }
+    beginRecording();
+}
+
+// A list starts unclipped at identity: the saved states are replayed so
+// later restores unwind to them, then the current one is set
+void Renderer::beginRecording() {
+    auto record = [this](const Matrix& matrix, const Rect& clip) {
+        if (!clip.isEmpty()) {
+            recorder_->setMatrix(Matrix::identity());
+            recorder_->setState(Matrix::identity(), Rect());
+            recorder_->clipRect(clip);
+        }
+        recorder_->setMatrix(matrix);
+        recorder_->setState(matrix, clip);
+    };
+    for (const RendererState& state : stateStack_) {
+        record(state.matrix, state.clip);
+        recorder_->save();
+    }
+    record(currentMatrix_, currentClip_);
+}
+
+void Renderer::present() {
+    // The surface takes the damaged rects; the rest of it is unchanged
+    presented_ = damage_;
+    damage_.clear();
+}
+
 } // namespace renderer
@@ -0,0 +1,81 @@
+#include "scanline.h"
+#include <algorithm>
+#include <cmath>
+
+namespace renderer {
+
+namespace {
+
+// Adds weight times the part of [from, to) over each pixel of a row
+void addSpan(std::vector<float>& row, int left, double from, double to, float weight) {
+    from = std::max(from, static_cast<double>(left));
+    to = std::min(to, static_cast<double>(left + static_cast<int>(row.size())));
+    if (from >= to) return;
+
+    int first = static_cast<int>(std::floor(from));
+    int last = static_cast<int>(std::floor(to));
+    if (first == last) {
+        row[first - left] += static_cast<float>((to - from) * weight);
+        return;
+    }
+    row[first - left] += static_cast<float>((first + 1 - from) * weight);
+    for (int x = first + 1; x < last; ++x) {
+        row[x - left] += weight;
+    }
+    if (last - left < static_cast<int>(row.size())) {
+        row[last - left] += static_cast<float>((to - last) * weight);
+    }
+}
+
+} // namespace
+
+// EdgeCoverage implementation
+EdgeCoverage::EdgeCoverage(const DeviceEdge* edges, size_t count, FillRule rule, bool antiAlias)
+    : edges_(edges)
+    , count_(count)
+    , rule_(rule)
+    , antiAlias_(antiAlias)
+    , next_(0) {
+}
+
+const std::vector<float>& EdgeCoverage::row(int y, int left, int width) {
+    row_.assign(width, 0.0f);
+    int samples = antiAlias_ ? 4 : 1;
+    float weight = 1.0f / samples;
+    for (int sample = 0; sample < samples; ++sample) {
+        double sy = y + (sample + 0.5) / samples;
+        // Edges are sorted by top: take on those that start above, drop
+        // those that ended
+        while (next_ < count_ && edges_[next_].y0 <= sy) {
+            active_.push_back(&edges_[next_++]);
+        }
+        active_.erase(std::remove_if(active_.begin(), active_.end(),
+                                     [&](const DeviceEdge* edge) { return edge->y1 <= sy; }),
+                      active_.end());
+
+        crossings_.clear();
+        for (const DeviceEdge* edge : active_) {
+            crossings_.emplace_back(edge->x0 + (sy - edge->y0) * edge->dxdy, edge->winding);
+        }
+        std::sort(crossings_.begin(), crossings_.end());
+
+        int winding = 0;
+        for (size_t i = 0; i + 1 < crossings_.size(); ++i) {
+            winding += crossings_[i].second;
+            bool inside = rule_ == FillRule::NonZero ? winding != 0 : (winding & 1) != 0;
+            if (!inside) continue;
+
+            double from = crossings_[i].first;
+            double to = crossings_[i + 1].first;
+            if (!antiAlias_) {
+                // Whole pixels whose centers are inside
+                from = std::ceil(from - 0.5);
+                to = std::ceil(to - 0.5);
+            }
+            addSpan(row_, left, from, to, weight);
+        }
+    }
+    return row_;
+}
+
+} // namespace renderer
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "renderer/enums.h"
+#include "renderer/path_cache.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Scanline coverage of device edges, shared by the software rasterizer and
+// clip masks; internal to the renderer
+namespace renderer {
+
+// Appends the edge from, to unless it is horizontal and so crosses no
+// scanline
+inline void appendDeviceEdge(std::vector<DeviceEdge>& edges, Point from, Point to) {
+    if (from.y == to.y) return;
+
+    int winding = from.y < to.y ? 1 : -1;
+    if (winding < 0) std::swap(from, to);
+    edges.push_back(DeviceEdge{from.x, from.y, to.y, (to.x - from.x) / (to.y - from.y), winding});
+}
+
+// Coverage of the rows of a polygon filled with rule, given its edges
+// sorted by top. Rows are asked for top to bottom; each sums the spans
+// inside the polygon on four subscanlines with antiAlias, otherwise on one
+// through the pixel centers, covering whole pixels whose centers are in.
+class EdgeCoverage {
+public:
+    EdgeCoverage(const DeviceEdge* edges, size_t count, FillRule rule, bool antiAlias);
+
+    // Coverage of pixels left up to left + width on row y, 0 to 1 each
+    const std::vector<float>& row(int y, int left, int width);
+
+private:
+    const DeviceEdge* edges_;
+    size_t count_;
+    FillRule rule_;
+    bool antiAlias_;
+    size_t next_;
+    std::vector<const DeviceEdge*> active_;
+    std::vector<std::pair<double, int>> crossings_;
+    std::vector<float> row_;
+};
+
+} // namespace renderer
@@ -0,0 +1,118 @@
+#include "renderer/shadow_cache.h"
+#include "renderer/blur.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace renderer {
+
+namespace {
+
+// Radii and sigma are keyed in quarter pixels
+constexpr double kQuantum = 4.0;
+
+// Smallest shape size whose middle row or column is past both corners and
+// the blur's reach from both edges
+int stretchSize(double radius, int outset) {
+    return 2 * (static_cast<int>(std::ceil(radius)) + outset) + 1;
+}
+
+// Signed distance to a shape centered on the origin, negative inside;
+// corners use the smaller radius, as the rasterizer draws them
+double shapeDistance(ShadowShape shape, double x, double y, double halfWidth, double halfHeight, double rx,
+                     double ry) {
+    if (shape == ShadowShape::Oval) {
+        if (halfWidth <= 0 || halfHeight <= 0) return 1;
+        double f = x * x / (halfWidth * halfWidth) + y * y / (halfHeight * halfHeight) - 1;
+        double gx = x / (halfWidth * halfWidth);
+        double gy = y / (halfHeight * halfHeight);
+        double gradient = 2 * std::sqrt(gx * gx + gy * gy);
+        return gradient > 0 ? f / gradient : -std::min(halfWidth, halfHeight);
+    }
+    double radius = shape == ShadowShape::RoundRect ? std::min({rx, ry, halfWidth, halfHeight}) : 0;
+    double qx = std::abs(x) - (halfWidth - radius);
+    double qy = std::abs(y) - (halfHeight - radius);
+    double outside = std::hypot(std::max(qx, 0.0), std::max(qy, 0.0));
+    return outside + std::min(std::max(qx, qy), 0.0) - radius;
+}
+
+} // namespace
+
+size_t ShadowCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<int>()(static_cast<int>(key.shape));
+    auto mix = [&](int value) { hash ^= std::hash<int>()(value) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2); };
+    mix(key.width);
+    mix(key.height);
+    mix(key.radiusX);
+    mix(key.radiusY);
+    mix(key.sigma);
+    return hash;
+}
+
+// ShadowCache implementation
+ShadowCache::ShadowCache(size_t budgetBytes)
+    : cache_(budgetBytes) {
+}
+
+std::shared_ptr<ShadowCache> ShadowCache::shared() {
+    static std::shared_ptr<ShadowCache> cache = std::make_shared<ShadowCache>();
+    return cache;
+}
+
+std::shared_ptr<const ShadowMask> ShadowCache::get(ShadowShape shape, int width, int height, double rx, double ry,
+                                                   double sigma) {
+    if (width <= 0 || height <= 0) return nullptr;
+
+    if (shape == ShadowShape::Rect) {
+        rx = ry = 0;
+    }
+    int radiusX = static_cast<int>(std::lround(std::clamp(rx, 0.0, width / 2.0) * kQuantum));
+    int radiusY = static_cast<int>(std::lround(std::clamp(ry, 0.0, height / 2.0) * kQuantum));
+    int quantizedSigma = static_cast<int>(std::lround(std::max(sigma, 0.0) * kQuantum));
+
+    // Larger rects stretch the mask of the smallest one that looks the same
+    if (shape != ShadowShape::Oval) {
+        int outset = blurOutset(quantizedSigma / kQuantum);
+        width = std::min(width, stretchSize(radiusX / kQuantum, outset));
+        height = std::min(height, stretchSize(radiusY / kQuantum, outset));
+    }
+    Key key{shape, width, height, radiusX, radiusY, quantizedSigma};
+
+    // Blurred unlocked; a racing thread may blur the same mask
+    return cache_.get(key, [&] { return build(key); });
+}
+
+std::shared_ptr<ShadowMask> ShadowCache::build(const Key& key) {
+    double sigma = key.sigma / kQuantum;
+    double rx = key.radiusX / kQuantum;
+    double ry = key.radiusY / kQuantum;
+    int outset = blurOutset(sigma);
+
+    auto mask = std::make_shared<ShadowMask>();
+    mask->width = key.width + outset * 2;
+    mask->height = key.height + outset * 2;
+    mask->outset = outset;
+    mask->coverage.resize(static_cast<size_t>(mask->width) * mask->height);
+
+    // Antialiased coverage at pixel centers, then the blur
+    double halfWidth = key.width / 2.0;
+    double halfHeight = key.height / 2.0;
+    for (int y = 0; y < mask->height; ++y) {
+        double py = y + 0.5 - outset - halfHeight;
+        for (int x = 0; x < mask->width; ++x) {
+            double px = x + 0.5 - outset - halfWidth;
+            double d = shapeDistance(key.shape, px, py, halfWidth, halfHeight, rx, ry);
+            mask->coverage[static_cast<size_t>(y) * mask->width + x] =
+                static_cast<uint8_t>(std::lround(std::clamp(0.5 - d, 0.0, 1.0) * 255));
+        }
+    }
+    blurMask(mask->coverage.data(), mask->width, mask->height, mask->width, sigma);
+
+    if (key.shape != ShadowShape::Oval) {
+        if (key.width == stretchSize(rx, outset)) mask->stretchX = outset + key.width / 2;
+        if (key.height == stretchSize(ry, outset)) mask->stretchY = outset + key.height / 2;
+    }
+    return mask;
+}
+
+} // namespace renderer
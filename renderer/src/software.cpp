@@ -0,0 +1,1059 @@
+#include "renderer/software.h"
+#include "renderer/blend.h"
+#include "renderer/paint.h"
+#include "pixel_math.h"
+#include "scanline.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace renderer {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kOutside = std::numeric_limits<double>::max();
+
+// Signed distances to shapes in local units, negative inside
+double boxDistance(const Point& p, const Point& center, double halfWidth, double halfHeight) {
+    double qx = std::abs(p.x - center.x) - halfWidth;
+    double qy = std::abs(p.y - center.y) - halfHeight;
+    double outside = std::hypot(std::max(qx, 0.0), std::max(qy, 0.0));
+    return outside + std::min(std::max(qx, qy), 0.0);
+}
+
+double rectDistance(const Point& p, const Rect& rect) {
+    return boxDistance(p, rect.center(), rect.width() / 2, rect.height() / 2);
+}
+
+// Corners use the smaller radius, so elliptical corners come out circular
+double roundRectDistance(const Point& p, const Rect& rect, double rx, double ry) {
+    double radius = std::max(0.0, std::min({rx, ry, rect.width() / 2, rect.height() / 2}));
+    return boxDistance(p, rect.center(), rect.width() / 2 - radius, rect.height() / 2 - radius) - radius;
+}
+
+// First-order distance to an ellipse: its implicit function over the
+// length of its gradient
+double ellipseDistance(const Point& p, const Rect& rect) {
+    double a = rect.width() / 2;
+    double b = rect.height() / 2;
+    if (a <= 0 || b <= 0) return kOutside;
+
+    Point center = rect.center();
+    double x = p.x - center.x;
+    double y = p.y - center.y;
+    double f = x * x / (a * a) + y * y / (b * b) - 1;
+    double gx = x / (a * a);
+    double gy = y / (b * b);
+    double gradient = 2 * std::sqrt(gx * gx + gy * gy);
+    return gradient > 0 ? f / gradient : -std::min(a, b);
+}
+
+double lineDistance(const Point& p, const Point& start, const Point& end, double halfWidth, LineCap cap) {
+    double dx = end.x - start.x;
+    double dy = end.y - start.y;
+    double length = std::hypot(dx, dy);
+    double px = p.x - start.x;
+    double py = p.y - start.y;
+    if (length == 0) {
+        if (cap == LineCap::Round) return std::hypot(px, py) - halfWidth;
+        if (cap == LineCap::Square) return boxDistance(p, start, halfWidth, halfWidth);
+        return kOutside;
+    }
+
+    // Along and across the segment
+    double u = (px * dx + py * dy) / length;
+    double v = (py * dx - px * dy) / length;
+    if (cap == LineCap::Round) {
+        double along = u - std::clamp(u, 0.0, length);
+        return std::hypot(along, v) - halfWidth;
+    }
+    double extend = cap == LineCap::Square ? halfWidth : 0;
+    return boxDistance(Point(u, v), Point(length / 2, 0), length / 2 + extend, halfWidth);
+}
+
+// Whether p lies within the arc's sweep, both in degrees
+bool withinSweep(const Point& p, const Rect& rect, double startAngle, double sweepAngle) {
+    if (std::abs(sweepAngle) >= 360) return true;
+    if (sweepAngle < 0) {
+        startAngle += sweepAngle;
+        sweepAngle = -sweepAngle;
+    }
+    Point center = rect.center();
+    double a = std::max(rect.width() / 2, 1e-9);
+    double b = std::max(rect.height() / 2, 1e-9);
+    double angle = std::atan2((p.y - center.y) / b, (p.x - center.x) / a) * 180 / kPi;
+    double offset = std::fmod(angle - startAngle, 360.0);
+    if (offset < 0) offset += 360;
+    return offset <= sweepAngle;
+}
+
+// Distance to what paint covers of a shape with the given fill distance
+double styledDistance(double fill, const Paint& paint, double halfStroke) {
+    if (fill == kOutside) return kOutside;
+    double stroke = std::abs(fill) - halfStroke;
+    switch (paint.style()) {
+        case PaintStyle::Fill:
+            return fill;
+        case PaintStyle::Stroke:
+            return stroke;
+        case PaintStyle::FillAndStroke:
+            return std::min(fill, stroke);
+    }
+    return fill;
+}
+
+// Paths drawn by distance like the draw of their shape
+bool isShape(const Path& path) {
+    return path.is_rect() || path.is_oval() || path.is_round_rect();
+}
+
+// The shape a draw covers, for draws of one rect, round rect or oval
+bool shapeOf(const DisplayList& list, const DisplayItem& item, ShadowShape& shape, Rect& rect, double& rx,
+             double& ry) {
+    const double* args = list.args().data() + item.args;
+    switch (item.op) {
+        case DisplayOp::DrawRect:
+            shape = ShadowShape::Rect;
+            rect = Rect(args[0], args[1], args[2], args[3]);
+            return true;
+        case DisplayOp::DrawRoundRect:
+            shape = ShadowShape::RoundRect;
+            rect = Rect(args[0], args[1], args[2], args[3]);
+            rx = args[4];
+            ry = args[5];
+            return true;
+        case DisplayOp::DrawOval:
+            shape = ShadowShape::Oval;
+            rect = Rect(args[0], args[1], args[2], args[3]);
+            return true;
+        case DisplayOp::DrawPath: {
+            const Path& path = list.path(item.data);
+            if (path.is_rect(&rect)) {
+                shape = ShadowShape::Rect;
+            } else if (path.is_round_rect(&rect, &rx, &ry)) {
+                shape = ShadowShape::RoundRect;
+            } else if (path.is_oval(&rect)) {
+                shape = ShadowShape::Oval;
+            } else {
+                return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+// SoftwareRasterizer implementation
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, size_t threadCount)
+    : width_(0)
+    , height_(0)
+    , tilesWide_(0)
+    , tilesHigh_(0)
+    , pixels_()
+    , target_()
+    , targetPixels_(nullptr)
+    , stride_(0)
+    , dirty_()
+    , stats_()
+    , list_(nullptr)
+    , draws_()
+    , bins_()
+    , jobTiles_()
+    , nextTile_(0)
+    , glyphCache_(std::make_shared<GlyphCache>())
+    , glyphQuads_()
+    , pathCache_(PathCache::shared())
+    , pathEdges_()
+    , shadowCache_(ShadowCache::shared())
+    , shadows_()
+    , clipMaskCache_(ClipMaskCache::shared())
+    , clipMasks_()
+    , scaledImageCache_(ScaledImageCache::shared())
+    , images_()
+    , threads_()
+    , mutex_()
+    , wake_()
+    , done_()
+    , generation_(0)
+    , started_(0)
+    , busy_(0)
+    , stopRequested_(false) {
+    resize(width, height);
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads_.reserve(threadCount - 1);
+    for (size_t i = 1; i < threadCount; ++i) {
+        threads_.emplace_back(&SoftwareRasterizer::workerLoop, this);
+    }
+}
+
+SoftwareRasterizer::~SoftwareRasterizer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void SoftwareRasterizer::resize(int width, int height) {
+    width_ = std::max(0, width);
+    height_ = std::max(0, height);
+    tilesWide_ = (width_ + kTileSize - 1) / kTileSize;
+    tilesHigh_ = (height_ + kTileSize - 1) / kTileSize;
+    target_.reset();
+    pixels_.assign(static_cast<size_t>(width_) * height_ * 4, 0);
+    targetPixels_ = pixels_.data();
+    stride_ = static_cast<size_t>(width_) * 4;
+    dirty_.assign(static_cast<size_t>(tilesWide_) * tilesHigh_, 1);
+    bins_.assign(dirty_.size(), std::vector<uint32_t>());
+}
+
+void SoftwareRasterizer::setTarget(std::shared_ptr<FrameBuffer> buffer, bool keepTiles) {
+    if (!buffer) {
+        if (target_) resize(width_, height_);
+        return;
+    }
+    if (buffer->width() != width_ || buffer->height() != height_) {
+        resize(buffer->width(), buffer->height());
+        keepTiles = false;
+    }
+    // Rasterizing into the target, the rasterizer's own pixels go unused
+    pixels_.clear();
+    pixels_.shrink_to_fit();
+    targetPixels_ = buffer->pixels();
+    stride_ = static_cast<size_t>(buffer->stride());
+    target_ = std::move(buffer);
+    if (!keepTiles) invalidateAll();
+}
+
+Color SoftwareRasterizer::pixel(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width_ || y >= height_) return Color::transparent();
+
+    const uint8_t* p = pixelAt(x, y);
+    if (p[3] == 0) return Color::transparent();
+    auto unpremultiply = [&](uint8_t value) {
+        return static_cast<uint8_t>(std::min(255u, (value * 255u + p[3] / 2) / p[3]));
+    };
+    return Color(unpremultiply(p[0]), unpremultiply(p[1]), unpremultiply(p[2]), p[3]);
+}
+
+size_t SoftwareRasterizer::dirtyTileCount() const {
+    return static_cast<size_t>(std::count(dirty_.begin(), dirty_.end(), 1));
+}
+
+void SoftwareRasterizer::invalidate(const Rect& rect) {
+    if (rect.isEmpty() || dirty_.empty()) return;
+
+    int left = std::max(0, static_cast<int>(std::floor(rect.left())) / kTileSize);
+    int top = std::max(0, static_cast<int>(std::floor(rect.top())) / kTileSize);
+    int right = std::min(tilesWide_ - 1, static_cast<int>(std::ceil(rect.right()) - 1) / kTileSize);
+    int bottom = std::min(tilesHigh_ - 1, static_cast<int>(std::ceil(rect.bottom()) - 1) / kTileSize);
+    for (int ty = top; ty <= bottom; ++ty) {
+        for (int tx = left; tx <= right; ++tx) {
+            dirty_[ty * tilesWide_ + tx] = 1;
+        }
+    }
+}
+
+void SoftwareRasterizer::invalidateAll() {
+    std::fill(dirty_.begin(), dirty_.end(), 1);
+}
+
+void SoftwareRasterizer::setGlyphCache(std::shared_ptr<GlyphCache> cache) {
+    glyphCache_ = cache ? std::move(cache) : std::make_shared<GlyphCache>();
+}
+
+void SoftwareRasterizer::setShadowCache(std::shared_ptr<ShadowCache> cache) {
+    shadowCache_ = std::move(cache);
+}
+
+void SoftwareRasterizer::setClipMaskCache(std::shared_ptr<ClipMaskCache> cache) {
+    clipMaskCache_ = std::move(cache);
+}
+
+void SoftwareRasterizer::setScaledImageCache(std::shared_ptr<ScaledImageCache> cache) {
+    scaledImageCache_ = std::move(cache);
+}
+
+void SoftwareRasterizer::setPathCache(std::shared_ptr<PathCache> cache) {
+    pathCache_ = cache ? std::move(cache) : PathCache::shared();
+}
+
+size_t SoftwareRasterizer::rasterize(const DisplayList& list) {
+    stats_ = Stats();
+    jobTiles_.clear();
+    for (uint32_t tile = 0; tile < dirty_.size(); ++tile) {
+        if (dirty_[tile]) jobTiles_.push_back(tile);
+    }
+    if (jobTiles_.empty()) return 0;
+
+    list_ = &list;
+    // Glyphs laid out for this job stay in the atlas until it is done
+    glyphCache_->beginFrame();
+    resolve(list);
+    bin();
+    stats_.tiles = jobTiles_.size();
+    stats_.draws = draws_.size();
+    for (uint32_t tile : jobTiles_) {
+        stats_.binned += bins_[tile].size();
+    }
+
+    nextTile_.store(0, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+        started_ = 0;
+    }
+    wake_.notify_all();
+
+    // The calling thread works too. Every worker must have taken and left
+    // the job before the next one may reuse its state.
+    runTiles();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return started_ == threads_.size() && busy_ == 0; });
+    }
+
+    for (uint32_t tile : jobTiles_) {
+        dirty_[tile] = 0;
+        bins_[tile].clear();
+    }
+    list_ = nullptr;
+    return jobTiles_.size();
+}
+
+void SoftwareRasterizer::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopRequested_ || generation_ != seen; });
+            if (stopRequested_) return;
+            seen = generation_;
+            ++started_;
+            ++busy_;
+        }
+        runTiles();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --busy_;
+        }
+        done_.notify_all();
+    }
+}
+
+void SoftwareRasterizer::runTiles() {
+    while (true) {
+        size_t next = nextTile_.fetch_add(1, std::memory_order_relaxed);
+        if (next >= jobTiles_.size()) return;
+
+        rasterizeTile(jobTiles_[next]);
+    }
+}
+
+bool SoftwareRasterizer::rasterizes(DisplayOp op) {
+    switch (op) {
+        case DisplayOp::DrawColor:
+        case DisplayOp::DrawPaint:
+        case DisplayOp::DrawRect:
+        case DisplayOp::DrawRoundRect:
+        case DisplayOp::DrawOval:
+        case DisplayOp::DrawArc:
+        case DisplayOp::DrawPath:
+        case DisplayOp::DrawLine:
+        case DisplayOp::DrawPoints:
+        case DisplayOp::DrawText:
+        case DisplayOp::DrawTextBlob:
+        case DisplayOp::DrawImage:
+        case DisplayOp::Clear:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void SoftwareRasterizer::rasterizeTile(uint32_t tile) {
+    int left = static_cast<int>(tile % tilesWide_) * kTileSize;
+    int top = static_cast<int>(tile / tilesWide_) * kTileSize;
+    int right = std::min(width_, left + kTileSize);
+    int bottom = std::min(height_, top + kTileSize);
+    Rect tileRect(left, top, right - left, bottom - top);
+
+    // Dirty tiles are redrawn from scratch
+    for (int y = top; y < bottom; ++y) {
+        uint8_t* row = pixelAt(left, y);
+        std::fill(row, row + (right - left) * 4, 0);
+    }
+    for (uint32_t index : bins_[tile]) {
+        drawItem(draws_[index], tileRect);
+    }
+}
+
+// Replays the state operations once, so each tile only sees its draws
+void SoftwareRasterizer::resolve(const DisplayList& list) {
+    struct State {
+        Matrix matrix;
+        Rect clip;
+        uint32_t mask;
+        double alpha;
+    };
+
+    draws_.clear();
+    glyphQuads_.clear();
+    pathEdges_.clear();
+    shadows_.clear();
+    images_.clear();
+    clipMasks_.clear();
+    Rect surface(0, 0, width_, height_);
+    State state{Matrix::identity(), surface, kNoMask, 1.0};
+    std::vector<State> stack;
+
+    for (uint32_t i = 0; i < list.items().size(); ++i) {
+        const DisplayItem& item = list.items()[i];
+        const double* args = list.args().data() + item.args;
+        switch (item.op) {
+            case DisplayOp::Save:
+                stack.push_back(state);
+                break;
+            case DisplayOp::SaveLayer:
+                // Layers are flattened: their opacity scales the draws inside
+                stack.push_back(state);
+                state.alpha *= list.paint(item.paint).opacity() * list.paint(item.paint).color().a / 255.0;
+                break;
+            case DisplayOp::Restore:
+                if (!stack.empty()) {
+                    state = stack.back();
+                    stack.pop_back();
+                }
+                break;
+            case DisplayOp::SetMatrix:
+                state.matrix = Matrix(args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8]);
+                break;
+            case DisplayOp::ClipRect:
+            case DisplayOp::ClipPath:
+                state.mask = applyClip(list, item, state.matrix, state.clip, state.mask);
+                break;
+            default: {
+                if (!rasterizes(item.op)) break;
+                Rect bounds = item.unbounded ? state.clip : item.bounds.intersection(state.clip);
+                if (bounds.isEmpty() || state.alpha <= 0) break;
+
+                const Matrix& m = state.matrix;
+                double scale = std::sqrt(std::abs(m.m11 * m.m22 - m.m12 * m.m21));
+                scale = scale > 0 ? scale : 1;
+                uint32_t firstQuad = static_cast<uint32_t>(glyphQuads_.size());
+                uint32_t firstEdge = static_cast<uint32_t>(pathEdges_.size());
+                uint32_t fillEdges = 0;
+                uint32_t image = static_cast<uint32_t>(images_.size());
+                if (item.op == DisplayOp::DrawText || item.op == DisplayOp::DrawTextBlob) {
+                    // The glyphs are tighter than the recorded bounds
+                    bounds = layoutText(list, item, m, scale).intersection(state.clip);
+                    if (bounds.isEmpty()) {
+                        glyphQuads_.resize(firstQuad);
+                        break;
+                    }
+                } else if (item.op == DisplayOp::DrawPath && !isShape(list.path(item.data))) {
+                    bounds = tessellatePath(list, item, m, scale, fillEdges).intersection(state.clip);
+                    if (bounds.isEmpty()) {
+                        pathEdges_.resize(firstEdge);
+                        break;
+                    }
+                } else if (item.op == DisplayOp::DrawImage) {
+                    bounds = resolveImage(list, item, m, state.clip).intersection(state.clip);
+                    if (bounds.isEmpty()) {
+                        images_.resize(image);
+                        break;
+                    }
+                }
+                uint32_t firstShadow = static_cast<uint32_t>(shadows_.size());
+                resolveShadows(list, item, m, scale, state.alpha);
+                if (shadows_.size() > firstShadow) {
+                    Rect masks;
+                    bool replaced = false;
+                    for (size_t s = firstShadow; s < shadows_.size(); ++s) {
+                        const ResolvedShadow& shadow = shadows_[s];
+                        masks = masks.unionRect(Rect(shadow.x, shadow.y, shadow.width, shadow.height));
+                        replaced = replaced || shadow.replacesShape;
+                    }
+                    bounds = (replaced ? masks : bounds.unionRect(masks)).intersection(state.clip);
+                    if (bounds.isEmpty()) {
+                        shadows_.resize(firstShadow);
+                        break;
+                    }
+                }
+                uint32_t edges = static_cast<uint32_t>(pathEdges_.size()) - firstEdge;
+                draws_.push_back(ResolvedDraw{i, m, m.inverted(), scale, state.clip, state.mask, bounds, state.alpha,
+                                              firstQuad, static_cast<uint32_t>(glyphQuads_.size()) - firstQuad,
+                                              firstEdge, fillEdges, edges - fillEdges, firstShadow,
+                                              static_cast<uint32_t>(shadows_.size()) - firstShadow, image});
+                break;
+            }
+        }
+    }
+}
+
+uint32_t SoftwareRasterizer::applyClip(const DisplayList& list, const DisplayItem& item, const Matrix& matrix,
+                                       Rect& clip, uint32_t mask) {
+    bool antiAlias = (item.mode & DisplayList::kClipAntiAlias) != 0;
+    bool out = (item.mode & DisplayList::kClipOut) != 0;
+    const double* args = list.args().data() + item.args;
+    Rect local = item.op == DisplayOp::ClipRect ? Rect(args[0], args[1], args[2], args[3])
+                                                : list.path(item.data).get_bounds();
+
+    // Masks are covered in affine device space; perspective clips to bounds
+    if (!matrix.isAffine()) {
+        if (!out) clip = clip.intersection(matrix.transform(local));
+        return mask;
+    }
+
+    PlacedClipMask added{nullptr, 0, 0};
+    if (item.op == DisplayOp::ClipRect) {
+        if (!out && local.isEmpty()) {
+            clip = Rect();
+            return kNoMask;
+        }
+        if (!out && matrix.m12 == 0 && matrix.m21 == 0) {
+            Rect device = matrix.transform(local);
+            double edges[4] = {device.left(), device.top(), device.right(), device.bottom()};
+            bool aligned = true;
+            for (double& edge : edges) {
+                aligned = aligned && std::abs(edge - std::round(edge)) < 1.0 / 256;
+                // Aliased clips keep the pixels whose centers are inside
+                edge = aligned ? std::round(edge) : std::ceil(edge - 0.5);
+            }
+            if (aligned || !antiAlias) {
+                clip = clip.intersection(Rect(edges[0], edges[1], edges[2] - edges[0], edges[3] - edges[1]));
+                return mask;
+            }
+        }
+        std::vector<PathEdge> edges = {{local.topLeft(), local.topRight()},
+                                       {local.topRight(), local.bottomRight()},
+                                       {local.bottomRight(), local.bottomLeft()},
+                                       {local.bottomLeft(), local.topLeft()}};
+        added.mask = rasterizeClip(edges, matrix, FillRule::NonZero, antiAlias);
+    } else {
+        added = clipMaskCache_->get(list.path(item.data), matrix, antiAlias, *pathCache_);
+    }
+
+    if (out) {
+        // Clipping out nothing keeps the clip
+        if (!added.mask) return mask;
+        added = PlacedClipMask{invertClip(added, static_cast<int>(std::ceil(clip.left() - 0.5)),
+                                          static_cast<int>(std::ceil(clip.top() - 0.5)),
+                                          static_cast<int>(std::ceil(clip.right() - 0.5)),
+                                          static_cast<int>(std::ceil(clip.bottom() - 0.5))),
+                               0, 0};
+    }
+    if (added.mask && mask != kNoMask) {
+        added = PlacedClipMask{intersectClips(clipMasks_[mask], added), 0, 0};
+    }
+    if (!added.mask) {
+        clip = Rect();
+        return kNoMask;
+    }
+
+    // Draws outside the mask are culled with the rect
+    clip = clip.intersection(Rect(added.left(), added.top(), added.right() - added.left(), added.bottom() - added.top()));
+    clipMasks_.push_back(std::move(added));
+    return static_cast<uint32_t>(clipMasks_.size() - 1);
+}
+
+Rect SoftwareRasterizer::layoutText(const DisplayList& list, const DisplayItem& item, const Matrix& matrix,
+                                    double scale) {
+    const double* args = list.args().data() + item.args;
+    Point origin(args[0], args[1]);
+    size_t firstQuad = glyphQuads_.size();
+    if (item.op == DisplayOp::DrawText) {
+        FontMetrics font = GlyphCache::fontFor(list.paint(item.paint));
+        font.size *= scale;
+        glyphCache_->layout(list.text(item.data), font, matrix.transform(origin), glyphQuads_);
+    } else {
+        for (const TextRun& run : list.blob(item.data).runs()) {
+            FontMetrics font = run.font;
+            font.size *= scale;
+            glyphCache_->layout(run.text, font, matrix.transform(origin + run.position), glyphQuads_);
+        }
+    }
+
+    Rect bounds;
+    for (size_t i = firstQuad; i < glyphQuads_.size(); ++i) {
+        const GlyphQuad& quad = glyphQuads_[i];
+        bounds = bounds.unionRect(Rect(quad.x, quad.y, quad.width, quad.height));
+    }
+    return bounds;
+}
+
+Rect SoftwareRasterizer::tessellatePath(const DisplayList& list, const DisplayItem& item, const Matrix& matrix,
+                                        double scale, uint32_t& fillEdges) {
+    std::shared_ptr<const PathGeometry> geometry = pathCache_->get(list.path(item.data), list.paint(item.paint), scale);
+    if (!geometry) return Rect();
+
+    bool first = true;
+    double left = 0, top = 0, right = 0, bottom = 0;
+    for (const auto* edges : {&geometry->fill, &geometry->stroke}) {
+        size_t start = pathEdges_.size();
+        for (const PathEdge& edge : *edges) {
+            Point from = matrix.transform(edge.from);
+            Point to = matrix.transform(edge.to);
+            for (const Point& point : {from, to}) {
+                left = first ? point.x : std::min(left, point.x);
+                top = first ? point.y : std::min(top, point.y);
+                right = first ? point.x : std::max(right, point.x);
+                bottom = first ? point.y : std::max(bottom, point.y);
+                first = false;
+            }
+            appendDeviceEdge(pathEdges_, from, to);
+        }
+        std::sort(pathEdges_.begin() + start, pathEdges_.end(),
+                  [](const DeviceEdge& a, const DeviceEdge& b) { return a.y0 < b.y0; });
+        if (edges == &geometry->fill) {
+            fillEdges = static_cast<uint32_t>(pathEdges_.size() - start);
+        }
+    }
+    return first ? Rect() : Rect(left, top, right - left, bottom - top);
+}
+
+void SoftwareRasterizer::resolveShadows(const DisplayList& list, const DisplayItem& item, const Matrix& matrix,
+                                        double scale, double alpha) {
+    if (item.op == DisplayOp::DrawPaint || item.paint == DisplayList::kNoPaint) return;
+    const Paint& paint = list.paint(item.paint);
+    bool shadowed = paint.hasShadow() && paint.shadowColor().a > 0;
+    bool blurred = paint.hasFilter() && paint.filterType() == FilterType::Blur && paint.filterBlur() > 0;
+    if ((!shadowed && !blurred) || paint.style() == PaintStyle::Stroke) return;
+    // Masks are in device space, so rotated and skewed shapes go without
+    if (matrix.m12 != 0 || matrix.m21 != 0) return;
+
+    ShadowShape shape;
+    Rect rect;
+    double rx = 0, ry = 0;
+    if (!shapeOf(list, item, shape, rect, rx, ry)) return;
+    if (paint.style() == PaintStyle::FillAndStroke) {
+        double half = paint.strokeWidth() / 2;
+        rect = Rect(rect.x() - half, rect.y() - half, rect.width() + half * 2, rect.height() + half * 2);
+        if (shape == ShadowShape::RoundRect) {
+            rx += half;
+            ry += half;
+        }
+    }
+
+    Rect device = matrix.transform(rect);
+    auto add = [&](double sigma, const Point& offset, const Color& color, bool replacesShape) {
+        int x = static_cast<int>(std::lround(device.left() + offset.x));
+        int y = static_cast<int>(std::lround(device.top() + offset.y));
+        int width = static_cast<int>(std::lround(device.right() + offset.x)) - x;
+        int height = static_cast<int>(std::lround(device.bottom() + offset.y)) - y;
+        std::shared_ptr<const ShadowMask> mask = shadowCache_->get(
+            shape, width, height, rx * std::abs(matrix.m11), ry * std::abs(matrix.m22), sigma);
+        if (!mask) return;
+
+        ResolvedShadow shadow{mask, x - mask->outset, y - mask->outset, width + mask->outset * 2,
+                              height + mask->outset * 2, {}, paint.blendMode(), replacesShape};
+        premultiply(color, alpha * paint.opacity(), shadow.color);
+        shadows_.push_back(std::move(shadow));
+    };
+
+    // Canvas shadowBlur is twice the deviation; a blur filter's radius is it.
+    // Shadow offsets are local, so they scale and flip with the shape.
+    if (shadowed) {
+        Point offset(matrix.m11 * paint.shadowOffset().x, matrix.m22 * paint.shadowOffset().y);
+        add(paint.shadowBlur() / 2 * scale, offset, paint.shadowColor(), false);
+    }
+    if (blurred) {
+        add(paint.filterBlur() * scale, Point(), paint.color(), true);
+    }
+}
+
+Rect SoftwareRasterizer::resolveImage(const DisplayList& list, const DisplayItem& item, const Matrix& matrix,
+                                      const Rect& clip) {
+    const Image& image = list.image(item.data);
+    const std::shared_ptr<const ImageBitmap>& bitmap = image.get_bitmap();
+    if (!bitmap || bitmap->readyRows() == 0 || image.get_width() <= 0 || image.get_height() <= 0) return Rect();
+    // Scaled pixels are device-aligned, so rotated, skewed and flipped
+    // images go without
+    if (!matrix.isAffine() || matrix.m12 != 0 || matrix.m21 != 0 || matrix.m11 <= 0 || matrix.m22 <= 0) {
+        return Rect();
+    }
+
+    const double* args = list.args().data() + item.args;
+    Rect device = matrix.transform(Rect(args[4], args[5], args[6], args[7]));
+    int left = static_cast<int>(std::lround(device.left()));
+    int top = static_cast<int>(std::lround(device.top()));
+    int right = static_cast<int>(std::lround(device.right()));
+    int bottom = static_cast<int>(std::lround(device.bottom()));
+    if (right <= left || bottom <= top) return Rect();
+
+    // Source rect in bitmap pixels, which need not match the image's size
+    double sx = static_cast<double>(bitmap->width()) / image.get_width();
+    double sy = static_cast<double>(bitmap->height()) / image.get_height();
+    Rect source(args[0] * sx, args[1] * sy, args[2] * sx, args[3] * sy);
+    if (source.isEmpty()) return Rect();
+
+    // Images larger than the surface are scaled only where the clip shows
+    // them; the rest are scaled whole, so they stay cached while they move
+    if (static_cast<double>(right - left) * (bottom - top) > static_cast<double>(width_) * height_) {
+        int clipLeft = std::max(left, static_cast<int>(std::floor(clip.left())));
+        int clipTop = std::max(top, static_cast<int>(std::floor(clip.top())));
+        int clipRight = std::min(right, static_cast<int>(std::ceil(clip.right())));
+        int clipBottom = std::min(bottom, static_cast<int>(std::ceil(clip.bottom())));
+        if (clipRight <= clipLeft || clipBottom <= clipTop) return Rect();
+        double perX = source.width() / (right - left);
+        double perY = source.height() / (bottom - top);
+        source = Rect(source.x() + (clipLeft - left) * perX, source.y() + (clipTop - top) * perY,
+                      (clipRight - clipLeft) * perX, (clipBottom - clipTop) * perY);
+        left = clipLeft;
+        top = clipTop;
+        right = clipRight;
+        bottom = clipBottom;
+    }
+
+    std::shared_ptr<const ImageBitmap> pixels = scaledImageCache_->get(
+        *bitmap, source, right - left, bottom - top, imageFilterFor(list.paint(item.paint).renderingHint()));
+    if (!pixels) return Rect();
+    images_.push_back(ResolvedImage{std::move(pixels), left, top});
+    return Rect(left, top, right - left, bottom - top);
+}
+
+void SoftwareRasterizer::drawImage(const ResolvedDraw& draw, const Rect& area) {
+    const ResolvedImage& image = images_[draw.image];
+    const ImageBitmap& pixels = *image.pixels;
+    // Pixels whose centers are in area, which is within the clip
+    int left = std::max(image.x, static_cast<int>(std::ceil(area.left() - 0.5)));
+    int top = std::max(image.y, static_cast<int>(std::ceil(area.top() - 0.5)));
+    int right = std::min(image.x + pixels.width(), static_cast<int>(std::ceil(area.right() - 0.5)));
+    int bottom = std::min(image.y + pixels.height(), static_cast<int>(std::ceil(area.bottom() - 0.5)));
+    if (right <= left || bottom <= top) return;
+
+    const Paint& paint = list_->paint(list_->items()[draw.item].paint);
+    double alpha = std::clamp(draw.alpha * paint.opacity(), 0.0, 1.0);
+    uint8_t scaledAlpha = static_cast<uint8_t>(std::lround(alpha * 255));
+    if (scaledAlpha == 0) return;
+    for (int y = top; y < bottom; ++y) {
+        const uint8_t* src = pixels.row(y - image.y) + static_cast<size_t>(left - image.x) * 4;
+        compositeSpan(pixelAt(left, y), src, right - left, paint.blendMode(), scaledAlpha);
+    }
+}
+
+void SoftwareRasterizer::drawShadow(const ResolvedShadow& shadow, const Rect& clip, const Rect& area) {
+    Rect covered = area.intersection(Rect(shadow.x, shadow.y, shadow.width, shadow.height));
+    if (covered.isEmpty()) return;
+    int left = static_cast<int>(std::floor(covered.left()));
+    int top = static_cast<int>(std::floor(covered.top()));
+    int right = static_cast<int>(std::ceil(covered.right()));
+    int bottom = static_cast<int>(std::ceil(covered.bottom()));
+
+    const ShadowMask& mask = *shadow.mask;
+    std::vector<uint8_t> coverage(right - left);
+    for (int y = top; y < bottom; ++y) {
+        const uint8_t* maskRow = mask.coverage.data() + mask.row(y - shadow.y, shadow.height) * mask.width;
+        double cy = y + 0.5;
+        bool rowClipped = cy < clip.top() || cy >= clip.bottom();
+        for (int x = left; x < right; ++x) {
+            double cx = x + 0.5;
+            coverage[x - left] = rowClipped || cx < clip.left() || cx >= clip.right()
+                                     ? 0
+                                     : maskRow[mask.column(x - shadow.x, shadow.width)];
+        }
+        blendSpan(pixelAt(left, y), right - left, shadow.color, coverage.data(), shadow.blendMode);
+    }
+}
+
+void SoftwareRasterizer::bin() {
+    for (uint32_t index = 0; index < draws_.size(); ++index) {
+        const Rect& bounds = draws_[index].bounds;
+        int left = std::max(0, static_cast<int>(std::floor(bounds.left())) / kTileSize);
+        int top = std::max(0, static_cast<int>(std::floor(bounds.top())) / kTileSize);
+        int right = std::min(tilesWide_ - 1, static_cast<int>(std::ceil(bounds.right()) - 1) / kTileSize);
+        int bottom = std::min(tilesHigh_ - 1, static_cast<int>(std::ceil(bounds.bottom()) - 1) / kTileSize);
+        for (int ty = top; ty <= bottom; ++ty) {
+            for (int tx = left; tx <= right; ++tx) {
+                uint32_t tile = static_cast<uint32_t>(ty * tilesWide_ + tx);
+                if (dirty_[tile]) bins_[tile].push_back(index);
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::drawItem(const ResolvedDraw& draw, const Rect& tileRect) {
+    Rect area = draw.bounds.intersection(tileRect);
+    if (area.isEmpty()) return;
+    if (draw.clipMask == kNoMask) {
+        drawArea(draw, area, tileRect);
+        return;
+    }
+
+    // The draw goes over the pixels as they were, which are then blended
+    // back in where the mask does not cover
+    const PlacedClipMask& mask = clipMasks_[draw.clipMask];
+    int left = std::max(mask.left(), static_cast<int>(std::floor(area.left())));
+    int top = std::max(mask.top(), static_cast<int>(std::floor(area.top())));
+    int right = std::min(mask.right(), static_cast<int>(std::ceil(area.right())));
+    int bottom = std::min(mask.bottom(), static_cast<int>(std::ceil(area.bottom())));
+    if (left >= right || top >= bottom) return;
+
+    size_t rowBytes = static_cast<size_t>(right - left) * 4;
+    std::vector<uint8_t> saved(rowBytes * (bottom - top));
+    for (int y = top; y < bottom; ++y) {
+        std::copy(pixelAt(left, y), pixelAt(left, y) + rowBytes, saved.data() + (y - top) * rowBytes);
+    }
+    drawArea(draw, area, tileRect);
+    for (int y = top; y < bottom; ++y) {
+        uint8_t* dst = pixelAt(left, y);
+        const uint8_t* before = saved.data() + (y - top) * rowBytes;
+        for (int x = left; x < right; ++x, dst += 4, before += 4) {
+            unsigned coverage = mask.at(x, y);
+            if (coverage == 255) continue;
+            for (int c = 0; c < 4; ++c) {
+                dst[c] = div255(dst[c] * coverage + before[c] * (255 - coverage));
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::drawArea(const ResolvedDraw& draw, Rect area, const Rect& tileRect) {
+    const DisplayList& list = *list_;
+    const DisplayItem& item = list.items()[draw.item];
+    const double* args = list.args().data() + item.args;
+
+    for (uint32_t i = draw.firstShadow; i < draw.firstShadow + draw.shadowCount; ++i) {
+        drawShadow(shadows_[i], draw.clip, area);
+        if (shadows_[i].replacesShape) return;
+    }
+
+    switch (item.op) {
+        case DisplayOp::DrawColor:
+            fillArea(area, Color(static_cast<uint32_t>(args[0])), draw.alpha, static_cast<BlendMode>(item.mode), false);
+            return;
+        case DisplayOp::DrawPaint:
+            fillArea(area, list.paint(item.paint).color(), draw.alpha * list.paint(item.paint).opacity(),
+                     list.paint(item.paint).blendMode(), false);
+            return;
+        case DisplayOp::Clear:
+            fillArea(area, Color(static_cast<uint32_t>(args[0])), 1.0, BlendMode::Normal, true);
+            return;
+        case DisplayOp::DrawText:
+        case DisplayOp::DrawTextBlob:
+            drawGlyphs(draw, area);
+            return;
+        case DisplayOp::DrawImage:
+            drawImage(draw, area);
+            return;
+        case DisplayOp::DrawPath:
+            if (draw.fillEdges + draw.strokeEdges > 0) {
+                drawEdges(draw, area);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    const Paint& paint = list.paint(item.paint);
+    // Zero-width strokes are one device pixel wide
+    double halfStroke = paint.strokeWidth() > 0 ? paint.strokeWidth() / 2 : 0.5 / draw.scale;
+    DisplayOp op = item.op;
+    Rect rect;
+    double radiusX = 0, radiusY = 0;
+    if (op == DisplayOp::DrawPath) {
+        // A path of one shape is covered like a draw of it
+        const Path& path = list.path(item.data);
+        if (path.is_rect(&rect)) {
+            op = DisplayOp::DrawRect;
+        } else if (path.is_oval(&rect)) {
+            op = DisplayOp::DrawOval;
+        } else if (path.is_round_rect(&rect, &radiusX, &radiusY)) {
+            op = DisplayOp::DrawRoundRect;
+        } else {
+            return;
+        }
+    } else if (op != DisplayOp::DrawPoints) {
+        rect = Rect(args[0], args[1], args[2], args[3]);
+        if (op == DisplayOp::DrawRoundRect) {
+            radiusX = args[4];
+            radiusY = args[5];
+        }
+    }
+    if (draw.shadowCount > 0 && op != DisplayOp::DrawPoints) {
+        // Bounds reach as far as the shadows, which the shape does not
+        double reach = halfStroke + 1;
+        Rect local(rect.x() - reach, rect.y() - reach, rect.width() + reach * 2, rect.height() + reach * 2);
+        area = area.intersection(draw.matrix.transform(local));
+        if (area.isEmpty()) return;
+    }
+
+    auto distance = [&](const Point& p) -> double {
+        switch (op) {
+            case DisplayOp::DrawRect:
+                return styledDistance(rectDistance(p, rect), paint, halfStroke);
+            case DisplayOp::DrawRoundRect:
+                return styledDistance(roundRectDistance(p, rect, radiusX, radiusY), paint, halfStroke);
+            case DisplayOp::DrawOval:
+                return styledDistance(ellipseDistance(p, rect), paint, halfStroke);
+            case DisplayOp::DrawArc:
+                // Filled arcs are drawn as pies; the sweep edges are hard
+                if (!withinSweep(p, rect, args[4], args[5])) return kOutside;
+                return styledDistance(ellipseDistance(p, rect), paint, halfStroke);
+            case DisplayOp::DrawLine:
+                return lineDistance(p, Point(args[0], args[1]), Point(args[2], args[3]), halfStroke, paint.lineCap());
+            default:
+                break;
+        }
+
+        // Points: the count, then the coordinates
+        size_t count = static_cast<size_t>(args[0]);
+        const double* xy = args + 1;
+        PointMode mode = static_cast<PointMode>(item.mode);
+        double best = kOutside;
+        if (mode == PointMode::Points) {
+            LineCap cap = paint.lineCap() == LineCap::Round ? LineCap::Round : LineCap::Square;
+            for (size_t i = 0; i < count; ++i) {
+                Point point(xy[i * 2], xy[i * 2 + 1]);
+                best = std::min(best, lineDistance(p, point, point, halfStroke, cap));
+            }
+            return best;
+        }
+        size_t step = mode == PointMode::Lines ? 2 : 1;
+        for (size_t i = 0; i + 1 < count; i += step) {
+            Point start(xy[i * 2], xy[i * 2 + 1]);
+            Point end(xy[i * 2 + 2], xy[i * 2 + 3]);
+            best = std::min(best, lineDistance(p, start, end, halfStroke, paint.lineCap()));
+        }
+        return best;
+    };
+
+    uint8_t color[4];
+    premultiply(paint.color(), draw.alpha * paint.opacity(), color);
+    if (color[3] == 0) return;
+
+    bool antialias = paint.antialias() != AntialiasMode::None;
+    int left = static_cast<int>(std::floor(area.left()));
+    int top = static_cast<int>(std::floor(area.top()));
+    int right = std::min(width_, static_cast<int>(std::ceil(area.right())));
+    int bottom = std::min(height_, static_cast<int>(std::ceil(area.bottom())));
+    right = std::min(right, static_cast<int>(tileRect.right()));
+    bottom = std::min(bottom, static_cast<int>(tileRect.bottom()));
+    if (left >= right || top >= bottom) return;
+
+    std::vector<uint8_t> coverage(static_cast<size_t>(right - left));
+    for (int y = top; y < bottom; ++y) {
+        for (int x = left; x < right; ++x) {
+            // Pixel centers outside the clip are not drawn
+            bool clipped = x + 0.5 < draw.clip.left() || x + 0.5 > draw.clip.right() ||
+                           y + 0.5 < draw.clip.top() || y + 0.5 > draw.clip.bottom();
+            double d = clipped ? kOutside : distance(draw.inverse.transform(Point(x + 0.5, y + 0.5)));
+            double covered;
+            if (d == kOutside) {
+                covered = 0;
+            } else if (antialias) {
+                covered = std::clamp(0.5 - d * draw.scale, 0.0, 1.0);
+            } else {
+                covered = d <= 0 ? 1 : 0;
+            }
+            coverage[x - left] = static_cast<uint8_t>(std::lround(covered * 255));
+        }
+        blendSpan(pixelAt(left, y), right - left, color, coverage.data(), paint.blendMode());
+    }
+}
+
+// Atlas rows are the coverage of the spans they land on
+void SoftwareRasterizer::drawGlyphs(const ResolvedDraw& draw, const Rect& area) {
+    const Paint& paint = list_->paint(list_->items()[draw.item].paint);
+    uint8_t color[4];
+    premultiply(paint.color(), draw.alpha * paint.opacity(), color);
+    if (color[3] == 0) return;
+
+    // Pixels whose centers are inside the area
+    int left = std::max(0, static_cast<int>(std::lround(area.left())));
+    int top = std::max(0, static_cast<int>(std::lround(area.top())));
+    int right = std::min(width_, static_cast<int>(std::lround(area.right())));
+    int bottom = std::min(height_, static_cast<int>(std::lround(area.bottom())));
+    const uint8_t* atlas = glyphCache_->atlas();
+    int atlasWidth = glyphCache_->atlasWidth();
+
+    for (uint32_t i = draw.firstQuad; i < draw.firstQuad + draw.quadCount; ++i) {
+        const GlyphQuad& quad = glyphQuads_[i];
+        int x0 = std::max(left, quad.x);
+        int x1 = std::min(right, quad.x + quad.width);
+        if (x0 >= x1) continue;
+        for (int y = std::max(top, quad.y); y < std::min(bottom, quad.y + quad.height); ++y) {
+            const uint8_t* coverage =
+                atlas + static_cast<size_t>(quad.atlasY + y - quad.y) * atlasWidth + quad.atlasX + (x0 - quad.x);
+            blendSpan(pixelAt(x0, y), x1 - x0, color, coverage, paint.blendMode());
+        }
+    }
+}
+
+// Scanline coverage of the draw's edges: each row sums the spans inside the
+// path on its subscanlines, fill and stroke apart, and covers the larger
+void SoftwareRasterizer::drawEdges(const ResolvedDraw& draw, const Rect& area) {
+    const DisplayItem& item = list_->items()[draw.item];
+    const Paint& paint = list_->paint(item.paint);
+    uint8_t color[4];
+    premultiply(paint.color(), draw.alpha * paint.opacity(), color);
+    if (color[3] == 0) return;
+
+    // Pixels the area touches whose centers are in the clip
+    int left = std::max({0, static_cast<int>(std::floor(area.left())), static_cast<int>(std::lround(draw.clip.left()))});
+    int top = std::max({0, static_cast<int>(std::floor(area.top())), static_cast<int>(std::lround(draw.clip.top()))});
+    int right = std::min({width_, static_cast<int>(std::ceil(area.right())), static_cast<int>(std::lround(draw.clip.right()))});
+    int bottom =
+        std::min({height_, static_cast<int>(std::ceil(area.bottom())), static_cast<int>(std::lround(draw.clip.bottom()))});
+    if (left >= right || top >= bottom) return;
+
+    bool antialias = paint.antialias() != AntialiasMode::None;
+    FillRule fillRule = list_->path(item.data).get_fill_rule();
+
+    const DeviceEdge* edges = pathEdges_.data() + draw.firstEdge;
+    EdgeCoverage fill(edges, draw.fillEdges, fillRule, antialias);
+    EdgeCoverage stroke(edges + draw.fillEdges, draw.strokeEdges, FillRule::NonZero, antialias);
+    std::vector<uint8_t> coverage(static_cast<size_t>(right - left));
+
+    for (int y = top; y < bottom; ++y) {
+        const std::vector<float>* rows[2] = {
+            draw.fillEdges > 0 ? &fill.row(y, left, right - left) : nullptr,
+            draw.strokeEdges > 0 ? &stroke.row(y, left, right - left) : nullptr,
+        };
+
+        bool any = false;
+        for (int x = left; x < right; ++x) {
+            float covered = 0;
+            for (const std::vector<float>* row : rows) {
+                if (row) covered = std::max(covered, (*row)[x - left]);
+            }
+            coverage[x - left] = static_cast<uint8_t>(std::lround(std::min(covered, 1.0f) * 255));
+            any = any || coverage[x - left] != 0;
+        }
+        if (any) {
+            blendSpan(pixelAt(left, y), right - left, color, coverage.data(), paint.blendMode());
+        }
+    }
+}
+
+void SoftwareRasterizer::fillArea(const Rect& area, const Color& color, double alpha, BlendMode mode, bool replace) {
+    int left = std::max(0, static_cast<int>(std::lround(area.left())));
+    int top = std::max(0, static_cast<int>(std::lround(area.top())));
+    int right = std::min(width_, static_cast<int>(std::lround(area.right())));
+    int bottom = std::min(height_, static_cast<int>(std::lround(area.bottom())));
+    if (left >= right || top >= bottom) return;
+
+    uint8_t premultiplied[4];
+    premultiply(color, alpha, premultiplied);
+    for (int y = top; y < bottom; ++y) {
+        uint8_t* row = pixelAt(left, y);
+        if (replace) {
+            fillSpan(row, right - left, premultiplied);
+        } else {
+            blendSpan(row, right - left, premultiplied, nullptr, mode);
+        }
+    }
+}
+
+} // namespace renderer
@@ -0,0 +1,264 @@
+#include "renderer/swap_chain.h"
+#include <algorithm>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#define RENDERER_EVENTFD 1
+#else
+#define RENDERER_EVENTFD 0
+#endif
+
+namespace renderer {
+
+namespace {
+
+// Waits on condition with pred, where nanoseconds::max() waits forever
+template <typename Lock, typename Pred>
+bool waitFor(std::condition_variable& condition, Lock& lock, std::chrono::nanoseconds timeout, Pred pred) {
+    if (timeout == std::chrono::nanoseconds::max()) {
+        condition.wait(lock, pred);
+        return true;
+    }
+    return condition.wait_for(lock, timeout, pred);
+}
+
+} // namespace
+
+// Fence implementation
+Fence::Fence()
+    : mutex_()
+    , signaled_()
+    , isSignaled_(false)
+    , fd_(-1) {
+#if RENDERER_EVENTFD
+    fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+}
+
+Fence::~Fence() {
+#if RENDERER_EVENTFD
+    if (fd_ >= 0) close(fd_);
+#endif
+}
+
+void Fence::signal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (isSignaled_) return;
+        isSignaled_ = true;
+#if RENDERER_EVENTFD
+        if (fd_ >= 0) {
+            uint64_t one = 1;
+            ssize_t written = write(fd_, &one, sizeof(one));
+            (void)written;
+        }
+#endif
+    }
+    signaled_.notify_all();
+}
+
+bool Fence::isSignaled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return isSignaled_;
+}
+
+bool Fence::wait(std::chrono::nanoseconds timeout) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return waitFor(signaled_, lock, timeout, [&] { return isSignaled_; });
+}
+
+// SwapChain implementation
+SwapChain::SwapChain(int width, int height, size_t bufferCount, FrameBufferMemory memory)
+    : width_(width)
+    , height_(height)
+    , buffers_()
+    , mutex_()
+    , freed_()
+    , serial_(0)
+    , taken_(0)
+    , history_()
+    , stats_() {
+    bufferCount = std::clamp<size_t>(bufferCount, 2, kMaxBuffers);
+    for (size_t i = 0; i < bufferCount; ++i) {
+        Slot slot;
+        if (memory == FrameBufferMemory::SharedMemory) {
+            slot.buffer = FrameBuffer::createShared(width, height);
+        } else if (memory == FrameBufferMemory::Owned) {
+            slot.buffer = FrameBuffer::allocate(width, height);
+        }
+        // External memory and dma-bufs come from the caller
+        if (!slot.buffer) {
+            buffers_.clear();
+            return;
+        }
+        buffers_.push_back(std::move(slot));
+    }
+}
+
+SwapChain::SwapChain(std::vector<std::shared_ptr<FrameBuffer>> buffers)
+    : width_(0)
+    , height_(0)
+    , buffers_()
+    , mutex_()
+    , freed_()
+    , serial_(0)
+    , taken_(0)
+    , history_()
+    , stats_() {
+    if (buffers.empty() || buffers.size() > kMaxBuffers || !buffers[0]) return;
+    width_ = buffers[0]->width();
+    height_ = buffers[0]->height();
+    for (auto& buffer : buffers) {
+        if (!buffer || buffer->width() != width_ || buffer->height() != height_) {
+            buffers_.clear();
+            return;
+        }
+        Slot slot;
+        slot.buffer = std::move(buffer);
+        buffers_.push_back(std::move(slot));
+    }
+}
+
+bool SwapChain::acquire(Frame& frame, std::chrono::nanoseconds timeout) {
+    std::shared_ptr<Fence> released;
+    size_t index = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto drawing = [&] {
+            return std::any_of(buffers_.begin(), buffers_.end(),
+                               [](const Slot& slot) { return slot.state == State::Drawing; });
+        };
+        auto hasFree = [&] {
+            return std::any_of(buffers_.begin(), buffers_.end(),
+                               [](const Slot& slot) { return slot.state == State::Free; });
+        };
+        if (buffers_.empty() || drawing()) return false;
+        if (!hasFree()) {
+            ++stats_.acquireWaits;
+            if (!waitFor(freed_, lock, timeout, hasFree)) return false;
+        }
+
+        // A buffer the embedder is done reading comes first, and the most
+        // recently drawn one has the least to redraw
+        auto rank = [](const Slot& slot) {
+            bool ready = !slot.released || slot.released->isSignaled();
+            return std::make_pair(ready, slot.serial);
+        };
+        bool found = false;
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            if (buffers_[i].state != State::Free) continue;
+            if (!found || rank(buffers_[i]) > rank(buffers_[index])) {
+                index = i;
+                found = true;
+            }
+        }
+        Slot& slot = buffers_[index];
+        slot.state = State::Drawing;
+        released = std::move(slot.released);
+
+        frame.buffer = slot.buffer;
+        frame.index = static_cast<uint32_t>(index);
+        frame.serial = serial_ + 1;
+        frame.age = slot.serial ? static_cast<int>(frame.serial - slot.serial) : 0;
+        frame.damage = slot.serial ? damageSince(slot.serial) : Rect(0, 0, width_, height_);
+        frame.ready = nullptr;
+    }
+
+    // The embedder may still be reading the buffer it released
+    if (released && !released->wait(timeout)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_[index].state = State::Free;
+        buffers_[index].released = std::move(released);
+        return false;
+    }
+    return true;
+}
+
+void SwapChain::present(const Frame& frame, const Rect& damage, std::shared_ptr<Fence> ready) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frame.index >= buffers_.size() || buffers_[frame.index].state != State::Drawing) return;
+
+        for (Slot& slot : buffers_) {
+            if (slot.state == State::Presented) {
+                slot.state = State::Free;
+                ++stats_.dropped;
+            }
+        }
+        Slot& slot = buffers_[frame.index];
+        slot.state = State::Presented;
+        slot.serial = frame.serial;
+        slot.ready = std::move(ready);
+        serial_ = frame.serial;
+        ++stats_.presented;
+
+        history_.push_back(Damage{frame.serial, damage.intersection(Rect(0, 0, width_, height_))});
+        // Damage older than every buffer can be forgotten; the embedder's
+        // last frame may be older still, in which case it gets all of it
+        while (history_.size() > kMaxBuffers * 2) {
+            history_.pop_front();
+        }
+    }
+    freed_.notify_all();
+}
+
+void SwapChain::cancel(const Frame& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frame.index >= buffers_.size() || buffers_[frame.index].state != State::Drawing) return;
+        // What was drawn before cancelling is unknown
+        buffers_[frame.index].state = State::Free;
+        buffers_[frame.index].serial = 0;
+    }
+    freed_.notify_all();
+}
+
+bool SwapChain::take(Frame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+        Slot& slot = buffers_[i];
+        if (slot.state != State::Presented) continue;
+
+        slot.state = State::Taken;
+        frame.buffer = slot.buffer;
+        frame.index = static_cast<uint32_t>(i);
+        frame.serial = slot.serial;
+        frame.age = 0;
+        frame.damage = taken_ ? damageSince(taken_) : Rect(0, 0, width_, height_);
+        frame.ready = std::move(slot.ready);
+        taken_ = slot.serial;
+        return true;
+    }
+    return false;
+}
+
+void SwapChain::release(const Frame& frame, std::shared_ptr<Fence> done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frame.index >= buffers_.size() || buffers_[frame.index].state != State::Taken) return;
+        buffers_[frame.index].state = State::Free;
+        buffers_[frame.index].released = std::move(done);
+    }
+    freed_.notify_all();
+}
+
+SwapChain::Stats SwapChain::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+Rect SwapChain::damageSince(uint64_t serial) const {
+    if (serial >= serial_) return Rect();
+    // Frames after serial that are no longer in the history changed anything
+    if (history_.empty() || history_.front().serial > serial + 1) return Rect(0, 0, width_, height_);
+
+    Rect damage;
+    for (const Damage& entry : history_) {
+        if (entry.serial > serial) damage = damage.unionRect(entry.rect);
+    }
+    return damage;
+}
+
+} // namespace renderer
@@ -0,0 +1,36 @@
+#pragma once
+
+// C interface to the engine's memory accounting, for the Rust side and the
+// metrics endpoint. Subsystem names are those of memorySubsystemName();
+// tab 0 is the process-wide entries.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ApolloMemoryUsage {
+    // Static string; never freed
+    const char* subsystem;
+    uint64_t tab;
+    size_t bytes;
+} ApolloMemoryUsage;
+
+// Fills up to capacity entries; returns how many there are
+size_t apollo_memory_usage(ApolloMemoryUsage* entries, size_t capacity);
+
+// Writes the Prometheus metrics text, truncated to fit and NUL-terminated;
+// returns its full length
+size_t apollo_memory_prometheus(char* buffer, size_t capacity);
+
+// Returns 0 when the build does not track allocations
+int apollo_memory_set_tracking(int enabled, size_t sample_interval);
+
+// Live tracked bytes of a subsystem, 0 for unknown names
+int64_t apollo_memory_tracked_bytes(const char* subsystem);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,174 @@
+#include "dom_mutation_queue.h"
+#include "layout/layout_engine.h"
+#include <algorithm>
+#include <utility>
+
+namespace apollo {
+
+// DOMMutationQueue implementation
+DOMMutationQueue::DOMMutationQueue(layout::LayoutEngine& engine)
+    : engine_(engine)
+    , log_()
+    , layoutStale_(false)
+    , script_()
+    , forcedLayouts_()
+    , stats_() {
+}
+
+void DOMMutationQueue::push(Mutation mutation) {
+    ++stats_.writes;
+    log_.push_back(std::move(mutation));
+}
+
+void DOMMutationQueue::setStyle(NodeHandle node, StyleChange change) {
+    if (!change) return;
+    push(Mutation{Mutation::Kind::Style, node, NodeHandle(), std::string(), std::move(change)});
+}
+
+void DOMMutationQueue::setText(NodeHandle node, std::string text) {
+    // Only the last of a run of text writes to a node is seen
+    if (!log_.empty() && log_.back().kind == Mutation::Kind::Text && log_.back().node == node) {
+        ++stats_.writes;
+        log_.back().text = std::move(text);
+        return;
+    }
+    push(Mutation{Mutation::Kind::Text, node, NodeHandle(), std::move(text), nullptr});
+}
+
+void DOMMutationQueue::appendChild(NodeHandle parent, NodeHandle child) {
+    push(Mutation{Mutation::Kind::AppendChild, parent, child, std::string(), nullptr});
+}
+
+void DOMMutationQueue::removeNode(NodeHandle node) {
+    push(Mutation{Mutation::Kind::Remove, node, NodeHandle(), std::string(), nullptr});
+}
+
+NodeHandle DOMMutationQueue::createNode(std::shared_ptr<layout::LayoutBox> box) {
+    layout::LayoutTree* tree = engine_.tree();
+    if (!tree) return NodeHandle();
+    return handleOf(tree->createNode(std::move(box)));
+}
+
+NodeHandle DOMMutationQueue::handleOf(const layout::LayoutNode* node) const {
+    layout::LayoutTree* tree = engine_.tree();
+    if (!tree || !node || tree->nodeAt(node->index()) != node) return NodeHandle();
+    return NodeHandle{node->index(), tree->arena().generation(node->index())};
+}
+
+layout::LayoutNode* DOMMutationQueue::resolve(NodeHandle handle) const {
+    layout::LayoutTree* tree = engine_.tree();
+    if (!tree || tree->arena().generation(handle.index) != handle.generation) return nullptr;
+    return tree->nodeAt(handle.index);
+}
+
+bool DOMMutationQueue::apply(const Mutation& mutation) {
+    layout::LayoutTree* tree = engine_.tree();
+    layout::LayoutNode* node = resolve(mutation.node);
+    if (!node) return false;
+
+    switch (mutation.kind) {
+        case Mutation::Kind::Style: {
+            auto box = node->box() ? std::make_shared<layout::LayoutBox>(*node->box())
+                                   : std::make_shared<layout::LayoutBox>();
+            mutation.style(*box);
+            // Marks the node for layout and paint order
+            node->setBox(std::move(box));
+            break;
+        }
+        case Mutation::Kind::Text:
+            node->setTextContent(mutation.text);
+            break;
+        case Mutation::Kind::AppendChild: {
+            layout::LayoutNode* child = resolve(mutation.other);
+            if (!child || child == node) return false;
+            tree->addChild(node, child);
+            break;
+        }
+        case Mutation::Kind::Remove:
+            tree->removeNode(node);
+            break;
+    }
+    tree->noteContentChange();
+    return true;
+}
+
+size_t DOMMutationQueue::flush() {
+    if (log_.empty()) return 0;
+
+    size_t count = log_.size();
+    ++stats_.flushes;
+    for (const Mutation& mutation : log_) {
+        if (apply(mutation)) {
+            layoutStale_ = true;
+        } else {
+            ++stats_.skippedWrites;
+        }
+    }
+    log_.clear();
+    return count;
+}
+
+void DOMMutationQueue::updateLayout() {
+    flush();
+    if (!layoutStale_) return;
+    engine_.updateLayout();
+    layoutStale_ = false;
+    ++stats_.layouts;
+}
+
+void DOMMutationQueue::prepareRead() {
+    flush();
+    if (!layoutStale_) return;
+
+    auto start = std::chrono::steady_clock::now();
+    updateLayout();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    ++stats_.forcedLayouts;
+    ForcedLayouts& forced = forcedLayouts_[script_];
+    ++forced.count;
+    forced.totalMs += ms;
+    forced.maxMs = std::max(forced.maxMs, ms);
+}
+
+layout::Rect DOMMutationQueue::layoutRect(NodeHandle node) {
+    prepareRead();
+    layout::LayoutNode* found = resolve(node);
+    return found ? found->layoutRect() : layout::Rect();
+}
+
+layout::Rect DOMMutationQueue::absoluteRect(NodeHandle node) {
+    prepareRead();
+    layout::LayoutNode* found = resolve(node);
+    if (!found) return layout::Rect();
+
+    layout::Rect rect = found->layoutRect();
+    for (layout::LayoutNode* parent = found->parent(); parent; parent = parent->parent()) {
+        rect.x += parent->layoutRect().x;
+        rect.y += parent->layoutRect().y;
+    }
+    return rect;
+}
+
+layout::LayoutNode* DOMMutationQueue::hitTest(const layout::Point& point) {
+    prepareRead();
+    return engine_.hitTest(point);
+}
+
+void DOMMutationQueue::resetStats() {
+    stats_ = Stats();
+    forcedLayouts_.clear();
+}
+
+// ScriptScope implementation
+DOMMutationQueue::ScriptScope::ScriptScope(DOMMutationQueue& queue, std::string script)
+    : queue_(queue)
+    , previous_(std::move(queue.script_)) {
+    queue_.script_ = std::move(script);
+}
+
+DOMMutationQueue::ScriptScope::~ScriptScope() {
+    queue_.script_ = std::move(previous_);
+}
+
+} // namespace apollo
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "layout/layout_node.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace layout {
+class LayoutEngine;
+}
+
+namespace apollo {
+
+// A node as scripts name it: its index with the arena generation it was
+// created in, so a handle kept past the node's removal names nothing
+// rather than the next node created in its slot
+struct NodeHandle {
+    layout::NodeIndex index = layout::kInvalidNodeIndex;
+    uint32_t generation = 0;
+
+    bool operator==(const NodeHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const NodeHandle& other) const { return !(*this == other); }
+};
+
+// Batches the DOM writes scripts make and lays out at most once per read
+//
+// The DOM bindings call the write methods as scripts change styles, text
+// and structure; each is only logged until the log is flushed. Geometry
+// reads (layoutRect(), absoluteRect(), hitTest()) flush it and, when
+// anything changed since the last layout, run one incremental
+// updateLayout() first, so a run of writes followed by a run of reads lays
+// out once however they are interleaved within each run. The frame's layout
+// stage flushes and lays out too (see FrameScheduler::engineStages()).
+//
+// A read that had to lay out is a forced synchronous layout; they are
+// counted per script, as named by the ScriptScope around its execution, so
+// the scripts that read geometry after writing it can be found.
+//
+// Nodes are named by NodeHandle. Writes to nodes removed by the time the
+// log is flushed are skipped, even when another node has taken the index
+// since. Everything runs on the thread that owns the layout tree.
+class DOMMutationQueue {
+public:
+    using StyleChange = std::function<void(layout::LayoutBox& box)>;
+
+    explicit DOMMutationQueue(layout::LayoutEngine& engine);
+
+    DOMMutationQueue(const DOMMutationQueue&) = delete;
+    DOMMutationQueue& operator=(const DOMMutationQueue&) = delete;
+
+    // Writes. Style changes edit a copy of the node's box, so nodes sharing
+    // it are not affected.
+    void setStyle(NodeHandle node, StyleChange change);
+    void setText(NodeHandle node, std::string text);
+    void appendChild(NodeHandle parent, NodeHandle child);
+    // Destroys the node and its subtree
+    void removeNode(NodeHandle node);
+    // New nodes are created at once, unattached, so scripts can name them
+    // in later writes; an invalid handle without a tree
+    NodeHandle createNode(std::shared_ptr<layout::LayoutBox> box);
+
+    // Handle of a node already in the tree, such as one the parser built
+    NodeHandle handleOf(const layout::LayoutNode* node) const;
+
+    size_t pendingCount() const { return log_.size(); }
+    // Applies the log without laying out; returns how many writes there were
+    size_t flush();
+    // Flushes, then lays out if anything changed since the last layout
+    void updateLayout();
+    // For layouts run by others, such as the frame's layout stage
+    void noteLayoutDone() { layoutStale_ = false; }
+
+    // Reads; zero rects and nullptr for nodes that do not exist
+    layout::Rect layoutRect(NodeHandle node);
+    layout::Rect absoluteRect(NodeHandle node);
+    layout::LayoutNode* hitTest(const layout::Point& point);
+
+    // Names the script forced layouts are counted against while alive
+    class ScriptScope {
+    public:
+        ScriptScope(DOMMutationQueue& queue, std::string script);
+        ~ScriptScope();
+
+        ScriptScope(const ScriptScope&) = delete;
+        ScriptScope& operator=(const ScriptScope&) = delete;
+
+    private:
+        DOMMutationQueue& queue_;
+        std::string previous_;
+    };
+
+    struct ForcedLayouts {
+        uint64_t count = 0;
+        double totalMs = 0;
+        double maxMs = 0;
+    };
+    // By script; reads outside any ScriptScope count under ""
+    const std::map<std::string, ForcedLayouts>& forcedLayouts() const { return forcedLayouts_; }
+
+    struct Stats {
+        uint64_t writes = 0;
+        uint64_t flushes = 0;
+        uint64_t layouts = 0;
+        uint64_t forcedLayouts = 0;
+        // Written to nodes gone by the flush
+        uint64_t skippedWrites = 0;
+    };
+    const Stats& stats() const { return stats_; }
+    void resetStats();
+
+private:
+    struct Mutation {
+        enum class Kind : uint8_t {
+            Style,
+            Text,
+            AppendChild,
+            Remove,
+        };
+
+        Kind kind;
+        NodeHandle node;
+        // The child of AppendChild
+        NodeHandle other;
+        std::string text;
+        StyleChange style;
+    };
+
+    layout::LayoutEngine& engine_;
+    std::vector<Mutation> log_;
+    // Changes applied since the last layout
+    bool layoutStale_;
+    std::string script_;
+    std::map<std::string, ForcedLayouts> forcedLayouts_;
+    Stats stats_;
+
+    void push(Mutation mutation);
+    // The node handle names, nullptr once it was removed
+    layout::LayoutNode* resolve(NodeHandle handle) const;
+    bool apply(const Mutation& mutation);
+    // Lays out before a read, counting it when it was needed
+    void prepareRead();
+};
+
+} // namespace apollo
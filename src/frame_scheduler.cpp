@@ -0,0 +1,260 @@
+#include "frame_scheduler.h"
+#include "dom_mutation_queue.h"
+#include "memory_accounting.h"
+#include "memory_pressure.h"
+#include "js/engine.h"
+#include "layout/layout_engine.h"
+#include "layout/layout_node.h"
+#include "layout/layout_snapshot.h"
+#include "renderer/display_list.h"
+#include <algorithm>
+#include <utility>
+
+namespace apollo {
+
+// FrameScheduler implementation
+void FrameScheduler::StageStats::add(double ms) {
+    ++count;
+    lastMs = ms;
+    maxMs = std::max(maxMs, ms);
+    totalMs += ms;
+}
+
+FrameScheduler::Stages FrameScheduler::engineStages(js::JavaScriptEngine& engine, layout::LayoutEngine& layout,
+                                                    double scriptBudget, DOMMutationQueue* mutations,
+                                                    bool preemptScripts) {
+    Stages stages;
+    stages.script = [&engine, scriptBudget, preemptScripts](const FrameArgs& args) {
+        // Between tasks, where the engine and tree may be trimmed
+        MemoryPressure::shared().dispatchPending();
+        auto budget = std::chrono::duration_cast<Clock::duration>((args.deadline - args.vsync) * scriptBudget);
+        // The turn stops between tasks at the budget; a task still running
+        // at the next vsync is reported, or ended with preemptScripts
+        engine.setExecutionDeadline(args.deadline, preemptScripts);
+        engine.runEventLoopTurn(args.vsync + budget);
+        engine.clearExecutionDeadline();
+    };
+    stages.layout = [&layout, mutations](const FrameArgs&) -> std::shared_ptr<const layout::LayoutSnapshot> {
+        if (!layout.tree()) return nullptr;
+        if (mutations) mutations->flush();
+        layout.updateLayout();
+        if (mutations) mutations->noteLayoutDone();
+        return layout.tree()->snapshot();
+    };
+    return stages;
+}
+
+FrameScheduler::FrameScheduler(Stages stages, std::chrono::nanoseconds interval)
+    : stages_(std::move(stages))
+    , interval_(interval.count() > 0 ? interval : kDefaultInterval)
+    , timingCallback_()
+    , mutex_()
+    , changed_()
+    , paintSlot_()
+    , rasterSlot_()
+    , inFlight_(0)
+    , nextFrame_(1)
+    , lastVsync_()
+    , stopRequested_(false)
+    , runStopRequested_(false)
+    , stats_()
+    , paintThread_()
+    , rasterThread_() {
+    paintThread_ = std::thread(&FrameScheduler::paintLoop, this);
+    rasterThread_ = std::thread(&FrameScheduler::rasterLoop, this);
+}
+
+FrameScheduler::~FrameScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    changed_.notify_all();
+    paintThread_.join();
+    rasterThread_.join();
+}
+
+bool FrameScheduler::beginFrame(Clock::time_point vsync) {
+    FrameArgs args;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.vsyncs;
+        if (lastVsync_ != Clock::time_point() && vsync > lastVsync_) {
+            // Vsyncs between this one and the last that never got here
+            auto skipped = (vsync - lastVsync_ + interval_ / 2) / interval_ - 1;
+            if (skipped > 0) {
+                stats_.missedVsyncs += static_cast<uint64_t>(skipped);
+                stats_.droppedFrames += static_cast<uint64_t>(skipped);
+            }
+        }
+        lastVsync_ = vsync;
+        if (paintSlot_.full) {
+            ++stats_.pipelineFull;
+            ++stats_.droppedFrames;
+            return false;
+        }
+        args.frame = nextFrame_++;
+        ++inFlight_;
+        ++stats_.framesBegun;
+    }
+    args.vsync = vsync;
+    args.deadline = vsync + std::chrono::duration_cast<Clock::duration>(interval_);
+
+    Job job;
+    job.args = args;
+    job.timing = FrameTiming{args.frame, 0, 0, 0, 0, 0};
+
+    Clock::time_point start = Clock::now();
+    if (stages_.script) {
+        MemoryAccounting::Scope scope(MemorySubsystem::JSHeap);
+        stages_.script(args);
+    }
+    Clock::time_point scripted = Clock::now();
+    if (stages_.layout) {
+        MemoryAccounting::Scope scope(MemorySubsystem::LayoutTree);
+        job.snapshot = stages_.layout(args);
+    }
+    Clock::time_point laidOut = Clock::now();
+    job.timing.scriptMs = elapsedMs(start, scripted);
+    job.timing.layoutMs = elapsedMs(scripted, laidOut);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.script.add(job.timing.scriptMs);
+        stats_.layout.add(job.timing.layoutMs);
+        // Only this thread fills the slot, and it was empty above
+        paintSlot_.job = std::move(job);
+        paintSlot_.full = true;
+    }
+    changed_.notify_all();
+    return true;
+}
+
+void FrameScheduler::run(uint64_t vsyncs) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        runStopRequested_ = false;
+    }
+    auto interval = std::chrono::duration_cast<Clock::duration>(interval_);
+    Clock::time_point vsync = Clock::now();
+    for (uint64_t count = 0; vsyncs == 0 || count < vsyncs;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (changed_.wait_until(lock, vsync, [&] { return runStopRequested_ || stopRequested_; })) break;
+        }
+        beginFrame(vsync);
+        ++count;
+
+        // A frame that ran past vsyncs skips them; beginFrame() counts them
+        Clock::time_point next = vsync + interval;
+        Clock::time_point now = Clock::now();
+        if (now >= next) {
+            auto late = (now - next) / interval + 1;
+            next += interval * late;
+            count += static_cast<uint64_t>(late);
+        }
+        vsync = next;
+    }
+}
+
+void FrameScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        runStopRequested_ = true;
+    }
+    changed_.notify_all();
+}
+
+void FrameScheduler::finish() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return inFlight_ == 0; });
+}
+
+void FrameScheduler::setTimingCallback(std::function<void(const FrameTiming& timing)> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timingCallback_ = std::move(callback);
+}
+
+FrameScheduler::Stats FrameScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void FrameScheduler::paintLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&] { return paintSlot_.full || stopRequested_; });
+            if (stopRequested_) return;
+            job = std::move(paintSlot_.job);
+            paintSlot_.full = false;
+        }
+        // The main thread may begin the next frame now
+        changed_.notify_all();
+
+        Clock::time_point start = Clock::now();
+        if (stages_.paint) {
+            MemoryAccounting::Scope scope(MemorySubsystem::DisplayLists);
+            job.list = stages_.paint(job.snapshot.get(), job.args);
+        }
+        job.timing.paintMs = elapsedMs(start, Clock::now());
+        // The snapshot is done with; let it go before waiting on raster
+        job.snapshot.reset();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stats_.paint.add(job.timing.paintMs);
+            changed_.wait(lock, [&] { return !rasterSlot_.full || stopRequested_; });
+            if (stopRequested_) return;
+            rasterSlot_.job = std::move(job);
+            rasterSlot_.full = true;
+        }
+        changed_.notify_all();
+    }
+}
+
+void FrameScheduler::rasterLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&] { return rasterSlot_.full || stopRequested_; });
+            if (stopRequested_) return;
+            job = std::move(rasterSlot_.job);
+            rasterSlot_.full = false;
+        }
+        changed_.notify_all();
+
+        Clock::time_point start = Clock::now();
+        if (stages_.raster) {
+            MemoryAccounting::Scope scope(MemorySubsystem::Raster);
+            stages_.raster(job.list.get(), job.args);
+        }
+        Clock::time_point end = Clock::now();
+        job.timing.rasterMs = elapsedMs(start, end);
+        job.timing.latencyMs = elapsedMs(job.args.vsync, end);
+
+        std::function<void(const FrameTiming&)> callback;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.raster.add(job.timing.rasterMs);
+            stats_.latency.add(job.timing.latencyMs);
+            ++stats_.framesPresented;
+            callback = timingCallback_;
+        }
+        if (callback) callback(job.timing);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --inFlight_;
+        }
+        changed_.notify_all();
+    }
+}
+
+double FrameScheduler::elapsedMs(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace apollo
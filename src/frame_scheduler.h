@@ -0,0 +1,179 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace js {
+class JavaScriptEngine;
+}
+
+namespace layout {
+class LayoutEngine;
+class LayoutSnapshot;
+}
+
+namespace renderer {
+class DisplayList;
+}
+
+namespace apollo {
+
+class DOMMutationQueue;
+
+// Drives vsync-aligned frames through script, layout, paint and raster
+//
+// Script and layout run on the thread that calls beginFrame() or run(),
+// which owns the JS engine and the layout tree. Layout ends in an
+// immutable LayoutSnapshot that goes to the scheduler's paint thread, which
+// builds the frame's display list; the list goes to its raster thread,
+// whose rasterizer fans tiles out to its own workers. Each stage holds one
+// frame, so frame N+1's script runs while frame N paints and frame N-1
+// rasters.
+//
+// A stage that is still busy holds the one before it back; when the frame
+// handed to paint has not been picked up by the next vsync, that vsync
+// begins no frame and counts as dropped, so script never produces frames
+// nobody will draw. Vsyncs that pass while the main thread is still
+// working on a frame are dropped too.
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::nanoseconds kDefaultInterval{16666667};
+
+    struct FrameArgs {
+        // Counts begun frames from 1
+        uint64_t frame;
+        Clock::time_point vsync;
+        // When the next vsync is due
+        Clock::time_point deadline;
+    };
+
+    // The work of each stage; any may be empty. script and layout run on
+    // the main thread, paint and raster on the scheduler's own.
+    struct Stages {
+        std::function<void(const FrameArgs& args)> script;
+        std::function<std::shared_ptr<const layout::LayoutSnapshot>(const FrameArgs& args)> layout;
+        std::function<std::shared_ptr<const renderer::DisplayList>(const layout::LayoutSnapshot* snapshot,
+                                                                   const FrameArgs& args)>
+            paint;
+        std::function<void(const renderer::DisplayList* list, const FrameArgs& args)> raster;
+    };
+
+    // Script handles pending memory pressure, then gets scriptBudget of
+    // each frame for its event loop; a task still running when the frame's
+    // deadline passes goes to the engine's long task handler and, with
+    // preemptScripts, is terminated there. Layout applies the DOM writes
+    // queued in mutations, if given, then updates the dirty part of the
+    // tree and snapshots it
+    static Stages engineStages(js::JavaScriptEngine& engine, layout::LayoutEngine& layout,
+                               double scriptBudget = 0.5, DOMMutationQueue* mutations = nullptr,
+                               bool preemptScripts = false);
+
+    // How long one stage of the pipeline took
+    struct StageStats {
+        uint64_t count = 0;
+        double lastMs = 0;
+        double maxMs = 0;
+        double totalMs = 0;
+
+        double averageMs() const { return count ? totalMs / count : 0; }
+        void add(double ms);
+    };
+
+    struct FrameTiming {
+        uint64_t frame;
+        double scriptMs;
+        double layoutMs;
+        double paintMs;
+        double rasterMs;
+        // From the frame's vsync to the end of its raster
+        double latencyMs;
+    };
+
+    struct Stats {
+        uint64_t vsyncs = 0;
+        uint64_t framesBegun = 0;
+        uint64_t framesPresented = 0;
+        // Vsyncs that began no frame: the pipeline was full, or the main
+        // thread was still busy with the frame before
+        uint64_t droppedFrames = 0;
+        uint64_t pipelineFull = 0;
+        uint64_t missedVsyncs = 0;
+        StageStats script;
+        StageStats layout;
+        StageStats paint;
+        StageStats raster;
+        StageStats latency;
+    };
+
+    explicit FrameScheduler(Stages stages, std::chrono::nanoseconds interval = kDefaultInterval);
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    std::chrono::nanoseconds interval() const { return interval_; }
+
+    // Called on the main thread at each vsync by an embedder that has its
+    // own; returns whether a frame was begun
+    bool beginFrame(Clock::time_point vsync);
+    // Beginning frames at the scheduler's interval until stop(), or until
+    // vsyncs have passed when it is not 0
+    void run(uint64_t vsyncs = 0);
+    // Safe from any thread; run() returns after its current frame
+    void stop();
+    // Waits until every begun frame is rastered
+    void finish();
+
+    // Called on the raster thread as each frame finishes
+    void setTimingCallback(std::function<void(const FrameTiming& timing)> callback);
+
+    Stats stats() const;
+
+private:
+    struct Job {
+        FrameArgs args;
+        FrameTiming timing;
+        std::shared_ptr<const layout::LayoutSnapshot> snapshot;
+        std::shared_ptr<const renderer::DisplayList> list;
+    };
+
+    // One frame handed from one stage to the next
+    struct Slot {
+        bool full = false;
+        Job job;
+    };
+
+    Stages stages_;
+    std::chrono::nanoseconds interval_;
+    std::function<void(const FrameTiming&)> timingCallback_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    Slot paintSlot_;
+    Slot rasterSlot_;
+    // Frames begun and not yet rastered
+    uint64_t inFlight_;
+    uint64_t nextFrame_;
+    Clock::time_point lastVsync_;
+    bool stopRequested_;
+    bool runStopRequested_;
+    Stats stats_;
+
+    std::thread paintThread_;
+    std::thread rasterThread_;
+
+    void paintLoop();
+    void rasterLoop();
+
+    static double elapsedMs(Clock::time_point start, Clock::time_point end);
+};
+
+} // namespace apollo
@@ -0,0 +1,549 @@
+#include "memory_accounting.h"
+#include "apollo_memory.h"
+#include "js/arena.h"
+#include "js/engine.h"
+#include "layout/layout_node.h"
+#include "layout/text_run_cache.h"
+#include "renderer/clip_mask.h"
+#include "renderer/glyph_cache.h"
+#include "renderer/image_cache.h"
+#include "renderer/image_scaler.h"
+#include "renderer/path_cache.h"
+#include "renderer/shadow_cache.h"
+#include "renderer/software.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <utility>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define APOLLO_HAVE_BACKTRACE 1
+#else
+#define APOLLO_HAVE_BACKTRACE 0
+#endif
+
+namespace apollo {
+
+namespace {
+
+const char* const kSubsystemNames[kMemorySubsystemCount] = {
+    "js_heap",
+    "js_ast",
+    "layout_tree",
+    "layout_caches",
+    "display_lists",
+    "raster",
+    "glyph_cache",
+    "image_cache",
+    "path_cache",
+    "shadow_cache",
+    "other",
+};
+
+// Tag of blocks allocated while tracking was off, or from inside the hooks
+constexpr uint8_t kUntracked = 0xFF;
+constexpr uint8_t kDefaultTag = static_cast<uint8_t>(MemorySubsystem::Other);
+// noteAllocation() and the sampler
+constexpr int kSkippedFrames = 2;
+constexpr size_t kSiteCapacity = 4096;
+constexpr size_t kMaxProbes = 64;
+
+// Everything the hooks touch is constant-initialized, so allocations made
+// before main() can be tracked
+std::atomic<bool> trackingEnabled{false};
+std::atomic<size_t> samplingInterval{0};
+std::atomic<int64_t> liveBytes[kMemorySubsystemCount];
+std::atomic<uint64_t> allocationCounts[kMemorySubsystemCount];
+std::atomic<uint64_t> freeCounts[kMemorySubsystemCount];
+
+thread_local uint8_t threadTag = kDefaultTag;
+thread_local int64_t bytesUntilSample = 0;
+thread_local uint32_t sampleSeed = 0;
+thread_local bool inHook = false;
+
+struct SampledSite {
+    uint64_t hash;
+    uint64_t samples;
+    uint8_t subsystem;
+    uint8_t frameCount;
+    void* frames[MemoryAccounting::kMaxSampledFrames];
+};
+
+SampledSite sampledSiteTable[kSiteCapacity];
+std::mutex sitesMutex;
+
+// Allocations made while alive are not tracked, so the accounting code can
+// allocate without recursing into the sampler
+class HookGuard {
+public:
+    HookGuard() : previous_(inHook) { inHook = true; }
+    ~HookGuard() { inHook = previous_; }
+
+    HookGuard(const HookGuard&) = delete;
+    HookGuard& operator=(const HookGuard&) = delete;
+
+private:
+    bool previous_;
+};
+
+// Spreads samples over [interval / 2, interval * 3 / 2), so allocation
+// patterns repeating at the interval are not always sampled at one site
+int64_t nextSampleDistance(size_t interval) {
+    if (sampleSeed == 0) {
+        sampleSeed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&sampleSeed) >> 4) | 1u;
+    }
+    sampleSeed ^= sampleSeed << 13;
+    sampleSeed ^= sampleSeed >> 17;
+    sampleSeed ^= sampleSeed << 5;
+    return static_cast<int64_t>(interval / 2 + sampleSeed % std::max<size_t>(interval, 1));
+}
+
+void recordSample(uint8_t tag, uint64_t samples) {
+#if APOLLO_HAVE_BACKTRACE
+    HookGuard guard;
+    void* frames[MemoryAccounting::kMaxSampledFrames + kSkippedFrames];
+    int count = backtrace(frames, static_cast<int>(MemoryAccounting::kMaxSampledFrames + kSkippedFrames));
+    int first = std::min(count, kSkippedFrames);
+    uint8_t frameCount = static_cast<uint8_t>(count - first);
+
+    uint64_t hash = 1469598103934665603ull ^ tag;
+    for (int i = first; i < count; ++i) {
+        hash = (hash ^ reinterpret_cast<uintptr_t>(frames[i])) * 1099511628211ull;
+    }
+
+    std::lock_guard<std::mutex> lock(sitesMutex);
+    for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+        SampledSite& site = sampledSiteTable[(hash + probe) % kSiteCapacity];
+        if (site.samples == 0) {
+            site.hash = hash;
+            site.subsystem = tag;
+            site.frameCount = frameCount;
+            std::memcpy(site.frames, frames + first, frameCount * sizeof(void*));
+            site.samples = samples;
+            return;
+        }
+        if (site.hash == hash && site.subsystem == tag && site.frameCount == frameCount &&
+            std::memcmp(site.frames, frames + first, frameCount * sizeof(void*)) == 0) {
+            site.samples += samples;
+            return;
+        }
+    }
+    // The table is crowded around this hash; the sample is lost
+#else
+    (void)tag;
+    (void)samples;
+#endif
+}
+
+void appendMetric(std::string& out, const char* name, const std::string& labels, const std::string& value) {
+    out += name;
+    out += '{';
+    out += labels;
+    out += "} ";
+    out += value;
+    out += '\n';
+}
+
+void appendHeader(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+std::string tabLabel(uint64_t tab) {
+    return tab == MemoryAccounting::kProcessTab ? std::string("process") : std::to_string(tab);
+}
+
+} // namespace
+
+const char* memorySubsystemName(MemorySubsystem subsystem) {
+    size_t index = static_cast<size_t>(subsystem);
+    return index < kMemorySubsystemCount ? kSubsystemNames[index] : "unknown";
+}
+
+bool memorySubsystemFromName(const std::string& name, MemorySubsystem& subsystem) {
+    for (size_t index = 0; index < kMemorySubsystemCount; ++index) {
+        if (name == kSubsystemNames[index]) {
+            subsystem = static_cast<MemorySubsystem>(index);
+            return true;
+        }
+    }
+    return false;
+}
+
+// MemoryAccounting implementation
+MemoryAccounting& MemoryAccounting::shared() {
+    static MemoryAccounting accounting;
+    return accounting;
+}
+
+MemoryAccounting::MemoryAccounting()
+    : mutex_()
+    , reporters_()
+    , nextId_(1) {
+}
+
+uint64_t MemoryAccounting::addReporter(MemorySubsystem subsystem, uint64_t tab, Reporter reporter) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t id = nextId_++;
+    reporters_.push_back(Entry{id, subsystem, tab, std::move(reporter)});
+    return id;
+}
+
+void MemoryAccounting::removeReporter(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reporters_.erase(std::remove_if(reporters_.begin(), reporters_.end(),
+                                    [id](const Entry& entry) { return entry.id == id; }),
+                     reporters_.end());
+}
+
+void MemoryAccounting::removeTab(uint64_t tab) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reporters_.erase(std::remove_if(reporters_.begin(), reporters_.end(),
+                                    [tab](const Entry& entry) { return entry.tab == tab; }),
+                     reporters_.end());
+}
+
+std::vector<MemoryAccounting::Usage> MemoryAccounting::usage() const {
+    std::vector<Entry> reporters;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reporters = reporters_;
+    }
+
+    // By tab, then subsystem
+    std::map<std::pair<uint64_t, uint8_t>, size_t> totals;
+    for (const Entry& entry : reporters) {
+        size_t bytes = entry.reporter ? entry.reporter() : 0;
+        totals[{entry.tab, static_cast<uint8_t>(entry.subsystem)}] += bytes;
+    }
+
+    std::vector<Usage> result;
+    result.reserve(totals.size());
+    for (const auto& total : totals) {
+        result.push_back(Usage{static_cast<MemorySubsystem>(total.first.second), total.first.first, total.second});
+    }
+    return result;
+}
+
+size_t MemoryAccounting::totalBytes(uint64_t tab) const {
+    size_t total = 0;
+    for (const Usage& entry : usage()) {
+        if (entry.tab == tab) total += entry.bytes;
+    }
+    return total;
+}
+
+bool MemoryAccounting::trackingAvailable() {
+#if defined(APOLLO_MEMORY_TRACKING)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MemoryAccounting::setTracking(bool enabled, size_t sampleInterval) {
+    if (!trackingAvailable()) return;
+#if APOLLO_HAVE_BACKTRACE
+    if (enabled && sampleInterval) {
+        // The first backtrace() loads the unwinder; not from inside a hook
+        void* frame;
+        backtrace(&frame, 1);
+    }
+#endif
+    samplingInterval.store(enabled ? sampleInterval : 0, std::memory_order_relaxed);
+    trackingEnabled.store(enabled, std::memory_order_release);
+}
+
+bool MemoryAccounting::isTracking() const {
+    return trackingEnabled.load(std::memory_order_relaxed);
+}
+
+MemoryAccounting::TrackedUsage MemoryAccounting::tracked(MemorySubsystem subsystem) const {
+    TrackedUsage result;
+    size_t index = static_cast<size_t>(subsystem);
+    if (index >= kMemorySubsystemCount) return result;
+    result.liveBytes = liveBytes[index].load(std::memory_order_relaxed);
+    result.allocations = allocationCounts[index].load(std::memory_order_relaxed);
+    result.frees = freeCounts[index].load(std::memory_order_relaxed);
+    return result;
+}
+
+std::vector<MemoryAccounting::Site> MemoryAccounting::sampledSites(size_t limit) const {
+    HookGuard guard;
+    size_t interval = samplingInterval.load(std::memory_order_relaxed);
+    std::vector<SampledSite> sites;
+    {
+        std::lock_guard<std::mutex> lock(sitesMutex);
+        for (const SampledSite& site : sampledSiteTable) {
+            if (site.samples) sites.push_back(site);
+        }
+    }
+    std::sort(sites.begin(), sites.end(),
+              [](const SampledSite& a, const SampledSite& b) { return a.samples > b.samples; });
+    if (sites.size() > limit) sites.resize(limit);
+
+    std::vector<Site> result;
+    result.reserve(sites.size());
+    for (const SampledSite& sampled : sites) {
+        Site site;
+        site.subsystem = sampled.subsystem < kMemorySubsystemCount ? static_cast<MemorySubsystem>(sampled.subsystem)
+                                                                   : MemorySubsystem::Other;
+        site.samples = sampled.samples;
+        site.bytes = static_cast<size_t>(sampled.samples * interval);
+        for (uint8_t i = 0; i < sampled.frameCount; ++i) {
+            site.frames.push_back(reinterpret_cast<uintptr_t>(sampled.frames[i]));
+        }
+        site.symbols.resize(sampled.frameCount);
+#if APOLLO_HAVE_BACKTRACE
+        if (char** symbols = backtrace_symbols(sampled.frames, sampled.frameCount)) {
+            for (uint8_t i = 0; i < sampled.frameCount; ++i) {
+                site.symbols[i] = symbols[i];
+            }
+            std::free(symbols);
+        }
+#endif
+        result.push_back(std::move(site));
+    }
+    return result;
+}
+
+void MemoryAccounting::resetSamples() {
+    std::lock_guard<std::mutex> lock(sitesMutex);
+    for (SampledSite& site : sampledSiteTable) {
+        site.samples = 0;
+    }
+}
+
+std::string MemoryAccounting::prometheusText() const {
+    std::string out;
+    appendHeader(out, "browser_engine_subsystem_memory_bytes", "gauge",
+                 "Bytes each subsystem reports holding, per tab");
+    for (const Usage& entry : usage()) {
+        std::string labels = std::string("subsystem=\"") + memorySubsystemName(entry.subsystem) + "\",tab=\"" +
+                             tabLabel(entry.tab) + "\"";
+        appendMetric(out, "browser_engine_subsystem_memory_bytes", labels, std::to_string(entry.bytes));
+    }
+
+    if (!trackingAvailable()) return out;
+    appendHeader(out, "browser_engine_tracked_memory_bytes", "gauge",
+                 "Live operator new bytes, by the subsystem that allocated them");
+    for (size_t index = 0; index < kMemorySubsystemCount; ++index) {
+        appendMetric(out, "browser_engine_tracked_memory_bytes",
+                     std::string("subsystem=\"") + kSubsystemNames[index] + "\"",
+                     std::to_string(liveBytes[index].load(std::memory_order_relaxed)));
+    }
+    appendHeader(out, "browser_engine_tracked_allocations_total", "counter",
+                 "Operator new calls, by the subsystem that made them");
+    for (size_t index = 0; index < kMemorySubsystemCount; ++index) {
+        appendMetric(out, "browser_engine_tracked_allocations_total",
+                     std::string("subsystem=\"") + kSubsystemNames[index] + "\"",
+                     std::to_string(allocationCounts[index].load(std::memory_order_relaxed)));
+    }
+    return out;
+}
+
+MemoryAccounting::Scope::Scope(MemorySubsystem subsystem) : previous_(threadTag) {
+    threadTag = static_cast<uint8_t>(subsystem);
+}
+
+MemoryAccounting::Scope::~Scope() {
+    threadTag = previous_;
+}
+
+uint8_t MemoryAccounting::noteAllocation(size_t size) {
+    if (!trackingEnabled.load(std::memory_order_relaxed) || inHook) return kUntracked;
+
+    uint8_t tag = threadTag;
+    liveBytes[tag].fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    allocationCounts[tag].fetch_add(1, std::memory_order_relaxed);
+
+    size_t interval = samplingInterval.load(std::memory_order_relaxed);
+    if (interval) {
+        if (sampleSeed == 0) bytesUntilSample = nextSampleDistance(interval);
+        bytesUntilSample -= static_cast<int64_t>(size);
+        if (bytesUntilSample <= 0) {
+            // A block spanning several intervals stands for as many samples
+            uint64_t samples = 1 + static_cast<uint64_t>(-bytesUntilSample) / interval;
+            bytesUntilSample = nextSampleDistance(interval);
+            recordSample(tag, samples);
+        }
+    }
+    return tag;
+}
+
+void MemoryAccounting::noteFree(uint8_t tag, size_t size) {
+    if (tag >= kMemorySubsystemCount) return;
+    liveBytes[tag].fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+    freeCounts[tag].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Reporters
+void reportSharedCaches(MemoryAccounting& accounting) {
+    uint64_t tab = MemoryAccounting::kProcessTab;
+    accounting.addReporter(MemorySubsystem::JSAst, tab, [] { return js::Arena::getTotalBytesReserved(); });
+    accounting.addReporter(MemorySubsystem::LayoutCaches, tab,
+                           [] { return layout::TextRunCache::shared().memoryUsage(); });
+    accounting.addReporter(MemorySubsystem::GlyphCache, tab,
+                           [] { return renderer::GlyphCache::shared().stats().atlasBytes; });
+    accounting.addReporter(MemorySubsystem::PathCache, tab,
+                           [] { return renderer::PathCache::shared()->stats().bytes; });
+    accounting.addReporter(MemorySubsystem::ShadowCache, tab,
+                           [] { return renderer::ShadowCache::shared()->stats().bytes; });
+    accounting.addReporter(MemorySubsystem::ImageCache, tab,
+                           [] { return renderer::ScaledImageCache::shared()->stats().bytes; });
+    accounting.addReporter(MemorySubsystem::PathCache, tab,
+                           [] { return renderer::ClipMaskCache::shared()->stats().bytes; });
+}
+
+void reportTab(uint64_t tab, const js::JavaScriptEngine* engine, const layout::LayoutTree* tree,
+               const renderer::ImageCache* images, MemoryAccounting& accounting) {
+    if (engine) {
+        accounting.addReporter(MemorySubsystem::JSHeap, tab, [engine] { return engine->getHeapSize(); });
+        accounting.addReporter(MemorySubsystem::JSAst, tab, [engine] { return engine->getModuleRecordSize(); });
+    }
+    if (tree) {
+        accounting.addReporter(MemorySubsystem::LayoutTree, tab, [tree] { return tree->arena().memoryUsage(); });
+    }
+    if (images) {
+        accounting.addReporter(MemorySubsystem::ImageCache, tab, [images] { return images->byteSize(); });
+    }
+}
+
+void reportRasterizer(uint64_t tab, const renderer::SoftwareRasterizer& rasterizer, MemoryAccounting& accounting) {
+    const renderer::SoftwareRasterizer* raster = &rasterizer;
+    accounting.addReporter(MemorySubsystem::GlyphCache, tab, [raster] {
+        const auto& cache = raster->glyphCache();
+        return cache ? cache->stats().atlasBytes : 0;
+    });
+}
+
+} // namespace apollo
+
+// C API
+extern "C" {
+
+size_t apollo_memory_usage(ApolloMemoryUsage* entries, size_t capacity) {
+    std::vector<apollo::MemoryAccounting::Usage> usage = apollo::MemoryAccounting::shared().usage();
+    for (size_t i = 0; i < usage.size() && i < capacity; ++i) {
+        entries[i].subsystem = apollo::memorySubsystemName(usage[i].subsystem);
+        entries[i].tab = usage[i].tab;
+        entries[i].bytes = usage[i].bytes;
+    }
+    return usage.size();
+}
+
+size_t apollo_memory_prometheus(char* buffer, size_t capacity) {
+    std::string text = apollo::MemoryAccounting::shared().prometheusText();
+    if (buffer && capacity) {
+        size_t length = std::min(text.size(), capacity - 1);
+        std::memcpy(buffer, text.data(), length);
+        buffer[length] = '\0';
+    }
+    return text.size();
+}
+
+int apollo_memory_set_tracking(int enabled, size_t sample_interval) {
+    if (!apollo::MemoryAccounting::trackingAvailable()) return 0;
+    apollo::MemoryAccounting::shared().setTracking(enabled != 0, sample_interval);
+    return 1;
+}
+
+int64_t apollo_memory_tracked_bytes(const char* subsystem) {
+    apollo::MemorySubsystem value;
+    if (!subsystem || !apollo::memorySubsystemFromName(subsystem, value)) return 0;
+    return apollo::MemoryAccounting::shared().tracked(value).liveBytes;
+}
+
+} // extern "C"
+
+#if defined(APOLLO_MEMORY_TRACKING)
+
+// Operator new replacement: each block is preceded by its size and tag.
+// The aligned forms are left to the runtime, which pairs them with its own
+// aligned deletes; their blocks are not tracked.
+namespace {
+
+struct alignas(std::max_align_t) BlockHeader {
+    size_t size;
+    uint8_t tag;
+};
+
+void* trackedAllocate(size_t size) noexcept {
+    void* block = std::malloc(sizeof(BlockHeader) + size);
+    if (!block) return nullptr;
+    BlockHeader* header = static_cast<BlockHeader*>(block);
+    header->size = size;
+    header->tag = apollo::MemoryAccounting::noteAllocation(size);
+    return header + 1;
+}
+
+void* trackedAllocateOrThrow(size_t size) {
+    for (;;) {
+        if (void* pointer = trackedAllocate(size ? size : 1)) return pointer;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void trackedFree(void* pointer) noexcept {
+    if (!pointer) return;
+    BlockHeader* header = static_cast<BlockHeader*>(pointer) - 1;
+    apollo::MemoryAccounting::noteFree(header->tag, header->size);
+    std::free(header);
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    return trackedAllocateOrThrow(size);
+}
+
+void* operator new[](size_t size) {
+    return trackedAllocateOrThrow(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    trackedFree(pointer);
+}
+
+#endif
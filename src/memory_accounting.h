@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace js {
+class JavaScriptEngine;
+}
+
+namespace layout {
+class LayoutTree;
+}
+
+namespace renderer {
+class ImageCache;
+class SoftwareRasterizer;
+}
+
+namespace apollo {
+
+enum class MemorySubsystem : uint8_t {
+    JSHeap,
+    // Parsed scripts, held in their arenas, and loaded module records
+    JSAst,
+    LayoutTree,
+    // Text runs and other layout caches
+    LayoutCaches,
+    DisplayLists,
+    Raster,
+    GlyphCache,
+    ImageCache,
+    PathCache,
+    ShadowCache,
+    Other,
+};
+
+constexpr size_t kMemorySubsystemCount = static_cast<size_t>(MemorySubsystem::Other) + 1;
+
+// Snake-case name, as exported to metrics
+const char* memorySubsystemName(MemorySubsystem subsystem);
+// false when name is no subsystem's
+bool memorySubsystemFromName(const std::string& name, MemorySubsystem& subsystem);
+
+// Memory held by each subsystem, per tab
+//
+// Two views are kept. Reporters are callbacks asking a subsystem what it
+// holds, such as a JS engine's heap size or a cache's bytes; they are
+// registered per tab, or for the whole process with kProcessTab, and asked
+// on every usage() call. Allocation tracking counts live operator new bytes
+// by the subsystem tagged on the allocating thread with a Scope. It needs
+// the build to replace operator new (APOLLO_MEMORY_TRACKING) and costs a
+// header per allocation; when also sampling, about one allocation per
+// interval bytes records its call stack, so the heaviest allocation sites
+// can be listed in an OOM investigation.
+class MemoryAccounting {
+public:
+    using Reporter = std::function<size_t()>;
+
+    static constexpr uint64_t kProcessTab = 0;
+    static constexpr size_t kDefaultSampleInterval = 512 * 1024;
+    static constexpr size_t kMaxSampledFrames = 16;
+
+    static MemoryAccounting& shared();
+
+    MemoryAccounting();
+
+    MemoryAccounting(const MemoryAccounting&) = delete;
+    MemoryAccounting& operator=(const MemoryAccounting&) = delete;
+
+    // Returns an id for removeReporter(); reporters are called without
+    // locks held, from the thread asking for usage
+    uint64_t addReporter(MemorySubsystem subsystem, uint64_t tab, Reporter reporter);
+    void removeReporter(uint64_t id);
+    void removeTab(uint64_t tab);
+
+    struct Usage {
+        MemorySubsystem subsystem;
+        uint64_t tab;
+        size_t bytes;
+    };
+    // Reporters of one subsystem and tab are summed into one entry
+    std::vector<Usage> usage() const;
+    size_t totalBytes(uint64_t tab) const;
+
+    // Allocation tracking; sampleInterval 0 tracks without sampling
+    static bool trackingAvailable();
+    void setTracking(bool enabled, size_t sampleInterval = 0);
+    bool isTracking() const;
+
+    struct TrackedUsage {
+        // Negative while frees of blocks allocated before tracking started
+        // outweigh those made since
+        int64_t liveBytes = 0;
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+    };
+    TrackedUsage tracked(MemorySubsystem subsystem) const;
+
+    struct Site {
+        MemorySubsystem subsystem;
+        // Innermost first; symbols are empty where they cannot be resolved
+        std::vector<uintptr_t> frames;
+        std::vector<std::string> symbols;
+        uint64_t samples;
+        // Estimated allocated bytes: samples times the interval
+        size_t bytes;
+    };
+    // Heaviest sites first
+    std::vector<Site> sampledSites(size_t limit = 20) const;
+    void resetSamples();
+
+    // Usage and tracked counters in the Prometheus text format
+    std::string prometheusText() const;
+
+    // Tags allocations made on this thread while alive
+    class Scope {
+    public:
+        explicit Scope(MemorySubsystem subsystem);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        uint8_t previous_;
+    };
+
+    // Called by the operator new replacement: the tag to store with a
+    // block of size bytes, and its release
+    static uint8_t noteAllocation(size_t size);
+    static void noteFree(uint8_t tag, size_t size);
+
+private:
+    struct Entry {
+        uint64_t id;
+        MemorySubsystem subsystem;
+        uint64_t tab;
+        Reporter reporter;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> reporters_;
+    uint64_t nextId_;
+};
+
+// Registers the process-wide caches: AST arenas, text runs, and the shared
+// glyph, path and shadow caches. Scaled images count as image cache, and
+// clip masks, which are rasterized paths too, as path cache.
+void reportSharedCaches(MemoryAccounting& accounting = MemoryAccounting::shared());
+// Registers what a tab owns; any may be null. Each must outlive its
+// reporters, which removeTab(tab) removes.
+void reportTab(uint64_t tab, const js::JavaScriptEngine* engine, const layout::LayoutTree* tree,
+               const renderer::ImageCache* images, MemoryAccounting& accounting = MemoryAccounting::shared());
+// Registers the glyph atlas of a tab's rasterizer
+void reportRasterizer(uint64_t tab, const renderer::SoftwareRasterizer& rasterizer,
+                      MemoryAccounting& accounting = MemoryAccounting::shared());
+
+} // namespace apollo
@@ -0,0 +1,267 @@
+#include "memory_pressure.h"
+#include "js/engine.h"
+#include "layout/layout_node.h"
+#include "layout/text_run_cache.h"
+#include "renderer/clip_mask.h"
+#include "renderer/compositor.h"
+#include "renderer/image_cache.h"
+#include "renderer/image_scaler.h"
+#include "renderer/path_cache.h"
+#include "renderer/shadow_cache.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <utility>
+
+namespace apollo {
+
+namespace {
+
+// Limits at least this large mean none was set
+constexpr size_t kUnlimited = size_t(1) << 60;
+
+bool readCounter(const char* path, size_t& value) {
+    std::ifstream file(path);
+    std::string text;
+    if (!(file >> text) || text == "max") return false;
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+    if (!end || *end) return false;
+    value = static_cast<size_t>(parsed);
+    return true;
+}
+
+// What a cache of budget keeps at level
+size_t retainedShare(size_t budget, MemoryPressureLevel level, double fraction) {
+    if (level == MemoryPressureLevel::Critical) return 0;
+    return static_cast<size_t>(budget * fraction);
+}
+
+} // namespace
+
+// MemoryPressure implementation
+MemoryPressure& MemoryPressure::shared() {
+    static MemoryPressure pressure;
+    return pressure;
+}
+
+MemoryPressure::MemoryPressure()
+    : mutex_()
+    , handlers_()
+    , background_()
+    , retainFraction_(kDefaultRetainFraction)
+    , nextId_(1)
+    , stats_()
+    , pending_(static_cast<uint8_t>(MemoryPressureLevel::None)) {
+}
+
+double MemoryPressure::retainFraction() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return retainFraction_;
+}
+
+void MemoryPressure::setRetainFraction(double fraction) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retainFraction_ = std::clamp(fraction, 0.0, 1.0);
+}
+
+uint64_t MemoryPressure::addHandler(uint64_t tab, Handler handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t id = nextId_++;
+    handlers_.push_back(Entry{id, tab, std::move(handler)});
+    return id;
+}
+
+void MemoryPressure::removeHandler(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handlers_.erase(std::remove_if(handlers_.begin(), handlers_.end(),
+                                   [id](const Entry& entry) { return entry.id == id; }),
+                    handlers_.end());
+}
+
+void MemoryPressure::removeTab(uint64_t tab) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handlers_.erase(std::remove_if(handlers_.begin(), handlers_.end(),
+                                   [tab](const Entry& entry) { return entry.tab == tab; }),
+                    handlers_.end());
+    background_.erase(tab);
+}
+
+bool MemoryPressure::isBackground(uint64_t tab) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return background_.count(tab) != 0;
+}
+
+void MemoryPressure::setBackground(uint64_t tab, bool background) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (background) {
+        background_.insert(tab);
+    } else {
+        background_.erase(tab);
+    }
+}
+
+void MemoryPressure::onMemoryPressure(MemoryPressureLevel level) {
+    if (level == MemoryPressureLevel::None) return;
+
+    std::vector<Entry> handlers;
+    double fraction;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handlers = handlers_;
+        fraction = retainFraction_;
+        if (level == MemoryPressureLevel::Critical) {
+            ++stats_.critical;
+        } else {
+            ++stats_.moderate;
+        }
+    }
+    // Handlers may take their own locks, or call back in
+    for (const Entry& entry : handlers) {
+        if (entry.handler) entry.handler(level, fraction);
+    }
+}
+
+void MemoryPressure::notify(MemoryPressureLevel level) {
+    uint8_t value = static_cast<uint8_t>(level);
+    uint8_t pending = pending_.load(std::memory_order_relaxed);
+    while (pending < value && !pending_.compare_exchange_weak(pending, value, std::memory_order_relaxed)) {
+    }
+}
+
+bool MemoryPressure::dispatchPending() {
+    if (pending_.load(std::memory_order_relaxed) == static_cast<uint8_t>(MemoryPressureLevel::None)) return false;
+    auto level = static_cast<MemoryPressureLevel>(
+        pending_.exchange(static_cast<uint8_t>(MemoryPressureLevel::None), std::memory_order_relaxed));
+    if (level == MemoryPressureLevel::None) return false;
+    onMemoryPressure(level);
+    return true;
+}
+
+MemoryPressure::Stats MemoryPressure::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+// Handlers
+void handleSharedCaches(MemoryPressure& pressure) {
+    pressure.addHandler(MemoryPressure::kProcessTab, [](MemoryPressureLevel level, double fraction) {
+        layout::TextRunCache& runs = layout::TextRunCache::shared();
+        runs.purge(retainedShare(runs.capacity(), level, fraction));
+        auto paths = renderer::PathCache::shared();
+        paths->purge(retainedShare(paths->budget(), level, fraction));
+        auto shadows = renderer::ShadowCache::shared();
+        shadows->purge(retainedShare(shadows->budget(), level, fraction));
+        auto scaled = renderer::ScaledImageCache::shared();
+        scaled->purge(retainedShare(scaled->budget(), level, fraction));
+        auto clips = renderer::ClipMaskCache::shared();
+        clips->purge(retainedShare(clips->budget(), level, fraction));
+    });
+}
+
+void handleTab(uint64_t tab, js::JavaScriptEngine* engine, layout::LayoutTree* tree, renderer::ImageCache* images,
+               renderer::Compositor* compositor, MemoryPressure& pressure) {
+    if (engine) {
+        pressure.addHandler(tab, [engine](MemoryPressureLevel level, double) {
+            engine->onMemoryPressure(level == MemoryPressureLevel::Critical);
+        });
+    }
+    if (tree) {
+        pressure.addHandler(tab, [tree](MemoryPressureLevel level, double) {
+            if (level == MemoryPressureLevel::Critical) tree->releaseMeasurementCaches();
+        });
+    }
+    if (images) {
+        pressure.addHandler(tab, [images](MemoryPressureLevel level, double fraction) {
+            images->purge(retainedShare(images->budget(), level, fraction));
+        });
+    }
+    if (compositor) {
+        MemoryPressure* owner = &pressure;
+        pressure.addHandler(tab, [owner, tab, compositor](MemoryPressureLevel, double) {
+            if (owner->isBackground(tab)) compositor->releaseLayerCaches();
+        });
+    }
+}
+
+// MemoryPressureMonitor implementation
+MemoryPressureMonitor::MemoryPressureMonitor(MemoryPressure& pressure)
+    : MemoryPressureMonitor(pressure, Options()) {
+}
+
+MemoryPressureMonitor::MemoryPressureMonitor(MemoryPressure& pressure, Options options)
+    : pressure_(pressure)
+    , options_(options)
+    , mutex_()
+    , stopped_()
+    , stopRequested_(false)
+    , level_(MemoryPressureLevel::None)
+    , thread_() {
+    thread_ = std::thread(&MemoryPressureMonitor::pollLoop, this);
+}
+
+MemoryPressureMonitor::~MemoryPressureMonitor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    stopped_.notify_all();
+    thread_.join();
+}
+
+MemoryPressureLevel MemoryPressureMonitor::level() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return level_;
+}
+
+bool MemoryPressureMonitor::readCgroupMemory(size_t& current, size_t& limit) {
+#if defined(__linux__)
+    if (readCounter("/sys/fs/cgroup/memory.max", limit) && readCounter("/sys/fs/cgroup/memory.current", current)) {
+        return limit < kUnlimited;
+    }
+    if (readCounter("/sys/fs/cgroup/memory/memory.limit_in_bytes", limit) &&
+        readCounter("/sys/fs/cgroup/memory/memory.usage_in_bytes", current)) {
+        return limit < kUnlimited;
+    }
+#else
+    (void)current;
+    (void)limit;
+#endif
+    return false;
+}
+
+void MemoryPressureMonitor::pollLoop() {
+    using Clock = std::chrono::steady_clock;
+    MemoryPressureLevel posted = MemoryPressureLevel::None;
+    Clock::time_point postedAt;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopRequested_) {
+        lock.unlock();
+        size_t current = 0;
+        size_t limit = 0;
+        MemoryPressureLevel level = MemoryPressureLevel::None;
+        if (readCgroupMemory(current, limit) && limit > 0) {
+            double ratio = static_cast<double>(current) / static_cast<double>(limit);
+            if (ratio >= options_.criticalRatio) {
+                level = MemoryPressureLevel::Critical;
+            } else if (ratio >= options_.moderateRatio) {
+                level = MemoryPressureLevel::Moderate;
+            }
+        }
+
+        Clock::time_point now = Clock::now();
+        if (level != MemoryPressureLevel::None && (level > posted || now - postedAt >= options_.repeatInterval)) {
+            pressure_.notify(level);
+            postedAt = now;
+        }
+        posted = level;
+
+        lock.lock();
+        level_ = level;
+        stopped_.wait_for(lock, options_.interval, [&] { return stopRequested_; });
+    }
+}
+
+} // namespace apollo
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace js {
+class JavaScriptEngine;
+}
+
+namespace layout {
+class LayoutTree;
+}
+
+namespace renderer {
+class Compositor;
+class ImageCache;
+}
+
+namespace apollo {
+
+enum class MemoryPressureLevel : uint8_t {
+    None,
+    Moderate,
+    Critical,
+};
+
+// Sheds cache memory when the process nears its memory limit
+//
+// onMemoryPressure() runs every handler on the calling thread. Under
+// moderate pressure caches shrink to retainFraction() of their budget, the
+// JS heap is collected in full and background tabs drop their retained
+// layers; under critical pressure caches drop everything not in use, the
+// heap also frees its spare blocks and layout trees their measurement
+// caches. Handlers are registered per tab, like MemoryAccounting's
+// reporters.
+//
+// Tabs are trimmed on the thread that owns them, so pressure seen anywhere
+// else, as by a MemoryPressureMonitor, is posted with notify() and handled
+// by the next dispatchPending(), which engineStages() frames call first.
+class MemoryPressure {
+public:
+    using Handler = std::function<void(MemoryPressureLevel level, double retainFraction)>;
+
+    static constexpr uint64_t kProcessTab = 0;
+    static constexpr double kDefaultRetainFraction = 0.5;
+
+    static MemoryPressure& shared();
+
+    MemoryPressure();
+
+    MemoryPressure(const MemoryPressure&) = delete;
+    MemoryPressure& operator=(const MemoryPressure&) = delete;
+
+    double retainFraction() const;
+    void setRetainFraction(double fraction);
+
+    // Returns an id for removeHandler()
+    uint64_t addHandler(uint64_t tab, Handler handler);
+    void removeHandler(uint64_t id);
+    // Also forgets whether the tab is in the background
+    void removeTab(uint64_t tab);
+
+    bool isBackground(uint64_t tab) const;
+    void setBackground(uint64_t tab, bool background);
+
+    void onMemoryPressure(MemoryPressureLevel level);
+
+    // Safe from any thread; the highest level posted since the last
+    // dispatch is the one handled
+    void notify(MemoryPressureLevel level);
+    // Returns whether there was pressure to handle
+    bool dispatchPending();
+
+    struct Stats {
+        uint64_t moderate = 0;
+        uint64_t critical = 0;
+    };
+    Stats stats() const;
+
+private:
+    struct Entry {
+        uint64_t id;
+        uint64_t tab;
+        Handler handler;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> handlers_;
+    std::set<uint64_t> background_;
+    double retainFraction_;
+    uint64_t nextId_;
+    Stats stats_;
+    std::atomic<uint8_t> pending_;
+};
+
+// Trims the process-wide caches: text runs and the shared path, shadow,
+// scaled image and clip mask caches
+void handleSharedCaches(MemoryPressure& pressure = MemoryPressure::shared());
+// Trims what a tab owns; any may be null. Each must outlive its handlers,
+// which removeTab(tab) removes. The compositor's layers are only dropped
+// while the tab is in the background.
+void handleTab(uint64_t tab, js::JavaScriptEngine* engine, layout::LayoutTree* tree, renderer::ImageCache* images,
+               renderer::Compositor* compositor, MemoryPressure& pressure = MemoryPressure::shared());
+
+// Watches the container's memory use against its cgroup limit
+//
+// A thread polls the cgroup (v2, or v1 memory controller) every interval
+// and posts Moderate or Critical pressure once use passes those fractions
+// of the limit, again whenever the level rises, and every repeatInterval
+// while it stays there. Processes without a limit are never under
+// pressure.
+class MemoryPressureMonitor {
+public:
+    struct Options {
+        double moderateRatio = 0.8;
+        double criticalRatio = 0.95;
+        std::chrono::milliseconds interval{1000};
+        std::chrono::milliseconds repeatInterval{10000};
+    };
+
+    explicit MemoryPressureMonitor(MemoryPressure& pressure = MemoryPressure::shared());
+    MemoryPressureMonitor(MemoryPressure& pressure, Options options);
+    ~MemoryPressureMonitor();
+
+    MemoryPressureMonitor(const MemoryPressureMonitor&) = delete;
+    MemoryPressureMonitor& operator=(const MemoryPressureMonitor&) = delete;
+
+    // Of the last poll
+    MemoryPressureLevel level() const;
+
+    // false when the process has no memory limit to watch
+    static bool readCgroupMemory(size_t& current, size_t& limit);
+
+private:
+    MemoryPressure& pressure_;
+    Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable stopped_;
+    bool stopRequested_;
+    MemoryPressureLevel level_;
+    std::thread thread_;
+
+    void pollLoop();
+};
+
+} // namespace apollo
@@ -0,0 +1,249 @@
+//! Flat node records for the layout engine's bulk tree build
+//!
+//! Mirrors `layout/include/layout/layout_records.h`. The resolver pushes one
+//! record per box in tree order into a `LayoutRecordBuffer` sized up front,
+//! and the engine hands `records()` and `text()` to
+//! `apollo_layout_tree_adopt` in a single call, so building the layout tree
+//! crosses the language boundary once instead of once per node.
+
+/// Parent index of the root record
+pub const NO_PARENT: u32 = 0xFFFF_FFFF;
+
+/// Record flags
+pub const REPLACED: u8 = 0x01;
+pub const ANONYMOUS: u8 = 0x02;
+pub const INSET_TOP: u8 = 0x04;
+pub const INSET_RIGHT: u8 = 0x08;
+pub const INSET_BOTTOM: u8 = 0x10;
+pub const INSET_LEFT: u8 = 0x20;
+
+/// Layout's `Display`, in its order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LayoutDisplay {
+    None,
+    Block,
+    Inline,
+    InlineBlock,
+    Flex,
+    InlineFlex,
+    Grid,
+    InlineGrid,
+    Table,
+    InlineTable,
+    TableRow,
+    TableCell,
+    TableColumn,
+    TableColumnGroup,
+    TableRowGroup,
+    TableHeaderGroup,
+    TableFooterGroup,
+    TableCaption,
+    ListItem,
+    RunIn,
+    Compact,
+    Marker,
+    Contents,
+}
+
+/// Layout's `Position`, in its order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LayoutPosition {
+    Static,
+    Relative,
+    Absolute,
+    Fixed,
+    Sticky,
+}
+
+/// Layout's `Float`, in its order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LayoutFloat {
+    None,
+    Left,
+    Right,
+}
+
+/// Layout's `Clear`, in its order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LayoutClear {
+    None,
+    Left,
+    Right,
+    Both,
+}
+
+/// Layout's `Visibility`, in its order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LayoutVisibility {
+    Visible,
+    Hidden,
+    Collapse,
+}
+
+/// Layout's `Overflow`, in its order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LayoutOverflow {
+    Visible,
+    Hidden,
+    Scroll,
+    Auto,
+}
+
+/// Layout's `BoxSizing`, in its order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LayoutBoxSizing {
+    ContentBox,
+    BorderBox,
+}
+
+/// One box; lengths are CSS pixels, top, right, bottom, left
+#[derive(Debug, Clone, Copy, PartialEq)]
+#[repr(C)]
+pub struct LayoutRecord {
+    pub parent: u32,
+    pub text_offset: u32,
+    pub text_length: u32,
+    pub z_index: i32,
+    pub padding: [f32; 4],
+    pub border: [f32; 4],
+    pub margin: [f32; 4],
+    pub insets: [f32; 4],
+    pub opacity: f32,
+    pub line_height: f32,
+    pub display: u8,
+    pub position: u8,
+    pub float_value: u8,
+    pub clear: u8,
+    pub visibility: u8,
+    pub overflow: u8,
+    pub box_sizing: u8,
+    pub flags: u8,
+}
+
+impl Default for LayoutRecord {
+    fn default() -> Self {
+        Self {
+            parent: NO_PARENT,
+            text_offset: 0,
+            text_length: 0,
+            z_index: 0,
+            padding: [0.0; 4],
+            border: [0.0; 4],
+            margin: [0.0; 4],
+            insets: [0.0; 4],
+            opacity: 1.0,
+            line_height: 0.0,
+            display: LayoutDisplay::Block as u8,
+            position: LayoutPosition::Static as u8,
+            float_value: LayoutFloat::None as u8,
+            clear: LayoutClear::None as u8,
+            visibility: LayoutVisibility::Visible as u8,
+            overflow: LayoutOverflow::Visible as u8,
+            box_sizing: LayoutBoxSizing::ContentBox as u8,
+            flags: 0,
+        }
+    }
+}
+
+/// Records of one tree and the text their spans point into
+#[derive(Debug, Default)]
+pub struct LayoutRecordBuffer {
+    records: Vec<LayoutRecord>,
+    text: String,
+}
+
+impl LayoutRecordBuffer {
+    pub fn with_capacity(nodes: usize, text_bytes: usize) -> Self {
+        Self {
+            records: Vec::with_capacity(nodes),
+            text: String::with_capacity(text_bytes),
+        }
+    }
+
+    /// Appends an element box under parent (`NO_PARENT` for the root) and
+    /// returns its index
+    pub fn push_box(&mut self, parent: u32, mut record: LayoutRecord) -> u32 {
+        record.parent = parent;
+        record.text_offset = 0;
+        record.text_length = 0;
+        self.push(record)
+    }
+
+    /// Appends a text node under parent and returns its index
+    pub fn push_text(&mut self, parent: u32, mut record: LayoutRecord, text: &str) -> u32 {
+        record.parent = parent;
+        record.text_offset = self.text.len() as u32;
+        record.text_length = text.len() as u32;
+        self.text.push_str(text);
+        self.push(record)
+    }
+
+    fn push(&mut self, record: LayoutRecord) -> u32 {
+        let index = self.records.len() as u32;
+        debug_assert!(
+            if index == 0 { record.parent == NO_PARENT } else { record.parent < index },
+            "records must come in tree order"
+        );
+        self.records.push(record);
+        index
+    }
+
+    pub fn records(&self) -> &[LayoutRecord] {
+        &self.records
+    }
+
+    pub fn text(&self) -> &str {
+        &self.text
+    }
+
+    pub fn len(&self) -> usize {
+        self.records.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.records.is_empty()
+    }
+
+    /// Empties the buffer, keeping its capacity for the next tree
+    pub fn clear(&mut self) {
+        self.records.clear();
+        self.text.clear();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_record_layout_matches_c() {
+        assert_eq!(std::mem::size_of::<LayoutRecord>(), 96);
+        assert_eq!(std::mem::align_of::<LayoutRecord>(), 4);
+    }
+
+    #[test]
+    fn test_push_in_tree_order() {
+        let mut buffer = LayoutRecordBuffer::with_capacity(3, 16);
+        let root = buffer.push_box(NO_PARENT, LayoutRecord::default());
+        let paragraph = buffer.push_box(root, LayoutRecord::default());
+        let text = LayoutRecord {
+            display: LayoutDisplay::Inline as u8,
+            ..LayoutRecord::default()
+        };
+        let first = buffer.push_text(paragraph, text, "hello ");
+        let second = buffer.push_text(paragraph, text, "world");
+
+        assert_eq!(buffer.len(), 4);
+        assert_eq!(buffer.records()[first as usize].parent, paragraph);
+        assert_eq!(buffer.text(), "hello world");
+        let span = buffer.records()[second as usize];
+        assert_eq!((span.text_offset, span.text_length), (6, 5));
+    }
+}
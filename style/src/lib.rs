@@ -1,6 +1,7 @@
 pub mod cascade;
 pub mod computed_style;
 pub mod inheritance;
+pub mod layout_records;
 pub mod media_queries;
 pub mod specificity;
 pub mod style_resolver;
@@ -9,6 +10,7 @@ pub mod viewport;
 pub use cascade::Cascade;
 pub use computed_style::ComputedStyle;
 pub use inheritance::Inheritance;
+pub use layout_records::{LayoutRecord, LayoutRecordBuffer};
 pub use media_queries::MediaQueryMatcher;
 pub use specificity::Specificity;
 pub use style_resolver::StyleResolver;
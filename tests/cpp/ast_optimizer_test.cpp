@@ -0,0 +1,76 @@
+// Constant folding of unary operators as the parser builds them
+
+#include "test.h"
+#include "js/ast_optimizer.h"
+#include <memory>
+#include <string>
+#include <utility>
+
+using namespace js;
+
+namespace {
+
+std::unique_ptr<Expression> number(double value) {
+    auto literal = std::make_unique<NumericLiteral>(std::to_string(value), TokenPosition());
+    literal->setValue(value);
+    return literal;
+}
+
+// The parser tags unary - and + with the binary operator types
+std::unique_ptr<Expression> unary(OperatorType op, std::unique_ptr<Expression> argument) {
+    return std::make_unique<UnaryExpression>(op, std::move(argument), TokenPosition());
+}
+
+// Optimizes a program of the one expression statement and returns what
+// the statement holds afterwards
+struct Folded {
+    std::unique_ptr<Program> program;
+    size_t folds = 0;
+
+    explicit Folded(std::unique_ptr<Expression> expression) {
+        NodeList<Statement> body;
+        body.push_back(std::make_unique<ExpressionStatement>(std::move(expression), TokenPosition()));
+        program = std::make_unique<Program>(std::move(body), TokenPosition());
+        ASTOptimizer pass;
+        pass.optimize(program.get());
+        folds = pass.getFoldedCount();
+    }
+
+    Expression* expression() const {
+        return static_cast<ExpressionStatement*>(program->body()[0].get())->expression();
+    }
+
+    // The folded number, or false when the expression is not one
+    bool numberValue(double& value) const {
+        auto* literal = dynamic_cast<NumericLiteral*>(expression());
+        if (!literal) return false;
+        value = literal->value();
+        return true;
+    }
+};
+
+} // namespace
+
+TEST(ast_optimizer_folds_unary_minus) {
+    Folded minusOne(unary(OperatorType::Subtract, number(1)));
+    double value = 0;
+    CHECK(minusOne.numberValue(value) && value == -1);
+    CHECK(minusOne.folds == 1);
+
+    // -(2 * 3)
+    Folded minusProduct(unary(OperatorType::Subtract,
+                              std::make_unique<BinaryExpression>(OperatorType::Multiply, number(2), number(3),
+                                                                 TokenPosition())));
+    CHECK(minusProduct.numberValue(value) && value == -6);
+    CHECK(minusProduct.folds == 2);
+}
+
+TEST(ast_optimizer_folds_unary_plus) {
+    Folded plusTwo(unary(OperatorType::Add, number(2)));
+    double value = 0;
+    CHECK(plusTwo.numberValue(value) && value == 2);
+
+    // -(-4) folds from the inside out
+    Folded doubleMinus(unary(OperatorType::Subtract, unary(OperatorType::Subtract, number(4))));
+    CHECK(doubleMinus.numberValue(value) && value == 4);
+}
@@ -0,0 +1,201 @@
+// Baseline code against the interpreter at the edges its int32 guards
+// cover: negative zero, int32 overflow and the sign of a remainder
+
+#include "test.h"
+#include "js/engine.h"
+#include "js/optimizer.h"
+#include "js/value.h"
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+
+using namespace js;
+
+namespace {
+
+constexpr int32_t kMin = std::numeric_limits<int32_t>::min();
+constexpr int32_t kMax = std::numeric_limits<int32_t>::max();
+
+// Same number, telling -0 from 0 and accepting any NaN
+bool sameNumber(double actual, double expected) {
+    if (std::isnan(expected)) return std::isnan(actual);
+    return actual == expected && std::signbit(actual) == std::signbit(expected);
+}
+
+std::string describe(const std::string& expression, double expected) {
+    return expression + " (expected " + std::to_string(expected) + (std::signbit(expected) ? ", negative" : "") +
+           ")";
+}
+
+struct BinaryCase {
+    Opcode op;
+    const char* source;
+    int32_t left;
+    int32_t right;
+    double expected;
+};
+
+const BinaryCase kBinaryCases[] = {
+    {Opcode::Add, "+", kMax, 1, 2147483648.0},
+    {Opcode::Add, "+", kMin, -1, -2147483649.0},
+    {Opcode::Add, "+", -5, 5, 0.0},
+    {Opcode::Subtract, "-", kMin, 1, -2147483649.0},
+    {Opcode::Subtract, "-", 0, kMin, 2147483648.0},
+    {Opcode::Subtract, "-", 3, 3, 0.0},
+    {Opcode::Multiply, "*", 0, -5, -0.0},
+    {Opcode::Multiply, "*", -4, 0, -0.0},
+    {Opcode::Multiply, "*", 0, 0, 0.0},
+    {Opcode::Multiply, "*", 65536, 65536, 4294967296.0},
+    {Opcode::Multiply, "*", kMin, -1, 2147483648.0},
+    {Opcode::Multiply, "*", -6, 7, -42.0},
+    {Opcode::Modulo, "%", -7, 3, -1.0},
+    {Opcode::Modulo, "%", 7, -3, 1.0},
+    {Opcode::Modulo, "%", -7, -3, -1.0},
+    {Opcode::Modulo, "%", -6, 3, -0.0},
+    {Opcode::Modulo, "%", 6, -3, 0.0},
+    {Opcode::Modulo, "%", 5, 0, std::numeric_limits<double>::quiet_NaN()},
+    {Opcode::Modulo, "%", kMin, -1, -0.0},
+    {Opcode::Modulo, "%", 0, 5, 0.0},
+};
+
+struct UnaryCase {
+    Opcode op;
+    const char* source;
+    int32_t operand;
+    double expected;
+};
+
+const UnaryCase kUnaryCases[] = {
+    {Opcode::Negate, "-x", 0, -0.0},
+    {Opcode::Negate, "-x", kMin, 2147483648.0},
+    {Opcode::Negate, "-x", 5, -5.0},
+    {Opcode::Increment, "x + 1", kMax, 2147483648.0},
+    {Opcode::Decrement, "x - 1", kMin, -2147483649.0},
+    {Opcode::Decrement, "x - 1", 1, 0.0},
+};
+
+// Completion value of source as a number, on an engine with the baseline
+// tier on or off
+bool evaluate(const std::string& source, bool optimize, double& result) {
+    JavaScriptEngine engine;
+    engine.initialize();
+    if (optimize) {
+        engine.enableOptimization();
+    } else {
+        engine.disableOptimization();
+    }
+    std::unique_ptr<Value> value = engine.execute(source);
+    bool ok = value && value->isNumber();
+    if (ok) result = value->toNumber();
+    engine.shutdown();
+    return ok;
+}
+
+// Source calling the function f(x, y) { return body } often enough to
+// tier it up on int32 arguments before calling it with the edge ones
+std::string warmedCall(const std::string& body, int32_t x, int32_t y) {
+    return "function f(x, y) { return " + body + "; }\n"
+           "var r = 0;\n"
+           "for (var i = 0; i < 300; i++) r = f(i % 7 + 1, 3);\n"
+           "f(" + std::to_string(x) + ", " + std::to_string(y) + ");\n";
+}
+
+void checkBothTiers(const std::string& source, double expected, const std::string& what) {
+    double interpreted = 0;
+    double optimized = 0;
+    CHECK_WHAT(evaluate(source, false, interpreted), what + " interpreted");
+    CHECK_WHAT(evaluate(source, true, optimized), what + " optimized");
+    CHECK_WHAT(sameNumber(interpreted, expected), what + " interpreted");
+    CHECK_WHAT(sameNumber(optimized, interpreted), what + " optimized");
+}
+
+// Runs a one-instruction function on regs[0] and regs[1]; true when the
+// baseline code computed regs[2] itself rather than leaving to the
+// interpreter
+bool runBaseline(const BaselineCode& code, JSValue left, JSValue right, JSValue& result) {
+    JSValue regs[4] = {left, right, JSValue::undefined(), JSValue::undefined()};
+    BaselineFrame frame{regs, nullptr, BaselineCode::kFuel, BaselineExit::Interpret};
+    uint32_t pc = code.run(frame, 0);
+    result = regs[2];
+    return pc == 1;
+}
+
+std::shared_ptr<BaselineCode> compileSingle(Instruction instruction) {
+    BytecodeFunction function;
+    function.registerCount = 4;
+    function.code = {instruction, Instruction(Opcode::ReturnUndefined)};
+    return BaselineCode::compile(function, BaselineHelpers{});
+}
+
+// Either the guard sent the edge to the interpreter with the destination
+// untouched, or the inline result is the exact number
+void checkBaselineResult(const BaselineCode& code, int32_t left, int32_t right, double expected,
+                         const std::string& what) {
+    JSValue result;
+    if (!runBaseline(code, JSValue::int32(left), JSValue::int32(right), result)) {
+        CHECK_WHAT(result.isUndefined(), what + " wrote its result before leaving");
+        return;
+    }
+    CHECK_WHAT(result.isNumber() && sameNumber(result.asNumber(), expected), what);
+}
+
+} // namespace
+
+TEST(baseline_jit_binary_edges_match_interpreter) {
+    for (const BinaryCase& edge : kBinaryCases) {
+        std::string body = std::string("x ") + edge.source + " y";
+        std::string call = std::to_string(edge.left) + " " + edge.source + " " + std::to_string(edge.right);
+        std::string what = describe(call, edge.expected);
+        checkBothTiers(warmedCall(body, edge.left, edge.right), edge.expected, what);
+    }
+}
+
+TEST(baseline_jit_unary_edges_match_interpreter) {
+    for (const UnaryCase& edge : kUnaryCases) {
+        std::string what = describe(std::string(edge.source) + " of " + std::to_string(edge.operand), edge.expected);
+        checkBothTiers(warmedCall(edge.source, edge.operand, 0), edge.expected, what);
+    }
+}
+
+TEST(baseline_jit_loop_edges_match_interpreter) {
+    // Overflows int32 part way through a loop hot enough to tier up
+    checkBothTiers("var s = 0; for (var i = 0; i < 5000; i++) s = s + 1000000; s;", 5e9, "sum past int32");
+    // Wraps through |0 on every iteration instead
+    uint32_t hash = 0;
+    for (uint32_t i = 0; i < 5000; ++i) {
+        hash = hash * 31 + i;
+    }
+    checkBothTiers("var h = 0; for (var i = 0; i < 5000; i++) h = (h * 31 + i) | 0; h;",
+                   static_cast<int32_t>(hash), "wrapped hash");
+    // Remainders of negative numbers keep the dividend's sign, -0 included
+    checkBothTiers("var z = 1; for (var i = 0; i < 5000; i++) z = (-i * 4) % 2; 1 / z;",
+                   -std::numeric_limits<double>::infinity(), "negative zero remainder");
+}
+
+TEST(baseline_jit_guards_leave_edges_to_interpreter) {
+    for (const BinaryCase& edge : kBinaryCases) {
+        std::shared_ptr<BaselineCode> code = compileSingle(Instruction(edge.op, 2, 0, 1));
+        // Targets without a backend run everything on the interpreter
+        if (!code) return;
+
+        std::string call = std::to_string(edge.left) + " " + edge.source + " " + std::to_string(edge.right);
+        std::string what = describe(call, edge.expected);
+        checkBaselineResult(*code, edge.left, edge.right, edge.expected, what);
+    }
+
+    for (const UnaryCase& edge : kUnaryCases) {
+        std::shared_ptr<BaselineCode> code = compileSingle(Instruction(edge.op, 2, 0));
+        if (!code) return;
+
+        std::string what = describe(std::string(edge.source) + " of " + std::to_string(edge.operand), edge.expected);
+        checkBaselineResult(*code, edge.operand, 0, edge.expected, what);
+    }
+
+    // Ordinary int32 arithmetic stays inline
+    std::shared_ptr<BaselineCode> multiply = compileSingle(Instruction(Opcode::Multiply, 2, 0, 1));
+    if (!multiply) return;
+    JSValue result;
+    CHECK(runBaseline(*multiply, JSValue::int32(6), JSValue::int32(-7), result));
+    CHECK(result.isInt32() && result.asInt32() == -42);
+}
@@ -0,0 +1,126 @@
+// Vector blend kernels against the scalar ones, which are the reference
+
+#include "test.h"
+#include "renderer/blend.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace renderer;
+
+namespace {
+
+const BlendIsa kVectorIsas[] = {BlendIsa::SSE41, BlendIsa::AVX2, BlendIsa::NEON};
+
+const BlendMode kModes[] = {
+    BlendMode::Normal,    BlendMode::Multiply,   BlendMode::Screen,     BlendMode::Overlay,
+    BlendMode::SoftLight, BlendMode::HardLight,  BlendMode::ColorDodge, BlendMode::ColorBurn,
+    BlendMode::Darken,    BlendMode::Lighten,    BlendMode::Difference, BlendMode::Exclusion,
+    BlendMode::Hue,       BlendMode::Saturation, BlendMode::Color,      BlendMode::Luminosity,
+};
+
+// Spans around every vector width and tail length, and one long one
+const int kCounts[] = {1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 257};
+
+// Premultiplied pixels, with runs of opaque and transparent ones
+std::vector<uint8_t> premultipliedPixels(std::mt19937& random, int count) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(count) * 4);
+    for (int i = 0; i < count; ++i) {
+        unsigned alpha = random() % 256;
+        if (i % 7 == 0) alpha = 255;
+        if (i % 11 == 0) alpha = 0;
+        pixels[i * 4 + 3] = static_cast<uint8_t>(alpha);
+        for (int c = 0; c < 3; ++c) {
+            pixels[i * 4 + c] = static_cast<uint8_t>(random() % (alpha + 1));
+        }
+    }
+    return pixels;
+}
+
+std::vector<uint8_t> coverageValues(std::mt19937& random, int count) {
+    std::vector<uint8_t> coverage(count);
+    for (int i = 0; i < count; ++i) {
+        coverage[i] = i % 5 == 0 ? 255 : i % 3 == 0 ? 0 : static_cast<uint8_t>(random() % 256);
+    }
+    return coverage;
+}
+
+std::string describe(BlendIsa isa, BlendMode mode, int count) {
+    return "isa " + std::to_string(static_cast<int>(isa)) + ", mode " + std::to_string(static_cast<int>(mode)) +
+           ", " + std::to_string(count) + " pixels";
+}
+
+// Runs span on a copy of pixels under isa
+template <typename Span>
+std::vector<uint8_t> run(BlendIsa isa, const std::vector<uint8_t>& pixels, Span&& span) {
+    setBlendIsa(isa);
+    std::vector<uint8_t> out = pixels;
+    span(out.data());
+    return out;
+}
+
+} // namespace
+
+TEST(blend_kernels_fill_span) {
+    std::mt19937 random(1);
+    const uint8_t color[4] = {10, 20, 30, 40};
+    for (BlendIsa isa : kVectorIsas) {
+        if (!setBlendIsa(isa)) continue;
+        for (int count : kCounts) {
+            std::vector<uint8_t> pixels = premultipliedPixels(random, count);
+            auto fill = [&](uint8_t* dst) { fillSpan(dst, count, color); };
+            CHECK_WHAT(run(isa, pixels, fill) == run(BlendIsa::Scalar, pixels, fill),
+                       describe(isa, BlendMode::Normal, count));
+        }
+    }
+    setBlendIsa(bestBlendIsa());
+}
+
+TEST(blend_kernels_blend_span) {
+    std::mt19937 random(2);
+    const uint8_t colors[][4] = {{100, 20, 200, 200}, {255, 255, 255, 255}, {0, 0, 0, 1}, {60, 0, 60, 128}};
+    for (BlendIsa isa : kVectorIsas) {
+        if (!setBlendIsa(isa)) continue;
+        for (BlendMode mode : kModes) {
+            for (int count : kCounts) {
+                std::vector<uint8_t> pixels = premultipliedPixels(random, count);
+                std::vector<uint8_t> coverage = coverageValues(random, count);
+                const uint8_t* masks[] = {nullptr, coverage.data()};
+                for (const uint8_t* color : colors) {
+                    for (const uint8_t* mask : masks) {
+                        auto blend = [&](uint8_t* dst) { blendSpan(dst, count, color, mask, mode); };
+                        CHECK_WHAT(run(isa, pixels, blend) == run(BlendIsa::Scalar, pixels, blend),
+                                   describe(isa, mode, count) + (mask ? " with coverage" : ""));
+                    }
+                }
+            }
+        }
+    }
+    setBlendIsa(bestBlendIsa());
+}
+
+TEST(blend_kernels_composite_span) {
+    std::mt19937 random(3);
+    for (BlendIsa isa : kVectorIsas) {
+        if (!setBlendIsa(isa)) continue;
+        for (BlendMode mode : kModes) {
+            for (int count : kCounts) {
+                std::vector<uint8_t> pixels = premultipliedPixels(random, count);
+                std::vector<uint8_t> source = premultipliedPixels(random, count);
+                for (uint8_t alpha : {uint8_t{255}, uint8_t{180}, uint8_t{1}}) {
+                    auto composite = [&](uint8_t* dst) { compositeSpan(dst, source.data(), count, mode, alpha); };
+                    CHECK_WHAT(run(isa, pixels, composite) == run(BlendIsa::Scalar, pixels, composite),
+                               describe(isa, mode, count) + ", alpha " + std::to_string(alpha));
+                }
+            }
+        }
+    }
+    setBlendIsa(bestBlendIsa());
+}
+
+TEST(blend_kernels_selection) {
+    CHECK(setBlendIsa(BlendIsa::Scalar));
+    CHECK(blendIsa() == BlendIsa::Scalar);
+    CHECK(setBlendIsa(bestBlendIsa()));
+    CHECK(blendIsa() == bestBlendIsa());
+}
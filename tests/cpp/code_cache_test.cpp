@@ -0,0 +1,166 @@
+// Code cache blobs: round trips, and rejection of truncated blobs and of
+// code that does not verify
+
+#include "test.h"
+#include "js/code_cache.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace js;
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Empty cache directory, removed with the fixture
+struct CacheDirectory {
+    fs::path path;
+
+    explicit CacheDirectory(const char* name) : path(fs::temp_directory_path() / name) {
+        fs::remove_all(path);
+    }
+    ~CacheDirectory() {
+        std::error_code error;
+        fs::remove_all(path, error);
+    }
+
+    // The one blob in the directory
+    fs::path blob() const {
+        for (const auto& entry : fs::directory_iterator(path)) {
+            return entry.path();
+        }
+        return fs::path();
+    }
+};
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const fs::path& path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// r1 = k[0] + k[0]; return r1, with a nested closure
+BytecodeFunction sampleFunction() {
+    auto child = std::make_shared<BytecodeFunction>();
+    child->name = "inner";
+    child->registerCount = 1;
+    child->code = {Instruction(Opcode::ReturnUndefined)};
+    child->positions.resize(child->code.size());
+    child->cacheSlots.resize(child->code.size());
+
+    BytecodeFunction function;
+    function.name = "main";
+    function.registerCount = 3;
+    function.isTopLevel = true;
+    function.constants.emplace_back(1.5);
+    function.names.push_back("x");
+    function.functions.push_back(child);
+    function.code = {Instruction(Opcode::LoadConst, 0, 0), Instruction(Opcode::Add, 1, 0, 0),
+                     Instruction(Opcode::Closure, 2, 0), Instruction(Opcode::Return, 1)};
+    function.positions.resize(function.code.size());
+    function.cacheSlots.resize(function.code.size());
+    return function;
+}
+
+// Stores function and reports whether loading it back was refused
+bool rejected(const BytecodeFunction& function, const char* directory) {
+    CacheDirectory dir(directory);
+    CodeCache cache(dir.path.string());
+    const std::string source = "bad()";
+    if (!cache.store(source, function, 0.01)) return false;
+    return !cache.load(source) && cache.getRejectedCount() == 1;
+}
+
+} // namespace
+
+TEST(code_cache_round_trip) {
+    CacheDirectory dir("apollo_code_cache_round_trip");
+    CodeCache cache(dir.path.string());
+    const std::string source = "1.5 + 1.5";
+    BytecodeFunction function = sampleFunction();
+
+    CHECK(!cache.load(source));
+    CHECK(cache.store(source, function, 0.01));
+    std::shared_ptr<BytecodeFunction> loaded = cache.load(source);
+    CHECK(loaded);
+    if (!loaded) return;
+
+    CHECK(loaded->name == "main");
+    CHECK(loaded->registerCount == 3);
+    CHECK(loaded->constants == function.constants);
+    CHECK(loaded->names == function.names);
+    CHECK(loaded->code.size() == function.code.size());
+    for (size_t i = 0; i < function.code.size() && i < loaded->code.size(); ++i) {
+        const Instruction& a = function.code[i];
+        const Instruction& b = loaded->code[i];
+        CHECK_WHAT(a.op == b.op && a.a == b.a && a.b == b.b && a.c == b.c, "instruction " + std::to_string(i));
+    }
+    CHECK(loaded->functions.size() == 1 && loaded->functions[0]->name == "inner");
+    CHECK(cache.getHitCount() == 1);
+    CHECK(cache.getRejectedCount() == 0);
+
+    // Another source misses
+    CHECK(!cache.load(source + " "));
+}
+
+TEST(code_cache_rejects_truncated_blobs) {
+    CacheDirectory dir("apollo_code_cache_truncated");
+    CodeCache cache(dir.path.string());
+    const std::string source = "1.5 + 1.5";
+    BytecodeFunction function = sampleFunction();
+    CHECK(cache.store(source, function, 0.01));
+    const std::string blob = readFile(dir.blob());
+    CHECK(!blob.empty());
+
+    size_t rejections = 0;
+    for (size_t length = 0; length < blob.size(); ++length) {
+        CHECK(cache.store(source, function, 0.01));
+        writeFile(dir.blob(), blob.substr(0, length));
+        CHECK_WHAT(!cache.load(source), "blob cut to " + std::to_string(length) + " bytes");
+        // An empty file reads as a miss
+        if (length > 0) ++rejections;
+    }
+    CHECK(cache.getRejectedCount() == rejections);
+
+    // A rejected blob is removed, and a fresh store loads again
+    CHECK(cache.store(source, function, 0.01));
+    CHECK(cache.load(source));
+}
+
+TEST(code_cache_rejects_unverified_code) {
+    BytecodeFunction function = sampleFunction();
+    function.code[3] = Instruction(Opcode::Return, 200);
+    CHECK_WHAT(rejected(function, "apollo_code_cache_register"), "register past registerCount");
+
+    function = sampleFunction();
+    function.code[0] = Instruction(Opcode::LoadConst, 0, 7);
+    CHECK_WHAT(rejected(function, "apollo_code_cache_constant"), "constant past the pool");
+
+    function = sampleFunction();
+    function.code[2] = Instruction(Opcode::Closure, 2, 1);
+    CHECK_WHAT(rejected(function, "apollo_code_cache_closure"), "child function past the table");
+
+    function = sampleFunction();
+    Instruction jump(Opcode::Jump);
+    jump.setTarget(99);
+    function.code.insert(function.code.begin(), jump);
+    function.positions.resize(function.code.size());
+    function.cacheSlots.resize(function.code.size());
+    CHECK_WHAT(rejected(function, "apollo_code_cache_jump"), "jump past the code");
+
+    function = sampleFunction();
+    function.code.pop_back();
+    function.positions.pop_back();
+    function.cacheSlots.pop_back();
+    CHECK_WHAT(rejected(function, "apollo_code_cache_fallthrough"), "code running off its end");
+
+    function = sampleFunction();
+    function.functions[0]->code[0] = Instruction(Opcode::Return, 5);
+    CHECK_WHAT(rejected(function, "apollo_code_cache_child"), "bad register in a child function");
+}
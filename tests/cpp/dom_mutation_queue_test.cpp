@@ -0,0 +1,50 @@
+// Node handles of the DOM mutation queue across removal and slot reuse
+
+#include "test.h"
+#include "dom_mutation_queue.h"
+#include "layout/layout_engine.h"
+#include <memory>
+
+using namespace apollo;
+using namespace layout;
+
+TEST(dom_mutation_queue_skips_writes_to_removed_nodes) {
+    LayoutEngine engine;
+    engine.setTree(std::make_unique<LayoutTree>());
+    DOMMutationQueue queue(engine);
+
+    NodeHandle root = queue.createNode(std::make_shared<LayoutBox>());
+    engine.tree()->setRoot(engine.tree()->nodeAt(root.index));
+    NodeHandle removed = queue.createNode(std::make_shared<LayoutBox>());
+    queue.appendChild(root, removed);
+    queue.removeNode(removed);
+    queue.flush();
+
+    // The new node takes the removed one's slot, but not its handle
+    NodeHandle created = queue.createNode(std::make_shared<LayoutBox>());
+    CHECK(created.index == removed.index);
+    CHECK(created != removed);
+
+    queue.setText(removed, "stale");
+    queue.appendChild(removed, root);
+    queue.setText(created, "fresh");
+    uint64_t skipped = queue.stats().skippedWrites;
+    CHECK(queue.flush() == 3);
+    CHECK(queue.stats().skippedWrites == skipped + 2);
+    CHECK(engine.tree()->nodeAt(created.index)->textContent() == "fresh");
+    CHECK(engine.tree()->root()->firstChild() == nullptr);
+}
+
+TEST(dom_mutation_queue_handles_nodes_built_elsewhere) {
+    LayoutEngine engine;
+    engine.setTree(std::make_unique<LayoutTree>());
+    DOMMutationQueue queue(engine);
+
+    LayoutNode* node = engine.tree()->createNode(std::make_shared<LayoutBox>());
+    NodeHandle handle = queue.handleOf(node);
+    queue.setText(handle, "parsed");
+    queue.flush();
+    CHECK(node->textContent() == "parsed");
+
+    CHECK(queue.handleOf(nullptr) == NodeHandle());
+}
@@ -0,0 +1,129 @@
+// Layout captures: round trips, and rejection of truncated and corrupt
+// captures
+
+#include "test.h"
+#include "layout/layout_capture.h"
+#include "layout/grid_tracks.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace layout;
+
+namespace {
+
+// Grid root over 50 text nodes sharing one box, every tenth with a child
+std::unique_ptr<LayoutTree> sampleTree() {
+    auto tree = std::make_unique<LayoutTree>();
+
+    auto rootBox = std::make_shared<LayoutBox>();
+    rootBox->setDisplay(Display::Grid);
+    auto grid = std::make_shared<GridTemplate>();
+    grid->columns = {GridTrackSize::fixed(100), GridTrackSize::flex(1)};
+    grid->rows = {GridTrackSize::autoSize()};
+    grid->columnGap = 4;
+    rootBox->setGridTemplate(grid);
+    rootBox->setPadding(EdgeInsets(1, 2, 3, 4));
+    LayoutNode* root = tree->createNode(rootBox);
+    tree->setRoot(root);
+
+    auto shared = std::make_shared<LayoutBox>();
+    shared->setDisplay(Display::Inline);
+    shared->setZIndex(-3);
+    shared->setOpacity(0.5);
+    FlexItemStyle item;
+    item.grow = 2;
+    item.alignSelf = AlignSelf::Center;
+    shared->setFlexItemStyle(item);
+    for (int i = 0; i < 50; ++i) {
+        LayoutNode* node = tree->createNode(shared);
+        node->setTextContent("hello " + std::to_string(i));
+        node->setFontMetrics(FontMetrics(10, 3, 1, 5, 7));
+        node->setLayoutRect(Rect(i, 2 * i, 30, 12));
+        root->addChild(node);
+        if (i % 10 == 0) {
+            LayoutNode* child = tree->createNode(std::make_shared<LayoutBox>());
+            child->setMinSize(Size(5, 6));
+            node->addChild(child);
+        }
+    }
+    return tree;
+}
+
+} // namespace
+
+TEST(layout_capture_round_trip) {
+    std::unique_ptr<LayoutTree> tree = sampleTree();
+    std::vector<uint8_t> data = serializeLayoutTree(*tree);
+    CHECK(isLayoutCapture(data.data(), data.size()));
+
+    std::string error;
+    std::unique_ptr<LayoutTree> copy = deserializeLayoutTree(data.data(), data.size(), error);
+    CHECK_WHAT(copy, error);
+    if (!copy) return;
+
+    // Captures of the copy match the original byte for byte
+    CHECK(serializeLayoutTree(*copy) == data);
+    CHECK(copy->root()->box()->gridTemplate() == tree->root()->box()->gridTemplate());
+    CHECK(copy->root()->box()->padding().left == 4);
+    size_t count = 0;
+    for (LayoutNode* node : copy->root()->children()) {
+        std::string what = "node " + std::to_string(count);
+        CHECK_WHAT(node->box()->zIndex() == -3, what);
+        CHECK_WHAT(node->box()->flexItemStyle().alignSelf == AlignSelf::Center, what);
+        CHECK_WHAT(node->textContent() == "hello " + std::to_string(count), what);
+        CHECK_WHAT(node->fontMetrics().capHeight == 7, what);
+        CHECK_WHAT(node->layoutRect().y == 2.0 * count, what);
+        ++count;
+    }
+    CHECK(count == 50);
+}
+
+TEST(layout_capture_file_round_trip) {
+    std::unique_ptr<LayoutTree> tree = sampleTree();
+    std::vector<uint8_t> data = serializeLayoutTree(*tree);
+    std::string path = (std::filesystem::temp_directory_path() / "apollo_layout_capture_test.lytc").string();
+
+    std::string error;
+    CHECK_WHAT(saveLayoutTree(*tree, path, error), error);
+    CHECK(isLayoutCaptureFile(path));
+    std::unique_ptr<LayoutTree> loaded = loadLayoutTree(path, error);
+    CHECK_WHAT(loaded && serializeLayoutTree(*loaded) == data, error);
+
+    std::error_code removeError;
+    std::filesystem::remove(path, removeError);
+}
+
+TEST(layout_capture_rejects_truncated_captures) {
+    std::unique_ptr<LayoutTree> tree = sampleTree();
+    std::vector<uint8_t> data = serializeLayoutTree(*tree);
+
+    for (size_t length = 0; length < data.size(); ++length) {
+        std::string error;
+        std::unique_ptr<LayoutTree> cut = deserializeLayoutTree(data.data(), length, error);
+        CHECK_WHAT(!cut && !error.empty(), "capture cut to " + std::to_string(length) + " bytes");
+    }
+}
+
+TEST(layout_capture_rejects_corrupt_captures) {
+    std::unique_ptr<LayoutTree> tree = sampleTree();
+    std::vector<uint8_t> data = serializeLayoutTree(*tree);
+
+    // Every flipped byte either still reads as a tree or is refused with an
+    // error; none may crash or read outside the capture
+    for (size_t i = 0; i < data.size(); ++i) {
+        std::vector<uint8_t> corrupt = data;
+        corrupt[i] ^= 0xA5;
+        std::string error;
+        std::unique_ptr<LayoutTree> result = deserializeLayoutTree(corrupt.data(), corrupt.size(), error);
+        CHECK_WHAT(result || !error.empty(), "byte " + std::to_string(i) + " flipped");
+    }
+
+    // Header fields are checked outright
+    std::vector<uint8_t> badMagic = data;
+    badMagic[0] ^= 0xFF;
+    std::string error;
+    CHECK(!deserializeLayoutTree(badMagic.data(), badMagic.size(), error));
+    CHECK(!isLayoutCapture(badMagic.data(), badMagic.size()));
+}
@@ -0,0 +1,53 @@
+// Runs the registered tests, or those whose name contains the first
+// argument; exits nonzero if any check failed
+
+#include "test.h"
+#include <cstdio>
+#include <cstring>
+
+namespace apollo {
+namespace test {
+
+namespace {
+
+size_t failures = 0;
+
+} // namespace
+
+std::vector<TestCase>& registry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+void fail(const char* file, int line, const std::string& what) {
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what.c_str());
+    ++failures;
+}
+
+} // namespace test
+} // namespace apollo
+
+int main(int argc, char** argv) {
+    using namespace apollo::test;
+
+    const char* filter = argc > 1 ? argv[1] : "";
+    size_t run = 0;
+    size_t failed = 0;
+    for (const TestCase& test : registry()) {
+        if (!std::strstr(test.name, filter)) continue;
+
+        size_t before = failures;
+        test.run();
+        ++run;
+        bool passed = failures == before;
+        if (!passed) ++failed;
+        std::printf("%-48s %s\n", test.name, passed ? "ok" : "FAILED");
+    }
+
+    if (run == 0) {
+        std::fprintf(stderr, "no tests match \"%s\"\n", filter);
+        return 1;
+    }
+    std::printf("%zu of %zu tests passed\n", run - failed, run);
+    return failed ? 1 : 0;
+}
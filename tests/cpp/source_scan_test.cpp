@@ -0,0 +1,98 @@
+// Vector source scanners against the scalar ones, which are the reference
+
+#include "test.h"
+#include "js/source_scan.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace js;
+
+namespace {
+
+const ScanIsa kVectorIsas[] = {ScanIsa::SSE2, ScanIsa::AVX2, ScanIsa::NEON};
+
+// Texts mostly of one kind of run, with the bytes that end each kind
+// sprinkled in; runs outlast the scalar probe and cross 64-byte blocks
+std::vector<std::string> sampleTexts() {
+    const std::string alphabets[] = {
+        " \t\t    \n",
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_$",
+        "some comment text, with punctuation ; + - = ( ) { }",
+        "string body text and spaces",
+    };
+    const std::string stops = "\n\r*/'\"\\`${}. \x7f\x80\xff";
+
+    std::mt19937 random(7);
+    std::vector<std::string> texts;
+    for (const std::string& alphabet : alphabets) {
+        for (size_t length : {0, 1, 15, 16, 17, 63, 64, 65, 130, 300}) {
+            for (int density : {0, 1, 8, 64}) {
+                std::string text;
+                for (size_t i = 0; i < length; ++i) {
+                    bool stop = density > 0 && static_cast<int>(random() % 512) < density;
+                    const std::string& from = stop ? stops : alphabet;
+                    text.push_back(from[random() % from.size()]);
+                }
+                texts.push_back(text);
+            }
+        }
+    }
+    // Stops exactly at block edges
+    for (size_t edge : {31, 32, 63, 64, 127, 128}) {
+        for (char stop : stops) {
+            std::string text(edge + 40, 'a');
+            text[edge] = stop;
+            texts.push_back(text);
+            std::string spaces(edge + 40, ' ');
+            spaces[edge] = stop;
+            texts.push_back(spaces);
+        }
+    }
+    return texts;
+}
+
+// Results of every scanner from every position of text under isa
+std::vector<size_t> scanAll(ScanIsa isa, const std::string& text) {
+    setScanIsa(isa);
+    std::vector<size_t> results;
+    for (size_t position = 0; position <= text.size(); ++position) {
+        results.push_back(skipWhitespaceRun(text, position));
+        results.push_back(skipIdentifierRun(text, position));
+        results.push_back(findLineEnd(text, position));
+        results.push_back(findBlockCommentEnd(text, position));
+        results.push_back(findStringStop(text, position, '"'));
+        results.push_back(findStringStop(text, position, '\''));
+        results.push_back(findTemplateStop(text, position));
+    }
+    return results;
+}
+
+} // namespace
+
+TEST(source_scan_kernels_match_scalar) {
+    std::vector<std::string> texts = sampleTexts();
+    for (ScanIsa isa : kVectorIsas) {
+        if (!setScanIsa(isa)) continue;
+        for (size_t i = 0; i < texts.size(); ++i) {
+            CHECK_WHAT(scanAll(isa, texts[i]) == scanAll(ScanIsa::Scalar, texts[i]),
+                       "isa " + std::to_string(static_cast<int>(isa)) + ", text " + std::to_string(i));
+        }
+    }
+    setScanIsa(bestScanIsa());
+}
+
+TEST(source_scan_scalar_results) {
+    setScanIsa(ScanIsa::Scalar);
+    CHECK(skipWhitespaceRun("  \t\nx", 0) == 4);
+    CHECK(skipIdentifierRun("get$Value_2 ", 0) == 11);
+    CHECK(skipIdentifierRun("caf\xc3\xa9", 0) == 3);
+    CHECK(findLineEnd("abc\r\n", 0) == 3);
+    CHECK(findLineEnd("abc", 1) == 3);
+    CHECK(findBlockCommentEnd("a * b */", 0) == 6);
+    CHECK(findBlockCommentEnd("a * b *", 0) == 7);
+    CHECK(findStringStop("it's \"q\"", 0, '"') == 5);
+    CHECK(findStringStop("a\\'b'", 0, '\'') == 1);
+    CHECK(findTemplateStop("text ${x}`", 0) == 5);
+    setScanIsa(bestScanIsa());
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace apollo {
+namespace test {
+
+// C++ tests of the engine's fast paths against their reference paths
+//
+// TEST(name) defines a test and registers it with the runner in main.cpp.
+// CHECK records a failure with its file and line and lets the test go on,
+// so one run reports every mismatch; CHECK_WHAT adds a description of the
+// case, for checks inside loops over inputs.
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<TestCase>& registry();
+void fail(const char* file, int line, const std::string& what);
+
+struct Registrar {
+    Registrar(const char* name, void (*run)()) { registry().push_back(TestCase{name, run}); }
+};
+
+} // namespace test
+} // namespace apollo
+
+#define TEST(name) \
+    static void test_##name(); \
+    static const ::apollo::test::Registrar registrar_##name(#name, test_##name); \
+    static void test_##name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) ::apollo::test::fail(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#define CHECK_WHAT(condition, what) \
+    do { \
+        if (!(condition)) ::apollo::test::fail(__FILE__, __LINE__, std::string(#condition) + " for " + (what)); \
+    } while (0)